@@ -1,4 +1,7 @@
 
+#include <algorithm>
+#include <iterator>
+
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -37,10 +40,6 @@ void Buffer::init(int buffer[], unsigned int count, unsigned int fmt, unsigned i
 // multi-planar format.
 int Buffer::alloc(unsigned int fmt, unsigned int width, unsigned int height)
 {
-    int devfd = exynos_ion_open();
-    if (devfd < 0)
-        return -1;
-
     // MSCL may read extra 128 pixels after the image region of interest due to its performance.
     // So, we should feed MSCL H/W more memory not to cause buffer overrun.
     size_t len = width * height + NR_EXTRA_PIXELS;
@@ -50,19 +49,126 @@ int Buffer::alloc(unsigned int fmt, unsigned int width, unsigned int height)
         len += len / 2;
     }
 
-    int buffd = exynos_ion_alloc(devfd, len, 1, 0);
+    int buffd = mPool->get(len);
     if (buffd < 0)
         ALOGERR("failed to allocate for %ux%u (fmt %#x)", width, height ,fmt);
+    else
+        mLength = len;
+
+    return buffd;
+}
+
+Buffer::~Buffer()
+{
+    if (mPool && (mBuffer[0] >= 0))
+        mPool->put(mBuffer[0]);
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto &ent: mEntries)
+        close(ent.fd);
+}
+
+size_t BufferPool::sizeClass(size_t len)
+{
+    // 4 size classes per power of two: 1.25, 1.5, 1.75 and 2 times.
+    size_t order = 1;
+    while ((order << 1) < len)
+        order <<= 1;
+
+    size_t step = std::max(order / 4, static_cast<size_t>(getpagesize()));
+
+    return (len + step - 1) / step * step;
+}
+
+int BufferPool::get(size_t len)
+{
+    len = sizeClass(len);
+
+    // the most recently used one is likely to be warm in the system MMU
+    for (auto iter = mEntries.rbegin(); iter != mEntries.rend(); iter++) {
+        if (!iter->busy && (iter->len == len)) {
+            Entry ent = *iter;
+            mEntries.erase(std::next(iter).base());
+            ent.busy = true;
+            mEntries.push_back(ent);
+            return ent.fd;
+        }
+    }
+
+    // release the idle buffers of other size classes to make room for the new buffer
+    for (auto iter = mEntries.begin(); (mTotal + len > mLimit) && (iter != mEntries.end()); ) {
+        if (iter->busy) {
+            iter++;
+            continue;
+        }
+        release(iter);
+    }
+
+    int devfd = exynos_ion_open();
+    if (devfd < 0)
+        return -1;
+
+    int buffd = exynos_ion_alloc(devfd, len, 1, 0);
 
     exynos_ion_close(devfd);
 
+    if (buffd >= 0) {
+        mEntries.push_back({buffd, len, true});
+        mTotal += len;
+    }
+
     return buffd;
 }
 
-Buffer::~Buffer()
+void BufferPool::put(int fd)
 {
-    if (mAllocated && (mBuffer[0] >= 0))
-        close(mBuffer[0]);
+    for (auto iter = mEntries.begin(); iter != mEntries.end(); iter++) {
+        if (iter->fd == fd) {
+            iter->busy = false;
+            // a job larger than the limit does not leave its buffers
+            if (mTotal > mLimit)
+                release(iter);
+            return;
+        }
+    }
+}
+
+void BufferPool::release(std::vector<Entry>::iterator &iter)
+{
+    close(iter->fd);
+    mTotal -= iter->len;
+    iter = mEntries.erase(iter);
+}
+
+void BufferPool::trim(size_t keep)
+{
+    size_t idle = 0;
+    for (auto &ent: mEntries)
+        if (!ent.busy)
+            idle += ent.len;
+
+    for (auto iter = mEntries.begin(); (idle > keep) && (iter != mEntries.end()); ) {
+        if (iter->busy) {
+            iter++;
+            continue;
+        }
+        idle -= iter->len;
+        release(iter);
+    }
+}
+
+void BufferPool::setLimit(size_t limit)
+{
+    mLimit = limit;
+
+    size_t busy = 0;
+    for (auto &ent: mEntries)
+        if (ent.busy)
+            busy += ent.len;
+
+    trim((limit > busy) ? limit - busy : 0);
 }
 
 int Buffer::getByteOffset(unsigned int idx, unsigned int x_offset, unsigned int y_offset, unsigned int pixel_stride) const
@@ -1,11 +1,46 @@
 #ifndef _BUFFER_H_
 #define _BUFFER_H_
 
+#include <cstddef>
+#include <vector>
+
 #include <exynos_format.h> // hardware/smasung_slsi/exynos/include
 
+// Bounce buffers kept across the jobs. The buffers are grouped by size classes
+// of a quarter of the power of two to be reused by the jobs with similar sizes.
+// The total size of the buffers is kept under the limit unless a job requires
+// more than the limit. The buffers exceeding the limit are released when the
+// job finishes.
+class BufferPool {
+public:
+    static const size_t DEFAULT_LIMIT = 64 * 1024 * 1024;
+
+    BufferPool(size_t limit = DEFAULT_LIMIT): mLimit(limit) { }
+    ~BufferPool();
+
+    int get(size_t len);
+    void put(int fd);
+    // release the idle buffers until the total size of the idle buffers is not larger than @keep.
+    void trim(size_t keep = 0);
+    void setLimit(size_t limit);
+private:
+    struct Entry {
+        int fd;
+        size_t len;
+        bool busy;
+    };
+
+    static size_t sizeClass(size_t len);
+    void release(std::vector<Entry>::iterator &iter);
+
+    std::vector<Entry> mEntries; // the least recently used first
+    size_t mTotal = 0;
+    size_t mLimit;
+};
+
 class Buffer {
 public:
-    Buffer(int buffer[], unsigned int fmt, unsigned int width, unsigned int height): mAllocated(false) {
+    Buffer(int buffer[], unsigned int fmt, unsigned int width, unsigned int height) {
         unsigned int count = 1;
         if ((fmt == HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M) || (fmt == HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M))
             count = 2;
@@ -13,7 +48,7 @@ public:
         init(buffer, count, fmt, width, height);
     }
 
-    Buffer(unsigned int fmt, unsigned int width, unsigned int height): mAllocated(true) {
+    Buffer(BufferPool &pool, unsigned int fmt, unsigned int width, unsigned int height): mPool(&pool) {
         int fd = alloc(fmt, width, height);
         if (fd >= 0)
             init(&fd, 1, fmt, width, height);
@@ -28,9 +63,10 @@ public:
         }
 
         mCount = buf.mCount;
-        mAllocated = buf.mAllocated;
+        mPool = buf.mPool;
+        mLength = buf.mLength;
 
-        buf.mAllocated = false;
+        buf.mPool = nullptr;
         buf.mCount = 0;
     }
 
@@ -43,9 +79,10 @@ public:
         }
 
         mCount = buf.mCount;
-        mAllocated = buf.mAllocated;
+        mPool = buf.mPool;
+        mLength = buf.mLength;
 
-        buf.mAllocated = false;
+        buf.mPool = nullptr;
         buf.mCount = 0;
 
         return *this;
@@ -61,13 +98,16 @@ public:
     int getByteOffset(unsigned int idx, unsigned int x_offset, unsigned int y_offset, unsigned int pixel_stride) const;
     int operator[](unsigned int idx) { return get(idx); }
     unsigned int count() const { return mCount; }
+    // bytes allocated from the pool. 0 if the buffer is given by the client
+    size_t length() const { return mLength; }
 private:
     int mBuffer[2] = {-1, -1};
     int mOffset[2] = {0, 0};
     unsigned char mHBitPP[2] = {8, 8}; // NV12
     unsigned char mVBitPP[2] = {8, 4}; // NV12
     unsigned int mCount = 0;
-    bool mAllocated;
+    BufferPool *mPool = nullptr; // the pool that the buffer is borrowed from
+    size_t mLength = 0;
 };
 
 #endif //_BUFFER_H_
@@ -41,6 +41,37 @@ bool GiantMscl::run(int src_buffer[], int dst_buffer[])
     return mImpl && mImpl->run(src_buffer, dst_buffer);
 }
 
+bool GiantMscl::runAsync(int src_buffer[], int dst_buffer[])
+{
+    return mImpl && mImpl->runAsync(src_buffer, dst_buffer);
+}
+
+bool GiantMscl::wait()
+{
+    return mImpl && mImpl->wait();
+}
+
+void GiantMscl::setBufferPoolLimit(size_t limit)
+{
+    if (mImpl)
+        mImpl->setBufferPoolLimit(limit);
+}
+
+void GiantMscl::trimBufferPool()
+{
+    if (mImpl)
+        mImpl->trimBufferPool();
+}
+
+bool GiantMscl::getJobInfo(JobInfo &info)
+{
+    if (!mImpl)
+        return false;
+
+    info = mImpl->getJobInfo();
+    return true;
+}
+
 bool GiantMscl::okay()
 {
     return mImpl && mImpl->available();
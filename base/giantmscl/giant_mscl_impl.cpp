@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -108,6 +110,8 @@ GiantMsclImpl::GiantMsclImpl(bool suppress_error)
 
 GiantMsclImpl::~GiantMsclImpl()
 {
+    wait();
+
     if (mFdDev >= 0)
         ::close(mFdDev);
 }
@@ -136,28 +140,50 @@ bool GiantMsclImpl::setDst(unsigned int dstw, unsigned int dsth, unsigned int fm
 
 bool GiantMsclImpl::run(int src_buffer[], int dst_buffer[])
 {
-    mscl_job job;
-    mscl_task task[6];
-    job.tasks = task;
+    return runAsync(src_buffer, dst_buffer) && wait();
+}
 
-    mBufferStore.clear();
+bool GiantMsclImpl::runAsync(int src_buffer[], int dst_buffer[])
+{
+    // the tasks and the bounce buffers of the pending job are still in use
+    wait();
+
+    mJob.tasks = mTasks;
 
-    job.taskcount = generate(task, 6, src_buffer, dst_buffer);
-    if (job.taskcount < 1) {
+    mJob.taskcount = generate(mTasks, MAX_TASKS, src_buffer, dst_buffer);
+    if (mJob.taskcount < 1) {
+        mBufferStore.clear();
         return false;
     }
 
-    job.version = 0;
+    mJob.version = 0;
 
-    showJob(&job);
-    if (::ioctl(mFdDev, MSCL_IOC_JOB, &job) < 0) {
-        ALOGERR("failed to run Giant MSCL");
-        return false;
-    }
+    showJob(&mJob);
+
+    // MSCL_IOC_JOB returns after the job is completed
+    mPendingJob = std::async(std::launch::async, [this] () {
+        bool success = ::ioctl(mFdDev, MSCL_IOC_JOB, &mJob) >= 0;
+        if (!success)
+            ALOGERR("failed to run Giant MSCL");
+        return success;
+    });
 
     return true;
 }
 
+bool GiantMsclImpl::wait()
+{
+    if (!mPendingJob.valid())
+        return false;
+
+    bool success = mPendingJob.get();
+
+    // the bounce buffers are returned to mBufferPool for the next job
+    mBufferStore.clear();
+
+    return success;
+}
+
 static inline unsigned int round_up(unsigned int val, unsigned int factor)
 {
     // factor & (factor - 1) == 0.
@@ -169,97 +195,179 @@ static inline bool is_aligned(unsigned int val, unsigned int factor)
     // factor & (factor - 1) == 0.
     return !(val & (factor - 1));
 }
-
-int GiantMsclImpl::generate(mscl_task tasks[], unsigned int count, int src_buffer[], int dst_buffer[])
+static inline unsigned int make_even(unsigned int val)
 {
-    unsigned int task_count = 0;
-    unsigned int srcBufferIdx = 0;
-    Image target = mSrcImage;
+    return (val + 1) & ~1;
+}
 
-    mBufferStore.emplace_back(src_buffer, format(mSrcImage), width(mSrcImage), height(mSrcImage));
-    // last element of mBufferStore is always the destination buffer.
-    mBufferStore.emplace_back(dst_buffer, format(mDstImage), width(mDstImage), height(mDstImage));
+// Stage targets of scaling @from to @to along an axis. Downscaling by 1/4 as
+// early as possible makes the intermediate images the smallest.
+// @to_aligned is false if @to cannot be partitioned by two for the 8K limit.
+static std::vector<unsigned int> planDownscale(unsigned int from, unsigned int to, bool to_aligned)
+{
+    std::vector<unsigned int> stages;
+
+    while (from != to) {
+        unsigned int next = std::max(make_even(round_up(from, 4) / 4), to);
+        // both of the source and the target are partitioned if the source is larger than 8K
+        if ((from > NR_PIXELS_8K) && ((next != to) || !to_aligned))
+            next = round_up(next, 4);
+        stages.push_back(next);
+        from = next;
+    }
 
-    do {
-        Image source = target;
+    return stages;
+}
 
-        unsigned int srcWidth = width(source);
-        unsigned int srcHeight = height(source);
+// Upscaling by 8 at the last stages keeps the intermediate images the smallest.
+// So the stages are planned backward from @to.
+// @from_aligned is false if @from cannot be partitioned by two for the 8K limit.
+static std::vector<unsigned int> planUpscale(unsigned int from, unsigned int to, bool from_aligned)
+{
+    std::vector<unsigned int> stages;
+    unsigned int cur = to;
 
-        if (rotate90(mTransform))
-            std::swap(srcWidth, srcHeight);
+    while (cur > from) {
+        stages.insert(stages.begin(), cur);
 
-        unsigned int targetWidth, targetHeight;
+        unsigned int prev = make_even(round_up(cur, 8) / 8);
+        if (cur > NR_PIXELS_8K)
+            prev = round_up(prev, 4);
 
-        if (srcWidth > width(mDstImage)) {
-            targetWidth = std::max(makeEven(round_up(srcWidth, 4) / 4), width(mDstImage));
-            if (srcWidth > NR_PIXELS_8K)
-                targetWidth = round_up(targetWidth, 4);
-        } else {
-            targetWidth = std::min(srcWidth * 8, width(mDstImage));
-            // if targetWidth is larger than 8K, the restriction by partitioned processing is checked by setDst().
-            // if srcWidth is not proper for partitioned procesing, insert an upscaling without partitioning.
-            if (targetWidth > NR_PIXELS_8K) {
-                unsigned int factor = 4;
-                if (rotate90(mTransform) && (format(source) == HAL_PIXEL_FORMAT_YCBCR_422_I))
-                    factor = 2;
-                if (!is_aligned(srcWidth, factor))
-                    targetWidth = NR_PIXELS_8K;
-            }
+        if (prev <= from) {
+            // insert a stage to the aligned size that does not need partitioning
+            if ((cur > NR_PIXELS_8K) && !from_aligned)
+                stages.insert(stages.begin(), round_up(from, 4));
+            break;
         }
 
-        if (srcHeight > height(mDstImage)) {
-            targetHeight = std::max(makeEven(round_up(srcHeight, 4) / 4), height(mDstImage));
-            if (srcHeight > NR_PIXELS_8K) {
-                if (format(mDstImage) == HAL_PIXEL_FORMAT_YCBCR_422_I)
-                    targetHeight = round_up(targetHeight, 2);
-                else
-                    targetHeight = round_up(targetHeight, 4);
-            }
-        } else {
-            targetHeight = std::min(srcHeight * 8, height(mDstImage));
-            if (targetHeight > NR_PIXELS_8K) {
-                unsigned int factor = 4;
-                if (!rotate90(mTransform) && (format(source) == HAL_PIXEL_FORMAT_YCBCR_422_I))
-                    factor = 2;
-                if (!is_aligned(srcHeight, factor))
-                    targetHeight = NR_PIXELS_8K;
-            }
+        cur = prev;
+    }
+
+    return stages;
+}
+
+// The intermediate images are always aligned by 4 when partitioned while
+// YUYV is partitioned by the multiple of 2 along its vertical axis.
+static bool is_partitionable(unsigned int val, unsigned int format, bool vertical)
+{
+    return is_aligned(val, (vertical && (format == HAL_PIXEL_FORMAT_YCBCR_422_I)) ? 2 : 4);
+}
+
+static std::vector<unsigned int> planAxis(unsigned int from, unsigned int to, bool from_aligned, bool to_aligned)
+{
+    if (from > to)
+        return planDownscale(from, to, to_aligned);
+    return planUpscale(from, to, from_aligned);
+}
+
+std::vector<GiantMsclImpl::Image> GiantMsclImpl::planStages()
+{
+    bool rot = rotate90(mTransform);
+    // sizes are in the orientation of the destination
+    unsigned int srcWidth = rot ? height(mSrcImage) : width(mSrcImage);
+    unsigned int srcHeight = rot ? width(mSrcImage) : height(mSrcImage);
+
+    auto hStages = planAxis(srcWidth, width(mDstImage),
+                            is_partitionable(srcWidth, format(mSrcImage), rot),
+                            is_partitionable(width(mDstImage), format(mDstImage), false));
+    auto vStages = planAxis(srcHeight, height(mDstImage),
+                            is_partitionable(srcHeight, format(mSrcImage), !rot),
+                            is_partitionable(height(mDstImage), format(mDstImage), true));
+
+    // An axis with less stages is not scaled at the first stages if it is
+    // upscaled and at the last stages if it is downscaled.
+    size_t count = std::max({hStages.size(), vStages.size(), static_cast<size_t>(1)});
+    auto pad = [count](std::vector<unsigned int> &stages, unsigned int from, unsigned int to) {
+        if (from > to)
+            stages.resize(count, to);
+        else
+            stages.insert(stages.begin(), count - stages.size(), from);
+    };
+    pad(hStages, srcWidth, width(mDstImage));
+    pad(vStages, srcHeight, height(mDstImage));
+
+    std::vector<Image> stages;
+    for (size_t i = 0; i < count; i++)
+        stages.emplace_back(hStages[i], vStages[i], format(mDstImage));
+
+    return stages;
+}
+
+size_t GiantMsclImpl::pickTransformStage(const std::vector<Image> &stages)
+{
+    // Rotation and flip degrade the throughput of MSCL while the number of
+    // pixels processed by each stage does not depend on the stage that
+    // transforms. So the stage that processes the least pixels transforms.
+    size_t best = 0;
+    uint64_t bestPixels = UINT64_MAX;
+    uint64_t srcPixels = static_cast<uint64_t>(width(mSrcImage)) * height(mSrcImage);
+
+    for (size_t i = 0; i < stages.size(); i++) {
+        uint64_t dstPixels = static_cast<uint64_t>(width(stages[i])) * height(stages[i]);
+        if (srcPixels + dstPixels < bestPixels) {
+            best = i;
+            bestPixels = srcPixels + dstPixels;
         }
+        srcPixels = dstPixels;
+    }
+
+    return best;
+}
+
+int GiantMsclImpl::generate(mscl_task tasks[], unsigned int count, int src_buffer[], int dst_buffer[])
+{
+    unsigned int task_count = 0;
+    std::vector<Image> stages = planStages();
+    size_t transformStage = (mTransform != 0) ? pickTransformStage(stages) : 0;
+    Image source = mSrcImage;
+
+    mJobInfo = {};
 
-        target = std::make_tuple(targetWidth, targetHeight, format(mDstImage));
+    mBufferStore.emplace_back(src_buffer, format(mSrcImage), width(mSrcImage), height(mSrcImage));
+    // last element of mBufferStore is always the destination buffer.
+    mBufferStore.emplace_back(dst_buffer, format(mDstImage), width(mDstImage), height(mDstImage));
+
+    for (size_t i = 0; i < stages.size(); i++) {
+        Image target = stages[i];
+
+        // the images before the transforming stage are in the orientation of the source
+        if ((i < transformStage) && rotate90(mTransform))
+            target = std::make_tuple(height(target), width(target), format(target));
 
         unsigned int targetBufferIdx = mBufferStore.size() - 1;
-        if (target != mDstImage) {
-            targetBufferIdx = srcBufferIdx + 1;
-            auto iter = mBufferStore.emplace(mBufferStore.begin() + targetBufferIdx,
+        if (i + 1 < stages.size()) {
+            targetBufferIdx = i + 1;
+            auto iter = mBufferStore.emplace(mBufferStore.begin() + targetBufferIdx, mBufferPool,
                                              format(target), width(target), height(target));
             if (iter->get(0) < 0)
                 return -1;
+            mJobInfo.bounce_bytes += iter->length();
         }
 
-        int ret = generateTask(source, target, srcBufferIdx, targetBufferIdx, &tasks[task_count], count - task_count);
+        int ret = generateTask(source, target, i, targetBufferIdx,
+                               (i == transformStage) ? mTransform : 0,
+                               &tasks[task_count], count - task_count);
         if (ret < 1)
             return ret;
 
+        if (i < GiantMscl::JobInfo::MAX_STAGES)
+            mJobInfo.task_count[i] = ret;
+        mJobInfo.stage_count = i + 1;
+
         task_count += ret;
-        srcBufferIdx++;
-    } while (target != mDstImage);
+        source = target;
+    }
 
     return static_cast<int>(task_count);
 }
 
 int GiantMsclImpl::generateTask(const Image &source, const Image &target,
                             unsigned int src_buf_idx, unsigned int dst_buf_idx,
-                            mscl_task tasks[], unsigned int count) {
+                            unsigned int transform, mscl_task tasks[], unsigned int count) {
     unsigned int task_count = 0;
 
-    // TODO: We rotate/flip image at the first stage for the simple design.
-    //       It is efficient unless the destination size is smaller than source/4.
-    //       To tackle this unefficiency in extreme downscaling with rotation/flip,
-    //       we should introduce an improved design to defer roation/flip until the
-    //       last stage of downscaling.
-    Task task(source, target, mBufferStore[src_buf_idx], mBufferStore[dst_buf_idx], mTransform);
+    Task task(source, target, mBufferStore[src_buf_idx], mBufferStore[dst_buf_idx], transform);
 
     do {
         if (task_count >= count)
@@ -268,8 +376,6 @@ int GiantMsclImpl::generateTask(const Image &source, const Image &target,
         task.fill(tasks[task_count++]);
     } while (task.next());
 
-    mTransform = 0;
-
     return task_count;
 }
 
@@ -2,11 +2,14 @@
 #define _GIANT_MSCL_IMPL_H_
 
 #include <cinttypes>
+#include <future>
 #include <vector>
 #include <tuple>
 
 #include <system/graphics.h>
 
+#include <hardware/exynos/giant_mscl.h>
+
 #include "uapi.h"
 #include "buffer.h"
 
@@ -20,7 +23,12 @@ public:
     bool setSrc(unsigned int srcw, unsigned int srch, unsigned int fmt, unsigned int transform = 0);
     bool setDst(unsigned int dstw, unsigned int dsth, unsigned int fmt);
     bool run(int src_buffer[], int dst_buffer[]);
+    bool runAsync(int src_buffer[], int dst_buffer[]);
+    bool wait();
     bool available() { return !(mFdDev < 0); }
+    void setBufferPoolLimit(size_t limit) { mBufferPool.setLimit(limit); }
+    void trimBufferPool() { mBufferPool.trim(); }
+    const GiantMscl::JobInfo &getJobInfo() { return mJobInfo; }
 
 private:
     using Image = std::tuple<unsigned int, unsigned int, unsigned int>;
@@ -36,9 +44,13 @@ private:
     static inline bool hFlip(unsigned int transform) { return (transform & HAL_TRANSFORM_FLIP_H) != 0; }
     static inline unsigned int makeEven(unsigned int val) { return (val + 1) & ~1; }
 
+    // Target images of the stages in the orientation of the destination.
+    std::vector<Image> planStages();
+    // Index of the stage that rotates and flips.
+    size_t pickTransformStage(const std::vector<Image> &stages);
     int generateTask(const Image &source, const Image &target,
                      unsigned int src_buf_idx, unsigned int dst_buf_idx,
-                     mscl_task tasks[], unsigned int count);
+                     unsigned int transform, mscl_task tasks[], unsigned int count);
 
     struct Task {
         const static uint32_t FRACTION_BITS = 20;
@@ -84,7 +96,14 @@ private:
         std::vector<TransformCoord> mDstPlaneCoord;
     };
 
+    // mBufferPool should be destroyed after mBufferStore
+    BufferPool mBufferPool;
     std::vector<Buffer> mBufferStore;
+    static const unsigned int MAX_TASKS = 6;
+    mscl_task mTasks[MAX_TASKS];
+    mscl_job mJob;
+    std::future<bool> mPendingJob;
+    GiantMscl::JobInfo mJobInfo = {};
     Image mSrcImage;
     Image mDstImage;
     unsigned int mTransform = 0;
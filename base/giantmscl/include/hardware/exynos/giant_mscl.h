@@ -1,6 +1,7 @@
 #ifndef _EXYNOS_GIANT_MSCL_H_
 #define _EXYNOS_GIANT_MSCL_H_
 
+#include <cstddef>
 #include <memory>
 
 class GiantMsclImpl;
@@ -13,6 +14,27 @@ public:
     bool setSrc(unsigned int srcw, unsigned int srch, unsigned int fmt, unsigned int transform = 0);
     bool setDst(unsigned int dstw, unsigned int dsth, unsigned int fmt);
     bool run(int src_buffer[], int dst_buffer[]);
+    // runAsync() returns after the job is submitted. wait() returns the result of
+    // the job submitted by runAsync() after it is completed. The buffers should
+    // not be accessed until wait() returns. Submitting a new job waits for the
+    // completion of the pending job.
+    bool runAsync(int src_buffer[], int dst_buffer[]);
+    bool wait();
+    // The bounce buffers for the jobs scaling more than once are kept for the next
+    // jobs up to @limit bytes. trimBufferPool() releases all of the kept buffers.
+    void setBufferPoolLimit(size_t limit);
+    void trimBufferPool();
+    // Description of the last job submitted by run() or runAsync(). Each stage
+    // scales and transforms the whole image once and it is split into one or
+    // more tasks of MSCL. bounce_bytes is the size of the intermediate buffers
+    // between the stages.
+    struct JobInfo {
+        static const unsigned int MAX_STAGES = 6;
+        unsigned int stage_count;
+        unsigned int task_count[MAX_STAGES];
+        size_t bounce_bytes;
+    };
+    bool getJobInfo(JobInfo &info);
     operator bool() { return okay(); }
     bool okay();
 private:
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <string>
@@ -41,6 +42,8 @@ struct Usage {
     void operator()() {
         std::cout << mProg << " -j <jobs_description.json>" << std::endl;
         std::cout << mProg << " -i [width]x[height]/[fmt]@[file] -o [width]x[height]/[fmt]@[file] [-t h|v|90|270|180|h90|h270]"  << std::endl;
+        std::cout << mProg << " -b <repeat>" << std::endl;
+        std::cout << " -b: sweeps sizes, ratios, formats and transforms and reports CSV" << std::endl;
         std::cout << " formats: nv12, nv12m, yuyv" << std::endl;
     }
     std::string mProg;
@@ -456,6 +459,112 @@ static int runWithJson(const char *json)
     return 0;
 }
 
+/* The sweep of the benchmark:
+ * - sources of 1080p, 4K and 8K
+ * - downscale ratios of 1, 2, 4, 8, 16 and 32 in both directions
+ * - NV12 and YUYV for both of the source and the destination
+ * - no transform, 90, 180, 270 degree rotations and horizontal flip
+ * A row of CSV is reported for each case. The tasks are the number of MSCL
+ * tasks of each stage separated by ':'. The elapsed time is the average of
+ * @repeat runs after a warm-up run that also fills the bounce buffer pool.
+ * The throughput is the source pixels processed per second.
+ */
+static int runBenchmark(unsigned int repeat)
+{
+    const unsigned int sizes[][2] = {{1920, 1080}, {3840, 2160}, {7680, 4320}};
+    const unsigned int ratios[] = {1, 2, 4, 8, 16, 32};
+    const unsigned int formats[] = {HAL_PIXEL_FORMAT_YCRCB_420_SP, HAL_PIXEL_FORMAT_YCBCR_422_I};
+    const unsigned int transforms[] = {0, HAL_TRANSFORM_ROT_90, HAL_TRANSFORM_ROT_180,
+                                       HAL_TRANSFORM_ROT_270, HAL_TRANSFORM_FLIP_H};
+
+    if (repeat == 0)
+        repeat = 1;
+
+    AutoFd ion(exynos_ion_open());
+    if (ion < 0)
+        return -1;
+
+    GiantMscl mscl;
+    if (!mscl)
+        return -1;
+
+    std::cout << "src_width,src_height,dst_width,dst_height,format,transform,"
+              << "stages,tasks,bounce_bytes,usec,mpix_per_sec,result" << std::endl;
+
+    unsigned int nr_fail = 0;
+
+    for (auto &size : sizes) {
+        for (auto fmt : formats) {
+            ImageQuad src = std::make_tuple(size[0], size[1], fmt, std::string());
+            unsigned int src_buf_len[2];
+            AutoFd2 srcbuf;
+
+            getBufferSize(src, src_buf_len, true);
+            for (unsigned int i = 0; i < 2; i++) {
+                if (src_buf_len[i] && ((srcbuf[i] = exynos_ion_alloc(ion, src_buf_len[i], 1, 0)) < 0)) {
+                    std::cerr << "failed to allocate " << src_buf_len[i] << " bytes from ION" << std::endl;
+                    return -1;
+                }
+            }
+
+            for (auto ratio : ratios) {
+                for (auto transform : transforms) {
+                    unsigned int dstw = (size[0] / ratio) & ~1;
+                    unsigned int dsth = (size[1] / ratio) & ~1;
+                    if (transform & HAL_TRANSFORM_ROT_90)
+                        std::swap(dstw, dsth);
+
+                    ImageQuad dst = std::make_tuple(dstw, dsth, fmt, std::string());
+                    unsigned int dst_buf_len[2];
+                    AutoFd2 dstbuf;
+
+                    getBufferSize(dst, dst_buf_len, true);
+                    for (unsigned int i = 0; i < 2; i++) {
+                        if (dst_buf_len[i] && ((dstbuf[i] = exynos_ion_alloc(ion, dst_buf_len[i], 1, 0)) < 0)) {
+                            std::cerr << "failed to allocate " << dst_buf_len[i] << " bytes from ION" << std::endl;
+                            return -1;
+                        }
+                    }
+
+                    int srcfds[2], dstfds[2];
+
+                    srcbuf.get(srcfds);
+                    dstbuf.get(dstfds);
+
+                    bool okay = mscl.setSrc(size[0], size[1], fmt, transform) &&
+                                mscl.setDst(dstw, dsth, fmt) && mscl.run(srcfds, dstfds);
+
+                    auto begin = std::chrono::steady_clock::now();
+                    for (unsigned int n = 0; okay && (n < repeat); n++)
+                        okay = mscl.run(srcfds, dstfds);
+                    auto end = std::chrono::steady_clock::now();
+
+                    GiantMscl::JobInfo info{};
+                    mscl.getJobInfo(info);
+
+                    double usec = std::chrono::duration<double, std::micro>(end - begin).count() / repeat;
+                    double mpix = okay ? (static_cast<double>(size[0]) * size[1]) / usec : 0;
+
+                    std::cout << size[0] << "," << size[1] << "," << dstw << "," << dsth << ","
+                              << formatName(fmt) << "," << (transform ? transformName(transform) : "0") << ","
+                              << info.stage_count << ",";
+                    for (unsigned int i = 0; i < info.stage_count; i++)
+                        std::cout << (i ? ":" : "") << info.task_count[i];
+                    std::cout << "," << info.bounce_bytes << ","
+                              << std::fixed << std::setprecision(1) << (okay ? usec : 0) << ","
+                              << std::setprecision(2) << mpix << "," << (okay ? "okay" : "fail") << std::endl;
+                    std::cout.unsetf(std::ios::floatfield);
+
+                    if (!okay)
+                        nr_fail++;
+                }
+            }
+        }
+    }
+
+    return (nr_fail == 0) ? 0 : -1;
+}
+
 int main(int argc, char *argv[])
 {
     Usage usage(argv[0]);
@@ -469,6 +578,8 @@ int main(int argc, char *argv[])
     for (int i = 1; i < argc; i += 2) {
         if (!strcmp(argv[i], "-j"))
             return runWithJson(argv[i + 1]);
+        if (!strcmp(argv[i], "-b"))
+            return runBenchmark(atoi(argv[i + 1]));
     }
 
     return runWithCommandLine(argc - 1, argv + 1, usage);
@@ -98,7 +98,7 @@ ndk::ScopedAStatus ComposerClient::executeCommands(const std::vector<DisplayComm
                                                    std::vector<CommandResultPayload>* results) {
     int64_t display = commands.empty() ? -1 : commands[0].display;
     DEBUG_DISPLAY_FUNC(display);
-    ComposerCommandEngine engine(mHal, mResources.get());
+    ComposerCommandEngine engine(mHal, mResources.get(), &mPresentWorkers);
 
     auto err = engine.init();
     if (err != ::android::NO_ERROR) {
@@ -409,15 +409,20 @@ ndk::ScopedAStatus ComposerClient::setIdleTimerEnabled(int64_t display, int32_t
     return TO_BINDER_STATUS(err);
 }
 
-ndk::ScopedAStatus ComposerClient::setRefreshRateChangedCallbackDebugEnabled(int64_t /* display */,
-                                                                             bool /* enabled */) {
-    // TODO(b/267825022) Add implementation for the HAL and pass appropriate binder status
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus ComposerClient::setRefreshRateChangedCallbackDebugEnabled(int64_t display,
+                                                                             bool enabled) {
+    DEBUG_DISPLAY_FUNC(display);
+    auto err = mHal->setRefreshRateChangedCallbackDebugEnabled(display, enabled);
+    return TO_BINDER_STATUS(err);
 }
 
 void ComposerClient::HalEventCallback::onRefreshRateChangedDebug(
-        const RefreshRateChangedDebugData&) {
-    // TODO(b/267825022) Add implementation for the HAL
+        const RefreshRateChangedDebugData& data) {
+    DEBUG_DISPLAY_FUNC(data.display);
+    auto ret = mCallback->onRefreshRateChangedDebug(data);
+    if (!ret.isOk()) {
+        LOG(ERROR) << "failed to send onRefreshRateChangedDebug:" << ret.getDescription();
+    }
 }
 
 void ComposerClient::HalEventCallback::onHotplug(int64_t display, bool connected) {
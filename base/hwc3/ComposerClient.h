@@ -141,6 +141,7 @@ private:
 
     IComposerHal* mHal;
     std::unique_ptr<IResourceManager> mResources;
+    PresentWorkers mPresentWorkers;
     std::function<void()> mOnClientDestroyed;
     std::unique_ptr<HalEventCallback> mHalEventCallback;
 };
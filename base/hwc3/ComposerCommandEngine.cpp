@@ -18,6 +18,10 @@
 
 #include <hardware/hwcomposer2.h>
 
+#include <algorithm>
+#include <iterator>
+#include <string>
+
 #include "Util.h"
 
 /// The command engine interface is not 'pure' aidl. Conversion to aidl
@@ -61,22 +65,96 @@ int32_t ComposerCommandEngine::init() {
     return (mWriter != nullptr) ? ::android::NO_ERROR : ::android::NO_MEMORY;
 }
 
+ExynosWorkerPool* PresentWorkers::get(int64_t display) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& worker = mWorkers[display];
+    if (!worker) {
+        worker = std::make_unique<ExynosWorkerPool>("hwc3_present_" + std::to_string(display), 1);
+    }
+    return worker.get();
+}
+
+ComposerCommandEngine* ComposerCommandEngine::getAsyncEngine(int64_t display) {
+    auto& engine = mAsyncEngines[display];
+    if (!engine) {
+        engine = std::make_unique<ComposerCommandEngine>(mHal, mResources);
+        if (engine->init() != ::android::NO_ERROR) {
+            engine.reset();
+            return nullptr;
+        }
+    }
+    return engine.get();
+}
+
 int32_t ComposerCommandEngine::execute(const std::vector<DisplayCommand>& commands,
                                        std::vector<CommandResultPayload>* result) {
+    // Commands of a multi-threaded display run on its present thread with their own writer,
+    // so that its present doesn't delay the commands of the other displays.
+    mActiveAsyncEngines.clear();
+    mActiveAsyncWorkers.clear();
+
     mCommandIndex = 0;
     for (const auto& command : commands) {
-        dispatchDisplayCommand(command);
+        ExynosWorkerPool* worker = (commands.size() > 1) ? getPresentWorker(command) : nullptr;
+        ComposerCommandEngine* asyncEngine = worker ? getAsyncEngine(command.display) : nullptr;
+
+        if (asyncEngine) {
+            if (std::find(mActiveAsyncEngines.begin(), mActiveAsyncEngines.end(), asyncEngine) ==
+                mActiveAsyncEngines.end()) {
+                asyncEngine->reset();
+                mActiveAsyncEngines.push_back(asyncEngine);
+            }
+            // Jobs of the same display are serialized on its worker
+            int32_t commandIndex = mCommandIndex;
+            worker->submit([asyncEngine, &command, commandIndex] {
+                asyncEngine->mCommandIndex = commandIndex;
+                asyncEngine->dispatchDisplayCommand(command);
+            });
+            if (std::find(mActiveAsyncWorkers.begin(), mActiveAsyncWorkers.end(), worker) ==
+                mActiveAsyncWorkers.end()) {
+                mActiveAsyncWorkers.push_back(worker);
+            }
+        } else {
+            dispatchDisplayCommand(command);
+        }
         ++mCommandIndex;
     }
 
+    for (auto worker : mActiveAsyncWorkers) {
+        worker->wait();
+    }
+
+    // Results are moved, not copied
     *result = mWriter->getPendingCommandResults();
+    for (auto engine : mActiveAsyncEngines) {
+        auto asyncResult = engine->mWriter->getPendingCommandResults();
+        result->reserve(result->size() + asyncResult.size());
+        result->insert(result->end(), std::make_move_iterator(asyncResult.begin()),
+                       std::make_move_iterator(asyncResult.end()));
+    }
     return 0;
 }
 
+ExynosWorkerPool* ComposerCommandEngine::getPresentWorker(const DisplayCommand& command) {
+    if (!mPresentWorkers || !(command.presentDisplay || command.presentOrValidateDisplay)) {
+        return nullptr;
+    }
+
+    bool support = false;
+    if (mHal->getDisplayMultiThreadedPresentSupport(command.display, support) != HWC2_ERROR_NONE ||
+        !support) {
+        return nullptr;
+    }
+    return mPresentWorkers->get(command.display);
+}
+
 void ComposerCommandEngine::dispatchDisplayCommand(const DisplayCommand& command) {
     for (const auto& layerCmd : command.layers) {
         dispatchLayerCommand(command.display, layerCmd);
     }
+    if (!command.layers.empty() && (command.validateDisplay || command.presentOrValidateDisplay)) {
+        mHal->prevalidateDisplay(command.display);
+    }
 
     DISPATCH_DISPLAY_COMMAND(command, colorTransformMatrix, SetColorTransform);
     DISPATCH_DISPLAY_COMMAND(command, clientTarget, SetClientTarget);
@@ -92,19 +170,9 @@ void ComposerCommandEngine::dispatchDisplayCommand(const DisplayCommand& command
 
 void ComposerCommandEngine::dispatchLayerCommand(int64_t display, const LayerCommand& command) {
     DISPATCH_LAYER_COMMAND(display, command, cursorPosition, CursorPosition);
-    DISPATCH_LAYER_COMMAND(display, command, buffer, Buffer);
-    DISPATCH_LAYER_COMMAND(display, command, damage, SurfaceDamage);
-    DISPATCH_LAYER_COMMAND(display, command, blendMode, BlendMode);
-    DISPATCH_LAYER_COMMAND(display, command, color, Color);
-    DISPATCH_LAYER_COMMAND(display, command, composition, Composition);
-    DISPATCH_LAYER_COMMAND(display, command, dataspace, Dataspace);
-    DISPATCH_LAYER_COMMAND(display, command, displayFrame, DisplayFrame);
-    DISPATCH_LAYER_COMMAND(display, command, planeAlpha, PlaneAlpha);
+    // Buffer, geometry and the other plain fields are applied at once
+    executeSetLayerState(display, command);
     DISPATCH_LAYER_COMMAND(display, command, sidebandStream, SidebandStream);
-    DISPATCH_LAYER_COMMAND(display, command, sourceCrop, SourceCrop);
-    DISPATCH_LAYER_COMMAND(display, command, transform, Transform);
-    DISPATCH_LAYER_COMMAND(display, command, visibleRegion, VisibleRegion);
-    DISPATCH_LAYER_COMMAND(display, command, z, ZOrder);
     DISPATCH_LAYER_COMMAND(display, command, colorTransform, ColorTransform);
     // TODO: (b/196171661) add support for mixed composition
     // DISPATCH_LAYER_COMMAND(display, command, whitePointNits, WhitePointNits);
@@ -113,20 +181,23 @@ void ComposerCommandEngine::dispatchLayerCommand(int64_t display, const LayerCom
 }
 
 int32_t ComposerCommandEngine::executeValidateDisplayInternal(int64_t display) {
-    std::vector<int64_t> changedLayers;
-    std::vector<Composition> compositionTypes;
+    auto& scratch = getScratch(display);
     uint32_t displayRequestMask = 0x0;
-    std::vector<int64_t> requestedLayers;
-    std::vector<int32_t> requestMasks;
     ClientTargetProperty clientTargetProperty{common::PixelFormat::RGBA_8888,
                                               common::Dataspace::UNKNOWN};
-    auto err = mHal->validateDisplay(display, &changedLayers, &compositionTypes,
-                                     &displayRequestMask, &requestedLayers, &requestMasks,
-                                     &clientTargetProperty);
+    scratch.changedLayers.clear();
+    scratch.compositionTypes.clear();
+    scratch.requestedLayers.clear();
+    scratch.requestMasks.clear();
+    auto err = mHal->validateDisplay(display, &scratch.changedLayers, &scratch.compositionTypes,
+                                     &displayRequestMask, &scratch.requestedLayers,
+                                     &scratch.requestMasks, &clientTargetProperty);
     mResources->setDisplayMustValidateState(display, false);
     if (err == HWC2_ERROR_NONE || err == HWC2_ERROR_HAS_CHANGES) {
-        mWriter->setChangedCompositionTypes(display, changedLayers, compositionTypes);
-        mWriter->setDisplayRequests(display, displayRequestMask, requestedLayers, requestMasks);
+        mWriter->setChangedCompositionTypes(display, scratch.changedLayers,
+                                            scratch.compositionTypes);
+        mWriter->setDisplayRequests(display, displayRequestMask, scratch.requestedLayers,
+                                    scratch.requestMasks);
     } else {
         LOG(ERROR) << __func__ << ": err " << err;
         mWriter->setError(mCommandIndex, err);
@@ -247,14 +318,16 @@ void ComposerCommandEngine::executeAcceptDisplayChanges(int64_t display) {
 }
 
 int ComposerCommandEngine::executePresentDisplay(int64_t display) {
+    auto& scratch = getScratch(display);
     ndk::ScopedFileDescriptor presentFence;
-    std::vector<int64_t> layers;
+    // Fences are moved into the result, so only the layer list can be reused
     std::vector<ndk::ScopedFileDescriptor> fences;
-    auto err = mHal->presentDisplay(display, presentFence, &layers, &fences);
+    scratch.releasedLayers.clear();
+    auto err = mHal->presentDisplay(display, presentFence, &scratch.releasedLayers, &fences);
     if (!err) {
         if (presentFence != ndk::ScopedFileDescriptor(-1))
             mWriter->setPresentFence(display, std::move(presentFence));
-        mWriter->setReleaseFences(display, layers, std::move(fences));
+        mWriter->setReleaseFences(display, scratch.releasedLayers, std::move(fences));
     }
     return err;
 }
@@ -268,85 +341,27 @@ void ComposerCommandEngine::executeSetLayerCursorPosition(int64_t display, int64
     }
 }
 
-void ComposerCommandEngine::executeSetLayerBuffer(int64_t display, int64_t layer,
-                                                  const Buffer& buffer) {
-    bool useCache = !buffer.handle;
-    buffer_handle_t handle = useCache
-                             ? nullptr
-                             : ::android::makeFromAidl(*buffer.handle);
+void ComposerCommandEngine::executeSetLayerState(int64_t display, const LayerCommand& command) {
+    const buffer_handle_t* buffer = nullptr;
     buffer_handle_t hwcBuffer;
     auto bufferReleaser = mResources->createReleaser(true);
-    auto err = mResources->getLayerBuffer(display, layer, buffer.slot, useCache,
-                                          handle, hwcBuffer, bufferReleaser.get());
-    if (!err) {
-        err = mHal->setLayerBuffer(display, layer, hwcBuffer, buffer.fence);
-        if (err) {
-            LOG(ERROR) << __func__ << ": setLayerBuffer err " << err;
+    if (command.buffer) {
+        bool useCache = !command.buffer->handle;
+        buffer_handle_t handle = useCache
+                                 ? nullptr
+                                 : ::android::makeFromAidl(*command.buffer->handle);
+        auto err = mResources->getLayerBuffer(display, command.layer, command.buffer->slot,
+                                              useCache, handle, hwcBuffer,
+                                              bufferReleaser.get());
+        if (!err) {
+            buffer = &hwcBuffer;
+        } else {
+            LOG(ERROR) << __func__ << ": getLayerBuffer err " << err;
             mWriter->setError(mCommandIndex, err);
         }
-    } else {
-        LOG(ERROR) << __func__ << ": getLayerBuffer err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerSurfaceDamage(int64_t display, int64_t layer,
-                              const std::vector<std::optional<common::Rect>>& damage) {
-    auto err = mHal->setLayerSurfaceDamage(display, layer, damage);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerBlendMode(int64_t display, int64_t layer,
-                                                     const ParcelableBlendMode& blendMode) {
-    auto err = mHal->setLayerBlendMode(display, layer, blendMode.blendMode);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerColor(int64_t display, int64_t layer,
-                                                 const Color& color) {
-    auto err = mHal->setLayerColor(display, layer, color);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerComposition(int64_t display, int64_t layer,
-                                                       const ParcelableComposition& composition) {
-    auto err = mHal->setLayerCompositionType(display, layer, composition.composition);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerDataspace(int64_t display, int64_t layer,
-                                                     const ParcelableDataspace& dataspace) {
-    auto err = mHal->setLayerDataspace(display, layer, dataspace.dataspace);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
     }
-}
 
-void ComposerCommandEngine::executeSetLayerDisplayFrame(int64_t display, int64_t layer,
-                                                        const common::Rect& rect) {
-    auto err = mHal->setLayerDisplayFrame(display, layer, rect);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerPlaneAlpha(int64_t display, int64_t layer,
-                                                      const PlaneAlpha& planeAlpha) {
-    auto err = mHal->setLayerPlaneAlpha(display, layer, planeAlpha.alpha);
+    auto err = mHal->setLayerState(display, command, buffer);
     if (err) {
         LOG(ERROR) << __func__ << ": err " << err;
         mWriter->setError(mCommandIndex, err);
@@ -370,42 +385,6 @@ void ComposerCommandEngine::executeSetLayerSidebandStream(int64_t display, int64
     }
 }
 
-void ComposerCommandEngine::executeSetLayerSourceCrop(int64_t display, int64_t layer,
-                                                      const common::FRect& sourceCrop) {
-    auto err = mHal->setLayerSourceCrop(display, layer, sourceCrop);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerTransform(int64_t display, int64_t layer,
-                                                     const ParcelableTransform& transform) {
-    auto err = mHal->setLayerTransform(display, layer, transform.transform);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerVisibleRegion(int64_t display, int64_t layer,
-                          const std::vector<std::optional<common::Rect>>& visibleRegion) {
-    auto err = mHal->setLayerVisibleRegion(display, layer, visibleRegion);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerZOrder(int64_t display, int64_t layer,
-                                                  const ZOrder& zOrder) {
-    auto err = mHal->setLayerZOrder(display, layer, zOrder.z);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
 void ComposerCommandEngine::executeSetLayerPerFrameMetadata(int64_t display, int64_t layer,
                 const std::vector<std::optional<PerFrameMetadata>>& perFrameMetadata) {
     auto err = mHal->setLayerPerFrameMetadata(display, layer, perFrameMetadata);
@@ -19,16 +19,31 @@
 #include <android/hardware/graphics/composer3/ComposerServiceWriter.h>
 
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
+#include "ExynosWorkerPool.h"
 #include "include/IComposerHal.h"
 #include "include/IResourceManager.h"
 
 namespace aidl::android::hardware::graphics::composer3::impl {
 
+// Dedicated present threads of displays that support multi-threaded present.
+// They are owned by the client and shared by its command engines.
+class PresentWorkers {
+  public:
+      ExynosWorkerPool* get(int64_t display);
+
+  private:
+      std::mutex mMutex;
+      std::unordered_map<int64_t, std::unique_ptr<ExynosWorkerPool>> mWorkers;
+};
+
 class ComposerCommandEngine {
   public:
-      ComposerCommandEngine(IComposerHal* hal, IResourceManager* resources)
-            : mHal(hal), mResources(resources) {}
+      ComposerCommandEngine(IComposerHal* hal, IResourceManager* resources,
+                            PresentWorkers* presentWorkers = nullptr)
+            : mHal(hal), mResources(resources), mPresentWorkers(presentWorkers) {}
       int32_t init();
 
       int32_t execute(const std::vector<DisplayCommand>& commands,
@@ -40,6 +55,7 @@ class ComposerCommandEngine {
 
   private:
       void dispatchDisplayCommand(const DisplayCommand& displayCommand);
+      ExynosWorkerPool* getPresentWorker(const DisplayCommand& displayCommand);
       void dispatchLayerCommand(int64_t display, const LayerCommand& displayCommand);
 
       void executeSetColorTransform(int64_t display, const std::vector<float>& matrix);
@@ -55,28 +71,9 @@ class ComposerCommandEngine {
 
       void executeSetLayerCursorPosition(int64_t display, int64_t layer,
                                          const common::Point& cursorPosition);
-      void executeSetLayerBuffer(int64_t display, int64_t layer, const Buffer& buffer);
-      void executeSetLayerSurfaceDamage(int64_t display, int64_t layer,
-                                        const std::vector<std::optional<common::Rect>>& damage);
-      void executeSetLayerBlendMode(int64_t display, int64_t layer,
-                                    const ParcelableBlendMode& blendMode);
-      void executeSetLayerColor(int64_t display, int64_t layer, const Color& color);
-      void executeSetLayerComposition(int64_t display, int64_t layer,
-                                      const ParcelableComposition& composition);
-      void executeSetLayerDataspace(int64_t display, int64_t layer,
-                                    const ParcelableDataspace& dataspace);
-      void executeSetLayerDisplayFrame(int64_t display, int64_t layer, const common::Rect& rect);
-      void executeSetLayerPlaneAlpha(int64_t display, int64_t layer, const PlaneAlpha& planeAlpha);
+      void executeSetLayerState(int64_t display, const LayerCommand& command);
       void executeSetLayerSidebandStream(int64_t display, int64_t layer,
                                          const AidlNativeHandle& sidebandStream);
-      void executeSetLayerSourceCrop(int64_t display, int64_t layer,
-                                     const common::FRect& sourceCrop);
-      void executeSetLayerTransform(int64_t display, int64_t layer,
-                                    const ParcelableTransform& transform);
-      void executeSetLayerVisibleRegion(
-              int64_t display, int64_t layer,
-              const std::vector<std::optional<common::Rect>>& visibleRegion);
-      void executeSetLayerZOrder(int64_t display, int64_t layer, const ZOrder& zOrder);
       void executeSetLayerPerFrameMetadata(
               int64_t display, int64_t layer,
               const std::vector<std::optional<PerFrameMetadata>>& perFrameMetadata);
@@ -89,11 +86,28 @@ class ComposerCommandEngine {
       int32_t executeValidateDisplayInternal(int64_t display);
       void executeSetExpectedPresentTimeInternal(
               int64_t display, const std::optional<ClockMonotonicTimestamp> expectedPresentTime);
+      ComposerCommandEngine* getAsyncEngine(int64_t display);
+
+      // Output storage of HAL calls, kept across frames so that their capacity is reused
+      struct DisplayScratch {
+          std::vector<int64_t> changedLayers;
+          std::vector<Composition> compositionTypes;
+          std::vector<int64_t> requestedLayers;
+          std::vector<int32_t> requestMasks;
+          std::vector<int64_t> releasedLayers;
+      };
+      DisplayScratch& getScratch(int64_t display) { return mDisplayScratch[display]; }
 
       IComposerHal* mHal;
       IResourceManager* mResources;
+      PresentWorkers* mPresentWorkers;
       std::unique_ptr<ComposerServiceWriter> mWriter;
       int32_t mCommandIndex;
+      std::unordered_map<int64_t, DisplayScratch> mDisplayScratch;
+      // Engines for commands of multi-threaded present displays, reused across frames
+      std::unordered_map<int64_t, std::unique_ptr<ComposerCommandEngine>> mAsyncEngines;
+      std::vector<ComposerCommandEngine*> mActiveAsyncEngines;
+      std::vector<ExynosWorkerPool*> mActiveAsyncWorkers;
 };
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
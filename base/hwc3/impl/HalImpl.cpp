@@ -96,6 +96,16 @@ void seamlessPossible(hwc2_callback_data_t callbackData, hwc2_display_t hwcDispl
     hal->getEventCallback()->onSeamlessPossible(display);
 }
 
+void refreshRateChangedDebug(hwc2_callback_data_t callbackData, hwc2_display_t hwcDisplay,
+                             hwc2_vsync_period_t hwcVsyncPeriodNanos) {
+    auto hal = static_cast<HalImpl*>(callbackData);
+    RefreshRateChangedDebugData data;
+
+    h2a::translate(hwcDisplay, data.display);
+    h2a::translate(hwcVsyncPeriodNanos, data.vsyncPeriodNanos);
+    hal->getEventCallback()->onRefreshRateChangedDebug(data);
+}
+
 } // nampesapce hook
 
 HalImpl::HalImpl(std::unique_ptr<ExynosDevice> device) : mDevice(std::move(device)) {
@@ -142,6 +152,11 @@ int32_t HalImpl::getHalDisplay(int64_t display, ExynosDisplay*& halDisplay) {
 
 int32_t HalImpl::getHalLayer(int64_t display, int64_t layer, ExynosLayer*& halLayer) {
     ExynosDisplay* halDisplay;
+    return getHalLayer(display, layer, halDisplay, halLayer);
+}
+
+int32_t HalImpl::getHalLayer(int64_t display, int64_t layer, ExynosDisplay*& halDisplay,
+                             ExynosLayer*& halLayer) {
     RET_IF_ERR(getHalDisplay(display, halDisplay));
 
     hwc2_layer_t hwcLayer;
@@ -184,6 +199,10 @@ void HalImpl::registerEventCallback(EventCallback* callback) {
                      reinterpret_cast<hwc2_function_pointer_t>(hook::vsyncPeriodTimingChanged));
     mDevice->registerCallback(HWC2_CALLBACK_SEAMLESS_POSSIBLE, this,
                      reinterpret_cast<hwc2_function_pointer_t>(hook::seamlessPossible));
+    mDevice->registerCallback(HWC2_CALLBACK_REFRESH_RATE_CHANGED_DEBUG, this,
+                     reinterpret_cast<hwc2_function_pointer_t>(hook::refreshRateChangedDebug));
+    mDevice->registerCallback(HWC2_CALLBACK_VSYNC_IDLE, this,
+                     reinterpret_cast<hwc2_function_pointer_t>(hook::vsyncIdle));
 }
 
 void HalImpl::unregisterEventCallback() {
@@ -192,6 +211,8 @@ void HalImpl::unregisterEventCallback() {
     mDevice->registerCallback(HWC2_CALLBACK_VSYNC_2_4, this, nullptr);
     mDevice->registerCallback(HWC2_CALLBACK_VSYNC_PERIOD_TIMING_CHANGED, this, nullptr);
     mDevice->registerCallback(HWC2_CALLBACK_SEAMLESS_POSSIBLE, this, nullptr);
+    mDevice->registerCallback(HWC2_CALLBACK_REFRESH_RATE_CHANGED_DEBUG, this, nullptr);
+    mDevice->registerCallback(HWC2_CALLBACK_VSYNC_IDLE, this, nullptr);
 
     mEventCallback = nullptr;
 }
@@ -324,6 +345,8 @@ int32_t HalImpl::getDisplayCapabilities(int64_t display,
     RET_IF_ERR(halDisplay->getDisplayCapabilities(&count, hwcCaps.data()));
 
     h2a::translate(hwcCaps, *caps);
+    if (halDisplay->isIdleTimerSupported())
+        caps->push_back(DisplayCapability::DISPLAY_IDLE_TIMER);
     return HWC2_ERROR_NONE;
 }
 
@@ -391,17 +414,49 @@ int32_t HalImpl::getDisplayVsyncPeriod(int64_t display, int32_t* outVsyncPeriod)
     return HWC2_ERROR_NONE;
 }
 
-int32_t HalImpl::getDisplayedContentSample([[maybe_unused]] int64_t display,
-                                           [[maybe_unused]] int64_t maxFrames,
-                                           [[maybe_unused]] int64_t timestamp,
-                                           [[maybe_unused]] DisplayContentSample* samples) {
-    return HWC2_ERROR_UNSUPPORTED;
+int32_t HalImpl::getDisplayedContentSample(int64_t display, int64_t maxFrames, int64_t timestamp,
+                                           DisplayContentSample* samples) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
+
+    uint64_t frameCount = 0;
+    int32_t samplesSize[4] = {};
+    RET_IF_ERR(halDisplay->getDisplayedContentSample(maxFrames, timestamp, &frameCount,
+                                                     samplesSize, nullptr));
+
+    std::vector<uint64_t> hwcSamples[4];
+    uint64_t* hwcSamplesPtr[4];
+    for (int i = 0; i < 4; i++) {
+        hwcSamples[i].resize(samplesSize[i]);
+        hwcSamplesPtr[i] = samplesSize[i] ? hwcSamples[i].data() : nullptr;
+    }
+    RET_IF_ERR(halDisplay->getDisplayedContentSample(maxFrames, timestamp, &frameCount,
+                                                     samplesSize, hwcSamplesPtr));
+
+    samples->frameCount = frameCount;
+    std::vector<int64_t>* components[4] = {&samples->sampleComponent0, &samples->sampleComponent1,
+                                           &samples->sampleComponent2, &samples->sampleComponent3};
+    for (int i = 0; i < 4; i++) {
+        components[i]->assign(hwcSamples[i].begin(), hwcSamples[i].end());
+    }
+    return HWC2_ERROR_NONE;
 }
 
-int32_t HalImpl::getDisplayedContentSamplingAttributes(
-        [[maybe_unused]] int64_t display,
-        [[maybe_unused]] DisplayContentSamplingAttributes* attrs) {
-    return HWC2_ERROR_UNSUPPORTED;
+int32_t HalImpl::getDisplayedContentSamplingAttributes(int64_t display,
+                                                       DisplayContentSamplingAttributes* attrs) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
+
+    int32_t format = -1;
+    int32_t dataspace = -1;
+    uint8_t componentMask = 0;
+    RET_IF_ERR(halDisplay->getDisplayedContentSamplingAttributes(&format, &dataspace,
+                                                                 &componentMask));
+
+    h2a::translate(format, attrs->format);
+    h2a::translate(dataspace, attrs->dataspace);
+    attrs->componentMask = static_cast<FormatColorComponent>(componentMask);
+    return HWC2_ERROR_NONE;
 }
 
 int32_t HalImpl::getDisplayPhysicalOrientation([[maybe_unused]] int64_t display,
@@ -543,8 +598,11 @@ int32_t HalImpl::presentDisplay(int64_t display, ndk::ScopedFileDescriptor& fenc
     uint32_t count = 0;
     RET_IF_ERR(halDisplay->getReleaseFences(&count, nullptr, nullptr));
 
-    std::vector<hwc2_layer_t> hwcLayers(count);
-    std::vector<int32_t> hwcFences(count);
+    // Present of each display can run on its own thread
+    thread_local std::vector<hwc2_layer_t> hwcLayers;
+    thread_local std::vector<int32_t> hwcFences;
+    hwcLayers.resize(count);
+    hwcFences.resize(count);
     RET_IF_ERR(halDisplay->getReleaseFences(&count, hwcLayers.data(), hwcFences.data()));
 
     h2a::translate(hwcLayers, *outLayers);
@@ -695,21 +753,25 @@ int32_t HalImpl::setDisplayBrightness(int64_t display, float brightness) {
     return halDisplay->setDisplayBrightness(brightness);
 }
 
-int32_t HalImpl::setDisplayedContentSamplingEnabled(
-        [[maybe_unused]] int64_t display,
-        [[maybe_unused]] bool enable,
-        [[maybe_unused]] FormatColorComponent componentMask,
-        [[maybe_unused]] int64_t maxFrames) {
-    return HWC2_ERROR_UNSUPPORTED;
+int32_t HalImpl::setDisplayedContentSamplingEnabled(int64_t display, bool enable,
+                                                    FormatColorComponent componentMask,
+                                                    int64_t maxFrames) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
+
+    return halDisplay->setDisplayedContentSamplingEnabled(
+            enable ? HWC2_DISPLAYED_CONTENT_SAMPLING_ENABLE : HWC2_DISPLAYED_CONTENT_SAMPLING_DISABLE,
+            static_cast<uint8_t>(componentMask), maxFrames);
 }
 
 int32_t HalImpl::setLayerBlendMode(int64_t display, int64_t layer, common::BlendMode mode) {
+    ExynosDisplay *halDisplay;
     ExynosLayer *halLayer;
-    RET_IF_ERR(getHalLayer(display, layer, halLayer));
+    RET_IF_ERR(getHalLayer(display, layer, halDisplay, halLayer));
 
     int32_t hwcMode;
     a2h::translate(mode, hwcMode);
-    return mDevice->setLayerBlendMode(halLayer, hwcMode);
+    return mDevice->setLayerBlendMode(halDisplay, halLayer, hwcMode);
 }
 
 int32_t HalImpl::setLayerBuffer(int64_t display, int64_t layer, buffer_handle_t buffer,
@@ -744,12 +806,13 @@ int32_t HalImpl::setLayerColorTransform(int64_t display, int64_t layer,
 }
 
 int32_t HalImpl::setLayerCompositionType(int64_t display, int64_t layer, Composition type) {
+    ExynosDisplay *halDisplay;
     ExynosLayer *halLayer;
-    RET_IF_ERR(getHalLayer(display, layer, halLayer));
+    RET_IF_ERR(getHalLayer(display, layer, halDisplay, halLayer));
 
     int32_t hwcType;
     a2h::translate(type, hwcType);
-    return mDevice->setLayerCompositionType(halLayer, hwcType);
+    return mDevice->setLayerCompositionType(halDisplay, halLayer, hwcType);
 }
 
 int32_t HalImpl::setLayerCursorPosition(int64_t display, int64_t __unused layer, int32_t x, int32_t y) {
@@ -772,12 +835,13 @@ int32_t HalImpl::setLayerDataspace(int64_t display, int64_t layer, common::Datas
 }
 
 int32_t HalImpl::setLayerDisplayFrame(int64_t display, int64_t layer, const common::Rect& frame) {
+    ExynosDisplay *halDisplay;
     ExynosLayer *halLayer;
-    RET_IF_ERR(getHalLayer(display, layer, halLayer));
+    RET_IF_ERR(getHalLayer(display, layer, halDisplay, halLayer));
 
     hwc_rect_t hwcFrame;
     a2h::translate(frame, hwcFrame);
-    return mDevice->setLayerDisplayFrame(halLayer, hwcFrame);
+    return mDevice->setLayerDisplayFrame(halDisplay, halLayer, hwcFrame);
 }
 
 int32_t HalImpl::setLayerPerFrameMetadata(int64_t display, int64_t layer,
@@ -839,12 +903,13 @@ int32_t HalImpl::setLayerSidebandStream([[maybe_unused]] int64_t display,
 }
 
 int32_t HalImpl::setLayerSourceCrop(int64_t display, int64_t layer, const common::FRect& crop) {
+    ExynosDisplay *halDisplay;
     ExynosLayer *halLayer;
-    RET_IF_ERR(getHalLayer(display, layer, halLayer));
+    RET_IF_ERR(getHalLayer(display, layer, halDisplay, halLayer));
 
     hwc_frect_t hwcCrop;
     a2h::translate(crop, hwcCrop);
-    return mDevice->setLayerSourceCrop(halLayer, hwcCrop);
+    return mDevice->setLayerSourceCrop(halDisplay, halLayer, hwcCrop);
 }
 
 int32_t HalImpl::setLayerSurfaceDamage(int64_t display, int64_t layer,
@@ -860,13 +925,14 @@ int32_t HalImpl::setLayerSurfaceDamage(int64_t display, int64_t layer,
 }
 
 int32_t HalImpl::setLayerTransform(int64_t display, int64_t layer, common::Transform transform) {
+    ExynosDisplay *halDisplay;
     ExynosLayer *halLayer;
-    RET_IF_ERR(getHalLayer(display, layer, halLayer));
+    RET_IF_ERR(getHalLayer(display, layer, halDisplay, halLayer));
 
     int32_t hwcTransform;
     a2h::translate(transform, hwcTransform);
 
-    return mDevice->setLayerTransform(halLayer, hwcTransform);
+    return mDevice->setLayerTransform(halDisplay, halLayer, hwcTransform);
 }
 
 int32_t HalImpl::setLayerVisibleRegion(int64_t display, int64_t layer,
@@ -882,10 +948,106 @@ int32_t HalImpl::setLayerVisibleRegion(int64_t display, int64_t layer,
 }
 
 int32_t HalImpl::setLayerZOrder(int64_t display, int64_t layer, uint32_t z) {
+    ExynosDisplay *halDisplay;
     ExynosLayer *halLayer;
-    RET_IF_ERR(getHalLayer(display, layer, halLayer));
+    RET_IF_ERR(getHalLayer(display, layer, halDisplay, halLayer));
+
+    return mDevice->setLayerZOrder(halDisplay, halLayer, z);
+}
+
+int32_t HalImpl::setLayerState(int64_t display, const LayerCommand& command,
+                               const buffer_handle_t* buffer) {
+    exynos_layer_state_t state;
+    bool hasChange = false;
+
+    if (buffer) {
+        state.buffer = *buffer;
+        a2h::translate(command.buffer->fence, state.acquireFence);
+        hasChange = true;
+    }
+    if (command.damage) {
+        state.surfaceDamage.emplace();
+        a2h::translate(*command.damage, *state.surfaceDamage);
+        hasChange = true;
+    }
+    if (command.blendMode) {
+        int32_t hwcMode;
+        a2h::translate(command.blendMode->blendMode, hwcMode);
+        state.blendMode = hwcMode;
+        hasChange = true;
+    }
+    if (command.color) {
+        hwc_color_t hwcColor;
+        a2h::translate(*command.color, hwcColor);
+        state.color = hwcColor;
+        hasChange = true;
+    }
+    if (command.composition) {
+        int32_t hwcType;
+        a2h::translate(command.composition->composition, hwcType);
+        state.compositionType = hwcType;
+        hasChange = true;
+    }
+    if (command.dataspace) {
+        int32_t hwcDataspace;
+        a2h::translate(command.dataspace->dataspace, hwcDataspace);
+        state.dataspace = hwcDataspace;
+        hasChange = true;
+    }
+    if (command.displayFrame) {
+        hwc_rect_t hwcFrame;
+        a2h::translate(*command.displayFrame, hwcFrame);
+        state.displayFrame = hwcFrame;
+        hasChange = true;
+    }
+    if (command.planeAlpha) {
+        state.planeAlpha = command.planeAlpha->alpha;
+        hasChange = true;
+    }
+    if (command.sourceCrop) {
+        hwc_frect_t hwcCrop;
+        a2h::translate(*command.sourceCrop, hwcCrop);
+        state.sourceCrop = hwcCrop;
+        hasChange = true;
+    }
+    if (command.transform) {
+        int32_t hwcTransform;
+        a2h::translate(command.transform->transform, hwcTransform);
+        state.transform = hwcTransform;
+        hasChange = true;
+    }
+    if (command.visibleRegion) {
+        state.visibleRegion.emplace();
+        a2h::translate(*command.visibleRegion, *state.visibleRegion);
+        hasChange = true;
+    }
+    if (command.z) {
+        state.zOrder = command.z->z;
+        hasChange = true;
+    }
+
+    if (!hasChange)
+        return HWC2_ERROR_NONE;
+
+    ExynosDisplay* halDisplay;
+    auto err = getHalDisplay(display, halDisplay);
+    ExynosLayer *halLayer = nullptr;
+    if (err == HWC2_ERROR_NONE) {
+        hwc2_layer_t hwcLayer;
+        a2h::translate(command.layer, hwcLayer);
+        halLayer = halDisplay->checkLayer(hwcLayer);
+        if (!halLayer) { [[unlikely]]
+            err = HWC2_ERROR_BAD_LAYER;
+        }
+    }
+    if (err != HWC2_ERROR_NONE) { [[unlikely]]
+        // acquireFence is owned by HWC once it is translated
+        if (state.acquireFence >= 0)
+            close(state.acquireFence);
+        return err;
+    }
 
-    return mDevice->setLayerZOrder(halLayer, z);
+    return mDevice->setLayerState(halDisplay, halLayer, state);
 }
 
 int32_t HalImpl::setOutputBuffer(int64_t display, buffer_handle_t buffer,
@@ -938,12 +1100,19 @@ int32_t HalImpl::setVsyncEnabled(int64_t display, bool enabled) {
     return halDisplay->setVsyncEnabled(hwcEnable);
 }
 
-int32_t HalImpl::setIdleTimerEnabled(int64_t display, int32_t __unused timeout) {
+int32_t HalImpl::setIdleTimerEnabled(int64_t display, int32_t timeout) {
     ExynosDisplay* halDisplay;
     RET_IF_ERR(getHalDisplay(display, halDisplay));
 
-    // TODO(b/198808492): implement setIdleTimerEnabled
-    return HWC2_ERROR_UNSUPPORTED;
+    return halDisplay->setIdleTimerEnabled(timeout);
+}
+
+int32_t HalImpl::prevalidateDisplay(int64_t display) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
+
+    mDevice->prevalidateDisplay(halDisplay);
+    return HWC2_ERROR_NONE;
 }
 
 int32_t HalImpl::validateDisplay(int64_t display, std::vector<int64_t>* outChangedLayers,
@@ -963,13 +1132,17 @@ int32_t HalImpl::validateDisplay(int64_t display, std::vector<int64_t>* outChang
         return err;
     }
 
-    std::vector<hwc2_layer_t> hwcChangedLayers(typesCount);
-    std::vector<int32_t> hwcCompositionTypes(typesCount);
+    // Validate of each display can run on its own thread
+    thread_local std::vector<hwc2_layer_t> hwcChangedLayers;
+    thread_local std::vector<int32_t> hwcCompositionTypes;
+    hwcChangedLayers.resize(typesCount);
+    hwcCompositionTypes.resize(typesCount);
     RET_IF_ERR(halDisplay->getChangedCompositionTypes(&typesCount, hwcChangedLayers.data(),
                                                       hwcCompositionTypes.data()));
 
     int32_t displayReqs;
-    std::vector<hwc2_layer_t> hwcRequestedLayers(reqsCount);
+    thread_local std::vector<hwc2_layer_t> hwcRequestedLayers;
+    hwcRequestedLayers.resize(reqsCount);
     outRequestMasks->resize(reqsCount);
     RET_IF_ERR(halDisplay->getDisplayRequests(&displayReqs, &reqsCount,
                                               hwcRequestedLayers.data(), outRequestMasks->data()));
@@ -988,9 +1161,13 @@ int32_t HalImpl::validateDisplay(int64_t display, std::vector<int64_t>* outChang
 }
 
 int HalImpl::setExpectedPresentTime(
-        int64_t __unused display, const std::optional<ClockMonotonicTimestamp> __unused expectedPresentTime) {
+        int64_t display, const std::optional<ClockMonotonicTimestamp> expectedPresentTime) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
 
-    return HWC2_ERROR_UNSUPPORTED;
+    halDisplay->setExpectedPresentTime(
+            expectedPresentTime ? expectedPresentTime->timestampNanos : 0);
+    return HWC2_ERROR_NONE;
 }
 
 int32_t HalImpl::getDisplayMultiThreadedPresentSupport(const int64_t& display, bool& outSupport) {
@@ -1000,10 +1177,11 @@ int32_t HalImpl::getDisplayMultiThreadedPresentSupport(const int64_t& display, b
     return halDisplay->getDisplayMultiThreadedPresentSupport(outSupport);
 }
 
-int32_t HalImpl::setRefreshRateChangedCallbackDebugEnabled(int64_t /* display*/,
-                                                           bool /* enabled */) {
-    // TODO(b/267825022) Add implementation for the HAL
-    return EX_UNSUPPORTED_OPERATION;
+int32_t HalImpl::setRefreshRateChangedCallbackDebugEnabled(int64_t display, bool enabled) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
+
+    return halDisplay->setRefreshRateChangedDebugEnabled(enabled);
 }
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
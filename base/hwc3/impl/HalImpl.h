@@ -131,6 +131,8 @@ class HalImpl : public IComposerHal {
     int32_t setLayerVisibleRegion(int64_t display, int64_t layer,
                           const std::vector<std::optional<common::Rect>>& visible) override;
     int32_t setLayerZOrder(int64_t display, int64_t layer, uint32_t z) override;
+    int32_t setLayerState(int64_t display, const LayerCommand& command,
+                          const buffer_handle_t* buffer) override;
     int32_t setOutputBuffer(int64_t display, buffer_handle_t buffer,
                             const ndk::ScopedFileDescriptor& releaseFence) override;
     int32_t setPowerMode(int64_t display, PowerMode mode) override;
@@ -140,6 +142,7 @@ class HalImpl : public IComposerHal {
     int32_t getDisplayMultiThreadedPresentSupport(const int64_t& display,
                                                   bool& outSupport) override;
     int32_t setIdleTimerEnabled(int64_t display, int32_t timeout) override;
+    int32_t prevalidateDisplay(int64_t display) override;
     int32_t validateDisplay(int64_t display, std::vector<int64_t>* outChangedLayers,
                             std::vector<Composition>* outCompositionTypes,
                             uint32_t* outDisplayRequestMask,
@@ -151,13 +154,14 @@ class HalImpl : public IComposerHal {
             const std::optional<ClockMonotonicTimestamp> expectedPresentTime) override;
 
     EventCallback* getEventCallback() { return mEventCallback; }
-    int32_t setRefreshRateChangedCallbackDebugEnabled(int64_t /* display */,
-                                                      bool /* enabled */) override;
+    int32_t setRefreshRateChangedCallbackDebugEnabled(int64_t display, bool enabled) override;
 
 private:
     void initCaps();
     int32_t getHalDisplay(int64_t display, ExynosDisplay*& halDisplay);
     int32_t getHalLayer(int64_t display, int64_t layer, ExynosLayer*& halLayer);
+    int32_t getHalLayer(int64_t display, int64_t layer, ExynosDisplay*& halDisplay,
+                        ExynosLayer*& halLayer);
 
     std::unique_ptr<ExynosDevice> mDevice;
     EventCallback* mEventCallback;
@@ -33,7 +33,72 @@ std::unique_ptr<IBufferReleaser> ResourceManager::createReleaser(bool isBuffer)
     return std::make_unique<BufferReleaser>(isBuffer);
 }
 
+std::shared_ptr<ResourceManager::LayerSlots> ResourceManager::findLayerSlots(int64_t display,
+                                                                           int64_t layer) {
+    auto displays = std::atomic_load(&mDisplaySlots);
+    auto displayIt = displays->find(display);
+    if (displayIt == displays->end()) {
+        return nullptr;
+    }
+
+    auto layers = std::atomic_load(&displayIt->second->layers);
+    auto layerIt = layers->find(layer);
+    if (layerIt == layers->end()) {
+        return nullptr;
+    }
+    return layerIt->second;
+}
+
+void ResourceManager::addLayerSlots(int64_t display, int64_t layer, uint32_t bufferCacheSize) {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    auto displays = std::atomic_load(&mDisplaySlots);
+    std::shared_ptr<DisplaySlots> displaySlots;
+
+    auto displayIt = displays->find(display);
+    if (displayIt == displays->end()) {
+        auto newDisplays = std::make_shared<DisplaySlotsMap>(*displays);
+        displaySlots = std::make_shared<DisplaySlots>();
+        newDisplays->emplace(display, displaySlots);
+        std::atomic_store(&mDisplaySlots, std::shared_ptr<const DisplaySlotsMap>(newDisplays));
+    } else {
+        displaySlots = displayIt->second;
+    }
+
+    auto newLayers = std::make_shared<LayerSlotsMap>(*std::atomic_load(&displaySlots->layers));
+    (*newLayers)[layer] = std::make_shared<LayerSlots>(bufferCacheSize);
+    std::atomic_store(&displaySlots->layers, std::shared_ptr<const LayerSlotsMap>(newLayers));
+}
+
+void ResourceManager::removeLayerSlots(int64_t display, int64_t layer) {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    auto displays = std::atomic_load(&mDisplaySlots);
+    auto displayIt = displays->find(display);
+    if (displayIt == displays->end()) {
+        return;
+    }
+
+    auto& displaySlots = displayIt->second;
+    auto newLayers = std::make_shared<LayerSlotsMap>(*std::atomic_load(&displaySlots->layers));
+    if (newLayers->erase(layer)) {
+        std::atomic_store(&displaySlots->layers, std::shared_ptr<const LayerSlotsMap>(newLayers));
+    }
+}
+
+void ResourceManager::removeDisplaySlots(int64_t display) {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    auto newDisplays = std::make_shared<DisplaySlotsMap>(*std::atomic_load(&mDisplaySlots));
+    if (newDisplays->erase(display)) {
+        std::atomic_store(&mDisplaySlots, std::shared_ptr<const DisplaySlotsMap>(newDisplays));
+    }
+}
+
+void ResourceManager::clearSlots() {
+    std::lock_guard<std::mutex> lock(mSlotMutex);
+    std::atomic_store(&mDisplaySlots, std::make_shared<const DisplaySlotsMap>());
+}
+
 void ResourceManager::clear(RemoveDisplay removeDisplay) {
+    clearSlots();
     mResources->clear([removeDisplay](Display hwcDisplay, bool isVirtual,
                                       const std::vector<Layer> hwcLayers) {
         int64_t display;
@@ -76,6 +141,9 @@ int32_t ResourceManager::addVirtualDisplay(int64_t display, uint32_t outputBuffe
 }
 
 int32_t ResourceManager::removeDisplay(int64_t display) {
+    // Unpublish cached handles before ComposerResources frees them
+    removeDisplaySlots(display);
+
     Display hwcDisplay;
     a2h::translate(display, hwcDisplay);
 
@@ -131,10 +199,16 @@ int32_t ResourceManager::addLayer(int64_t display, int64_t layer, uint32_t buffe
 
     int32_t err;
     h2a::translate(hwcErr, err);
+    if (!err) {
+        addLayerSlots(display, layer, bufferCacheSize);
+    }
     return err;
 }
 
 int32_t ResourceManager::removeLayer(int64_t display, int64_t layer) {
+    // Unpublish cached handles before ComposerResources frees them
+    removeLayerSlots(display, layer);
+
     Display hwcDisplay;
     Layer hwcLayer;
 
@@ -213,6 +287,15 @@ int32_t ResourceManager::getLayerBuffer(int64_t display, int64_t layer, uint32_t
                                         bool fromCache, const buffer_handle_t rawHandle,
                                         buffer_handle_t& outBufferHandle,
                                         IBufferReleaser* bufReleaser) {
+    auto slots = findLayerSlots(display, layer);
+    if (fromCache && slots && slot < slots->count) {
+        buffer_handle_t handle = slots->handles[slot].load(std::memory_order_acquire);
+        if (handle) {
+            outBufferHandle = handle;
+            return 0;
+        }
+    }
+
     Display hwcDisplay;
     a2h::translate(display, hwcDisplay);
 
@@ -226,6 +309,10 @@ int32_t ResourceManager::getLayerBuffer(int64_t display, int64_t layer, uint32_t
 
     int32_t err;
     h2a::translate(hwcErr, err);
+    // Replaced handle is released by bufReleaser after the command, publish the new one now
+    if (!err && slots && slot < slots->count) {
+        slots->handles[slot].store(outBufferHandle, std::memory_order_release);
+    }
     return err;
 }
 
@@ -18,6 +18,11 @@
 
 #include <composer-resources/2.2/ComposerResources.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "include/IResourceManager.h"
 
 using android::hardware::graphics::composer::V2_2::hal::ComposerResources;
@@ -73,7 +78,36 @@ class ResourceManager : public IResourceManager {
                                    buffer_handle_t& outStreamHandle,
                                    IBufferReleaser* bufReleaser) override;
   private:
+    // Mirror of imported layer buffers of ComposerResources, so that cached slot lookups on
+    // the command thread don't take the lock of ComposerResources. Slot arrays and layer maps
+    // are published by atomic shared_ptr stores and never modified after publish, except for
+    // the atomic slot entries. Writers are serialized by mSlotMutex.
+    struct LayerSlots {
+        LayerSlots(uint32_t size)
+              : count(size), handles(std::make_unique<std::atomic<buffer_handle_t>[]>(size)) {
+            for (uint32_t i = 0; i < count; i++) {
+                handles[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        const uint32_t count;
+        std::unique_ptr<std::atomic<buffer_handle_t>[]> handles;
+    };
+    using LayerSlotsMap = std::unordered_map<int64_t, std::shared_ptr<LayerSlots>>;
+    struct DisplaySlots {
+        std::shared_ptr<const LayerSlotsMap> layers = std::make_shared<const LayerSlotsMap>();
+    };
+    using DisplaySlotsMap = std::unordered_map<int64_t, std::shared_ptr<DisplaySlots>>;
+
+    std::shared_ptr<LayerSlots> findLayerSlots(int64_t display, int64_t layer);
+    void addLayerSlots(int64_t display, int64_t layer, uint32_t bufferCacheSize);
+    void removeLayerSlots(int64_t display, int64_t layer);
+    void removeDisplaySlots(int64_t display);
+    void clearSlots();
+
     std::unique_ptr<ComposerResources> mResources = ComposerResources::create();
+    std::mutex mSlotMutex;
+    std::shared_ptr<const DisplaySlotsMap> mDisplaySlots =
+            std::make_shared<const DisplaySlotsMap>();
 };
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
@@ -206,12 +206,20 @@ class IComposerHal {
     virtual int32_t setLayerVisibleRegion(int64_t display, int64_t layer,
                                  const std::vector<std::optional<common::Rect>>& visible) = 0;
     virtual int32_t setLayerZOrder(int64_t display, int64_t layer, uint32_t z) = 0;
+    // Buffer, damage, blend mode, color, composition, dataspace, display frame, plane alpha,
+    // source crop, transform, visible region and z order of the command are applied at once.
+    // buffer is the one resolved from command.buffer, nullptr if it should not be set.
+    virtual int32_t setLayerState(int64_t display, const LayerCommand& command,
+                                  const buffer_handle_t* buffer) = 0; // cmd
     virtual int32_t setOutputBuffer(int64_t display, buffer_handle_t buffer,
                                     const ndk::ScopedFileDescriptor& releaseFence) = 0;
     virtual int32_t setPowerMode(int64_t display, PowerMode mode) = 0;
     virtual int32_t setReadbackBuffer(int64_t display, buffer_handle_t buffer,
                                       const ndk::ScopedFileDescriptor& releaseFence) = 0;
     virtual int32_t setVsyncEnabled(int64_t display, bool enabled) = 0;
+    // The layer commands of the display in the batch are applied. The HAL may start the
+    // checks of the next validateDisplay() while the rest of the batch is executed.
+    virtual int32_t prevalidateDisplay(int64_t display) = 0;
     virtual int32_t validateDisplay(int64_t display, std::vector<int64_t>* outChangedLayers,
                                     std::vector<Composition>* outCompositionTypes,
                                     uint32_t* outDisplayRequestMask,
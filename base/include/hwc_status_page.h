@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HWC_STATUS_PAGE_H__
+#define __HWC_STATUS_PAGE_H__
+
+#include <atomic>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+
+/*
+ * HWC status page - read-only snapshot of the HWC state for the monitors
+ *
+ * The page is an ashmem region created by HWC and shared by
+ * IExynosHWCService::getStatusPage(). HWC rewrites the data at the end of
+ * each frame and the monitors poll it without the binder and the lock of
+ * the composition. The data is protected by a seqlock: @seq is odd while
+ * HWC writes it, and a copy is valid if @seq is even and unchanged across
+ * the copy. The fd given to the monitors cannot be mapped writable.
+ *
+ * The counters are accumulated since boot. The latency buckets have the
+ * bounds of kLatencyBucketBounds of ExynosLatencyStats.h in usec.
+ */
+#define HWC_STATUS_PAGE_MAGIC       0x48575354  /* "HWST" */
+#define HWC_STATUS_PAGE_VERSION     1
+
+#define HWC_STATUS_DISPLAY_MAX      4
+#define HWC_STATUS_MPP_MAX          32
+#define HWC_STATUS_NAME_MAX         16
+#define HWC_STATUS_CLIENT_REASON_MAX 16
+#define HWC_STATUS_REJECT_MAX       40
+#define HWC_STATUS_LATENCY_STAGE_MAX 8
+#define HWC_STATUS_LATENCY_BUCKET_MAX 20
+
+#define HWC_STATUS_READ_RETRY       16
+
+struct hwc_status_latency {
+    uint64_t count;
+    int64_t max_ns;
+    uint32_t buckets[HWC_STATUS_LATENCY_BUCKET_MAX];
+};
+
+struct hwc_status_display {
+    uint32_t id;
+    uint32_t type;
+    uint32_t power_mode;
+    uint32_t vsync_period;
+    uint64_t validated_frames;
+    uint64_t client_frames;
+    uint64_t presented_frames;
+    int64_t last_present_ns;
+    /* client composited layers by client_composition_reason */
+    uint64_t client_reasons[HWC_STATUS_CLIENT_REASON_MAX];
+    /* by hwc_latency_stage */
+    struct hwc_status_latency latency[HWC_STATUS_LATENCY_STAGE_MAX];
+};
+
+struct hwc_status_mpp {
+    char name[HWC_STATUS_NAME_MAX];
+    uint32_t physical_type;
+    uint32_t logical_type;
+    uint32_t assigned_state;
+    uint32_t assigned_display;
+    uint64_t assigned_frames;
+    uint64_t assigned_layers;
+    uint64_t processed_pixels;
+    /* rejections of isSupported() by error bit */
+    uint64_t rejects[HWC_STATUS_REJECT_MAX];
+};
+
+struct hwc_status_data {
+    int64_t update_ns;
+    uint64_t frames;
+    /* validate and present time of the displays of the latest frame */
+    int64_t frame_time_ns;
+    uint32_t display_num;
+    uint32_t mpp_num;
+    struct hwc_status_display displays[HWC_STATUS_DISPLAY_MAX];
+    struct hwc_status_mpp mpps[HWC_STATUS_MPP_MAX];
+};
+
+struct hwc_status_page {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    std::atomic<uint32_t> seq;
+    struct hwc_status_data data;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "seq of hwc_status_page should be lock free in shared memory");
+
+/* Creates a page in an ashmem region. The fd is stored to @fd. */
+static inline struct hwc_status_page *hwc_status_page_create(int *fd)
+{
+    *fd = ashmem_create_region("hwc_status_page", sizeof(struct hwc_status_page));
+    if (*fd < 0)
+        return NULL;
+
+    void *addr = mmap(NULL, sizeof(struct hwc_status_page), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, *fd, 0);
+    if (addr == MAP_FAILED) {
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+
+    /* The later mappings of the fd, those of the monitors, are read-only */
+    if (ashmem_set_prot_region(*fd, PROT_READ) < 0) {
+        munmap(addr, sizeof(struct hwc_status_page));
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+
+    /* ashmem is zero filled and zero is the initial state of seq */
+    struct hwc_status_page *page = (struct hwc_status_page *)addr;
+    page->size = sizeof(struct hwc_status_page);
+    page->version = HWC_STATUS_PAGE_VERSION;
+    page->magic = HWC_STATUS_PAGE_MAGIC;
+
+    return page;
+}
+
+/* Maps the page created by HWC. @fd can be closed after that. */
+static inline const struct hwc_status_page *hwc_status_page_map(int fd)
+{
+    void *addr = mmap(NULL, sizeof(struct hwc_status_page), PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return NULL;
+
+    const struct hwc_status_page *page = (const struct hwc_status_page *)addr;
+    if ((page->magic != HWC_STATUS_PAGE_MAGIC) || (page->version != HWC_STATUS_PAGE_VERSION) ||
+            (page->size != sizeof(struct hwc_status_page))) {
+        munmap(addr, sizeof(struct hwc_status_page));
+        return NULL;
+    }
+
+    return page;
+}
+
+static inline void hwc_status_page_unmap(const struct hwc_status_page *page)
+{
+    if (page)
+        munmap((void *)page, sizeof(struct hwc_status_page));
+}
+
+/* The writer is only HWC, the updates of the data are between begin and end */
+static inline void hwc_status_page_write_begin(struct hwc_status_page *page)
+{
+    page->seq.store(page->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+static inline void hwc_status_page_write_end(struct hwc_status_page *page)
+{
+    page->seq.store(page->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/*
+ * Copies the data of the page to @data. Returns false if every try of
+ * HWC_STATUS_READ_RETRY overlapped an update of HWC.
+ */
+static inline bool hwc_status_page_read(const struct hwc_status_page *page,
+                                        struct hwc_status_data *data)
+{
+    for (int i = 0; i < HWC_STATUS_READ_RETRY; i++) {
+        uint32_t seq = page->seq.load(std::memory_order_acquire);
+
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(data, &page->data, sizeof(*data));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (page->seq.load(std::memory_order_relaxed) == seq)
+            return true;
+    }
+
+    return false;
+}
+
+#endif /* __HWC_STATUS_PAGE_H__ */
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __WFD_LATENCY_TRACE_H__
+#define __WFD_LATENCY_TRACE_H__
+
+#include <atomic>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+
+/*
+ * WFD latency trace - timestamps of each frame through the WFD pipeline
+ *
+ * The ring is an ashmem region created by HWC and shared with the WFD engine
+ * by IExynosHWCService::getWFDLatencyRing(). The engine passes the fd to
+ * librepeater and libtsmux that map the same ring. HWC assigns an id to each
+ * frame of the virtual display and the later stages tag their records with
+ * the latest id of HWC. All times are CLOCK_MONOTONIC in nanoseconds, so the
+ * records of the processes are comparable.
+ *
+ * The repeater copies frames in the kernel. The copy and the encoding are
+ * recorded at dequeue from tsmux with the timestamps of the driver.
+ */
+enum wfd_latency_stage {
+    WFD_LATENCY_HWC_PRESENT = 0,        /* presentDisplay() of the virtual display */
+    WFD_LATENCY_HWC_COMMIT,             /* the frame is committed to the DPU */
+    WFD_LATENCY_REPEATER_COPY_START,
+    WFD_LATENCY_REPEATER_COPY_DONE,
+    WFD_LATENCY_ENCODER_START,
+    WFD_LATENCY_ENCODER_DONE,
+    WFD_LATENCY_TSMUX_DONE,
+    WFD_LATENCY_TSMUX_DEQUEUE,
+    WFD_LATENCY_STAGE_MAX
+};
+
+#define WFD_LATENCY_RING_MAGIC  0x57464454  /* "WFDT" */
+#define WFD_LATENCY_RING_SIZE   256
+
+struct wfd_latency_record {
+    /* index + 1 of the record in the ring, 0 while it is written */
+    std::atomic<uint32_t> seq;
+    uint32_t stage;
+    uint64_t frame_id;
+    int64_t time_ns;
+};
+
+struct wfd_latency_ring {
+    uint32_t magic;
+    uint32_t size;
+    std::atomic<uint64_t> frame_id;
+    std::atomic<uint32_t> head;
+    struct wfd_latency_record records[WFD_LATENCY_RING_SIZE];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "atomics of wfd_latency_ring should be lock free in shared memory");
+
+static inline int64_t wfd_latency_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline const char *wfd_latency_stage_name(uint32_t stage)
+{
+    static const char *names[WFD_LATENCY_STAGE_MAX] = {
+        "hwc_present", "hwc_commit", "repeater_copy_s", "repeater_copy_e",
+        "encoder_s", "encoder_e", "tsmux_done", "tsmux_dequeue",
+    };
+
+    return (stage < WFD_LATENCY_STAGE_MAX) ? names[stage] : "unknown";
+}
+
+/* Creates a ring in an ashmem region. The fd is stored to @fd. */
+static inline struct wfd_latency_ring *wfd_latency_ring_create(int *fd)
+{
+    *fd = ashmem_create_region("wfd_latency_trace", sizeof(struct wfd_latency_ring));
+    if (*fd < 0)
+        return NULL;
+
+    void *addr = mmap(NULL, sizeof(struct wfd_latency_ring), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, *fd, 0);
+    if (addr == MAP_FAILED) {
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+
+    /* ashmem is zero filled and zero is the initial state of the atomics */
+    struct wfd_latency_ring *ring = (struct wfd_latency_ring *)addr;
+    ring->size = WFD_LATENCY_RING_SIZE;
+    ring->magic = WFD_LATENCY_RING_MAGIC;
+
+    return ring;
+}
+
+/* Maps the ring created by another process. @fd can be closed after that. */
+static inline struct wfd_latency_ring *wfd_latency_ring_map(int fd)
+{
+    void *addr = mmap(NULL, sizeof(struct wfd_latency_ring), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return NULL;
+
+    struct wfd_latency_ring *ring = (struct wfd_latency_ring *)addr;
+    if ((ring->magic != WFD_LATENCY_RING_MAGIC) || (ring->size != WFD_LATENCY_RING_SIZE)) {
+        munmap(addr, sizeof(struct wfd_latency_ring));
+        return NULL;
+    }
+
+    return ring;
+}
+
+static inline void wfd_latency_ring_unmap(struct wfd_latency_ring *ring)
+{
+    if (ring)
+        munmap(ring, sizeof(struct wfd_latency_ring));
+}
+
+/* Assigns the id of a new frame. It is called by HWC. */
+static inline uint64_t wfd_latency_new_frame(struct wfd_latency_ring *ring)
+{
+    return ring ? ring->frame_id.fetch_add(1, std::memory_order_relaxed) + 1 : 0;
+}
+
+static inline void wfd_latency_trace_at(struct wfd_latency_ring *ring, uint64_t frame_id,
+                                        uint32_t stage, int64_t time_ns)
+{
+    if (!ring)
+        return;
+
+    uint32_t index = ring->head.fetch_add(1, std::memory_order_relaxed);
+    struct wfd_latency_record *record = &ring->records[index % WFD_LATENCY_RING_SIZE];
+
+    record->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record->stage = stage;
+    record->frame_id = frame_id;
+    record->time_ns = time_ns;
+    record->seq.store(index + 1, std::memory_order_release);
+}
+
+/* Records @stage of the latest frame of HWC at the current time */
+static inline void wfd_latency_trace(struct wfd_latency_ring *ring, uint32_t stage)
+{
+    if (ring)
+        wfd_latency_trace_at(ring, ring->frame_id.load(std::memory_order_relaxed),
+                             stage, wfd_latency_now());
+}
+
+/*
+ * Prints the records from the oldest with the delay from hwc_present of the
+ * same frame. Returns the length of the string in @buf.
+ */
+static inline size_t wfd_latency_ring_dump(struct wfd_latency_ring *ring, char *buf, size_t size)
+{
+    struct {
+        uint32_t stage;
+        uint64_t frame_id;
+        int64_t time_ns;
+    } snapshot[WFD_LATENCY_RING_SIZE];
+    size_t count = 0;
+    size_t len = 0;
+
+    if (!ring || (size == 0))
+        return 0;
+
+    buf[0] = '\0';
+
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    uint32_t first = (head > WFD_LATENCY_RING_SIZE) ? head - WFD_LATENCY_RING_SIZE : 0;
+
+    for (uint32_t index = first; index != head; index++) {
+        struct wfd_latency_record *record = &ring->records[index % WFD_LATENCY_RING_SIZE];
+
+        if (record->seq.load(std::memory_order_acquire) != index + 1)
+            continue;
+        snapshot[count].stage = record->stage;
+        snapshot[count].frame_id = record->frame_id;
+        snapshot[count].time_ns = record->time_ns;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        /* skip the record that is overwritten while it is read */
+        if (record->seq.load(std::memory_order_relaxed) == index + 1)
+            count++;
+    }
+
+    for (size_t i = 0; (i < count) && (len < size); i++) {
+        int64_t present_ns = -1;
+
+        for (size_t j = 0; j < count; j++) {
+            if ((snapshot[j].frame_id == snapshot[i].frame_id) &&
+                    (snapshot[j].stage == WFD_LATENCY_HWC_PRESENT)) {
+                present_ns = snapshot[j].time_ns;
+                break;
+            }
+        }
+
+        int ret;
+        if (present_ns < 0)
+            ret = snprintf(buf + len, size - len, "frame %" PRIu64 " %-16s %" PRId64 " ns\n",
+                           snapshot[i].frame_id, wfd_latency_stage_name(snapshot[i].stage),
+                           snapshot[i].time_ns);
+        else
+            ret = snprintf(buf + len, size - len, "frame %" PRIu64 " %-16s %" PRId64 " ns +%" PRId64 " us\n",
+                           snapshot[i].frame_id, wfd_latency_stage_name(snapshot[i].stage),
+                           snapshot[i].time_ns, (snapshot[i].time_ns - present_ns) / 1000);
+        if (ret < 0)
+            break;
+        len += ret;
+    }
+
+    return (len < size) ? len : size - 1;
+}
+
+#endif /* __WFD_LATENCY_TRACE_H__ */
@@ -17,7 +17,9 @@
 
 #include <algorithm>
 
+#include <android/sync.h>
 #include <log/log.h>
+#include <utils/Timers.h>
 
 #include <hardware/exynos/acryl.h>
 
@@ -26,7 +28,7 @@
 Acrylic::Acrylic(const HW2DCapability &capability)
     : mCapability(capability), mHasBackgroundColor(false),
       mMaxTargetLuminance(100), mMinTargetLuminance(0), mTargetDisplayInfo(nullptr),
-      mCanvas(this, AcrylicCanvas::CANVAS_TARGET)
+      mCanvas(this, AcrylicCanvas::CANVAS_TARGET), mStats(), mSubmitTime(0), mPendingFence(-1)
 {
     ALOGD_TEST("Created a new Acrylic on %p", this);
 }
@@ -40,6 +42,9 @@ Acrylic::~Acrylic()
         removeTransitData(layer);
     }
 
+    if (mPendingFence >= 0)
+        close(mPendingFence);
+
     ALOGD_TEST("Destroyed Acrylic on %p", this);
 }
 
@@ -58,6 +63,7 @@ AcrylicLayer *Acrylic::createLayer()
     }
 
     mLayers.push_back(layer);
+    reorderLayer(layer);
 
     ALOGD_TEST("A new Acrylic layer is created. Total %zd layers", mLayers.size());
 
@@ -120,7 +126,15 @@ bool Acrylic::validateAllLayers()
     hw2d_rect_t rect;
     hw2d_coord_t xy = mCanvas.getImageDimension();
 
+    // The layers are validated against the target image
+    bool validated = !(mCanvas.getSettingFlags() & AcrylicCanvas::SETTING_MODIFIED_MASK);
+
     for (auto layer: mLayers) {
+        prot = prot || layer->isProtected();
+
+        if (validated && !(layer->getSettingFlags() & AcrylicCanvas::SETTING_MODIFIED_MASK))
+            continue;
+
         if (!layer->isSettingOkay()) {
             ALOGE("Incomplete settting (flags: %#x) on a layer of %zu layers",
                   layer->getSettingFlags(), mLayers.size());
@@ -169,8 +183,6 @@ bool Acrylic::validateAllLayers()
                     mLayers.size(), xy.hori, xy.vert);
             return false;
         }
-
-        prot = prot || layer->isProtected();
     }
 
     if (prot && !mCanvas.isProtected()) {
@@ -181,7 +193,87 @@ bool Acrylic::validateAllLayers()
     return true;
 }
 
-void Acrylic::sortLayers()
+void Acrylic::recordSubmission(int fence)
 {
-    std::sort(std::begin(mLayers), std::end(mLayers), [] (auto l1, auto l2) { return l1->getZOrder() < l2->getZOrder(); });
+    collectPendingJob();
+
+    mStats.job_count++;
+    mSubmitTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mPendingFence = (fence >= 0) ? dup(fence) : -1;
+}
+
+void Acrylic::recordCompletion(unsigned int hw_usec)
+{
+    if (mSubmitTime == 0)
+        return;
+
+    nsecs_t complete = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (mPendingFence >= 0) {
+        // The job is completed earlier than it is observed if it has a release fence
+        struct sync_file_info *info = sync_file_info(mPendingFence);
+        if (info) {
+            if (info->status == 1) {
+                struct sync_fence_info *fence_info = sync_get_fence_info(info);
+                nsecs_t signaled = 0;
+                for (uint32_t i = 0; i < info->num_fences; i++)
+                    signaled = std::max(signaled, static_cast<nsecs_t>(fence_info[i].timestamp_ns));
+                if ((signaled > mSubmitTime) && (signaled < complete))
+                    complete = signaled;
+            }
+            sync_file_info_free(info);
+        }
+        close(mPendingFence);
+        mPendingFence = -1;
+    }
+
+    unsigned int latency = static_cast<unsigned int>(ns2us(complete - mSubmitTime));
+
+    mStats.measured_count++;
+    mStats.total_latency_usec += latency;
+    mStats.last_latency_usec = latency;
+    mStats.max_latency_usec = std::max(mStats.max_latency_usec, latency);
+    if (hw_usec != 0)
+        mStats.last_hw_usec = hw_usec;
+
+    mSubmitTime = 0;
+}
+
+void Acrylic::collectPendingJob()
+{
+    // A job submitted with a release fence is completed if its release fence is signaled.
+    // Otherwise, its completion is not observed any more when the next job is submitted.
+    if (mPendingFence >= 0) {
+        if (sync_wait(mPendingFence, 0) == 0) {
+            recordCompletion();
+            return;
+        }
+        close(mPendingFence);
+        mPendingFence = -1;
+    }
+
+    mSubmitTime = 0;
+}
+
+void Acrylic::clearStats()
+{
+    if (mPendingFence >= 0)
+        close(mPendingFence);
+
+    mStats = {};
+    mSubmitTime = 0;
+    mPendingFence = -1;
+}
+
+void Acrylic::reorderLayer(AcrylicLayer *layer)
+{
+    auto it = find(std::begin(mLayers), std::end(mLayers), layer);
+
+    if (it == std::end(mLayers))
+        return;
+
+    mLayers.erase(it);
+    it = std::upper_bound(std::begin(mLayers), std::end(mLayers), layer,
+                          [] (auto l1, auto l2) { return l1->getZOrder() < l2->getZOrder(); });
+    mLayers.insert(it, layer);
 }
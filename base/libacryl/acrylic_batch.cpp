@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <log/log.h>
+
+#include <hardware/exynos/acryl.h>
+
+#include "acrylic_internal.h"
+
+bool AcrylicBatch::addJob(Acrylic *job)
+{
+    if (!job) {
+        ALOGE("Trying to add an empty job to a batch");
+        return false;
+    }
+
+    if (std::find(mJobs.begin(), mJobs.end(), job) != mJobs.end()) {
+        ALOGE("Acrylic %p is already added to the batch", job);
+        return false;
+    }
+
+    mJobs.push_back(job);
+
+    return true;
+}
+
+bool AcrylicBatch::submit(int fence[], unsigned int num_fences)
+{
+    for (unsigned int i = 0; i < num_fences; i++)
+        fence[i] = -1;
+
+    std::vector<int> job_fence;
+
+    for (unsigned int i = 0; i < mJobs.size(); i++) {
+        Acrylic *job = mJobs[i];
+        // Release fences of the sources followed by the fence of the target
+        unsigned int job_fences = job->layerCount() + 1;
+        job_fence.assign(job_fences, -1);
+
+        if (!job->execute(job_fence.data(), job_fences)) {
+            ALOGE("Failed to run job %u of %zu in the batch", i, mJobs.size());
+            return false;
+        }
+
+        // The target is written after all the sources are read
+        for (unsigned int j = 0; j < job_fences - 1; j++) {
+            if (job_fence[j] >= 0)
+                close(job_fence[j]);
+        }
+
+        if (i < num_fences)
+            fence[i] = job_fence[job_fences - 1];
+        else if (job_fence[job_fences - 1] >= 0)
+            close(job_fence[job_fences - 1]);
+    }
+
+    ALOGD_TEST("Submitted %zu jobs in a batch", mJobs.size());
+
+    return true;
+}
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include <android/sync.h>
+#include <log/log.h>
+
+#include <hardware/hwcomposer2.h>
+
+#include "acrylic_internal.h"
+#include "acrylic_cpu.h"
+
+#define CPU_FENCE_TIMEOUT_MSEC 1000
+
+static bool is_blending_none(uint32_t mode)
+{
+    return (mode == HWC_BLENDING_NONE) || (mode == HWC2_BLEND_MODE_NONE);
+}
+
+static bool is_blending_premult(uint32_t mode)
+{
+    return (mode == HWC_BLENDING_PREMULT) || (mode == HWC2_BLEND_MODE_PREMULTIPLIED);
+}
+
+static bool is_format_compatible(uint32_t target, uint32_t source)
+{
+    if ((target == HAL_PIXEL_FORMAT_RGBA_8888) || (target == HAL_PIXEL_FORMAT_RGBX_8888))
+        return (source == HAL_PIXEL_FORMAT_RGBA_8888) || (source == HAL_PIXEL_FORMAT_RGBX_8888);
+
+    if ((target == HAL_PIXEL_FORMAT_BGRA_8888) || (target == HAL_PIXEL_FORMAT_RGB_565))
+        return source == target;
+
+    return false;
+}
+
+static bool is_canvas_eligible(AcrylicCanvas &canvas)
+{
+    if (canvas.isProtected() || canvas.isCompressed() || canvas.isUOrder() || canvas.isOTF())
+        return false;
+
+    if (canvas.isSolidColor())
+        return true;
+
+    return (canvas.getBufferCount() == 1) &&
+           ((canvas.getBufferType() == AcrylicCanvas::MT_DMABUF) ||
+            (canvas.getBufferType() == AcrylicCanvas::MT_USERPTR));
+}
+
+static hw2d_rect_t get_target_rect(AcrylicLayer &layer, hw2d_coord_t xy)
+{
+    hw2d_rect_t rect = layer.getTargetRect();
+
+    if (area_is_zero(rect)) {
+        rect.pos = {0, 0};
+        rect.size = xy;
+    }
+
+    return rect;
+}
+
+// x * y / 255 with rounding
+static inline uint32_t mul255(uint32_t x, uint32_t y)
+{
+    uint32_t t = x * y + 128;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+// Premultiplied source over: D = S * Pa + D * (1 - Sa * Pa)
+// Alpha of all formats blended here is in the most significant byte.
+static void blend_row(uint32_t *dst, const uint32_t *src, unsigned int count, uint8_t plane_alpha, bool opaque)
+{
+    unsigned int i = 0;
+
+#ifdef __ARM_NEON
+    uint8x8_t pa = vdup_n_u8(plane_alpha);
+    uint8x8_t full = vdup_n_u8(255);
+
+    for ( ; (i + 8) <= count; i += 8) {
+        uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t *>(src + i));
+        uint8x8x4_t d = vld4_u8(reinterpret_cast<const uint8_t *>(dst + i));
+
+        if (opaque)
+            s.val[3] = full;
+
+        for (int c = 0; c < 4; c++) {
+            uint16x8_t t = vmull_u8(s.val[c], pa);
+            s.val[c] = vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+        }
+
+        uint8x8_t inv = vsub_u8(full, s.val[3]);
+
+        for (int c = 0; c < 4; c++) {
+            uint16x8_t t = vmull_u8(d.val[c], inv);
+            d.val[c] = vqadd_u8(s.val[c], vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8));
+        }
+
+        vst4_u8(reinterpret_cast<uint8_t *>(dst + i), d);
+    }
+#endif
+
+    for ( ; i < count; i++) {
+        uint32_t s = src[i];
+        uint32_t d = dst[i];
+        uint32_t alpha = mul255(opaque ? 255 : (s >> 24), plane_alpha);
+        uint32_t inv = 255 - alpha;
+        uint32_t out = std::min(alpha + mul255(d >> 24, inv), 255U) << 24;
+
+        for (int shift = 0; shift < 24; shift += 8) {
+            uint32_t c = mul255((s >> shift) & 0xFF, plane_alpha) + mul255((d >> shift) & 0xFF, inv);
+            out |= std::min(c, 255U) << shift;
+        }
+
+        dst[i] = out;
+    }
+}
+
+bool AcrylicCPUBlitter::isEligible(AcrylicCanvas &target, AcrylicLayer *layers[], unsigned int count, bool background)
+{
+    uint32_t format = target.getFormat();
+
+    if (!is_format_compatible(format, format) || !is_canvas_eligible(target) || target.isSolidColor())
+        return false;
+
+    hw2d_coord_t xy = target.getImageDimension();
+    unsigned int pixels = background ? xy.hori * xy.vert : 0;
+
+    for (unsigned int i = 0; (i < count) && (pixels <= MAX_PIXELS); i++) {
+        AcrylicLayer &layer = *layers[i];
+
+        if (!is_canvas_eligible(layer) || (layer.getTransform() != 0))
+            return false;
+
+        uint32_t mode = layer.getCompositingMode();
+        if (!is_blending_none(mode) && !is_blending_premult(mode))
+            return false;
+
+        hw2d_rect_t rect = get_target_rect(layer, xy);
+        bool opaque;
+
+        if (layer.isSolidColor()) {
+            opaque = (layer.getSolidColor() >> 24) == 0xFF;
+        } else {
+            hw2d_rect_t crop = layer.getImageRect();
+
+            if (!is_format_compatible(format, layer.getFormat()) ||
+                (layer.getDataspace() != target.getDataspace()) ||
+                (crop.size.hori != rect.size.hori) || (crop.size.vert != rect.size.vert))
+                return false;
+
+            opaque = (layer.getFormat() != HAL_PIXEL_FORMAT_RGBA_8888) &&
+                     (layer.getFormat() != HAL_PIXEL_FORMAT_BGRA_8888);
+        }
+
+        // Blending is not supported on RGB565 and plane alpha is not applied without blending
+        if ((layer.getPlaneAlpha() != 255) && (is_blending_none(mode) || (format == HAL_PIXEL_FORMAT_RGB_565)))
+            return false;
+
+        if (!opaque && !is_blending_none(mode) && (format == HAL_PIXEL_FORMAT_RGB_565))
+            return false;
+
+        pixels += rect.size.hori * rect.size.vert;
+    }
+
+    return pixels <= MAX_PIXELS;
+}
+
+bool AcrylicCPUBlitter::map(AcrylicCanvas &canvas, Mapping &mapping, bool write)
+{
+    mapping = {nullptr, MAP_FAILED, 0, -1};
+
+    if (canvas.getBufferType() == AcrylicCanvas::MT_USERPTR) {
+        mapping.addr = static_cast<char *>(canvas.getUserptr(0));
+        return mapping.addr != nullptr;
+    }
+
+    int prot = write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    size_t len = canvas.getOffset(0) + canvas.getBufferLength(0);
+    void *addr = mmap(NULL, len, prot, MAP_SHARED, canvas.getDmabuf(0), 0);
+    if (addr == MAP_FAILED) {
+        ALOGERR("Failed to map buffer %d of length %u", canvas.getDmabuf(0), canvas.getBufferLength(0));
+        return false;
+    }
+
+    mapping.fd = canvas.getDmabuf(0);
+    mapping.base = addr;
+    mapping.len = len;
+    mapping.addr = static_cast<char *>(addr) + canvas.getOffset(0);
+
+    struct dma_buf_sync sync = { DMA_BUF_SYNC_START | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ) };
+    if (ioctl(mapping.fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+        ALOGERR("Failed to start CPU access to buffer %d", mapping.fd);
+
+    return true;
+}
+
+void AcrylicCPUBlitter::unmap(Mapping &mapping, bool write)
+{
+    if (mapping.fd < 0)
+        return;
+
+    struct dma_buf_sync sync = { DMA_BUF_SYNC_END | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ) };
+    if (ioctl(mapping.fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+        ALOGERR("Failed to end CPU access to buffer %d", mapping.fd);
+
+    munmap(mapping.base, mapping.len);
+    mapping.fd = -1;
+}
+
+void AcrylicCPUBlitter::fill(Mapping &target, hw2d_coord_t xy, hw2d_rect_t rect, uint32_t color, bool blend)
+{
+    size_t stride = xy.hori * mBpp;
+    char *dst = target.addr + rect.pos.vert * stride + rect.pos.hori * mBpp;
+
+    if (mFormat == HAL_PIXEL_FORMAT_RGB_565) {
+        uint16_t pixel = static_cast<uint16_t>((((color >> 19) & 0x1F) << 11) |
+                                               (((color >> 10) & 0x3F) << 5) | ((color >> 3) & 0x1F));
+        for (unsigned int y = 0; y < rect.size.vert; y++, dst += stride)
+            std::fill_n(reinterpret_cast<uint16_t *>(dst), rect.size.hori, pixel);
+        return;
+    }
+
+    // color is A, R, G, B from MSB while RGBA8888 is R, G, B, A from the lowest address
+    if (mFormat != HAL_PIXEL_FORMAT_BGRA_8888)
+        color = (color & 0xFF00FF00) | ((color >> 16) & 0xFF) | ((color & 0xFF) << 16);
+
+    if (!blend) {
+        for (unsigned int y = 0; y < rect.size.vert; y++, dst += stride)
+            std::fill_n(reinterpret_cast<uint32_t *>(dst), rect.size.hori, color);
+        return;
+    }
+
+    mLine.assign(rect.size.hori, color);
+    for (unsigned int y = 0; y < rect.size.vert; y++, dst += stride)
+        blend_row(reinterpret_cast<uint32_t *>(dst), mLine.data(), rect.size.hori, 255, false);
+}
+
+void AcrylicCPUBlitter::blit(Mapping &target, hw2d_coord_t xy, hw2d_rect_t rect, AcrylicLayer &layer, Mapping &source)
+{
+    size_t stride = xy.hori * mBpp;
+    size_t src_stride = layer.getImageDimension().hori * mBpp;
+    hw2d_rect_t crop = layer.getImageRect();
+    char *dst = target.addr + rect.pos.vert * stride + rect.pos.hori * mBpp;
+    const char *src = source.addr + crop.pos.vert * src_stride + crop.pos.hori * mBpp;
+    uint8_t plane_alpha = layer.getPlaneAlpha();
+    bool opaque = (layer.getFormat() != HAL_PIXEL_FORMAT_RGBA_8888) &&
+                  (layer.getFormat() != HAL_PIXEL_FORMAT_BGRA_8888);
+
+    if (is_blending_none(layer.getCompositingMode()) || (opaque && (plane_alpha == 255))) {
+        for (unsigned int y = 0; y < rect.size.vert; y++, dst += stride, src += src_stride)
+            memcpy(dst, src, rect.size.hori * mBpp);
+        return;
+    }
+
+    for (unsigned int y = 0; y < rect.size.vert; y++, dst += stride, src += src_stride)
+        blend_row(reinterpret_cast<uint32_t *>(dst), reinterpret_cast<const uint32_t *>(src),
+                  rect.size.hori, plane_alpha, opaque);
+}
+
+static bool wait_fence(AcrylicCanvas &canvas)
+{
+    bool success = (canvas.getFence() < 0) || (sync_wait(canvas.getFence(), CPU_FENCE_TIMEOUT_MSEC) == 0);
+
+    if (!success)
+        ALOGERR("Failed to wait for the acquire fence %d", canvas.getFence());
+
+    canvas.setFence(-1);
+
+    return success;
+}
+
+bool AcrylicCPUBlitter::execute(AcrylicCanvas &target, AcrylicLayer *layers[], unsigned int count,
+                                bool has_background, uint32_t background)
+{
+    bool success = wait_fence(target);
+
+    for (unsigned int i = 0; i < count; i++)
+        success = wait_fence(*layers[i]) && success;
+
+    if (!success)
+        return false;
+
+    mFormat = target.getFormat();
+    mBpp = (mFormat == HAL_PIXEL_FORMAT_RGB_565) ? 2 : 4;
+
+    Mapping dst;
+    if (!map(target, dst, true))
+        return false;
+
+    hw2d_coord_t xy = target.getImageDimension();
+
+    if (has_background)
+        fill(dst, xy, {{0, 0}, xy}, background, false);
+
+    for (unsigned int i = 0; i < count; i++) {
+        AcrylicLayer &layer = *layers[i];
+        hw2d_rect_t rect = get_target_rect(layer, xy);
+
+        if (layer.isSolidColor()) {
+            uint32_t color = layer.getSolidColor();
+            uint32_t alpha = mul255(color >> 24, layer.getPlaneAlpha());
+
+            // The solid color is not premultiplied
+            if (is_blending_premult(layer.getCompositingMode()) && (alpha != 255)) {
+                uint32_t multiplied = alpha << 24;
+                for (int shift = 0; shift < 24; shift += 8)
+                    multiplied |= mul255((color >> shift) & 0xFF, alpha) << shift;
+                fill(dst, xy, rect, multiplied, true);
+            } else {
+                fill(dst, xy, rect, color, false);
+            }
+            continue;
+        }
+
+        Mapping src;
+        if (!map(layer, src, false)) {
+            success = false;
+            break;
+        }
+
+        blit(dst, xy, rect, layer, src);
+
+        unmap(src, false);
+    }
+
+    unmap(dst, true);
+
+    return success;
+}
+
+AcrylicCompositorCPU::AcrylicCompositorCPU(const HW2DCapability &capability)
+    : Acrylic(capability)
+{
+    ALOGD_TEST("Created a new Acrylic for CPU on %p", this);
+}
+
+AcrylicCompositorCPU::~AcrylicCompositorCPU()
+{
+    ALOGD_TEST("Deleting Acrylic for CPU on %p", this);
+}
+
+bool AcrylicCompositorCPU::execute(int fence[], unsigned int num_fences)
+{
+    if (!validateAllLayers())
+        return false;
+
+    AcrylicLayer *layers[layerCount() + 1];
+    for (unsigned int i = 0; i < layerCount(); i++)
+        layers[i] = getLayer(i);
+
+    bool success = mBlitter.isEligible(getCanvas(), layers, layerCount(), hasBackgroundColor());
+    if (!success) {
+        ALOGE("The job of %u layers is not supported by CPU", layerCount());
+    } else {
+        uint16_t r, g, b, a;
+        getBackgroundColor(&r, &g, &b, &a);
+        uint32_t background = ((a & 0xFF00) << 16) | ((r & 0xFF00) << 8) | (g & 0xFF00) | (b >> 8);
+
+        recordSubmission();
+        success = mBlitter.execute(getCanvas(), layers, layerCount(), hasBackgroundColor(), background);
+    }
+
+    // Nothing is running after the job is done by CPU
+    for (unsigned int i = 0; i < num_fences; i++)
+        fence[i] = -1;
+
+    if (!success) {
+        recordFailure();
+        for (unsigned int i = 0; i < layerCount(); i++)
+            getLayer(i)->setFence(-1);
+        getCanvas().setFence(-1);
+
+        return false;
+    }
+
+    recordCompletion();
+
+    getCanvas().clearSettingModified();
+    for (unsigned int i = 0; i < layerCount(); i++)
+        getLayer(i)->clearSettingModified();
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::execute(int *handle)
+{
+    if (!execute(NULL, 0))
+        return false;
+
+    if (handle != NULL)
+        *handle = -1; /* nothing to wait for */
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::waitExecution(int __unused handle)
+{
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_HW2DCOMPOSITOR_CPU_H__
+#define __HARDWARE_EXYNOS_HW2DCOMPOSITOR_CPU_H__
+
+#include <vector>
+
+#include <hardware/exynos/acryl.h>
+
+/*
+ * AcrylicCPUBlitter - Compositing of tiny jobs by CPU
+ *
+ * The cost to process a few thousands of pixels by HW 2D is dominated by the
+ * ioctl, fences and powering up HW 2D. AcrylicCPUBlitter composites such jobs
+ * with CPU if all of the following conditions are met:
+ * - the target and the sources are RGBA8888, RGBX8888, BGRA8888 or RGB565
+ *   in the same byte order, or the sources are solid colors
+ * - no scaling, no transform and no color space conversion
+ * - blending is none or premultiplied source over
+ * - no protected, compressed or U-Order images and no OTF buffers
+ * - the number of pixels written is not larger than MAX_PIXELS
+ * The images are accessed by CPU, so the acquire fences are waited before
+ * compositing and no release fence is created.
+ */
+class AcrylicCPUBlitter {
+public:
+    static const unsigned int MAX_PIXELS = 128 * 128;
+
+    bool isEligible(AcrylicCanvas &target, AcrylicLayer *layers[], unsigned int count, bool background);
+    /*
+     * @background is a color in A(31:24), R(23:16), G(15:8), B(7:0) filled to
+     * the entire target image before the layers are composited if @has_background.
+     */
+    bool execute(AcrylicCanvas &target, AcrylicLayer *layers[], unsigned int count,
+                 bool has_background, uint32_t background);
+private:
+    struct Mapping {
+        char *addr;
+        void *base;
+        size_t len;
+        int fd;
+    };
+
+    bool map(AcrylicCanvas &canvas, Mapping &mapping, bool write);
+    void unmap(Mapping &mapping, bool write);
+    void fill(Mapping &target, hw2d_coord_t xy, hw2d_rect_t rect, uint32_t color, bool blend);
+    void blit(Mapping &target, hw2d_coord_t xy, hw2d_rect_t rect, AcrylicLayer &layer, Mapping &source);
+
+    uint32_t mFormat;
+    unsigned int mBpp;
+    std::vector<uint32_t> mLine;
+};
+
+/*
+ * AcrylicCompositorCPU - Acrylic backend of AcrylicCPUBlitter
+ *
+ * It executes the jobs that AcrylicCPUBlitter accepts and rejects the others.
+ */
+class AcrylicCompositorCPU: public Acrylic {
+public:
+    AcrylicCompositorCPU(const HW2DCapability &capability);
+    virtual ~AcrylicCompositorCPU();
+    virtual bool execute(int fence[], unsigned int num_fences);
+    virtual bool execute(int *handle = NULL);
+    virtual bool waitExecution(int handle);
+private:
+    AcrylicCPUBlitter mBlitter;
+};
+
+#endif /* __HARDWARE_EXYNOS_HW2DCOMPOSITOR_CPU_H__ */
@@ -62,7 +62,7 @@ int AcrylicDevice::ioctl(int cmd, void *arg)
 }
 
 AcrylicRedundantDevice::AcrylicRedundantDevice(const char *devpath)
-    : mDevPath(devpath), mDevFd{-1, -1, -1}, mFdIdx(0)
+    : mDevPath(devpath), mDevFd{-1, -1, -1}, mInFlight{false, false, false}, mFdIdx(0)
 {
     mDevPath = devpath;
 }
@@ -113,6 +113,37 @@ int AcrylicRedundantDevice::ioctl_current(int cmd, void *arg)
     return ::ioctl(mDevFd[mFdIdx], cmd, arg);
 }
 
+int AcrylicRedundantDevice::ioctl_single(int cmd, void *arg, int *fdidx)
+{
+    int idx = mFdIdx;
+
+    // all fds in flight: the driver decides whether to queue or to reject the job
+    for (int i = 0; i < MAX_DEVICE_FD; i++) {
+        if (!mInFlight[(mFdIdx + i) % MAX_DEVICE_FD]) {
+            idx = (mFdIdx + i) % MAX_DEVICE_FD;
+            break;
+        }
+    }
+
+    int ret = ioctl_fd(idx, cmd, arg);
+    if ((ret == 0) && (fdidx != NULL)) {
+        mInFlight[idx] = true;
+        *fdidx = idx;
+    }
+
+    mFdIdx = (idx + 1) % MAX_DEVICE_FD;
+
+    return ret;
+}
+
+int AcrylicRedundantDevice::ioctl_fd(int fdidx, int cmd, void *arg)
+{
+    if (!open())
+        return -1;
+
+    return ::ioctl(mDevFd[fdidx], cmd, arg);
+}
+
 int AcrylicRedundantDevice::ioctl_broadcast(int cmd, void *arg) {
     if (!open())
         return -1;
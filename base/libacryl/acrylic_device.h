@@ -33,6 +33,13 @@ private:
 };
 
 #define MAX_DEVICE_FD 3
+/*
+ * The contexts of the fds to the same device are the independent job queues.
+ * ioctl_single() submits a job to the next fd in turn that has no job in
+ * flight, so that a job waited later by the caller does not block the jobs
+ * submitted after it. The jobs submitted with @fdidx are in flight until
+ * complete() is called with the index informed by ioctl_single().
+ */
 class AcrylicRedundantDevice {
 public:
     AcrylicRedundantDevice(const char *path);
@@ -40,19 +47,16 @@ public:
     int ioctl_unique(int cmd, void *arg);
     int ioctl_current(int cmd, void *arg);
     int ioctl_broadcast(int cmd, void *arg);
-    int ioctl_single(int cmd, void *arg) {
-        int ret = ioctl_current(cmd, arg);
-
-        mFdIdx++;
-        mFdIdx = mFdIdx % MAX_DEVICE_FD;
-        return ret;
-
-    }
+    int ioctl_single(int cmd, void *arg, int *fdidx = NULL);
+    int ioctl_fd(int fdidx, int cmd, void *arg);
+    void complete(int fdidx) { mInFlight[fdidx] = false; }
+    bool isInFlight(int fdidx) { return mInFlight[fdidx]; }
 private:
     bool open();
 
     std:: string mDevPath;
     int mDevFd[MAX_DEVICE_FD];
+    bool mInFlight[MAX_DEVICE_FD];
     int mFdIdx;
 };
 
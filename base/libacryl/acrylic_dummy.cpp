@@ -56,8 +56,6 @@ bool AcrylicCompositorDummy::execute(int *handle)
     if (!validateAllLayers())
         return false;
 
-    sortLayers();
-
     if (handle)
         *handle = 0;
 
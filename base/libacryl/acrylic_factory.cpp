@@ -27,6 +27,7 @@
 #include "acrylic_mscl9810.h"
 #include "acrylic_mscl3830.h"
 #include "acrylic_dummy.h"
+#include "acrylic_cpu.h"
 
 static uint32_t all_fimg2d_formats[] = {
     HAL_PIXEL_FORMAT_RGBA_8888,
@@ -305,6 +306,13 @@ static uint32_t rgb_formats[] = {
     HAL_PIXEL_FORMAT_RGB_565,
 };
 
+static uint32_t cpu_formats[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_RGB_565,
+};
+
 // The presence of the dataspace definitions are in the order
 // of application's preference to reduce comparations.
 static int all_hwc_dataspaces[] = {
@@ -656,6 +664,29 @@ const static stHW2DCapability __capability_mscl_sbwc_v2_7 = {
     .base_align = 4,
 };
 
+// CPU composites only the tiny jobs that AcrylicCPUBlitter accepts
+const static stHW2DCapability __capability_cpu = {
+    .max_upsampling_num = {1, 1},
+    .max_downsampling_factor = {1, 1},
+    .max_upsizing_num = {1, 1},
+    .max_downsizing_factor = {1, 1},
+    .min_src_dimension = {1, 1},
+    .max_src_dimension = {8192, 8192},
+    .min_dst_dimension = {1, 1},
+    .max_dst_dimension = {8192, 8192},
+    .min_pix_align = {1, 1},
+    .rescaling_count = 0,
+    .compositing_mode = HW2DCapability::BLEND_NONE | HW2DCapability::BLEND_SRC_OVER,
+    .transform_type = 0,
+    .auxiliary_feature = HW2DCapability::FEATURE_PLANE_ALPHA | HW2DCapability::FEATURE_SOLIDCOLOR,
+    .num_formats = ARRSIZE(cpu_formats),
+    .num_dataspaces = ARRSIZE(all_hwc_dataspaces),
+    .max_layers = 4,
+    .pixformats = cpu_formats,
+    .dataspaces = all_hwc_dataspaces,
+    .base_align = 1,
+};
+
 static const HW2DCapability capability_fimg2d_8895(__capability_fimg2d_8895);
 static const HW2DCapability capability_fimg2d_8890(__capability_fimg2d_8890);
 static const HW2DCapability capability_fimg2d_9610(__capability_fimg2d_9610);
@@ -669,6 +700,7 @@ static const HW2DCapability capability_mscl_sbwcl(__capability_mscl_sbwcl);
 static const HW2DCapability capability_mscl_3830(__capability_mscl_3830);
 static const HW2DCapability capability_mscl_votf(__capability_mscl_votf);
 static const HW2DCapability capability_mscl_sbwc_v2_7(__capability_mscl_sbwc_v2_7);
+static const HW2DCapability capability_cpu(__capability_cpu);
 
 Acrylic *Acrylic::createInstance(const char *spec)
 {
@@ -704,6 +736,8 @@ Acrylic *Acrylic::createInstance(const char *spec)
         compositor = new AcrylicCompositorMSCL9810(capability_mscl_votf);
     } else if (strcmp(spec, "mscl_sbwc_v2_7") == 0) {
         compositor = new AcrylicCompositorMSCL9810(capability_mscl_sbwc_v2_7);
+    } else if (strcmp(spec, "cpu_compositor") == 0) {
+        compositor = new AcrylicCompositorCPU(capability_cpu);
     } else if (strcmp(spec, "dummy") == 0) {
         compositor = new AcrylicCompositorDummy(capability_fimg2d_8895);
     } else {
@@ -22,6 +22,8 @@
 
 #include <exynos_format.h> // hardware/smasung_slsi/exynos/include
 
+#include <hardware/exynos/format_index.h>
+
 #include "acrylic_internal.h"
 
 #define V4L2_PIX_FMT_NV12N             v4l2_fourcc('N', 'N', '1', '2')
@@ -80,7 +82,7 @@
 #define V4L2_PIX_FMT_NV12_RGB32 v4l2_fourcc('N', 'V', '1', 'R') /* 12  Y/CbCr 4:2:0 RGBA */
 #define V4L2_PIX_FMT_NV12N_RGB32   v4l2_fourcc('N', 'N', '1', 'R') /* 12  Y/CbCr 4:2:0 RGBA */
 
-static uint32_t __halfmt_to_v4l2_rgb[][2] = {
+static constexpr uint32_t __halfmt_to_v4l2_rgb[][2] = {
     {HAL_PIXEL_FORMAT_RGBA_8888,                    V4L2_PIX_FMT_ABGR32   },
     {HAL_PIXEL_FORMAT_BGRA_8888,                    V4L2_PIX_FMT_ARGB32   },
     {HAL_PIXEL_FORMAT_RGBX_8888,                    V4L2_PIX_FMT_XBGR32   },
@@ -88,10 +90,13 @@ static uint32_t __halfmt_to_v4l2_rgb[][2] = {
     {HAL_PIXEL_FORMAT_RGB_565,                      V4L2_PIX_FMT_RGB565   },
 };
 
+static constexpr auto __halfmt_to_v4l2_rgb_index =
+        makeFormatIndex(__halfmt_to_v4l2_rgb, [] (const auto &e) { return e[0]; });
+
 // The V4L2_PIX_FMT_RGB32, V4L2_PIX_FMT_BGR32 are deprecated in V4L2.
 // But the legacy mscl driver and libhwcutils requires them.
 // The HAL format conversion to the deprecated V4L2 formats are prepared for mscl_9810
-static uint32_t __halfmt_to_v4l2_rgb_deprecated[][2] = {
+static constexpr uint32_t __halfmt_to_v4l2_rgb_deprecated[][2] = {
     {HAL_PIXEL_FORMAT_RGBA_8888,                    V4L2_PIX_FMT_RGB32       },
     {HAL_PIXEL_FORMAT_BGRA_8888,                    V4L2_PIX_FMT_BGR32       },
     {HAL_PIXEL_FORMAT_RGBX_8888,                    V4L2_PIX_FMT_RGB32       },
@@ -100,7 +105,12 @@ static uint32_t __halfmt_to_v4l2_rgb_deprecated[][2] = {
     {HAL_PIXEL_FORMAT_RGBA_1010102,                 V4L2_PIX_FMT_ABGR2101010 },
 };
 
-static uint32_t __halfmt_to_v4l2_ycbcr[][2] = {
+static constexpr auto __halfmt_to_v4l2_rgb_deprecated_index =
+        makeFormatIndex(__halfmt_to_v4l2_rgb_deprecated, [] (const auto &e) { return e[0]; });
+static constexpr auto __v4l2_rgb_deprecated_to_halfmt_index =
+        makeFormatIndex(__halfmt_to_v4l2_rgb_deprecated, [] (const auto &e) { return e[1]; });
+
+static constexpr uint32_t __halfmt_to_v4l2_ycbcr[][2] = {
     {HAL_PIXEL_FORMAT_YV12,                           V4L2_PIX_FMT_YVU420         },
     {HAL_PIXEL_FORMAT_EXYNOS_YV12_M,                  V4L2_PIX_FMT_YVU420M        },
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P,             V4L2_PIX_FMT_YUV420         },
@@ -148,7 +158,12 @@ static uint32_t __halfmt_to_v4l2_ycbcr[][2] = {
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_256_SBWC,  V4L2_PIX_FMT_NV12N_SBWC_256_10B },
 };
 
-static uint32_t __halfmt_to_sbwc_lossy_blocksize[][2] = {
+static constexpr auto __halfmt_to_v4l2_ycbcr_index =
+        makeFormatIndex(__halfmt_to_v4l2_ycbcr, [] (const auto &e) { return e[0]; });
+static constexpr auto __v4l2_ycbcr_to_halfmt_index =
+        makeFormatIndex(__halfmt_to_v4l2_ycbcr, [] (const auto &e) { return e[1]; });
+
+static constexpr uint32_t __halfmt_to_sbwc_lossy_blocksize[][2] = {
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_SBWC_L50,  64 },
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_SBWC_L75,  96 },
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L40, 64 },
@@ -156,12 +171,14 @@ static uint32_t __halfmt_to_sbwc_lossy_blocksize[][2] = {
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L80, 128 },
 };
 
+static constexpr auto __halfmt_to_sbwc_lossy_blocksize_index =
+        makeFormatIndex(__halfmt_to_sbwc_lossy_blocksize, [] (const auto &e) { return e[0]; });
+
 static uint32_t halfmt_to_v4l2_ycbcr(uint32_t halfmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_v4l2_ycbcr); i++) {
-        if (__halfmt_to_v4l2_ycbcr[i][0] == halfmt)
-            return __halfmt_to_v4l2_ycbcr[i][1];
-    }
+    int i = __halfmt_to_v4l2_ycbcr_index.find(halfmt);
+    if (i >= 0)
+        return __halfmt_to_v4l2_ycbcr[i][1];
 
     ALOGE("Unable to find the proper v4l2 format for HAL format %#x", halfmt);
 
@@ -170,10 +187,9 @@ static uint32_t halfmt_to_v4l2_ycbcr(uint32_t halfmt)
 
 static uint32_t v4l2_ycbcr_to_halfmt(uint32_t v4l2_fmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_v4l2_ycbcr); i++) {
-        if (__halfmt_to_v4l2_ycbcr[i][1] == v4l2_fmt)
-            return __halfmt_to_v4l2_ycbcr[i][0];
-    }
+    int i = __v4l2_ycbcr_to_halfmt_index.find(v4l2_fmt);
+    if (i >= 0)
+        return __halfmt_to_v4l2_ycbcr[i][0];
 
     ALOGE("Unable to find the proper HAL format for v4l2 format %#x", v4l2_fmt);
 
@@ -182,51 +198,49 @@ static uint32_t v4l2_ycbcr_to_halfmt(uint32_t v4l2_fmt)
 
 uint32_t halfmt_to_v4l2(uint32_t halfmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_v4l2_rgb); i++) {
-        if (__halfmt_to_v4l2_rgb[i][0] == halfmt)
-            return __halfmt_to_v4l2_rgb[i][1];
-    }
+    int i = __halfmt_to_v4l2_rgb_index.find(halfmt);
+    if (i >= 0)
+        return __halfmt_to_v4l2_rgb[i][1];
 
     return halfmt_to_v4l2_ycbcr(halfmt);
 }
 
 uint32_t halfmt_to_v4l2_deprecated(uint32_t halfmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_v4l2_rgb_deprecated); i++) {
-        if (__halfmt_to_v4l2_rgb_deprecated[i][0] == halfmt)
-            return __halfmt_to_v4l2_rgb_deprecated[i][1];
-    }
+    int i = __halfmt_to_v4l2_rgb_deprecated_index.find(halfmt);
+    if (i >= 0)
+        return __halfmt_to_v4l2_rgb_deprecated[i][1];
 
     return halfmt_to_v4l2_ycbcr(halfmt);
 }
 
 uint32_t v4l2_deprecated_to_halfmt(uint32_t v4l2_fmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_v4l2_rgb_deprecated); i++) {
-        if (__halfmt_to_v4l2_rgb_deprecated[i][1] == v4l2_fmt)
-            return __halfmt_to_v4l2_rgb_deprecated[i][0];
-    }
+    int i = __v4l2_rgb_deprecated_to_halfmt_index.find(v4l2_fmt);
+    if (i >= 0)
+        return __halfmt_to_v4l2_rgb_deprecated[i][0];
 
     return v4l2_ycbcr_to_halfmt(v4l2_fmt);
-
 }
 
 uint8_t get_block_size_from_halfmt(uint32_t halfmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_sbwc_lossy_blocksize); i++) {
-        if (__halfmt_to_sbwc_lossy_blocksize[i][0] == halfmt)
-            return __halfmt_to_sbwc_lossy_blocksize[i][1];
-    }
+    int i = __halfmt_to_sbwc_lossy_blocksize_index.find(halfmt);
+    if (i >= 0)
+        return __halfmt_to_sbwc_lossy_blocksize[i][1];
 
     return 0;
 }
 
-static uint32_t __v4l2_fmt_with_blend[][2] = {
+static constexpr uint32_t __v4l2_fmt_with_blend[][2] = {
     {V4L2_PIX_FMT_NV12N,        V4L2_PIX_FMT_NV12N_RGB32    },
     {V4L2_PIX_FMT_NV12,         V4L2_PIX_FMT_NV12_RGB32     },
     {V4L2_PIX_FMT_NV12M,        V4L2_PIX_FMT_NV12M_RGB32    },
 };
 
+static constexpr auto __v4l2_fmt_with_blend_index =
+        makeFormatIndex(__v4l2_fmt_with_blend, [] (const auto &e) { return e[0]; });
+
 uint32_t v4l2_fmt_with_blend(uint32_t v4l2_fmt, uint32_t blend_halfmt)
 {
     if (blend_halfmt != HAL_PIXEL_FORMAT_RGBX_8888 && blend_halfmt != HAL_PIXEL_FORMAT_RGBA_8888) {
@@ -234,23 +248,16 @@ uint32_t v4l2_fmt_with_blend(uint32_t v4l2_fmt, uint32_t blend_halfmt)
         return 0;
     }
 
-    for (size_t i = 0 ; i < ARRSIZE(__v4l2_fmt_with_blend); i++) {
-        if (__v4l2_fmt_with_blend[i][0] == v4l2_fmt)
-            return __v4l2_fmt_with_blend[i][1];
-    }
+    int i = __v4l2_fmt_with_blend_index.find(v4l2_fmt);
+    if (i >= 0)
+        return __v4l2_fmt_with_blend[i][1];
 
     ALOGE("Unable to find the proper v4l2 format with blending %#x", v4l2_fmt);
 
     return 0; // it is alright to return 0 for an error because a fmt identifier is 4cc value
 }
 
-static struct {
-    uint32_t fmt;                   // HAL_PIXEL_FORMAT that describe how pixels are stored in memory
-    uint8_t  bufcnt;                // the number of buffer to describe @fmt
-    uint8_t  subfactor;             // Horizontal (upper 4 bits)and vertical (lower 4 bits) chroma subsampling factor
-    uint8_t  bpp[MAX_HW2D_PLANES];  // bits in a buffer per pixel
-    uint32_t equivalent;            // The equivalent format on a single buffer without H/W constraints
-} __halfmt_plane_bpp[] = {
+static constexpr halfmt_desc __halfmt_plane_bpp[] = {
     {HAL_PIXEL_FORMAT_RGBA_8888,                    1, 0x11, {32, 0, 0, 0}, HAL_PIXEL_FORMAT_RGBA_8888                },
     {HAL_PIXEL_FORMAT_BGRA_8888,                    1, 0x11, {32, 0, 0, 0}, HAL_PIXEL_FORMAT_BGRA_8888                },
     {HAL_PIXEL_FORMAT_RGBA_1010102,                 1, 0x11, {32, 0, 0, 0}, HAL_PIXEL_FORMAT_RGBA_1010102             },
@@ -281,6 +288,9 @@ static struct {
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M,          2, 0x22, {16, 8, 0, 0}, HAL_PIXEL_FORMAT_YCBCR_P010               },
 };
 
+static constexpr auto __halfmt_plane_bpp_index =
+        makeFormatIndex(__halfmt_plane_bpp, [] (const auto &e) { return e.fmt; });
+
 #define MFC_PAD_SIZE                256
 #define MFC_2B_PAD_SIZE             (MFC_PAD_SIZE / 4)
 #define MFC_ALIGN(v)                (((v) + 15) & ~15)
@@ -292,36 +302,57 @@ static struct {
 #define NV12_82_MFC_C_PAYLOAD(w, h) (NV12_MFC_C_PAYLOAD(w, h) + MFC_PAD_SIZE + MFC_ALIGN((w) / 4) * (h) / 2)
 #define NV12_82_MFC_PAYLOAD(w, h)   (NV12_MFC_Y_PAYLOAD(w, h) + MFC_PAD_SIZE + MFC_ALIGN((w) / 4) * MFC_ALIGN(h) + MFC_2B_PAD_SIZE + NV12_82_MFC_C_PAYLOAD(w, h))
 
-size_t halfmt_plane_length(uint32_t fmt, unsigned int plane, uint32_t width, uint32_t height)
+const halfmt_desc *halfmt_find_desc(uint32_t fmt)
 {
+    int i = __halfmt_plane_bpp_index.find(fmt);
+
+    return (i >= 0) ? &__halfmt_plane_bpp[i] : NULL;
+}
+
+unsigned int halfmt_plane_lengths(uint32_t fmt, uint32_t width, uint32_t height,
+                                  size_t len[MAX_HW2D_PLANES])
+{
+    for (int i = 0; i < MAX_HW2D_PLANES; i++)
+        len[i] = 0;
+
     switch (fmt) {
         case HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_S10B:
-            return NV12_82_MFC_PAYLOAD(width, height);
+            len[0] = NV12_82_MFC_PAYLOAD(width, height);
+            return 1;
         case HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_S10B:
-            return (plane == 0) ? NV12_82_MFC_Y_PAYLOAD(width, height) : NV12_82_MFC_C_PAYLOAD(width, height);
-        default:
-            for (size_t i = 0 ; i < ARRSIZE(__halfmt_plane_bpp); i++) {
-                if (__halfmt_plane_bpp[i].fmt == fmt) {
-                    LOGASSERT(plane < __halfmt_plane_bpp[i].bufcnt,
-                              "Plane count of HAL format %#x is %u but %d plane is requested",
-                              fmt, __halfmt_plane_bpp[i].bufcnt, plane);
-                    if (plane < __halfmt_plane_bpp[i].bufcnt)
-                        return (__halfmt_plane_bpp[i].bpp[plane] * width * height) / 8;
-                }
-            }
+            len[0] = NV12_82_MFC_Y_PAYLOAD(width, height);
+            len[1] = NV12_82_MFC_C_PAYLOAD(width, height);
+            return 2;
     }
 
-    LOGASSERT(1, "Unable to find HAL format %#x with plane %d", fmt, plane);
+    const halfmt_desc *desc = halfmt_find_desc(fmt);
+    if (!desc) {
+        LOGASSERT(1, "Unable to find HAL format %#x", fmt);
+        return 0;
+    }
 
-    return 0;
+    for (unsigned int i = 0; i < desc->bufcnt; i++)
+        len[i] = (desc->bpp[i] * width * height) / 8;
+
+    return desc->bufcnt;
+}
+
+size_t halfmt_plane_length(uint32_t fmt, unsigned int plane, uint32_t width, uint32_t height)
+{
+    size_t len[MAX_HW2D_PLANES];
+    unsigned int count = halfmt_plane_lengths(fmt, width, height, len);
+
+    LOGASSERT(plane < count, "Plane count of HAL format %#x is %u but %d plane is requested",
+              fmt, count, plane);
+
+    return (plane < count) ? len[plane] : 0;
 }
 
 unsigned int halfmt_bpp(uint32_t fmt)
 {
-    for (size_t i = 0 ; i < ARRSIZE(__halfmt_plane_bpp); i++) {
-        if (__halfmt_plane_bpp[i].fmt == fmt)
-                return __halfmt_plane_bpp[i].bpp[0] + __halfmt_plane_bpp[i].bpp[1] + __halfmt_plane_bpp[i].bpp[2];
-    }
+    const halfmt_desc *desc = halfmt_find_desc(fmt);
+    if (desc)
+        return desc->bpp[0] + desc->bpp[1] + desc->bpp[2];
 
     LOGASSERT(1, "Unable to find HAL format %#x", fmt);
 
@@ -331,10 +362,9 @@ unsigned int halfmt_bpp(uint32_t fmt)
 #define DEFINE_HALFMT_PROPERTY_GETTER(rettype, funcname, member)    \
     rettype funcname(uint32_t fmt)                                  \
     {                                                               \
-        for (size_t i = 0 ; i < ARRSIZE(__halfmt_plane_bpp); i++) { \
-            if (__halfmt_plane_bpp[i].fmt == fmt)                   \
-                return __halfmt_plane_bpp[i].member;                \
-        }                                                           \
+        const halfmt_desc *desc = halfmt_find_desc(fmt);            \
+        if (desc)                                                   \
+            return desc->member;                                    \
         LOGASSERT(1, "Unable to find HAL format %#x", fmt);         \
         return 0;                                                   \
     }
@@ -244,6 +244,11 @@ AcrylicCompositorM2M1SHOT2_G2D *AcrylicCompositorM2M1SHOT2_G2D::prescaleSource(
     if (upscaling && !!(layer.getTransform() & HAL_TRANSFORM_ROT_90))
         transit_image_size.swap();
 
+    // NOTE: The transit image is not processed in strips. The second stage
+    // is a single m2m1shot2 task that reads the whole transit image with the
+    // other layers, so strips would not reduce the bytes read or written.
+    // The transit image is already reduced by min_xy for downscaling, and its
+    // buffer is kept in the transit data across frames.
     // NOTE: No AFBC is applied to the transit image due to the simplicity
     // The transit image is likely a continous-tone image because it is required
     // to resampling video frames AFBC does not show a good performance to that
@@ -376,10 +381,12 @@ bool AcrylicCompositorM2M1SHOT2_G2D::prepareSource(m2m1shot2_image &image, Acryl
         image.fmt.crop.width = image_rect.size.hori;
         image.fmt.crop.height = image_rect.size.vert;
 
+        size_t payload[MAX_HW2D_PLANES];
+
+        halfmt_plane_lengths(layer.getFormat(), image.fmt.width,
+                             image.fmt.crop.height + image.fmt.crop.top, payload);
         for (unsigned int i = 0; i < image.num_planes; i++)
-            image.plane[i].payload = halfmt_plane_length(layer.getFormat(), i,
-                    image.fmt.width,
-                    image.fmt.crop.height + image.fmt.crop.top);
+            image.plane[i].payload = payload[i];
     }
 
     if (trf == HAL_TRANSFORM_ROT_270) {
@@ -440,7 +447,7 @@ bool AcrylicCompositorM2M1SHOT2_G2D::prepareSource(m2m1shot2_image &image, Acryl
     return true;
 }
 
-bool AcrylicCompositorM2M1SHOT2_G2D::executeG2D(int fence[], unsigned int num_fences, bool nonblocking)
+bool AcrylicCompositorM2M1SHOT2_G2D::executeG2D(int fence[], unsigned int num_fences, bool nonblocking, int *fdidx)
 {
     if (!validateAllLayers())
         return false;
@@ -468,8 +475,6 @@ bool AcrylicCompositorM2M1SHOT2_G2D::executeG2D(int fence[], unsigned int num_fe
         mMaxSourceCount = layercount;
     }
 
-    sortLayers();
-
     if (!prepareImage(mDesc.target, getCanvas())) {
         ALOGE("Failed to configure the target image");
         return false;
@@ -556,18 +561,24 @@ bool AcrylicCompositorM2M1SHOT2_G2D::executeG2D(int fence[], unsigned int num_fe
 
     debug_show_m2m1shot2(mDesc);
 
-    if (mDev.ioctl_single(M2M1SHOT2_IOC_PROCESS, &mDesc) < 0) {
+    if (mDev.ioctl_single(M2M1SHOT2_IOC_PROCESS, &mDesc, fdidx) < 0) {
         if (errno != EBUSY)
             ALOGERR("Failed to process a m2m1shot2 task to G2D");
 
+        recordFailure();
         return false;
     }
 
     if (!!(mDesc.flags & M2M1SHOT2_FLAG_ERROR)) {
         ALOGE("Error occurred during processing a m2m1shot2 task to G2D");
+        recordFailure();
         return false;
     }
 
+    recordSubmission(!!(mDesc.target.flags & M2M1SHOT2_IMGFLAG_RELEASE_FENCE) ? mDesc.target.fence : -1);
+    if (!nonblocking)
+        recordCompletion();
+
     getCanvas().clearSettingModified();
     getCanvas().setFence(-1);
 
@@ -610,7 +621,9 @@ bool AcrylicCompositorM2M1SHOT2_G2D::execute(int fence[], unsigned int num_fence
 
 bool AcrylicCompositorM2M1SHOT2_G2D::execute(int *handle)
 {
-    if (!executeG2D(NULL, 0, handle ? true : false)) {
+    int fdidx = -1;
+
+    if (!executeG2D(NULL, 0, handle ? true : false, handle ? &fdidx : NULL)) {
         // Clearing all acquire fences because their buffers are expired.
         // The clients should configure everything again to start new execution
         for (unsigned int i = 0; i < layerCount(); i++)
@@ -620,18 +633,19 @@ bool AcrylicCompositorM2M1SHOT2_G2D::execute(int *handle)
         return false;
     }
 
+    // The handle is the fd that the job is submitted to, 0 is for all jobs
     if (handle != NULL)
-        *handle = 1; /* dummy handle */
+        *handle = fdidx + 1;
 
     return true;
 }
 
-bool AcrylicCompositorM2M1SHOT2_G2D::waitExecution(int __unused handle)
+bool AcrylicCompositorM2M1SHOT2_G2D::waitG2D(int fdidx)
 {
-    LOG_FATAL(handle == 1);
+    mDev.complete(fdidx);
 
-    if ((mDev.ioctl_current(M2M1SHOT2_IOC_WAIT_PROCESS, &mDesc) < 0) && (errno != EAGAIN)) {
-        ALOGERR("Failed to wait the previous execution");
+    if ((mDev.ioctl_fd(fdidx, M2M1SHOT2_IOC_WAIT_PROCESS, &mDesc) < 0) && (errno != EAGAIN)) {
+        ALOGERR("Failed to wait the previous execution on devfd[%d]", fdidx);
         return false;
     }
 
@@ -642,8 +656,34 @@ bool AcrylicCompositorM2M1SHOT2_G2D::waitExecution(int __unused handle)
         return false;
     }
 
+    return true;
+}
+
+bool AcrylicCompositorM2M1SHOT2_G2D::waitExecution(int handle)
+{
+    if ((handle < 0) || (handle > MAX_DEVICE_FD)) {
+        ALOGE("Invalid handle %d to wait", handle);
+        return false;
+    }
+
+    bool success = true;
+
+    if (handle > 0) {
+        success = waitG2D(handle - 1);
+    } else {
+        for (int i = 0; i < MAX_DEVICE_FD; i++) {
+            if (mDev.isInFlight(i) && !waitG2D(i))
+                success = false;
+        }
+    }
+
+    if (!success)
+        return false;
+
     ALOGD_TEST("Waiting for execution of m2m1shot2 G2D completed by handle %d", handle);
 
+    recordCompletion();
+
     return true;
 }
 
@@ -42,7 +42,8 @@ public:
 protected:
     virtual void removeTransitData(AcrylicLayer *layer);
 private:
-    bool executeG2D(int fence[], unsigned int num_fences, bool nonblocking);
+    bool executeG2D(int fence[], unsigned int num_fences, bool nonblocking, int *fdidx = NULL);
+    bool waitG2D(int fdidx);
     bool prepareImage(m2m1shot2_image &image, AcrylicCanvas &layer);
     bool prepareSource(m2m1shot2_image &image, AcrylicLayer &layer,
                        uint32_t target_width, uint32_t target_height);
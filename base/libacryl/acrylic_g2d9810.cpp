@@ -20,6 +20,8 @@
 #include <algorithm>
 
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include <system/graphics.h>
 #include <log/log.h>
@@ -340,9 +342,16 @@ static g2d_fmt *halfmt_to_g2dfmt(struct g2d_fmt *tbl, size_t tbl_len, uint32_t h
     return NULL;
 }
 
+#define G2D_QOS_WINDOW          8
+#define G2D_QOS_SCALE_DEFAULT   100
+#define G2D_QOS_SCALE_MIN       50
+#define G2D_QOS_SCALE_MAX       200
+#define G2D_QOS_SCALE_STEP      25
+
 AcrylicCompositorG2D9810::AcrylicCompositorG2D9810(const HW2DCapability &capability, bool newcolormode)
     : Acrylic(capability), mDev((capability.maxLayerCount() > 2) ? "/dev/g2d" : "/dev/fimg2d"),
-      mMaxSourceCount(0), mPriority(-1)
+      mMaxSourceCount(0), mSourceCache(NULL), mPriority(-1), mQoSRequested(false),
+      mQoSScale(G2D_QOS_SCALE_DEFAULT), mQoSSamples(0), mQoSMaxLatency(0), mQoSMeasuredCount(0)
 {
     memset(&mTask, 0, sizeof(mTask));
 
@@ -365,6 +374,7 @@ AcrylicCompositorG2D9810::~AcrylicCompositorG2D9810()
     delete [] mTask.commands.target;
     for (unsigned int i = 0; i < mMaxSourceCount; i++)
         delete [] mTask.commands.source[i];
+    delete [] mSourceCache;
 
     ALOGD_TEST("Deleting Acrylic for G2D 9810 on %p", this);
 }
@@ -404,42 +414,28 @@ static unsigned int sbwc_lossy_formats[] = {
     HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L80,
 };
 
-bool AcrylicCompositorG2D9810::prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index)
+bool AcrylicCompositorG2D9810::prepareImageBuffer(AcrylicCanvas &layer, struct g2d_layer &image, unsigned int num_bufs)
 {
-    image.flags = 0;
-
     if (layer.getFence() >= 0) {
         image.flags |= G2D_LAYERFLAG_ACQUIRE_FENCE;
         image.fence = layer.getFence();
     }
 
-    if (layer.isProtected())
-        image.flags |= G2D_LAYERFLAG_SECURE;
-
-    g2d_fmt *g2dfmt = halfmt_to_g2dfmt(halfmt_to_g2dfmt_tbl, len_halfmt_to_g2dfmt_tbl, layer.getFormat());
-    if (!g2dfmt)
-        return false;
-
-    image.flags &= ~G2D_LAYERFLAG_MFC_STRIDE;
-    for (size_t i = 0; i < ARRSIZE(mfc_stride_formats); i++) {
-        if (layer.getFormat() == mfc_stride_formats[i]) {
-            image.flags |= G2D_LAYERFLAG_MFC_STRIDE;
-            break;
-        }
-    }
-
     if (layer.getBufferType() == AcrylicCanvas::MT_EMPTY) {
         image.buffer_type = G2D_BUFTYPE_EMPTY;
     } else {
-        if (layer.getBufferCount() < g2dfmt->num_bufs) {
+        if (layer.getBufferCount() < num_bufs) {
             ALOGE("HAL Format %#x requires %d buffers but %d buffers are given",
-                    layer.getFormat(), g2dfmt->num_bufs, layer.getBufferCount());
+                    layer.getFormat(), num_bufs, layer.getBufferCount());
             return false;
         }
 
         if (layer.getBufferType() == AcrylicCanvas::MT_DMABUF) {
+            // The driver attaches and maps dmabufs for every task. There is no
+            // ioctl to register a buffer once, so it is identified by fd here
+            // and the mapping should be cached by the driver if needed.
             image.buffer_type = G2D_BUFTYPE_DMABUF;
-            for (unsigned int i = 0; i < g2dfmt->num_bufs; i++) {
+            for (unsigned int i = 0; i < num_bufs; i++) {
                 image.buffer[i].dmabuf.fd = layer.getDmabuf(i);
                 image.buffer[i].dmabuf.offset = layer.getOffset(i);
                 image.buffer[i].length = layer.getBufferLength(i);
@@ -448,14 +444,39 @@ bool AcrylicCompositorG2D9810::prepareImage(AcrylicCanvas &layer, struct g2d_lay
             LOGASSERT(layer.getBufferType() == AcrylicCanvas::MT_USERPTR,
                       "Unknown buffer type %d", layer.getBufferType());
             image.buffer_type = G2D_BUFTYPE_USERPTR;
-            for (unsigned int i = 0; i < g2dfmt->num_bufs; i++) {
+            for (unsigned int i = 0; i < num_bufs; i++) {
                 image.buffer[i].userptr = layer.getUserptr(i);
                 image.buffer[i].length = layer.getBufferLength(i);
             }
         }
     }
 
-    image.num_buffers = g2dfmt->num_bufs;
+    image.num_buffers = num_bufs;
+
+    return true;
+}
+
+bool AcrylicCompositorG2D9810::prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index)
+{
+    image.flags = 0;
+
+    if (layer.isProtected())
+        image.flags |= G2D_LAYERFLAG_SECURE;
+
+    g2d_fmt *g2dfmt = halfmt_to_g2dfmt(halfmt_to_g2dfmt_tbl, len_halfmt_to_g2dfmt_tbl, layer.getFormat());
+    if (!g2dfmt)
+        return false;
+
+    image.flags &= ~G2D_LAYERFLAG_MFC_STRIDE;
+    for (size_t i = 0; i < ARRSIZE(mfc_stride_formats); i++) {
+        if (layer.getFormat() == mfc_stride_formats[i]) {
+            image.flags |= G2D_LAYERFLAG_MFC_STRIDE;
+            break;
+        }
+    }
+
+    if (!prepareImageBuffer(layer, image, g2dfmt->num_bufs))
+        return false;
 
     hw2d_coord_t xy = layer.getImageDimension();
 
@@ -754,6 +775,8 @@ bool AcrylicCompositorG2D9810::reallocLayer(unsigned int layercount)
     delete [] mTask.source;
     for (unsigned int i = 0; i < mMaxSourceCount; i++)
         delete [] mTask.commands.source[i];
+    delete [] mSourceCache;
+    mSourceCache = NULL;
 
     mMaxSourceCount = 0;
 
@@ -779,11 +802,58 @@ bool AcrylicCompositorG2D9810::reallocLayer(unsigned int layercount)
 	memset(mTask.commands.source[i], 0, sizeof(uint32_t) * G2DSFR_SRC_FIELD_COUNT);
     }
 
+    mSourceCache = new G2DCommandCache[layercount];
+    if (!mSourceCache) {
+        ALOGE("Failed to allocate %u command caches", layercount);
+        return false;
+    }
+
     mMaxSourceCount = layercount;
 
     return true;
 }
 
+static_assert(G2DSFR_SRC_FIELD_COUNT >= G2DSFR_DST_FIELD_COUNT,
+              "G2DCommandCache should be able to store target commands");
+
+// A new canvas always has modified settings because the mandatory settings are
+// modified. Settings are cleared after every successful execution, so a cache is valid
+// only if it was stored or used in the last execution. Unused caches are invalidated.
+bool AcrylicCompositorG2D9810::isCommandCached(G2DCommandCache &cache, AcrylicCanvas &canvas,
+                                               hw2d_coord_t target_size, int index)
+{
+    uint32_t modified = canvas.getSettingFlags() & AcrylicCanvas::SETTING_MODIFIED_MASK;
+
+    return cache.valid && (cache.canvas == &canvas) && (cache.index == index) &&
+           (cache.attributes == canvas.getAttributes()) &&
+           (cache.target_size.hori == target_size.hori) &&
+           (cache.target_size.vert == target_size.vert) &&
+           !(modified & ~AcrylicCanvas::SETTING_BUFFER_MODIFIED);
+}
+
+void AcrylicCompositorG2D9810::storeCommandCache(G2DCommandCache &cache, AcrylicCanvas &canvas,
+                                                 struct g2d_layer &image, uint32_t cmd[], unsigned int count,
+                                                 hw2d_coord_t target_size, int index)
+{
+    cache.canvas = &canvas;
+    cache.attributes = canvas.getAttributes();
+    cache.target_size = target_size;
+    cache.index = index;
+    cache.flags = image.flags & ~G2D_LAYERFLAG_ACQUIRE_FENCE;
+    cache.num_buffers = image.num_buffers;
+    memcpy(cache.cmd, cmd, sizeof(uint32_t) * count);
+    cache.valid = true;
+}
+
+bool AcrylicCompositorG2D9810::restoreCommandCache(G2DCommandCache &cache, AcrylicCanvas &canvas,
+                                                   struct g2d_layer &image, uint32_t cmd[], unsigned int count)
+{
+    image.flags = cache.flags;
+    memcpy(cmd, cache.cmd, sizeof(uint32_t) * count);
+
+    return prepareImageBuffer(canvas, image, cache.num_buffers);
+}
+
 int AcrylicCompositorG2D9810::ioctlG2D(void)
 {
     if (mVersion == 1) {
@@ -1017,6 +1087,16 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
 
     unsigned int layercount = layerCount();
 
+    if (layercount > 0) {
+        AcrylicLayer *layers[layercount];
+
+        for (unsigned int i = 0; i < layercount; i++)
+            layers[i] = getLayer(i);
+
+        if (mCPUBlitter.isEligible(getCanvas(), layers, layercount, hasBackgroundColor()))
+            return executeCPU(fence, num_fences);
+    }
+
     // Set invalid fence fd to the entries exceeds the number of source and destination images
     for (unsigned int i = layercount; i < num_fences; i++)
         fence[i] = -1;
@@ -1042,13 +1122,22 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     if (!reallocLayer(layercount))
         return false;
 
-    sortLayers();
-
     mTask.flags = 0;
 
-    if (!prepareImage(getCanvas(), mTask.target, mTask.commands.target, -1)) {
+    hw2d_coord_t no_target = {0, 0};
+    if (isCommandCached(mTargetCache, getCanvas(), no_target, -1)) {
+        if (!restoreCommandCache(mTargetCache, getCanvas(), mTask.target,
+                                 mTask.commands.target, G2DSFR_DST_FIELD_COUNT)) {
+            ALOGE("Failed to configure the target image");
+            return false;
+        }
+    } else if (!prepareImage(getCanvas(), mTask.target, mTask.commands.target, -1)) {
+        mTargetCache.valid = false;
         ALOGE("Failed to configure the target image");
         return false;
+    } else {
+        storeCommandCache(mTargetCache, getCanvas(), mTask.target, mTask.commands.target,
+                          G2DSFR_DST_FIELD_COUNT, no_target, -1);
     }
 
     if (getCanvas().isOTF())
@@ -1059,8 +1148,12 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     if (hasBackground) {
         baseidx++;
         prepareSolidLayer(getCanvas(), mTask.source[0], mTask.commands.source[0]);
+        mSourceCache[0].valid = false;
     }
 
+    for (unsigned int i = layercount; i < mMaxSourceCount; i++)
+        mSourceCache[i].valid = false;
+
     mTask.commands.target[G2DSFR_DST_YCBCRMODE] = 0;
 
     CSCMatrixWriter cscMatrixWriter(mTask.commands.target[G2DSFR_IMG_COLORMODE],
@@ -1072,12 +1165,27 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     unsigned int layer_premult = 0;
     for (unsigned int i = baseidx; i < layercount; i++) {
         AcrylicLayer &layer = *getLayer(i - baseidx);
-
-        if (!prepareSource(layer, mTask.source[i],
-                           mTask.commands.source[i], getCanvas().getImageDimension(),
-                           i - baseidx)) {
+        G2DCommandCache &cache = mSourceCache[i];
+        hw2d_coord_t target_size = getCanvas().getImageDimension();
+
+        // Commands of solid color layers are simple enough to be generated every time
+        if (!layer.isSolidColor() && isCommandCached(cache, layer, target_size, i - baseidx)) {
+            if (!restoreCommandCache(cache, layer, mTask.source[i],
+                                     mTask.commands.source[i], G2DSFR_SRC_FIELD_COUNT)) {
+                ALOGE("Failed to configure source layer %u", i - baseidx);
+                return false;
+            }
+        } else if (!prepareSource(layer, mTask.source[i],
+                                  mTask.commands.source[i], target_size,
+                                  i - baseidx)) {
+            cache.valid = false;
             ALOGE("Failed to configure source layer %u", i - baseidx);
             return false;
+        } else if (layer.isSolidColor()) {
+            cache.valid = false;
+        } else {
+            storeCommandCache(cache, layer, mTask.source[i], mTask.commands.source[i],
+                              G2DSFR_SRC_FIELD_COUNT, target_size, i - baseidx);
         }
 
         if (!cscMatrixWriter.configure(mTask.commands.source[i][G2DSFR_IMG_COLORMODE],
@@ -1149,6 +1257,7 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     if (ioctlG2D() < 0) {
         ALOGERR("Failed to process a task");
         show_g2d_task(mTask);
+        recordFailure();
         return false;
     }
 
@@ -1157,9 +1266,14 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     if (!!(mTask.flags & G2D_FLAG_ERROR)) {
         ALOGE("Error occurred during processing a task to G2D");
         show_g2d_task(mTask);
+        recordFailure();
         return false;
     }
 
+    recordSubmission((mTask.num_release_fences > 0) ? mTask.release_fence[0] : -1);
+    if (!nonblocking)
+        recordCompletion(mTask.laptime_in_usec);
+
     getCanvas().clearSettingModified();
     getCanvas().setFence(-1);
 
@@ -1174,6 +1288,45 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     return true;
 }
 
+bool AcrylicCompositorG2D9810::executeCPU(int fence[], unsigned int num_fences)
+{
+    AcrylicLayer *layers[layerCount()];
+    uint16_t r, g, b, a;
+
+    for (unsigned int i = 0; i < layerCount(); i++)
+        layers[i] = getLayer(i);
+
+    getBackgroundColor(&r, &g, &b, &a);
+    uint32_t background = ((a & 0xFF00) << 16) | ((r & 0xFF00) << 8) | (g & 0xFF00) | (b >> 8);
+
+    // The commands in the caches are not applied to the configuration of this job
+    mTargetCache.valid = false;
+    for (unsigned int i = 0; i < mMaxSourceCount; i++)
+        mSourceCache[i].valid = false;
+
+    recordSubmission();
+    if (!mCPUBlitter.execute(getCanvas(), layers, layerCount(), hasBackgroundColor(), background)) {
+        ALOGE("Failed to process a task by CPU");
+        recordFailure();
+        return false;
+    }
+    recordCompletion();
+
+    getCanvas().clearSettingModified();
+    getCanvas().setFence(-1);
+
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        getLayer(i)->clearSettingModified();
+        getLayer(i)->setFence(-1);
+    }
+
+    // No release fence is required because the job is already done
+    for (unsigned int i = 0; i < num_fences; i++)
+        fence[i] = -1;
+
+    return true;
+}
+
 bool AcrylicCompositorG2D9810::execute(int fence[], unsigned int num_fences)
 {
     if (!executeG2D(fence, num_fences, true)) {
@@ -1191,7 +1344,10 @@ bool AcrylicCompositorG2D9810::execute(int fence[], unsigned int num_fences)
 
 bool AcrylicCompositorG2D9810::execute(int *handle)
 {
-    if (!executeG2D(NULL, 0, handle ? true : false)) {
+    // The release fence of the task is the handle of the asynchronous execution
+    int fence = -1;
+
+    if (!executeG2D(handle ? &fence : NULL, handle ? 1 : 0, handle ? true : false)) {
         // Clearing all acquire fences because their buffers are expired.
         // The clients should configure everything again to start new execution
         for (unsigned int i = 0; i < layerCount(); i++)
@@ -1202,16 +1358,86 @@ bool AcrylicCompositorG2D9810::execute(int *handle)
     }
 
     if (handle != NULL)
-        *handle = 1; /* dummy handle */
+        *handle = fence;
 
     return true;
 }
 
-bool AcrylicCompositorG2D9810::waitExecution(int __unused handle)
+#define G2D_WAIT_TIMEOUT_MSEC 1000
+
+bool AcrylicCompositorG2D9810::waitExecution(int handle)
 {
-    ALOGD_TEST("Waiting for execution of m2m1shot2 G2D completed by handle %d", handle);
+    // No fence is given if the driver failed to create it but the task is still running
+    if (handle < 0)
+        return true;
 
-    return true;
+    ALOGD_TEST("Waiting for execution of G2D completed by handle %d", handle);
+
+    struct pollfd pfd = { handle, POLLIN, 0 };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, G2D_WAIT_TIMEOUT_MSEC);
+    } while ((ret < 0) && ((errno == EINTR) || (errno == EAGAIN)));
+
+    bool success = true;
+    if (ret == 0) {
+        ALOGE("Timed out waiting for execution of G2D by handle %d", handle);
+        success = false;
+    } else if ((ret < 0) || !!(pfd.revents & (POLLERR | POLLNVAL))) {
+        ALOGERR("Failed to wait for execution of G2D by handle %d", handle);
+        success = false;
+    }
+
+    close(handle);
+
+    if (success)
+        recordCompletion();
+
+    return success;
+}
+
+void AcrylicCompositorG2D9810::releaseHandle(int handle)
+{
+    if (handle >= 0)
+        close(handle);
+}
+
+unsigned int AcrylicCompositorG2D9810::updateQoSScale(unsigned int frame_rate)
+{
+    const AcrylicStats &stats = getStats();
+
+    if (stats.measured_count != mQoSMeasuredCount) {
+        // The latency of a job with acquire fences includes the time waiting for
+        // them. The processing time reported by the driver is preferred if any.
+        unsigned int latency = stats.last_hw_usec ? stats.last_hw_usec : stats.last_latency_usec;
+
+        mQoSMeasuredCount = stats.measured_count;
+        mQoSMaxLatency = std::max(mQoSMaxLatency, latency);
+        mQoSSamples++;
+    }
+
+    if ((mQoSSamples < G2D_QOS_WINDOW) || (frame_rate == 0))
+        return mQoSScale;
+
+    // Step up if the slowest job in the window gets close to the frame deadline
+    // and step down if all jobs in the window are completed well before it.
+    unsigned int deadline = 1000000 / frame_rate;
+    unsigned int scale = mQoSScale;
+
+    if (mQoSMaxLatency > (deadline * 3 / 4))
+        scale = std::min(scale + G2D_QOS_SCALE_STEP, static_cast<unsigned int>(G2D_QOS_SCALE_MAX));
+    else if (mQoSMaxLatency < (deadline / 3))
+        scale = std::max(scale - G2D_QOS_SCALE_STEP, static_cast<unsigned int>(G2D_QOS_SCALE_MIN));
+
+    if (scale != mQoSScale)
+        ALOGD_TEST("QoS scale %u%% -> %u%%: max latency %uus, deadline %uus",
+                   mQoSScale, scale, mQoSMaxLatency, deadline);
+
+    mQoSScale = scale;
+    mQoSSamples = 0;
+    mQoSMaxLatency = 0;
+
+    return mQoSScale;
 }
 
 bool AcrylicCompositorG2D9810::requestPerformanceQoS(AcrylicPerformanceRequest *request)
@@ -1220,17 +1446,34 @@ bool AcrylicCompositorG2D9810::requestPerformanceQoS(AcrylicPerformanceRequest *
 
     memset(&data, 0, sizeof(data));
 
-    if (!request || (request->getFrameCount() == 0)) {
+    if (!request || (request->getFrameCount() == 0) || (mPriority == 0)) {
+        // The measurement is restarted when the next request is made
+        mQoSSamples = 0;
+        mQoSMaxLatency = 0;
+
+        if (!mQoSRequested && request && (request->getFrameCount() > 0)) {
+            ALOGD_TEST("Ignored performance request of background jobs");
+            return true;
+        }
+
         if (mDev.ioctl(G2D_IOC_PERFORMANCE, &data) < 0) {
             ALOGERR("Failed to cancel performance request");
             return false;
         }
 
+        mQoSRequested = false;
+
         ALOGD_TEST("Canceled performance request");
         return true;
     }
 
-    ALOGD_TEST("Requesting performance: frame count %d:", request->getFrameCount());
+    int frame_rate = 0;
+    for (int i = 0; i < request->getFrameCount(); i++)
+        frame_rate = std::max(frame_rate, request->getFrame(i)->mFrameRate);
+
+    unsigned int scale = updateQoSScale(frame_rate);
+
+    ALOGD_TEST("Requesting performance: frame count %d, scale %u%%:", request->getFrameCount(), scale);
     for (int i = 0; i < request->getFrameCount(); i++) {
         AcrylicPerformanceRequestFrame *frame = request->getFrame(i);
         uint64_t bandwidth = 0;
@@ -1303,6 +1546,7 @@ bool AcrylicCompositorG2D9810::requestPerformanceQoS(AcrylicPerformanceRequest *
 
         bandwidth *= frame->mFrameRate;
         bandwidth >>= 17; // divide by 16(weight), 8(bpp) and 1024(kilobyte)
+        bandwidth = bandwidth * scale / 100;
 
         data.frame[i].bandwidth_read = static_cast<uint32_t>(bandwidth);
 
@@ -1316,6 +1560,7 @@ bool AcrylicCompositorG2D9810::requestPerformanceQoS(AcrylicPerformanceRequest *
         // RSH 12 : bw * 2 / (bits_per_byte * kilobyte)
         // RHS 13 : bw * 1 / (bits_per_byte * kilobyte)
         bandwidth >>= ((bpp == 12) && src_yuv420 && src_rotate) ? 12 : 13;
+        bandwidth = bandwidth * scale / 100;
         data.frame[i].bandwidth_write = static_cast<uint32_t>(bandwidth);
 
         if (frame->mHasBackgroundLayer)
@@ -1338,6 +1583,8 @@ bool AcrylicCompositorG2D9810::requestPerformanceQoS(AcrylicPerformanceRequest *
         return false;
     }
 
+    mQoSRequested = true;
+
     return true;
 }
 
@@ -1378,6 +1625,9 @@ int AcrylicCompositorG2D9810::prioritize(int priority)
 
     mPriority = priority;
 
+    if ((mPriority == 0) && mQoSRequested)
+        requestPerformanceQoS(NULL);
+
     return 0;
 }
 
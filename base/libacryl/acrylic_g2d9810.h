@@ -28,6 +28,7 @@
 
 #include "acrylic_internal.h"
 #include "acrylic_device.h"
+#include "acrylic_cpu.h"
 
 class G2DHdrWriter {
     IG2DHdr10CommandWriter *mWriter;
@@ -115,13 +116,34 @@ struct g2d_fmt;
 
 #define MAX_HDR_SET 4
 
+/*
+ * Commands of a canvas generated by prepareImage() or prepareSource().
+ * They are reused while nothing but the buffer of the canvas is modified.
+ * Buffers and fences are configured to g2d_layer on every execution.
+ */
+struct G2DCommandCache {
+    AcrylicCanvas *canvas = nullptr;
+    uint32_t attributes = 0;
+    hw2d_coord_t target_size = {0, 0};
+    int index = 0;
+    uint32_t flags = 0;
+    uint32_t num_buffers = 0;
+    bool valid = false;
+    uint32_t cmd[G2DSFR_SRC_FIELD_COUNT];
+};
+
 class AcrylicCompositorG2D9810: public Acrylic {
 public:
     AcrylicCompositorG2D9810(const HW2DCapability &capability, bool newcolormode);
     virtual ~AcrylicCompositorG2D9810();
     virtual bool execute(int fence[], unsigned int num_fences);
     virtual bool execute(int *handle = NULL);
+    /*
+     * Handles are release fences of tasks. Several tasks can be in flight
+     * and each of them is waited or released with its own handle.
+     */
     virtual bool waitExecution(int handle);
+    virtual void releaseHandle(int handle);
     virtual unsigned int getLaptimeUSec() { return mTask.laptime_in_usec; }
     /*
      * Return -1 on failure in configuring the give priority or the priority is invalid.
@@ -137,11 +159,19 @@ public:
 private:
     int ioctlG2D(void);
     bool executeG2D(int fence[], unsigned int num_fences, bool nonblocking);
+    bool executeCPU(int fence[], unsigned int num_fences);
     bool prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index);
+    bool prepareImageBuffer(AcrylicCanvas &layer, struct g2d_layer &image, unsigned int num_bufs);
     bool prepareSource(AcrylicLayer &layer, struct g2d_layer &image, uint32_t cmd[], hw2d_coord_t target_size, int index);
     bool prepareSolidLayer(AcrylicCanvas &canvas, struct g2d_layer &image, uint32_t cmd[]);
     bool prepareSolidLayer(AcrylicLayer &layer, struct g2d_layer &image, uint32_t cmd[], hw2d_coord_t target_size, int index);
     bool reallocLayer(unsigned int layercount);
+    bool isCommandCached(G2DCommandCache &cache, AcrylicCanvas &canvas, hw2d_coord_t target_size, int index);
+    void storeCommandCache(G2DCommandCache &cache, AcrylicCanvas &canvas, struct g2d_layer &image,
+                           uint32_t cmd[], unsigned int count, hw2d_coord_t target_size, int index);
+    bool restoreCommandCache(G2DCommandCache &cache, AcrylicCanvas &canvas, struct g2d_layer &image,
+                             uint32_t cmd[], unsigned int count);
+    unsigned int updateQoSScale(unsigned int frame_rate);
     unsigned int setHdrLibCommand(g2d_reg regs[]);
     void setHdrLayerCommand(g2d_task &task, unsigned int layer_premult);
 
@@ -149,8 +179,29 @@ private:
     g2d_task	  mTask;
     G2DHdrWriter  mHdrWriter;
     unsigned int  mMaxSourceCount;
+    G2DCommandCache mTargetCache;
+    G2DCommandCache *mSourceCache;
     int mPriority;
     unsigned int mVersion;
+    /*
+     * The priority 0 is of the background jobs like screenshots and dumps.
+     * They do not request QoS not to raise the clock for the jobs without
+     * deadlines, and the request made before is canceled.
+     */
+    bool mQoSRequested;
+    /*
+     * Percentage applied to the bandwidth requested to the driver. It is
+     * stepped by the latencies of the jobs measured in a window of frames.
+     */
+    unsigned int mQoSScale;
+    unsigned int mQoSSamples;
+    unsigned int mQoSMaxLatency;
+    uint64_t mQoSMeasuredCount;
+    /*
+     * Tiny jobs are composited by CPU because it is faster than the round trip
+     * to the driver and powering up G2D.
+     */
+    AcrylicCPUBlitter mCPUBlitter;
 
     g2d_fmt *halfmt_to_g2dfmt_tbl;
     size_t len_halfmt_to_g2dfmt_tbl;
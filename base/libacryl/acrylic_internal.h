@@ -112,13 +112,38 @@ static inline bool area_is_zero(hw2d_rect_t rect)
     return (rect.size.hori == 0) && (rect.size.vert == 0);
 }
 
+static inline bool rect_is_same(hw2d_rect_t a, hw2d_rect_t b)
+{
+    return (a.pos.hori == b.pos.hori) && (a.pos.vert == b.pos.vert) &&
+           (a.size.hori == b.size.hori) && (a.size.vert == b.size.vert);
+}
+
 uint32_t halfmt_to_v4l2(uint32_t halfmt);
 uint32_t halfmt_to_v4l2_deprecated(uint32_t halfmt);
 uint32_t v4l2_deprecated_to_halfmt(uint32_t v4l2_fmt);
 uint8_t get_block_size_from_halfmt(uint32_t halfmt);
 uint32_t v4l2_fmt_with_blend(uint32_t v4l2_fmt, uint32_t blend_halfmt);
+/*
+ * Properties of a HAL pixel format. halfmt_find_desc() returns all of them
+ * by a single lookup, or NULL if @fmt is unknown.
+ */
+struct halfmt_desc {
+    uint32_t fmt;                   // HAL_PIXEL_FORMAT that describe how pixels are stored in memory
+    uint8_t  bufcnt;                // the number of buffer to describe @fmt
+    uint8_t  subfactor;             // Horizontal (upper 4 bits)and vertical (lower 4 bits) chroma subsampling factor
+    uint8_t  bpp[MAX_HW2D_PLANES];  // bits in a buffer per pixel
+    uint32_t equivalent;            // The equivalent format on a single buffer without H/W constraints
+};
+
+const halfmt_desc *halfmt_find_desc(uint32_t fmt);
 unsigned int halfmt_plane_count(uint32_t fmt);
 size_t halfmt_plane_length(uint32_t fmt, unsigned int plane, uint32_t width, uint32_t height);
+/*
+ * Stores the payloads of all planes of @fmt to @len and returns the number
+ * of the planes. The entries of @len beyond the planes are zero.
+ */
+unsigned int halfmt_plane_lengths(uint32_t fmt, uint32_t width, uint32_t height,
+                                  size_t len[MAX_HW2D_PLANES]);
 uint32_t haldataspace_to_v4l2(int dataspace, uint32_t width, uint32_t height);
 uint32_t haldataspace_to_range(int dataspace, uint32_t width, uint32_t height);
 uint32_t find_format_equivalent(uint32_t fmt);
@@ -377,9 +377,15 @@ bool AcrylicLayer::setCompositMode(uint32_t mode, uint8_t alpha, int z_order)
         return false;
     }
 
+    if ((mBlendingMode != mode) || (mZOrder != z_order) || (mPlaneAlpha != alpha))
+        set(SETTING_COMPOSIT_MODIFIED);
+
     mBlendingMode = mode;
 
-    mZOrder = z_order;
+    if (mZOrder != z_order) {
+        mZOrder = z_order;
+        getCompositor()->reorderLayer(this);
+    }
     mPlaneAlpha = alpha;
 
     ALOGD_TEST("Configured compositing mode: mode %d, z-order %d, alpha %d",
@@ -474,6 +480,11 @@ bool AcrylicLayer::setCompositArea(hwc_rect_t &src_area, hwc_rect_t &out_area, u
         }
     }
 
+    hw2d_rect_t target = mTargetRect;
+    hw2d_rect_t image = mImageRect;
+    uint32_t transform_prev = mTransform;
+    uint32_t attr_prev = mCompositAttr;
+
     mTargetRect.pos.hori = static_cast<int16_t>(out_area.left);
     mTargetRect.pos.vert = static_cast<int16_t>(out_area.top);
     mTargetRect.size.hori = static_cast<int16_t>(get_width(out_area));
@@ -487,6 +498,10 @@ bool AcrylicLayer::setCompositArea(hwc_rect_t &src_area, hwc_rect_t &out_area, u
     mTransform = transform;
     mCompositAttr = attr & ATTR_ALL_MASK;
 
+    if (!rect_is_same(target, mTargetRect) || !rect_is_same(image, mImageRect) ||
+            (transform_prev != mTransform) || (attr_prev != mCompositAttr))
+        set(SETTING_COMPOSIT_MODIFIED);
+
     ALOGD_TEST("Configured area: %dx%d@%dx%d -> %dx%d@%dx%d, transform: %d, attr: %#x",
                 mImageRect.size.hori, mImageRect.size.vert, mImageRect.pos.hori, mImageRect.pos.vert,
                 mTargetRect.size.hori, mTargetRect.size.vert, mTargetRect.pos.hori, mTargetRect.pos.vert,
@@ -501,8 +516,11 @@ bool AcrylicLayer::setImageDimension(int32_t width, int32_t height)
         return false;
 
     // NOTE: the crop area should be initialized with the new image size
+    hw2d_rect_t image = mImageRect;
     mImageRect.pos = {0, 0};
     mImageRect.size = getImageDimension();
+    if (!rect_is_same(image, mImageRect))
+        set(SETTING_COMPOSIT_MODIFIED);
 
     ALOGD_TEST("Reset the image rect to %dx%d@0x0", mImageRect.size.hori, mImageRect.size.vert);
 
@@ -565,4 +583,5 @@ void AcrylicLayer::importLayer(AcrylicLayer &other, bool inherit_transform)
     mImageRect = other.mImageRect;
     if (inherit_transform)
         mTransform = other.mTransform;
+    set(SETTING_COMPOSIT_MODIFIED);
 }
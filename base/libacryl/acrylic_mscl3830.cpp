@@ -1,3 +1,4 @@
+#include <cerrno>
 #include <cstring>
 #include <new>
 
@@ -144,9 +145,6 @@ bool AcrylicCompositorMSCL3830::resetMode()
     if (area_is_zero(crop))
         crop.size = getCanvas().getImageDimension();
 
-    if ((crop != mCurrentCrop[TARGET]) || (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE]))
-        reset_required = true;
-
     if (((getLayer(0)->getSettingFlags() | getCanvas().getSettingFlags()) & mod_flags) != 0)
         reset_required = true;
 
@@ -158,6 +156,12 @@ bool AcrylicCompositorMSCL3830::resetMode()
         mTransformChanged = false;
     }
 
+    // Only the crops are changed, try to keep streaming
+    if (!reset_required && ((crop != mCurrentCrop[TARGET]) ||
+            (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE])) &&
+            !updateCrop(getLayer(0)->getImageRect(), crop))
+        reset_required = true;
+
     if (reset_required) {
         // Ignore the return value because we have no choice when it is false.
         resetMode(*getLayer(0), SOURCE);
@@ -171,6 +175,55 @@ bool AcrylicCompositorMSCL3830::resetMode()
     return true;
 }
 
+/*
+ * Applies the crop changes of a streaming job without the re-negotiation.
+ * The scaler takes the selection of the next job while it is streaming if
+ * its driver allows it. False if the crops should be set by changeMode().
+ */
+bool AcrylicCompositorMSCL3830::updateCrop(hw2d_rect_t source, hw2d_rect_t target)
+{
+    if (!mRuntimeUpdateSupported || getLayer(1) || !testDeviceState(SOURCE, STATE_REQBUFS) ||
+            !testDeviceState(TARGET, STATE_REQBUFS))
+        return false;
+
+    if ((source != mCurrentCrop[SOURCE]) &&
+            !setSelection(source, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_SEL_TGT_CROP))
+        return false;
+    mCurrentCrop[SOURCE] = source;
+
+    if ((target != mCurrentCrop[TARGET]) &&
+            !setSelection(target, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_SEL_TGT_COMPOSE))
+        return false;
+    mCurrentCrop[TARGET] = target;
+
+    return true;
+}
+
+bool AcrylicCompositorMSCL3830::setSelection(hw2d_rect_t rect, v4l2_buf_type buftype, uint32_t target)
+{
+    v4l2_selection sel;
+
+    memset(&sel, 0, sizeof(sel));
+    sel.type = buftype;
+    sel.target = target;
+    sel.r.left = rect.pos.hori;
+    sel.r.top = rect.pos.vert;
+    sel.r.width = rect.size.hori;
+    sel.r.height = rect.size.vert;
+    ALOGD_TEST("VIDIOC_S_SELECTION: type=%d, target=%d, left=%d, top=%d, width=%d, height=%d",
+            buftype, target, sel.r.left, sel.r.top, sel.r.width, sel.r.height);
+    if (mDev.ioctl(VIDIOC_S_SELECTION, &sel) < 0) {
+        // The driver needs the re-negotiation for the crop changes
+        if ((errno == EBUSY) || (errno == ENOTTY)) {
+            ALOGI("Crop changes while streaming are not supported, error %d", errno);
+            mRuntimeUpdateSupported = false;
+        }
+        return false;
+    }
+
+    return true;
+}
+
 bool AcrylicCompositorMSCL3830::changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir)
 {
     if (testDeviceState(dir, STATE_REQBUFS))
@@ -426,7 +479,8 @@ bool AcrylicCompositorMSCL3830::setTransform()
     uint32_t trdiff = mCurrentTransform ^ getLayer(0)->getTransform();
     v4l2_control ctrl;
 
-    mTransformChanged = !!trdiff;
+    // Rotation swaps the target size, but flips are applied to the next job
+    mTransformChanged = (trdiff & HAL_TRANSFORM_ROT_90) || (!!trdiff && !mRuntimeUpdateSupported);
 
     // TODO: consider to use rot 180 and 270
     if (trdiff & HAL_TRANSFORM_FLIP_H) {
@@ -592,11 +646,16 @@ bool AcrylicCompositorMSCL3830::queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION
         buffer.reserved = -1;
     }
 
+    size_t payload[MAX_HW2D_PLANES];
+
+    if (output)
+        halfmt_plane_lengths(canvas.getFormat(), canvas.getImageDimension().hori,
+                             mCurrentCrop[SOURCE].size.vert, payload);
+
     for (unsigned int i = 0; i < canvas.getBufferCount(); i++) {
         plane[i].length = canvas.getBufferLength(i);
         if (output)
-            plane[i].bytesused = halfmt_plane_length(canvas.getFormat(), i,
-                                canvas.getImageDimension().hori, mCurrentCrop[SOURCE].size.vert);
+            plane[i].bytesused = payload[i];
         if (dmabuf)
             plane[i].m.fd = canvas.getDmabuf(i);
         else
@@ -679,6 +738,8 @@ bool AcrylicCompositorMSCL3830::queueBuffer(int fence[], unsigned int num_fences
         setDeviceState(SOURCE, STATE_QBUF);
         setDeviceState(TARGET, STATE_QBUF);
 
+        recordSubmission((release_fence[TARGET] >= 0) ? release_fence[TARGET] : release_fence[SOURCE]);
+
         unsigned int j;
         for (j = 0; j < num_fences; j++) {
             if (j < NUM_IMAGES)
@@ -808,7 +869,12 @@ bool AcrylicCompositorMSCL3830::execute(int fence[], unsigned int num_fences)
     if (!prepareExecute())
         return false;
 
-    return queueBuffer(fence, num_fences);
+    if (!queueBuffer(fence, num_fences)) {
+        recordFailure();
+        return false;
+    }
+
+    return true;
 }
 
 bool AcrylicCompositorMSCL3830::execute(int *handle)
@@ -834,12 +900,17 @@ bool AcrylicCompositorMSCL3830::dequeueBuffer()
     v4l2_buffer buffer;
     memset(&buffer, 0, sizeof(buffer));
 
+    bool queued = testDeviceState(TARGET, STATE_QBUF);
+
     if (!dequeueBuffer(SOURCE, &buffer))
         return false;
 
     if (!dequeueBuffer(TARGET, &buffer))
         return false;
 
+    if (queued)
+        recordCompletion();
+
     return true;
 }
 
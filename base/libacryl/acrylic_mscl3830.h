@@ -41,6 +41,8 @@ private:
     bool resetMode(AcrylicCanvas &canvas, BUFDIRECTION dir);
     bool resetMode();
     bool changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir);
+    bool updateCrop(hw2d_rect_t source, hw2d_rect_t target);
+    bool setSelection(hw2d_rect_t rect, v4l2_buf_type buftype, uint32_t target);
     bool setFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype);
     bool setTransform();
     bool isBlendingChanged();
@@ -72,5 +74,7 @@ private:
     int             mCurrentTypeMem[NUM_IMAGES]; // AcrylicCanvas::memory_type
     int             mDeviceState[NUM_IMAGES];
     uint32_t        mUseFenceFlag;
+    // Cleared if the driver refuses the crop and flip changes while streaming
+    bool            mRuntimeUpdateSupported = true;
 };
 #endif //__HARDWARE_EXYNOS_HW2DCOMPOSITOR_MSCL3830_LEGACY_H__
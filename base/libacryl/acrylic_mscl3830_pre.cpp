@@ -28,7 +28,8 @@ static const char *__dirname[AcrylicCompositorMSCL3830Pre::NUM_IMAGES] = {"sourc
 
 AcrylicCompositorMSCL3830Pre::AcrylicCompositorMSCL3830Pre()
     : mDev("/dev/video50"), mProtectedContent(false), mCurrentPixFmt{0, 0},
-      mCurrentTypeMem{AcrylicCanvas::MT_DMABUF, AcrylicCanvas::MT_DMABUF}, mUseFenceFlag(V4L2_BUF_FLAG_USE_SYNC)
+      mCurrentTypeMem{AcrylicCanvas::MT_DMABUF, AcrylicCanvas::MT_DMABUF}, mCurrentDataspace{0, 0},
+      mCurrentCscSel(-1), mCurrentCscRange(-1), mUseFenceFlag(V4L2_BUF_FLAG_USE_SYNC)
 {
     memset(&mCurrentSize, 0, sizeof(mCurrentSize));
     memset(&mCurrentCrop, 0, sizeof(mCurrentCrop));
@@ -209,11 +210,16 @@ bool AcrylicCompositorMSCL3830Pre::queueBuffer(AcrylicCanvas &canvas, BUFDIRECTI
         buffer.reserved = -1;
     }
 
+    size_t payload[MAX_HW2D_PLANES];
+
+    if (V4L2_TYPE_IS_OUTPUT(buffer.type))
+        halfmt_plane_lengths(canvas.getFormat(), canvas.getImageDimension().hori,
+                             mCurrentCrop[SOURCE].size.vert, payload);
+
     for (unsigned int i = 0; i < canvas.getBufferCount(); i++) {
         plane[i].length = canvas.getBufferLength(i);
         if (V4L2_TYPE_IS_OUTPUT(buffer.type))
-            plane[i].bytesused = halfmt_plane_length(canvas.getFormat(), i,
-                                canvas.getImageDimension().hori, mCurrentCrop[SOURCE].size.vert);
+            plane[i].bytesused = payload[i];
         if (dmabuf)
             plane[i].m.fd = canvas.getDmabuf(i);
         else
@@ -251,15 +257,17 @@ bool AcrylicCompositorMSCL3830Pre::configureCSC(AcrylicCanvas &canvasSrc, Acryli
     uint32_t csc_sel = 0;
     uint32_t csc_range = 0;
 
-    if ((halfmt_chroma_subsampling(mCurrentPixFmt[SOURCE]) == 0x11) &&
-        (halfmt_chroma_subsampling(mCurrentPixFmt[TARGET]) != 0x11)) {
+    // mCurrentPixFmt still has the previous formats here
+    uint32_t srcSubsampling = halfmt_chroma_subsampling(canvasSrc.getFormat());
+    uint32_t dstSubsampling = halfmt_chroma_subsampling(canvasDst.getFormat());
+
+    if ((srcSubsampling == 0x11) && (dstSubsampling != 0x11)) {
         hw2d_coord_t coord = canvasDst.getImageDimension();
 
         // RGB of sRGB -> Y'CbCr
         csc_req = true;
         csc_sel = haldataspace_to_v4l2(canvasDst.getDataspace(), coord.hori, coord.vert);
-    } else if ((halfmt_chroma_subsampling(mCurrentPixFmt[SOURCE]) != 0x11) &&
-        (halfmt_chroma_subsampling(mCurrentPixFmt[TARGET]) == 0x11)) {
+    } else if ((srcSubsampling != 0x11) && (dstSubsampling == 0x11)) {
         hw2d_coord_t coord = canvasSrc.getImageDimension();
 
         // Y'CbCr -> RGB of sRGB
@@ -291,25 +299,33 @@ bool AcrylicCompositorMSCL3830Pre::configureCSC(AcrylicCanvas &canvasSrc, Acryli
                 break;
         }
 
-        v4l2_control ctrl;
-
-        ctrl.id = V4L2_CID_CSC_EQ;
-        ctrl.value = csc_sel;
-        ALOGD_TEST("[Pre]VIDIOC_S_CTRL: csc_matrix_sel=%d", ctrl.value);
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("[Pre]Failed to configure csc matrix to %d", ctrl.value);
+        if (!setCSC(V4L2_CID_CSC_EQ, csc_sel, mCurrentCscSel) ||
+                !setCSC(V4L2_CID_CSC_RANGE, csc_range, mCurrentCscRange))
             return false;
-        }
+    }
 
-        ctrl.id = V4L2_CID_CSC_RANGE;
-        ctrl.value = csc_range;
-        ALOGD_TEST("[Pre]VIDIOC_S_CTRL: csc_range=%d", ctrl.value);
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("[Pre]Failed to configure csc range to %d", ctrl.value);
-            return false;
-        }
+    return true;
+}
+
+// The controls stay in the context of the device across reqbufs(0)
+bool AcrylicCompositorMSCL3830Pre::setCSC(uint32_t id, int value, int &current)
+{
+    if (current == value)
+        return true;
+
+    v4l2_control ctrl;
+
+    ctrl.id = id;
+    ctrl.value = value;
+    ALOGD_TEST("[Pre]VIDIOC_S_CTRL: %s=%d", (id == V4L2_CID_CSC_EQ) ? "csc_matrix_sel" : "csc_range", ctrl.value);
+    if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
+        ALOGERR("[Pre]Failed to configure %s to %d", (id == V4L2_CID_CSC_EQ) ? "csc matrix" : "csc range", ctrl.value);
+        current = -1;
+        return false;
     }
 
+    current = value;
+
     return true;
 }
 
@@ -362,6 +378,9 @@ bool AcrylicCompositorMSCL3830Pre::checkReset(BUFDIRECTION dir, AcrylicCanvas &c
         return true;
     if (mCurrentTypeMem[dir] != canvas.getBufferType())
         return true;
+    // the colorspace of S_FMT and the CSC controls follow the dataspace
+    if (mCurrentDataspace[dir] != canvas.getDataspace())
+        return true;
 
     return false;
 }
@@ -374,6 +393,8 @@ void AcrylicCompositorMSCL3830Pre::setCurrentInfo(BUFDIRECTION dir, AcrylicCanva
     mCurrentCrop[dir] = rect;
 
     mCurrentTypeMem[dir] = canvas.getBufferType();
+
+    mCurrentDataspace[dir] = canvas.getDataspace();
 }
 
 void AcrylicCompositorMSCL3830Pre::clearCurrByFail()
@@ -383,6 +404,9 @@ void AcrylicCompositorMSCL3830Pre::clearCurrByFail()
     mCurrentTypeMem[TARGET] = AcrylicCanvas::MT_DMABUF;
     memset(&mCurrentSize, 0, sizeof(mCurrentSize));
     memset(&mCurrentCrop, 0, sizeof(mCurrentCrop));
+    memset(&mCurrentDataspace, 0, sizeof(mCurrentDataspace));
+    mCurrentCscSel = -1;
+    mCurrentCscRange = -1;
 }
 
 class for_clear {
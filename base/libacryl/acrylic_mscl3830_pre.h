@@ -38,6 +38,7 @@ private:
     bool resetMode(BUFDIRECTION dir);
 
     bool configureCSC(AcrylicCanvas &canvasSrc, AcrylicCanvas &canvasDst);
+    bool setCSC(uint32_t id, int value, int &current);
     bool setFormat(BUFDIRECTION dir, AcrylicCanvas &canvas);
     bool setCrop(BUFDIRECTION dir, hw2d_rect_t rect);
     bool prepareExecute(AcrylicCanvas &canvasSrc, AcrylicCanvas &canvasDst);
@@ -59,6 +60,10 @@ private:
     hw2d_coord_t    mCurrentSize[NUM_IMAGES];
     hw2d_rect_t     mCurrentCrop[NUM_IMAGES];
     int             mCurrentTypeMem[NUM_IMAGES]; // AcrylicCanvas::memory_type
+    int             mCurrentDataspace[NUM_IMAGES];
+    // CSC controls applied to the device, -1 if unknown
+    int             mCurrentCscSel;
+    int             mCurrentCscRange;
     uint32_t        mUseFenceFlag;
 };
 #endif //__HARDWARE_EXYNOS_HW2DCOMPOSITOR_MSCL3830_PRE_LEGACY_H__
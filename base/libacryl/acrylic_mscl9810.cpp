@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstring>
 
 #include <log/log.h>
@@ -98,7 +101,9 @@ bool AcrylicCompositorMSCL9810::resetMode(AcrylicCanvas &canvas, BUFDIRECTION di
 
         ALOGD_TEST("VIDIOC_REQBUFS: count=%d, type=%d, memory=%d", reqbufs.count, reqbufs.type, reqbufs.memory);
 
-        clearDeviceState(dir, STATE_REQBUFS);
+        // The queued jobs are dropped by streamoff
+        clearDeviceState(dir, STATE_PROCESSING);
+        mQueuedJobs = 0;
     }
 
     return true;
@@ -117,9 +122,6 @@ bool AcrylicCompositorMSCL9810::resetMode()
     if (area_is_zero(crop))
         crop.size = getCanvas().getImageDimension();
 
-    if ((crop != mCurrentCrop[TARGET]) || (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE]))
-        reset_required = true;
-
     if (((getLayer(0)->getSettingFlags() | getCanvas().getSettingFlags()) & mod_flags) != 0)
         reset_required = true;
 
@@ -131,6 +133,12 @@ bool AcrylicCompositorMSCL9810::resetMode()
         mTransformChanged = false;
     }
 
+    // Only the crops are changed, try to keep streaming
+    if (!reset_required && ((crop != mCurrentCrop[TARGET]) ||
+            (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE])) &&
+            !updateCrop(getLayer(0)->getImageRect(), crop))
+        reset_required = true;
+
     if (reset_required) {
         // Ignore the return value because we have no choice when it is false.
         resetMode(*getLayer(0), SOURCE);
@@ -144,6 +152,55 @@ bool AcrylicCompositorMSCL9810::resetMode()
     return true;
 }
 
+/*
+ * Applies the crop changes of a streaming job without the re-negotiation.
+ * The scaler takes the selection of the next job while it is streaming if
+ * its driver allows it. False if the crops should be set by changeMode().
+ */
+bool AcrylicCompositorMSCL9810::updateCrop(hw2d_rect_t source, hw2d_rect_t target)
+{
+    if (!mRuntimeUpdateSupported || !testDeviceState(SOURCE, STATE_REQBUFS) ||
+            !testDeviceState(TARGET, STATE_REQBUFS))
+        return false;
+
+    if ((source != mCurrentCrop[SOURCE]) &&
+            !setSelection(source, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_SEL_TGT_CROP))
+        return false;
+    mCurrentCrop[SOURCE] = source;
+
+    if ((target != mCurrentCrop[TARGET]) &&
+            !setSelection(target, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_SEL_TGT_COMPOSE))
+        return false;
+    mCurrentCrop[TARGET] = target;
+
+    return true;
+}
+
+bool AcrylicCompositorMSCL9810::setSelection(hw2d_rect_t rect, v4l2_buf_type buftype, uint32_t target)
+{
+    v4l2_selection sel;
+
+    memset(&sel, 0, sizeof(sel));
+    sel.type = buftype;
+    sel.target = target;
+    sel.r.left = rect.pos.hori;
+    sel.r.top = rect.pos.vert;
+    sel.r.width = rect.size.hori;
+    sel.r.height = rect.size.vert;
+    ALOGD_TEST("VIDIOC_S_SELECTION: type=%d, target=%d, left=%d, top=%d, width=%d, height=%d",
+            buftype, target, sel.r.left, sel.r.top, sel.r.width, sel.r.height);
+    if (mDev.ioctl(VIDIOC_S_SELECTION, &sel) < 0) {
+        // The driver needs the re-negotiation for the crop changes
+        if ((errno == EBUSY) || (errno == ENOTTY)) {
+            ALOGI("Crop changes while streaming are not supported, error %d", errno);
+            mRuntimeUpdateSupported = false;
+        }
+        return false;
+    }
+
+    return true;
+}
+
 bool AcrylicCompositorMSCL9810::changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir)
 {
     if (testDeviceState(dir, STATE_REQBUFS))
@@ -218,7 +275,8 @@ bool AcrylicCompositorMSCL9810::setTransform()
     uint32_t trdiff = mCurrentTransform ^ getLayer(0)->getTransform();
     v4l2_control ctrl;
 
-    mTransformChanged = !!trdiff;
+    // Rotation swaps the target size, but flips are applied to the next job
+    mTransformChanged = (trdiff & HAL_TRANSFORM_ROT_90) || (!!trdiff && !mRuntimeUpdateSupported);
 
     // TODO: consider to use rot 180 and 270
     if (trdiff & HAL_TRANSFORM_FLIP_H) {
@@ -292,7 +350,7 @@ bool AcrylicCompositorMSCL9810::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
                                             : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     v4l2_requestbuffers reqbufs;
 
-    reqbufs.count = 1;
+    reqbufs.count = QUEUE_DEPTH;
     reqbufs.type = buftype;
     reqbufs.memory = (canvas.getBufferType() == AcrylicCanvas::MT_DMABUF)
                      ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_USERPTR;
@@ -316,6 +374,11 @@ bool AcrylicCompositorMSCL9810::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
 
     ALOGD_TEST("VIDIOC_STREAMON: type=%d", reqbufs.type);
 
+    // The driver may give less buffers than requested
+    unsigned int count = (reqbufs.count > 0) ? reqbufs.count : 1;
+    mBufferCount = (dir == SOURCE) ? count : std::min(mBufferCount, count);
+    mNextIndex = 0;
+
     mCurrentTypeMem[dir] = canvas.getBufferType();
     mCurrentTypeBuf[dir] = buftype;
 
@@ -384,6 +447,7 @@ bool AcrylicCompositorMSCL9810::queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type
     memset(&buffer, 0, sizeof(buffer));
 
     buffer.type = buftype;
+    buffer.index = mNextIndex;
     buffer.memory = dmabuf ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_USERPTR;
     if (canvas.getFence() >= 0) {
         buffer.flags = mUseFenceFlag;
@@ -399,11 +463,16 @@ bool AcrylicCompositorMSCL9810::queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type
         buffer.reserved = -1;
     }
 
+    size_t payload[MAX_HW2D_PLANES];
+
+    if (output)
+        halfmt_plane_lengths(canvas.getFormat(), canvas.getImageDimension().hori,
+                             mCurrentCrop[SOURCE].size.vert, payload);
+
     for (unsigned int i = 0; i < canvas.getBufferCount(); i++) {
         plane[i].length = canvas.getBufferLength(i);
         if (output)
-            plane[i].bytesused = halfmt_plane_length(canvas.getFormat(), i,
-                                    canvas.getImageDimension().hori, mCurrentCrop[SOURCE].size.vert);
+            plane[i].bytesused = payload[i];
 
         if (dmabuf)
             plane[i].m.fd = canvas.getDmabuf(i);
@@ -490,6 +559,12 @@ bool AcrylicCompositorMSCL9810::queueBuffer(int fence[], unsigned int num_fences
         setDeviceState(SOURCE, STATE_QBUF);
         setDeviceState(TARGET, STATE_QBUF);
 
+        mQueuedJobs++;
+        mSubmittedJobs++;
+        mNextIndex = (mNextIndex + 1) % mBufferCount;
+
+        recordSubmission((release_fence[TARGET] >= 0) ? release_fence[TARGET] : release_fence[SOURCE]);
+
         unsigned int max_fences = num_fences < NUM_IMAGES ? num_fences : NUM_IMAGES;
 
         for ( ; i < max_fences; i++)
@@ -578,6 +653,36 @@ bool AcrylicCompositorMSCL9810::configureCSC()
     return true;
 }
 
+/*
+ * Whether the next job needs a setting other than the one of the queued
+ * jobs. The settings are shared by the jobs in the queue of the driver.
+ */
+bool AcrylicCompositorMSCL9810::isConfigChanged()
+{
+    hw2d_rect_t crop = getLayer(0)->getTargetRect();
+    int mod_flags = AcrylicCanvas::SETTING_TYPE_MODIFIED |
+                    AcrylicCanvas::SETTING_DIMENSION_MODIFIED |
+                    AcrylicCanvas::SETTING_STRIDE_MODIFIED;
+
+    if (area_is_zero(crop))
+        crop.size = getCanvas().getImageDimension();
+
+    return (crop != mCurrentCrop[TARGET]) || (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE]) ||
+           (((getLayer(0)->getSettingFlags() | getCanvas().getSettingFlags()) & mod_flags) != 0) ||
+           (getCanvas().isProtected() != mProtectedContent) ||
+           (getLayer(0)->getTransform() != mCurrentTransform) || mFramerateChanged;
+}
+
+bool AcrylicCompositorMSCL9810::waitQueueSpace()
+{
+    while (mQueuedJobs >= mBufferCount) {
+        if (!dequeueBuffer())
+            return false;
+    }
+
+    return true;
+}
+
 bool AcrylicCompositorMSCL9810::execute(int fence[], unsigned int num_fences)
 {
     if (!validateAllLayers())
@@ -585,7 +690,8 @@ bool AcrylicCompositorMSCL9810::execute(int fence[], unsigned int num_fences)
 
     LOGASSERT(layerCount() == 1, "Number of layer is not 1 but %d", layerCount());
 
-    if (!waitExecution(0)) {
+    // The jobs of the same setting are pipelined in the queues of the driver
+    if (!(isConfigChanged() ? waitExecution(0) : waitQueueSpace())) {
         ALOGE("Error occurred in the previous image processing");
         return false;
     }
@@ -602,7 +708,12 @@ bool AcrylicCompositorMSCL9810::execute(int fence[], unsigned int num_fences)
     if (!prepareExecute())
         return false;
 
-    return queueBuffer(fence, num_fences);
+    if (!queueBuffer(fence, num_fences)) {
+        recordFailure();
+        return false;
+    }
+
+    return true;
 }
 
 bool AcrylicCompositorMSCL9810::execute(int *handle)
@@ -611,7 +722,7 @@ bool AcrylicCompositorMSCL9810::execute(int *handle)
 
     if (success) {
         if (handle != NULL)
-            *handle = 1; /* dummy handle */
+            *handle = static_cast<int>(mSubmittedJobs & INT_MAX);
         else
             success = waitExecution(0);
     }
@@ -628,12 +739,21 @@ bool AcrylicCompositorMSCL9810::dequeueBuffer()
     v4l2_buffer buffer;
     memset(&buffer, 0, sizeof(buffer));
 
+    bool queued = testDeviceState(TARGET, STATE_QBUF);
+
     if (!dequeueBuffer(SOURCE, &buffer))
         return false;
 
     if (!dequeueBuffer(TARGET, &buffer))
         return false;
 
+    // The buffers of the jobs are dequeued in the order of the submission
+    if (queued && (--mQueuedJobs == 0)) {
+        clearDeviceState(SOURCE, STATE_QBUF);
+        clearDeviceState(TARGET, STATE_QBUF);
+        recordCompletion();
+    }
+
     return true;
 }
 
@@ -661,8 +781,6 @@ bool AcrylicCompositorMSCL9810::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buf
             ALOGI("Error during streaming: type=%d, memory=%d", buffer->type, buffer->memory);
         }
 
-        clearDeviceState(dir, STATE_QBUF);
-
         // The clients of V4L2 capture/m2m device should identify and verify the payload
         // written by the device and the expected payload but MSCL driver does not specify
         // the payload written by it.
@@ -675,9 +793,20 @@ bool AcrylicCompositorMSCL9810::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buf
 
 }
 
-bool AcrylicCompositorMSCL9810::waitExecution(int __unused handle)
+bool AcrylicCompositorMSCL9810::waitExecution(int handle)
 {
-    return dequeueBuffer();
+    // A handle is the sequence of the job, 0 waits for all the queued jobs
+    while (testDeviceState(TARGET, STATE_QBUF)) {
+        unsigned int age = (mSubmittedJobs - static_cast<unsigned int>(handle)) & INT_MAX;
+
+        if ((handle > 0) && (age >= mQueuedJobs))
+            break;
+
+        if (!dequeueBuffer())
+            return false;
+    }
+
+    return true;
 }
 
 bool AcrylicCompositorMSCL9810::requestPerformanceQoS(AcrylicPerformanceRequest *request)
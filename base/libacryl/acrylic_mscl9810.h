@@ -36,14 +36,20 @@ public:
     virtual bool requestPerformanceQoS(AcrylicPerformanceRequest *request);
 private:
     enum { STATE_REQBUFS = 1, STATE_QBUF = 2, STATE_PROCESSING = STATE_REQBUFS | STATE_QBUF };
+    // Jobs queued to the driver at most without a dequeue
+    enum { QUEUE_DEPTH = 3 };
 
     bool resetMode(AcrylicCanvas &canvas, BUFDIRECTION dir);
     bool resetMode();
     bool changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir);
+    bool updateCrop(hw2d_rect_t source, hw2d_rect_t target);
+    bool setSelection(hw2d_rect_t rect, v4l2_buf_type buftype, uint32_t target);
     bool setFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype);
     bool setTransform();
     bool setCrop(hw2d_rect_t rect, v4l2_buf_type buftype, hw2d_rect_t &save_rect);
     bool prepareExecute();
+    bool isConfigChanged();
+    bool waitQueueSpace();
     bool prepareExecute(AcrylicCanvas &canvas, BUFDIRECTION dir);
     bool configureCSC();
     bool queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type buftype, int *fence, bool needReleaseFence);
@@ -64,7 +70,13 @@ private:
     v4l2_buf_type   mCurrentTypeBuf[NUM_IMAGES];
     int             mCurrentTypeMem[NUM_IMAGES]; // AcrylicCanvas::memory_type
     int             mDeviceState[NUM_IMAGES];
+    unsigned int    mBufferCount = 1; // buffers of a direction given by VIDIOC_REQBUFS
+    unsigned int    mNextIndex = 0;
+    unsigned int    mQueuedJobs = 0;
+    unsigned int    mSubmittedJobs = 0;
     uint32_t        mUseFenceFlag;
+    // Cleared if the driver refuses the crop and flip changes while streaming
+    bool            mRuntimeUpdateSupported = true;
     bool            mVotfSupported = false;
     int             mFramerate = 0;
     bool            mFramerateChanged = false;
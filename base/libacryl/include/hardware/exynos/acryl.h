@@ -472,6 +472,8 @@ public:
      *                            it is not applied to HW yet.
      * - SETTING_DIMENSION_MODIFIED: Image dimension information is configured by users
      *                               and it is not applied to HW yet.
+     * - SETTING_COMPOSIT_MODIFIED: Compositing mode or area of a layer is changed by users
+     *                              and it is not applied to HW yet.
      */
     enum setting_check_t {
         SETTING_TYPE = 1,
@@ -484,8 +486,10 @@ public:
         SETTING_BUFFER_MODIFIED = 32,
         SETTING_DIMENSION_MODIFIED = 64,
         SETTING_STRIDE_MODIFIED = 128,
+        SETTING_COMPOSIT_MODIFIED = 256,
         SETTING_MODIFIED_MASK = SETTING_TYPE_MODIFIED | SETTING_BUFFER_MODIFIED |
-                                SETTING_DIMENSION_MODIFIED | SETTING_STRIDE_MODIFIED,
+                                SETTING_DIMENSION_MODIFIED | SETTING_STRIDE_MODIFIED |
+                                SETTING_COMPOSIT_MODIFIED,
     };
 
     /*
@@ -602,6 +606,10 @@ public:
      * Study if the image is filled with solid color.
      */
     bool isSolidColor() { return !!(mAttributes & ATTR_SOLIDCOLOR); }
+    /*
+     * Obtain all the attributes configured with the buffer.
+     */
+    uint32_t getAttributes() { return mAttributes; }
     /*
      * Obtain the acquire fence of the buffer.
      */
@@ -964,6 +972,28 @@ public:
     static Acrylic *createAcrylic(const char *spec);
 };
 
+/*
+ * AcrylicStats - The statistics of the jobs executed by an instance of Acrylic
+ *
+ * The latency of a job is the time from the submission of the job to HW 2D
+ * until the completion of the job. The completion is the signal time of the
+ * release fence of the job if the users requested release fences. Otherwise,
+ * it is the time when the completion of the job is observed by Acrylic.
+ * The jobs whose completion is not observed until the next job is submitted
+ * are not counted in measured_count.
+ * last_hw_usec is the last processing time of HW 2D reported by the driver.
+ * It is zero if the driver does not report it.
+ */
+struct AcrylicStats {
+    uint64_t job_count;
+    uint64_t fail_count;
+    uint64_t measured_count;
+    uint64_t total_latency_usec;
+    unsigned int last_latency_usec;
+    unsigned int max_latency_usec;
+    unsigned int last_hw_usec;
+};
+
 /*
  * Acrylic - The type of the object for 2D compositing with HW 2D
  *
@@ -1143,6 +1173,8 @@ public:
      * completes and stores a value(handle) to @handle. Users can wait for HW 2D
      * to be finished with that handle. Users does not need to wait HW 2D. Then,
      * they sshould release the handle with releaseHandle().
+     * A handle is valid until it is waited or released, so several executions
+     * can be in flight if the implementation allows it.
      */
     virtual bool execute(int *handle = NULL) = 0;
     /*
@@ -1158,7 +1190,15 @@ public:
      * Return the last execution time of the H/W in micro seconds.
      * It is only vaild when the last call to execute() succeeded.
      */
-    virtual unsigned int getLaptimeUSec() { return 0; }
+    virtual unsigned int getLaptimeUSec() { return mStats.last_hw_usec; }
+    /*
+     * Return the statistics of the jobs executed by this instance of Acrylic.
+     * The latency of the last job is counted after the next job is submitted
+     * if the completion of the last job is not waited by waitExecution().
+     * clearStats() resets all statistics.
+     */
+    const AcrylicStats &getStats() { return mStats; }
+    void clearStats();
     /*
      * Configure the priority of the image processing tasks requested
      * to this compositor object. The default priority is -1 and the
@@ -1210,8 +1250,23 @@ protected:
      * AcrylicLayer, it should implement removeTransitData().
      */
     virtual void removeTransitData(AcrylicLayer __attribute__((__unused__)) *layer) { }
+    /*
+     * Validates the layers configured after the last execution. Layers and the
+     * target image that are not modified since the last execution are already
+     * validated with the same configuration.
+     */
     bool validateAllLayers();
-    void sortLayers();
+    /*
+     * Called by the implementations of Acrylic to collect AcrylicStats.
+     * recordSubmission() is called when a job is submitted to HW 2D. @fence is
+     * a release fence of the job that is signaled on the completion of the job. It
+     * is not owned by Acrylic. recordCompletion() is called when the completion
+     * of the job is observed and @hw_usec is the processing time of HW 2D if
+     * the driver reports it. recordFailure() is called when a job is failed.
+     */
+    void recordSubmission(int fence = -1);
+    void recordCompletion(unsigned int hw_usec = 0);
+    void recordFailure() { mStats.fail_count++; }
     AcrylicLayer *getLayer(unsigned int index)
     {
         return (index < mLayers.size()) ? mLayers[index] : nullptr;
@@ -1244,6 +1299,54 @@ private:
     void *mTargetDisplayInfo;
     AcrylicCanvas mCanvas;
     std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> mTablePPC;
+    AcrylicStats mStats;
+    int64_t mSubmitTime;
+    int mPendingFence;
+
+    void collectPendingJob();
+
+    friend class AcrylicLayer;
+    /*
+     * mLayers is always ordered by z-order. The implementations of Acrylic
+     * get the layers in z-order from getLayer() without sorting them.
+     * reorderLayer() moves @layer whose z-order is changed to its place.
+     */
+    void reorderLayer(AcrylicLayer *layer);
+};
+
+/*
+ * AcrylicBatch - Submission of the jobs of several Acrylic instances at once
+ *
+ * A job is an instance of Acrylic whose canvas and layers are configured by
+ * users. submit() runs all the jobs in the order added without waiting for any
+ * of them to complete, then reports a release fence of the target of each job.
+ * The H/W of the next job is configured while the previous job is processed.
+ * The jobs are kept after submit() so that the same group of jobs can be
+ * submitted again after their layers and canvases are configured again.
+ */
+class AcrylicBatch {
+public:
+    AcrylicBatch() { }
+    ~AcrylicBatch() { }
+    /*
+     * Add @job to the batch. An instance of Acrylic can be added only once.
+     */
+    bool addJob(Acrylic *job);
+    /*
+     * Remove all the jobs from the batch.
+     */
+    void clear() { mJobs.clear(); }
+    unsigned int getJobCount() { return static_cast<unsigned int>(mJobs.size()); }
+    /*
+     * Run all jobs. If @fence is not NULL, submit() stores the release fence of
+     * the target of the i-th job to @fence[i] for i < num_fences. The remaining
+     * elements are filled with -1. The fences of the jobs not running are also -1.
+     * If a job fails, submit() returns false without running the jobs after it.
+     * The jobs before it are still running.
+     */
+    bool submit(int fence[] = NULL, unsigned int num_fences = 0);
+private:
+    std::vector<Acrylic *> mJobs;
 };
 
 struct AcrylicPerformanceRequestLayer {
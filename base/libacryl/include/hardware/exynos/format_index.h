@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_FORMAT_INDEX_H__
+#define __HARDWARE_EXYNOS_FORMAT_INDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * FormatIndex - constant time lookup of a format table
+ *
+ * Format tables are arrays of entries keyed by a HAL pixel format or a V4L2
+ * fourcc. FormatIndex is an open addressing hash table of the indices of the
+ * entries in a table that is built at compile time:
+ *
+ *     static constexpr uint32_t table[][2] = {{HAL_FMT_A, V4L2_FMT_A}, ...};
+ *     static constexpr auto index = makeFormatIndex(table,
+ *                                       [] (const auto &e) { return e[0]; });
+ *     int i = index.find(HAL_FMT_A); // i is 0
+ *
+ * The tables stay the only description of the formats and the indices are
+ * just accelerators over them. If a key appears more than once in a table,
+ * find() returns the first entry with the key as the linear search did.
+ */
+template <size_t N>
+class FormatIndex {
+    static constexpr size_t bucketCount()
+    {
+        size_t count = 1;
+        while (count < N * 2)
+            count <<= 1;
+        return count;
+    }
+
+    static constexpr size_t BUCKETS = bucketCount();
+
+    static constexpr size_t hash(uint32_t key)
+    {
+        // Fibonacci hashing spreads both small HAL formats and fourcc values
+        return static_cast<uint32_t>(key * 2654435769U) & (BUCKETS - 1);
+    }
+
+    uint32_t mKeys[BUCKETS];
+    int16_t mIndex[BUCKETS];
+public:
+    template <typename T, typename KeyOf>
+    constexpr FormatIndex(const T (&table)[N], KeyOf keyof) : mKeys(), mIndex()
+    {
+        for (size_t i = 0; i < BUCKETS; i++)
+            mIndex[i] = -1;
+
+        for (size_t i = 0; i < N; i++) {
+            uint32_t key = static_cast<uint32_t>(keyof(table[i]));
+            size_t pos = hash(key);
+
+            while ((mIndex[pos] >= 0) && (mKeys[pos] != key))
+                pos = (pos + 1) & (BUCKETS - 1);
+
+            if (mIndex[pos] < 0) {
+                mKeys[pos] = key;
+                mIndex[pos] = static_cast<int16_t>(i);
+            }
+        }
+    }
+
+    /*
+     * Returns the index of the first entry of the table with @key or -1 if
+     * no entry has @key.
+     */
+    constexpr int find(uint32_t key) const
+    {
+        for (size_t pos = hash(key); mIndex[pos] >= 0; pos = (pos + 1) & (BUCKETS - 1)) {
+            if (mKeys[pos] == key)
+                return mIndex[pos];
+        }
+
+        return -1;
+    }
+};
+
+template <typename T, size_t N, typename KeyOf>
+constexpr FormatIndex<N> makeFormatIndex(const T (&table)[N], KeyOf keyof)
+{
+    return FormatIndex<N>(table, keyof);
+}
+
+#endif /* __HARDWARE_EXYNOS_FORMAT_INDEX_H__ */
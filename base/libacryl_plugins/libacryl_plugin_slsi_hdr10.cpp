@@ -16,6 +16,7 @@
  *  limitations under the License.
  */
 #include <cassert>
+#include <cstring>
 
 #include <system/graphics.h>
 
@@ -540,9 +541,44 @@ class G2DHdr10CommandWriter: public IG2DHdr10CommandWriter {
     int mLayerDataspace[MAX_LAYER_COUNT];
     unsigned int mLayerMaxLuminance[MAX_LAYER_COUNT];
     struct g2d_commandlist mCommandList;
+    // Configuration that mCommandList is generated from.
+    // The command list is reused while the configuration is not changed.
+    bool mCommandCached;
+    int mCachedLayerMap;
+    int mCachedLayerAlphaMap;
+    int mCachedTargetDataspace;
+    int mCachedLayerDataspace[MAX_LAYER_COUNT];
+    unsigned int mCachedLayerMaxLuminance[MAX_LAYER_COUNT];
+
+    bool isCommandCached(int LayerMap, int LayerAlphaMap) {
+        if (!mCommandCached || (LayerMap != mCachedLayerMap) ||
+            (LayerAlphaMap != mCachedLayerAlphaMap) || (mTargetDataspace != mCachedTargetDataspace))
+            return false;
+
+        for (unsigned int i = 0; i < MAX_LAYER_COUNT; i++) {
+            if (!(LayerMap & (1 << i)))
+                continue;
+
+            if ((mLayerDataspace[i] != mCachedLayerDataspace[i]) ||
+                (mLayerMaxLuminance[i] != mCachedLayerMaxLuminance[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+    void storeCommandCache(int LayerMap, int LayerAlphaMap) {
+        mCachedLayerMap = LayerMap;
+        mCachedLayerAlphaMap = LayerAlphaMap;
+        mCachedTargetDataspace = mTargetDataspace;
+        memcpy(mCachedLayerDataspace, mLayerDataspace, sizeof(mLayerDataspace));
+        memcpy(mCachedLayerMaxLuminance, mLayerMaxLuminance, sizeof(mLayerMaxLuminance));
+        mCommandCached = true;
+    }
 public:
     G2DHdr10CommandWriter() : mLayerMap(0), mLayerAlphaMap(0), mTargetDataspace(HAL_DATASPACE_TRANSFER_SRGB),
-                              mCommandList{nullptr, nullptr, 0, 0} {
+                              mCommandList{nullptr, nullptr, 0, 0}, mCommandCached(false),
+                              mCachedLayerMap(0), mCachedLayerAlphaMap(0), mCachedTargetDataspace(0) {
     }
     ~G2DHdr10CommandWriter() { delete [] mCommandList.commands; }
 
@@ -588,6 +624,11 @@ public:
             mCommandList.layer_hdr_mode = cmds + NUM_HDR_COEFFICIENTS;
         }
 
+        if (isCommandCached(LayerMap, LayerAlphaMap))
+            return &mCommandList;
+
+        mCommandCached = false;
+
         HDRMatrixWriter hdrMatrixWriter(mTargetDataspace);
 
         mCommandList.layer_count = 0;
@@ -614,6 +655,8 @@ public:
 
         mCommandList.command_count = hdrMatrixWriter.write(mCommandList.commands);
 
+        storeCommandCache(LayerMap, LayerAlphaMap);
+
         return &mCommandList;
     }
 
@@ -20,8 +20,10 @@
 #include "drmdevice.h"
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <array>
 #include <sstream>
 
@@ -145,6 +147,20 @@ int DrmConnector::Init() {
     ALOGE("Could not get hdr_sink_connected property\n");
   }
 
+  if (external()) {
+    ret = drm_->GetConnectorProperty(*this, "vrr_capable", &vrr_capable_);
+    if (ret)
+      ALOGI("Could not get vrr_capable property\n");
+
+    ret = drm_->GetConnectorProperty(*this, "content type", &content_type_);
+    if (ret)
+      ALOGI("Could not get content type property\n");
+
+    ret = drm_->GetConnectorProperty(*this, "allm", &allm_);
+    if (ret)
+      ALOGI("Could not get allm property\n");
+  }
+
   properties_.push_back(&dpms_property_);
   properties_.push_back(&crtc_id_property_);
   properties_.push_back(&edid_property_);
@@ -164,6 +180,9 @@ int DrmConnector::Init() {
   properties_.push_back(&hdr_output_meta_);
   properties_.push_back(&lp_mode_);
   properties_.push_back(&hdr_sink_connected_);
+  properties_.push_back(&vrr_capable_);
+  properties_.push_back(&content_type_);
+  properties_.push_back(&allm_);
 
   return 0;
 }
@@ -222,6 +241,9 @@ std::string DrmConnector::name() const {
 }
 
 int DrmConnector::UpdateModes() {
+  if (UpdateModesFromCache())
+    return 0;
+
   int fd = drm_->fd();
   drmModeConnectorPtr c = drmModeGetConnector(fd, id_);
   if (!c) {
@@ -232,6 +254,7 @@ int DrmConnector::UpdateModes() {
   state_ = c->connection;
 
   if (state_ == DRM_MODE_DISCONNECTED) {
+    drmModeFreeConnector(c);
     return 0;
   }
 
@@ -258,13 +281,57 @@ int DrmConnector::UpdateModes() {
       preferred_mode_found = true;
     }
   }
+  drmModeFreeConnector(c);
   modes_.swap(new_modes);
   if (!preferred_mode_found && modes_.size() != 0) {
     preferred_mode_id_ = modes_[0].id();
   }
+  CacheModes();
   return 0;
 }
 
+bool DrmConnector::UpdateModesFromCache() {
+  // The driver updates EDID when the sink is detected, so a known sink can
+  // be identified without probing it again
+  if (edid_property_.id() == 0 || UpdateEdid() < 0 || edid_hash_ == 0)
+    return false;
+
+  auto it = std::find_if(mode_cache_.begin(), mode_cache_.end(),
+                         [this](const ModeCacheEntry &entry) {
+                           return entry.edid_hash == edid_hash_;
+                         });
+  if (it == mode_cache_.end())
+    return false;
+
+  drmModeConnectorPtr c = drmModeGetConnectorCurrent(drm_->fd(), id_);
+  if (!c)
+    return false;
+  drmModeConnection state = c->connection;
+  drmModeFreeConnector(c);
+  // Let the full probe handle disconnection and unknown state
+  if (state != DRM_MODE_CONNECTED)
+    return false;
+
+  state_ = state;
+  modes_ = it->modes;
+  preferred_mode_id_ = it->preferred_mode_id;
+  mode_cache_.splice(mode_cache_.begin(), mode_cache_, it);
+  return true;
+}
+
+void DrmConnector::CacheModes() {
+  if (edid_property_.id() == 0 || UpdateEdid() < 0 || edid_hash_ == 0 ||
+      state_ != DRM_MODE_CONNECTED || modes_.empty())
+    return;
+
+  mode_cache_.remove_if([this](const ModeCacheEntry &entry) {
+    return entry.edid_hash == edid_hash_;
+  });
+  mode_cache_.push_front({edid_hash_, modes_, preferred_mode_id_});
+  if (mode_cache_.size() > kModeCacheSize)
+    mode_cache_.pop_back();
+}
+
 const DrmMode &DrmConnector::active_mode() const {
   return active_mode_;
 }
@@ -361,25 +428,39 @@ const DrmProperty &DrmConnector::hdr_sink_connected() const {
   return hdr_sink_connected_;
 }
 
-int DrmConnector::UpdateHdrInfo() {
-  int ret = UpdateProperty(&max_luminance_);
-  if (ret) {
-    ALOGE("Could not get max_luminance property\n");
-  }
+const DrmProperty &DrmConnector::vrr_capable() const {
+  return vrr_capable_;
+}
 
-  ret = UpdateProperty(&max_avg_luminance_);
-  if (ret) {
-    ALOGE("Could not get max_avg_luminance property\n");
-  }
+const DrmProperty &DrmConnector::content_type() const {
+  return content_type_;
+}
 
-  ret = UpdateProperty(&min_luminance_);
-  if (ret) {
-    ALOGE("Could not get min_luminance property\n");
-  }
+const DrmProperty &DrmConnector::allm() const {
+  return allm_;
+}
+
+int DrmConnector::UpdateVrrCapable() {
+  // The capability follows the sink, read it again on each plug
+  if (vrr_capable_.id() == 0)
+    return -EINVAL;
+
+  return UpdateProperty(&vrr_capable_);
+}
+
+int DrmConnector::UpdateHdrInfo() {
+  // HDR capabilities of the sink come from its EDID
+  if (edid_property_.id() != 0 && UpdateEdid() == 0 && edid_hash_ != 0 &&
+      edid_hash_ == hdr_info_edid_hash_)
+    return 0;
 
-  ret = UpdateProperty(&hdr_sink_connected_);
+  int ret = UpdateProperties({&max_luminance_, &max_avg_luminance_,
+                              &min_luminance_, &hdr_sink_connected_});
   if (ret) {
-    ALOGE("Could not get min_luminance property\n");
+    ALOGE("Could not get HDR properties\n");
+    hdr_info_edid_hash_ = 0;
+  } else {
+    hdr_info_edid_hash_ = edid_hash_;
   }
   return ret;
 }
@@ -388,9 +469,41 @@ int DrmConnector::UpdateEdid() {
   int ret = UpdateProperty(&edid_property_);
   if (ret) {
     ALOGE("Could not get edid_property property\n");
+    return ret;
   }
 
-  return ret;
+  uint64_t blob_id = 0;
+  std::tie(ret, blob_id) = edid_property_.value();
+  if (ret)
+    return ret;
+  if (blob_id == edid_blob_id_)
+    return 0;
+
+  edid_blob_id_ = blob_id;
+  edid_.clear();
+  edid_hash_ = 0;
+  if (blob_id == 0)
+    return 0;
+
+  drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(drm_->fd(), blob_id);
+  if (!blob) {
+    ALOGE("Failed to get edid blob %" PRIu64, blob_id);
+    edid_blob_id_ = 0;
+    return -ENOENT;
+  }
+  const uint8_t *data = static_cast<const uint8_t *>(blob->data);
+  edid_.assign(data, data + blob->length);
+  drmModeFreePropertyBlob(blob);
+
+  // FNV-1a, zero is reserved for no EDID
+  edid_hash_ = 14695981039346656037ULL;
+  for (uint8_t byte : edid_) {
+    edid_hash_ ^= byte;
+    edid_hash_ *= 1099511628211ULL;
+  }
+  if (edid_hash_ == 0)
+    edid_hash_ = 1;
+  return 0;
 }
 
 int DrmConnector::UpdateProperty(DrmProperty *property) {
@@ -403,14 +516,34 @@ int DrmConnector::UpdateProperty(DrmProperty *property) {
   }
   bool found = false;
   for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-    drmModePropertyPtr p = drmModeGetProperty(fd, props->props[i]);
     if (props->props[i] == property->id()) {
       property->UpdateValue(props->prop_values[i]);
       found = true;
     }
-    drmModeFreeProperty(p);
   }
   drmModeFreeObjectProperties(props);
   return found ? 0 : -ENOENT;
 }
+
+int DrmConnector::UpdateProperties(const std::vector<DrmProperty *> &properties) {
+  int fd = drm_->fd();
+  drmModeObjectPropertiesPtr props;
+  props = drmModeObjectGetProperties(fd, id_, DRM_MODE_OBJECT_CONNECTOR);
+  if (!props) {
+    ALOGE("Failed to get properties for connector %d", id_);
+    return -ENODEV;
+  }
+  size_t found = 0;
+  for (DrmProperty *property : properties) {
+    for (int i = 0; (size_t)i < props->count_props; ++i) {
+      if (props->props[i] == property->id()) {
+        property->UpdateValue(props->prop_values[i]);
+        found++;
+        break;
+      }
+    }
+  }
+  drmModeFreeObjectProperties(props);
+  return found == properties.size() ? 0 : -ENOENT;
+}
 }  // namespace android
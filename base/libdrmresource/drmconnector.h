@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <xf86drmMode.h>
+#include <list>
 #include <string>
 #include <vector>
 
@@ -55,6 +56,15 @@ class DrmConnector {
   int UpdateModes();
   int UpdateHdrInfo();
   int UpdateEdid();
+  int UpdateVrrCapable();
+
+  // Raw EDID read by the last UpdateEdid(), empty if there is no EDID
+  const std::vector<uint8_t> &edid() const {
+    return edid_;
+  }
+  uint64_t edid_hash() const {
+    return edid_hash_;
+  }
 
   const std::vector<DrmMode> &modes() const {
     return modes_;
@@ -79,6 +89,10 @@ class DrmConnector {
   DrmProperty &hdr_output_meta();
   DrmProperty &adjusted_fps();
   const DrmProperty &hdr_sink_connected() const;
+  const DrmProperty &vrr_capable() const;
+  // Content type and ALLM of the InfoFrames sent to the sink
+  const DrmProperty &content_type() const;
+  const DrmProperty &allm() const;
 
   const std::vector<DrmProperty *> &properties() const {
       return properties_;
@@ -133,12 +147,36 @@ class DrmConnector {
   DrmProperty lp_mode_;
   DrmProperty hdr_output_meta_;
   DrmProperty hdr_sink_connected_;
+  DrmProperty vrr_capable_;
+  DrmProperty content_type_;
+  DrmProperty allm_;
   std::vector<DrmProperty *> properties_;
 
   std::vector<DrmEncoder *> possible_encoders_;
 
   uint32_t preferred_mode_id_;
+
+  // Blob that edid_ was read from
+  uint64_t edid_blob_id_ = 0;
+  std::vector<uint8_t> edid_;
+  uint64_t edid_hash_ = 0;
+  // EDID that HDR properties were read for
+  uint64_t hdr_info_edid_hash_ = 0;
+
+  // Modes of recently connected sinks, so that a sink bouncing HPD doesn't
+  // cause a full probe. Most recently used one is at the front.
+  struct ModeCacheEntry {
+    uint64_t edid_hash;
+    std::vector<DrmMode> modes;
+    uint32_t preferred_mode_id;
+  };
+  static constexpr size_t kModeCacheSize = 4;
+  std::list<ModeCacheEntry> mode_cache_;
+
+  bool UpdateModesFromCache();
+  void CacheModes();
   int UpdateProperty(DrmProperty *property);
+  int UpdateProperties(const std::vector<DrmProperty *> &properties);
 };
 }  // namespace android
 
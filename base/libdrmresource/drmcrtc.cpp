@@ -88,6 +88,8 @@ int DrmCrtc::Init() {
     ALOGI("Failed to get &modeset_only_property");
   if (drm_->GetCrtcProperty(*this, "bts_fps", &bts_fps_property_))
     ALOGI("Failed to get &bts_fps_property");
+  if (drm_->GetCrtcProperty(*this, "VRR_ENABLED", &vrr_enabled_property_))
+    ALOGI("Failed to get &vrr_enabled_property");
 
   properties_.push_back(&active_property_);
   properties_.push_back(&mode_property_);
@@ -111,6 +113,7 @@ int DrmCrtc::Init() {
   properties_.push_back(&render_intent_property_);
   properties_.push_back(&modeset_only_property_);
   properties_.push_back(&bts_fps_property_);
+  properties_.push_back(&vrr_enabled_property_);
 
   return 0;
 }
@@ -223,4 +226,8 @@ const DrmProperty &DrmCrtc::bts_fps_property() const {
     return bts_fps_property_;
 }
 
+const DrmProperty &DrmCrtc::vrr_enabled_property() const {
+    return vrr_enabled_property_;
+}
+
 }  // namespace android
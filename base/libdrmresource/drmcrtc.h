@@ -65,6 +65,7 @@ class DrmCrtc {
   DrmProperty &render_intent_property();
   DrmProperty &modeset_only_property();
   const DrmProperty &bts_fps_property() const;
+  const DrmProperty &vrr_enabled_property() const;
 
   const std::vector<DrmProperty *> &properties() const {
       return properties_;
@@ -101,6 +102,7 @@ class DrmCrtc {
   DrmProperty render_intent_property_;
   DrmProperty modeset_only_property_;
   DrmProperty bts_fps_property_;
+  DrmProperty vrr_enabled_property_;
   std::vector<DrmProperty *> properties_;
 };
 }  // namespace android
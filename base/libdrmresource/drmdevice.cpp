@@ -44,6 +44,7 @@ DrmDevice::DrmDevice() : event_listener_(this) {
 
 DrmDevice::~DrmDevice() {
   event_listener_.Exit();
+  ClearPropertyCache();
 }
 
 std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
@@ -106,7 +107,9 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
     std::unique_ptr<DrmCrtc> crtc(new DrmCrtc(this, c, i));
     drmModeFreeCrtc(c);
 
+    CacheProperties(crtc->id(), DRM_MODE_OBJECT_CRTC);
     ret = crtc->Init();
+    ClearPropertyCache();
     if (ret) {
       ALOGE("Failed to initialize crtc %d", res->crtcs[i]);
       break;
@@ -171,7 +174,9 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
 
     drmModeFreeConnector(c);
 
+    CacheProperties(conn->id(), DRM_MODE_OBJECT_CONNECTOR);
     ret = conn->Init();
+    ClearPropertyCache();
     if (ret) {
       ALOGE("Init connector %d failed", res->connectors[i]);
       break;
@@ -236,7 +241,9 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
 
     drmModeFreePlane(p);
 
+    CacheProperties(plane->id(), DRM_MODE_OBJECT_PLANE);
     ret = plane->Init();
+    ClearPropertyCache();
     if (ret) {
       ALOGE("Init plane %d failed", plane_res->planes[i]);
       break;
@@ -454,8 +461,48 @@ DrmEventListener *DrmDevice::event_listener() {
   return &event_listener_;
 }
 
+void DrmDevice::CacheProperties(uint32_t obj_id, uint32_t obj_type) {
+  ClearPropertyCache();
+
+  drmModeObjectPropertiesPtr props =
+      drmModeObjectGetProperties(fd(), obj_id, obj_type);
+  if (!props) {
+    ALOGE("Failed to get properties for %d/%x", obj_id, obj_type);
+    return;
+  }
+
+  property_cache_.obj_id = obj_id;
+  property_cache_.obj_type = obj_type;
+  for (uint32_t i = 0; i < props->count_props; ++i) {
+    drmModePropertyPtr p = drmModeGetProperty(fd(), props->props[i]);
+    if (p)
+      property_cache_.properties.emplace_back(p, props->prop_values[i]);
+  }
+  drmModeFreeObjectProperties(props);
+}
+
+void DrmDevice::ClearPropertyCache() {
+  for (auto &property : property_cache_.properties)
+    drmModeFreeProperty(property.first);
+  property_cache_.properties.clear();
+  property_cache_.obj_id = 0;
+  property_cache_.obj_type = 0;
+}
+
 int DrmDevice::GetProperty(uint32_t obj_id, uint32_t obj_type,
                            const char *prop_name, DrmProperty *property) {
+  if ((property_cache_.obj_id == obj_id) &&
+      (property_cache_.obj_type == obj_type)) {
+    for (auto &cached : property_cache_.properties) {
+      if (!strcmp(cached.first->name, prop_name)) {
+        property->Init(cached.first, cached.second);
+        return 0;
+      }
+    }
+    property->SetName(prop_name);
+    return -ENOENT;
+  }
+
   drmModeObjectPropertiesPtr props;
 
   props = drmModeObjectGetProperties(fd(), obj_id, obj_type);
@@ -507,12 +554,10 @@ int DrmDevice::UpdateCrtcProperty(const DrmCrtc &crtc, DrmProperty *property) {
     }
     bool found = false;
     for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-        drmModePropertyPtr p = drmModeGetProperty(fd(), props->props[i]);
         if (props->props[i] == property->id()) {
             property->UpdateValue(props->prop_values[i]);
             found = true;
         }
-        drmModeFreeProperty(p);
     }
     drmModeFreeObjectProperties(props);
     return found ? 0 : -ENOENT;
@@ -527,12 +572,10 @@ int DrmDevice::UpdateConnectorProperty(const DrmConnector &connector, DrmPropert
     }
     bool found = false;
     for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-        drmModePropertyPtr p = drmModeGetProperty(fd(), props->props[i]);
         if (props->props[i] == property->id()) {
             property->UpdateValue(props->prop_values[i]);
             found = true;
         }
-        drmModeFreeProperty(p);
     }
     drmModeFreeObjectProperties(props);
     return found ? 0 : -ENOENT;
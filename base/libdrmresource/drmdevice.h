@@ -89,6 +89,10 @@ class DrmDevice {
   int TryEncoderForDisplay(int display, DrmEncoder *enc);
   int GetProperty(uint32_t obj_id, uint32_t obj_type, const char *prop_name,
                   DrmProperty *property);
+  // Properties of an object are read from the kernel once while the object
+  // is initialized instead of every GetProperty() call.
+  void CacheProperties(uint32_t obj_id, uint32_t obj_type);
+  void ClearPropertyCache();
 
   int CreateDisplayPipe(DrmConnector *connector);
   int AttachWriteback(int display);
@@ -106,6 +110,12 @@ class DrmDevice {
   std::pair<uint32_t, uint32_t> min_resolution_;
   std::pair<uint32_t, uint32_t> max_resolution_;
   std::map<int, int> displays_;
+
+  struct PropertyCache {
+    uint32_t obj_id = 0;
+    uint32_t obj_type = 0;
+    std::vector<std::pair<drmModePropertyPtr, uint64_t>> properties;
+  } property_cache_;
 };
 }  // namespace android
 
@@ -22,7 +22,10 @@
 #include <assert.h>
 #include <errno.h>
 #include <linux/netlink.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
@@ -32,12 +35,16 @@
 bool mResetPanel = false;
 namespace android {
 
+static const int kMaxEpollEvents = 4;
+
 DrmEventListener::DrmEventListener(DrmDevice *drm)
-    : Worker("drm-event-listener", HAL_PRIORITY_URGENT_DISPLAY), drm_(drm) {
+    : Worker("drm-event-listener", HAL_PRIORITY_URGENT_DISPLAY), drm_(drm),
+      uevent_dispatcher_(this) {
 }
 
 int DrmEventListener::Init() {
-  uevent_fd_.Set(socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT));
+  uevent_fd_.Set(socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_KOBJECT_UEVENT));
   if (uevent_fd_.get() < 0) {
     ALOGE("Failed to open uevent socket: %s", strerror(errno));
     return uevent_fd_.get();
@@ -55,30 +62,69 @@ int DrmEventListener::Init() {
     return -errno;
   }
 
-  FD_ZERO(&fds_);
-  FD_SET(drm_->fd(), &fds_);
-  FD_SET(uevent_fd_.get(), &fds_);
-  max_fd_ = std::max(drm_->fd(), uevent_fd_.get());
+  wake_fd_.Set(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (wake_fd_.get() < 0) {
+    ALOGE("Failed to create wake fd: %s", strerror(errno));
+    return -errno;
+  }
+
+  epoll_fd_.Set(epoll_create1(EPOLL_CLOEXEC));
+  if (epoll_fd_.get() < 0) {
+    ALOGE("Failed to create epoll: %s", strerror(errno));
+    return -errno;
+  }
+
+  for (int fd : {drm_->fd(), uevent_fd_.get(), wake_fd_.get()}) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, fd, &event)) {
+      ALOGE("Failed to add fd(%d) to epoll: %s", fd, strerror(errno));
+      return -errno;
+    }
+  }
+
+  ret = uevent_dispatcher_.Init();
+  if (ret) {
+    ALOGE("Failed to initialize uevent dispatcher %d", ret);
+    return ret;
+  }
 
   return InitWorker();
 }
 
+void DrmEventListener::Exit() {
+  /* wake_fd_ is never cleared, Routine() returns until exit is handled */
+  if (wake_fd_.get() >= 0) {
+    uint64_t value = 1;
+    if (write(wake_fd_.get(), &value, sizeof(value)) < 0)
+      ALOGE("Failed to wake up event listener: %s", strerror(errno));
+  }
+  Worker::Exit();
+  uevent_dispatcher_.Exit();
+}
+
 void DrmEventListener::RegisterHotplugHandler(DrmEventHandler *handler) {
+  std::lock_guard<std::mutex> lock(handler_mutex_);
   assert(!hotplug_handler_);
   hotplug_handler_.reset(handler);
 }
 
 void DrmEventListener::UnRegisterHotplugHandler(DrmEventHandler *handler) {
+    std::lock_guard<std::mutex> lock(handler_mutex_);
     if (handler == hotplug_handler_.get())
         hotplug_handler_ = NULL;
 }
 
 void DrmEventListener::RegisterPanelResetHandler(DrmEventHandler *handler) {
+    std::lock_guard<std::mutex> lock(handler_mutex_);
     assert(!panelreset_handler_);
     panelreset_handler_.reset(handler);
 }
 
 void DrmEventListener::UnRegisterPanelResetHandler(DrmEventHandler *handler) {
+    std::lock_guard<std::mutex> lock(handler_mutex_);
     if (handler == panelreset_handler_.get())
         panelreset_handler_ = NULL;
 }
@@ -94,6 +140,20 @@ void DrmEventListener::FlipHandler(int /* fd */, unsigned int /* sequence */,
   delete handler;
 }
 
+void DrmEventListener::DispatchUEvent(UEventType type, uint64_t timestamp) {
+  std::lock_guard<std::mutex> lock(handler_mutex_);
+  switch (type) {
+    case UEVENT_HOTPLUG:
+      if (hotplug_handler_)
+        hotplug_handler_->HandleEvent(timestamp);
+      break;
+    case UEVENT_PANEL_RESET:
+      if (panelreset_handler_)
+        panelreset_handler_->HandlePanelEvent(timestamp);
+      break;
+  }
+}
+
 static const uint64_t kOneSecondNs = 1ULL * 1000 * 1000 * 1000;
 void DrmEventListener::UEventHandler() {
   char buffer[1024] = {0};
@@ -112,12 +172,12 @@ void DrmEventListener::UEventHandler() {
     if (ret == 0) {
       return;
     } else if (ret < 0) {
-      ALOGE("Got error reading uevent %d", ret);
+      /* All of the pending uevents are read */
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        ALOGE("Got error reading uevent %d", ret);
       return;
     }
-
-    if (!hotplug_handler_)
-      continue;
+    buffer[ret] = '\0';
 
     bool drm_event = false, hotplug_event = false;
     for (int i = 0; i < ret;) {
@@ -136,29 +196,69 @@ void DrmEventListener::UEventHandler() {
       i += strlen(event) + 1;
     }
     if (drm_event && mResetPanel) {
-      panelreset_handler_->HandlePanelEvent(timestamp);
+      uevent_dispatcher_.Queue(UEVENT_PANEL_RESET, timestamp);
       mResetPanel = false;
     }
     if (drm_event && hotplug_event)
-      hotplug_handler_->HandleEvent(timestamp);
+      uevent_dispatcher_.Queue(UEVENT_HOTPLUG, timestamp);
   }
 }
 
 void DrmEventListener::Routine() {
+  struct epoll_event events[kMaxEpollEvents];
   int ret;
   do {
-    ret = select(max_fd_ + 1, &fds_, NULL, NULL, NULL);
+    ret = epoll_wait(epoll_fd_.get(), events, kMaxEpollEvents, -1);
   } while (ret == -1 && errno == EINTR);
 
-  if (FD_ISSET(drm_->fd(), &fds_)) {
-    drmEventContext event_context =
-        {.version = 2,
-         .vblank_handler = NULL,
-         .page_flip_handler = DrmEventListener::FlipHandler};
-    drmHandleEvent(drm_->fd(), &event_context);
+  if (ret < 0) {
+    ALOGE("Failed to wait events: %s", strerror(errno));
+    return;
+  }
+
+  bool has_uevent = false;
+  for (int i = 0; i < ret; i++) {
+    /* Flip events are handled first, uevents are only queued here */
+    if (events[i].data.fd == drm_->fd()) {
+      drmEventContext event_context =
+          {.version = 2,
+           .vblank_handler = NULL,
+           .page_flip_handler = DrmEventListener::FlipHandler};
+      drmHandleEvent(drm_->fd(), &event_context);
+    } else if (events[i].data.fd == uevent_fd_.get()) {
+      has_uevent = true;
+    }
   }
 
-  if (FD_ISSET(uevent_fd_.get(), &fds_))
+  if (has_uevent)
     UEventHandler();
 }
+
+DrmEventListener::UEventDispatcher::UEventDispatcher(DrmEventListener *listener)
+    : Worker("drm-uevent-dispatcher", HAL_PRIORITY_URGENT_DISPLAY),
+      listener_(listener) {
+}
+
+void DrmEventListener::UEventDispatcher::Queue(UEventType type,
+                                               uint64_t timestamp) {
+  Lock();
+  queue_.push_back({type, timestamp});
+  Unlock();
+  Signal();
+}
+
+void DrmEventListener::UEventDispatcher::Routine() {
+  std::deque<UEvent> events;
+
+  Lock();
+  if (queue_.empty() && (WaitForSignalOrExitLocked() == -EINTR)) {
+    Unlock();
+    return;
+  }
+  events.swap(queue_);
+  Unlock();
+
+  for (auto &event : events)
+    listener_->DispatchUEvent(event.type, event.timestamp);
+}
 }  // namespace android
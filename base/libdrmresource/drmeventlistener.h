@@ -17,6 +17,8 @@
 #ifndef ANDROID_DRM_EVENT_LISTENER_H_
 #define ANDROID_DRM_EVENT_LISTENER_H_
 
+#include <deque>
+#include <memory>
 #include "autofd.h"
 #include "worker.h"
 
@@ -42,6 +44,7 @@ class DrmEventListener : public Worker {
   }
 
   int Init();
+  void Exit();
 
   void RegisterHotplugHandler(DrmEventHandler *handler);
   void UnRegisterHotplugHandler(DrmEventHandler *handler);
@@ -55,15 +58,48 @@ class DrmEventListener : public Worker {
   virtual void Routine();
 
  private:
+  enum UEventType {
+    UEVENT_HOTPLUG,
+    UEVENT_PANEL_RESET,
+  };
+
+  /*
+   * Hotplug and panel reset handlers can take long (e.g. EDID reprobe),
+   * they are called on this worker so that flip events are not delayed.
+   */
+  class UEventDispatcher : public Worker {
+   public:
+    UEventDispatcher(DrmEventListener *listener);
+    int Init() {
+      return InitWorker();
+    }
+    void Queue(UEventType type, uint64_t timestamp);
+
+   protected:
+    virtual void Routine();
+
+   private:
+    struct UEvent {
+      UEventType type;
+      uint64_t timestamp;
+    };
+    DrmEventListener *listener_;
+    std::deque<UEvent> queue_;
+  };
+
   void UEventHandler();
+  void DispatchUEvent(UEventType type, uint64_t timestamp);
 
-  fd_set fds_;
+  UniqueFd epoll_fd_;
+  /* Wakes up epoll_wait() on Exit() */
+  UniqueFd wake_fd_;
   UniqueFd uevent_fd_;
-  int max_fd_ = -1;
 
   DrmDevice *drm_;
+  std::mutex handler_mutex_;
   std::unique_ptr<DrmEventHandler> hotplug_handler_;
   std::unique_ptr<DrmEventHandler> panelreset_handler_;
+  UEventDispatcher uevent_dispatcher_;
 };
 }  // namespace android
 
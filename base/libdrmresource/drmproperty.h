@@ -44,8 +44,12 @@ class DrmProperty {
   void SetName(std::string name) { name_ = name; };
   std::tuple<uint64_t, int> GetEnumValueWithName(std::string name) const;
 
-  uint32_t id() const;
-  std::string name() const;
+  uint32_t id() const {
+    return id_;
+  }
+  const std::string &name() const {
+    return name_;
+  }
 
   std::tuple<int, uint64_t> value() const;
   bool is_immutable() const;
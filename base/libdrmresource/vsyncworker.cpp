@@ -50,9 +50,7 @@ int VSyncWorker::Init(DrmDevice *drm, int display) {
 }
 
 void VSyncWorker::RegisterCallback(VsyncCallback* callback) {
-  Lock();
-  callback_ = callback;
-  Unlock();
+  callback_.store(callback);
 }
 
 void VSyncWorker::VSyncControl(bool enabled) {
@@ -117,18 +115,24 @@ int VSyncWorker::SyntheticWaitVBlank(int64_t *timestamp) {
 void VSyncWorker::Routine() {
   int ret;
 
-  Lock();
+  /*
+   * Worker lock is taken only to wait for enable signal so that
+   * vsync delivery doesn't contend with VSyncControl() callers.
+   */
   if (!enabled_) {
-    ret = WaitForSignalOrExitLocked();
-    if (ret == -EINTR) {
-      Unlock();
-      return;
+    Lock();
+    if (!enabled_) {
+      ret = WaitForSignalOrExitLocked();
+      if (ret == -EINTR) {
+        Unlock();
+        return;
+      }
     }
+    Unlock();
   }
 
   int display = display_;
-  VsyncCallback* callback(callback_);
-  Unlock();
+  VsyncCallback* callback = callback_.load();
 
   DrmCrtc *crtc = drm_->GetCrtcForDisplay(display);
   if (!crtc) {
@@ -21,6 +21,7 @@
 #include "worker.h"
 
 #include <stdint.h>
+#include <atomic>
 #include <map>
 
 #include <hardware/hardware.h>
@@ -54,7 +55,8 @@ class VSyncWorker : public Worker {
 
   DrmDevice *drm_;
 
-  VsyncCallback* callback_ = NULL;
+  /* Read by Routine() without the worker lock */
+  std::atomic<VsyncCallback*> callback_ = NULL;
 
   int display_;
   std::atomic_bool enabled_;
@@ -14,8 +14,14 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "hwc-drm-worker"
+
 #include "worker.h"
 
+#include <cutils/properties.h>
+#include <log/log.h>
+#include <sched.h>
+#include <string.h>
 #include <sys/prctl.h>
 #include <sys/resource.h>
 
@@ -76,8 +82,37 @@ int Worker::WaitForSignalOrExitLocked(int64_t max_nanoseconds) {
   return ret;
 }
 
-void Worker::InternalRoutine() {
+void Worker::SetSchedPolicy() {
   setpriority(PRIO_PROCESS, 0, priority_);
+
+  // Optional, a CPU of a busy cluster delays the vsync and the flip events
+  uint32_t cpus = property_get_int32("vendor.hwc.drm.worker.cpus", 0);
+  if (cpus) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu = 0; cpu < 32; cpu++) {
+      if (cpus & (1U << cpu))
+        CPU_SET(cpu, &mask);
+    }
+    if (sched_setaffinity(0, sizeof(mask), &mask) < 0)
+      ALOGW("%s: failed to set affinity(0x%x): %s", name_.c_str(), cpus,
+            strerror(errno));
+  }
+
+  // Optional, SCHED_FIFO keeps the events on time while CFS is crowded. The
+  // thread stays at priority_ if it is not permitted.
+  int rt_priority = property_get_int32("vendor.hwc.drm.worker.rt_priority", 0);
+  if (rt_priority > 0) {
+    struct sched_param param = {};
+    param.sched_priority = rt_priority;
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) < 0)
+      ALOGW("%s: failed to set SCHED_FIFO(%d): %s", name_.c_str(), rt_priority,
+            strerror(errno));
+  }
+}
+
+void Worker::InternalRoutine() {
+  SetSchedPolicy();
   prctl(PR_SET_NAME, name_.c_str());
 
   std::unique_lock<std::mutex> lk(mutex_, std::defer_lock);
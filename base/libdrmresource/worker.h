@@ -70,6 +70,12 @@ class Worker {
 
  private:
   void InternalRoutine();
+  /*
+   * Applies priority_ and the optional policy of the properties:
+   * vendor.hwc.drm.worker.rt_priority : SCHED_FIFO priority, 0 for none
+   * vendor.hwc.drm.worker.cpus : bit mask of the CPUs, 0 for any CPU
+   */
+  void SetSchedPolicy();
 
   std::string name_;
   int priority_;
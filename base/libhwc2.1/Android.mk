@@ -50,6 +50,14 @@ LOCAL_SHARED_LIBRARIES += libdisplaycolor_default
 LOCAL_HEADER_LIBRARIES += libdisplaycolor_interface
 endif
 
+ifeq ($(BOARD_USES_HWC_LAYER_DUMP_LZ4), true)
+LOCAL_SHARED_LIBRARIES += liblz4
+endif
+
+ifeq ($(BOARD_USES_HWC_PERFETTO_TRACE), true)
+LOCAL_STATIC_LIBRARIES += libperfetto_client_experimental
+endif
+
 LOCAL_C_INCLUDES += \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/device \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/utils \
@@ -68,7 +76,8 @@ LOCAL_C_INCLUDES += \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/externaldisplay \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/virtualdisplay \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/libhwcService \
-	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libdrmresource
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libdrmresource \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/include
 
 LOCAL_SRC_FILES := \
 	device/ExynosDevice.cpp \
@@ -76,12 +85,16 @@ LOCAL_SRC_FILES := \
 	device/ExynosDeviceFbInterface.cpp \
 	device/ExynosDeviceInterface.cpp \
 	device/ExynosResourceManager.cpp \
+	device/ExynosRestrictionBlob.cpp \
 	display/ExynosDisplay.cpp \
 	display/ExynosDisplayDrmInterface.cpp \
 	display/ExynosDrmFramebufferManager.cpp \
 	display/ExynosDisplayFbInterface.cpp \
 	display/ExynosDisplayInterface.cpp \
 	display/ExynosLayer.cpp \
+	display/ExynosReadbackRing.cpp \
+	display/ExynosContentSampler.cpp \
+	display/ExynosFrameCrc.cpp \
 	primarydisplay/ExynosPrimaryDisplay.cpp \
 	primarydisplay/ExynosPrimaryDisplayFbInterface.cpp \
 	externaldisplay/ExynosExternalDisplay.cpp \
@@ -89,7 +102,13 @@ LOCAL_SRC_FILES := \
 	virtualdisplay/ExynosVirtualDisplay.cpp \
 	virtualdisplay/ExynosVirtualDisplayFbInterface.cpp \
 	resources/ExynosMPP.cpp \
+	resources/ExynosMPPBufferPool.cpp \
 	utils/ExynosFenceTracer.cpp \
+	utils/ExynosLatencyStats.cpp \
+	utils/ExynosFrameRecorder.cpp \
+	utils/ExynosPerfettoTrace.cpp \
+	utils/ExynosVsyncModel.cpp \
+	utils/ExynosWorkerPool.cpp \
 	utils/ExynosHWCDebug.cpp \
 	utils/ExynosHWCFormat.cpp \
 	utils/ExynosHWCHelper.cpp \
@@ -107,6 +126,12 @@ ifeq ($(TARGET_BUILD_VARIANT), user)
 LOCAL_CFLAGS += -Wno-unused-variable
 endif
 LOCAL_CFLAGS += -Wthread-safety
+ifeq ($(BOARD_USES_HWC_LAYER_DUMP_LZ4), true)
+LOCAL_CFLAGS += -DUSE_LAYER_DUMP_LZ4
+endif
+ifeq ($(BOARD_USES_HWC_PERFETTO_TRACE), true)
+LOCAL_CFLAGS += -DUSE_PERFETTO_TRACE
+endif
 
 LOCAL_MODULE := libexynosdisplay
 LOCAL_MODULE_TAGS := optional
@@ -144,7 +169,8 @@ LOCAL_C_INCLUDES += \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/externaldisplay \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/virtualdisplay \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/libhwcService \
-	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libdrmresource
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libdrmresource \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/include
 
 LOCAL_CFLAGS := -DHLOG_CODE=0
 LOCAL_CFLAGS += -DLOG_TAG=\"hwc-service\"
@@ -253,21 +279,7 @@ include $(BUILD_SHARED_LIBRARY)
 
 ################################################################################
 
-include $(CLEAR_VARS)
-
-LOCAL_PROPRIETARY_MODULE := true
-
-LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libexynosdisplay libacryl \
-                          libui libion libdrmresource
-
-LOCAL_PROPRIETARY_MODULE := true
-LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers libbinder_headers libexynos_headers
-LOCAL_STATIC_LIBRARIES := libgtest libgmock
-
-LOCAL_CFLAGS := -DHLOG_CODE=0
-LOCAL_CFLAGS += -DLOG_TAG=\"hwc-2\"
-
-LOCAL_C_INCLUDES += \
+HWC_TEST_C_INCLUDES := \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/unittest \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/device \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/utils \
@@ -288,6 +300,22 @@ LOCAL_C_INCLUDES += \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/libhwcService \
 	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libdrmresource
 
+include $(CLEAR_VARS)
+
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libexynosdisplay libacryl \
+                          libui libion libdrmresource
+
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers libbinder_headers libexynos_headers
+LOCAL_STATIC_LIBRARIES := libgtest libgmock
+
+LOCAL_CFLAGS := -DHLOG_CODE=0
+LOCAL_CFLAGS += -DLOG_TAG=\"hwc-2\"
+
+LOCAL_C_INCLUDES += $(HWC_TEST_C_INCLUDES)
+
 LOCAL_HEADER_LIBRARIES += libhdrinterface_header libhdr10p_meta_interface_header
 ifdef BOARD_LIBHDR_PLUGIN
     LOCAL_SHARED_LIBRARIES += $(BOARD_LIBHDR_PLUGIN)
@@ -316,3 +344,47 @@ LOCAL_MODULE := hwcomposer_unittest
 
 include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
 include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libexynosdisplay libacryl \
+                          libui libion libdrmresource
+
+LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers libbinder_headers libexynos_headers
+
+LOCAL_CFLAGS := -DHLOG_CODE=0
+LOCAL_CFLAGS += -DLOG_TAG=\"hwc-2\"
+LOCAL_CFLAGS += -DHWC_BENCHMARK_SOC=\"$(TARGET_SOC_BASE)\"
+
+LOCAL_C_INCLUDES += $(HWC_TEST_C_INCLUDES)
+
+LOCAL_HEADER_LIBRARIES += libhdrinterface_header libhdr10p_meta_interface_header
+ifdef BOARD_LIBHDR_PLUGIN
+    LOCAL_SHARED_LIBRARIES += $(BOARD_LIBHDR_PLUGIN)
+endif
+ifdef BOARD_LIBHDR10P_META_PLUGIN
+    LOCAL_SHARED_LIBRARIES += $(BOARD_LIBHDR10P_META_PLUGIN)
+endif
+
+ifeq ($(BOARD_USES_DQE_INTERFACE), true)
+LOCAL_SHARED_LIBRARIES += libdqeInterface
+LOCAL_HEADER_LIBRARIES += libdqeInterface_headers
+endif
+
+ifeq ($(BOARD_USES_DISPLAY_COLOR_INTERFACE), true)
+LOCAL_SHARED_LIBRARIES += libdisplaycolor_default
+LOCAL_HEADER_LIBRARIES += libdisplaycolor_interface
+endif
+
+LOCAL_SRC_FILES := \
+	unittests/HwcBenchmark.cpp
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+LOCAL_MODULE := hwcomposer_benchmark
+
+include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
+include $(BUILD_NATIVE_BENCHMARK)
@@ -103,9 +103,9 @@ hwc2_function_pointer_t exynos_function_pointer[] = {
     reinterpret_cast<hwc2_function_pointer_t>(exynos_getDisplayIdentificationData),   //HWC2_FUNCTION_GET_DISPLAY_IDENTIFICATION_DATA
     reinterpret_cast<hwc2_function_pointer_t>(exynos_getDisplayCapabilities),         //HWC2_FUNCTION_GET_DISPLAY_CAPABILITIES
     reinterpret_cast<hwc2_function_pointer_t>(exynos_setLayerColorTransform),         //HWC2_FUNCTION_SET_LAYER_COLOR_TRANSFORM
-    reinterpret_cast<hwc2_function_pointer_t>(NULL),                                  //HWC2_FUNCTION_GET_DISPLAYED_CONTENT_SAMPLING_ATTRIBUTES
-    reinterpret_cast<hwc2_function_pointer_t>(NULL),                                  //HWC2_FUNCTION_SET_DISPLAYED_CONTENT_SAMPLING_ENABLED
-    reinterpret_cast<hwc2_function_pointer_t>(NULL),                                  //HWC2_FUNCTION_GET_DISPLAYED_CONTENT_SAMPLE
+    reinterpret_cast<hwc2_function_pointer_t>(exynos_getDisplayedContentSamplingAttributes),  //HWC2_FUNCTION_GET_DISPLAYED_CONTENT_SAMPLING_ATTRIBUTES
+    reinterpret_cast<hwc2_function_pointer_t>(exynos_setDisplayedContentSamplingEnabled),     //HWC2_FUNCTION_SET_DISPLAYED_CONTENT_SAMPLING_ENABLED
+    reinterpret_cast<hwc2_function_pointer_t>(exynos_getDisplayedContentSample),              //HWC2_FUNCTION_GET_DISPLAYED_CONTENT_SAMPLE
     reinterpret_cast<hwc2_function_pointer_t>(exynos_setLayerPerFrameMetadataBlobs),  //HWC2_FUNCTION_SET_LAYER_PER_FRAME_METADATA_BLOBS
     reinterpret_cast<hwc2_function_pointer_t>(exynos_getDisplayBrightnessSupport),    //HWC2_FUNCTION_GET_DISPLAY_BRIGHTNESS_SUPPORT
     reinterpret_cast<hwc2_function_pointer_t>(exynos_setDisplayBrightness),           //HWC2_FUNCTION_SET_DISPLAY_BRIGHTNESS
@@ -592,7 +592,7 @@ int32_t exynos_setLayerBlendMode(hwc2_device_t *dev, hwc2_display_t display,
         if (exynosDisplay) {
             ExynosLayer *exynosLayer = checkLayer(exynosDisplay, layer);
             if (exynosLayer)
-                return exynosDevice->setLayerBlendMode(exynosLayer, mode);
+                return exynosDevice->setLayerBlendMode(exynosDisplay, exynosLayer, mode);
         }
     }
 
@@ -639,7 +639,7 @@ int32_t exynos_setLayerCompositionType(hwc2_device_t *dev, hwc2_display_t displa
         if (exynosDisplay) {
             ExynosLayer *exynosLayer = checkLayer(exynosDisplay, layer);
             if (exynosLayer)
-                return exynosDevice->setLayerCompositionType(exynosLayer, type);
+                return exynosDevice->setLayerCompositionType(exynosDisplay, exynosLayer, type);
         }
     }
 
@@ -670,7 +670,7 @@ int32_t exynos_setLayerDisplayFrame(hwc2_device_t *dev, hwc2_display_t display,
         if (exynosDisplay) {
             ExynosLayer *exynosLayer = checkLayer(exynosDisplay, layer);
             if (exynosLayer)
-                return exynosDevice->setLayerDisplayFrame(exynosLayer, frame);
+                return exynosDevice->setLayerDisplayFrame(exynosDisplay, exynosLayer, frame);
         }
     }
 
@@ -702,7 +702,7 @@ int32_t exynos_setLayerSourceCrop(hwc2_device_t *dev, hwc2_display_t display,
         if (exynosDisplay) {
             ExynosLayer *exynosLayer = checkLayer(exynosDisplay, layer);
             if (exynosLayer)
-                return exynosDevice->setLayerSourceCrop(exynosLayer, crop);
+                return exynosDevice->setLayerSourceCrop(exynosDisplay, exynosLayer, crop);
         }
     }
 
@@ -734,7 +734,7 @@ int32_t exynos_setLayerTransform(hwc2_device_t *dev, hwc2_display_t display,
         if (exynosDisplay) {
             ExynosLayer *exynosLayer = checkLayer(exynosDisplay, layer);
             if (exynosLayer)
-                return exynosDevice->setLayerTransform(exynosLayer, transform);
+                return exynosDevice->setLayerTransform(exynosDisplay, exynosLayer, transform);
         }
     }
 
@@ -766,7 +766,7 @@ int32_t exynos_setLayerZOrder(hwc2_device_t *dev, hwc2_display_t display,
         if (exynosDisplay) {
             ExynosLayer *exynosLayer = checkLayer(exynosDisplay, layer);
             if (exynosLayer)
-                return exynosDevice->setLayerZOrder(exynosLayer, z);
+                return exynosDevice->setLayerZOrder(exynosDisplay, exynosLayer, z);
         }
     }
 
@@ -941,6 +941,56 @@ int32_t exynos_getDisplayCapabilities(hwc2_device_t *dev, hwc2_display_t display
     return HWC2_ERROR_BAD_DISPLAY;
 }
 
+int32_t exynos_getDisplayedContentSamplingAttributes(hwc2_device_t *dev, hwc2_display_t display,
+                                                     int32_t * /* android_pixel_format_t */ format,
+                                                     int32_t * /* android_dataspace_t */ dataspace,
+                                                     uint8_t * /* mask of android_component_t */ supported_components) {
+    ExynosDevice *exynosDevice = checkDevice(dev);
+
+    if (exynosDevice) {
+        ExynosDisplay *exynosDisplay = checkDisplay(exynosDevice, display);
+        if (exynosDisplay)
+            return exynosDisplay->getDisplayedContentSamplingAttributes(format, dataspace,
+                                                                        supported_components);
+    }
+
+    return HWC2_ERROR_BAD_DISPLAY;
+}
+
+int32_t exynos_setDisplayedContentSamplingEnabled(hwc2_device_t *dev, hwc2_display_t display,
+                                                  int32_t /*hwc2_displayed_content_sampling_t*/ enabled,
+                                                  uint8_t /* mask of android_component_t */ component_mask,
+                                                  uint64_t max_frames) {
+    ExynosDevice *exynosDevice = checkDevice(dev);
+
+    if (exynosDevice) {
+        ExynosDisplay *exynosDisplay = checkDisplay(exynosDevice, display);
+        if (exynosDisplay)
+            return exynosDisplay->setDisplayedContentSamplingEnabled(enabled, component_mask,
+                                                                     max_frames);
+    }
+
+    return HWC2_ERROR_BAD_DISPLAY;
+}
+
+int32_t exynos_getDisplayedContentSample(hwc2_device_t *dev, hwc2_display_t display,
+                                         uint64_t max_frames, uint64_t timestamp,
+                                         uint64_t *frame_count, int32_t samples_size[4], uint64_t *samples[4]) {
+    if ((frame_count == nullptr) || (samples_size == nullptr))
+        return HWC2_ERROR_BAD_PARAMETER;
+
+    ExynosDevice *exynosDevice = checkDevice(dev);
+
+    if (exynosDevice) {
+        ExynosDisplay *exynosDisplay = checkDisplay(exynosDevice, display);
+        if (exynosDisplay)
+            return exynosDisplay->getDisplayedContentSample(max_frames, timestamp, frame_count,
+                                                            samples_size, samples);
+    }
+
+    return HWC2_ERROR_BAD_DISPLAY;
+}
+
 int32_t exynos_setLayerColorTransform(hwc2_device_t *dev,
                                       hwc2_display_t display, hwc2_layer_t layer, const float *matrix) {
     if (matrix == nullptr)
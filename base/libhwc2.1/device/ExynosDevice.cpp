@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <sched.h>
 #include <dlfcn.h>
 
@@ -28,12 +29,20 @@
 #include "ExynosVirtualDisplayModule.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosLatencyStats.h"
+#include "ExynosFrameRecorder.h"
+#include "ExynosPerfettoTrace.h"
+#include "ExynosMPPBufferPool.h"
 #include "ExynosDeviceFbInterface.h"
 #include "ExynosDeviceDrmInterface.h"
 #include <sync/sync.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
+#include <linux/sched.h>
+#include <linux/sched/types.h>
 #include "ExynosGraphicBuffer.h"
+#include "hwc_status_page.h"
 
 #ifdef USES_HWC_CPU_PERF_MODE
 #include "CpuPerfInfo.h"
@@ -76,6 +85,14 @@ ExynosDevice::ExynosDevice()
       mTotalDumpCount(0),
       mIsDumpRequest(false),
       mInterfaceType(INTERFACE_TYPE_FB) {
+    nsecs_t phaseStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    auto endInitPhase = [&](const char *name) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        addInitPhase(name, now - phaseStart);
+        phaseStart = now;
+    };
+
+    ExynosPerfettoTrace::init();
 #ifdef ENABLE_FORCE_GPU
     exynosHWCControl.forceGpu = true;
 #else
@@ -97,10 +114,22 @@ ExynosDevice::ExynosDevice()
     exynosHWCControl.fenceTracer = 0;
     exynosHWCControl.sysFenceLogging = false;
     exynosHWCControl.usePerfFile = false;
+    exynosHWCControl.parallelValidate = false;
+    exynosHWCControl.atomicPropertyShadow = false;
+    exynosHWCControl.ppcModel = PPC_MODEL_TABLE;
+    exynosHWCControl.m2mPipeline = false;
+    exynosHWCControl.m2mCapaBroker = false;
+    exynosHWCControl.dppPowerGating = false;
+    exynosHWCControl.fbPreImport = false;
+    exynosHWCControl.validateFingerprint = false;
+    exynosHWCControl.dpuBandwidthBudget = DPU_READ_BW_BUDGET_MBPS;
+    exynosHWCControl.speculativePrevalidate = false;
+    exynosHWCControl.adaptiveDstBuf = false;
 
     /* Initialize pre defined format */
     PredefinedFormat::init();
     ExynosMPP::initDefaultMppFormats();
+    endInitPhase("formats");
 
     hwcDebug = 0;
 
@@ -117,6 +146,7 @@ ExynosDevice::ExynosDevice()
     DeviceResourceInfo deviceResourceInfo;
     getDeviceResourceInfo(deviceResourceInfo);
     mResourceManager->setDeviceInfo(deviceResourceInfo);
+    endInitPhase("resource_manager");
 
     String8 strDispW;
     String8 strDispH;
@@ -168,6 +198,8 @@ ExynosDevice::ExynosDevice()
         }
     }
 
+    endInitPhase("displays");
+
     for (uint32_t i = 0; i < FENCE_IP_ALL; i++)
         hwcFenceDebug[i] = 0;
 
@@ -190,7 +222,9 @@ ExynosDevice::ExynosDevice()
 
     initDeviceInterface(mInterfaceType);
     registerHandlers();
+    endInitPhase("device_interface");
     registerRestrictions();
+    endInitPhase("restrictions");
     /*
      * Otf MPP could be created by registerRestrictions.
      * initDisplays should be called after registerRestrictions for this case.
@@ -200,6 +234,7 @@ ExynosDevice::ExynosDevice()
     int ret = mResourceManager->doPreProcessing();
     if (ret)
         ALOGI("ExynosResourceManager::doPreProcessing return fail %d", ret);
+    endInitPhase("init_displays");
 
     mCanProcessWCG = mResourceManager->deviceSupportWCG();
 
@@ -239,6 +274,7 @@ ExynosDevice::ExynosDevice()
 
     if (!mEPICAcquireConditional || !mEPICFreeConditional)
         ALOGI("%s: Additional DLSYM failed\n", __func__);
+    endInitPhase("epic");
 #endif
 
     if (mInterfaceType == INTERFACE_TYPE_DRM) {
@@ -250,6 +286,11 @@ ExynosDevice::ExynosDevice()
 
     mResourceManager->initDisplaysTDMInfo();
     handleVsyncPeriodChange();
+    endInitPhase("tdm_vsync");
+
+    mStatusPage = hwc_status_page_create(&mStatusPageFd);
+    if (mStatusPage == NULL)
+        ALOGE("%s: failed to create status page", __func__);
 }
 
 void ExynosDevice::updateNonPrimaryDisplayList(ExynosDisplay *display) {
@@ -306,7 +347,10 @@ void ExynosDevice::handleHotplug() {
                 continue;
             if (mDisplays[i]->mType == HWC_DISPLAY_VIRTUAL)
                 continue;
+            mDisplays[i]->mDisplayInterface->updateHotplugStatus();
             if (mDisplays[i]->checkHotplugEventUpdated(hpdStatus)) {
+                LayerLocks layerLocks(*this);
+                layerLocks.lock(mDisplays[i]);
                 mDisplays[i]->handleHotplugEvent(hpdStatus);
                 displayIndex = i;
                 if (mDisplays[i]->mType == HWC_DISPLAY_EXTERNAL) {
@@ -324,6 +368,8 @@ void ExynosDevice::handleHotplug() {
             for (size_t i = 0; i < mDisplays.size(); i++) {
                 if (mDisplays[i]->mType == HWC_DISPLAY_VIRTUAL && mDisplays[i]->mUseDpu) {
                     Mutex::Autolock lock(mMutex);
+                    LayerLocks layerLocks(*this);
+                    layerLocks.lock(mDisplays[i]);
                     ExynosVirtualDisplay *virtualDisplay = (ExynosVirtualDisplay *)mDisplays[i];
                     virtualDisplay->setExternalPlugState(hpdStatus, mGeometryChanged);
                     if (hpdStatus && virtualDisplay->mPlugState)
@@ -429,6 +475,9 @@ void ExynosDevice::initDeviceInterface(uint32_t interfaceType) {
 }
 
 ExynosDevice::~ExynosDevice() {
+    if (mDeferredInitThread.joinable())
+        mDeferredInitThread.join();
+
     ExynosDisplay *primary_display = getDisplay(getDisplayId(HWC_DISPLAY_PRIMARY, 0));
 
     delete primary_display;
@@ -437,6 +486,11 @@ ExynosDevice::~ExynosDevice() {
     if (mEPICHandle != NULL) {
         dlclose(mEPICHandle);
     }
+
+    if (mStatusPage != NULL)
+        munmap(mStatusPage, sizeof(struct hwc_status_page));
+    if (mStatusPageFd >= 0)
+        close(mStatusPageFd);
 }
 
 bool ExynosDevice::isFirstValidate(ExynosDisplay *display) {
@@ -617,7 +671,13 @@ void ExynosDevice::registerRestrictions() {
          */
         if (mInterfaceType != INTERFACE_TYPE_DRM)
             mResourceManager->updateFeatureTable(restrictions);
-        mResourceManager->makeM2MRestrictions();
+        /*
+         * Opening the Acrylic handles for the m2mMPP restrictions
+         * is deferred to deferredInit() after the first present.
+         * m2mMPPs are disabled until then.
+         */
+        mResourceManager->mM2mRestrictionsReady = false;
+        mDeferredInitPending = true;
     } else {
         mResourceManager->updateRestrictions();
     }
@@ -626,6 +686,7 @@ void ExynosDevice::registerRestrictions() {
      * because it uses feature_table updated by updateFeatureTable
      */
     mResourceManager->updateMPPFeature((ret != NO_ERROR) || (mInterfaceType != INTERFACE_TYPE_DRM));
+    mResourceManager->applyRestrictionBlob();
 
     /* It's implmented in each module */
     mResourceManager->setVirtualOtfMPPsRestrictions();
@@ -638,8 +699,41 @@ void ExynosDevice::registerRestrictions() {
     mCanProcessWCG = mResourceManager->deviceSupportWCG();
 }
 
+void ExynosDevice::deferredInit() {
+    Mutex::Autolock lock(mMutex);
+    ATRACE_CALL();
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    mResourceManager->makeM2MRestrictions();
+    /* Values from Acrylic are overridden by the blob again */
+    mResourceManager->applyRestrictionBlob();
+    /* m2mMPPs are enabled by checkExceptionScenario() of the next frame */
+    mResourceManager->mM2mRestrictionsReady = true;
+
+    addInitPhase("deferred_m2m_restrictions", systemTime(SYSTEM_TIME_MONOTONIC) - start);
+}
+
+void ExynosDevice::addInitPhase(const char *name, nsecs_t duration) {
+    mInitPhases.push_back(std::make_pair(name, duration));
+    ALOGI("init phase %s: %" PRId64 " us", name, ns2us(duration));
+}
+
+void ExynosDevice::dumpInitPhases(String8 &result) {
+    nsecs_t total = 0;
+
+    result.append("Init phases (us)\n");
+    for (auto &phase : mInitPhases) {
+        result.appendFormat("\t%s: %" PRId64 "\n", phase.first, ns2us(phase.second));
+        total += phase.second;
+    }
+    result.appendFormat("\ttotal: %" PRId64 "%s\n", ns2us(total),
+                        mResourceManager->mM2mRestrictionsReady ? "" : " (deferred init pending)");
+}
+
 void ExynosDevice::dump(uint32_t *outSize, char *outBuffer) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lockAll();
 
     if (outSize == NULL) {
         ALOGE("%s:: outSize is null", __func__);
@@ -676,10 +770,21 @@ void ExynosDevice::dump(uint32_t *outSize, char *outBuffer) {
 
     for (size_t i = 0; i < mDisplays.size(); i++) {
         ExynosDisplay *display = mDisplays[i];
-        if (display->mPlugState == true)
+        if (display->mPlugState == true) {
             display->dump(result);
+            if (display->mType == HWC_DISPLAY_VIRTUAL)
+                ((ExynosVirtualDisplay *)display)->dumpWFDLatency(result);
+        }
     }
 
+    ExynosLatencyStats::getInstance().dump(result);
+    ExynosMPPBufferPool::getInstance().dump(result);
+    mResourceManager->dumpM2mCapaShares(result);
+    mResourceManager->dumpMPPUsageStats(result);
+    mResourceManager->dumpDpuBandwidth(result);
+    dumpGeometryStats(result);
+    dumpInitPhases(result);
+
     if (outBuffer == NULL) {
         *outSize = (uint32_t)result.length();
     } else {
@@ -708,7 +813,7 @@ uint32_t ExynosDevice::getMaxVirtualDisplayCount() {
 int32_t ExynosDevice::registerCallback(
     int32_t descriptor, hwc2_callback_data_t callbackData,
     hwc2_function_pointer_t point) {
-    if (descriptor < 0 || descriptor > HWC2_CALLBACK_SEAMLESS_POSSIBLE)
+    if (descriptor < 0 || descriptor >= HWC2_CALLBACK_EXYNOS_MAX)
         return HWC2_ERROR_BAD_PARAMETER;
 
     mCallbackInfos[descriptor].callbackData = callbackData;
@@ -748,6 +853,17 @@ void ExynosDevice::invalidate() {
         ALOGE("%s:: refresh callback is not registered", __func__);
 }
 
+void ExynosDevice::notifyPSRExit() {
+    ATRACE_CALL();
+    for (size_t i = 0; i < mDisplays.size(); i++) {
+        ExynosDisplay *display = mDisplays[i];
+        /* mHiberState is updated with mLayerMutex like setLayerBuffer() */
+        Mutex::Autolock lock(display->mLayerMutex);
+        if (display->mPlugState && !display->isFrameSkipPowerState())
+            display->requestHiberExit();
+    }
+}
+
 void ExynosDevice::setHWCDebug(unsigned int debug) {
     Mutex::Autolock lock(mMutex);
     hwcDebug = debug;
@@ -859,6 +975,78 @@ void ExynosDevice::setHWCControl(uint32_t display, uint32_t ctrl, int32_t val) {
         setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
         invalidate();
         break;
+    case HWC_CTL_PARALLEL_VALIDATE:
+        ALOGI("%s::HWC_CTL_PARALLEL_VALIDATE on/off=%d", __func__, val);
+        exynosHWCControl.parallelValidate = (unsigned int)val;
+        break;
+    case HWC_CTL_ATOMIC_PROPERTY_SHADOW:
+        ALOGI("%s::HWC_CTL_ATOMIC_PROPERTY_SHADOW on/off=%d", __func__, val);
+        exynosHWCControl.atomicPropertyShadow = (unsigned int)val;
+        break;
+    case HWC_CTL_M2M_PIPELINE:
+        ALOGI("%s::HWC_CTL_M2M_PIPELINE on/off=%d", __func__, val);
+        exynosHWCControl.m2mPipeline = (unsigned int)val;
+        break;
+    case HWC_CTL_M2M_CAPA_BROKER:
+        ALOGI("%s::HWC_CTL_M2M_CAPA_BROKER on/off=%d", __func__, val);
+        exynosHWCControl.m2mCapaBroker = (unsigned int)val;
+        break;
+    case HWC_CTL_DPU_BW_BUDGET:
+        ALOGI("%s::HWC_CTL_DPU_BW_BUDGET %d MB/s", __func__, val);
+        exynosHWCControl.dpuBandwidthBudget = (val < 0) ? 0 : (uint32_t)val;
+        setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
+        invalidate();
+        break;
+    case HWC_CTL_DPP_POWER_GATING:
+        ALOGI("%s::HWC_CTL_DPP_POWER_GATING on/off=%d", __func__, val);
+        exynosHWCControl.dppPowerGating = (unsigned int)val;
+        setGeometryChanged(GEOMETRY_DEVICE_SCENARIO_CHANGED);
+        break;
+    case HWC_CTL_FB_PRE_IMPORT:
+        ALOGI("%s::HWC_CTL_FB_PRE_IMPORT on/off=%d", __func__, val);
+        exynosHWCControl.fbPreImport = (unsigned int)val;
+        break;
+    case HWC_CTL_VALIDATE_FINGERPRINT:
+        ALOGI("%s::HWC_CTL_VALIDATE_FINGERPRINT on/off=%d", __func__, val);
+        exynosHWCControl.validateFingerprint = (unsigned int)val;
+        break;
+    case HWC_CTL_SPECULATIVE_PREVALIDATE:
+        ALOGI("%s::HWC_CTL_SPECULATIVE_PREVALIDATE on/off=%d", __func__, val);
+        exynosHWCControl.speculativePrevalidate = (unsigned int)val;
+        break;
+    case HWC_CTL_ADAPTIVE_DST_BUF:
+        ALOGI("%s::HWC_CTL_ADAPTIVE_DST_BUF on/off=%d", __func__, val);
+        exynosHWCControl.adaptiveDstBuf = (unsigned int)val;
+        break;
+    case HWC_CTL_RECORD_FRAMES:
+        ALOGI("%s::HWC_CTL_RECORD_FRAMES on/off=%d", __func__, val);
+        if (val)
+            ExynosFrameRecorder::getInstance().start();
+        else
+            ExynosFrameRecorder::getInstance().stop();
+        break;
+    case HWC_CTL_MPP_BUFFER_POOL_SIZE:
+        ALOGI("%s::HWC_CTL_MPP_BUFFER_POOL_SIZE size=%dMB", __func__, val);
+        if (val < 0) {
+            ALOGI("%s::invalid value(%d) is passed", __func__, val);
+            break;
+        }
+        ExynosMPPBufferPool::getInstance().setMaxSize((uint64_t)val * 1024 * 1024);
+        break;
+    case HWC_CTL_PPC_MODEL:
+        ALOGI("%s::HWC_CTL_PPC_MODEL model=%d", __func__, val);
+        if ((val < PPC_MODEL_TABLE) || (val >= PPC_MODEL_MAX)) {
+            ALOGI("%s::invalid value(%d) is passed", __func__, val);
+            break;
+        }
+        exynosHWCControl.ppcModel = (unsigned int)val;
+        setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
+        invalidate();
+        break;
+    case HWC_CTL_RESET_LATENCY_STATS:
+        ALOGI("%s::HWC_CTL_RESET_LATENCY_STATS", __func__);
+        ExynosLatencyStats::getInstance().reset();
+        break;
     case HWC_CTL_DUMP_MID_BUF:
         ALOGI("%s::HWC_CTL_DUMP_MID_BUF on/off=%d", __func__, val);
         exynosHWCControl.dumpMidBuf = (unsigned int)val;
@@ -874,6 +1062,15 @@ void ExynosDevice::setHWCControl(uint32_t display, uint32_t ctrl, int32_t val) {
     case HWC_CTL_ENABLE_EXYNOSCOMPOSITION_OPT:
     case HWC_CTL_USE_MAX_G2D_SRC:
     case HWC_CTL_ENABLE_EARLY_START_MPP:
+    case HWC_CTL_INCREMENTAL_ASSIGN:
+    case HWC_CTL_STATIC_LAYER_CACHE:
+    case HWC_CTL_PREDICTIVE_PRESENT:
+    case HWC_CTL_ASSIGN_SOLVER:
+    case HWC_CTL_ASSIGN_DEADLINE:
+    case HWC_CTL_UPDATE_RATE_PRIORITY:
+    case HWC_CTL_PIPELINED_COMMIT:
+    case HWC_CTL_FOLD_DIM_LAYER:
+    case HWC_CTL_FRAME_CRC:
         exynosDisplay = (ExynosDisplay *)getDisplay(display);
         if (exynosDisplay == NULL) {
             for (uint32_t i = 0; i < mDisplays.size(); i++) {
@@ -1019,12 +1216,67 @@ void ExynosDevice::getCapabilities(uint32_t *outCount, int32_t *outCapabilities)
 }
 
 void ExynosDevice::clearGeometryChanged() {
+    countFilteredGeometryChanged();
     mGeometryChanged = 0;
     for (auto display : mDisplays) {
         display->clearGeometryChanged();
     }
 }
 
+bool ExynosDevice::hasLayerGeometryChanged(uint64_t changedBit) {
+    for (auto display : mDisplays) {
+        for (auto layer : display->mLayers) {
+            if (layer->mGeometryChanged & changedBit)
+                return true;
+        }
+    }
+    return false;
+}
+
+void ExynosDevice::countGeometryChanged() {
+    mGeometryStats.assignedFrames++;
+    for (uint32_t bit = 0; bit < GEOMETRY_STATS_BIT_NUM; bit++) {
+        if (mGeometryChanged & (1ULL << bit))
+            mGeometryStats.assigned[bit]++;
+    }
+}
+
+void ExynosDevice::countFilteredGeometryChanged() {
+    uint64_t filtered = 0;
+
+    for (auto display : mDisplays) {
+        for (auto layer : display->mLayers)
+            filtered |= layer->mFilteredGeometryChanged;
+    }
+    /* Only the changes that did not come with the same change of another layer */
+    filtered &= ~mGeometryChanged;
+
+    for (uint32_t bit = 0; bit < GEOMETRY_STATS_BIT_NUM; bit++) {
+        if (filtered & (1ULL << bit))
+            mGeometryStats.filtered[bit]++;
+    }
+}
+
+void ExynosDevice::dumpGeometryStats(String8 &result) {
+    std::vector<uint32_t> bits;
+
+    for (uint32_t bit = 0; bit < GEOMETRY_STATS_BIT_NUM; bit++) {
+        if (mGeometryStats.assigned[bit] || mGeometryStats.filtered[bit])
+            bits.push_back(bit);
+    }
+    std::stable_sort(bits.begin(), bits.end(), [this](uint32_t l, uint32_t r) {
+        return mGeometryStats.assigned[l] > mGeometryStats.assigned[r];
+    });
+
+    result.appendFormat("Geometry changes (%" PRIu64 " frames with resource assignment)\n",
+                        mGeometryStats.assignedFrames);
+    result.append("\tbit |      geometry      |  assigned  |  filtered\n");
+    for (auto bit : bits)
+        result.appendFormat("\t%3u | 0x%016" PRIx64 " | %10" PRIu64 " | %10" PRIu64 "\n",
+                            bit, (uint64_t)1 << bit, mGeometryStats.assigned[bit],
+                            mGeometryStats.filtered[bit]);
+}
+
 void ExynosDevice::setGeometryFlagForNextFrame() {
     for (uint32_t i = 0; i < mDisplays.size(); i++) {
         if ((mDisplays[i]->mType != HWC_DISPLAY_VIRTUAL) &&
@@ -1065,6 +1317,21 @@ void ExynosDevice::setGeometryFlagForNextFrame() {
     }
 }
 
+bool ExynosDevice::isLayerStateValidated() {
+    if ((exynosHWCControl.validateFingerprint == false) ||
+        (mGeometryChanged == 0) ||
+        (mGeometryChanged & ~GEOMETRY_LAYER_FINGERPRINT_MASK))
+        return false;
+
+    for (auto display : mDisplays) {
+        if (display->mPlugState && !display->isValidateFingerprintSame())
+            return false;
+    }
+    HDEBUGLOGD(eDebugSkipValidate, "layer state is same with validated state, "
+                                   "mGeometryChanged(0x%" PRIx64 ")", mGeometryChanged);
+    return true;
+}
+
 bool ExynosDevice::canSkipValidate() {
     /*
      * This should be called by presentDisplay()
@@ -1073,7 +1340,7 @@ bool ExynosDevice::canSkipValidate() {
 
     int ret = 0;
     if ((exynosHWCControl.skipValidate == false) ||
-        (mGeometryChanged != 0)) {
+        ((mGeometryChanged != 0) && !isLayerStateValidated())) {
         HDEBUGLOGD(eDebugSkipValidate,
                    "skipValidate(%d), mGeometryChanged(0x%" PRIx64 ")",
                    exynosHWCControl.skipValidate, mGeometryChanged);
@@ -1111,7 +1378,7 @@ bool ExynosDevice::canSkipValidate() {
         }
     }
 
-    if (mGeometryChanged != 0) {
+    if ((mGeometryChanged != 0) && !isLayerStateValidated()) {
         HDEBUGLOGD(eDebugSkipValidate, "mGeometryChanged(0x%" PRIx64 ") is changed",
                    mGeometryChanged);
         /* validateDisplay() should be called */
@@ -1202,10 +1469,41 @@ bool ExynosDevice::wasRenderingStateFlagsCleared() {
     return true;
 }
 
+void ExynosDevice::applyPendingRenderingStateClear() {
+    if (mRenderingStateClearPending.exchange(false))
+        clearRenderingStateFlags();
+}
+
+ExynosDevice::LayerLocks::~LayerLocks() {
+    for (auto it = mLocked.rbegin(); it != mLocked.rend(); ++it)
+        (*it)->mLayerMutex.unlock();
+}
+
+void ExynosDevice::LayerLocks::lock(ExynosDisplay *display) {
+    if (std::find(mLocked.begin(), mLocked.end(), display) != mLocked.end())
+        return;
+
+    display->mLayerMutex.lock();
+    mLocked.push_back(display);
+
+    mDevice.mGeometryChanged |= display->mPendingGeometryChanged;
+    display->mPendingGeometryChanged = 0;
+}
+
+void ExynosDevice::LayerLocks::lockAll() {
+    for (auto display : mDevice.mDisplays)
+        lock(display);
+}
+
 int32_t ExynosDevice::validateDisplay(
     ExynosDisplay *display,
     uint32_t *outNumTypes, uint32_t *outNumRequests) {
     Mutex::Autolock lock(mMutex);
+    /* The first validate validates all of displays */
+    LayerLocks layerLocks(*this);
+    layerLocks.lockAll();
+    applyPendingRenderingStateClear();
+    ExynosLatencyStats::Scope latencyScope(display->mDisplayId, LATENCY_STAGE_VALIDATE);
 
     gettimeofday(&updateTimeInfo.lastValidateTime, NULL);
     if (outNumTypes == nullptr || outNumRequests == nullptr)
@@ -1302,6 +1600,119 @@ int32_t ExynosDevice::getDevicePresentInfo(DevicePresentInfo &info) {
     return NO_ERROR;
 }
 
+/*
+ * Pre-processing and restriction checks of each display only touch
+ * the display and its layers, so they are run on the worker pool.
+ * MPP capacity accounting and resource assignment are done serially
+ * in validateAllDisplays() with the same display order.
+ */
+void ExynosDevice::preProcessValidateInParallel(std::vector<ExynosDisplay *> &displays) {
+    ATRACE_CALL();
+    if (mValidateWorkers == nullptr)
+        mValidateWorkers = std::make_unique<ExynosWorkerPool>("hwc_validate", VALIDATE_WORKER_NUM);
+
+    /* Each display starts from the device geometry of this frame */
+    std::vector<uint64_t> geometryChanged(displays.size(), mGeometryChanged);
+    for (size_t i = 0; i < displays.size(); i++) {
+        mValidateWorkers->submit([this, &displays, &geometryChanged, i]() {
+            ExynosDisplay *display = displays[i];
+            display->preProcessValidate(mDeviceValidateInfo, geometryChanged[i]);
+            /* HDR10+ layers can be changed to HDR10 by the shared MPP accounting */
+            if (!display->mHasHdr10PlusLayer)
+                mResourceManager->preUpdateSupportedMPPFlag(display);
+        });
+    }
+    mValidateWorkers->wait();
+
+    for (auto geometry : geometryChanged)
+        setGeometryChanged(geometry);
+}
+
+/*
+ * Finds the displays that show the layers of the primary display up to
+ * scale. The composition of such a display is still done by itself; the
+ * mirror state tells how often the composition of the primary display
+ * could be reused for it.
+ */
+void ExynosDevice::updateMirroredDisplays(const std::vector<ExynosDisplay *> &displays) {
+    ExynosDisplay *primaryDisplay = getDisplay(getDisplayId(HWC_DISPLAY_PRIMARY, 0));
+    bool primaryValidated = (primaryDisplay != nullptr) &&
+        (std::find(displays.begin(), displays.end(), primaryDisplay) != displays.end());
+
+    for (auto display : displays) {
+        if (display == primaryDisplay)
+            continue;
+
+        ExynosDisplay *mirrorSource =
+            (primaryValidated && display->isMirrorOf(*primaryDisplay)) ? primaryDisplay : nullptr;
+        if (mirrorSource != display->mMirrorSource)
+            HDEBUGLOGD(eDebugResourceManager, "%s:: %s mirrors primary(%d)", __func__,
+                       display->mDisplayName.string(), mirrorSource != nullptr);
+        display->mMirrorSource = mirrorSource;
+        if (mirrorSource != nullptr)
+            display->mMirroredFrameCnt++;
+    }
+}
+
+/*
+ * Records the input and the result of the resource assignment of @display
+ * to replay the frame offline. Called after postProcessValidate() so the
+ * composition types and the MPPs are the final ones of this frame.
+ */
+void ExynosDevice::prevalidateDisplay(ExynosDisplay *display) {
+    if (!exynosHWCControl.speculativePrevalidate || (display == nullptr))
+        return;
+
+    std::call_once(mPrevalidateWorkerOnce, [this]() {
+        mPrevalidateWorker = std::make_unique<ExynosWorkerPool>("hwc_prevalidate", 1);
+    });
+
+    mPrevalidateWorker->submit([this, display]() {
+        /* The validation does the checks by itself if it has begun */
+        if (mMutex.tryLock() != NO_ERROR)
+            return;
+        if (display->mLayerMutex.tryLock() != NO_ERROR) {
+            mMutex.unlock();
+            return;
+        }
+
+        ATRACE_NAME("prevalidate");
+        if (display->mPlugState && !display->isFrameSkipPowerState())
+            mResourceManager->prefetchSupportedMPPFlag(display);
+
+        display->mLayerMutex.unlock();
+        mMutex.unlock();
+    });
+}
+
+void ExynosDevice::recordValidatedFrame(ExynosDisplay *display, nsecs_t validateTime) {
+    ExynosFrameRecord frame;
+
+    frame.displayId = display->mDisplayInfo.displayIdentifier.id;
+    frame.displayType = display->mType;
+    frame.xres = display->mXres;
+    frame.yres = display->mYres;
+    frame.geometryChanged = mGeometryChanged;
+    frame.validateTime = validateTime;
+    frame.layers.resize(display->mLayers.size());
+
+    for (size_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        ExynosFrameRecordLayer &recordLayer = frame.layers[i];
+
+        recordLayer.requestedType = layer->mSfCompositionType;
+        recordLayer.validatedType = layer->mValidateCompositionType;
+        if (layer->mOtfMPP != NULL)
+            recordLayer.otfMPP = layer->mOtfMPP->mName;
+        if (layer->mM2mMPP != NULL)
+            recordLayer.m2mMPP = layer->mM2mMPP->mName;
+        layer->setSrcExynosImage(&recordLayer.src);
+        layer->setDstExynosImage(&recordLayer.dst);
+    }
+
+    ExynosFrameRecorder::getInstance().record(frame);
+}
+
 int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
                                           uint32_t *outNumTypes, uint32_t *outNumRequests) {
     int32_t ret = HWC2_ERROR_NONE;
@@ -1359,15 +1770,34 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
     mResourceManager->applyEnableMPPRequests();
 
     /* preprocessing display for validate */
+    std::vector<ExynosDisplay *> validateDisplays;
     for (int32_t i = (mDisplays.size() - 1); i >= 0; i--) {
         if (skip_display(mDisplays[i]))
             continue;
         /* No skips validate and present */
         mDisplays[i]->mNeedSkipValidatePresent = false;
-        mDisplays[i]->preProcessValidate(mDeviceValidateInfo, mGeometryChanged);
-        if ((mDisplays[i]->mType == HWC_DISPLAY_VIRTUAL) &&
-            !(mDisplays[i]->mUseDpu)) {
-            ExynosVirtualDisplay *virtualDisplay = (ExynosVirtualDisplay *)mDisplays[i];
+        validateDisplays.push_back(mDisplays[i]);
+    }
+
+    if (exynosHWCControl.parallelValidate && (validateDisplays.size() > 1)) {
+        preProcessValidateInParallel(validateDisplays);
+    } else {
+        for (auto display : validateDisplays)
+            display->preProcessValidate(mDeviceValidateInfo, mGeometryChanged);
+    }
+
+    if (validateDisplays.size() > 1)
+        updateMirroredDisplays(validateDisplays);
+
+    /* The z order change is raised by the setters and may be dropped by the displays */
+    if ((mGeometryChanged & GEOMETRY_LAYER_ZORDER_CHANGED) &&
+        !hasLayerGeometryChanged(GEOMETRY_LAYER_ZORDER_CHANGED))
+        mGeometryChanged &= ~GEOMETRY_LAYER_ZORDER_CHANGED;
+
+    for (auto display : validateDisplays) {
+        if ((display->mType == HWC_DISPLAY_VIRTUAL) &&
+            !(display->mUseDpu)) {
+            ExynosVirtualDisplay *virtualDisplay = (ExynosVirtualDisplay *)display;
             if (virtualDisplay->mNeedReloadResourceForHWFC) {
                 mResourceManager->reloadResourceForHWFC();
                 mResourceManager->setTargetDisplayLuminance(
@@ -1396,6 +1826,7 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
                "%s:: mGeometryChanged(0x%" PRIx64 ")", __func__, mGeometryChanged);
 
     if (mGeometryChanged) {
+        countGeometryChanged();
         if ((ret = mResourceManager->prepareResources()) != NO_ERROR) {
             HWC_LOGE_NODISP("%s:: prepareResources() error (%d)",
                             __func__, ret);
@@ -1403,11 +1834,11 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
         }
     }
 
-    for (int32_t i = (mDisplays.size() - 1); i >= 0; i--) {
-        ExynosDisplay *display = mDisplays[i];
-        if (skip_display(display))
-            continue;
+    for (auto display : validateDisplays) {
         int32_t displayRet = NO_ERROR;
+        nsecs_t validateStart = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        HWC_TRACE_BEGIN("validate", "display", display->mDisplayId);
 
         if (display->mLayers.size() == 0)
             ALOGI("%s:: %s validateDisplay layer size is 0",
@@ -1430,6 +1861,8 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
             }
         }
 
+        display->mSupportedMPPFlagUpdated = false;
+
         /*
          * HWC should update performanceInfo even if assignResource is skipped
          * HWC excludes the layer from performance calculation
@@ -1464,6 +1897,15 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
             mResourceManager->assignWindow(display);
         }
 
+        display->updateClientCompositionReasons();
+        display->updateValidateFingerprint(displayRet == NO_ERROR);
+        HWC_TRACE_END_DISPLAY(display);
+
+        nsecs_t validateTime = systemTime(SYSTEM_TIME_MONOTONIC) - validateStart;
+        mDeadlineBoost.frameTime += validateTime;
+        if (ExynosFrameRecorder::getInstance().isRecording())
+            recordValidatedFrame(display, validateTime);
+
         if (display == firstDisplay) {
             /* Update ret only if display is the first display */
             ret = display->setValidateState(*outNumTypes, *outNumRequests,
@@ -1488,11 +1930,30 @@ int32_t ExynosDevice::presentDisplay(ExynosDisplay *display,
                                      int32_t *outPresentFence) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
+    nsecs_t presentStart = systemTime(SYSTEM_TIME_MONOTONIC);
 
     if (display == NULL || display == nullptr) {
         ALOGE("%s: There is no display", __func__);
         return HWC2_ERROR_BAD_DISPLAY;
     }
+    /*
+     * Only the layers of this display are locked while it is presented.
+     * The others are locked when the skip of validate checks them or
+     * when the last present finishes the frame.
+     */
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
+    applyPendingRenderingStateClear();
+    HWC_TRACE_EVENT("present", "display", display->mDisplayId,
+                    "layers", static_cast<uint64_t>(display->mLayers.size()));
+
+    /* The deferred init waits for mMutex until this present returns */
+    funcReturnCallback deferredInitCallback([&]() {
+        if (mDeferredInitPending && (display->mType == HWC_DISPLAY_PRIMARY)) {
+            mDeferredInitPending = false;
+            mDeferredInitThread = std::thread(&ExynosDevice::deferredInit, this);
+        }
+    });
 
     funcReturnCallback retCallback([&]() {
         display->mHWCRenderingState = RENDERING_STATE_PRESENTED;
@@ -1516,7 +1977,12 @@ int32_t ExynosDevice::presentDisplay(ExynosDisplay *display,
             ret = HWC_HAL_ERROR_INVAL;
         }
 
+        nsecs_t presentTime = systemTime(SYSTEM_TIME_MONOTONIC) - presentStart;
+        updateStatusPage(display, mDeadlineBoost.frameTime + presentTime);
+        updateDeadlineBoost(display, presentTime);
+
         if (isLastPresent(display)) {
+            layerLocks.lockAll();
             finishFrame();
         }
         return ret;
@@ -1587,6 +2053,7 @@ int32_t ExynosDevice::presentDisplay(ExynosDisplay *display,
                                    __func__, display->mDisplayName.string(), display->mRenderingState);
             return handleErr();
         }
+        layerLocks.lockAll();
         if (canSkipValidate() == false) {
             HDEBUGLOGD(eDebugSkipValidate, "%s display need validate",
                        display->mDisplayName.string());
@@ -1635,11 +2102,6 @@ int32_t ExynosDevice::presentDisplay(ExynosDisplay *display,
             }
         }
     }
-#ifdef USES_HWC_CPU_PERF_MODE
-    if (isLastPresent(display))
-        acquireCPUPerfPerCluster(round((double)1000000000 / (display->mVsyncPeriod)));
-#endif
-
     display->clearWinConfigData();
 #ifdef USE_DQE_INTERFACE
     if (display->needDqeSetting() &&
@@ -1656,6 +2118,8 @@ int32_t ExynosDevice::presentDisplay(ExynosDisplay *display,
                                display->mDisplayName.string(), ret);
         return handleErr();
     }
+    /* After the task profile of the thread is set by the first present */
+    applyPresentThreadPolicy();
     ret = presentPostProcessing();
     return ret;
 }
@@ -1767,19 +2231,15 @@ void ExynosDevice::performanceAssuranceInternal() {
         ALOGI("Use default fps instead of %d for setting performance", fps);
         fps = kDefaultDispFps;
     }
-    /* Affinity settings */
-    cpu_set_t mask;
-    CPU_ZERO(&mask);  // Clear mask
-    ALOGI("Set Affinity config for fps(%d) : cpuIDs : %d", fps, perfTable[fps].cpuIDs);
-    for (int cpu_no = 0; cpu_no < 32; cpu_no++) {
-        if (perfTable[fps].cpuIDs & (1 << cpu_no)) {
-            CPU_SET(cpu_no, &mask);
-            ALOGI("Set Affinity CPU ID : %d", cpu_no);
-        }
+    /* Affinity and uclamp settings, applied by the next present */
+    if ((mPresentThreadPolicy.cpuIDs != perfTable[fps].cpuIDs) ||
+        (mPresentThreadPolicy.uclampMin != perfTable[fps].uclampMin)) {
+        mPresentThreadPolicy.cpuIDs = perfTable[fps].cpuIDs;
+        mPresentThreadPolicy.uclampMin = perfTable[fps].uclampMin;
+        mPresentThreadPolicy.generation++;
+        ALOGI("Set present thread policy for fps(%d) : cpuIDs(0x%x), uclamp.min(%d)",
+              fps, mPresentThreadPolicy.cpuIDs, mPresentThreadPolicy.uclampMin);
     }
-    sched_setaffinity(getpid(), sizeof(cpu_set_t), &mask);
-
-    ALOGI("Set affinity HWC : %d", getpid());
 
     /* TODO cluster modification in module */
     setCPUClocksPerCluster(fps);
@@ -1790,6 +2250,171 @@ void ExynosDevice::performanceAssuranceInternal() {
     return;
 }
 
+#ifdef USES_HWC_CPU_PERF_MODE
+static int setThreadUclampMin(uint32_t utilMin) {
+    struct sched_attr attr = {};
+
+    attr.size = sizeof(attr);
+    attr.sched_flags = SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP_MIN;
+    attr.sched_util_min = utilMin;
+
+    return syscall(__NR_sched_setattr, 0, &attr, 0);
+}
+#endif
+
+void ExynosDevice::updateDeadlineBoost(ExynosDisplay *display, nsecs_t presentTime) {
+    mDeadlineBoost.frameTime += presentTime;
+    if (!isLastPresent(display))
+        return;
+
+#ifdef USES_HWC_CPU_PERF_MODE
+    DeadlineBoostInfo &boost = mDeadlineBoost;
+    nsecs_t period = display->mVsyncPeriod;
+
+    if ((period > 0) && supportPerformaceAssurance()) {
+        if (boost.frameTime * 100 >= period * DeadlineBoostInfo::kRaiseLoad) {
+            boost.overCnt++;
+            boost.underCnt = 0;
+        } else if (boost.frameTime * 100 < period * DeadlineBoostInfo::kRelaxLoad) {
+            boost.underCnt++;
+            boost.overCnt = 0;
+        }
+
+        if (!boost.boosting && (boost.overCnt >= DeadlineBoostInfo::kRaiseFrames)) {
+            boost.boosting = true;
+            HDEBUGLOGD(eDebugDefault, "%s:: raise, frame time %" PRId64 " of %" PRId64,
+                       __func__, boost.frameTime, period);
+        } else if (boost.boosting && (boost.underCnt >= DeadlineBoostInfo::kRelaxFrames)) {
+            boost.boosting = false;
+            HDEBUGLOGD(eDebugDefault, "%s:: relax, frame time %" PRId64 " of %" PRId64,
+                       __func__, boost.frameTime, period);
+        }
+
+        /* Every request keeps the clocks for the next frame */
+        if (boost.boosting)
+            acquireCPUPerfPerCluster(round((double)1000000000 / period));
+    }
+#endif
+
+    mDeadlineBoost.frameTime = 0;
+}
+
+static_assert(CLIENT_REASON_MAX <= HWC_STATUS_CLIENT_REASON_MAX, "client reasons of status page");
+static_assert(MPP_REJECT_TYPE_NUM <= HWC_STATUS_REJECT_MAX, "rejections of status page");
+static_assert(LATENCY_STAGE_MAX <= HWC_STATUS_LATENCY_STAGE_MAX, "latency stages of status page");
+static_assert(kLatencyBucketBounds.size() <= HWC_STATUS_LATENCY_BUCKET_MAX,
+              "latency buckets of status page");
+
+static void updateStatusMPP(hwc_status_mpp &status, ExynosMPP *mpp) {
+    strlcpy(status.name, mpp->mName.string(), sizeof(status.name));
+    status.physical_type = mpp->mPhysicalType;
+    status.logical_type = mpp->mLogicalType;
+    status.assigned_state = mpp->mAssignedState;
+    status.assigned_display = mpp->mAssignedDisplayInfo.displayIdentifier.id;
+    status.assigned_frames = mpp->mUsageStats.assignedFrames;
+    status.assigned_layers = mpp->mUsageStats.assignedLayers;
+    status.processed_pixels = mpp->mUsageStats.processedPixels;
+    for (uint32_t i = 0; i < MPP_REJECT_TYPE_NUM; i++)
+        status.rejects[i] = mpp->mRejectCount[i].load(std::memory_order_relaxed);
+}
+
+void ExynosDevice::updateStatusPage(ExynosDisplay *display, nsecs_t frameTime) {
+    if (mStatusPage == NULL)
+        return;
+
+    hwc_status_data &data = mStatusPage->data;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    /* The histograms and the MPPs are updated once a frame */
+    bool lastPresent = isLastPresent(display);
+
+    hwc_status_page_write_begin(mStatusPage);
+
+    data.update_ns = now;
+    if (lastPresent) {
+        data.frames = ++mStatusFrames;
+        data.frame_time_ns = frameTime;
+    }
+
+    data.display_num = std::min((uint32_t)mDisplays.size(), (uint32_t)HWC_STATUS_DISPLAY_MAX);
+    for (uint32_t i = 0; i < data.display_num; i++) {
+        ExynosDisplay *d = mDisplays[i];
+        hwc_status_display &status = data.displays[i];
+
+        status.id = d->mDisplayId;
+        status.type = d->mType;
+        status.power_mode = d->mPowerModeState;
+        status.vsync_period = d->mVsyncPeriod;
+        status.validated_frames = d->mValidatedFrameCnt;
+        status.client_frames = d->mClientCompositionFrameCnt;
+        std::copy(d->mClientReasonCount.begin(), d->mClientReasonCount.end(),
+                  status.client_reasons);
+        if (d == display) {
+            status.presented_frames++;
+            status.last_present_ns = now;
+        }
+
+        if (!lastPresent)
+            continue;
+
+        for (uint32_t stage = 0; stage < LATENCY_STAGE_MAX; stage++) {
+            std::array<uint32_t, kLatencyBucketBounds.size()> buckets;
+            hwc_status_latency &latency = status.latency[stage];
+            if (!ExynosLatencyStats::getInstance().getHistogram(d->mDisplayId,
+                                                                (hwc_latency_stage_t)stage,
+                                                                buckets, latency.count,
+                                                                latency.max_ns)) {
+                latency = {};
+                continue;
+            }
+            std::copy(buckets.begin(), buckets.end(), latency.buckets);
+        }
+    }
+
+    if (lastPresent) {
+        uint32_t mppNum = 0;
+        for (auto mpp : ExynosResourceManager::getOtfMPPs()) {
+            if (mppNum < HWC_STATUS_MPP_MAX)
+                updateStatusMPP(data.mpps[mppNum++], mpp);
+        }
+        for (uint32_t i = 0; i < ExynosResourceManager::getM2mMPPSize(); i++) {
+            if (mppNum < HWC_STATUS_MPP_MAX)
+                updateStatusMPP(data.mpps[mppNum++], mResourceManager->getM2mMPP(i));
+        }
+        data.mpp_num = mppNum;
+    }
+
+    hwc_status_page_write_end(mStatusPage);
+}
+
+void ExynosDevice::applyPresentThreadPolicy() {
+#ifdef USES_HWC_CPU_PERF_MODE
+    thread_local uint32_t appliedGeneration = 0;
+
+    if (appliedGeneration == mPresentThreadPolicy.generation)
+        return;
+    appliedGeneration = mPresentThreadPolicy.generation;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu_no = 0; cpu_no < 32; cpu_no++) {
+        if (mPresentThreadPolicy.cpuIDs & (1 << cpu_no))
+            CPU_SET(cpu_no, &mask);
+    }
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &mask) < 0)
+        ALOGW("Failed to set affinity(0x%x) of %d: %s",
+              mPresentThreadPolicy.cpuIDs, gettid(), strerror(errno));
+
+    /* 0 leaves uclamp.min of the thread to its task profile */
+    if ((mPresentThreadPolicy.uclampMin != 0) &&
+        (setThreadUclampMin(mPresentThreadPolicy.uclampMin) < 0))
+        ALOGW("Failed to set uclamp.min(%d) of %d: %s",
+              mPresentThreadPolicy.uclampMin, gettid(), strerror(errno));
+
+    HDEBUGLOGD(eDebugDefault, "Present thread %d : cpuIDs(0x%x), uclamp.min(%d)",
+               gettid(), mPresentThreadPolicy.cpuIDs, mPresentThreadPolicy.uclampMin);
+#endif
+}
+
 bool ExynosDevice::getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *minClock) {
     Mutex::Autolock lock(mMutex);
 
@@ -1978,16 +2603,16 @@ void ExynosDevice::setVsyncMode() {
     }
 }
 
-int32_t ExynosDevice::setLayerBlendMode(ExynosLayer *layer,
+int32_t ExynosDevice::setLayerBlendMode(ExynosDisplay *display, ExynosLayer *layer,
                                         int32_t /*hwc2_blend_mode_t*/ mode) {
-    Mutex::Autolock lock(mMutex);
-    int32_t ret = layer->setLayerBlendMode(mode, mGeometryChanged);
+    Mutex::Autolock lock(display->mLayerMutex);
+    int32_t ret = layer->setLayerBlendMode(mode, display->mPendingGeometryChanged);
     return ret;
 }
 
 int32_t ExynosDevice::setLayerBuffer(ExynosDisplay *display,
                                      hwc2_layer_t layer, buffer_handle_t buffer, int32_t acquireFence) {
-    Mutex::Autolock lock(mMutex);
+    Mutex::Autolock lock(display->mLayerMutex);
 
     if (display->mPlugState == false)
         buffer = NULL;
@@ -1998,61 +2623,88 @@ int32_t ExynosDevice::setLayerBuffer(ExynosDisplay *display,
         return HWC2_ERROR_BAD_LAYER;
 
     int32_t ret = exynosLayer->setLayerBuffer(buffer, acquireFence,
-                                              mGeometryChanged);
+                                              display->mPendingGeometryChanged);
+    if ((ret == HWC2_ERROR_NONE) && exynosHWCControl.fbPreImport)
+        display->preImportLayerBuffer(*exynosLayer);
     return ret;
 }
 
-int32_t ExynosDevice::setLayerCompositionType(ExynosLayer *layer,
+int32_t ExynosDevice::setLayerCompositionType(ExynosDisplay *display, ExynosLayer *layer,
                                               int32_t /*hwc2_composition_t*/ type) {
-    Mutex::Autolock lock(mMutex);
-    int32_t ret = layer->setLayerCompositionType(type, mGeometryChanged);
+    Mutex::Autolock lock(display->mLayerMutex);
+    int32_t ret = layer->setLayerCompositionType(type, display->mPendingGeometryChanged);
     return ret;
 }
 
 int32_t ExynosDevice::setLayerDataspace(ExynosDisplay *display,
                                         hwc2_layer_t layer, int32_t /*android_dataspace_t*/ dataspace) {
-    Mutex::Autolock lock(mMutex);
+    Mutex::Autolock lock(display->mLayerMutex);
 
     ExynosLayer *exynosLayer = display->checkLayer(layer);
     if (exynosLayer == nullptr)
         return HWC2_ERROR_BAD_LAYER;
 
-    int32_t ret = exynosLayer->setLayerDataspace(dataspace, mGeometryChanged);
+    int32_t ret = exynosLayer->setLayerDataspace(dataspace, display->mPendingGeometryChanged);
     return ret;
 }
 
-int32_t ExynosDevice::setLayerDisplayFrame(ExynosLayer *layer, hwc_rect_t frame) {
-    Mutex::Autolock lock(mMutex);
-    clearRenderingStateFlags();
-    int32_t ret = layer->setLayerDisplayFrame(frame, mGeometryChanged);
+int32_t ExynosDevice::setLayerDisplayFrame(ExynosDisplay *display, ExynosLayer *layer,
+                                           hwc_rect_t frame) {
+    Mutex::Autolock lock(display->mLayerMutex);
+    mRenderingStateClearPending = true;
+    int32_t ret = layer->setLayerDisplayFrame(frame, display->mPendingGeometryChanged);
     return ret;
 }
 
-int32_t ExynosDevice::setLayerSourceCrop(ExynosLayer *layer, hwc_frect_t crop) {
-    Mutex::Autolock lock(mMutex);
-    int32_t ret = layer->setLayerSourceCrop(crop, mGeometryChanged);
+int32_t ExynosDevice::setLayerSourceCrop(ExynosDisplay *display, ExynosLayer *layer,
+                                         hwc_frect_t crop) {
+    Mutex::Autolock lock(display->mLayerMutex);
+    int32_t ret = layer->setLayerSourceCrop(crop, display->mPendingGeometryChanged);
     return ret;
 }
 
-int32_t ExynosDevice::setLayerTransform(ExynosLayer *layer, int32_t /*hwc_transform_t*/ transform) {
-    Mutex::Autolock lock(mMutex);
-    int32_t ret = layer->setLayerTransform(transform, mGeometryChanged);
+int32_t ExynosDevice::setLayerTransform(ExynosDisplay *display, ExynosLayer *layer,
+                                        int32_t /*hwc_transform_t*/ transform) {
+    Mutex::Autolock lock(display->mLayerMutex);
+    int32_t ret = layer->setLayerTransform(transform, display->mPendingGeometryChanged);
     return ret;
 }
 
-int32_t ExynosDevice::setLayerZOrder(ExynosLayer *layer, uint32_t z) {
-    Mutex::Autolock lock(mMutex);
-    int32_t ret = layer->setLayerZOrder(z, mGeometryChanged);
+int32_t ExynosDevice::setLayerZOrder(ExynosDisplay *display, ExynosLayer *layer, uint32_t z) {
+    Mutex::Autolock lock(display->mLayerMutex);
+    int32_t ret = layer->setLayerZOrder(z, display->mPendingGeometryChanged);
+    return ret;
+}
+
+int32_t ExynosDevice::setLayerState(ExynosDisplay *display, ExynosLayer *layer,
+                                    exynos_layer_state_t &state) {
+    Mutex::Autolock lock(display->mLayerMutex);
+
+    if (state.buffer) {
+        if (display->mPlugState == false)
+            state.buffer = NULL;
+        display->requestHiberExit();
+    }
+    if (state.displayFrame)
+        mRenderingStateClearPending = true;
+
+    int32_t ret = layer->setLayerState(state, display->mPendingGeometryChanged);
+    if (state.buffer && exynosHWCControl.fbPreImport)
+        display->preImportLayerBuffer(*layer);
     return ret;
 }
 
 int32_t ExynosDevice::setColorMode(ExynosDisplay *display, int32_t mode) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->setColorMode(mode, mCanProcessWCG, mGeometryChanged);
 }
 
 int32_t ExynosDevice::setColorModeWithRenderIntent(ExynosDisplay *display, int32_t mode, int32_t intent) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->setColorModeWithRenderIntent(mode, intent, mCanProcessWCG,
                                                  mGeometryChanged);
 }
@@ -2066,6 +2718,10 @@ int32_t ExynosDevice::setPowerMode(ExynosDisplay *display, int32_t /*hwc2_power_
 
     if (!display)
         return HWC2_ERROR_BAD_DISPLAY;
+    /* The last present of the frame can be finished here */
+    LayerLocks layerLocks(*this);
+    layerLocks.lockAll();
+    applyPendingRenderingStateClear();
     if (mode == HWC_POWER_MODE_OFF) {
         /*
          * present will be skipped when display is power off
@@ -2083,11 +2739,15 @@ int32_t ExynosDevice::setPowerMode(ExynosDisplay *display, int32_t /*hwc2_power_
 
 int32_t ExynosDevice::createLayer(ExynosDisplay *display, hwc2_layer_t *outLayer) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->createLayer(outLayer, mGeometryChanged);
 }
 
 int32_t ExynosDevice::destroyLayer(ExynosDisplay *display, hwc2_layer_t layer) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     if (display->checkLayer(layer) == nullptr)
         return HWC2_ERROR_BAD_LAYER;
 
@@ -2097,18 +2757,24 @@ int32_t ExynosDevice::destroyLayer(ExynosDisplay *display, hwc2_layer_t layer) {
 int32_t ExynosDevice::setColorTransform(ExynosDisplay *display,
                                         const float *matrix, int32_t /*android_color_transform_t*/ hint) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->setColorTransform(matrix, hint, mGeometryChanged);
 }
 
 int32_t ExynosDevice::setClientTarget(ExynosDisplay *display,
                                       buffer_handle_t target, int32_t acquireFence, int32_t dataspace) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->setClientTarget(target, acquireFence, dataspace,
                                     mGeometryChanged);
 }
 
 int32_t ExynosDevice::setActiveConfig(ExynosDisplay *display, hwc2_config_t config) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->setActiveConfig(config);
 }
 
@@ -2117,6 +2783,8 @@ int32_t ExynosDevice::setActiveConfigWithConstraints(ExynosDisplay *display,
                                                      hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
                                                      hwc_vsync_period_change_timeline_t *outTimeline) {
     Mutex::Autolock lock(mMutex);
+    LayerLocks layerLocks(*this);
+    layerLocks.lock(display);
     return display->setActiveConfigWithConstraints(config, vsyncPeriodChangeConstraints,
                                                    outTimeline);
 }
@@ -34,6 +34,8 @@
 
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
 
@@ -46,6 +48,7 @@
 #include "ExynosHWCTypes.h"
 #include "ExynosFenceTracer.h"
 #include "OneShotTimer.h"
+#include "ExynosWorkerPool.h"
 
 #define MAX_DEV_NAME 128
 #define ERROR_LOG_PATH0 "/data/vendor/log/hwc"
@@ -65,6 +68,12 @@
 #define MAX_SUPPORTED_FPS 120
 #endif
 
+#ifndef VALIDATE_WORKER_NUM
+#define VALIDATE_WORKER_NUM 2
+#endif
+
+#define GEOMETRY_STATS_BIT_NUM 64
+
 #ifdef USE_DQE_INTERFACE
 #include <hardware/exynos/dqeInterface.h>
 #ifndef DEFAULT_DQE_INTERFACE_XML
@@ -72,6 +81,8 @@
 #endif
 #endif
 
+struct hwc_status_page;
+
 typedef long epic_handle;
 
 #ifndef DRM_DEVICE_PATH
@@ -128,7 +139,7 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
          */
 
     /** TODO : Array size shuld be checked */
-    exynos_callback_info_t mCallbackInfos[HWC2_CALLBACK_SEAMLESS_POSSIBLE + 1];
+    exynos_callback_info_t mCallbackInfos[HWC2_CALLBACK_EXYNOS_MAX];
 
     /**
          * mDisplayId of display that has the slowest fps.
@@ -234,11 +245,35 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     void clearGeometryChanged();
     void setGeometryFlagForNextFrame();
     bool canSkipValidate();
+    /*
+     * Only layer geometry is changed and layer state of every display is
+     * same with last validated one
+     */
+    bool isLayerStateValidated();
     bool compareVsyncPeriod();
     void setDumpCount();
     void clearRenderingStateFlags();
     bool wasRenderingStateFlagsCleared();
 
+    /*
+     * Layer locks of the displays taken by a path holding mMutex. The path
+     * takes the locks of the displays whose layers it touches and only the
+     * holders of mMutex take more than one layer lock, so the order among
+     * the layer locks is free. Taking a lock moves the geometry changes
+     * that the layer setters queued for the display to mGeometryChanged.
+     */
+    class LayerLocks {
+      public:
+        explicit LayerLocks(ExynosDevice &device) : mDevice(device){};
+        ~LayerLocks();
+        void lock(ExynosDisplay *display);
+        void lockAll();
+
+      private:
+        ExynosDevice &mDevice;
+        std::vector<ExynosDisplay *> mLocked;
+    };
+
     virtual bool getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *minClock);
 
     /* Add EPIC APIs */
@@ -256,6 +291,18 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     bool handleVsyncPeriodChangeInternal();
     virtual bool supportPerformaceAssurance() { return false; };
     virtual void performanceAssuranceInternal(); // REQUIRES(mMutex)
+    /*
+     * CPU policy of the thread presenting the frames. It is set by
+     * performanceAssuranceInternal() and applied by the presenting thread
+     * itself because a sched_setaffinity() of the process pins only its
+     * main thread. A new policy has a new generation.
+     */
+    struct PresentThreadPolicy {
+        uint32_t cpuIDs = 0;
+        uint32_t uclampMin = 0;
+        uint32_t generation = 0;
+    } mPresentThreadPolicy;  // GUARDED_BY(mMutex)
+    void applyPresentThreadPolicy(); // REQUIRES(mMutex)
     /*
      * This function checks mActiveConfig of each display
      * in order to get fps for performance.
@@ -294,6 +341,10 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     void initDisplays();
     void registerHandlers();
     void registerRestrictions();
+    /* Init work that is not needed for the first frame, run after the first present */
+    void deferredInit();
+    void addInitPhase(const char *name, nsecs_t duration);
+    void dumpInitPhases(String8 &result);
 
     /** APIs for display **/
     virtual int32_t validateDisplay(
@@ -301,6 +352,63 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
         uint32_t *outNumTypes, uint32_t *outNumRequests);
     int32_t validateAllDisplays(ExynosDisplay *firstDisplay,
                                 uint32_t *outNumTypes, uint32_t *outNumRequests);
+    void preProcessValidateInParallel(std::vector<ExynosDisplay *> &displays);
+    void updateMirroredDisplays(const std::vector<ExynosDisplay *> &displays);
+    /*
+     * Starts the layer checks of the validation of @display on a worker
+     * once its layer state of the frame is set. It is a speculation: the
+     * validation does the same checks with the memoized results, and the
+     * worker gives up if the device or the layers are busy.
+     */
+    void prevalidateDisplay(ExynosDisplay *display);
+    void recordValidatedFrame(ExynosDisplay *display, nsecs_t validateTime);
+
+    /*
+     * Geometry change statistics by bit. assigned counts the frames that
+     * ran the resource assignment with the bit, filtered counts the frames
+     * in which a layer change of the bit kept the hardware state and was
+     * not set to mGeometryChanged.
+     */
+    struct GeometryStats {
+        uint64_t assignedFrames = 0;
+        uint64_t assigned[GEOMETRY_STATS_BIT_NUM] = {};
+        uint64_t filtered[GEOMETRY_STATS_BIT_NUM] = {};
+    };
+    bool hasLayerGeometryChanged(uint64_t changedBit);
+    void countGeometryChanged();
+    void countFilteredGeometryChanged();
+    void dumpGeometryStats(String8 &result);
+
+    /*
+     * Deadline driven CPU boosting. The HAL time of a frame is the time of
+     * validate and present of all the displays. The min clocks of perfTable
+     * are requested only while it is close to the vsync period, and the
+     * timer of acquireCPUPerfPerCluster() relaxes them after the last request.
+     */
+    struct DeadlineBoostInfo {
+        /* In percent of the vsync period */
+        static constexpr uint32_t kRaiseLoad = 50;
+        static constexpr uint32_t kRelaxLoad = 25;
+        /* Consecutive frames to raise or to relax */
+        static constexpr uint32_t kRaiseFrames = 2;
+        static constexpr uint32_t kRelaxFrames = 30;
+        nsecs_t frameTime = 0;
+        uint32_t overCnt = 0;
+        uint32_t underCnt = 0;
+        bool boosting = false;
+    } mDeadlineBoost;  // GUARDED_BY(mMutex)
+    void updateDeadlineBoost(ExynosDisplay *display, nsecs_t presentTime); // REQUIRES(mMutex)
+
+    /*
+     * Status page shared with the monitors by ExynosHWCService.
+     * It is rewritten at the end of each frame, see hwc_status_page.h.
+     */
+    struct hwc_status_page *mStatusPage = NULL;
+    int mStatusPageFd = -1;
+    uint64_t mStatusFrames = 0;  // GUARDED_BY(mMutex)
+    void updateStatusPage(ExynosDisplay *display, nsecs_t frameTime); // REQUIRES(mMutex)
+    /* Returns the fd of the page, the caller should not close it */
+    int getStatusPage() { return mStatusPageFd; };
     int32_t getDeviceValidateInfo(DeviceValidateInfo &info);
     int32_t getDeviceResourceInfo(DeviceResourceInfo &info);
 
@@ -309,6 +417,11 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     int32_t finishFrame();
     int32_t getDevicePresentInfo(DevicePresentInfo &info);
     void invalidate();
+    /*
+     * Hint of an input that is likely to update the displays, like a touch.
+     * The displays exit the hibernation before the buffers of the frame come.
+     */
+    void notifyPSRExit();
 
     int32_t setColorMode(ExynosDisplay *display, int32_t mode);
     int32_t setColorModeWithRenderIntent(ExynosDisplay *display,
@@ -329,19 +442,22 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
                                            hwc_vsync_period_change_timeline_t *outTimeline);
 
     /** APIs for layer **/
-    int32_t setLayerBlendMode(ExynosLayer *layer,
+    int32_t setLayerBlendMode(ExynosDisplay *display, ExynosLayer *layer,
                               int32_t /*hwc2_blend_mode_t*/ mode);
     int32_t setLayerBuffer(ExynosDisplay *display, hwc2_layer_t layer,
                            buffer_handle_t buffer, int32_t acquireFence);
-    int32_t setLayerCompositionType(ExynosLayer *layer,
+    int32_t setLayerCompositionType(ExynosDisplay *display, ExynosLayer *layer,
                                     int32_t /*hwc2_composition_t */ type);
     int32_t setLayerDataspace(ExynosDisplay *display, hwc2_layer_t layer,
                               int32_t /*android_dataspace_t*/ dataspace);
-    int32_t setLayerDisplayFrame(ExynosLayer *layer, hwc_rect_t frame);
-    int32_t setLayerSourceCrop(ExynosLayer *layer, hwc_frect_t crop);
-    int32_t setLayerTransform(ExynosLayer *layer,
+    int32_t setLayerDisplayFrame(ExynosDisplay *display, ExynosLayer *layer, hwc_rect_t frame);
+    int32_t setLayerSourceCrop(ExynosDisplay *display, ExynosLayer *layer, hwc_frect_t crop);
+    int32_t setLayerTransform(ExynosDisplay *display, ExynosLayer *layer,
                               int32_t /*hwc_transform_t*/ transform);
-    int32_t setLayerZOrder(ExynosLayer *layer, uint32_t z);
+    int32_t setLayerZOrder(ExynosDisplay *display, ExynosLayer *layer, uint32_t z);
+    /* All of changed layer state is applied with one lock */
+    int32_t setLayerState(ExynosDisplay *display, ExynosLayer *layer,
+                          exynos_layer_state_t &state);
     int32_t printMppsAttr();
     void resetForDestroyClient();
 
@@ -358,6 +474,16 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     Mutex mCaptureMutex;
     Condition mCaptureCondition;
     std::atomic<bool> mIsWaitingReadbackReqDone = false;
+    std::unique_ptr<ExynosWorkerPool> mValidateWorkers;
+    std::once_flag mPrevalidateWorkerOnce;
+    std::unique_ptr<ExynosWorkerPool> mPrevalidateWorker;
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
+    bool mDeferredInitPending = false;  // GUARDED_BY(mMutex)
+    /* Set by the layer setters, the next validate or present clears the rendering state flags */
+    std::atomic<bool> mRenderingStateClearPending = false;
+    void applyPendingRenderingStateClear();  // REQUIRES(mMutex)
+    std::thread mDeferredInitThread;
+    std::vector<std::pair<const char *, nsecs_t>> mInitPhases;  // GUARDED_BY(mMutex)
+    GeometryStats mGeometryStats;  // GUARDED_BY(mMutex)
 };
 #endif  //_EXYNOSDEVICE_H
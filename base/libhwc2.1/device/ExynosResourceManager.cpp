@@ -20,6 +20,8 @@
 
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
 #include <cutils/properties.h>
+#include <algorithm>
+#include <functional>
 #include <unordered_set>
 #include "ExynosResourceManager.h"
 #include "ExynosMPPModule.h"
@@ -30,6 +32,8 @@
 #include "ExynosVirtualDisplay.h"
 #include "ExynosExternalDisplay.h"
 #include "ExynosDeviceInterface.h"
+#include "ExynosLatencyStats.h"
+#include "ExynosPerfettoTrace.h"
 
 #ifndef USE_MODULE_ATTR
 /* Basic supported features */
@@ -128,6 +132,16 @@ ExynosResourceManager::ExynosResourceManager() {
         mOtfMPPs.add(exynosMPP);
         if (exynosMPP->isVirtual8KOtf())
             mVirtualMPPNum++;
+        mOtfLogicalTypes |= exynosMPP->mLogicalType;
+
+        /* The first otfMPP of a channel is the one of the channel */
+        int32_t ch = exynosMPP->mChId;
+        if (ch < 0)
+            continue;
+        if ((size_t)ch >= mOtfMPPsByChannel.size())
+            mOtfMPPsByChannel.resize(ch + 1, nullptr);
+        if (mOtfMPPsByChannel[ch] == nullptr)
+            mOtfMPPsByChannel[ch] = exynosMPP;
     }
 
     num_mpp_units = sizeof(AVAILABLE_M2M_MPP_UNITS) / sizeof(exynos_mpp_t);
@@ -281,6 +295,9 @@ int32_t ExynosResourceManager::doAllocDstBufs(uint32_t Xres, uint32_t Yres) {
  */
 int32_t ExynosResourceManager::assignResource(ExynosDisplay *display) {
     ATRACE_CALL();
+    ExynosLatencyStats::Scope latencyScope(display->mDisplayId, LATENCY_STAGE_ASSIGN_RESOURCE);
+    HWC_TRACE_EVENT("assign", "display", display->mDisplayId,
+                    "layers", static_cast<uint64_t>(display->mLayers.size()));
     int ret = 0;
 
     HDEBUGLOGD(eDebugResourceManager | eDebugSkipResourceAssign,
@@ -307,7 +324,8 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display) {
             mM2mMPPs[i]->mPreAssignedCapacity = 0.0f;
     }
 
-    if ((ret = updateSupportedMPPFlag(display)) != NO_ERROR) {
+    if ((display->mSupportedMPPFlagUpdated == false) &&
+        ((ret = updateSupportedMPPFlag(display)) != NO_ERROR)) {
         HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: updateSupportedMPPFlag() error (%d)",
                  __func__, ret);
         return ret;
@@ -325,6 +343,12 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display) {
         return ret;
     }
 
+    for (uint32_t i = 0; i < display->mLayers.size(); i++)
+        display->mLayers[i]->updatePrevAssignInfo();
+
+    updateM2mCapaShares(display);
+    updateMPPUsageStats(display);
+
     if (hwcCheckDebugMessages(eDebugResourceManager)) {
         HDEBUGLOGD(eDebugResourceManager, "AssignResource result");
         String8 result;
@@ -481,8 +505,31 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display) {
         }
     }
 
+    if (display->mLowPowerComposition && (display->mLayers.size() > 1))
+        return assignLowPowerComposition(display);
+
+    if (display->mDisplayControl.assignSolver)
+        solveOtfAssignment(display);
+
+    /*
+     * If assignment doesn't converge within the time budget,
+     * layers under the top assignDeadlineLayerNum layers are
+     * composited by client so that validate time is bounded.
+     */
+    nsecs_t assignDeadline = systemTime(SYSTEM_TIME_MONOTONIC) +
+                             (nsecs_t)display->mDisplayControl.assignDeadlineUs * 1000;
+    display->mAssignDeadlineExceeded = false;
+
     do {
         HDEBUGLOGD(eDebugResourceAssigning, "%s:: retry_count(%d)", __func__, retry_count);
+        if ((retry_count > 0) && (display->mDisplayControl.assignDeadlineUs > 0) &&
+            (display->mAssignDeadlineExceeded == false) &&
+            (systemTime(SYSTEM_TIME_MONOTONIC) > assignDeadline)) {
+            display->mAssignDeadlineExceeded = true;
+            display->mAssignDeadlineCnt++;
+            HDEBUGLOGD(eDebugResourceManager, "%s:: deadline is exceeded, retry_count(%d), count(%" PRIu64 ")",
+                       __func__, retry_count, display->mAssignDeadlineCnt);
+        }
         if ((ret = resetAssignedResources(display)) != NO_ERROR)
             return ret;
         if ((ret = assignCompositionTarget(display, COMPOSITION_CLIENT)) != NO_ERROR) {
@@ -551,6 +598,8 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display) {
         if (ret == NO_ERROR) {
             ret = setResourcePriority(display);
         }
+        if (ret == NO_ERROR)
+            ret = checkDpuBandwidth(display);
         retry_count++;
     } while ((ret == EXYNOS_ERROR_CHANGED) && (retry_count < ASSIGN_RESOURCE_TRY_COUNT));
 
@@ -578,6 +627,41 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display) {
     return ret;
 }
 
+/*
+ * All layers of a dozing display are composited by client into one window.
+ * The few layers of the doze UI are updated rarely, so the client target is
+ * mostly reused by skipStaticLayers() and the search of the MPPs is skipped.
+ */
+int32_t ExynosResourceManager::assignLowPowerComposition(ExynosDisplay *display) {
+    int ret = NO_ERROR;
+
+    if ((ret = resetAssignedResources(display)) != NO_ERROR)
+        return ret;
+
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if (layer->mValidateCompositionType == HWC2_COMPOSITION_CLIENT)
+            continue;
+        layer->mOverlayInfo |= eLowPowerComposition;
+        layer->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
+        if (((ret = display->addClientCompositionLayer(i)) != NO_ERROR) &&
+            (ret != EXYNOS_ERROR_CHANGED)) {
+            HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: addClientCompositionLayer failed (%d)",
+                     __func__, ret);
+            return ret;
+        }
+    }
+
+    if ((ret = assignCompositionTarget(display, COMPOSITION_CLIENT)) != NO_ERROR) {
+        HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: Fail to assign resource for compositionTarget",
+                 __func__);
+        return ret;
+    }
+    display->mLowPowerFrameCnt++;
+
+    return NO_ERROR;
+}
+
 int32_t ExynosResourceManager::updateExynosComposition(ExynosDisplay *display) {
     int ret = NO_ERROR;
     /* Use Exynos composition as many as possible */
@@ -622,7 +706,8 @@ int32_t ExynosResourceManager::updateExynosComposition(ExynosDisplay *display) {
                             return ret;
                         }
                         layer->setExynosMidImage(dst_img);
-                        float totalUsedCapacity = getResourceUsedCapa(*m2mMPP);
+                        float totalUsedCapacity = getResourceUsedCapa(*m2mMPP) +
+                                                  getM2mCapaReservedByOthers(*m2mMPP, display);
                         display->addExynosCompositionLayer(i, totalUsedCapacity);
                         layer->mValidateCompositionType = HWC2_COMPOSITION_EXYNOS;
                         remainNum--;
@@ -658,7 +743,8 @@ int32_t ExynosResourceManager::updateExynosComposition(ExynosDisplay *display) {
                             return ret;
                         }
                         layer->setExynosMidImage(dst_img);
-                        float totalUsedCapacity = getResourceUsedCapa(*m2mMPP);
+                        float totalUsedCapacity = getResourceUsedCapa(*m2mMPP) +
+                                                  getM2mCapaReservedByOthers(*m2mMPP, display);
                         display->addExynosCompositionLayer(i, totalUsedCapacity);
                         layer->mValidateCompositionType = HWC2_COMPOSITION_EXYNOS;
                         remainNum--;
@@ -974,6 +1060,11 @@ int32_t ExynosResourceManager::validateLayer(uint32_t index, ExynosDisplay *disp
         (layer->mOverlayPriority < ePriorityHigh))
         return eExceedMaxLayerNum;
 
+    if (display->mAssignDeadlineExceeded &&
+        ((index + display->mDisplayControl.assignDeadlineLayerNum) < display->mLayers.size()) &&
+        (layer->mOverlayPriority < ePriorityHigh))
+        return eAssignDeadline;
+
     if (display->mUseDynamicRecomp &&
         (display->mDynamicRecompMode == DEVICE_TO_CLIENT))
         return eDynamicRecomposition;
@@ -981,6 +1072,10 @@ int32_t ExynosResourceManager::validateLayer(uint32_t index, ExynosDisplay *disp
     if (layer->mCompositionType == HWC2_COMPOSITION_CLIENT)
         return eSkipLayer;
 
+    /* No sideband stream is bound to a layer, SIDEBAND_STREAM is not a capability */
+    if (layer->mCompositionType == HWC2_COMPOSITION_SIDEBAND)
+        return eUnSupportedUseCase;
+
 #ifndef HWC_SUPPORT_COLOR_TRANSFORM
     if (display->mColorTransformHint != HAL_COLOR_TRANSFORM_IDENTITY)
         return eUnSupportedColorTransform;
@@ -1088,6 +1183,13 @@ int32_t ExynosResourceManager::getCandidateM2mMPPOutImages(ExynosDisplay *displa
                        src_img.x, src_img.y, src_img.w, src_img.h,
                        dst_img.x, dst_img.y, dst_img.w, dst_img.h,
                        dst_scale_img.x, dst_scale_img.y, dst_scale_img.w, dst_scale_img.h);
+            if (dst_scale_img.exynosFormat == ExynosMPP::defaultMppDstFormat) {
+                exynos_image dst_comp_img = dst_scale_img;
+                dst_comp_img.exynosFormat = ExynosMPP::defaultMppDstCompFormat;
+                dst_comp_img.compressionInfo.type = COMP_TYPE_AFBC;
+                if (canCompressM2mOutImage(display, dst_comp_img))
+                    image_lists.push_back(dst_comp_img);
+            }
             image_lists.push_back(dst_scale_img);
 
             if (dst_scale_img.exynosFormat.isSBWC()) {
@@ -1150,6 +1252,18 @@ int32_t ExynosResourceManager::getCandidateM2mMPPOutImages(ExynosDisplay *displa
             dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
     }
 
+    /*
+     * Compressed output is tried first if an M2M can write it and a DPP can read it,
+     * DPP fetches less of it. The uncompressed one follows for the other MPPs.
+     */
+    if (dst_img.exynosFormat.isRgb() && dst_img.exynosFormat.is8Bit() && !hasHdrInfo(src_img)) {
+        exynos_image dst_comp_img = dst_img;
+        dst_comp_img.exynosFormat = ExynosMPP::defaultMppDstCompFormat;
+        dst_comp_img.compressionInfo.type = COMP_TYPE_AFBC;
+        if (canCompressM2mOutImage(display, dst_comp_img))
+            image_lists.push_back(dst_comp_img);
+    }
+
     image_lists.push_back(dst_img);
     if (dst_img.exynosFormat.isSBWC()) {
         /*
@@ -1239,40 +1353,80 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
         layer->printLayer();
     }
 
+    if ((validateFlag == NO_ERROR) && (display->mUseDpu) &&
+        (display->mStaticLayerCache.contains(layer_index))) {
+        if (assignStaticCachedLayer(display, layer, src_img, dst_img, m2mMPP) == HWC2_COMPOSITION_EXYNOS)
+            return HWC2_COMPOSITION_EXYNOS;
+    }
+
+    if ((validateFlag == NO_ERROR) && (display->mUseDpu) &&
+        (display->mDisplayControl.incrementalAssign) &&
+        (layer->isPrevAssignReusable(src_img))) {
+        if (assignLayerWithPrevInfo(display, layer, layer_index, src_img, dst_img,
+                                    m2m_out_img, m2mMPP, otfMPP) == HWC2_COMPOSITION_DEVICE)
+            return HWC2_COMPOSITION_DEVICE;
+    }
+
+    if ((validateFlag & eDimLayer) && (display->mUseDpu) &&
+        (display->mDisplayControl.foldDimLayer)) {
+        if (assignFoldedDimLayer(display, layer, layer_index, src_img, dst_img, m2mMPP) == HWC2_COMPOSITION_EXYNOS)
+            return HWC2_COMPOSITION_EXYNOS;
+    }
+
     if ((validateFlag == NO_ERROR) || (validateFlag & eInsufficientWindow) ||
         (validateFlag & eDimLayer)) {
         bool isAssignableFlag = false;
         uint64_t isSupported = 0;
-        /* 1. Find available otfMPP */
+        /* 1. Find available otfMPP, none of them if the layer supports no otfMPP type */
         if ((display->mUseDpu) &&
-            (!(validateFlag & eInsufficientWindow))) {
+            (!(validateFlag & eInsufficientWindow)) &&
+            (layer->mSupportedMPPFlag & mOtfLogicalTypes)) {
             otfMppReordering(display, mOtfMPPs, src_img, dst_img);
 
-            for (uint32_t j = 0; j < mOtfMPPs.size(); j++) {
+            /* Pairing chosen by the assignment solver is checked first */
+            ExynosMPP *solverMPP = display->mDisplayControl.assignSolver ? layer->mSolverOtfMPP : nullptr;
+            for (int32_t j = (solverMPP != nullptr) ? -1 : 0; j < (int32_t)mOtfMPPs.size(); j++) {
+                ExynosMPP *candidateMPP = (j < 0) ? solverMPP : mOtfMPPs[j];
+                if ((j >= 0) && (candidateMPP == solverMPP))
+                    continue;
 #ifdef USE_DEDICATED_TOP_WINDOW
-                if ((mOtfMPPs[j]->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
-                    (mOtfMPPs[j]->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
+                if ((candidateMPP->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
+                    (candidateMPP->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
                     (uint32_t)layer_index != (display->mLayers.size() - 1))
                     continue;
 #endif
-                if ((layer->mSupportedMPPFlag & mOtfMPPs[j]->mLogicalType) != 0)
-                    isAssignableFlag = isAssignable(mOtfMPPs[j], display, src_img, dst_img, layer);
+                isAssignableFlag = false;
+                if ((layer->mSupportedMPPFlag & candidateMPP->mLogicalType) != 0)
+                    isAssignableFlag = isAssignable(candidateMPP, display, src_img, dst_img, layer);
 
                 HDEBUGLOGD(eDebugResourceAssigning, "\t\t check %s: flag (%d) supportedBit(%d), isAssignable(%d)",
-                           mOtfMPPs[j]->mName.string(), layer->mSupportedMPPFlag,
-                           (layer->mSupportedMPPFlag & mOtfMPPs[j]->mLogicalType), isAssignableFlag);
+                           candidateMPP->mName.string(), layer->mSupportedMPPFlag,
+                           (layer->mSupportedMPPFlag & candidateMPP->mLogicalType), isAssignableFlag);
 
-                if ((layer->mSupportedMPPFlag & mOtfMPPs[j]->mLogicalType) && (isAssignableFlag)) {
-                    isSupported = mOtfMPPs[j]->isSupported(display->mDisplayInfo, src_img, dst_img);
+                if ((layer->mSupportedMPPFlag & candidateMPP->mLogicalType) && (isAssignableFlag)) {
+                    isSupported = candidateMPP->isSupported(display->mDisplayInfo, src_img, dst_img);
                     HDEBUGLOGD(eDebugResourceAssigning, "\t\t\t isSuported(%" PRIx64 ")", -isSupported);
                     if (isSupported == NO_ERROR) {
-                        *otfMPP = mOtfMPPs[j];
+                        *otfMPP = candidateMPP;
                         return HWC2_COMPOSITION_DEVICE;
                     }
                 }
             }
         }
 
+        /*
+         * The intermediate buffers of a protected layer come from the secure
+         * heap, so every legal m2mMPP and output image pair is costed and the
+         * one of the smallest intermediate buffer is taken instead of the
+         * first one.
+         */
+        bool costM2mPath = layer->isDrm();
+        ExynosMPP *bestM2mMPP = nullptr;
+        ExynosMPP *bestOtfMPP = nullptr;
+        exynos_image bestOutImg;
+        uint64_t bestBytes = UINT64_MAX;
+        float bestCapa = 0;
+
         /* 2. Find available m2mMPP */
         for (uint32_t j = 0; j < mM2mMPPs.size(); j++) {
             if ((display->mUseDpu == true) &&
@@ -1298,7 +1452,6 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
                        mM2mMPPs[j]->mName.string(),
                        (layer->mSupportedMPPFlag & mM2mMPPs[j]->mLogicalType), isAssignableState);
 
-            float totalUsedCapa = ExynosResourceManager::getResourceUsedCapa(*mM2mMPPs[j]);
             if (isAssignableState) {
                 if (!(mM2mMPPs[j]->mMaxSrcLayerNum > 1)) {
                     exynos_image otf_dst_img = dst_img;
@@ -1326,7 +1479,7 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
                             m2m_src_img.needColorTransform = false;
 
                         if (((isSupported = mM2mMPPs[j]->isSupported(display->mDisplayInfo, m2m_src_img, otf_src_img)) != NO_ERROR) ||
-                            ((isAssignableFlag = mM2mMPPs[j]->hasEnoughCapa(display->mDisplayInfo, m2m_src_img, otf_src_img, totalUsedCapa)) == false)) {
+                            ((isAssignableFlag = hasEnoughM2mCapa(mM2mMPPs[j], display, m2m_src_img, otf_src_img)) == false)) {
                             HDEBUGLOGD(eDebugResourceAssigning, "\t\t\t check %s: supportedBit(0x%" PRIx64 "), hasEnoughCapa(%d)",
                                        mM2mMPPs[j]->mName.string(), -isSupported, isAssignableFlag);
                             continue;
@@ -1359,16 +1512,33 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
                             HDEBUGLOGD(eDebugResourceAssigning, "\t\t\t check %s: supportedBit(0x%" PRIx64 "), isAssignable(%d)",
                                        mOtfMPPs[k]->mName.string(), -isSupported, isAssignableFlag);
                             if ((isSupported == NO_ERROR) && isAssignableFlag) {
-                                *m2mMPP = mM2mMPPs[j];
-                                *otfMPP = mOtfMPPs[k];
-                                m2m_out_img = otf_src_img;
-                                return HWC2_COMPOSITION_DEVICE;
+                                if (!costM2mPath) {
+                                    *m2mMPP = mM2mMPPs[j];
+                                    *otfMPP = mOtfMPPs[k];
+                                    m2m_out_img = otf_src_img;
+                                    return HWC2_COMPOSITION_DEVICE;
+                                }
+                                uint64_t bytes = getDpuReadBandwidth(otf_src_img, 1);
+                                float capa = mM2mMPPs[j]->getRequiredCapacity(display->mDisplayInfo,
+                                                                              m2m_src_img, otf_src_img);
+                                HDEBUGLOGD(eDebugResourceAssigning, "\t\t\t %s -> %s: %" PRIu64 " bytes, capacity %f",
+                                           mM2mMPPs[j]->mName.string(), mOtfMPPs[k]->mName.string(), bytes, capa);
+                                if ((bytes < bestBytes) || ((bytes == bestBytes) && (capa < bestCapa))) {
+                                    bestM2mMPP = mM2mMPPs[j];
+                                    bestOtfMPP = mOtfMPPs[k];
+                                    bestOutImg = otf_src_img;
+                                    bestBytes = bytes;
+                                    bestCapa = capa;
+                                }
+                                /* Other otfMPPs read the same image */
+                                break;
                             }
                         }
                     }
                 } else {
-                    if ((layer->mSupportedMPPFlag & mM2mMPPs[j]->mLogicalType) &&
-                        ((isAssignableFlag = mM2mMPPs[j]->hasEnoughCapa(display->mDisplayInfo, src_img, dst_img, totalUsedCapa) == true))) {
+                    if ((bestM2mMPP == nullptr) &&
+                        (layer->mSupportedMPPFlag & mM2mMPPs[j]->mLogicalType) &&
+                        ((isAssignableFlag = hasEnoughM2mCapa(mM2mMPPs[j], display, src_img, dst_img)) == true)) {
                         *m2mMPP = mM2mMPPs[j];
                         return HWC2_COMPOSITION_EXYNOS;
                     } else {
@@ -1378,6 +1548,13 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
                 }
             }
         }
+
+        if (bestM2mMPP != nullptr) {
+            *m2mMPP = bestM2mMPP;
+            *otfMPP = bestOtfMPP;
+            m2m_out_img = bestOutImg;
+            return HWC2_COMPOSITION_DEVICE;
+        }
     }
     /* Fail to assign resource */
     if (validateFlag != NO_ERROR)
@@ -1399,6 +1576,350 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
     return HWC2_COMPOSITION_CLIENT;
 }
 
+/*
+ * Idle layers in the static layer cache range are sent to exynos composition
+ * so that they are blended once and shown through a single window.
+ * The blending MPP skips processing while its sources are not changed.
+ */
+int32_t ExynosResourceManager::assignStaticCachedLayer(ExynosDisplay *display, ExynosLayer *layer,
+                                                       exynos_image &src_img, exynos_image &dst_img,
+                                                       ExynosMPP **m2mMPP) {
+    for (uint32_t j = 0; j < mM2mMPPs.size(); j++) {
+        if ((mM2mMPPs[j]->mMaxSrcLayerNum <= 1) ||
+            (mM2mMPPs[j]->mLogicalType == MPP_LOGICAL_G2D_COMBO) ||
+            (mM2mMPPs[j]->mLogicalType == MPP_LOGICAL_MSC_COMBO))
+            continue;
+        if ((layer->mSupportedMPPFlag & mM2mMPPs[j]->mLogicalType) == 0)
+            continue;
+        if (!mM2mMPPs[j]->isAssignableState(display->mDisplayInfo, src_img, dst_img))
+            continue;
+
+        if (hasEnoughM2mCapa(mM2mMPPs[j], display, src_img, dst_img)) {
+            HDEBUGLOGD(eDebugResourceAssigning, "\t\tstatic layer is assigned to %s",
+                       mM2mMPPs[j]->mName.string());
+            *m2mMPP = mM2mMPPs[j];
+            return HWC2_COMPOSITION_EXYNOS;
+        }
+    }
+
+    return HWC2_COMPOSITION_CLIENT;
+}
+
+/*
+ * A dim or solid color layer next to the exynos composition is filled by its
+ * blending MPP instead of taking a window of its own. The fill is cheap for
+ * G2D while a window and a DPP channel are scarce, so it is folded whenever
+ * the blending MPP supports it and has enough capacity left.
+ */
+int32_t ExynosResourceManager::assignFoldedDimLayer(ExynosDisplay *display, ExynosLayer *layer,
+                                                    uint32_t layer_index,
+                                                    exynos_image &src_img, exynos_image &dst_img,
+                                                    ExynosMPP **m2mMPP) {
+    ExynosCompositionInfo &exynosInfo = display->mExynosCompositionInfo;
+    ExynosMPP *blendingMPP = exynosInfo.mM2mMPP;
+
+    if (!exynosInfo.mHasCompositionLayer || (blendingMPP == NULL))
+        return HWC2_COMPOSITION_CLIENT;
+
+    /* Folding a layer apart from the range would pull the layers between */
+    if (((int32_t)layer_index + 1 != exynosInfo.mFirstIndex) &&
+        ((int32_t)layer_index != exynosInfo.mLastIndex + 1))
+        return HWC2_COMPOSITION_CLIENT;
+
+    if ((layer->mSupportedMPPFlag & blendingMPP->mLogicalType) == 0)
+        return HWC2_COMPOSITION_CLIENT;
+
+    if ((blendingMPP->isSupported(display->mDisplayInfo, src_img, dst_img) != NO_ERROR) ||
+        !hasEnoughM2mCapa(blendingMPP, display, src_img, dst_img))
+        return HWC2_COMPOSITION_CLIENT;
+
+    HDEBUGLOGD(eDebugResourceAssigning, "		[%d] dim layer is folded into %s",
+               layer_index, blendingMPP->mName.string());
+    *m2mMPP = blendingMPP;
+
+    return HWC2_COMPOSITION_EXYNOS;
+}
+
+/*
+ * Check whether the MPPs of the last successful validate can be assigned again.
+ * This skips the candidate search of assignLayer() for layers
+ * of which only buffer is updated.
+ */
+int32_t ExynosResourceManager::assignLayerWithPrevInfo(ExynosDisplay *display, ExynosLayer *layer,
+                                                       uint32_t layer_index,
+                                                       exynos_image &src_img, exynos_image &dst_img,
+                                                       exynos_image &m2m_out_img, ExynosMPP **m2mMPP,
+                                                       ExynosMPP **otfMPP) {
+    ExynosMPP *prevOtfMPP = layer->mPrevAssignInfo.otfMPP;
+    ExynosMPP *prevM2mMPP = layer->mPrevAssignInfo.m2mMPP;
+
+#ifdef USE_DEDICATED_TOP_WINDOW
+    if ((prevOtfMPP->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
+        (prevOtfMPP->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
+        (uint32_t)layer_index != (display->mLayers.size() - 1))
+        return HWC2_COMPOSITION_INVALID;
+#endif
+
+    if (prevM2mMPP == NULL) {
+        if (((layer->mSupportedMPPFlag & prevOtfMPP->mLogicalType) == 0) ||
+            (isAssignable(prevOtfMPP, display, src_img, dst_img, layer) == false) ||
+            (prevOtfMPP->isSupported(display->mDisplayInfo, src_img, dst_img) != NO_ERROR))
+            return HWC2_COMPOSITION_INVALID;
+
+        HDEBUGLOGD(eDebugResourceAssigning, "\t\t[%d] layer: reuse %s",
+                   layer_index, prevOtfMPP->mName.string());
+        *otfMPP = prevOtfMPP;
+        return HWC2_COMPOSITION_DEVICE;
+    }
+
+    /* Only single source m2mMPP is reused, blending m2mMPP is handled by exynos composition */
+    if (prevM2mMPP->mMaxSrcLayerNum > 1)
+        return HWC2_COMPOSITION_INVALID;
+
+    if (prevM2mMPP->isAssignableState(display->mDisplayInfo, src_img, dst_img) == false)
+        return HWC2_COMPOSITION_INVALID;
+
+    exynos_image m2m_src_img = src_img;
+    exynos_image otf_src_img = layer->mPrevAssignInfo.midImg;
+    exynos_image otf_dst_img = dst_img;
+    otf_dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
+    otf_src_img.transform = 0;
+    otf_dst_img.transform = 0;
+    if (otf_src_img.needColorTransform)
+        m2m_src_img.needColorTransform = false;
+
+    if ((prevM2mMPP->isSupported(display->mDisplayInfo, m2m_src_img, otf_src_img) != NO_ERROR) ||
+        (hasEnoughM2mCapa(prevM2mMPP, display, m2m_src_img, otf_src_img) == false) ||
+        (prevOtfMPP->isSupported(display->mDisplayInfo, otf_src_img, otf_dst_img) != NO_ERROR))
+        return HWC2_COMPOSITION_INVALID;
+
+    ExynosCompositionInfo dpuSrcInfo;
+    dpuSrcInfo.mSrcImg = otf_src_img;
+    dpuSrcInfo.mDstImg = otf_dst_img;
+    calculateHWResourceAmount(display, &dpuSrcInfo);
+    if (isAssignable(prevOtfMPP, display, otf_src_img, otf_dst_img, &dpuSrcInfo) == false)
+        return HWC2_COMPOSITION_INVALID;
+
+    HDEBUGLOGD(eDebugResourceAssigning, "\t\t[%d] layer: reuse %s, %s",
+               layer_index, prevM2mMPP->mName.string(), prevOtfMPP->mName.string());
+    *m2mMPP = prevM2mMPP;
+    *otfMPP = prevOtfMPP;
+    m2m_out_img = otf_src_img;
+    return HWC2_COMPOSITION_DEVICE;
+}
+
+/*
+ * Search layer to otfMPP pairings with a small branch and bound.
+ * Each layer is shown by an otfMPP directly, through a m2mMPP or by
+ * client composition, and the pairing that minimizes eSolverCost* is
+ * searched within assignSolverBudgetUs. Client composition is extended
+ * to the layers between client layers as addClientCompositionLayer() does.
+ * The result is used only if it is better than the greedy order of
+ * assignLayer(), and it is only a hint: assignLayer() still checks
+ * every restriction of the chosen otfMPP.
+ */
+int32_t ExynosResourceManager::solveOtfAssignment(ExynosDisplay *display) {
+    struct SolverLayer {
+        uint32_t index;
+        uint64_t directMask;
+        uint64_t scaledMask;
+        uint64_t m2mMask;
+    };
+    /* otfMPP index, or one of below for each layer */
+    constexpr int32_t kSolverM2m = -1;
+    constexpr int32_t kSolverClient = -2;
+
+    for (auto layer : display->mLayers)
+        layer->mSolverOtfMPP = nullptr;
+
+    if ((display->mUseDpu == false) || (mOtfMPPs.size() > 64) ||
+        (display->mLayers.size() > MAX_OVERLAY_LAYER_NUM))
+        return NO_ERROR;
+
+    std::vector<SolverLayer> layers;
+    int32_t forcedClientFirst = -1;
+    int32_t forcedClientLast = -1;
+    auto addForcedClient = [&](int32_t index) {
+        if ((forcedClientFirst < 0) || (index < forcedClientFirst))
+            forcedClientFirst = index;
+        if (index > forcedClientLast)
+            forcedClientLast = index;
+    };
+
+    for (int32_t priority = ePriorityMax; priority > ePriorityNone; priority--) {
+        for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+            ExynosLayer *layer = display->mLayers[i];
+            if (layer->mOverlayPriority != (uint32_t)priority)
+                continue;
+            if (layer->mCompositionType == HWC2_COMPOSITION_CLIENT) {
+                addForcedClient(i);
+                continue;
+            }
+
+            int32_t validateFlag = validateLayer(i, display, layer);
+            if (validateFlag == eDimLayer)
+                continue;
+            if (validateFlag != NO_ERROR) {
+                addForcedClient(i);
+                continue;
+            }
+
+            exynos_image src_img;
+            exynos_image dst_img;
+            layer->setSrcExynosImage(&src_img);
+            layer->setDstExynosImage(&dst_img);
+
+            SolverLayer solverLayer = {i, 0, 0, 0};
+            bool scaled = (src_img.transform & HAL_TRANSFORM_ROT_90) ?
+                              ((src_img.w != dst_img.h) || (src_img.h != dst_img.w)) :
+                              ((src_img.w != dst_img.w) || (src_img.h != dst_img.h));
+            uint64_t assignableMask = 0;
+            for (uint32_t j = 0; j < mOtfMPPs.size(); j++) {
+#ifdef USE_DEDICATED_TOP_WINDOW
+                if ((mOtfMPPs[j]->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
+                    (mOtfMPPs[j]->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
+                    (i != (display->mLayers.size() - 1)))
+                    continue;
+#endif
+                if (mOtfMPPs[j]->isAssignableState(display->mDisplayInfo, src_img, dst_img) == false)
+                    continue;
+                assignableMask |= (1ULL << j);
+                if (((layer->mSupportedMPPFlag & mOtfMPPs[j]->mLogicalType) != 0) &&
+                    (mOtfMPPs[j]->isSupported(display->mDisplayInfo, src_img, dst_img) == NO_ERROR))
+                    solverLayer.directMask |= (1ULL << j);
+            }
+            if (scaled)
+                solverLayer.scaledMask = solverLayer.directMask;
+            for (uint32_t j = 0; j < mM2mMPPs.size(); j++) {
+                if ((mM2mMPPs[j]->mLogicalType == MPP_LOGICAL_G2D_COMBO) ||
+                    (mM2mMPPs[j]->mLogicalType == MPP_LOGICAL_MSC_COMBO))
+                    continue;
+                if (layer->mSupportedMPPFlag & mM2mMPPs[j]->mLogicalType) {
+                    solverLayer.m2mMask = assignableMask;
+                    break;
+                }
+            }
+            layers.push_back(solverLayer);
+        }
+    }
+
+    if (layers.size() == 0)
+        return NO_ERROR;
+
+    const size_t layerNum = layers.size();
+    std::vector<int32_t> current(layerNum, kSolverClient);
+    std::vector<int32_t> best(layerNum, kSolverClient);
+
+    /* Cost of a complete pairing including the extended client composition */
+    auto evaluate = [&](const std::vector<int32_t> &choice) -> uint32_t {
+        int32_t clientFirst = forcedClientFirst;
+        int32_t clientLast = forcedClientLast;
+        for (size_t k = 0; k < layerNum; k++) {
+            if (choice[k] != kSolverClient)
+                continue;
+            int32_t index = layers[k].index;
+            if ((clientFirst < 0) || (index < clientFirst))
+                clientFirst = index;
+            if (index > clientLast)
+                clientLast = index;
+        }
+
+        uint32_t cost = (clientFirst >= 0) ? eSolverCostClient : 0;
+        uint32_t windowNum = (clientFirst >= 0) ? 1 : 0;
+        for (size_t k = 0; k < layerNum; k++) {
+            int32_t index = layers[k].index;
+            if ((clientFirst >= 0) && (index >= clientFirst) && (index <= clientLast)) {
+                cost += eSolverCostClientLayer;
+                continue;
+            }
+            windowNum++;
+            if (choice[k] == kSolverM2m)
+                cost += eSolverCostM2m;
+            else if (layers[k].scaledMask & (1ULL << choice[k]))
+                cost += eSolverCostScaled;
+            else
+                cost += eSolverCostDirect;
+        }
+        if (windowNum > display->mMaxWindowNum)
+            return UINT32_MAX;
+        return cost;
+    };
+
+    /* Greedy pairing in the order of assignLayers() as the initial bound */
+    uint64_t greedyUsed = 0;
+    for (size_t k = 0; k < layerNum; k++) {
+        uint64_t freeMask = layers[k].directMask & ~greedyUsed;
+        if (freeMask == 0)
+            freeMask = layers[k].m2mMask & ~greedyUsed;
+        if (freeMask == 0)
+            continue;
+        int32_t j = __builtin_ctzll(freeMask);
+        greedyUsed |= (1ULL << j);
+        best[k] = (layers[k].directMask & (1ULL << j)) ? j : kSolverM2m;
+    }
+    const uint32_t greedyCost = evaluate(best);
+    uint32_t bestCost = greedyCost;
+
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) +
+                       (nsecs_t)display->mDisplayControl.assignSolverBudgetUs * 1000;
+    uint32_t nodeCount = 0;
+    bool timeout = false;
+
+    std::function<void(size_t, uint64_t, uint32_t)> search =
+        [&](size_t k, uint64_t used, uint32_t partialCost) {
+            if (timeout || (partialCost >= bestCost))
+                return;
+            if (((++nodeCount & 0x3f) == 0) &&
+                (systemTime(SYSTEM_TIME_MONOTONIC) > deadline)) {
+                timeout = true;
+                return;
+            }
+            if (k == layerNum) {
+                uint32_t cost = evaluate(current);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    best = current;
+                }
+                return;
+            }
+
+            uint64_t freeMask = layers[k].directMask & ~used;
+            while (freeMask) {
+                int32_t j = __builtin_ctzll(freeMask);
+                freeMask &= ~(1ULL << j);
+                current[k] = j;
+                search(k + 1, used | (1ULL << j),
+                       partialCost + ((layers[k].scaledMask & (1ULL << j)) ? eSolverCostScaled : eSolverCostDirect));
+            }
+
+            /* m2mMPP output can be shown by any otfMPP, try the first free one */
+            uint64_t m2mFreeMask = layers[k].m2mMask & ~used;
+            if (m2mFreeMask) {
+                int32_t j = __builtin_ctzll(m2mFreeMask);
+                current[k] = kSolverM2m;
+                search(k + 1, used | (1ULL << j), partialCost + eSolverCostM2m);
+            }
+
+            current[k] = kSolverClient;
+            search(k + 1, used, partialCost + eSolverCostClientLayer);
+        };
+    search(0, 0, 0);
+
+    HDEBUGLOGD(eDebugResourceAssigning, "%s:: display(%d) layers(%zu) greedy cost(%d), solver cost(%d), nodes(%d)%s",
+               __func__, display->mType, layerNum, greedyCost, bestCost, nodeCount,
+               timeout ? ", timeout" : "");
+
+    if (bestCost >= greedyCost)
+        return NO_ERROR;
+
+    for (size_t k = 0; k < layerNum; k++) {
+        if (best[k] >= 0)
+            display->mLayers[layers[k].index]->mSolverOtfMPP = mOtfMPPs[best[k]];
+    }
+
+    return NO_ERROR;
+}
+
 int32_t ExynosResourceManager::assignLayers(ExynosDisplay *display, uint32_t priority) {
     HDEBUGLOGD(eDebugResourceAssigning, "%s:: display(%d), priority(%d) +++++",
                __func__, display->mType, priority);
@@ -1460,7 +1981,8 @@ int32_t ExynosResourceManager::assignLayers(ExynosDisplay *display, uint32_t pri
                           __func__, m2mMPP->mName.string(), ret);
                     return ret;
                 }
-                totalUsedCapacity = getResourceUsedCapa(*m2mMPP);
+                totalUsedCapacity = getResourceUsedCapa(*m2mMPP) +
+                                    getM2mCapaReservedByOthers(*m2mMPP, display);
                 HDEBUGLOGD(eDebugResourceAssigning, "\t\t[%d] layer: %s MPP is assigned",
                            i, m2mMPP->mName.string());
             }
@@ -1582,6 +2104,16 @@ int32_t ExynosResourceManager::assignWindow(ExynosDisplay *display) {
  * @param * display
  * @return int
  */
+/*
+ * Called from the validate worker pool before assignResource().
+ * It only reads MPP restrictions and writes flags of the layers of the display.
+ */
+int32_t ExynosResourceManager::preUpdateSupportedMPPFlag(ExynosDisplay *display) {
+    int32_t ret = updateSupportedMPPFlag(display);
+    display->mSupportedMPPFlagUpdated = (ret == NO_ERROR);
+    return ret;
+}
+
 int32_t ExynosResourceManager::updateSupportedMPPFlag(ExynosDisplay *display) {
     int64_t ret = 0;
     HDEBUGLOGD(eDebugResourceAssigning, "%s++++++++++", __func__);
@@ -1663,6 +2195,34 @@ int32_t ExynosResourceManager::updateSupportedMPPFlag(ExynosDisplay *display) {
     return NO_ERROR;
 }
 
+void ExynosResourceManager::prefetchSupportedMPPFlag(ExynosDisplay *display) {
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+
+        if ((layer->mGeometryChanged == 0) || !layer->preProcessSpeculatively())
+            continue;
+
+        exynos_image src_img;
+        exynos_image dst_img;
+        exynos_image dst_img_yuv;
+        layer->setSrcExynosImage(&src_img);
+        layer->setDstExynosImage(&dst_img);
+        dst_img_yuv = dst_img;
+        dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
+        dst_img_yuv.exynosFormat = ExynosMPP::defaultMppDstYuvFormat;
+
+        auto prefetch = [&](ExynosMPP *mpp) {
+            if ((-mpp->prefetchSupported(display->mDisplayInfo, src_img, dst_img)) ==
+                eMPPUnsupportedFormat)
+                mpp->prefetchSupported(display->mDisplayInfo, src_img, dst_img_yuv);
+        };
+        for (auto mpp : mOtfMPPs)
+            prefetch(mpp);
+        for (auto mpp : mM2mMPPs)
+            prefetch(mpp);
+    }
+}
+
 int32_t ExynosResourceManager::resetResources() {
     HDEBUGLOGD(eDebugResourceManager, "%s+++++++++", __func__);
 
@@ -1692,11 +2252,80 @@ int32_t ExynosResourceManager::resetResources() {
 uint32_t ExynosResourceManager::getExceptionScenarioFlag(ExynosMPP *mpp) {
     if (mpp->mEnableByDebug == false)
         return static_cast<uint32_t>(DisableType::DISABLE_DEBUG);
+    else if (mpp->mPowerGated)
+        return static_cast<uint32_t>(DisableType::DISABLE_POWER_GATING);
+    else if ((mpp->mMPPType == MPP_TYPE_M2M) && (mM2mRestrictionsReady == false))
+        return static_cast<uint32_t>(DisableType::DISABLE_DEFERRED_INIT);
     else
         return static_cast<uint32_t>(DisableType::DISABLE_NONE);
 }
 
+/*
+ * Gate otfMPPs that were not used for MPP_POWER_GATING_IDLE_FRAMES.
+ * Gated otfMPPs are not assigned so that their DPP channels can be
+ * powered down by the kernel. Each display keeps at least its layer number
+ * + MPP_POWER_GATING_SPARE_NUM otfMPPs ungated, so gated ones are enabled
+ * again as soon as layer number increases. All of them are enabled
+ * if any display has client composition.
+ */
+void ExynosResourceManager::updateMPPPowerGating() {
+    /* [displayId] */
+    std::map<uint32_t, uint32_t> layerNums;
+    std::map<uint32_t, uint32_t> ungatedNums;
+    uint32_t totalLayerNum = 0;
+    bool hasClientComposition = false;
+
+    for (auto display : mDisplays) {
+        if (display->isEnabled() == false)
+            continue;
+        layerNums[display->mDisplayId] = display->mLayers.size();
+        totalLayerNum += display->mLayers.size();
+        if (display->mClientCompositionInfo.mHasCompositionLayer)
+            hasClientComposition = true;
+    }
+
+    for (auto mpp : mOtfMPPs) {
+        if (mpp->mPowerGated == false)
+            ungatedNums[mpp->mReservedDisplayInfo.displayIdentifier.id]++;
+    }
+
+    for (auto mpp : mOtfMPPs) {
+        uint32_t displayId = mpp->mReservedDisplayInfo.displayIdentifier.id;
+        uint32_t &ungatedNum = ungatedNums[displayId];
+        uint32_t requiredNum = MPP_POWER_GATING_SPARE_NUM;
+        if (displayId == UINT32_MAX)
+            requiredNum += totalLayerNum;
+        else if (layerNums.count(displayId))
+            requiredNum += layerNums[displayId];
+
+        if ((exynosHWCControl.dppPowerGating == false) || hasClientComposition) {
+            if (mpp->mPowerGated)
+                ungatedNum++;
+            mpp->mPowerGated = false;
+            continue;
+        }
+
+        if (mpp->mPowerGated) {
+            if (ungatedNum < requiredNum) {
+                HDEBUGLOGD(eDebugResourceManager, "%s:: %s is enabled, requiredNum(%d)",
+                           __func__, mpp->mName.string(), requiredNum);
+                mpp->mPowerGated = false;
+                mpp->mUnusedFrameCnt = 0;
+                ungatedNum++;
+            }
+        } else if ((mpp->mUnusedFrameCnt >= MPP_POWER_GATING_IDLE_FRAMES) &&
+                   (ungatedNum > requiredNum)) {
+            HDEBUGLOGD(eDebugResourceManager, "%s:: %s is gated, requiredNum(%d)",
+                       __func__, mpp->mName.string(), requiredNum);
+            mpp->mPowerGated = true;
+            ungatedNum--;
+        }
+    }
+}
+
 int32_t ExynosResourceManager::checkExceptionScenario(uint64_t &geometryFlag) {
+    updateMPPPowerGating();
+
     auto checkDisabled = [&](ExynosMPPVector &mpps) {
         for (auto mpp : mpps) {
             uint32_t disableByUserScenario = 0;
@@ -1813,8 +2442,13 @@ ExynosMPP *ExynosResourceManager::getExynosMPPForBlending(ExynosDisplay *display
 
 int32_t ExynosResourceManager::updateResourceState() {
     for (uint32_t i = 0; i < mOtfMPPs.size(); i++) {
-        if (mOtfMPPs[i]->mAssignedSources.size() == 0)
+        if (mOtfMPPs[i]->mAssignedSources.size() == 0) {
             mOtfMPPs[i]->requestHWStateChange(MPP_HW_STATE_IDLE);
+            if (mOtfMPPs[i]->mUnusedFrameCnt < MPP_POWER_GATING_IDLE_FRAMES)
+                mOtfMPPs[i]->mUnusedFrameCnt++;
+        } else {
+            mOtfMPPs[i]->mUnusedFrameCnt = 0;
+        }
         mOtfMPPs[i]->mPrevAssignedState = mOtfMPPs[i]->mAssignedState;
     }
     for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
@@ -2023,6 +2657,303 @@ float ExynosResourceManager::getResourceUsedCapa(ExynosMPP &mpp) {
     return usedCapa;
 }
 
+bool ExynosResourceManager::hasEnoughM2mCapa(ExynosMPP *mpp, ExynosDisplay *display,
+                                             struct exynos_image &src, struct exynos_image &dst) {
+    float totalUsedCapa = getResourceUsedCapa(*mpp) + getM2mCapaReservedByOthers(*mpp, display);
+    if (mpp->hasEnoughCapa(display->mDisplayInfo, src, dst, totalUsedCapa))
+        return true;
+
+    /* Remember how much more this display wanted for the next rebalancing */
+    if (exynosHWCControl.m2mCapaBroker && (mpp->mCapacity > 0)) {
+        M2mCapaShare &share = mM2mCapaShares[mpp->mPhysicalType][display->mDisplayId];
+        share.shortage = max(share.shortage,
+                             mpp->getRequiredCapacity(display->mDisplayInfo, src, dst));
+    }
+    return false;
+}
+
+float ExynosResourceManager::getDisplayUsedCapa(uint32_t physicalType, uint32_t displayId) {
+    float usedCapa = 0;
+    for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        if (mM2mMPPs[i]->mPhysicalType != physicalType)
+            continue;
+        if (mM2mMPPs[i]->mAssignedDisplayInfo.displayIdentifier.id == displayId)
+            usedCapa += mM2mMPPs[i]->mUsedCapacity;
+        if (mM2mMPPs[i]->mReservedDisplayInfo.displayIdentifier.id == displayId)
+            usedCapa += mM2mMPPs[i]->mPreAssignedCapacity;
+    }
+    return usedCapa;
+}
+
+/*
+ * Weight of the display for sharing m2mMPP capacity.
+ * Display that is refreshed more often or shows protected or HDR
+ * content has more share.
+ */
+float ExynosResourceManager::getM2mCapaWeight(ExynosDisplay *display) {
+    float fps = kDefaultDispFps;
+    if (display->mVsyncPeriod > 0)
+        fps = (float)1000000000 / display->mVsyncPeriod;
+
+    float priority = (display->mType == HWC_DISPLAY_PRIMARY) ? 2.0f : 1.0f;
+    if (display->mLayerSummary.drmLayerNum || display->mLayerSummary.hdrLayerNum)
+        priority += 1.0f;
+    return fps * priority;
+}
+
+/*
+ * Capacity that was budgeted to other displays but is not used by them yet.
+ * It is regarded as used so that the display validated first can't take it.
+ */
+float ExynosResourceManager::getM2mCapaReservedByOthers(ExynosMPP &mpp, ExynosDisplay *display) {
+    if ((exynosHWCControl.m2mCapaBroker == false) || (mpp.mMPPType != MPP_TYPE_M2M) ||
+        (mpp.mCapacity < 0))
+        return 0;
+
+    auto shares = mM2mCapaShares.find(mpp.mPhysicalType);
+    if (shares == mM2mCapaShares.end())
+        return 0;
+
+    float reserved = 0;
+    for (auto &share : shares->second) {
+        if (share.first == display->mDisplayId)
+            continue;
+        float unused = share.second.budget - getDisplayUsedCapa(mpp.mPhysicalType, share.first);
+        if (unused > 0)
+            reserved += unused;
+    }
+
+    HDEBUGLOGD(eDebugCapacity, "%s:: display(%d) %s reserved by others(%f)",
+               __func__, display->mDisplayId, mpp.mName.string(), reserved);
+    return reserved;
+}
+
+/*
+ * Weighted max-min fair sharing.
+ * Display that needs less than its share gets what it needs and
+ * the rest is shared by other displays.
+ */
+void ExynosResourceManager::rebalanceM2mCapa(uint32_t physicalType, float capacity) {
+    std::map<uint32_t, M2mCapaShare> &shares = mM2mCapaShares[physicalType];
+    std::vector<uint32_t> pending;
+
+    for (auto it = shares.begin(); it != shares.end();) {
+        ExynosDisplay *display = getDisplay(it->first);
+        if ((display == nullptr) || (display->isEnabled() == false)) {
+            it = shares.erase(it);
+            continue;
+        }
+        it->second.budget = 0;
+        pending.push_back(it->first);
+        it++;
+    }
+
+    float remain = capacity;
+    while ((pending.size() > 0) && (remain > 0)) {
+        float weightSum = 0;
+        for (auto displayId : pending)
+            weightSum += getM2mCapaWeight(getDisplay(displayId));
+        if (weightSum <= 0)
+            break;
+
+        bool satisfied = false;
+        for (auto it = pending.begin(); it != pending.end();) {
+            M2mCapaShare &share = shares[*it];
+            float fairShare = remain * getM2mCapaWeight(getDisplay(*it)) / weightSum;
+            if (share.demand <= fairShare) {
+                share.budget = share.demand;
+                it = pending.erase(it);
+                satisfied = true;
+            } else {
+                it++;
+            }
+        }
+
+        if (satisfied) {
+            remain = capacity;
+            for (auto &share : shares)
+                remain -= share.second.budget;
+            continue;
+        }
+
+        for (auto displayId : pending)
+            shares[displayId].budget = remain * getM2mCapaWeight(getDisplay(displayId)) / weightSum;
+        break;
+    }
+}
+
+/*
+ * Update capacity demand of the display after resource assignment
+ * and rebalance budgets for the next frame.
+ */
+void ExynosResourceManager::updateM2mCapaShares(ExynosDisplay *display) {
+    if (exynosHWCControl.m2mCapaBroker == false) {
+        mM2mCapaShares.clear();
+        return;
+    }
+
+    std::map<uint32_t, float> capacities;
+    for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        if (mM2mMPPs[i]->mCapacity > 0)
+            capacities[mM2mMPPs[i]->mPhysicalType] = mM2mMPPs[i]->mCapacity;
+    }
+
+    for (auto &capacity : capacities) {
+        M2mCapaShare &share = mM2mCapaShares[capacity.first][display->mDisplayId];
+        float demand = getDisplayUsedCapa(capacity.first, display->mDisplayId) + share.shortage;
+        /* Decay slowly so that budget is not lost by one frame */
+        share.demand = max(demand, share.demand * 0.875f);
+        share.shortage = 0;
+        rebalanceM2mCapa(capacity.first, capacity.second);
+    }
+}
+
+void ExynosResourceManager::updateMPPUsageStats(ExynosDisplay *display) {
+    for (auto mpp : mOtfMPPs) {
+        if (mpp->mAssignedDisplayInfo.displayIdentifier.id == display->mDisplayId)
+            mpp->updateUsageStats();
+    }
+    for (auto mpp : mM2mMPPs) {
+        if (mpp->mAssignedDisplayInfo.displayIdentifier.id == display->mDisplayId)
+            mpp->updateUsageStats();
+    }
+}
+
+void ExynosResourceManager::dumpMPPUsageStats(String8 &result) {
+    result.appendFormat("MPP usage\n");
+    for (auto mpp : mOtfMPPs)
+        mpp->dumpUsageStats(result);
+    for (auto mpp : mM2mMPPs)
+        mpp->dumpUsageStats(result);
+}
+
+void ExynosResourceManager::dumpM2mCapaShares(String8 &result) {
+    if (exynosHWCControl.m2mCapaBroker == false)
+        return;
+
+    result.appendFormat("M2M capacity shares\n");
+    for (auto &shares : mM2mCapaShares) {
+        for (auto &share : shares.second) {
+            result.appendFormat("\ttype(%d) display(%d): demand(%f), budget(%f), used(%f)\n",
+                                shares.first, share.first, share.second.demand,
+                                share.second.budget,
+                                getDisplayUsedCapa(shares.first, share.first));
+        }
+    }
+}
+
+/* Bytes/s that DPU reads for the image at the fps */
+uint64_t ExynosResourceManager::getDpuReadBandwidth(const exynos_image &img, uint32_t fps) {
+    uint64_t bytes = (uint64_t)img.w * img.h * img.exynosFormat.bpp() / 8;
+
+    if ((img.compressionInfo.type == COMP_TYPE_AFBC) ||
+        (img.compressionInfo.type == COMP_TYPE_SAJC))
+        bytes = bytes * DPU_BW_AFBC_RATIO / 100;
+    else if (isFormatSBWC(img.exynosFormat.halFormat()))
+        bytes = bytes * DPU_BW_SBWC_RATIO / 100;
+
+    return bytes * fps;
+}
+
+/*
+ * Estimates DPU read bandwidth of the windows of the display and moves
+ * the device composition layers that need the most bandwidth to client
+ * composition while the estimate of all displays exceeds the budget.
+ * It returns EXYNOS_ERROR_CHANGED if any layer is moved so that the
+ * assignment is done again with the new client composition range.
+ */
+int32_t ExynosResourceManager::checkDpuBandwidth(ExynosDisplay *display) {
+    int32_t ret = NO_ERROR;
+    const uint64_t budget = (uint64_t)exynosHWCControl.dpuBandwidthBudget * 1000000;
+
+    display->mDpuBandwidth = 0;
+    if ((budget == 0) || (display->mUseDpu == false))
+        return NO_ERROR;
+
+    uint32_t fps = (display->mVsyncPeriod > 0) ? (uint32_t)(1000000000 / display->mVsyncPeriod) : 60;
+    auto readBandwidth = [&](ExynosMPPSource *source) -> uint64_t {
+        return getDpuReadBandwidth(source->mM2mMPP ? source->mMidImg : source->mSrcImg, fps);
+    };
+
+    uint64_t total = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> deviceLayers;
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if (layer->mValidateCompositionType != HWC2_COMPOSITION_DEVICE)
+            continue;
+        uint64_t bandwidth = readBandwidth(layer);
+        deviceLayers.push_back(std::make_pair(bandwidth, i));
+        total += bandwidth;
+    }
+    if (display->mExynosCompositionInfo.mHasCompositionLayer)
+        total += readBandwidth(&display->mExynosCompositionInfo);
+
+    exynos_image clientTarget;
+    exynos_image clientTargetDst;
+    display->setCompositionTargetExynosImage(COMPOSITION_CLIENT, &clientTarget, &clientTargetDst);
+    bool hasClientTarget = display->mClientCompositionInfo.mHasCompositionLayer;
+    if (hasClientTarget)
+        total += getDpuReadBandwidth(clientTarget, fps);
+
+    uint64_t others = 0;
+    for (auto other : mDisplays) {
+        if ((other != display) && other->isEnabled())
+            others += (uint64_t)other->mDpuBandwidth * 1000000;
+    }
+
+    if (others + total > budget) {
+        /* Layers that need more bandwidth are moved first */
+        std::sort(deviceLayers.begin(), deviceLayers.end(),
+                  [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b) {
+                      return a.first > b.first;
+                  });
+        for (auto &it : deviceLayers) {
+            if (others + total <= budget)
+                break;
+            /* It can be added to client composition with the previous one */
+            if (display->mLayers[it.second]->mValidateCompositionType != HWC2_COMPOSITION_DEVICE)
+                continue;
+            if (hasClientTarget == false) {
+                total += getDpuReadBandwidth(clientTarget, fps);
+                hasClientTarget = true;
+            }
+            ExynosLayer *layer = display->mLayers[it.second];
+            layer->resetAssignedResource();
+            layer->mOverlayInfo |= eExceedDpuBandwidth;
+            layer->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
+            if (((ret = display->addClientCompositionLayer(it.second)) != NO_ERROR) &&
+                (ret != EXYNOS_ERROR_CHANGED)) {
+                HWC_LOGE(display->mDisplayInfo.displayIdentifier,
+                         "%s:: addClientCompositionLayer failed (%d)", __func__, ret);
+                return ret;
+            }
+            total -= min(total, it.first);
+            ret = EXYNOS_ERROR_CHANGED;
+        }
+        if (ret == EXYNOS_ERROR_CHANGED) {
+            display->mDpuBandwidthExceededCnt++;
+            HDEBUGLOGD(eDebugResourceManager, "%s:: display(%d) exceeds dpu bandwidth budget(%" PRIu64 ")",
+                       __func__, display->mType, budget);
+        }
+    }
+
+    display->mDpuBandwidth = (uint32_t)(total / 1000000);
+    return ret;
+}
+
+void ExynosResourceManager::dumpDpuBandwidth(String8 &result) {
+    if (exynosHWCControl.dpuBandwidthBudget == 0)
+        return;
+
+    uint32_t total = 0;
+    for (auto display : mDisplays) {
+        if (display->isEnabled())
+            total += display->mDpuBandwidth;
+    }
+    result.appendFormat("DPU read bandwidth: %u MB/s, budget: %u MB/s\n",
+                        total, exynosHWCControl.dpuBandwidthBudget);
+}
+
 void ExynosResourceManager::enableMPP(uint32_t physicalType, uint32_t physicalIndex,
                                       uint32_t logicalIndex, uint32_t enable) {
     mEnableMPPRequests.emplace_back(EnableMPPRequest(physicalType, physicalIndex,
@@ -2221,19 +3152,15 @@ void ExynosResourceManager::makeAcrylRestrictions(mpp_phycal_type_t type) {
 }
 
 mpp_phycal_type_t ExynosResourceManager::getPhysicalType(int ch) const {
-    for (auto mpp : mOtfMPPs) {
-        if (mpp->mChId == ch)
-            return static_cast<mpp_phycal_type_t>(mpp->mPhysicalType);
-    }
-    return MPP_P_TYPE_MAX;
+    if ((ch < 0) || ((size_t)ch >= mOtfMPPsByChannel.size()) || (mOtfMPPsByChannel[ch] == nullptr))
+        return MPP_P_TYPE_MAX;
+    return static_cast<mpp_phycal_type_t>(mOtfMPPsByChannel[ch]->mPhysicalType);
 }
 
 ExynosMPP *ExynosResourceManager::getOtfMPPWithChannel(int ch) {
-    for (auto mpp : mOtfMPPs) {
-        if (mpp->mChId == ch)
-            return mpp;
-    }
-    return nullptr;
+    if ((ch < 0) || ((size_t)ch >= mOtfMPPsByChannel.size()))
+        return nullptr;
+    return mOtfMPPsByChannel[ch];
 }
 
 void ExynosResourceManager::updateRestrictions() {
@@ -2277,6 +3204,62 @@ void ExynosResourceManager::updateRestrictions() {
     }
 }
 
+void ExynosResourceManager::applyRestrictionBlob() {
+    if (!mRestrictionBlob.isOpened()) {
+        int32_t ret = mRestrictionBlob.open();
+        if (ret < 0) {
+            if (ret != -ENOENT)
+                HWC_LOGE_NODISP("%s:: failed to open restriction blob (%d)", __func__, ret);
+            return;
+        }
+    }
+
+    uint32_t num = 0;
+    const restriction_blob_feature *features =
+        mRestrictionBlob.getEntries<restriction_blob_feature>(RESTRICTION_BLOB_FEATURE, num);
+    for (uint32_t i = 0; i < num; i++) {
+        for (auto &feature : feature_table) {
+            if (feature.hwType == features[i].hwType)
+                feature.attr = features[i].attr;
+        }
+        auto setFeature = [&](ExynosMPPVector &mppList) {
+            for (auto mpp : mppList) {
+                if (mpp->mPhysicalType == features[i].hwType) {
+                    mpp->mAttr = features[i].attr;
+                    mpp->invalidateSupportedMemo();
+                }
+            }
+        };
+        setFeature(mOtfMPPs);
+        setFeature(mM2mMPPs);
+    }
+
+    const restriction_blob_size *sizes =
+        mRestrictionBlob.getEntries<restriction_blob_size>(RESTRICTION_BLOB_SIZE, num);
+    for (uint32_t i = 0; i < num; i++) {
+        if (sizes[i].classification >= RESTRICTION_MAX) {
+            HWC_LOGE_NODISP("%s:: invalid classification(%d) of mpp(%d)", __func__,
+                            sizes[i].classification, sizes[i].hwType);
+            continue;
+        }
+        addSizeRestrictions(sizes[i].hwType, sizes[i].src, sizes[i].dst,
+                            static_cast<restriction_classification>(sizes[i].classification));
+    }
+
+    const restriction_blob_ppc *ppcs =
+        mRestrictionBlob.getEntries<restriction_blob_ppc>(RESTRICTION_BLOB_PPC, num);
+    if (num == 0)
+        return;
+    for (uint32_t i = 0; i < num; i++)
+        memcpy(ppc_table_map[ppcs[i].ppcIndex].ppcList, ppcs[i].ppcList,
+               sizeof(ppcs[i].ppcList));
+    /* ppc_table_map of ExynosMPP is shared by all MPPs */
+    if (mM2mMPPs.size())
+        mM2mMPPs[0]->updatePPCTable(ppc_table_map);
+    else if (mOtfMPPs.size())
+        mOtfMPPs[0]->updatePPCTable(ppc_table_map);
+}
+
 uint32_t ExynosResourceManager::getFeatureTableSize() const {
     return sizeof(feature_table) / sizeof(feature_support_t);
 }
@@ -2436,6 +3419,21 @@ ExynosMPP *ExynosResourceManager::getHDR10OtfMPP() {
     return NULL;
 }
 
+bool ExynosResourceManager::canCompressM2mOutImage(ExynosDisplay *display, exynos_image &img) {
+    /* The compression of the M2M outputs follows the one of the composition target */
+    if (display->mExynosCompositionInfo.mCompressionInfo.type != img.compressionInfo.type)
+        return false;
+    if (getDrmMode(img.usageFlags) != NO_DRM)
+        return false;
+
+    bool m2mSupported = std::any_of(mM2mMPPs.begin(), mM2mMPPs.end(),
+                                    [&img](auto m) { return m->isSupportedDstCompression(img); });
+    bool otfSupported = std::any_of(mOtfMPPs.begin(), mOtfMPPs.end(),
+                                    [&img](auto m) { return m->isSupportedCompression(img); });
+
+    return m2mSupported && otfSupported;
+}
+
 void ExynosResourceManager::setM2mTargetCompression() {
     for (size_t i = 0; i < mM2mMPPs.size(); i++) {
         if (mM2mMPPs[i]->mLogicalType == MPP_LOGICAL_G2D_RGB) {
@@ -2640,6 +3638,7 @@ void ExynosResourceManager::updateMPPFeature(bool updateOtfMPP) {
         for (auto &m2mMPP : mM2mMPPs) {
             if (m2mMPP->mPhysicalType == feature.hwType) {
                 m2mMPP->mAttr = feature.attr;
+                m2mMPP->invalidateSupportedMemo();
                 HDEBUGLOGD(eDebugAttrSetting, "Attr:%s:  0x%" PRIx64 "",
                            m2mMPP->mName.string(), feature.attr);
             }
@@ -2654,6 +3653,7 @@ void ExynosResourceManager::updateMPPFeature(bool updateOtfMPP) {
         for (auto &otfMPP : mOtfMPPs) {
             if (otfMPP->mPhysicalType == feature.hwType) {
                 otfMPP->mAttr = feature.attr;
+                otfMPP->invalidateSupportedMemo();
                 HDEBUGLOGD(eDebugAttrSetting, "Attr:%s:  0x%" PRIx64 "",
                            otfMPP->mName.string(), feature.attr);
             }
@@ -2731,6 +3731,7 @@ void ExynosResourceManager::setDPUFeature(ExynosMPP *mpp, uint64_t dpuAttr) {
         attr |= it->second;
 
     mpp->mAttr = attr;
+    mpp->invalidateSupportedMemo();
     HDEBUGLOGD(eDebugAttrSetting, "Attr:%s: 0x%" PRIx64 "",
                mpp->mName.string(), attr);
 }
@@ -2768,7 +3769,8 @@ bool ExynosResourceManager::isAssignable(ExynosMPP *candidateMPP, ExynosDisplay
                                          struct exynos_image &src, struct exynos_image &dst, ExynosMPPSource *mppSrc) {
     bool ret = true;
 
-    float totalUsedCapacity = getResourceUsedCapa(*candidateMPP);
+    float totalUsedCapacity = getResourceUsedCapa(*candidateMPP) +
+                              getM2mCapaReservedByOthers(*candidateMPP, display);
     ret = candidateMPP->isAssignable(display->mDisplayInfo, src, dst, totalUsedCapacity);
 
     if ((ret) && (mppSrc != nullptr)) {
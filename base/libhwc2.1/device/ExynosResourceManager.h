@@ -21,11 +21,13 @@
 #ifndef _EXYNOSRESOURCEMANAGER_H
 #define _EXYNOSRESOURCEMANAGER_H
 
+#include <atomic>
 #include <vector>
 #include "ExynosDisplay.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosMPPModule.h"
 #include "ExynosResourceRestriction.h"
+#include "ExynosRestrictionBlob.h"
 
 using namespace android;
 
@@ -34,8 +36,39 @@ class ExynosMPP;
 
 #define ASSIGN_RESOURCE_TRY_COUNT 100
 
+/*
+ * DPU read bandwidth model. A SoC defines DPU_READ_BW_BUDGET_MBPS in
+ * ExynosResourceRestriction.h to enable the bandwidth check. The ratios(%)
+ * are the read bytes of the compressed buffers to the uncompressed ones.
+ */
+#ifndef DPU_READ_BW_BUDGET_MBPS
+#define DPU_READ_BW_BUDGET_MBPS 0
+#endif
+#ifndef DPU_BW_AFBC_RATIO
+#define DPU_BW_AFBC_RATIO 60
+#endif
+#ifndef DPU_BW_SBWC_RATIO
+#define DPU_BW_SBWC_RATIO 70
+#endif
+
 #define MAX_OVERLAY_LAYER_NUM 30
 
+/* otfMPP that is not used for this number of frames can be gated */
+#define MPP_POWER_GATING_IDLE_FRAMES 120
+/* Number of ungated otfMPPs over the layer number */
+#define MPP_POWER_GATING_SPARE_NUM 1
+
+/* Costs used by the assignment solver */
+enum {
+    eSolverCostDirect = 0,
+    eSolverCostScaled = 1,
+    eSolverCostM2m = 10,
+    /* Additional layer in the client composition */
+    eSolverCostClientLayer = 10,
+    /* GLES composition pass */
+    eSolverCostClient = 100,
+};
+
 struct EnableMPPRequest {
     EnableMPPRequest(uint32_t _physicalType, uint32_t _physicalIndex,
                      uint32_t _logicalIndex, uint32_t _enable) : physicalType(_physicalType), physicalIndex(_physicalIndex),
@@ -126,6 +159,12 @@ class ExynosResourceManager {
     static void enableMPP(uint32_t physicalType, uint32_t physicalIndex, uint32_t logicalIndex, uint32_t enable);
     static bool applyEnableMPPRequests();
     int32_t updateSupportedMPPFlag(ExynosDisplay *display);
+    /*
+     * Memoizes the MPP checks of updateSupportedMPPFlag() for the changed
+     * layers of @display before its validation
+     */
+    void prefetchSupportedMPPFlag(ExynosDisplay *display);
+    int32_t preUpdateSupportedMPPFlag(ExynosDisplay *display);
     int32_t resetResources();
     virtual int32_t preAssignResources();
     /* This function should be implemented by module */
@@ -139,14 +178,35 @@ class ExynosResourceManager {
 
     virtual int32_t assignLayer(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
                                 exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP, uint32_t &overlayInfo);
+    int32_t assignLayerWithPrevInfo(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                                    exynos_image &src_img, exynos_image &dst_img,
+                                    exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP);
+    int32_t assignStaticCachedLayer(ExynosDisplay *display, ExynosLayer *layer,
+                                    exynos_image &src_img, exynos_image &dst_img,
+                                    ExynosMPP **m2mMPP);
+    int32_t assignFoldedDimLayer(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                                 exynos_image &src_img, exynos_image &dst_img,
+                                 ExynosMPP **m2mMPP);
+    int32_t solveOtfAssignment(ExynosDisplay *display);
+    int32_t assignLowPowerComposition(ExynosDisplay *display);
 
     /* If product needs specific assign policy, describe at their module codes */
     virtual int32_t checkExceptionScenario(uint64_t &geometryFlag);
     virtual uint32_t getExceptionScenarioFlag(ExynosMPP *mpp);
+    void updateMPPPowerGating();
 
     virtual int32_t assignWindow(ExynosDisplay *display);
     int32_t updateResourceState();
     static float getResourceUsedCapa(ExynosMPP &mpp);
+    bool hasEnoughM2mCapa(ExynosMPP *mpp, ExynosDisplay *display,
+                          struct exynos_image &src, struct exynos_image &dst);
+    void updateM2mCapaShares(ExynosDisplay *display);
+    void dumpM2mCapaShares(String8 &result);
+    void updateMPPUsageStats(ExynosDisplay *display);
+    void dumpMPPUsageStats(String8 &result);
+    static uint64_t getDpuReadBandwidth(const exynos_image &img, uint32_t fps);
+    int32_t checkDpuBandwidth(ExynosDisplay *display);
+    void dumpDpuBandwidth(String8 &result);
     int32_t updateExynosComposition(ExynosDisplay *display);
     int32_t updateClientComposition(ExynosDisplay *display);
     int32_t getCandidateM2mMPPOutImages(ExynosDisplay *display,
@@ -164,6 +224,8 @@ class ExynosResourceManager {
 
     virtual void makeM2MRestrictions();
     virtual void makeAcrylRestrictions(mpp_phycal_type_t type);
+    /* m2mMPPs are not assigned until makeM2MRestrictions() of the deferred init */
+    std::atomic<bool> mM2mRestrictionsReady{true};
     void addFormatRestrictions(restriction_key_t restrictionNode);
     void addSizeRestrictions(uint32_t mppId,
                              restriction_size src_size,
@@ -176,6 +238,9 @@ class ExynosResourceManager {
     void setDPUFeature(ExynosMPP *mpp, uint64_t dpuAttr);
 
     void updateRestrictions();
+    /* Overrides the compiled-in tables with the blob of RESTRICTION_BLOB_PATH */
+    void applyRestrictionBlob();
+    ExynosRestrictionBlob mRestrictionBlob;
     virtual void setVirtualOtfMPPsRestrictions() { return; };
 
     mpp_phycal_type_t getPhysicalType(int ch) const;
@@ -193,6 +258,8 @@ class ExynosResourceManager {
 
     virtual bool hasHDR10PlusMPP();
     ExynosMPP *getHDR10OtfMPP();
+    /* Whether an M2M can write @img compressed and a DPP can read it */
+    bool canCompressM2mOutImage(ExynosDisplay *display, exynos_image &img);
     virtual void setM2mTargetCompression();
 
     virtual bool useCameraException() { return false; };
@@ -238,9 +305,26 @@ class ExynosResourceManager {
     static std::vector<EnableMPPRequest> mEnableMPPRequests;
     android::Vector<ExynosDisplay *> mDisplays;
     std::map<uint32_t, ExynosDisplay *> mDisplayMap;
+    /* otfMPP of each DPP channel, indexed by mChId */
+    std::vector<ExynosMPP *> mOtfMPPsByChannel;
+    /* Union of mLogicalType of mOtfMPPs, to be masked with mSupportedMPPFlag */
+    uint32_t mOtfLogicalTypes = 0;
     DeviceResourceInfo mDeviceInfo;
     bool mDeviceSupportWCG = false;
 
+    /* Capacity of m2mMPP that is reserved for each display */
+    struct M2mCapaShare {
+        float demand = 0;
+        float shortage = 0;
+        float budget = 0;
+    };
+    /* [physicalType][displayId] */
+    std::map<uint32_t, std::map<uint32_t, M2mCapaShare>> mM2mCapaShares;
+    float getDisplayUsedCapa(uint32_t physicalType, uint32_t displayId);
+    float getM2mCapaWeight(ExynosDisplay *display);
+    float getM2mCapaReservedByOthers(ExynosMPP &mpp, ExynosDisplay *display);
+    void rebalanceM2mCapa(uint32_t physicalType, float capacity);
+
   public:
     virtual bool isHWResourceAvailable(ExynosDisplay __unused *display, ExynosMPP __unused *currentMPP, ExynosMPPSource __unused *mppSrc) { return true; };
     virtual uint32_t setDisplaysTDMInfo() { return 0; };
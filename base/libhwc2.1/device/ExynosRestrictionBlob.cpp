@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <log/log.h>
+#include "ExynosRestrictionBlob.h"
+
+static uint32_t restriction_blob_entry_size(uint32_t type) {
+    switch (type) {
+    case RESTRICTION_BLOB_PPC:
+        return sizeof(restriction_blob_ppc);
+    case RESTRICTION_BLOB_FEATURE:
+        return sizeof(restriction_blob_feature);
+    case RESTRICTION_BLOB_SIZE:
+        return sizeof(restriction_blob_size);
+    default:
+        return 0;
+    }
+}
+
+int32_t ExynosRestrictionBlob::open(const char *path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(restriction_blob_header))) {
+        ALOGE("%s: invalid restriction blob %s", __func__, path);
+        ::close(fd);
+        return -EINVAL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: failed to map %s: %s", __func__, path, strerror(errno));
+        return -ENOMEM;
+    }
+
+    mData = static_cast<const uint8_t *>(data);
+    mSize = st.st_size;
+
+    int32_t ret = parse();
+    if (ret != 0) {
+        ALOGE("%s: invalid restriction blob %s (%d)", __func__, path, ret);
+        close();
+        return ret;
+    }
+
+    ALOGI("%s: restriction blob %s: ppc(%u), feature(%u), size(%u)", __func__, path,
+          mSections[RESTRICTION_BLOB_PPC].entry_num, mSections[RESTRICTION_BLOB_FEATURE].entry_num,
+          mSections[RESTRICTION_BLOB_SIZE].entry_num);
+
+    return 0;
+}
+
+void ExynosRestrictionBlob::close() {
+    if (mData != nullptr)
+        munmap(const_cast<uint8_t *>(mData), mSize);
+    mData = nullptr;
+    mSize = 0;
+    memset(mSections, 0, sizeof(mSections));
+}
+
+int32_t ExynosRestrictionBlob::parse() {
+    const restriction_blob_header *header =
+        reinterpret_cast<const restriction_blob_header *>(mData);
+
+    if ((header->magic != RESTRICTION_BLOB_MAGIC) || (header->version != RESTRICTION_BLOB_VERSION))
+        return -EPROTO;
+    if (header->size != mSize)
+        return -EINVAL;
+
+    const size_t sectionsEnd =
+        sizeof(*header) + (size_t)header->section_num * sizeof(restriction_blob_section);
+    if (sectionsEnd > mSize)
+        return -EINVAL;
+
+    const restriction_blob_section *sections =
+        reinterpret_cast<const restriction_blob_section *>(mData + sizeof(*header));
+    for (uint32_t i = 0; i < header->section_num; i++) {
+        const restriction_blob_section &section = sections[i];
+
+        /* Unknown sections are skipped */
+        if ((section.type == 0) || (section.type >= RESTRICTION_BLOB_SECTION_MAX))
+            continue;
+        if ((mSections[section.type].entry_size != 0) ||
+            (section.entry_size != restriction_blob_entry_size(section.type)) ||
+            (section.offset & 7) || (section.offset < sectionsEnd) ||
+            ((uint64_t)section.offset + (uint64_t)section.entry_size * section.entry_num > mSize))
+            return -EINVAL;
+
+        mSections[section.type] = section;
+    }
+
+    return 0;
+}
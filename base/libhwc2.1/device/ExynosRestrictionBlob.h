@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSRESTRICTIONBLOB_H
+#define _EXYNOSRESTRICTIONBLOB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include "ExynosHWCTypes.h"
+#include "ExynosMPP.h"
+
+#define RESTRICTION_BLOB_PATH "/vendor/etc/hwc_restrictions.bin"
+#define RESTRICTION_BLOB_MAGIC 0x48525354 /* "HRST" */
+#define RESTRICTION_BLOB_VERSION 1
+
+/*
+ * Binary overrides of the restriction tables of ExynosResourceRestriction.h
+ *
+ * The blob is a header followed by the section descriptors and the
+ * entries of the sections. Entries are used in place from the read-only
+ * mapping of the file. An entry of a section replaces the compiled-in
+ * value of the same key, so the blob has only the values tuned in the
+ * field. The entry size of a section should be the size of its entry
+ * struct of this version, and a blob of another version is not used.
+ * All the values are in the byte order of the device.
+ */
+enum restriction_blob_section_type {
+    RESTRICTION_BLOB_PPC = 1,     /* restriction_blob_ppc */
+    RESTRICTION_BLOB_FEATURE = 2, /* restriction_blob_feature */
+    RESTRICTION_BLOB_SIZE = 3,    /* restriction_blob_size */
+    RESTRICTION_BLOB_SECTION_MAX
+};
+
+struct restriction_blob_header {
+    uint32_t magic;
+    uint32_t version;
+    /* of the whole blob */
+    uint32_t size;
+    uint32_t section_num;
+};
+
+struct restriction_blob_section {
+    uint32_t type;
+    /* from the start of the blob, aligned to 8 bytes */
+    uint32_t offset;
+    uint32_t entry_size;
+    uint32_t entry_num;
+};
+
+/* ppc of every scale bucket of a PPC_IDX of ppc_table_map */
+struct restriction_blob_ppc {
+    uint32_t ppcIndex;
+    float ppcList[PPC_SCALE_MAX];
+};
+
+/* attr of a hwType of feature_table */
+struct restriction_blob_feature {
+    uint32_t hwType;
+    uint32_t reserved;
+    uint64_t attr;
+};
+
+/* src and dst size restrictions of a hwType for a restriction_classification */
+struct restriction_blob_size {
+    uint32_t hwType;
+    uint32_t classification;
+    restriction_size_t src;
+    restriction_size_t dst;
+};
+
+static_assert(std::is_trivially_copyable<restriction_size_t>::value,
+              "restriction_size_t should be read from the blob in place");
+
+class ExynosRestrictionBlob {
+  public:
+    ExynosRestrictionBlob(){};
+    ~ExynosRestrictionBlob() { close(); };
+
+    /* Maps and checks the blob, -ENOENT if there is no blob at @path */
+    int32_t open(const char *path = RESTRICTION_BLOB_PATH);
+    void close();
+    bool isOpened() const { return mData != nullptr; };
+
+    /* Entries of @type, nullptr and 0 if the blob has no such section */
+    template <typename T>
+    const T *getEntries(restriction_blob_section_type type, uint32_t &outNum) const {
+        outNum = 0;
+        if (mSections[type].entry_size != sizeof(T))
+            return nullptr;
+        outNum = mSections[type].entry_num;
+        return reinterpret_cast<const T *>(mData + mSections[type].offset);
+    };
+
+  private:
+    int32_t parse();
+
+    const uint8_t *mData = nullptr;
+    size_t mSize = 0;
+    restriction_blob_section mSections[RESTRICTION_BLOB_SECTION_MAX] = {};
+};
+
+#endif
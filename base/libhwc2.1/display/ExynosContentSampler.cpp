@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include <hardware/hwcomposer2.h>
+#include <inttypes.h>
+#include <sync/sync.h>
+#include <sys/mman.h>
+#include <utils/Trace.h>
+#include "ExynosContentSampler.h"
+#include "ExynosGraphicBuffer.h"
+#include "ExynosHWCDebug.h"
+#include "ExynosHWCHelper.h"
+
+using namespace vendor::graphics;
+
+ExynosContentSampler::~ExynosContentSampler() {
+    disable();
+}
+
+bool ExynosContentSampler::isFormatSupported(int32_t format) {
+    switch (format) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+    case HAL_PIXEL_FORMAT_RGBA_1010102:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int32_t ExynosContentSampler::enable(int32_t format, uint32_t width, uint32_t height,
+                                     uint8_t componentMask, uint64_t maxFrames) {
+    if (!isFormatSupported(format) || (width == 0) || (height == 0)) {
+        ALOGE("%s:: display[%d] unsupported readback format(0x%x), %dx%d",
+              __func__, mDisplayId, format, width, height);
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+
+    /* Sampling is restarted with new parameters */
+    disable();
+
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    uint64_t usage = static_cast<uint64_t>(GRALLOC1_CONSUMER_USAGE_HWCOMPOSER |
+                                           GRALLOC1_CONSUMER_USAGE_CPU_READ_OFTEN);
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &buffer : mBuffers) {
+        uint32_t stride = 0;
+        status_t error = gAllocator.allocate(width, height, format, 1, usage,
+                                             &buffer.handle, &stride, "HWC_sampler");
+        if ((error != NO_ERROR) || (buffer.handle == nullptr)) {
+            ALOGE("%s:: display[%d] failed to allocate buffer(%dx%d): %d",
+                  __func__, mDisplayId, width, height, error);
+            buffer.handle = nullptr;
+            freeBuffers();
+            return HWC2_ERROR_NO_RESOURCES;
+        }
+    }
+
+    if (mWorkerPool == nullptr)
+        mWorkerPool = std::make_unique<ExynosWorkerPool>(
+            "hwc_sampler_" + std::to_string(mDisplayId), 1);
+
+    mFormat = format;
+    mComponentMask = componentMask;
+    mMaxFrames = maxFrames;
+    mPresentCount = 0;
+    mPendingFrames = 0;
+    mSampledCount = 0;
+    mFailCount = 0;
+    mSamples.clear();
+    mEnabled = true;
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosContentSampler::disable() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mEnabled)
+            return;
+        mEnabled = false;
+    }
+
+    /* Reduction jobs are using buffers */
+    if (mWorkerPool != nullptr)
+        mWorkerPool->wait();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    freeBuffers();
+    mSamples.clear();
+}
+
+bool ExynosContentSampler::isEnabled() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEnabled;
+}
+
+void ExynosContentSampler::freeBuffers() {
+    ExynosGraphicBufferMapper &gMapper(ExynosGraphicBufferMapper::get());
+    for (auto &buffer : mBuffers) {
+        if (buffer.handle != nullptr)
+            gMapper.freeBuffer(buffer.handle);
+        buffer = {};
+    }
+}
+
+buffer_handle_t ExynosContentSampler::dequeueFrame(bool readbackAvailable) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled)
+        return nullptr;
+
+    mPendingFrames++;
+    if (!readbackAvailable || ((mPresentCount++ % kSampleInterval) != 0))
+        return nullptr;
+
+    for (auto &buffer : mBuffers) {
+        if (!buffer.busy) {
+            buffer.busy = true;
+            return buffer.handle;
+        }
+    }
+    /* Previous frames are still being reduced */
+    return nullptr;
+}
+
+void ExynosContentSampler::queueFrame(buffer_handle_t handle, int32_t fence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t index = 0;
+    for (; index < kBufferNum; index++) {
+        if (mBuffers[index].handle == handle)
+            break;
+    }
+
+    if (!mEnabled || (index == kBufferNum) || (fence < 0)) {
+        if (index < kBufferNum)
+            mBuffers[index].busy = false;
+        if (fence >= 0)
+            hwcFdClose(fence);
+        mFailCount++;
+        return;
+    }
+
+    uint64_t frames = mPendingFrames;
+    nsecs_t timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    mPendingFrames = 0;
+    mWorkerPool->submit([this, index, fence, frames, timestamp]() {
+        reduce(index, fence, frames, timestamp);
+    });
+}
+
+void ExynosContentSampler::reduce(uint32_t index, int32_t fence, uint64_t frames,
+                                  nsecs_t timestamp) {
+    ATRACE_CALL();
+    Sample sample;
+    sample.timestamp = timestamp;
+    sample.frames = frames;
+
+    bool done = (sync_wait(fence, 1000) >= 0);
+    hwcFdClose(fence);
+    if (!done)
+        ALOGE("%s:: display[%d] writeback is not done", __func__, mDisplayId);
+    else
+        done = readHistogram(mBuffers[index].handle, sample.histogram);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBuffers[index].busy = false;
+    if (!done) {
+        /* Frames are counted with the next sample */
+        mPendingFrames += frames;
+        mFailCount++;
+        return;
+    }
+    mSamples.push_back(sample);
+    while (mSamples.size() > kHistorySize)
+        mSamples.pop_front();
+    mSampledCount++;
+}
+
+bool ExynosContentSampler::readHistogram(buffer_handle_t handle, Histogram &histogram) {
+    ExynosGraphicBufferMeta gmeta(handle);
+    uint32_t size = gmeta.stride * gmeta.vstride * formatToBpp(gmeta.format) / 8;
+    void *data = mmap(0, size, PROT_READ, MAP_SHARED, gmeta.fd, 0);
+    if ((data == MAP_FAILED) || (data == NULL)) {
+        ALOGE("%s:: display[%d] fail to mmap", __func__, mDisplayId);
+        return false;
+    }
+
+    for (uint32_t y = 0; y < gmeta.height; y += kPixelStep) {
+        const uint32_t *line = static_cast<const uint32_t *>(data) + (size_t)y * gmeta.stride;
+        for (uint32_t x = 0; x < gmeta.width; x += kPixelStep) {
+            uint32_t pixel = line[x];
+            uint32_t c[kComponentNum];
+            if (mFormat == HAL_PIXEL_FORMAT_RGBA_1010102) {
+                c[0] = (pixel >> 2) & 0xff;
+                c[1] = (pixel >> 12) & 0xff;
+                c[2] = (pixel >> 22) & 0xff;
+                c[3] = (pixel >> 30) * 0x55;
+            } else if (mFormat == HAL_PIXEL_FORMAT_BGRA_8888) {
+                c[0] = (pixel >> 16) & 0xff;
+                c[1] = (pixel >> 8) & 0xff;
+                c[2] = pixel & 0xff;
+                c[3] = pixel >> 24;
+            } else {
+                c[0] = pixel & 0xff;
+                c[1] = (pixel >> 8) & 0xff;
+                c[2] = (pixel >> 16) & 0xff;
+                c[3] = (mFormat == HAL_PIXEL_FORMAT_RGBX_8888) ? 0xff : (pixel >> 24);
+            }
+            for (uint32_t i = 0; i < kComponentNum; i++) {
+                if (mComponentMask & (1 << i))
+                    histogram[i][c[i]]++;
+            }
+        }
+    }
+    munmap(data, size);
+    return true;
+}
+
+int32_t ExynosContentSampler::getSample(uint64_t maxFrames, uint64_t timestamp,
+                                        uint64_t *outFrameCount,
+                                        int32_t outSamplesSize[kComponentNum],
+                                        uint64_t *outSamples[kComponentNum]) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled)
+        return HWC2_ERROR_UNSUPPORTED;
+
+    for (uint32_t i = 0; i < kComponentNum; i++)
+        outSamplesSize[i] = (mComponentMask & (1 << i)) ? kBinNum : 0;
+    if (outSamples == nullptr)
+        return HWC2_ERROR_NONE;
+
+    if ((maxFrames == 0) || ((mMaxFrames != 0) && (maxFrames > mMaxFrames)))
+        maxFrames = mMaxFrames;
+
+    for (uint32_t i = 0; i < kComponentNum; i++) {
+        if ((outSamples[i] != nullptr) && outSamplesSize[i])
+            memset(outSamples[i], 0, sizeof(uint64_t) * kBinNum);
+    }
+
+    /* Newest samples first, up to maxFrames frames presented after timestamp */
+    uint64_t frameCount = mPendingFrames;
+    for (auto it = mSamples.rbegin(); it != mSamples.rend(); it++) {
+        if (((nsecs_t)timestamp > it->timestamp) ||
+            ((maxFrames != 0) && (frameCount >= maxFrames)))
+            break;
+        frameCount += it->frames;
+        for (uint32_t i = 0; i < kComponentNum; i++) {
+            if ((outSamples[i] == nullptr) || (outSamplesSize[i] == 0))
+                continue;
+            for (uint32_t bin = 0; bin < kBinNum; bin++)
+                outSamples[i][bin] += it->histogram[i][bin];
+        }
+    }
+    if ((maxFrames != 0) && (frameCount > maxFrames))
+        frameCount = maxFrames;
+    *outFrameCount = frameCount;
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosContentSampler::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled)
+        return;
+
+    result.appendFormat("Content sampling: format(0x%x), mask(0x%x), maxFrames(%" PRIu64 "), "
+                        "presented(%" PRIu64 "), sampled(%" PRIu64 "), failed(%" PRIu64 ")\n",
+                        mFormat, mComponentMask, mMaxFrames, mPresentCount, mSampledCount,
+                        mFailCount);
+}
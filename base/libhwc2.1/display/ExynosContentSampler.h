@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSCONTENTSAMPLER_H
+#define _EXYNOSCONTENTSAMPLER_H
+
+#include <cutils/native_handle.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "ExynosWorkerPool.h"
+
+using namespace android;
+
+/*
+ * Histograms of displayed content for displayed content sampling.
+ * Every kSampleInterval frames, the frame is written back to an internal
+ * buffer and reduced to per-component histograms on a worker thread,
+ * so that neither the present path nor GPU has to read the frame.
+ */
+class ExynosContentSampler {
+  public:
+    static constexpr uint32_t kComponentNum = 4;
+    static constexpr uint32_t kBinNum = 256;
+    static constexpr uint32_t kBufferNum = 2;
+    static constexpr uint32_t kSampleInterval = 4;
+    /* Only every kPixelStep-th pixel of every kPixelStep-th line is counted */
+    static constexpr uint32_t kPixelStep = 4;
+    static constexpr uint32_t kHistorySize = 32;
+
+    ExynosContentSampler(uint32_t displayId) : mDisplayId(displayId){};
+    ~ExynosContentSampler();
+
+    static bool isFormatSupported(int32_t format);
+
+    int32_t enable(int32_t format, uint32_t width, uint32_t height,
+                   uint8_t componentMask, uint64_t maxFrames);
+    void disable();
+    bool isEnabled();
+
+    /*
+     * For present path, it is called for every presented frame.
+     * Buffer is returned if this frame should be written back.
+     */
+    buffer_handle_t dequeueFrame(bool readbackAvailable);
+    /* fence is owned by sampler after this call, -1 if writeback failed */
+    void queueFrame(buffer_handle_t buffer, int32_t fence);
+
+    /* samples[i] can be null to get samplesSize[i] */
+    int32_t getSample(uint64_t maxFrames, uint64_t timestamp, uint64_t *outFrameCount,
+                      int32_t outSamplesSize[kComponentNum], uint64_t *outSamples[kComponentNum]);
+
+    void dump(String8 &result);
+
+  private:
+    typedef std::array<std::array<uint32_t, kBinNum>, kComponentNum> Histogram;
+    struct Sample {
+        nsecs_t timestamp = 0;
+        /* Presented frames this sample stands for */
+        uint64_t frames = 0;
+        Histogram histogram = {};
+    };
+    struct Buffer {
+        buffer_handle_t handle = nullptr;
+        bool busy = false;
+    };
+
+    void reduce(uint32_t index, int32_t fence, uint64_t frames, nsecs_t timestamp);
+    bool readHistogram(buffer_handle_t handle, Histogram &histogram);
+    void freeBuffers();
+
+    uint32_t mDisplayId;
+    std::mutex mMutex;
+    bool mEnabled = false;
+    int32_t mFormat = 0;
+    uint8_t mComponentMask = 0;
+    uint64_t mMaxFrames = 0;
+    std::array<Buffer, kBufferNum> mBuffers;
+    uint64_t mPresentCount = 0;
+    /* Presented frames since the last sampled frame */
+    uint64_t mPendingFrames = 0;
+    std::deque<Sample> mSamples;
+    uint64_t mSampledCount = 0;
+    uint64_t mFailCount = 0;
+
+    /* Declared last to drain jobs before other members are destroyed */
+    std::unique_ptr<ExynosWorkerPool> mWorkerPool;
+};
+
+#endif
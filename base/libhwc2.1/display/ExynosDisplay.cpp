@@ -22,6 +22,7 @@
 #include <utils/CallStack.h>
 #include <hardware/hwcomposer_defs.h>
 #include <android/sync.h>
+#include <algorithm>
 #include <cmath>
 
 #include <map>
@@ -30,11 +31,19 @@
 #include "ExynosLayer.h"
 #include "exynos_format.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosLatencyStats.h"
+#include "ExynosPerfettoTrace.h"
 #include "TraceUtils.h"
 
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef USE_LAYER_DUMP_LZ4
+#include <lz4frame.h>
+#endif
+
 #include "ExynosGraphicBuffer.h"
 
 /**
@@ -57,6 +66,19 @@ int ExynosSortedLayer::compare(ExynosLayer *const *lhs, ExynosLayer *const *rhs)
     return left->mZOrder > right->mZOrder;
 }
 
+ssize_t ExynosSortedLayer::add(ExynosLayer *item) {
+    size_t low = 0;
+    size_t high = size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (array()[mid]->mZOrder > item->mZOrder)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return insertAt(item, low);
+}
+
 ssize_t ExynosSortedLayer::remove(const ExynosLayer *item) {
     for (size_t i = 0; i < size(); i++) {
         if (array()[i] == item) {
@@ -68,7 +90,12 @@ ssize_t ExynosSortedLayer::remove(const ExynosLayer *item) {
 }
 
 status_t ExynosSortedLayer::vector_sort() {
-    return sort(compare);
+    /* zOrder is not changed in most frames */
+    for (size_t i = 1; i < size(); i++) {
+        if (array()[i - 1]->mZOrder > array()[i]->mZOrder)
+            return sort(compare);
+    }
+    return NO_ERROR;
 }
 
 bool ExynosVsyncCallback::Callback(uint64_t timestamp) {
@@ -186,19 +213,120 @@ bool ExynosCompositionInfo::setTargetBuffer(
                                                      FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D, acquireFence);
     }
     mDataSpace = dataspace;
-    ExynosGraphicBufferMeta gmeta(handle);
 
-    BufInfo newBufInfo = BufInfo(gmeta.width, gmeta.height, gmeta.format,
-                                 gmeta.producer_usage, gmeta.consumer_usage);
+    const BufInfo &newBufInfo = getTargetBufferMeta(handle).bufInfo;
     bool bufChanged = (mBufInfo.isValid() && (mBufInfo != newBufInfo));
     mBufInfo = newBufInfo;
     return bufChanged;
 }
 
+const ExynosCompositionInfo::TargetBufferMeta &ExynosCompositionInfo::getTargetBufferMeta(
+    buffer_handle_t handle) {
+    static const TargetBufferMeta emptyMeta;
+    if (handle == NULL)
+        return emptyMeta;
+
+    /* The handle of a freed buffer can be reused by another buffer */
+    uint64_t bufferId = ExynosGraphicBufferMeta::get_buffer_id(handle);
+    for (auto &meta : mTargetBufferCache) {
+        if ((meta.handle == handle) && (meta.bufferId == bufferId))
+            return meta;
+    }
+
+    TargetBufferMeta &meta = mTargetBufferCache[mTargetBufferCacheNext];
+    mTargetBufferCacheNext = (mTargetBufferCacheNext + 1) % kTargetBufferCacheSize;
+
+    ExynosGraphicBufferMeta gmeta(handle);
+    meta.handle = handle;
+    meta.bufferId = bufferId;
+    meta.fd[0] = gmeta.fd;
+    meta.fd[1] = gmeta.fd1;
+    meta.fd[2] = gmeta.fd2;
+    meta.stride = gmeta.stride;
+    meta.vstride = gmeta.vstride;
+    meta.bufInfo = BufInfo(gmeta.width, gmeta.height, gmeta.format,
+                           gmeta.producer_usage, gmeta.consumer_usage);
+    meta.compressionInfo = getCompressionInfo(handle);
+    return meta;
+}
+
 void ExynosCompositionInfo::setCompressionType(uint32_t compressionType) {
     mCompressionInfo.type = compressionType;
 }
 
+void DamageRectSet::mergeAt(size_t dst, size_t src) {
+    mRects[dst] = expand(mRects[dst], mRects[src]);
+    mRects[src] = mRects[mNum - 1];
+    mNum--;
+}
+
+void DamageRectSet::add(const hwc_rect &rect) {
+    if (AREA(rect) == 0)
+        return;
+
+    mRects[mNum++] = rect;
+
+    /* Keep rects disjoint, a merged rect can overlap others again */
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; (i < mNum) && !merged; i++) {
+            for (size_t j = i + 1; j < mNum; j++) {
+                if (isOverlapped(mRects[i], mRects[j])) {
+                    mergeAt(i, j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (mNum <= kMaxRects)
+        return;
+
+    /* Merge the pair that adds the fewest clean pixels */
+    size_t bestI = 0, bestJ = 1;
+    int64_t bestWaste = INT64_MAX;
+    for (size_t i = 0; i < mNum; i++) {
+        for (size_t j = i + 1; j < mNum; j++) {
+            int64_t waste = AREA(expand(mRects[i], mRects[j])) -
+                            AREA(mRects[i]) - AREA(mRects[j]);
+            if (waste < bestWaste) {
+                bestWaste = waste;
+                bestI = i;
+                bestJ = j;
+            }
+        }
+    }
+    mergeAt(bestI, bestJ);
+    /* The union may overlap the remaining rects */
+    if (mNum > 0) {
+        hwc_rect last = mRects[--mNum];
+        add(last);
+    }
+}
+
+hwc_rect DamageRectSet::bound() const {
+    hwc_rect bound = {INT_MAX, INT_MAX, 0, 0};
+    for (size_t i = 0; i < mNum; i++)
+        bound = expand(bound, mRects[i]);
+    return bound;
+}
+
+int64_t DamageRectSet::area() const {
+    int64_t area = 0;
+    for (size_t i = 0; i < mNum; i++)
+        area += AREA(mRects[i]);
+    return area;
+}
+
+void DamageRectSet::dump(String8 &result) const {
+    result.appendFormat("DamageRectSet num: %zu, area: %" PRId64 "\n", mNum, area());
+    for (size_t i = 0; i < mNum; i++)
+        result.appendFormat("\t[%zu] %d, %d, %d, %d\n", i,
+                            mRects[i].left, mRects[i].top, mRects[i].right, mRects[i].bottom);
+}
+
 void ExynosCompositionInfo::dump(String8 &result) {
     result.appendFormat("CompositionInfo (%d)\n", mType);
     result.appendFormat("mHasCompositionLayer(%d)\n", mHasCompositionLayer);
@@ -321,6 +449,8 @@ ExynosDisplay::ExynosDisplay(DisplayIdentifier node)
     mHpdStatus = false;
 
     mLayerDumpManager = new LayerDumpManager(this);
+    mContentSampler = std::make_unique<ExynosContentSampler>(mDisplayId);
+    mFrameCrc = std::make_unique<ExynosFrameCrc>(mDisplayId);
 
     return;
 }
@@ -333,6 +463,9 @@ ExynosDisplay::~ExynosDisplay() {
         close(mDqeParcelFd);
 #endif
     delete mLayerDumpManager;
+    /* Timeout handler can not run after here */
+    std::lock_guard<std::mutex> lock(mIdleTimerMutex);
+    mIdleTimer.reset();
 }
 
 int ExynosDisplay::getId() {
@@ -385,6 +518,7 @@ void ExynosDisplay::initDisplay() {
     initCompositionInfo(mExynosCompositionInfo);
 
     mGeometryChanged = 0x0;
+    mValidateFingerprint = 0;
     mRenderingState = RENDERING_STATE_NONE;
     mCursorIndex = -1;
 
@@ -445,6 +579,7 @@ int32_t ExynosDisplay::destroyLayer(hwc2_layer_t outLayer,
         return HWC2_ERROR_BAD_LAYER;
 
     mLayers.remove((ExynosLayer *)outLayer);
+    mLayerMap.erase(outLayer);
     mDisplayInterface->onLayerDestroyed(outLayer);
 
     delete (ExynosLayer *)outLayer;
@@ -470,14 +605,13 @@ void ExynosDisplay::destroyLayers() {
             delete layer;
         }
     }
+    mLayerMap.clear();
 }
 
 ExynosLayer *ExynosDisplay::checkLayer(hwc2_layer_t addr, bool printError) {
-    ExynosLayer *temp = (ExynosLayer *)addr;
-    for (auto layer : mLayers) {
-        if (layer == temp)
-            return layer;
-    }
+    auto it = mLayerMap.find(addr);
+    if (it != mLayerMap.end())
+        return it->second;
 
     if (printError)
         DISPLAY_LOGE("HWC2 : %s wrong layer request, layer num(%zu)!", __func__, mLayers.size());
@@ -493,41 +627,45 @@ void ExynosDisplay::doPreProcessing(DeviceValidateInfo &validateInfo,
     int ret = 0;
     uint32_t selfRefresh = 0;
     unsigned int skipProcessing = 1;
-    bool hasSingleBuffer = false;
-    bool skipStaticLayers = true;
+    LayerSummary summary;
 
     getDisplayInfo(mDisplayInfo);
 
-    mHasHdr10PlusLayer = false;
-
+    summary.layerNum = mLayers.size();
     for (size_t i = 0; i < mLayers.size(); i++) {
-        mLayers[i]->updateDisplayInfo(mDisplayInfo);
+        ExynosLayer *layer = mLayers[i];
+        layer->updateDisplayInfo(mDisplayInfo);
 
-        buffer_handle_t handle = mLayers[i]->mLayerBuffer;
-        ExynosGraphicBufferMeta gmeta(handle);
+        buffer_handle_t handle = layer->mLayerBuffer;
+        /* Gralloc is read only when a new buffer is set */
+        const ExynosLayer::BufferMetaCache &meta = layer->getBufferMeta();
         /* TODO: This should be checked **/
         if ((handle != NULL) &&
 #ifdef GRALLOC_VERSION1
-            (gmeta.consumer_usage & ExynosGraphicBufferUsage::DAYDREAM_SINGLE_BUFFER_MODE))
+            (meta.consumerUsage & ExynosGraphicBufferUsage::DAYDREAM_SINGLE_BUFFER_MODE))
 #else
-            (gmeta.flags & BufferUsage::DAYDREAM_SINGLE_BUFFER_MODE))
+            (meta.consumerUsage & BufferUsage::DAYDREAM_SINGLE_BUFFER_MODE))
 #endif
         {
-            hasSingleBuffer = true;
+            summary.singleBufferLayerNum++;
         }
-        if (mLayers[i]->mCompositionType == HWC2_COMPOSITION_CLIENT)
-            skipStaticLayers = false;
+        if (layer->mCompositionType == HWC2_COMPOSITION_CLIENT)
+            summary.clientLayerNum++;
 
-        if (mLayers[i]->doPreProcess(validateInfo, geometryChanged) < 0) {
+        if (layer->doPreProcess(validateInfo, geometryChanged) < 0) {
             DISPLAY_LOGE("%s:: layer.doPreProcess() error, layer %zu", __func__, i);
         }
 
-        if (mLayers[i]->mIsHdr10PlusLayer)
-            mHasHdr10PlusLayer = true;
+        if (layer->mIsHdr10PlusLayer)
+            summary.hdr10PlusLayerNum++;
+        if (layer->mIsHdrLayer)
+            summary.hdrLayerNum++;
+        if (layer->mLastLayerBuffer != handle)
+            summary.updatedLayerNum++;
 
 #ifdef NUM_CAMERA_DPP_CHANEL_NUM
         /* camera exception scenario */
-        if (i == 0 && handle != NULL && isFormatYUV(gmeta.format) &&
+        if (i == 0 && handle != NULL && isFormatYUV(meta.format) &&
             validateInfo.useCameraException &&
             mLayers[i]->mOverlayPriority != ePriorityMax) {
             mLayers[i]->mOverlayPriority = ePriorityHigh;
@@ -539,10 +677,33 @@ void ExynosDisplay::doPreProcessing(DeviceValidateInfo &validateInfo,
 
         exynos_image srcImg;
         exynos_image dstImg;
-        mLayers[i]->setSrcExynosImage(&srcImg);
-        mLayers[i]->setDstExynosImage(&dstImg);
-        mLayers[i]->setExynosImage(srcImg, dstImg);
+        layer->setSrcExynosImage(&srcImg);
+        layer->setDstExynosImage(&dstImg);
+        layer->setExynosImage(srcImg, dstImg);
+
+        if (handle == NULL)
+            continue;
+        summary.bufferLayerNum++;
+        if (getDrmMode(meta.usage) != NO_DRM)
+            summary.drmLayerNum++;
+        if (srcImg.exynosFormat.isYUV())
+            summary.yuvLayerNum++;
+        /* YUV, scaled, plane alpha or color gamut change */
+        if (srcImg.exynosFormat.isYUV() ||
+            (srcImg.w != dstImg.w) || (srcImg.h != dstImg.h) ||
+            (srcImg.planeAlpha != 1.0f) ||
+            ((mColorMode != HAL_COLOR_MODE_NATIVE) &&
+             (srcImg.dataSpace != dstImg.dataSpace)))
+            summary.dynamicRecompBlockingLayerNum++;
+    }
+
+    {
+        Mutex::Autolock lock(mDRMutex);
+        mLayerSummary = summary;
     }
+    mHasHdr10PlusLayer = (summary.hdr10PlusLayerNum > 0);
+    bool hasSingleBuffer = (summary.singleBufferLayerNum > 0);
+    bool skipStaticLayers = (summary.clientLayerNum == 0);
 
     // Re-align layer priority for max overlay resources
     uint32_t numMaxPriorityLayers = 0;
@@ -594,6 +755,8 @@ void ExynosDisplay::doPreProcessing(DeviceValidateInfo &validateInfo,
     if (mUseDynamicRecomp && mDynamicRecompTimer)
         checkLayersForRevertingDR(geometryChanged);
 
+    updateStaticLayerCache(geometryChanged);
+
     /* Display info could be changed */
     getDisplayInfo(mDisplayInfo);
     for (size_t i = 0; i < mLayers.size(); i++) {
@@ -1116,6 +1279,15 @@ int32_t ExynosDisplay::configureHandle(ExynosLayer &layer, int fence_fd,
             cfg.src.w = mpp_dst_img.w;
             cfg.src.h = mpp_dst_img.h;
             cfg.format = mpp_dst_img.exynosFormat;
+            /* DPP reads the compression that m2mMPP wrote, not the one of the layer */
+            if ((layer.mMidImg.compressionInfo.type != COMP_TYPE_NONE) &&
+                (getCompressionInfo(handle).type == layer.mMidImg.compressionInfo.type)) {
+                cfg.compressionInfo = getCompressionInfo(handle);
+                cfg.comp_src = DPP_COMP_SRC_G2D;
+            } else {
+                cfg.compressionInfo.type = COMP_TYPE_NONE;
+                cfg.comp_src = DPP_COMP_SRC_NONE;
+            }
             cfg.acq_fence =
                 mFenceTracer.checkFenceDebug(mDisplayInfo.displayIdentifier, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, mpp_dst_img.acquireFenceFd);
 
@@ -1270,13 +1442,32 @@ int32_t ExynosDisplay::configureOverlay(ExynosLayer *layer,
 
         /* This will be closed by setReleaseFences() using config.acq_fence */
         layer->mAcquireFence = -1;
+
+        if (exynosHWCControl.fbPreImport &&
+            (layer->mM2mMPP == NULL) && (cfg.state == cfg.WIN_STATE_BUFFER))
+            layer->updatePreImportConfig(cfg);
+        else
+            layer->mPreImportValid = false;
     }
     return ret;
 }
+
+void ExynosDisplay::preImportLayerBuffer(ExynosLayer &layer) {
+    exynos_win_config_data config;
+
+    if ((mPlugState == false) ||
+        (layer.mExynosCompositionType != HWC2_COMPOSITION_DEVICE) ||
+        (layer.mM2mMPP != NULL))
+        return;
+
+    if (layer.getPreImportConfig(layer.mLayerBuffer, config))
+        mDisplayInterface->preImportBuffer(config);
+}
 int32_t ExynosDisplay::configureOverlay(ExynosCompositionInfo &compositionInfo) {
     int32_t windowIndex = compositionInfo.mWindowIndex;
     buffer_handle_t handle = compositionInfo.mTargetBuffer;
-    ExynosGraphicBufferMeta gmeta(compositionInfo.mTargetBuffer);
+    const ExynosCompositionInfo::TargetBufferMeta &meta =
+        compositionInfo.getTargetBufferMeta(handle);
 
     if ((windowIndex < 0) || (windowIndex >= (int32_t)mDpuData.configs.size())) {
         HWC_LOGE(mDisplayInfo.displayIdentifier, "%s:: ExynosCompositionInfo(%d) has invalid data, windowIndex(%d)",
@@ -1309,11 +1500,11 @@ int32_t ExynosDisplay::configureOverlay(ExynosCompositionInfo &compositionInfo)
         }
     }
 
-    config.fd_idma[0] = gmeta.fd;
-    config.fd_idma[1] = gmeta.fd1;
-    config.fd_idma[2] = gmeta.fd2;
-    config.buffer_id = ExynosGraphicBufferMeta::get_buffer_id(compositionInfo.mTargetBuffer);
-    config.protection = (getDrmMode(gmeta.producer_usage) == SECURE_DRM) ? 1 : 0;
+    config.fd_idma[0] = meta.fd[0];
+    config.fd_idma[1] = meta.fd[1];
+    config.fd_idma[2] = meta.fd[2];
+    config.buffer_id = meta.bufferId;
+    config.protection = (getDrmMode(meta.bufInfo.producer_usage) == SECURE_DRM) ? 1 : 0;
     config.state = config.WIN_STATE_BUFFER;
 
     config.assignedMPP = compositionInfo.mOtfMPP;
@@ -1321,14 +1512,13 @@ int32_t ExynosDisplay::configureOverlay(ExynosCompositionInfo &compositionInfo)
     config.dst.f_w = mXres;
     config.dst.f_h = mYres;
     if (compositionInfo.mType == COMPOSITION_EXYNOS) {
-        config.src.f_w = pixel_align(mXres, GET_M2M_DST_ALIGN(gmeta.format));
-        config.src.f_h = pixel_align(mYres, GET_M2M_DST_ALIGN(gmeta.format));
+        config.src.f_w = pixel_align(mXres, GET_M2M_DST_ALIGN(meta.bufInfo.format));
+        config.src.f_h = pixel_align(mYres, GET_M2M_DST_ALIGN(meta.bufInfo.format));
     } else {
-        config.src.f_w = gmeta.stride;
-        config.src.f_h = gmeta.vstride;
+        config.src.f_w = meta.stride;
+        config.src.f_h = meta.vstride;
     }
-    if (compositionInfo.mCompressionInfo.type ==
-        getCompressionInfo(handle).type)
+    if (compositionInfo.mCompressionInfo.type == meta.compressionInfo.type)
         config.compressionInfo = compositionInfo.mCompressionInfo;
     else
         config.compressionInfo.type = COMP_TYPE_NONE;
@@ -1710,22 +1900,8 @@ int ExynosDisplay::setDisplayWinConfigData() {
 }
 
 bool ExynosDisplay::checkConfigChanged(const exynos_dpu_data &lastConfigsData, const exynos_dpu_data &newConfigsData) {
-    for (size_t i = 0; i < lastConfigsData.configs.size(); i++) {
-        if ((lastConfigsData.configs[i].state != newConfigsData.configs[i].state) ||
-            (lastConfigsData.configs[i].fd_idma[0] != newConfigsData.configs[i].fd_idma[0]) ||
-            (lastConfigsData.configs[i].fd_idma[1] != newConfigsData.configs[i].fd_idma[1]) ||
-            (lastConfigsData.configs[i].fd_idma[2] != newConfigsData.configs[i].fd_idma[2]) ||
-            (lastConfigsData.configs[i].dst.x != newConfigsData.configs[i].dst.x) ||
-            (lastConfigsData.configs[i].dst.y != newConfigsData.configs[i].dst.y) ||
-            (lastConfigsData.configs[i].dst.w != newConfigsData.configs[i].dst.w) ||
-            (lastConfigsData.configs[i].dst.h != newConfigsData.configs[i].dst.h) ||
-            (lastConfigsData.configs[i].src.x != newConfigsData.configs[i].src.x) ||
-            (lastConfigsData.configs[i].src.y != newConfigsData.configs[i].src.y) ||
-            (lastConfigsData.configs[i].src.w != newConfigsData.configs[i].src.w) ||
-            (lastConfigsData.configs[i].src.h != newConfigsData.configs[i].src.h) ||
-            (lastConfigsData.configs[i].format != newConfigsData.configs[i].format) ||
-            (lastConfigsData.configs[i].blending != newConfigsData.configs[i].blending) ||
-            (lastConfigsData.configs[i].plane_alpha != newConfigsData.configs[i].plane_alpha))
+    for (size_t i = 0; i < newConfigsData.configs.size(); i++) {
+        if (lastConfigsData.win_table.getDirty(i, newConfigsData.configs[i]))
             return true;
     }
 
@@ -1739,10 +1915,10 @@ bool ExynosDisplay::checkConfigChanged(const exynos_dpu_data &lastConfigsData, c
 }
 
 int ExynosDisplay::canApplyWindowUpdate(const exynos_dpu_data &lastConfigsData, const exynos_dpu_data &newConfigsData, uint32_t index) {
-    if ((lastConfigsData.configs[index].state != newConfigsData.configs[index].state) ||
-        (lastConfigsData.configs[index].format != newConfigsData.configs[index].format) ||
-        (lastConfigsData.configs[index].blending != newConfigsData.configs[index].blending) ||
-        (lastConfigsData.configs[index].plane_alpha != newConfigsData.configs[index].plane_alpha)) {
+    uint32_t dirty = lastConfigsData.win_table.getDirty(index, newConfigsData.configs[index]);
+
+    if (dirty & (WIN_CONFIG_DIRTY_STATE | WIN_CONFIG_DIRTY_FORMAT |
+                 WIN_CONFIG_DIRTY_BLENDING | WIN_CONFIG_DIRTY_ALPHA)) {
         DISPLAY_LOGD(eDebugWindowUpdate,
                      "damage region is skip, but other configuration except dst was changed");
         DISPLAY_LOGD(eDebugWindowUpdate,
@@ -1755,14 +1931,7 @@ int ExynosDisplay::canApplyWindowUpdate(const exynos_dpu_data &lastConfigsData,
         return -1;
     }
 
-    if ((lastConfigsData.configs[index].dst.x != newConfigsData.configs[index].dst.x) ||
-        (lastConfigsData.configs[index].dst.y != newConfigsData.configs[index].dst.y) ||
-        (lastConfigsData.configs[index].dst.w != newConfigsData.configs[index].dst.w) ||
-        (lastConfigsData.configs[index].dst.h != newConfigsData.configs[index].dst.h) ||
-        (lastConfigsData.configs[index].src.x != newConfigsData.configs[index].src.x) ||
-        (lastConfigsData.configs[index].src.y != newConfigsData.configs[index].src.y) ||
-        (lastConfigsData.configs[index].src.w != newConfigsData.configs[index].src.w) ||
-        (lastConfigsData.configs[index].src.h != newConfigsData.configs[index].src.h))
+    if (dirty & (WIN_CONFIG_DIRTY_SRC | WIN_CONFIG_DIRTY_DST))
         return 1;
 
     else
@@ -1803,6 +1972,7 @@ int ExynosDisplay::setWindowUpdate(const hwc_rect &merge_rect) {
  */
 int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
     ATRACE_CALL();
+    ExynosLatencyStats::Scope latencyScope(mDisplayId, LATENCY_STAGE_DELIVER_WIN_CONFIG);
     int ret = NO_ERROR;
 
     ret = validateWinConfigData();
@@ -1826,7 +1996,7 @@ int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
          (mType == HWC_DISPLAY_PRIMARY)))
         canSkipConfig = false;
 
-    if (canSkipConfig && (checkConfigChanged(mDpuData, mLastDpuData) == false)) {
+    if (canSkipConfig && (checkConfigChanged(mLastDpuData, mDpuData) == false)) {
         DISPLAY_LOGD(eDebugWinConfig, "Winconfig : same");
 #ifndef DISABLE_FENCE
         if (mLastPresentFence > 0) {
@@ -1852,8 +2022,18 @@ int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
 #ifdef WAIT_FENCE
         waitFence = true;
 #endif
-        if (waitFence) {
+        if (waitFence && mDisplayControl.pipelinedCommit &&
+            !mDisplayControl.predictivePresent) {
+            /*
+             * Frame before the previous one should be done.
+             * The interface waits for the previous frame only if
+             * the kernel has not flipped it yet.
+             */
+            waitPreviousFrameDone(mN2PresentFence);
+            schedulePresentCommit();
+        } else if (waitFence) {
             waitPreviousFrameDone(mLastPresentFence);
+            schedulePresentCommit();
         } else {
             bool hasExternalDisplay = false;
             for (auto display : presentInfo.nonPrimaryDisplays) {
@@ -1873,6 +2053,7 @@ int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
                                       FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, FENCE_TO);
         }
 
+        mDpuData.updateWinDirty(mLastDpuData);
         if ((ret = mDisplayInterface->deliverWinConfigData(mDpuData)) < 0) {
             DISPLAY_LOGE("%s::interface's deliverWinConfigData() failed: %s, ret(%d)",
                          __func__, strerror(errno), ret);
@@ -1923,6 +2104,7 @@ int ExynosDisplay::setReleaseFences() {
         (mClientCompositionInfo.mWindowIndex >= 0) &&
         (mClientCompositionInfo.mWindowIndex < (int32_t)mDpuData.configs.size())) {
         exynos_win_config_data &config = mDpuData.configs[mClientCompositionInfo.mWindowIndex];
+        ExynosLayer *lastClientLayer = nullptr;
 
         for (int i = mClientCompositionInfo.mFirstIndex; i <= mClientCompositionInfo.mLastIndex; i++) {
             if (mLayers[i]->mExynosCompositionType != HWC2_COMPOSITION_CLIENT) {
@@ -1935,17 +2117,33 @@ int ExynosDisplay::setReleaseFences() {
                     continue;
                 }
             }
-            if (!mUseDpu)
-                mLayers[i]->mReleaseFence = -1;
-            else
+            mLayers[i]->mReleaseFence = -1;
+            lastClientLayer = mLayers[i];
+        }
+
+        /*
+         * SurfaceFlinger doesn't get the release fence of the client target,
+         * so the last client layer takes it instead of a dup of it.
+         */
+        if (mUseDpu && (lastClientLayer != nullptr) && (config.rel_fence >= 0)) {
+            for (int i = mClientCompositionInfo.mFirstIndex; i <= mClientCompositionInfo.mLastIndex; i++) {
+                if ((mLayers[i]->mExynosCompositionType != HWC2_COMPOSITION_CLIENT) ||
+                    (mLayers[i] == lastClientLayer))
+                    continue;
                 mLayers[i]->mReleaseFence =
                     mFenceTracer.checkFenceDebug(mDisplayInfo.displayIdentifier, FENCE_TYPE_SRC_RELEASE, FENCE_IP_DPP,
                                                  mFenceTracer.hwc_dup(config.rel_fence, mDisplayInfo.displayIdentifier,
                                                                       FENCE_TYPE_SRC_RELEASE, FENCE_IP_DPP));
+            }
+            lastClientLayer->mReleaseFence =
+                mFenceTracer.checkFenceDebug(mDisplayInfo.displayIdentifier, FENCE_TYPE_SRC_RELEASE,
+                                             FENCE_IP_DPP, config.rel_fence);
+            config.rel_fence = -1;
+        } else {
+            config.rel_fence = mFenceTracer.fence_close(config.rel_fence, mDisplayInfo.displayIdentifier,
+                                                        FENCE_TYPE_SRC_RELEASE, FENCE_IP_FB,
+                                                        "display::setReleaseFences: config.rel_fence for client comp");
         }
-        config.rel_fence = mFenceTracer.fence_close(config.rel_fence, mDisplayInfo.displayIdentifier,
-                                                    FENCE_TYPE_SRC_RELEASE, FENCE_IP_FB,
-                                                    "display::setReleaseFences: config.rel_fence for client comp");
     }
 
     // DPU doesn't close acq_fence, HWC should close it.
@@ -2136,6 +2334,7 @@ int32_t ExynosDisplay::createLayer(hwc2_layer_t *outLayer,
     ExynosLayer *layer = new ExynosLayer(mDisplayInfo);
     mLayers.add((ExynosLayer *)layer);
     *outLayer = (hwc2_layer_t)layer;
+    mLayerMap[*outLayer] = layer;
     setGeometryChanged(GEOMETRY_DISPLAY_LAYER_ADDED, geometryFlag);
     mDisplayInterface->onLayerCreated(*outLayer);
 
@@ -2538,6 +2737,127 @@ int32_t ExynosDisplay::canSkipValidate() {
     return NO_ERROR;
 }
 
+uint64_t ExynosDisplay::computeValidateFingerprint() {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 0x100000001b3ULL;
+    };
+
+    mix(mLayers.size());
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        mix(reinterpret_cast<uintptr_t>(mLayers[i]));
+        mix(mLayers[i]->getValidateFingerprint());
+    }
+    /* 0 is reserved for invalid fingerprint */
+    return (hash == 0) ? 1 : hash;
+}
+
+void ExynosDisplay::updateValidateFingerprint(bool validated) {
+    if (validated && exynosHWCControl.validateFingerprint)
+        mValidateFingerprint = computeValidateFingerprint();
+    else
+        mValidateFingerprint = 0;
+}
+
+static const char *clientReasonName[CLIENT_REASON_MAX] = {
+    "requested",
+    "forced",
+    "color_transform",
+    "format",
+    "scale",
+    "size",
+    "capacity",
+    "window",
+    "sandwich",
+    "hdr",
+    "deadline",
+    "assign_fail",
+    "other",
+};
+
+bool ExynosDisplay::isMirrorOf(const ExynosDisplay &source) const {
+    if ((mLayers.size() == 0) || (mLayers.size() != source.mLayers.size()))
+        return false;
+
+    /* The scale and the offset are those of the bottom layer */
+    const hwc_rect_t &srcBase = source.mLayers[0]->mDisplayFrame;
+    const hwc_rect_t &dstBase = mLayers[0]->mDisplayFrame;
+    if ((srcBase.right <= srcBase.left) || (srcBase.bottom <= srcBase.top))
+        return false;
+    float scaleX = (float)(dstBase.right - dstBase.left) / (srcBase.right - srcBase.left);
+    float scaleY = (float)(dstBase.bottom - dstBase.top) / (srcBase.bottom - srcBase.top);
+    auto isScaled = [](int32_t dst, int32_t src, int32_t dstOrigin, int32_t srcOrigin,
+                       float scale) -> bool {
+        return fabsf(dstOrigin + (src - srcOrigin) * scale - dst) <= 1.0f;
+    };
+
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        const ExynosLayer *layer = mLayers[i];
+        const ExynosLayer *srcLayer = source.mLayers[i];
+
+        if ((layer->mLayerBuffer != srcLayer->mLayerBuffer) ||
+            (layer->mTransform != srcLayer->mTransform) ||
+            (layer->mBlending != srcLayer->mBlending) ||
+            (layer->mPlaneAlpha != srcLayer->mPlaneAlpha) ||
+            (layer->mSourceCrop.left != srcLayer->mSourceCrop.left) ||
+            (layer->mSourceCrop.top != srcLayer->mSourceCrop.top) ||
+            (layer->mSourceCrop.right != srcLayer->mSourceCrop.right) ||
+            (layer->mSourceCrop.bottom != srcLayer->mSourceCrop.bottom))
+            return false;
+        if ((layer->mLayerBuffer == NULL) &&
+            ((layer->mColor.r != srcLayer->mColor.r) || (layer->mColor.g != srcLayer->mColor.g) ||
+             (layer->mColor.b != srcLayer->mColor.b) || (layer->mColor.a != srcLayer->mColor.a)))
+            return false;
+
+        const hwc_rect_t &frame = layer->mDisplayFrame;
+        const hwc_rect_t &srcFrame = srcLayer->mDisplayFrame;
+        if (!isScaled(frame.left, srcFrame.left, dstBase.left, srcBase.left, scaleX) ||
+            !isScaled(frame.right, srcFrame.right, dstBase.left, srcBase.left, scaleX) ||
+            !isScaled(frame.top, srcFrame.top, dstBase.top, srcBase.top, scaleY) ||
+            !isScaled(frame.bottom, srcFrame.bottom, dstBase.top, srcBase.top, scaleY))
+            return false;
+    }
+
+    return true;
+}
+
+void ExynosDisplay::updateClientCompositionReasons() {
+    bool hasClientLayer = false;
+
+    mValidatedFrameCnt++;
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        uint32_t reason = mLayers[i]->updateClientCompositionReason();
+        if (reason == CLIENT_REASON_NONE)
+            continue;
+        mClientReasonCount[reason]++;
+        hasClientLayer = true;
+        DISPLAY_LOGD(eDebugResourceManager, "[%zu] layer: client composition by %s",
+                     i, clientReasonName[reason]);
+    }
+    if (hasClientLayer)
+        mClientCompositionFrameCnt++;
+}
+
+void ExynosDisplay::dumpClientCompositionReasons(String8 &result) {
+    if (mClientCompositionFrameCnt == 0)
+        return;
+
+    result.appendFormat("client composition frames: %" PRIu64 "/%" PRIu64 ", layers by reason:",
+                        mClientCompositionFrameCnt, mValidatedFrameCnt);
+    for (uint32_t i = 0; i < CLIENT_REASON_MAX; i++) {
+        if (mClientReasonCount[i])
+            result.appendFormat(" %s(%" PRIu64 ")", clientReasonName[i], mClientReasonCount[i]);
+    }
+    result.append("\n");
+}
+
+bool ExynosDisplay::isValidateFingerprintSame() {
+    if (mValidateFingerprint == 0)
+        return false;
+    return (computeValidateFingerprint() == mValidateFingerprint);
+}
+
 int32_t ExynosDisplay::handleSkipPresent(int32_t *outPresentFence) {
     int ret = HWC2_ERROR_NONE;
     if ((mNeedSkipPresent == false) && (mNeedSkipValidatePresent == false))
@@ -2626,7 +2946,21 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         setTaskProfileDone = true;
     }
 
+    /* Timer is reset before mDisplayMutex, timeout handler takes it */
+    {
+        std::lock_guard<std::mutex> lock(mIdleTimerMutex);
+        if (mIdleTimer)
+            mIdleTimer->reset();
+    }
+
     Mutex::Autolock lock(mDisplayMutex);
+    processPendingVsyncEvents();
+    mFramePacing.presentStart = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (mIdleModeState == IdleModeState::ENTERING)
+        mIdleModeState = IdleModeState::IDLE;
+    else if (mIdleModeState == IdleModeState::IDLE)
+        exitIdleModeLocked();
 
     /*
      * buffer handle, dataspace were set by setClientTarget() after validateDisplay
@@ -2738,11 +3072,19 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         return ret;
     }
 
+    setupReadbackStreamFrame();
+    setupContentSampleFrame();
+    setupFrameCrcFrame();
+
     handleWindowUpdate();
 
     setDisplayWinConfigData();
 
-    if ((ret = deliverWinConfigData(presentInfo)) != NO_ERROR) {
+    ret = deliverWinConfigData(presentInfo);
+    queueReadbackStreamFrame();
+    queueContentSampleFrame();
+    queueFrameCrcFrame();
+    if (ret != NO_ERROR) {
         HWC_LOGE(mDisplayInfo.displayIdentifier, "%s:: fail to deliver win_config (%d)", __func__, ret);
         if (mDpuData.present_fence > 0)
             mFenceTracer.fence_close(mDpuData.present_fence, mDisplayInfo.displayIdentifier,
@@ -2777,6 +3119,7 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         *outPresentFence = -1;
 
     /* Update last present fence */
+    updateFramePacing();
     mN2PresentFence = mFenceTracer.fence_close(mN2PresentFence, mDisplayInfo.displayIdentifier,
                                                FENCE_TYPE_PRESENT, FENCE_IP_DPP,
                                                "display::presentDisplay: mN2PresentFence wait done");
@@ -2898,7 +3241,8 @@ int32_t ExynosDisplay::setClientTarget(buffer_handle_t target,
     if (target != NULL)
         handle = target;
 
-    ExynosGraphicBufferMeta gmeta(handle);
+    const ExynosCompositionInfo::TargetBufferMeta &meta =
+        mClientCompositionInfo.getTargetBufferMeta(handle);
     if (mClientCompositionInfo.mHasCompositionLayer == false) {
         if (acquireFence >= 0)
             mFenceTracer.fence_close(acquireFence, mDisplayInfo.displayIdentifier,
@@ -2921,17 +3265,17 @@ int32_t ExynosDisplay::setClientTarget(buffer_handle_t target,
             }
         } else {
             DISPLAY_LOGD(eDebugOverlaySupported, "ClientTarget handle: %p [fd: %d, %d, %d]",
-                         handle, gmeta.fd, gmeta.fd1, gmeta.fd2);
+                         handle, meta.fd[0], meta.fd[1], meta.fd[2]);
             if ((mClientCompositionInfo.mSkipFlag == true) &&
-                ((mClientCompositionInfo.mLastWinConfigData.fd_idma[0] != gmeta.fd) ||
-                 (mClientCompositionInfo.mLastWinConfigData.fd_idma[1] != gmeta.fd1) ||
-                 (mClientCompositionInfo.mLastWinConfigData.fd_idma[2] != gmeta.fd2))) {
+                ((mClientCompositionInfo.mLastWinConfigData.fd_idma[0] != meta.fd[0]) ||
+                 (mClientCompositionInfo.mLastWinConfigData.fd_idma[1] != meta.fd[1]) ||
+                 (mClientCompositionInfo.mLastWinConfigData.fd_idma[2] != meta.fd[2]))) {
                 String8 errString;
                 DISPLAY_LOGE("skip flag is enabled but buffer is updated lastConfig[%d, %d, %d], handle[%d, %d, %d]\n",
                              mClientCompositionInfo.mLastWinConfigData.fd_idma[0],
                              mClientCompositionInfo.mLastWinConfigData.fd_idma[1],
                              mClientCompositionInfo.mLastWinConfigData.fd_idma[2],
-                             gmeta.fd, gmeta.fd1, gmeta.fd2);
+                             meta.fd[0], meta.fd[1], meta.fd[2]);
                 DISPLAY_LOGE("last win config");
                 for (size_t i = 0; i < mLastDpuData.configs.size(); i++) {
                     errString.appendFormat("config[%zu]\n", i);
@@ -2953,8 +3297,8 @@ int32_t ExynosDisplay::setClientTarget(buffer_handle_t target,
                                   FENCE_TYPE_SRC_RELEASE, FENCE_IP_FB, FENCE_FROM);
     }
     if (handle) {
-        mClientCompositionInfo.mCompressionInfo = getCompressionInfo(handle);
-        mClientCompositionInfo.mFormat = ExynosFormat(gmeta.format, mClientCompositionInfo.mCompressionInfo.type);
+        mClientCompositionInfo.mCompressionInfo = meta.compressionInfo;
+        mClientCompositionInfo.mFormat = ExynosFormat(meta.bufInfo.format, meta.compressionInfo.type);
     }
 
     return HWC2_ERROR_NONE;
@@ -2978,6 +3322,8 @@ int32_t ExynosDisplay::setColorTransform(
         (mDisplayColorInterface->setColorTransform(matrix, hint) == NO_ERROR)) {
         mDisplayColorInterface->getDqeLut(mDisplayColorCoefAddr);
         fd = mDisplayColorFd;
+        /* LUTs of modes have the previous transform */
+        mDisplayColorTransformGen++;
     }
 #endif
     int ret = mDisplayInterface->setColorTransform(matrix, hint, fd);
@@ -2996,25 +3342,65 @@ int32_t ExynosDisplay::setColorTransform(
 }
 
 #ifdef USE_DISPLAY_COLOR_INTERFACE
-int32_t ExynosDisplay::searchDisplayColorMode(int32_t mode) {
-    if (mDisplayColorModes.find(mode) != mDisplayColorModes.end()) {
-        if (mDisplayColorInterface &&
-            mDisplayColorInterface->getDqeLut(mDisplayColorCoefAddr) != NO_ERROR) {
+int32_t ExynosDisplay::searchDisplayColorMode(int32_t mode, int32_t intent, int32_t &outFd) {
+    if (mDisplayColorModes.find(mode) == mDisplayColorModes.end())
+        return -EINVAL;
+    if (mDisplayColorInterface == NULL) {
+        outFd = mDisplayColorFd;
+        return NO_ERROR;
+    }
+
+    DisplayColorLut *lut = NULL;
+    uint64_t key = displayColorKey(mode, intent);
+    auto it = mDisplayColorLuts.find(key);
+    if (it != mDisplayColorLuts.end()) {
+        lut = &it->second;
+    } else if ((mDisplayColorLuts.size() < kMaxDisplayColorLutNum) &&
+               (mDisplayColorCoefSize > 0)) {
+        DisplayColorLut newLut;
+        if (allocParcelData(&newLut.fd, mDisplayColorCoefSize) == NO_ERROR) {
+            newLut.addr = mmap(0, mDisplayColorCoefSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED, newLut.fd, 0);
+            if (newLut.addr != MAP_FAILED)
+                lut = &(mDisplayColorLuts[key] = newLut);
+            else
+                close(newLut.fd);
+        }
+    }
+
+    /* Out of LUTs, the shared parcel is written for every switch */
+    if (lut == NULL) {
+        if (mDisplayColorInterface->getDqeLut(mDisplayColorCoefAddr) != NO_ERROR) {
             ALOGI("%s:: getting DqeLut fail", __func__);
             return -EINVAL;
-        } else {
-            return NO_ERROR;
         }
-    } else {
-        return -EINVAL;
+        outFd = mDisplayColorFd;
+        return NO_ERROR;
+    }
+
+    if (lut->transformGen != mDisplayColorTransformGen) {
+        if (mDisplayColorInterface->getDqeLut(lut->addr) != NO_ERROR) {
+            ALOGI("%s:: getting DqeLut fail", __func__);
+            lut->transformGen = 0;
+            return -EINVAL;
+        }
+        lut->transformGen = mDisplayColorTransformGen;
     }
+    outFd = lut->fd;
+    return NO_ERROR;
 }
 
-int32_t ExynosDisplay::searchDisplayRenderIntent(int32_t mode, int32_t intent) {
-    for (auto item : mDisplayRenderIntents[mode]) {
-        if (item.intentId == intent)
-            return NO_ERROR;
+void ExynosDisplay::freeDisplayColorLuts() {
+    for (auto &item : mDisplayColorLuts) {
+        munmap(item.second.addr, mDisplayColorCoefSize);
+        close(item.second.fd);
     }
+    mDisplayColorLuts.clear();
+}
+
+int32_t ExynosDisplay::searchDisplayRenderIntent(int32_t mode, int32_t intent) {
+    if (mDisplayRenderIntentKeys.count(displayColorKey(mode, intent)))
+        return NO_ERROR;
     return -EINVAL;
 }
 #endif
@@ -3030,8 +3416,7 @@ int32_t ExynosDisplay::setColorMode(
 #ifdef USE_DISPLAY_COLOR_INTERFACE
     if (mDisplayColorInterface &&
         (mDisplayColorInterface->setColorMode(mode) == NO_ERROR) &&
-        (searchDisplayColorMode(mode) == NO_ERROR)) {
-        fd = mDisplayColorFd;
+        (searchDisplayColorMode(mode, -1, fd) == NO_ERROR)) {
         if (mCurrentDisplayColorMode.modeId != mode)
             setGeometryChanged(GEOMETRY_DISPLAY_COLOR_MODE_CHANGED, geometryFlag);
         mCurrentDisplayColorMode = mDisplayColorModes[mode];
@@ -3075,6 +3460,10 @@ int32_t ExynosDisplay::getRenderIntents(int32_t mode, uint32_t *outNumIntents,
             if (mDisplayRenderIntents[mode].size() == 0)
                 mDisplayRenderIntents[mode].clear();
             std::vector<DisplayRenderIntent> list = mDisplayColorInterface->getRenderIntents(mode);
+            for (auto &item : mDisplayRenderIntents[mode])
+                mDisplayRenderIntentKeys.erase(displayColorKey(mode, item.intentId));
+            for (auto &item : list)
+                mDisplayRenderIntentKeys.insert(displayColorKey(mode, item.intentId));
             mDisplayRenderIntents[mode] = list;
             *outNumIntents = list.size();
         } else {
@@ -3105,8 +3494,7 @@ int32_t ExynosDisplay::setColorModeWithRenderIntent(
 #ifdef USE_DISPLAY_COLOR_INTERFACE
     if (mDisplayColorInterface && (searchDisplayRenderIntent(mode, intent) == NO_ERROR) &&
         (mDisplayColorInterface->setColorModeWithRenderIntent(mode, intent) == NO_ERROR) &&
-        (searchDisplayColorMode(mode) == NO_ERROR)) {
-        fd = mDisplayColorFd;
+        (searchDisplayColorMode(mode, intent, fd) == NO_ERROR)) {
         if (mCurrentDisplayColorMode.modeId != mode)
             setGeometryChanged(GEOMETRY_DISPLAY_COLOR_MODE_CHANGED, geometryFlag);
         mCurrentDisplayColorMode = mDisplayColorModes[mode];
@@ -3153,6 +3541,8 @@ int32_t ExynosDisplay::getDisplayCapabilities(uint32_t *outNumCapabilities,
     if (mDisplayInterface->isDozeModeAvailable()) {
         capabilityNum++;
     }
+    if (mDisplayInterface->isAllmSupported())
+        capabilityNum++;
 #ifdef HWC_SUPPORT_COLOR_TRANSFORM
 #ifdef USE_DISPLAY_COLOR_INTERFACE
     if (mType == HWC_DISPLAY_PRIMARY)
@@ -3178,6 +3568,8 @@ int32_t ExynosDisplay::getDisplayCapabilities(uint32_t *outNumCapabilities,
         ALOGD("%s, Doze enabed", __func__);
         outCapabilities[index++] = HWC2_DISPLAY_CAPABILITY_DOZE;
     }
+    if (mDisplayInterface->isAllmSupported())
+        outCapabilities[index++] = HWC2_DISPLAY_CAPABILITY_AUTO_LOW_LATENCY_MODE;
 #ifdef HWC_SUPPORT_COLOR_TRANSFORM
 #ifdef USE_DISPLAY_COLOR_INTERFACE
     if (mType == HWC_DISPLAY_PRIMARY)
@@ -3212,14 +3604,33 @@ int32_t ExynosDisplay::setDisplayBrightness(float brightness) {
     }
 #endif
 
+    if (mBrightnessWorker == nullptr) {
+        writeBrightness(scaledBrightness);
+        return HWC2_ERROR_NONE;
+    }
+
+    /* The worker has not taken the previous value yet, it writes this one instead */
+    if (mPendingBrightness.exchange(scaledBrightness) < 0)
+        mBrightnessWorker->submit([this]() { flushPendingBrightness(); });
+
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosDisplay::flushPendingBrightness() {
+    int64_t brightness = mPendingBrightness.exchange(-1);
+    if (brightness >= 0)
+        writeBrightness(static_cast<uint32_t>(brightness));
+}
+
+void ExynosDisplay::writeBrightness(uint32_t brightness) {
+    ATRACE_INT("brightness", brightness);
     mBrightnessOfs.seekp(std::ios_base::beg);
-    mBrightnessOfs << std::to_string(scaledBrightness);
+    mBrightnessOfs << std::to_string(brightness);
     mBrightnessOfs.flush();
     if (mBrightnessOfs.fail()) {
         DISPLAY_LOGE("brightness write failed");
+        mBrightnessOfs.clear();
     }
-
-    return HWC2_ERROR_NONE;
 }
 
 int32_t ExynosDisplay::getDisplayVsyncPeriod(hwc2_vsync_period_t *outVsyncPeriod) {
@@ -3239,14 +3650,21 @@ int32_t ExynosDisplay::getConfigAppliedTime(const uint64_t desiredTime,
                                             const uint64_t actualChangeTime,
                                             int64_t &appliedTime, int64_t &refreshTime) {
     uint32_t transientDuration = mDisplayInterface->getConfigChangeDuration();
+    nsecs_t period = mVsyncModel.getPeriod(mVsyncPeriod);
     appliedTime = actualChangeTime;
+    /* Config is applied at the vsync, align it to the actual vsync timeline */
+    if (mPowerModeState == HWC2_POWER_MODE_ON) {
+        nsecs_t vsync = mVsyncModel.getNextVsync(actualChangeTime - period / 2);
+        if (vsync > 0)
+            appliedTime = vsync;
+    }
     while (desiredTime > appliedTime) {
         DISPLAY_LOGD(eDebugDisplayConfig, "desired time(%" PRId64 ") > applied time(%" PRId64 ")", desiredTime, appliedTime);
         ;
-        appliedTime += mVsyncPeriod;
+        appliedTime += period;
     }
 
-    refreshTime = appliedTime - (transientDuration * mVsyncPeriod);
+    refreshTime = appliedTime - (transientDuration * period);
 
     return NO_ERROR;
 }
@@ -3285,6 +3703,20 @@ int32_t ExynosDisplay::setActiveConfigWithConstraints(hwc2_config_t config,
                                                       bool needUpdateTimeline) {
     Mutex::Autolock lock(mDisplayMutex);
 
+    /* Config requested by the client replaces the idle config */
+    if (mIdleModeState != IdleModeState::ACTIVE) {
+        DISPLAY_LOGD(eDebugDisplayConfig, "idle mode is canceled by config(%d)", config);
+        mIdleModeState = IdleModeState::ACTIVE;
+    }
+
+    return setActiveConfigWithConstraintsLocked(config, vsyncPeriodChangeConstraints,
+                                                outTimeline, needUpdateTimeline);
+}
+
+int32_t ExynosDisplay::setActiveConfigWithConstraintsLocked(hwc2_config_t config,
+                                                            hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
+                                                            hwc_vsync_period_change_timeline_t *outTimeline,
+                                                            bool needUpdateTimeline) {
     ATRACE_CALL();
 
     int32_t ret = checkValidationConfigConstraints(config,
@@ -3376,14 +3808,60 @@ int32_t ExynosDisplay::getPreferredDisplayConfigInternal(int32_t *outConfig) {
     return HWC2_ERROR_UNSUPPORTED;
 }
 
-int32_t ExynosDisplay::setAutoLowLatencyMode(bool __unused on) {
-    return HWC2_ERROR_UNSUPPORTED;
+int32_t ExynosDisplay::setAutoLowLatencyMode(bool on) {
+    if (!mDisplayInterface->isAllmSupported())
+        return HWC2_ERROR_UNSUPPORTED;
+
+    Mutex::Autolock lock(mDisplayMutex);
+    return setAutoLowLatencyModeInternal(on);
+}
+
+int32_t ExynosDisplay::setAutoLowLatencyModeInternal(bool on) {
+    if (on == mLowLatency.enabled)
+        return HWC2_ERROR_NONE;
+
+    /* The policy is restored even if the sink is gone */
+    int32_t ret = mDisplayInterface->setAutoLowLatencyMode(on);
+    if (ret != NO_ERROR) {
+        DISPLAY_LOGE("%s:: failed to set ALLM(%d), ret(%d)", __func__, on, ret);
+        if (on)
+            return HWC2_ERROR_UNSUPPORTED;
+    }
+
+    /* Frames are committed as soon as they are ready, one at a time */
+    if (on) {
+        mLowLatency.predictivePresent = mDisplayControl.predictivePresent;
+        mLowLatency.pipelinedCommit = mDisplayControl.pipelinedCommit;
+        mLowLatency.staticLayerCache = mDisplayControl.staticLayerCache;
+        mDisplayControl.predictivePresent = false;
+        mDisplayControl.pipelinedCommit = false;
+        mDisplayControl.staticLayerCache = false;
+    } else {
+        mDisplayControl.predictivePresent = mLowLatency.predictivePresent;
+        mDisplayControl.pipelinedCommit = mLowLatency.pipelinedCommit;
+        mDisplayControl.staticLayerCache = mLowLatency.staticLayerCache;
+    }
+    mLowLatency.enabled = on;
+    DISPLAY_LOGI("%s:: ALLM(%d)", __func__, on);
+
+    return HWC2_ERROR_NONE;
 }
 
-int32_t ExynosDisplay::getSupportedContentTypes(uint32_t *__unused outNumSupportedContentTypes,
-                                                uint32_t *__unused outSupportedContentTypes) {
-    if (outSupportedContentTypes == NULL)
-        outNumSupportedContentTypes = 0;
+int32_t ExynosDisplay::getSupportedContentTypes(uint32_t *outNumSupportedContentTypes,
+                                                uint32_t *outSupportedContentTypes) {
+    std::vector<uint32_t> types;
+    mDisplayInterface->getSupportedContentTypes(types);
+
+    if (outSupportedContentTypes == NULL) {
+        *outNumSupportedContentTypes = types.size();
+        return HWC2_ERROR_NONE;
+    }
+
+    uint32_t num = std::min(*outNumSupportedContentTypes, (uint32_t)types.size());
+    for (uint32_t i = 0; i < num; i++)
+        outSupportedContentTypes[i] = types[i];
+    *outNumSupportedContentTypes = num;
+
     return HWC2_ERROR_NONE;
 }
 
@@ -3609,10 +4087,24 @@ int32_t ExynosDisplay::getDisplayConnectionType(uint32_t *outType) {
 }
 
 int32_t ExynosDisplay::setContentType(int32_t /* hwc2_content_type_t */ contentType) {
-    if (contentType == HWC2_CONTENT_TYPE_NONE)
-        return HWC2_ERROR_NONE;
+    if ((contentType < HWC2_CONTENT_TYPE_NONE) || (contentType > HWC2_CONTENT_TYPE_GAME))
+        return HWC2_ERROR_BAD_PARAMETER;
 
-    return HWC2_ERROR_UNSUPPORTED;
+    std::vector<uint32_t> types;
+    mDisplayInterface->getSupportedContentTypes(types);
+    if (types.empty())
+        return (contentType == HWC2_CONTENT_TYPE_NONE) ? HWC2_ERROR_NONE : HWC2_ERROR_UNSUPPORTED;
+    if ((contentType != HWC2_CONTENT_TYPE_NONE) &&
+        (std::find(types.begin(), types.end(), (uint32_t)contentType) == types.end()))
+        return HWC2_ERROR_UNSUPPORTED;
+
+    int32_t ret = mDisplayInterface->setContentType(contentType);
+    if (ret != NO_ERROR) {
+        DISPLAY_LOGE("%s:: failed to set content type(%d), ret(%d)", __func__, contentType, ret);
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+
+    return HWC2_ERROR_NONE;
 }
 
 int32_t ExynosDisplay::setOutputBuffer(buffer_handle_t __unused buffer, int32_t __unused releaseFence) {
@@ -3734,6 +4226,7 @@ int32_t ExynosDisplay::preProcessValidate(DeviceValidateInfo &validateInfo,
     mLastUpdateTimeStamp = systemTime(SYSTEM_TIME_MONOTONIC);
 
     mLayers.vector_sort();
+    filterLayerZOrderChanged();
     doPreProcessing(validateInfo, geometryChanged);
     setSrcAcquireFences();
     setPerformanceSetting();
@@ -3741,6 +4234,23 @@ int32_t ExynosDisplay::preProcessValidate(DeviceValidateInfo &validateInfo,
     return NO_ERROR;
 }
 
+void ExynosDisplay::filterLayerZOrderChanged() {
+    bool sameOrder = (mValidatedLayerOrder.size() == mLayers.size());
+    for (size_t i = 0; sameOrder && (i < mLayers.size()); i++)
+        sameOrder = (mValidatedLayerOrder[i] == mLayers[i]);
+
+    if (sameOrder) {
+        for (auto layer : mLayers) {
+            if (layer->mGeometryChanged & GEOMETRY_LAYER_ZORDER_CHANGED) {
+                layer->mGeometryChanged &= ~GEOMETRY_LAYER_ZORDER_CHANGED;
+                layer->mFilteredGeometryChanged |= GEOMETRY_LAYER_ZORDER_CHANGED;
+            }
+        }
+    }
+
+    mValidatedLayerOrder.assign(mLayers.begin(), mLayers.end());
+}
+
 void ExynosDisplay::setForceClient() {
     mClientCompositionInfo.mSkipStaticInitFlag = false;
     mExynosCompositionInfo.mSkipStaticInitFlag = false;
@@ -3754,6 +4264,16 @@ void ExynosDisplay::setForceClient() {
     }
 }
 
+void ExynosDisplay::setLowPowerComposition(bool enable, uint64_t &geometryFlag) {
+    if (mLowPowerComposition == enable)
+        return;
+
+    DISPLAY_LOGI("%s:: low power composition(%d)", __func__, enable);
+    mLowPowerComposition = enable;
+    mLowPowerFrameCnt = 0;
+    setGeometryChanged(GEOMETRY_DISPLAY_LOW_POWER_CHANGED, geometryFlag);
+}
+
 int32_t ExynosDisplay::postProcessValidate() {
     ATRACE_CALL();
     int ret = NO_ERROR;
@@ -3859,6 +4379,7 @@ int32_t ExynosDisplay::startPostProcessing() {
                 m2mMpp->setVotfInfo(votfInfo);
             }
 
+            m2mMpp->mCurrentTargetCompressionInfoType = midImg.compressionInfo.type;
             if ((ret = m2mMpp->doPostProcessing(srcImg, midImg)) != NO_ERROR) {
                 DISPLAY_LOGE("%s:: doPostProcessing() failed, layer(%zu), ret(%d)",
                              __func__, i, ret);
@@ -3875,7 +4396,31 @@ int32_t ExynosDisplay::startPostProcessing() {
 }
 
 int32_t ExynosDisplay::setCursorPositionAsync(uint32_t x_pos, uint32_t y_pos) {
-    mDisplayInterface->setCursorPositionAsync(x_pos, y_pos);
+    bool needRefresh = false;
+
+    {
+        /* The cursor plane is moved between the frame commits */
+        Mutex::Autolock lock(mDisplayMutex);
+
+        if ((mDisplayControl.cursorSupport == false) ||
+            (mPowerModeState != HWC2_POWER_MODE_ON))
+            return HWC2_ERROR_NONE;
+
+        if ((mCursorIndex < 0) || (mCursorIndex >= (int32_t)mLayers.size()) ||
+            (mLayers[mCursorIndex]->mExynosCompositionType != HWC2_COMPOSITION_DEVICE) ||
+            (mLayers[mCursorIndex]->mM2mMPP != NULL))
+            return HWC2_ERROR_NONE;
+
+        if (mDisplayInterface->setCursorPositionAsync(x_pos, y_pos) != NO_ERROR) {
+            DISPLAY_LOGD(eDebugWinConfig, "%s:: cursor (%d, %d) is moved by the next frame",
+                         __func__, x_pos, y_pos);
+            needRefresh = true;
+        }
+    }
+
+    if (needRefresh)
+        invalidate();
+
     return HWC2_ERROR_NONE;
 }
 
@@ -3909,6 +4454,43 @@ void ExynosDisplay::dump(String8 &result) {
                         mXres, mYres, mVsyncState, mColorMode, mColorTransformHint);
     mClientCompositionInfo.dump(result);
     mExynosCompositionInfo.dump(result);
+    if (mDpuData.enable_win_update)
+        mWindowUpdateDamage.dump(result);
+    mVsyncModel.dump(result);
+    mReadbackRing.dump(result);
+    mContentSampler->dump(result);
+    mFrameCrc->dump(result);
+    if (mIdleTimeoutMs)
+        result.appendFormat("idle timer: %d ms, state(%d), entered(%" PRIu64 ")\n",
+                            mIdleTimeoutMs, static_cast<int>(mIdleModeState), mIdleEnterCount);
+    if (mRefreshRateDebugEnabled)
+        result.appendFormat("refresh rate debug: observed period(%d), dropped(%" PRIu64 ")\n",
+                            mObservedVsyncPeriod, mRefreshRateChangeDropped);
+    if (mDisplayControl.predictivePresent || mPresentSchedule.heldCount)
+        result.appendFormat("present schedule margin: %" PRId64 " ns, hit: %" PRIu64 ", miss: %" PRIu64
+                            ", held: %" PRIu64 "\n",
+                            mPresentSchedule.margin, mPresentSchedule.hitCount, mPresentSchedule.missCount,
+                            mPresentSchedule.heldCount);
+    dumpFramePacing(result);
+    if (mStaticLayerCache.active)
+        result.appendFormat("static layer cache [%d] - [%d]\n",
+                            mStaticLayerCache.firstIndex, mStaticLayerCache.lastIndex);
+    if (mDisplayControl.assignDeadlineUs)
+        result.appendFormat("assign deadline: %d us, exceeded: %" PRIu64 "\n",
+                            mDisplayControl.assignDeadlineUs, mAssignDeadlineCnt);
+    if (mLowPowerComposition)
+        result.appendFormat("low power composition: %" PRIu64 " frames\n", mLowPowerFrameCnt);
+    if (mMirroredFrameCnt)
+        result.appendFormat("mirror of %s: %s, mirrored frames: %" PRIu64 "\n",
+                            (mMirrorSource != nullptr) ? mMirrorSource->mDisplayName.string() : "none",
+                            (mMirrorSource != nullptr) ? "on" : "off", mMirroredFrameCnt);
+    if (mHdrCoefBuildupSkipCnt || mHdrCoefWriteSkipCnt)
+        result.appendFormat("hdr coef cache: skipped build-up: %" PRIu64 ", skipped writes: %" PRIu64 "\n",
+                            mHdrCoefBuildupSkipCnt, mHdrCoefWriteSkipCnt);
+    if (exynosHWCControl.dpuBandwidthBudget)
+        result.appendFormat("dpu read bandwidth: %u MB/s, exceeded: %" PRIu64 "\n",
+                            mDpuBandwidth, mDpuBandwidthExceededCnt);
+    dumpClientCompositionReasons(result);
 
     for (uint32_t i = 0; i < mLayers.size(); i++) {
         ExynosLayer *layer = mLayers[i];
@@ -3975,8 +4557,8 @@ int32_t ExynosDisplay::setCompositionTargetExynosImage(uint32_t targetType, exyn
             src_img->exynosFormat = compositionInfo.mFormat;
 
 #ifdef GRALLOC_VERSION1
-            ExynosGraphicBufferMeta gmeta(compositionInfo.mTargetBuffer);
-            src_img->usageFlags = gmeta.producer_usage;
+            src_img->usageFlags =
+                compositionInfo.getTargetBufferMeta(compositionInfo.mTargetBuffer).bufInfo.producer_usage;
 #else
             src_img->usageFlags = compositionInfo.mTargetBuffer->flags;
 #endif
@@ -4289,6 +4871,21 @@ int32_t ExynosDisplay::handleSandwitchedExynosCompositionLayer(
     return NO_ERROR;
 }
 
+/* Pixels of the layers in [@first, @last] that would be added to the client composition */
+uint64_t ExynosDisplay::getClientCompositionCost(int32_t first, int32_t last) {
+    uint64_t pixels = 0;
+    for (int32_t i = std::max(first, 0); (i <= last) && (i < (int32_t)mLayers.size()); i++) {
+        ExynosLayer *layer = mLayers[i];
+        /* addClientCompositionLayer() keeps these layers */
+        if ((layer->mValidateCompositionType == HWC2_COMPOSITION_CLIENT) ||
+            ((layer->mPlaneAlpha == 1.0f) && (layer->mOverlayPriority >= ePriorityHigh)))
+            continue;
+        pixels += (uint64_t)std::max(WIDTH(layer->mDisplayFrame), 0) *
+                  std::max(HEIGHT(layer->mDisplayFrame), 0);
+    }
+    return pixels;
+}
+
 int32_t ExynosDisplay::handleNestedClientCompositionLayer(int32_t &changeFlag) {
     /* Check if exynos comosition nests GLES composition */
     if (!(mClientCompositionInfo.mHasCompositionLayer) ||
@@ -4298,10 +4895,25 @@ int32_t ExynosDisplay::handleNestedClientCompositionLayer(int32_t &changeFlag) {
         (mClientCompositionInfo.mLastIndex >= mExynosCompositionInfo.mLastIndex))
         return NO_ERROR;
 
+    /*
+     * The exynos composition layers on one side of the client composition
+     * are moved to the client composition. The side with fewer pixels is
+     * moved so that GLES composes less, or the side with fewer layers if
+     * the pixels are the same.
+     */
+    uint64_t lowerPixels = getClientCompositionCost(mExynosCompositionInfo.mFirstIndex,
+                                                    mClientCompositionInfo.mFirstIndex - 1);
+    uint64_t upperPixels = getClientCompositionCost(mClientCompositionInfo.mLastIndex + 1,
+                                                    mExynosCompositionInfo.mLastIndex);
+    DISPLAY_LOGD(eDebugResourceAssigning, "\tnested client composition, pixels lower(%" PRIu64 "), upper(%" PRIu64 ")",
+                 lowerPixels, upperPixels);
+
     int32_t ret = NO_ERROR;
     uint32_t isExynosCompositionChanged = 0;
-    if ((mClientCompositionInfo.mFirstIndex - mExynosCompositionInfo.mFirstIndex) <
-        (mExynosCompositionInfo.mLastIndex - mClientCompositionInfo.mLastIndex)) {
+    if ((lowerPixels < upperPixels) ||
+        ((lowerPixels == upperPixels) &&
+         ((mClientCompositionInfo.mFirstIndex - mExynosCompositionInfo.mFirstIndex) <
+          (mExynosCompositionInfo.mLastIndex - mClientCompositionInfo.mLastIndex)))) {
         mLayers[mExynosCompositionInfo.mFirstIndex]->resetAssignedResource();
         mLayers[mExynosCompositionInfo.mFirstIndex]->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
         if ((ret = addClientCompositionLayer(mExynosCompositionInfo.mFirstIndex,
@@ -4522,13 +5134,21 @@ int ExynosDisplay::handleWindowUpdate() {
     if (windowUpdateExceptions())
         return 0;
 
-    hwc_rect mergedRect = {(int)mXres, (int)mYres, 0, 0};
     hwc_rect damageRect = {(int)mXres, (int)mYres, 0, 0};
-    if (mergeDamageRect(mergedRect, damageRect) != NO_ERROR) {
+    mWindowUpdateDamage.clear();
+    if (mergeDamageRect(mWindowUpdateDamage, damageRect) != NO_ERROR) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled");
         return 0;
     }
 
+    hwc_rect mergedRect = {(int)mXres, (int)mYres, 0, 0};
+    if (mWindowUpdateDamage.size() > 0) {
+        if (isPartialUpdateBeneficial(mWindowUpdateDamage))
+            mergedRect = mWindowUpdateDamage.bound();
+        else
+            mergedRect = {0, 0, (int)mXres, (int)mYres};
+    }
+
     if (setWindowUpdate(mergedRect) != NO_ERROR) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled");
         return 0;
@@ -4537,7 +5157,30 @@ int ExynosDisplay::handleWindowUpdate() {
     return 0;
 }
 
-int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect) {
+bool ExynosDisplay::isPartialUpdateBeneficial(const DamageRectSet &damage_set) {
+    /*
+     * The panel takes a single update region, so the cost of a partial
+     * update is its bounding rect plus the extra reconfiguration of the
+     * panel window. Fall back to full update once the bounding rect covers
+     * most of the panel.
+     */
+    hwc_rect bound = damage_set.bound();
+    int64_t boundArea = AREA(bound);
+    int64_t fullArea = (int64_t)mXres * mYres;
+
+    DISPLAY_LOGD(eDebugWindowUpdate,
+                 "damage rects: %zu, dirty area: %" PRId64 ", bound area: %" PRId64 ", full area: %" PRId64,
+                 damage_set.size(), damage_set.area(), boundArea, fullArea);
+
+    if (boundArea * 100 >= fullArea * mDisplayControl.partialUpdateFullThreshold) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "Partial region is too large, use full update");
+        return false;
+    }
+
+    return true;
+}
+
+int ExynosDisplay::mergeDamageRect(DamageRectSet &damage_set, hwc_rect &damage_rect) {
     for (size_t i = 0; i < mLayers.size(); i++) {
         int32_t windowIndex = mLayers[i]->mWindowIndex;
         if ((windowIndex < 0) ||
@@ -4558,14 +5201,14 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
             damage_rect.bottom = mLayers[i]->mDisplayFrame.bottom;
             DISPLAY_LOGD(eDebugWindowUpdate, "Skip layer (origin) : %d, %d, %d, %d",
                          damage_rect.left, damage_rect.top, damage_rect.right, damage_rect.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            damage_set.add(damage_rect);
             hwc_rect prevDst = {mLastDpuData.configs[windowIndex].dst.x, mLastDpuData.configs[windowIndex].dst.y,
                                 mLastDpuData.configs[windowIndex].dst.x + (int)mLastDpuData.configs[windowIndex].dst.w,
                                 mLastDpuData.configs[windowIndex].dst.y + (int)mLastDpuData.configs[windowIndex].dst.h};
             DISPLAY_LOGD(eDebugWindowUpdate, "prev rect(%d, %d, %d, %d)",
                          prevDst.left, prevDst.top, prevDst.right, prevDst.bottom);
 
-            merge_rect = expand(merge_rect, prevDst);
+            damage_set.add(prevDst);
             continue;
         }
 
@@ -4573,7 +5216,7 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
         if (excp == eDamageRegionPartial) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) partial : %d, %d, %d, %d", i,
                          damage_rect.left, damage_rect.top, damage_rect.right, damage_rect.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            damage_set.add(damage_rect);
         } else if (excp == eDamageRegionSkip) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) skip", i);
             continue;
@@ -4587,7 +5230,7 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
                          mLayers[i]->mDisplayFrame.top,
                          mLayers[i]->mDisplayFrame.right,
                          mLayers[i]->mDisplayFrame.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            damage_set.add(damage_rect);
         } else {
             DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled, Skip reason (layer %zu) : %d", i, excp);
             return -1;
@@ -4824,12 +5467,44 @@ void ExynosDisplay::setHWCControl(uint32_t ctrl, int32_t val) {
     case HWC_CTL_ENABLE_EARLY_START_MPP:
         mDisplayControl.earlyStartMPP = (unsigned int)val;
         break;
+    case HWC_CTL_INCREMENTAL_ASSIGN:
+        mDisplayControl.incrementalAssign = (unsigned int)val;
+        break;
+    case HWC_CTL_STATIC_LAYER_CACHE:
+        mDisplayControl.staticLayerCache = (unsigned int)val;
+        break;
+    case HWC_CTL_PREDICTIVE_PRESENT:
+        mDisplayControl.predictivePresent = (unsigned int)val;
+        break;
+    case HWC_CTL_ASSIGN_SOLVER:
+        mDisplayControl.assignSolver = (unsigned int)val;
+        break;
+    case HWC_CTL_ASSIGN_DEADLINE:
+        mDisplayControl.assignDeadlineUs = (val < 0) ? 0 : (uint32_t)val;
+        break;
+    case HWC_CTL_UPDATE_RATE_PRIORITY:
+        mDisplayControl.updateRatePriority = (unsigned int)val;
+        break;
+    case HWC_CTL_PIPELINED_COMMIT:
+        mDisplayControl.pipelinedCommit = (unsigned int)val;
+        break;
+    case HWC_CTL_FOLD_DIM_LAYER:
+        mDisplayControl.foldDimLayer = (unsigned int)val;
+        break;
+    case HWC_CTL_FRAME_CRC:
+        setFrameCrcEnabled(val);
+        break;
     default:
         DISPLAY_LOGE("%s: unsupported HWC_CTL (%d)", __func__, ctrl);
         break;
     }
 }
 
+int32_t ExynosDisplay::updateHdrCapabilities() {
+    return mDisplayInterface->updateHdrCapabilities(mHdrTypes, &mMaxLuminance,
+                                                    &mMaxAverageLuminance, &mMinLuminance);
+}
+
 int32_t ExynosDisplay::getHdrCapabilities(uint32_t *outNumTypes,
                                           int32_t *outTypes, float *outMaxLuminance,
                                           float *outMaxAverageLuminance, float *outMinLuminance) {
@@ -4848,8 +5523,7 @@ int32_t ExynosDisplay::getHdrCapabilities(uint32_t *outNumTypes,
          * Get information only in the first call.
          * Use saved information in the second call.
          */
-        if (mDisplayInterface->updateHdrCapabilities(mHdrTypes, &mMaxLuminance,
-                                                     &mMaxAverageLuminance, &mMinLuminance) != NO_ERROR)
+        if (updateHdrCapabilities() != NO_ERROR)
             return HWC2_ERROR_BAD_CONFIG;
     }
 
@@ -5013,15 +5687,175 @@ int32_t ExynosDisplay::getReadbackBufferFence(int32_t *outFence) {
     return HWC2_ERROR_NONE;
 }
 
-void ExynosDisplay::initDisplayInterface(uint32_t __unused interfaceType,
-                                         void *deviceData, size_t &deviceDataSize) {
-    mDisplayInterface = std::make_unique<ExynosDisplayInterface>();
-    mDisplayInterface->init(mDisplayInfo.displayIdentifier,
+int32_t ExynosDisplay::startReadbackStream(const std::vector<buffer_handle_t> &buffers) {
+    if (!mDisplayControl.readbackSupport) {
+        DISPLAY_LOGE("%s:: readback is not supported", __func__);
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+    return mReadbackRing.start(buffers);
+}
+
+void ExynosDisplay::stopReadbackStream() {
+    mReadbackRing.stop();
+}
+
+int32_t ExynosDisplay::acquireReadbackStreamFrame(buffer_handle_t *outBuffer, int32_t *outFence,
+                                                  uint64_t *outFrameNumber) {
+    return mReadbackRing.acquire(outBuffer, outFence, outFrameNumber);
+}
+
+int32_t ExynosDisplay::releaseReadbackStreamFrame(buffer_handle_t buffer, int32_t releaseFence) {
+    return mReadbackRing.release(buffer, releaseFence);
+}
+
+void ExynosDisplay::setupReadbackStreamFrame() {
+    mReadbackRingBuffer = nullptr;
+
+    /* Readback requested by framework or capture has priority */
+    if (mDpuData.enable_readback || !mReadbackRing.isRunning())
+        return;
+
+    if ((mReadbackRingBuffer = mReadbackRing.dequeue()) == nullptr) {
+        DISPLAY_LOGD(eDebugWinConfig, "%s:: there is no free readback slot", __func__);
+        return;
+    }
+
+    setReadbackBufferInternal(mReadbackRingBuffer, -1);
+    mDpuData.enable_readback = true;
+}
+
+void ExynosDisplay::queueReadbackStreamFrame() {
+    if (mReadbackRingBuffer == nullptr)
+        return;
+
+    int32_t fence = -1;
+    getReadbackBufferFence(&fence);
+    mReadbackRing.queue(mReadbackRingBuffer, fence);
+    mReadbackRingBuffer = nullptr;
+}
+
+int32_t ExynosDisplay::getDisplayedContentSamplingAttributes(int32_t *outFormat,
+                                                             int32_t *outDataspace,
+                                                             uint8_t *outComponentMask) {
+    int32_t ret = getReadbackBufferAttributes(outFormat, outDataspace);
+    if (ret != HWC2_ERROR_NONE)
+        return ret;
+
+    if (!ExynosContentSampler::isFormatSupported(*outFormat)) {
+        DISPLAY_LOGD(eDebugDefault, "%s:: readback format(0x%x) can't be sampled",
+                     __func__, *outFormat);
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+    *outComponentMask = HAL_COMPONENT_R | HAL_COMPONENT_G | HAL_COMPONENT_B | HAL_COMPONENT_A;
+    return HWC2_ERROR_NONE;
+}
+
+int32_t ExynosDisplay::setDisplayedContentSamplingEnabled(int32_t enabled,
+                                                          uint8_t componentMask,
+                                                          uint64_t maxFrames) {
+    if (enabled == HWC2_DISPLAYED_CONTENT_SAMPLING_DISABLE) {
+        mContentSampler->disable();
+        return HWC2_ERROR_NONE;
+    }
+    if (enabled != HWC2_DISPLAYED_CONTENT_SAMPLING_ENABLE)
+        return HWC2_ERROR_BAD_PARAMETER;
+
+    int32_t format = 0;
+    int32_t dataspace = 0;
+    uint8_t supportedMask = 0;
+    int32_t ret = getDisplayedContentSamplingAttributes(&format, &dataspace, &supportedMask);
+    if (ret != HWC2_ERROR_NONE)
+        return ret;
+
+    /* 0 means all of supported components */
+    if (componentMask == 0)
+        componentMask = supportedMask;
+    if (componentMask & ~supportedMask)
+        return HWC2_ERROR_BAD_PARAMETER;
+
+    return mContentSampler->enable(format, mXres, mYres, componentMask, maxFrames);
+}
+
+int32_t ExynosDisplay::getDisplayedContentSample(uint64_t maxFrames, uint64_t timestamp,
+                                                 uint64_t *outFrameCount, int32_t outSamplesSize[4],
+                                                 uint64_t *outSamples[4]) {
+    return mContentSampler->getSample(maxFrames, timestamp, outFrameCount,
+                                      outSamplesSize, outSamples);
+}
+
+void ExynosDisplay::setupContentSampleFrame() {
+    mContentSampleBuffer = nullptr;
+
+    if (!mContentSampler->isEnabled())
+        return;
+
+    /* Readback requested by framework or readback stream has priority */
+    if ((mContentSampleBuffer =
+             mContentSampler->dequeueFrame(!mDpuData.enable_readback)) == nullptr)
+        return;
+
+    setReadbackBufferInternal(mContentSampleBuffer, -1);
+    mDpuData.enable_readback = true;
+}
+
+void ExynosDisplay::queueContentSampleFrame() {
+    if (mContentSampleBuffer == nullptr)
+        return;
+
+    int32_t fence = -1;
+    getReadbackBufferFence(&fence);
+    mContentSampler->queueFrame(mContentSampleBuffer, fence);
+    mContentSampleBuffer = nullptr;
+}
+
+int32_t ExynosDisplay::setFrameCrcEnabled(bool enabled) {
+    if (!enabled) {
+        mFrameCrc->disable();
+        return HWC2_ERROR_NONE;
+    }
+
+    int32_t format = 0;
+    int32_t dataspace = 0;
+    int32_t ret = getReadbackBufferAttributes(&format, &dataspace);
+    if (ret != HWC2_ERROR_NONE)
+        return ret;
+
+    return mFrameCrc->enable(format, mXres, mYres);
+}
+
+void ExynosDisplay::setupFrameCrcFrame() {
+    mFrameCrcBuffer = nullptr;
+
+    if (!mFrameCrc->isEnabled())
+        return;
+
+    /* Other users of readback have priority */
+    if ((mFrameCrcBuffer = mFrameCrc->dequeueFrame(!mDpuData.enable_readback)) == nullptr)
+        return;
+
+    setReadbackBufferInternal(mFrameCrcBuffer, -1);
+    mDpuData.enable_readback = true;
+}
+
+void ExynosDisplay::queueFrameCrcFrame() {
+    if (mFrameCrcBuffer == nullptr)
+        return;
+
+    int32_t fence = -1;
+    getReadbackBufferFence(&fence);
+    mFrameCrc->queueFrame(mFrameCrcBuffer, fence);
+    mFrameCrcBuffer = nullptr;
+}
+
+void ExynosDisplay::initDisplayInterface(uint32_t __unused interfaceType,
+                                         void *deviceData, size_t &deviceDataSize) {
+    mDisplayInterface = std::make_unique<ExynosDisplayInterface>();
+    mDisplayInterface->init(mDisplayInfo.displayIdentifier,
                             deviceData, deviceDataSize);
 }
 
 void ExynosDisplay::setDumpCount(uint32_t dumpCount) {
-    if (mLayerDumpManager->isRunning()) {
+    if (!mLayerDumpManager->isIdle()) {
         DISPLAY_LOGE("%s::Dump request is not compeleted", __func__);
         return;
     }
@@ -5110,10 +5944,16 @@ void ExynosDisplay::getDumpLayer() {
     frameInfo->layerDumpState = LAYER_DUMP_DONE;
 }
 
+/* The files are written on the dump thread not to block presentDisplay() */
 void ExynosDisplay::dumpLayers() {
-    int32_t frameIndex = mLayerDumpManager->getDumpFrameIndex();
+    DISPLAY_LOGD(eDebugHWC, "debug_dump_source finished dump file index=%d",
+                 mLayerDumpManager->getDumpFrameIndex());
+    mLayerDumpManager->requestWrite();
+}
+
+void ExynosDisplay::writeDumpLayers() {
     int32_t maxIndex = mLayerDumpManager->getDumpMaxIndex();
-    DISPLAY_LOGD(eDebugHWC, "debug_dump_source finished dump file index=%d", frameIndex);
+
     for (int j = 0; j <= maxIndex; j++) {
         layerDumpFrameInfo *temp = mLayerDumpManager->getLayerDumpFrameInfo(j);
         for (int i = 0; i < temp->layerDumpCnt; i++) {
@@ -5134,12 +5974,57 @@ void ExynosDisplay::dumpLayers() {
             }
         }
     }
-    mLayerDumpManager->stop();
+}
+
+/*
+ * Writes @len bytes of @data to @path by one write. The file is compressed to
+ * the LZ4 frame format in @path.lz4 with USE_LAYER_DUMP_LZ4. Returns 1 on
+ * success as fwrite() of one item.
+ */
+static size_t writeDumpFile(const char *path, const void *data, size_t len) {
+    std::vector<uint8_t> compressed;
+    char lz4Path[MAX_DEV_NAME + 4];
+
+#ifdef USE_LAYER_DUMP_LZ4
+    compressed.resize(LZ4F_compressFrameBound(len, NULL));
+    size_t compressedLen = LZ4F_compressFrame(compressed.data(), compressed.size(), data, len, NULL);
+    if (!LZ4F_isError(compressedLen)) {
+        snprintf(lz4Path, sizeof(lz4Path), "%s.lz4", path);
+        path = lz4Path;
+        data = compressed.data();
+        len = compressedLen;
+    } else {
+        ALOGE("debug_dump_source failed to compress %s: %s", path, LZ4F_getErrorName(compressedLen));
+    }
+#else
+    (void)lz4Path;
+#endif
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return 0;
+
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    size_t remain = len;
+
+    while (remain > 0) {
+        ssize_t ret = write(fd, p, remain);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        p += ret;
+        remain -= ret;
+    }
+
+    close(fd);
+
+    return (remain == 0) ? 1 : 0;
 }
 
 void ExynosDisplay::writeDumpData(int32_t frameNo, int32_t layerNo,
                                   layerDumpFrameInfo *frameInfo, layerDumpLayerInfo *layerInfo) {
-    FILE *fp = NULL;
     size_t result = 0;
     char filePath[MAX_DEV_NAME];
     uint32_t bufferNum = layerInfo->bufferNum;
@@ -5156,11 +6041,8 @@ void ExynosDisplay::writeDumpData(int32_t frameNo, int32_t layerNo,
             sprintf(filePath, "%s/displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw", ERROR_LOG_PATH0, mDisplayId, frameNo,
                     layerNo, format, 0, compositionType, layerInfo->stride, layerInfo->vStride);
 
-        fp = fopen(filePath, "w+");
-        if (fp) {
-            result = fwrite(layerInfo->planeRawData[0], layerInfo->bufferLength[0], 1, fp);
-            fclose(fp);
-        }
+        if (layerInfo->planeRawData[0] != nullptr)
+            result = writeDumpFile(filePath, layerInfo->planeRawData[0], layerInfo->bufferLength[0]);
 
         /* make afbc decoding script file */
         if (compressionType == COMP_TYPE_AFBC) {
@@ -5196,40 +6078,38 @@ void ExynosDisplay::writeDumpData(int32_t frameNo, int32_t layerNo,
         sprintf(filePath, "%s/displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw", ERROR_LOG_PATH0, mDisplayId, frameNo,
                 layerNo, format, 0, compositionType, layerInfo->stride, layerInfo->vStride);
 
-        //forbit apend buffer when file has exited.so before each dumping,clear file
-        fp = fopen(filePath, "w+");
-        if (fp) {
-            fclose(fp);
-        }
+        if (layerInfo->planeRawData[0] == nullptr)
+            return;
+
+        /* The lines of the planes are packed and written at once */
+        std::vector<uint8_t> packed;
         for (uint32_t start = 0; start < bufferNum; start++) {
             DISPLAY_LOGD(eDebugHWC, "debug_dump_source yuv data enter start_times=%d", start);
-            fp = fopen(filePath, "a+");
-
-            if (fp) {
-                int align_width = layerInfo->stride;
-                int width = layerInfo->width;
-                int height = start == 0 ? layerInfo->height : layerInfo->height / 2;
-                if (bufferNum == 3 && start != 0) {
-                    height = layerInfo->height / 4;
-                }
-                result = yuvWriteByLines(layerInfo->planeRawData[0], align_width, width, height, fp);
-                fclose(fp);
+            int align_width = layerInfo->stride;
+            int width = layerInfo->width;
+            int height = start == 0 ? layerInfo->height : layerInfo->height / 2;
+            if (bufferNum == 3 && start != 0) {
+                height = layerInfo->height / 4;
             }
-            DISPLAY_LOGD(eDebugHWC, "debug_dump_source Frame Dump %s: is %s result=%s mLayers.size=%zu", filePath, result ? "Successful" : "Failed", result ? "1" : strerror(errno), mLayers.size());
+            yuvPackLines(layerInfo->planeRawData[0], align_width, width, height, packed);
         }
+        result = writeDumpFile(filePath, packed.data(), packed.size());
+        DISPLAY_LOGD(eDebugHWC, "debug_dump_source Frame Dump %s: is %s result=%s mLayers.size=%zu", filePath, result ? "Successful" : "Failed", result ? "1" : strerror(errno), mLayers.size());
     }
 }
 
-size_t ExynosDisplay::yuvWriteByLines(void *temp, int align_Width, int original_Width, int original_Height, FILE *fp) {
-    size_t result = 0;
-
-    DISPLAY_LOGD(eDebugHWC, "debug_dump_source yuvWriteByLines enter align_Width=%d original_Width=%d, original_Height=%d",
+void ExynosDisplay::yuvPackLines(const void *temp, int align_Width, int original_Width, int original_Height,
+                                 std::vector<uint8_t> &out) {
+    DISPLAY_LOGD(eDebugHWC, "debug_dump_source yuvPackLines enter align_Width=%d original_Width=%d, original_Height=%d",
                  align_Width, original_Width, original_Height);
 
+    const uint8_t *src = static_cast<const uint8_t *>(temp);
+
+    out.reserve(out.size() + (size_t)original_Width * original_Height);
     for (int h = 0; h < original_Height; h++) {
-        result = fwrite((char *)temp + h * align_Width, original_Width, 1, fp);
+        const uint8_t *line = src + (size_t)h * align_Width;
+        out.insert(out.end(), line, line + original_Width);
     }
-    return result;
 }
 
 void ExynosDisplay::setPresentState() {
@@ -5267,6 +6147,42 @@ int32_t ExynosDisplay::updateColorConversionInfo() {
 
     bool hasHdrLayer =
         mDisplayInfo.hdrLayersIndex.size() ? true : false;
+
+    struct HdrCoefChannel {
+        ExynosMPP *otfMPP;
+        exynos_image *image;
+        enum RenderSource renderSource;
+    };
+    std::vector<HdrCoefChannel> channels;
+    auto addChannel = [&](ExynosMPP *otfMPP, exynos_image &image, enum RenderSource renderSource) {
+        if (otfMPP != nullptr)
+            channels.push_back({otfMPP, &image, renderSource});
+    };
+    addChannel(mExynosCompositionInfo.mOtfMPP, mExynosCompositionInfo.mSrcImg, REND_G2D);
+    addChannel(mClientCompositionInfo.mOtfMPP, mClientCompositionInfo.mSrcImg, REND_GPU);
+    for (auto layer : mLayers)
+        addChannel(layer->mOtfMPP, layer->mSrcImg, REND_ORI);
+
+    /* Channels of the display that are not used in this frame are unknown */
+    for (auto mpp : ExynosResourceManager::getOtfMPPs()) {
+        if (mpp->mAssignedDisplayInfo.displayIdentifier.id == mDisplayId)
+            mpp->mHdrCoefPendingFingerprint = 0;
+    }
+
+    bool changed = false;
+    for (auto &channel : channels) {
+        uint64_t fingerprint = getHdrCoefFingerprint(*channel.image, channel.renderSource, hasHdrLayer);
+        channel.otfMPP->mHdrCoefPendingFingerprint = fingerprint;
+        if (fingerprint != channel.otfMPP->mHdrCoefFingerprint)
+            changed = true;
+    }
+
+    /* Coefficients of all channels are in their parcels already */
+    if (!changed) {
+        mHdrCoefBuildupSkipCnt++;
+        return NO_ERROR;
+    }
+
     mHdrCoefInterface->initHdrCoefBuildup(HDR_HW_DPU);
     mHdrCoefInterface->setHDRlayer(hasHdrLayer);
 
@@ -5287,34 +6203,13 @@ int32_t ExynosDisplay::updateColorConversionInfo() {
     };
 
     int32_t tmpRet = NO_ERROR;
-    ExynosMPP *otfMPP = mExynosCompositionInfo.mOtfMPP;
-    if (otfMPP != nullptr) {
-        if ((tmpRet = setHdrCoefLayerInfo(otfMPP, mExynosCompositionInfo.mSrcImg,
-                                          REND_G2D)) != NO_ERROR) {
-            DISPLAY_LOGE("%s:: ExynosComposition setHdrCoefLayerInfo() "
-                         "error(%d)",
-                         __func__, tmpRet);
-            ret = tmpRet;
-        }
-    }
-    otfMPP = mClientCompositionInfo.mOtfMPP;
-    if (otfMPP != nullptr) {
-        if ((tmpRet = setHdrCoefLayerInfo(otfMPP, mClientCompositionInfo.mSrcImg,
-                                          REND_GPU)) != NO_ERROR) {
-            DISPLAY_LOGE("%s:: ClientComposition setHdrCoefLayerInfo() "
-                         "error(%d)",
-                         __func__, tmpRet);
-            ret = tmpRet;
-        }
-    }
-    for (auto layer : mLayers) {
-        otfMPP = layer->mOtfMPP;
-        if (otfMPP == nullptr)
-            continue;
-        if ((tmpRet = setHdrCoefLayerInfo(otfMPP, layer->mSrcImg,
-                                          REND_ORI)) != NO_ERROR) {
-            DISPLAY_LOGE("%s:: layer setHdrCoefLayerInfo() error(%d)",
-                         __func__, tmpRet);
+    for (auto &channel : channels) {
+        if ((tmpRet = setHdrCoefLayerInfo(channel.otfMPP, *channel.image,
+                                          channel.renderSource)) != NO_ERROR) {
+            DISPLAY_LOGE("%s:: source(%d) setHdrCoefLayerInfo() error(%d)",
+                         __func__, channel.renderSource, tmpRet);
+            /* The coefficients are fetched again in the next frame */
+            channel.otfMPP->mHdrCoefPendingFingerprint = 0;
             ret = tmpRet;
         }
     }
@@ -5328,17 +6223,89 @@ void ExynosDisplay::checkLayersForRevertingDR(uint64_t &geometryChanged) {
     if (mDynamicRecompMode != DEVICE_TO_CLIENT)
         return;
 
-    for (uint32_t i = 0; i < mLayers.size(); i++) {
-        if ((mLayers[i]->mLastLayerBuffer != mLayers[i]->mLayerBuffer) || geometryChanged) {
-            mDynamicRecompMode = CLIENT_TO_DEVICE;
-            DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] CLIENT TO DEVICE");
-            setGeometryChanged(GEOMETRY_DISPLAY_DYNAMIC_RECOMPOSITION, geometryChanged);
-            return;
-        }
+    if (mLayerSummary.updatedLayerNum || geometryChanged) {
+        mDynamicRecompMode = CLIENT_TO_DEVICE;
+        DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] CLIENT TO DEVICE");
+        setGeometryChanged(GEOMETRY_DISPLAY_DYNAMIC_RECOMPOSITION, geometryChanged);
+        return;
     }
     setGeometryChanged(GEOMETRY_DISPLAY_DYNAMIC_RECOMPOSITION, geometryChanged);
 }
 
+bool ExynosDisplay::isStaticLayerCacheCandidate(ExynosLayer *layer) {
+    return ((layer->mLayerBuffer != NULL) &&
+            (layer->mCompositionType == HWC2_COMPOSITION_DEVICE) &&
+            (layer->mOverlayPriority < ePriorityHigh) &&
+            (layer->isDimLayer() == false) &&
+            (layer->mStaticFrameCount >= mDisplayControl.staticLayerCacheFrames));
+}
+
+void ExynosDisplay::updateStaticLayerCache(uint64_t &geometryChanged) {
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        if ((layer->mLastLayerBuffer != layer->mLayerBuffer) ||
+            (layer->mGeometryChanged != 0))
+            layer->mStaticFrameCount = 0;
+        else if (layer->mStaticFrameCount < UINT32_MAX)
+            layer->mStaticFrameCount++;
+    }
+
+    if ((mDisplayControl.staticLayerCache == false) ||
+        (mUseDpu == false) || (mType == HWC_DISPLAY_VIRTUAL) ||
+        (mDisplayControl.skipM2mProcessing == false)) {
+        if (mStaticLayerCache.active) {
+            mStaticLayerCache.reset();
+            setGeometryChanged(GEOMETRY_DISPLAY_STATIC_LAYER_CACHE, geometryChanged);
+        }
+        return;
+    }
+
+    if (mStaticLayerCache.active) {
+        bool changed = ((mGeometryChanged & GEOMETRY_DISPLAY_LAYER_ADDED) ||
+                        (mGeometryChanged & GEOMETRY_DISPLAY_LAYER_REMOVED) ||
+                        (mStaticLayerCache.lastIndex >= (int32_t)mLayers.size()));
+        for (int32_t i = mStaticLayerCache.firstIndex;
+             !changed && (i <= mStaticLayerCache.lastIndex); i++) {
+            if (mLayers[i]->mStaticFrameCount == 0)
+                changed = true;
+        }
+        if (changed) {
+            DISPLAY_LOGD(eDebugSkipStaicLayer, "static layer cache [%d] - [%d] is released",
+                         mStaticLayerCache.firstIndex, mStaticLayerCache.lastIndex);
+            mStaticLayerCache.reset();
+            setGeometryChanged(GEOMETRY_DISPLAY_STATIC_LAYER_CACHE, geometryChanged);
+        }
+        return;
+    }
+
+    /* Find the longest run of idle layers */
+    int32_t firstIndex = -1, lastIndex = -1;
+    int32_t runStart = -1;
+    for (int32_t i = 0; i < (int32_t)mLayers.size(); i++) {
+        if (!isStaticLayerCacheCandidate(mLayers[i])) {
+            runStart = -1;
+            continue;
+        }
+        if (runStart < 0)
+            runStart = i;
+        if ((i - runStart) > (lastIndex - firstIndex)) {
+            firstIndex = runStart;
+            lastIndex = i;
+        }
+    }
+
+    /* A single layer doesn't save any window */
+    if ((firstIndex < 0) || (lastIndex == firstIndex))
+        return;
+
+    mStaticLayerCache.active = true;
+    mStaticLayerCache.firstIndex = firstIndex;
+    mStaticLayerCache.lastIndex = lastIndex;
+    DISPLAY_LOGD(eDebugSkipStaicLayer, "static layer cache [%d] - [%d] is set",
+                 firstIndex, lastIndex);
+    setGeometryChanged(GEOMETRY_DISPLAY_STATIC_LAYER_CACHE, geometryChanged);
+}
+
 #ifdef USE_DQE_INTERFACE
 bool ExynosDisplay::needDqeSetting() {
     /* If dqe interface is changed to pass HDR info,
@@ -5359,28 +6326,169 @@ void ExynosDisplay::setDqeCoef(int fd) {
 
 constexpr int maxWaitTime = 20000; /* 20s */
 void ExynosDisplay::waitPreviousFrameDone(int fence) {
-    struct timeval tv_s, tv_e;
-    long timediff;
+    if (!mFenceTracer.fence_valid(fence))
+        return;
+
+    ExynosLatencyStats::Scope latencyScope(mDisplayId, LATENCY_STAGE_PREV_FRAME_WAIT);
+
+    /* The previous frame is mostly done already, it is checked without blocking */
+    if (sync_wait(fence, 0) == 0)
+        return;
+
+    ATRACE_CALL();
+    HWC_TRACE_EVENT("fence_wait", "display", mDisplayId, "fence", fence);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
 
     /* wait for 5 vsync */
     int32_t waitTime = mVsyncPeriod / 1000000 * 5;
-    gettimeofday(&tv_s, NULL);
-    if (mFenceTracer.fence_valid(fence)) {
-        ATRACE_CALL();
-        if (sync_wait(fence, waitTime) < 0) {
-            DISPLAY_LOGW("%s:: fence(%d) is not released during (%d ms)",
-                         __func__, fence, waitTime);
-            if (sync_wait(fence, maxWaitTime) < 0) {
-                DISPLAY_LOGE("%s:: fence sync wait error (%d)", __func__, fence);
-            } else {
-                gettimeofday(&tv_e, NULL);
-                tv_e.tv_usec += (tv_e.tv_sec - tv_s.tv_sec) * 1000000;
-                timediff = tv_e.tv_usec - tv_s.tv_usec;
-                DISPLAY_LOGE("%s:: winconfig is delayed over 5 vysnc (fence:%d)(time:%ld)",
-                             __func__, fence, timediff);
-            }
+    if (sync_wait(fence, waitTime) < 0) {
+        DISPLAY_LOGW("%s:: fence(%d) is not released during (%d ms)",
+                     __func__, fence, waitTime);
+        if (sync_wait(fence, maxWaitTime) < 0) {
+            DISPLAY_LOGE("%s:: fence sync wait error (%d)", __func__, fence);
+        } else {
+            DISPLAY_LOGE("%s:: winconfig is delayed over 5 vysnc (fence:%d)(time:%" PRId64 ")",
+                         __func__, fence, ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - start));
+        }
+    }
+}
+
+void ExynosDisplay::setExpectedPresentTime(nsecs_t expectedPresentTime) {
+    mPresentSchedule.expectedPresentTime = expectedPresentTime;
+}
+
+void ExynosDisplay::schedulePresentCommit() {
+    PresentScheduleInfo &schedule = mPresentSchedule;
+    nsecs_t period = mVsyncModel.getPeriod(mVsyncPeriod);
+    /* Expected present time is valid only for the frame it was set with */
+    nsecs_t expectedPresentTime = schedule.expectedPresentTime;
+    schedule.expectedPresentTime = 0;
+
+    if (((mDisplayControl.predictivePresent == false) && (expectedPresentTime == 0)) ||
+        (period == 0) || (mPowerModeState != HWC2_POWER_MODE_ON)) {
+        schedule.targetVsync = 0;
+        return;
+    }
+
+    ATRACE_CALL();
+    /* Previous frame is done, check whether it was flipped at the target vsync */
+    nsecs_t lastFlip = getFenceSignalTime(mLastPresentFence);
+    if ((schedule.targetVsync > 0) && (lastFlip > 0)) {
+        if (lastFlip > (schedule.targetVsync + period / 2)) {
+            schedule.missCount++;
+            schedule.margin = min(schedule.margin * 2, period / 2);
+        } else {
+            schedule.hitCount++;
+            schedule.margin = max(schedule.margin - schedule.margin / 16,
+                                  PresentScheduleInfo::kMinMargin);
+        }
+    }
+    schedule.targetVsync = 0;
+
+    nsecs_t commitLatency = us2ns((nsecs_t)ExynosLatencyStats::getInstance().getPercentile(
+        mDisplayId, LATENCY_STAGE_INTERFACE_DELIVER, 99));
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t phase = max(lastFlip, schedule.lastHwVsync);
+    auto nextVsync = [&](nsecs_t time) -> nsecs_t {
+        nsecs_t vsync = mVsyncModel.getNextVsync(time);
+        if ((vsync == 0) && (phase > 0))
+            vsync = phase + (((time - phase) / period) + 1) * period;
+        return vsync;
+    };
+
+    nsecs_t target = nextVsync(now);
+    if (target == 0)
+        return;
+
+    /* Client wants this frame to be shown at a later vsync, hold the commit until then */
+    bool holdForExpected = false;
+    if ((expectedPresentTime > target + period / 2) &&
+        (expectedPresentTime - now <= PresentScheduleInfo::kMaxExpectedPresentDelay)) {
+        nsecs_t expectedVsync = nextVsync(expectedPresentTime - period / 2);
+        if (expectedVsync > target) {
+            target = expectedVsync;
+            holdForExpected = true;
         }
     }
+
+    if (!holdForExpected &&
+        ((mDisplayControl.predictivePresent == false) ||
+         (commitLatency + schedule.margin >= period)))
+        return;
+
+    nsecs_t wakeup = target - commitLatency - schedule.margin;
+    /* Too late for this vsync already, commit right away */
+    if (wakeup <= now)
+        return;
+
+    DISPLAY_LOGD(eDebugWinConfig, "%s:: delay commit %" PRId64 " ns, target vsync %" PRId64,
+                 __func__, wakeup - now, target);
+    struct timespec ts = {.tv_sec = (time_t)(wakeup / 1000000000LL),
+                          .tv_nsec = (long)(wakeup % 1000000000LL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+    schedule.targetVsync = target;
+    if (holdForExpected)
+        schedule.heldCount++;
+}
+
+void ExynosDisplay::updateFramePacing() {
+    FramePacingInfo &pacing = mFramePacing;
+    FramePacingInfo::Frame &frame = pacing.n2Frame;
+    nsecs_t signalTime = getFenceSignalTime(mN2PresentFence);
+
+    if ((frame.targetVsync > 0) && (frame.period > 0) && (signalTime > 0)) {
+        nsecs_t slip = 0;
+        if (signalTime > frame.targetVsync)
+            slip = (signalTime - frame.targetVsync + frame.period / 2) / frame.period;
+
+        FramePacingInfo::Stats &stats = pacing.stats[frame.config];
+        stats.slip[min(slip, (nsecs_t)FramePacingInfo::kSlipBuckets - 1)]++;
+        stats.repeatedFrames += slip;
+    }
+
+    /* Target of this frame, it is accounted when it becomes mN2PresentFence */
+    nsecs_t period = mVsyncModel.getPeriod(mVsyncPeriod);
+    /* Vsync the commit was held for, it is left from an older frame if it is in the past */
+    nsecs_t target = mPresentSchedule.targetVsync;
+    if (target < pacing.presentStart)
+        target = 0;
+    if ((target == 0) && (period > 0)) {
+        target = mVsyncModel.getNextVsync(pacing.presentStart);
+        uint64_t lastVsync = mPresentSchedule.lastHwVsync;
+        if ((target == 0) && (lastVsync == 0))
+            getDisplayVsyncTimestamp(&lastVsync);
+        if ((target == 0) && (lastVsync > 0) && (pacing.presentStart >= (nsecs_t)lastVsync))
+            target = lastVsync + ((pacing.presentStart - lastVsync) / period + 1) * period;
+    }
+
+    pacing.n2Frame = pacing.lastFrame;
+    pacing.lastFrame = {.targetVsync = target, .period = period, .config = mActiveConfig};
+}
+
+void ExynosDisplay::dumpFramePacing(String8 &result) {
+    if (mFramePacing.stats.empty())
+        return;
+
+    result.append("frame pacing (slip in vsync: 0, 1, ..., repeated frames)\n");
+    for (auto &it : mFramePacing.stats) {
+        result.appendFormat("\tconfig[%u]:", it.first);
+        for (auto count : it.second.slip)
+            result.appendFormat(" %" PRIu64, count);
+        result.appendFormat(", repeated: %" PRIu64 "\n", it.second.repeatedFrames);
+    }
+}
+
+int32_t ExynosDisplay::getFramePacingStats(uint32_t config, FramePacingInfo::Stats &outStats) {
+    Mutex::Autolock lock(mDisplayMutex);
+
+    auto it = mFramePacing.stats.find(config);
+    if (it == mFramePacing.stats.end())
+        return HWC2_ERROR_BAD_CONFIG;
+
+    outStats = it->second;
+    return HWC2_ERROR_NONE;
 }
 
 int32_t ExynosDisplay::getDisplayInfo(DisplayInfo &dispInfo) {
@@ -5407,6 +6515,7 @@ int32_t ExynosDisplay::getDisplayInfo(DisplayInfo &dispInfo) {
     dispInfo.adjustDisplayFrame = mDisplayControl.adjustDisplayFrame;
     dispInfo.cursorSupport = mDisplayControl.cursorSupport;
     dispInfo.skipM2mProcessing = mDisplayControl.skipM2mProcessing;
+    dispInfo.updateRatePriority = mDisplayControl.updateRatePriority;
     dispInfo.baseWindowIndex = mBaseWindowIndex;
     dispInfo.defaultDMA = mDefaultDMA;
 
@@ -5419,9 +6528,18 @@ int32_t ExynosDisplay::setColorConversionInfo(ExynosMPP *otfMPP) {
     if (mHdrCoefInterface == nullptr)
         return NO_ERROR;
 
+    /* The parcel has the coefficients of the same layer info already */
+    if ((otfMPP->mHdrCoefPendingFingerprint != 0) &&
+        (otfMPP->mHdrCoefPendingFingerprint == otfMPP->mHdrCoefFingerprint)) {
+        mHdrCoefWriteSkipCnt++;
+        return NO_ERROR;
+    }
+
     struct hdrCoefParcel data;
     data.hdrCoef = otfMPP->mHdrCoefAddr;
-    return mHdrCoefInterface->getHdrCoefData(HDR_HW_DPU, otfMPP->mChId, &data);
+    int32_t ret = mHdrCoefInterface->getHdrCoefData(HDR_HW_DPU, otfMPP->mChId, &data);
+    otfMPP->mHdrCoefFingerprint = (ret == NO_ERROR) ? otfMPP->mHdrCoefPendingFingerprint : 0;
+    return ret;
 }
 
 void ExynosDisplay::setSrcAcquireFences() {
@@ -5432,12 +6550,61 @@ void ExynosDisplay::setSrcAcquireFences() {
 }
 
 void ExynosDisplay::handleVsync(uint64_t timestamp) {
-    Mutex::Autolock lock(mDisplayMutex);
     if (timestamp == 0)
         getDisplayVsyncTimestamp(&timestamp);
 
+    /*
+     * Config change handling needs mDisplayMutex.
+     * Queue the timestamp instead of waiting if present holds the lock,
+     * it is handled by the lock holder.
+     */
+    if (mDisplayMutex.tryLock() == NO_ERROR) {
+        processPendingVsyncEvents();
+        handleVsyncLocked(timestamp);
+        mDisplayMutex.unlock();
+    } else if (!mPendingVsyncEvents.push(timestamp)) {
+        DISPLAY_LOGD(eDebugDisplayConfig, "%s:: pending vsync queue is full", __func__);
+    }
+
+    if (mRefreshRateDebugEnabled)
+        deliverRefreshRateChanges((nsecs_t)timestamp);
+
+    if (!mVsyncCallback.getVSyncEnabled()) {
+        return;
+    }
+
+    if (mIsVsyncDisplay) {
+        /* Vsync callback must pass display ID of primary display 0. */
+        auto vsyncCallbackInfo =
+            mCallbackInfos[HWC2_CALLBACK_VSYNC];
+        if (vsyncCallbackInfo.funcPointer &&
+            vsyncCallbackInfo.callbackData)
+            ((HWC2_PFN_VSYNC)vsyncCallbackInfo.funcPointer)(
+                vsyncCallbackInfo.callbackData,
+                getDisplayId(HWC_DISPLAY_PRIMARY, 0), timestamp);
+
+        auto vsync_2_4CallbackInfo =
+            mCallbackInfos[HWC2_CALLBACK_VSYNC_2_4];
+        if (vsync_2_4CallbackInfo.funcPointer &&
+            vsync_2_4CallbackInfo.callbackData)
+            ((HWC2_PFN_VSYNC_2_4)vsync_2_4CallbackInfo.funcPointer)(
+                vsync_2_4CallbackInfo.callbackData,
+                getDisplayId(HWC_DISPLAY_PRIMARY, 0), timestamp, mVsyncPeriod);
+    }
+}
+
+void ExynosDisplay::processPendingVsyncEvents() {
+    uint64_t timestamp = 0;
+    while (mPendingVsyncEvents.pop(timestamp))
+        handleVsyncLocked(timestamp);
+}
+
+void ExynosDisplay::handleVsyncLocked(uint64_t timestamp) {
     bool configApplied = true;
 
+    mPresentSchedule.lastHwVsync = (nsecs_t)timestamp;
+    mVsyncModel.addVsync((nsecs_t)timestamp, mVsyncPeriod);
+
     if (mConfigRequestState == hwc_request_state_t::SET_CONFIG_STATE_REQUESTED) {
         hwc2_vsync_period_t vsyncPeriod;
         if (mDisplayInterface->getDisplayVsyncPeriod(&vsyncPeriod) ==
@@ -5471,34 +6638,167 @@ void ExynosDisplay::handleVsync(uint64_t timestamp) {
         }
     }
 
-    if (mDisplayId == getDisplayId(HWC_DISPLAY_PRIMARY, 0)) {
+    bool isPrimary = (mDisplayId == getDisplayId(HWC_DISPLAY_PRIMARY, 0));
+    if (isPrimary || mRefreshRateDebugEnabled) {
         hwc2_vsync_period_t curPeriod;
         getDisplayVsyncPeriodInternal(&curPeriod);
-        ATRACE_INT("fps", std::chrono::nanoseconds(1s).count() / curPeriod);
+        if (isPrimary)
+            ATRACE_INT("fps", std::chrono::nanoseconds(1s).count() / curPeriod);
+        if (mRefreshRateDebugEnabled)
+            recordRefreshRateChange((nsecs_t)timestamp, curPeriod);
     }
+}
 
-    if (!mVsyncCallback.getVSyncEnabled()) {
+int32_t ExynosDisplay::setRefreshRateChangedDebugEnabled(bool enabled) {
+    Mutex::Autolock lock(mDisplayMutex);
+    if (enabled == mRefreshRateDebugEnabled)
+        return HWC2_ERROR_NONE;
+
+    /* Current refresh rate is reported first */
+    mObservedVsyncPeriod = 0;
+    mLastRefreshRateDelivery = 0;
+    mRefreshRateDebugEnabled = enabled;
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosDisplay::recordRefreshRateChange(nsecs_t timestamp, hwc2_vsync_period_t vsyncPeriod) {
+    if ((vsyncPeriod == 0) || (vsyncPeriod == mObservedVsyncPeriod))
+        return;
+
+    mObservedVsyncPeriod = vsyncPeriod;
+    if (!mRefreshRateChanges.push({timestamp, vsyncPeriod})) {
+        mRefreshRateChangeDropped++;
         return;
     }
+    mRefreshRateChangeCount.fetch_add(1, std::memory_order_relaxed);
+}
 
-    if (mIsVsyncDisplay) {
-        /* Vsync callback must pass display ID of primary display 0. */
-        auto vsyncCallbackInfo =
-            mCallbackInfos[HWC2_CALLBACK_VSYNC];
-        if (vsyncCallbackInfo.funcPointer &&
-            vsyncCallbackInfo.callbackData)
-            ((HWC2_PFN_VSYNC)vsyncCallbackInfo.funcPointer)(
-                vsyncCallbackInfo.callbackData,
-                getDisplayId(HWC_DISPLAY_PRIMARY, 0), timestamp);
+void ExynosDisplay::deliverRefreshRateChanges(nsecs_t now) {
+    if (mRefreshRateChanges.empty())
+        return;
 
-        auto vsync_2_4CallbackInfo =
-            mCallbackInfos[HWC2_CALLBACK_VSYNC_2_4];
-        if (vsync_2_4CallbackInfo.funcPointer &&
-            vsync_2_4CallbackInfo.callbackData)
-            ((HWC2_PFN_VSYNC_2_4)vsync_2_4CallbackInfo.funcPointer)(
-                vsync_2_4CallbackInfo.callbackData,
-                getDisplayId(HWC_DISPLAY_PRIMARY, 0), timestamp, mVsyncPeriod);
+    if (((now - mLastRefreshRateDelivery) < kRefreshRateDeliverInterval) &&
+        (mRefreshRateChangeCount.load(std::memory_order_relaxed) < (kRefreshRateChangeNum / 2)))
+        return;
+
+    auto callbackInfo = mCallbackInfos[HWC2_CALLBACK_REFRESH_RATE_CHANGED_DEBUG];
+    RefreshRateChange change;
+    while (mRefreshRateChanges.pop(change)) {
+        mRefreshRateChangeCount.fetch_sub(1, std::memory_order_relaxed);
+        if (callbackInfo.funcPointer && callbackInfo.callbackData)
+            ((HWC2_PFN_REFRESH_RATE_CHANGED_DEBUG)callbackInfo.funcPointer)(
+                callbackInfo.callbackData, mDisplayId, change.vsyncPeriod);
+    }
+    mLastRefreshRateDelivery = now;
+}
+
+bool ExynosDisplay::getIdleConfig(hwc2_config_t activeConfig, hwc2_config_t &outConfig) {
+    auto active = mDisplayConfigs.find(activeConfig);
+    if (active == mDisplayConfigs.end())
+        return false;
+
+    /* Only configs in the same group can be changed seamlessly */
+    outConfig = activeConfig;
+    uint32_t maxPeriod = active->second.vsyncPeriod;
+    for (const auto &[id, displayConfig] : mDisplayConfigs) {
+        if ((displayConfig.groupId != active->second.groupId) ||
+            (displayConfig.width != active->second.width) ||
+            (displayConfig.height != active->second.height))
+            continue;
+        if (displayConfig.vsyncPeriod > maxPeriod) {
+            maxPeriod = displayConfig.vsyncPeriod;
+            outConfig = id;
+        }
+    }
+    return outConfig != activeConfig;
+}
+
+bool ExynosDisplay::isIdleTimerSupported() {
+    if (mType != HWC_DISPLAY_PRIMARY)
+        return false;
+
+    hwc2_config_t idleConfig;
+    for (const auto &config : mDisplayConfigs) {
+        if (getIdleConfig(config.first, idleConfig))
+            return true;
+    }
+    return false;
+}
+
+int32_t ExynosDisplay::setIdleTimerEnabled(int32_t timeoutMs) {
+    if (timeoutMs < 0)
+        return HWC2_ERROR_BAD_PARAMETER;
+    if (!isIdleTimerSupported())
+        return HWC2_ERROR_UNSUPPORTED;
+
+    {
+        /* Timer thread is joined here, mDisplayMutex should not be held */
+        std::lock_guard<std::mutex> lock(mIdleTimerMutex);
+        if (timeoutMs == 0) {
+            mIdleTimer.reset();
+        } else if (!mIdleTimer) {
+            mIdleTimer.emplace(std::chrono::milliseconds(timeoutMs), [] {},
+                               [this] { handleIdleTimeout(); });
+            mIdleTimer->start();
+        } else if (timeoutMs != mIdleTimeoutMs) {
+            mIdleTimer->setInterval(std::chrono::milliseconds(timeoutMs));
+        }
+        mIdleTimeoutMs = timeoutMs;
+    }
+
+    DISPLAY_LOGD(eDebugDisplayConfig, "%s:: timeout(%d ms)", __func__, timeoutMs);
+    if (timeoutMs == 0) {
+        Mutex::Autolock lock(mDisplayMutex);
+        if (mIdleModeState != IdleModeState::ACTIVE)
+            exitIdleModeLocked();
+    }
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosDisplay::handleIdleTimeout() {
+    ATRACE_CALL();
+    {
+        Mutex::Autolock lock(mDisplayMutex);
+        if ((mIdleModeState != IdleModeState::ACTIVE) ||
+            (mPowerModeState != HWC2_POWER_MODE_ON) ||
+            (mConfigRequestState != hwc_request_state_t::SET_CONFIG_STATE_NONE))
+            return;
+
+        hwc2_config_t idleConfig;
+        if (!getIdleConfig(mActiveConfig, idleConfig))
+            return;
+
+        hwc_vsync_period_change_constraints_t constraints;
+        constraints.desiredTimeNanos = systemTime(SYSTEM_TIME_MONOTONIC);
+        constraints.seamlessRequired = true;
+        hwc_vsync_period_change_timeline_t timeline;
+        if (setActiveConfigWithConstraintsLocked(idleConfig, &constraints, &timeline, true) != HWC2_ERROR_NONE)
+            return;
+
+        DISPLAY_LOGD(eDebugDisplayConfig, "enter idle mode, config(%d -> %d)", mActiveConfig, idleConfig);
+        mIdleRestoreConfig = mActiveConfig;
+        mIdleModeState = IdleModeState::ENTERING;
+        mIdleEnterCount++;
     }
+
+    /* Idle config is applied by a frame */
+    invalidate();
+
+    auto callbackInfo = mCallbackInfos[HWC2_CALLBACK_VSYNC_IDLE];
+    if (callbackInfo.funcPointer && callbackInfo.callbackData)
+        ((HWC2_PFN_VSYNC_IDLE)callbackInfo.funcPointer)(callbackInfo.callbackData, mDisplayId);
+}
+
+void ExynosDisplay::exitIdleModeLocked() {
+    mIdleModeState = IdleModeState::ACTIVE;
+
+    hwc_vsync_period_change_constraints_t constraints;
+    constraints.desiredTimeNanos = systemTime(SYSTEM_TIME_MONOTONIC);
+    constraints.seamlessRequired = true;
+    hwc_vsync_period_change_timeline_t timeline;
+    DISPLAY_LOGD(eDebugDisplayConfig, "exit idle mode, config(%d)", mIdleRestoreConfig);
+    if (setActiveConfigWithConstraintsLocked(mIdleRestoreConfig, &constraints, &timeline, true) != HWC2_ERROR_NONE)
+        DISPLAY_LOGE("%s:: fail to restore config(%d)", __func__, mIdleRestoreConfig);
 }
 
 void ExynosDisplay::invalidate() {
@@ -5569,7 +6869,7 @@ bool ExynosDisplay::needHdrProcessing(exynos_image &srcImg, exynos_image &dstImg
 #endif
 }
 
-uint32_t ExynosDisplay::getHdrLayerInfo(exynos_image img, enum RenderSource renderSource, HdrLayerInfo *outHdrLayerInfo) {
+uint32_t ExynosDisplay::getHdrLayerInfo(exynos_image &img, enum RenderSource renderSource, HdrLayerInfo *outHdrLayerInfo) {
     ExynosHdrStaticInfo *staticMetadata = NULL;
     ExynosHdrDynamicInfo *dynamicMetadata = NULL;
     if (hasHdr10Plus(img) && img.metaParcel)
@@ -5600,6 +6900,37 @@ uint32_t ExynosDisplay::getHdrLayerInfo(exynos_image img, enum RenderSource rend
     return NO_ERROR;
 }
 
+/*
+ * Fingerprint of everything the HDR coefficients of a channel depend on.
+ * Same fingerprint gives the same coefficients, 0 is not returned.
+ */
+uint64_t ExynosDisplay::getHdrCoefFingerprint(exynos_image &img, enum RenderSource renderSource,
+                                              bool hasHdrLayer) {
+    HdrLayerInfo hdrLayerInfo;
+    getHdrLayerInfo(img, renderSource, &hdrLayerInfo);
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hashFingerprint(hash, &hdrLayerInfo.dataspace, sizeof(hdrLayerInfo.dataspace));
+    if (hdrLayerInfo.static_metadata)
+        hashFingerprint(hash, hdrLayerInfo.static_metadata, sizeof(ExynosHdrStaticInfo));
+    /* The generation stands for the dynamic info if it is known */
+    if (hdrLayerInfo.dynamic_metadata && img.hdrDynamicGeneration)
+        hashFingerprint(hash, &img.hdrDynamicGeneration, sizeof(img.hdrDynamicGeneration));
+    else if (hdrLayerInfo.dynamic_metadata)
+        hashFingerprint(hash, hdrLayerInfo.dynamic_metadata, sizeof(ExynosHdrDynamicInfo));
+    if (hdrLayerInfo.tf_matrix)
+        hashFingerprint(hash, img.colorTransformMatrix.data(),
+                        sizeof(float) * img.colorTransformMatrix.size());
+    hashFingerprint(hash, &hdrLayerInfo.premult_alpha, sizeof(hdrLayerInfo.premult_alpha));
+    hashFingerprint(hash, &hdrLayerInfo.bpc, sizeof(hdrLayerInfo.bpc));
+    hashFingerprint(hash, &renderSource, sizeof(renderSource));
+    hashFingerprint(hash, &hdrLayerInfo.bypass, sizeof(hdrLayerInfo.bypass));
+    hashFingerprint(hash, &hasHdrLayer, sizeof(hasHdrLayer));
+    hashFingerprint(hash, &mHdrTargetInfo, sizeof(mHdrTargetInfo));
+
+    return (hash == 0) ? 1 : hash;
+}
+
 void ExynosDisplay::resetForDestroyClient() {
     if (!mPlugState)
         return;
@@ -5648,15 +6979,29 @@ void LayerDumpManager::setCount(uint32_t cnt) {
 }
 
 void LayerDumpManager::run(uint32_t cnt) {
-    setCount(cnt);
     {
         std::lock_guard<std::mutex> lock(mMutex);
+        if (mState != ThreadState::STOPPED) {
+            ALOGI("LayerDumpManager::the thread is already started");
+            return;
+        }
+    }
+
+    /* the thread of the previous dump stops by itself after writing */
+    if (mThread.joinable())
+        mThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDumpMaxIndex = std::min(cnt, (uint32_t)(LAYER_DUMP_FRAME_CNT_MAX - 1));
+        mDumpFrameIndex = 0;
+        for (auto &info : mLayerDumpInfo) {
+            info.layerDumpState = LAYER_DUMP_IDLE;
+            info.layerDumpCnt = 0;
+        }
         mState = ThreadState::RUN;
     }
-    if (!mThread.joinable())
-        mThread = std::thread(&LayerDumpManager::loop, this);
-    else
-        ALOGI("LayerDumpManager::the thread is already started");
+    mThread = std::thread(&LayerDumpManager::loop, this);
 }
 
 void LayerDumpManager::stop() {
@@ -5665,6 +7010,7 @@ void LayerDumpManager::stop() {
         std::lock_guard<std::mutex> lock(mMutex);
         mState = ThreadState::STOPPED;
     }
+    mCondition.notify_all();
     if (mThread.joinable()) {
         mThread.join();
         ALOGI("LayerDumpManager::stop the thread is joined");
@@ -5681,29 +7027,61 @@ bool LayerDumpManager::isRunning() {
         return false;
 }
 
-void LayerDumpManager::triggerDumpFrame() {
+bool LayerDumpManager::isIdle() {
     std::lock_guard<std::mutex> lock(mMutex);
+    return mState == ThreadState::STOPPED;
+}
+
+void LayerDumpManager::triggerDumpFrame() {
+    std::unique_lock<std::mutex> lock(mMutex);
 
     if (mDumpFrameIndex > 0) {
         // wait previous buffer copy
-        while (mLayerDumpInfo[mDumpFrameIndex].layerDumpState != LAYER_DUMP_DONE) {
-            HDEBUGLOGD(eDebugHWC, "wait : %d, %d", mDumpFrameIndex, mState);
-        }
+        mCondition.wait(lock, [this]() {
+            return (mLayerDumpInfo[mDumpFrameIndex].layerDumpState != LAYER_DUMP_READY) ||
+                    (mState != ThreadState::RUN);
+        });
     }
     mDumpFrameIndex++;
     mLayerDumpInfo[mDumpFrameIndex].layerDumpState = LAYER_DUMP_READY;
     HDEBUGLOGD(eDebugHWC, "%s trigger %d", __func__, mDumpFrameIndex);
+    mCondition.notify_all();
+}
+
+void LayerDumpManager::requestWrite() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mState != ThreadState::RUN)
+            return;
+        mState = ThreadState::WRITE;
+    }
+    mCondition.notify_all();
 }
 
 void LayerDumpManager::loop() {
-    while (true) {
-        if (isRunning()) {
+    setHelperThreadProfile();
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (mState != ThreadState::STOPPED) {
+        layerDumpFrameInfo *frameInfo = &mLayerDumpInfo[mDumpFrameIndex];
+
+        if (frameInfo->layerDumpState == LAYER_DUMP_READY) {
+            lock.unlock();
             mDisplay->getDumpLayer();
+            lock.lock();
+            /* a frame that failed to be copied is not waited for */
+            frameInfo->layerDumpState = LAYER_DUMP_DONE;
+            mCondition.notify_all();
+        } else if (mState == ThreadState::WRITE) {
+            lock.unlock();
+            mDisplay->writeDumpLayers();
+            lock.lock();
+            mState = ThreadState::STOPPED;
+            mCondition.notify_all();
         } else {
-            break;
+            mCondition.wait(lock);
         }
     }
-    return;
 }
 
 hdrInterface *ExynosDisplay::createHdrInterfaceInstance() {
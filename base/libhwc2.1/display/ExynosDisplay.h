@@ -17,7 +17,10 @@
 #ifndef _EXYNOSDISPLAY_H
 #define _EXYNOSDISPLAY_H
 
+#include <array>
+#include <condition_variable>
 #include <fstream>
+#include <unordered_set>
 
 #include <utils/Vector.h>
 #include <utils/KeyedVector.h>
@@ -27,10 +30,16 @@
 #include <hardware/hwcomposer2.h>
 #include "ExynosHWCTypes.h"
 #include "ExynosHWCHelper.h"
+#include "ExynosVsyncModel.h"
+#include "ExynosReadbackRing.h"
+#include "ExynosContentSampler.h"
+#include "ExynosFrameCrc.h"
+#include "ExynosWorkerPool.h"
 #include "ExynosMPP.h"
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWCDebug.h"
 #include "OneShotTimer.h"
+#include "SpscRingBuffer.h"
 
 //#include <hardware/exynos/hdrInterface.h>
 //#include <hardware/exynos/hdr10pMetaInterface.h>
@@ -150,8 +159,14 @@ struct layerDumpFrameInfo {
     layerDumpLayerInfo layerInfo[LAYER_DUMP_LAYER_CNT_MAX];
 };
 
+/*
+ * Layers in ascending mZOrder, layers of the same mZOrder in the order of add().
+ * The order is kept by add() and is restored by vector_sort() after
+ * setLayerZOrder(), which sorts only if a zOrder was changed.
+ */
 class ExynosSortedLayer : public Vector<ExynosLayer *> {
   public:
+    ssize_t add(ExynosLayer *item);
     ssize_t remove(const ExynosLayer *item);
     status_t vector_sort();
     static int compare(ExynosLayer *const *lhs, ExynosLayer *const *rhs);
@@ -237,9 +252,30 @@ class ExynosCompositionInfo : public ExynosMPPSource {
     void dump(String8 &result);
     String8 getTypeStr();
 
+    /**
+      * Gralloc metadata of a target buffer.
+      * SurfaceFlinger and the M2M MPP cycle through a few target buffers,
+      * so the metadata is read once per buffer and kept in a slot that is
+      * looked up by the handle and the buffer id of the buffer.
+      */
+    struct TargetBufferMeta {
+        buffer_handle_t handle = NULL;
+        uint64_t bufferId = 0;
+        int fd[3] = {-1, -1, -1};
+        uint32_t stride = 0;
+        uint32_t vstride = 0;
+        BufInfo bufInfo;
+        compressionInfo_t compressionInfo = {COMP_TYPE_NONE, 0, 0};
+    };
+    static constexpr uint32_t kTargetBufferCacheSize = 4;
+    const TargetBufferMeta &getTargetBufferMeta(buffer_handle_t handle);
+
   private:
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
     BufInfo mBufInfo;
+    std::array<TargetBufferMeta, kTargetBufferCacheSize> mTargetBufferCache;
+    /* Slot replaced by the next buffer that is not in the cache */
+    uint32_t mTargetBufferCacheNext = 0;
 };
 
 struct DisplayControl {
@@ -261,6 +297,116 @@ struct DisplayControl {
     bool skipM2mProcessing = true;
     /** Enable multi-thread present **/
     bool multiThreadedPresent = false;
+    /** Try previous MPP assignment first for layers without geometry change **/
+    bool incrementalAssign = true;
+    /** Fall back to full update when the partial region covers
+     *  more than this percentage of the panel **/
+    uint32_t partialUpdateFullThreshold = 75;
+    /** Compose layers idle for staticLayerCacheFrames with the blending MPP
+     *  into a single window **/
+    bool staticLayerCache = false;
+    uint32_t staticLayerCacheFrames = 30;
+    /** Delay atomic commit until it is just early enough for the next vsync **/
+    bool predictivePresent = false;
+    /** Search layer to otfMPP pairings before the greedy assignment **/
+    bool assignSolver = false;
+    uint32_t assignSolverBudgetUs = 300;
+    /** Time budget of resource assignment, 0 means no limit.
+     *  Only top assignDeadlineLayerNum layers can be device composition
+     *  after the budget is exceeded **/
+    uint32_t assignDeadlineUs = 4000;
+    uint32_t assignDeadlineLayerNum = 4;
+    /** Layers updated frequently are assigned to otfMPP first **/
+    bool updateRatePriority = false;
+    /** Commit without waiting for the previous frame, up to two frames
+     *  can be in flight **/
+    bool pipelinedCommit = false;
+    /** Fill dim layers next to the exynos composition by its blending MPP
+     *  instead of a window **/
+    bool foldDimLayer = false;
+};
+
+/*
+ * State of predictive present scheduling.
+ * The commit is delayed until the learned commit latency and margin
+ * before the target vsync. The margin grows when a frame misses its
+ * target vsync and shrinks slowly while frames are on time.
+ */
+struct PresentScheduleInfo {
+    static constexpr nsecs_t kMinMargin = 500000; /* 0.5ms */
+    /* Commit is not held longer than this for the expected present time */
+    static constexpr nsecs_t kMaxExpectedPresentDelay = 100000000; /* 100ms */
+    nsecs_t lastHwVsync = 0;
+    nsecs_t targetVsync = 0;
+    /* Expected present time of the frame from the client, 0 if it is not set */
+    nsecs_t expectedPresentTime = 0;
+    uint64_t heldCount = 0;
+    nsecs_t margin = kMinMargin;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+/*
+ * Slip of the present fence signal time from the vsync targeted by the
+ * present, in vsync periods, by display config. The previous frame is
+ * shown again for every vsync a frame slips, those are the repeated frames.
+ */
+struct FramePacingInfo {
+    /* The last bucket has the slips larger than kSlipBuckets - 2 */
+    static constexpr uint32_t kSlipBuckets = 8;
+    struct Stats {
+        std::array<uint64_t, kSlipBuckets> slip = {};
+        uint64_t repeatedFrames = 0;
+    };
+    struct Frame {
+        nsecs_t targetVsync = 0;
+        nsecs_t period = 0;
+        uint32_t config = 0;
+    };
+    nsecs_t presentStart = 0;
+    /* Frames of mLastPresentFence and mN2PresentFence */
+    Frame lastFrame;
+    Frame n2Frame;
+    std::map<uint32_t, Stats> stats;
+};
+
+/*
+ * Range of idle layers that are composed by exynos composition
+ * and shown as a single window until any of them is changed.
+ */
+struct StaticLayerCacheInfo {
+    bool active = false;
+    int32_t firstIndex = -1;
+    int32_t lastIndex = -1;
+    void reset() { *this = {}; };
+    bool contains(uint32_t index) const {
+        return active && ((int32_t)index >= firstIndex) && ((int32_t)index <= lastIndex);
+    };
+};
+
+/*
+ * Small set of disjoint dirty rects used by window update.
+ * Overlapping rects are merged on insertion, and when the set is full the
+ * pair whose union wastes the fewest pixels is merged.
+ */
+class DamageRectSet {
+  public:
+    static constexpr size_t kMaxRects = 4;
+
+    void clear() { mNum = 0; };
+    size_t size() const { return mNum; };
+    const hwc_rect &operator[](size_t index) const { return mRects[index]; };
+    void add(const hwc_rect &rect);
+    /* Bounding rect of every dirty rect */
+    hwc_rect bound() const;
+    /* Sum of disjoint dirty areas */
+    int64_t area() const;
+    void dump(String8 &result) const;
+
+  private:
+    void mergeAt(size_t dst, size_t src);
+    hwc_rect mRects[kMaxRects + 1];
+    size_t mNum = 0;
 };
 
 typedef struct hiberState {
@@ -288,7 +434,7 @@ class ExynosVsyncCallback {
         mVsyncEnabled = enable;
         resetVsyncTimeStamp();
     };
-    bool getVSyncEnabled() { return mVsyncEnabled; };
+    bool getVSyncEnabled() { return mVsyncEnabled.load(); };
     void setDesiredVsyncPeriod(uint64_t period) {
         mDesiredVsyncPeriod = period;
         resetVsyncTimeStamp();
@@ -301,7 +447,8 @@ class ExynosVsyncCallback {
     void resetDesiredVsyncPeriod() { mDesiredVsyncPeriod = 0; };
 
   private:
-    bool mVsyncEnabled = false;
+    /* It is read by vsync thread without mDisplayMutex */
+    std::atomic<bool> mVsyncEnabled = false;
     uint64_t mVsyncTimeStamp = 0;
     uint64_t mVsyncPeriod = 0;
     uint64_t mDesiredVsyncPeriod = 0;
@@ -369,12 +516,34 @@ class ExynosDisplay : public ExynosVsyncHandler {
     bool mDisplayConfigPending = false;
 
     DisplayControl mDisplayControl;
+    /* Controls of mDisplayControl saved while the auto low latency mode is on */
+    struct LowLatencyState {
+        bool enabled = false;
+        bool predictivePresent = false;
+        bool pipelinedCommit = false;
+        bool staticLayerCache = false;
+    } mLowLatency;
 
     /**
          * TODO : Should be defined as ExynosLayer type
          * Layer list those sorted by z-order
          */
     ExynosSortedLayer mLayers;
+    /*
+     * Guards mLayers, mLayerMap, the layers and mPendingGeometryChanged.
+     * The layer setters of ExynosDevice take only this lock so that they
+     * don't wait for the validation or the presentation of the other
+     * displays. Lock order: ExynosDevice::mMutex -> mLayerMutex -> mDisplayMutex
+     */
+    Mutex mLayerMutex;
+    /* Geometry changed by the layer setters, moved to the device by ExynosDevice::LayerLocks */
+    uint64_t mPendingGeometryChanged = 0;  // GUARDED_BY(mLayerMutex)
+    /* Layer handle to layer of mLayers, for lookup of layer commands */
+    std::unordered_map<hwc2_layer_t, ExynosLayer *> mLayerMap;
+    /* Fingerprint of layer state of last successful validation, 0 if invalid */
+    uint64_t mValidateFingerprint = 0;
+    /* mLayers in the order of the last validation */
+    std::vector<ExynosLayer *> mValidatedLayerOrder;
 
     /**
          * Layer index, target buffer information for GLES.
@@ -386,6 +555,82 @@ class ExynosDisplay : public ExynosVsyncHandler {
          */
     ExynosCompositionInfo mExynosCompositionInfo;
 
+    /**
+         * Disjoint dirty rects of the last window update.
+         */
+    DamageRectSet mWindowUpdateDamage;
+
+    /**
+         * Idle layers that are cached by exynos composition.
+         */
+    StaticLayerCacheInfo mStaticLayerCache;
+
+    /**
+         * Predictive present scheduling state.
+         */
+    PresentScheduleInfo mPresentSchedule;
+    ExynosVsyncModel mVsyncModel;
+
+    /**
+         * Streaming writeback to caller-provided buffers.
+         */
+    ExynosReadbackRing mReadbackRing;
+    buffer_handle_t mReadbackRingBuffer = nullptr;
+
+    /**
+         * Displayed content sampling with writeback.
+         */
+    std::unique_ptr<ExynosContentSampler> mContentSampler;
+    buffer_handle_t mContentSampleBuffer = nullptr;
+
+    /**
+         * CRC of presented frames with writeback.
+         */
+    std::unique_ptr<ExynosFrameCrc> mFrameCrc;
+    buffer_handle_t mFrameCrcBuffer = nullptr;
+
+    /**
+         * Resource assignment of current validate exceeded its time budget.
+         */
+    bool mAssignDeadlineExceeded = false;
+    uint64_t mAssignDeadlineCnt = 0;
+    /*
+     * In doze the layers are blended into the client target so that the
+     * panel is scanned out from a single window.
+     */
+    bool mLowPowerComposition = false;
+    uint64_t mLowPowerFrameCnt = 0;
+
+    /*
+     * Display whose layers are shown on this display up to scale, as when
+     * SurfaceFlinger mirrors the primary display. It is detected in each
+     * validation to find the frames that could reuse the composition of
+     * the source.
+     */
+    ExynosDisplay *mMirrorSource = nullptr;
+    uint64_t mMirroredFrameCnt = 0;
+
+    /**
+         * Client composition of validated frames by client_composition_reason.
+         * Each client composited layer of a frame is counted once.
+         */
+    std::array<uint64_t, CLIENT_REASON_MAX> mClientReasonCount = {};
+    uint64_t mClientCompositionFrameCnt = 0;
+    uint64_t mValidatedFrameCnt = 0;
+
+    /**
+         * Present-to-vsync slip of the presented frames.
+         */
+    FramePacingInfo mFramePacing;
+
+    /**
+         * Estimated DPU read bandwidth(MB/s) of the last assignment and
+         * the number of validates that moved layers to client composition
+         * to stay in the budget.
+         */
+    uint32_t mDpuBandwidth = 0;
+    uint64_t mDpuBandwidthExceededCnt = 0;
+
     /**
          * Geometry change info is described by bit map.
          * This flag is cleared when resource assignment for all displays
@@ -459,6 +704,27 @@ class ExynosDisplay : public ExynosVsyncHandler {
     float mMaxAverageLuminance;
     float mMinLuminance;
     bool mHasHdr10PlusLayer;
+    /*
+     * Classification of the layers of the frame by doPreProcessing(),
+     * for the later stages not to walk the layers again.
+     * It is updated with mDRMutex for the dynamic recomposition timer.
+     */
+    struct LayerSummary {
+        uint32_t layerNum = 0;
+        uint32_t bufferLayerNum = 0;
+        uint32_t yuvLayerNum = 0;
+        uint32_t hdrLayerNum = 0;
+        uint32_t hdr10PlusLayerNum = 0;
+        uint32_t drmLayerNum = 0;
+        uint32_t clientLayerNum = 0;
+        uint32_t singleBufferLayerNum = 0;
+        /* Layers of a buffer other than that of the last frame */
+        uint32_t updatedLayerNum = 0;
+        /* Layers that should be shown by DPU in dynamic recomposition */
+        uint32_t dynamicRecompBlockingLayerNum = 0;
+    } mLayerSummary;
+    /* Supported MPP flags of layers are already updated in this validate */
+    bool mSupportedMPPFlagUpdated = false;
 
     std::map<uint32_t, displayConfigs_t> mDisplayConfigs;
     android::SortedVector<uint32_t> mAssignedWindows;
@@ -480,6 +746,15 @@ class ExynosDisplay : public ExynosVsyncHandler {
     hiberState_t mHiberState;
     std::ofstream mBrightnessOfs;
     uint32_t mMaxBrightness;
+    /*
+     * Brightness is written to mBrightnessOfs by mBrightnessWorker if it is
+     * created, and only the newest of the values set while a write is in
+     * progress is written. -1 if no value is waiting for the worker.
+     */
+    std::atomic<int64_t> mPendingBrightness{-1};
+    std::unique_ptr<ExynosWorkerPool> mBrightnessWorker;
+    void writeBrightness(uint32_t brightness);
+    void flushPendingBrightness();
 
     hwc_vsync_period_change_constraints_t mVsyncPeriodChangeConstraints;
     hwc_vsync_period_change_timeline_t mVsyncAppliedTimeLine;
@@ -488,7 +763,7 @@ class ExynosDisplay : public ExynosVsyncHandler {
 
     uint32_t mActiveConfig = 0;
     uint32_t mConfigChangeTimoutCnt = 0;
-    exynos_callback_info_t mCallbackInfos[HWC2_CALLBACK_SEAMLESS_POSSIBLE + 1];
+    exynos_callback_info_t mCallbackInfos[HWC2_CALLBACK_EXYNOS_MAX];
     ExynosFpsChangedCallback *mFpsChangedCallback = nullptr;
     bool mIsVsyncDisplay = false;
 
@@ -509,7 +784,11 @@ class ExynosDisplay : public ExynosVsyncHandler {
         bool bypass;
     };
 #endif
-    uint32_t getHdrLayerInfo(exynos_image img, enum RenderSource renderSource = REND_ORI, HdrLayerInfo *outHdrLayerInfo = nullptr);
+    uint32_t getHdrLayerInfo(exynos_image &img, enum RenderSource renderSource = REND_ORI, HdrLayerInfo *outHdrLayerInfo = nullptr);
+    uint64_t getHdrCoefFingerprint(exynos_image &img, enum RenderSource renderSource, bool hasHdrLayer);
+    /* Frames whose HDR coefficient build-up is skipped, parcel writes that are skipped */
+    uint64_t mHdrCoefBuildupSkipCnt = 0;
+    uint64_t mHdrCoefWriteSkipCnt = 0;
     bool needHdrProcessing(exynos_image &srcImg, exynos_image &dstImg);
     bool mHasHdr10AttrMPP = false;
     bool mHasHdr10PlusAttrMPP = false;
@@ -529,7 +808,28 @@ class ExynosDisplay : public ExynosVsyncHandler {
     std::unordered_map<uint32_t, std::vector<DisplayRenderIntent>> mDisplayRenderIntents;
     DisplayColorMode mCurrentDisplayColorMode;
     DisplayRenderIntent mCurrentDisplayRenderIntents;
-    virtual int32_t searchDisplayColorMode(int32_t mode);
+    /* (mode, intent) pairs of mDisplayRenderIntents */
+    std::unordered_set<uint64_t> mDisplayRenderIntentKeys;
+    /*
+     * DQE LUT of a (mode, intent) pair in its own parcel. DPU reads the LUT
+     * of the fd given with the mode, so a LUT is used again without
+     * getDqeLut() until the color transform is changed.
+     */
+    struct DisplayColorLut {
+        int fd = -1;
+        void *addr = NULL;
+        uint32_t transformGen = 0;
+    };
+    static constexpr uint32_t kMaxDisplayColorLutNum = 8;
+    /* intent is -1 for the LUT of setColorMode() */
+    static uint64_t displayColorKey(int32_t mode, int32_t intent) {
+        return ((uint64_t)(uint32_t)mode << 32) | (uint32_t)intent;
+    };
+    std::unordered_map<uint64_t, DisplayColorLut> mDisplayColorLuts;
+    uint32_t mDisplayColorTransformGen = 1;
+    void freeDisplayColorLuts();
+    /* outFd is the parcel fd of the DQE LUT of mode and intent */
+    virtual int32_t searchDisplayColorMode(int32_t mode, int32_t intent, int32_t &outFd);
     virtual int32_t searchDisplayRenderIntent(int32_t mode, int32_t intent);
 #endif
 
@@ -547,6 +847,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
     };
     virtual void checkLayersForSettingDR(){};
     virtual void checkLayersForRevertingDR(uint64_t &geometryChanged);
+    void updateStaticLayerCache(uint64_t &geometryChanged);
+    bool isStaticLayerCacheCandidate(ExynosLayer *layer);
 
     virtual void hotplug();
     virtual bool checkHotplugEventUpdated(bool &hpdStatus);
@@ -557,8 +859,9 @@ class ExynosDisplay : public ExynosVsyncHandler {
 
     int getId();
 
-    size_t yuvWriteByLines(void *temp, int align_Width, int original_Width, int original_Height, FILE *fp);
-    int32_t setCompositionTargetExynosImage(uint32_t targetType, exynos_image *src_img, exynos_image *dst_img);
+    void yuvPackLines(const void *temp, int align_Width, int original_Width, int original_Height,
+                      std::vector<uint8_t> &out);
+    virtual int32_t setCompositionTargetExynosImage(uint32_t targetType, exynos_image *src_img, exynos_image *dst_img);
     int32_t initializeValidateInfos();
     int32_t addClientCompositionLayer(uint32_t layerIndex,
                                       uint32_t *isExynosCompositionChanged = NULL);
@@ -567,6 +870,7 @@ class ExynosDisplay : public ExynosVsyncHandler {
     int32_t handleSandwitchedExynosCompositionLayer(
         std::vector<int32_t> &highPriLayers, float totalUsedCapa,
         bool &invalidFlag, int32_t &changeFlag);
+    uint64_t getClientCompositionCost(int32_t first, int32_t last);
     int32_t handleNestedClientCompositionLayer(int32_t &changeFlag);
     int32_t addExynosCompositionLayer(uint32_t layerIndex, float totalUsedCapa);
 
@@ -599,6 +903,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
     int32_t configureOverlay(ExynosLayer *layer,
                              exynos_win_config_data &cfg, bool hdrException = false);
     virtual int32_t configureOverlay(ExynosCompositionInfo &compositionInfo);
+    /* Import next buffer of the layer into framebuffer before present */
+    void preImportLayerBuffer(ExynosLayer &layer);
 
     int32_t configureHandle(ExynosLayer &layer, int fence_fd,
                             exynos_win_config_data &cfg, bool hdrException = false);
@@ -732,6 +1038,14 @@ class ExynosDisplay : public ExynosVsyncHandler {
     };
     virtual int32_t canSkipValidate();
 
+    uint64_t computeValidateFingerprint();
+    void updateValidateFingerprint(bool validated);
+    void updateClientCompositionReasons();
+    bool isMirrorOf(const ExynosDisplay &source) const;
+    void dumpClientCompositionReasons(String8 &result);
+    /* Layer state is same with last validated one even if geometry flag is set */
+    bool isValidateFingerprintSame();
+
     int32_t forceSkipPresentDisplay(int32_t *outPresentFence);
 
     int32_t handlePresentError(String8 &errString, int32_t *outPresentFence);
@@ -806,11 +1120,18 @@ class ExynosDisplay : public ExynosVsyncHandler {
 
     virtual int32_t preProcessValidate(DeviceValidateInfo &validateInfo,
                                        uint64_t &geometryChanged);
+    /*
+     * Drops GEOMETRY_LAYER_ZORDER_CHANGED of the layers if the sorted
+     * layers are in the order of the last validation. The hardware only
+     * sees the order, not the values of z.
+     */
+    void filterLayerZOrderChanged();
     virtual int32_t postProcessValidate();
     int32_t setValidateState(uint32_t &outNumTypes,
                              uint32_t &outNumRequests,
                              uint64_t &geometryChanged);
     void setForceClient();
+    void setLowPowerComposition(bool enable, uint64_t &geometryFlag);
 
     /* getHdrCapabilities(..., outNumTypes, outTypes, outMaxLuminance,
          *     outMaxAverageLuminance, outMinLuminance)
@@ -818,6 +1139,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
          */
     virtual int32_t getHdrCapabilities(uint32_t *outNumTypes, int32_t * /*android_hdr_t*/ outTypes, float *outMaxLuminance,
                                        float *outMaxAverageLuminance, float *outMinLuminance);
+    /* Reads mHdrTypes and the luminances of the display */
+    virtual int32_t updateHdrCapabilities();
 
     virtual int32_t getRenderIntents(int32_t mode, uint32_t *outNumIntents,
                                      int32_t * /*android_render_intent_v1_1_t*/ outIntents);
@@ -1045,7 +1368,9 @@ class ExynosDisplay : public ExynosVsyncHandler {
          *   HWC2_ERROR_BAD_DISPLAY - when the display is invalid, or
          *   HWC2_ERROR_UNSUPPORTED - when the display does not support any low latency mode
          */
-    int32_t setAutoLowLatencyMode(bool __unused on);
+    int32_t setAutoLowLatencyMode(bool on);
+    /* mDisplayMutex should be held */
+    int32_t setAutoLowLatencyModeInternal(bool on);
 
     /* getSupportedContentTypes(..., outSupportedContentTypes)
          * Descriptor: HWC2_FUNCTION_GET_SUPPORTED_CONTENT_TYPES
@@ -1065,8 +1390,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
          * Returns HWC2_ERROR_NONE or one of the following errors:
          *   HWC2_ERROR_BAD_DISPLAY - an invalid display handle was passed in
          */
-    int32_t getSupportedContentTypes(uint32_t *__unused outNumSupportedContentTypes,
-                                     uint32_t *__unused outSupportedContentTypes);
+    int32_t getSupportedContentTypes(uint32_t *outNumSupportedContentTypes,
+                                     uint32_t *outSupportedContentTypes);
 
     /* setContentType(displayToken, contentType)
          * Descriptor: HWC2_FUNCTION_SET_CONTENT_TYPE
@@ -1087,7 +1412,7 @@ class ExynosDisplay : public ExynosVsyncHandler {
          *                            supported on this display, or
          *   HWC2_ERROR_BAD_PARAMETER - when the given content type is invalid
          */
-    int32_t setContentType(int32_t /* hwc2_content_type_t */ __unused contentType);
+    int32_t setContentType(int32_t /* hwc2_content_type_t */ contentType);
 
     /* getClientTargetProperty(..., outClientTargetProperty)
          * Descriptor: HWC2_FUNCTION_GET_CLIENT_TARGET_PROPERTY
@@ -1141,6 +1466,43 @@ class ExynosDisplay : public ExynosVsyncHandler {
     void setReadbackBufferInternal(buffer_handle_t buffer, int32_t releaseFence);
     int32_t getReadbackBufferFence(int32_t *outFence);
 
+    /* Streaming writeback, each presented frame is written to the ring */
+    int32_t startReadbackStream(const std::vector<buffer_handle_t> &buffers);
+    void stopReadbackStream();
+    int32_t acquireReadbackStreamFrame(buffer_handle_t *outBuffer, int32_t *outFence,
+                                       uint64_t *outFrameNumber);
+    int32_t releaseReadbackStreamFrame(buffer_handle_t buffer, int32_t releaseFence);
+    void setupReadbackStreamFrame();
+    void queueReadbackStreamFrame();
+
+    /* Displayed content sampling, histograms are made from writeback frames */
+    int32_t getDisplayedContentSamplingAttributes(int32_t * /* android_pixel_format_t */ outFormat,
+                                                  int32_t * /* android_dataspace_t */ outDataspace,
+                                                  uint8_t * /* mask of android_component_t */ outComponentMask);
+    int32_t setDisplayedContentSamplingEnabled(int32_t /* hwc2_displayed_content_sampling_t */ enabled,
+                                               uint8_t /* mask of android_component_t */ componentMask,
+                                               uint64_t maxFrames);
+    int32_t getDisplayedContentSample(uint64_t maxFrames, uint64_t timestamp, uint64_t *outFrameCount,
+                                      int32_t outSamplesSize[4], uint64_t *outSamples[4]);
+    void setupContentSampleFrame();
+    void queueContentSampleFrame();
+
+    /* CRC of every presented frame is logged, from HWC_CTL_FRAME_CRC */
+    int32_t setFrameCrcEnabled(bool enabled);
+    void setupFrameCrcFrame();
+    void queueFrameCrcFrame();
+
+    /* Refresh rate changes are reported by HWC2_CALLBACK_REFRESH_RATE_CHANGED_DEBUG */
+    int32_t setRefreshRateChangedDebugEnabled(bool enabled);
+
+    /*
+     * HAL idle timer. If no frame is presented during timeoutMs, refresh rate
+     * is dropped to the lowest seamless config and restored on the next present.
+     * timeoutMs 0 disables the timer.
+     */
+    int32_t setIdleTimerEnabled(int32_t timeoutMs);
+    bool isIdleTimerSupported();
+
     void dump(String8 &result);
 
     virtual int32_t startPostProcessing();
@@ -1154,12 +1516,20 @@ class ExynosDisplay : public ExynosVsyncHandler {
     int canApplyWindowUpdate(const exynos_dpu_data &lastConfigsData,
                              const exynos_dpu_data &newConfigsData,
                              uint32_t index);
-    int mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect);
+    int mergeDamageRect(DamageRectSet &damage_set, hwc_rect &damage_rect);
+    bool isPartialUpdateBeneficial(const DamageRectSet &damage_set);
     int setWindowUpdate(const hwc_rect &merge_rect);
     bool windowUpdateExceptions();
     int handleWindowUpdate();
 
     virtual void waitPreviousFrameDone(int fence);
+    void schedulePresentCommit();
+    /* Accounts the frame of mN2PresentFence, it is called before the fences are rotated */
+    void updateFramePacing();
+    void dumpFramePacing(String8 &result);
+    int32_t getFramePacingStats(uint32_t config, FramePacingInfo::Stats &outStats);
+    /* Present of the next frame is held until the vsync of the time */
+    void setExpectedPresentTime(nsecs_t expectedPresentTime);
 
     /* For debugging */
     bool validateExynosCompositionLayer();
@@ -1182,6 +1552,7 @@ class ExynosDisplay : public ExynosVsyncHandler {
                                       void *deviceData, size_t &deviceDataSize);
     void getDumpLayer();
     void dumpLayers();
+    void writeDumpLayers();
     void setDumpCount(uint32_t dumpCount);
     void writeDumpData(int32_t frameNo, int32_t layerNo,
                        layerDumpFrameInfo *frameInfo, layerDumpLayerInfo *layerInfo);
@@ -1246,6 +1617,9 @@ class ExynosDisplay : public ExynosVsyncHandler {
     std::unique_ptr<ExynosDisplayInterface> mDisplayInterface;
     /* Interface of ExynosVsyncHandler */
     virtual void handleVsync(uint64_t timestamp) override;
+    void handleVsyncLocked(uint64_t timestamp);
+    /* Handle vsync timestamps queued while mDisplayMutex was held, mDisplayMutex should be locked */
+    void processPendingVsyncEvents();
 
     int32_t checkValidationConfigConstraints(hwc2_config_t config,
                                              hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
@@ -1254,6 +1628,49 @@ class ExynosDisplay : public ExynosVsyncHandler {
   private:
     bool skipStaticLayerChanged(ExynosCompositionInfo &compositionInfo);
     LayerDumpManager *mLayerDumpManager = nullptr;
+    static constexpr size_t kPendingVsyncEventNum = 16;
+    /* vsync thread is producer, thread holding mDisplayMutex is consumer */
+    SpscRingBuffer<uint64_t, kPendingVsyncEventNum> mPendingVsyncEvents;
+
+    /* Observed refresh rate transitions for the debug callback */
+    struct RefreshRateChange {
+        nsecs_t timestamp = 0;
+        hwc2_vsync_period_t vsyncPeriod = 0;
+    };
+    static constexpr size_t kRefreshRateChangeNum = 64;
+    /* Changes are delivered in a batch after this time or if half of the ring is used */
+    static constexpr nsecs_t kRefreshRateDeliverInterval = 100000000; /* 100ms */
+    /* Thread holding mDisplayMutex is producer, vsync thread is consumer */
+    SpscRingBuffer<RefreshRateChange, kRefreshRateChangeNum> mRefreshRateChanges;
+    std::atomic<bool> mRefreshRateDebugEnabled = false;
+    std::atomic<size_t> mRefreshRateChangeCount = 0;
+    hwc2_vsync_period_t mObservedVsyncPeriod = 0;
+    nsecs_t mLastRefreshRateDelivery = 0;
+    uint64_t mRefreshRateChangeDropped = 0;
+    void recordRefreshRateChange(nsecs_t timestamp, hwc2_vsync_period_t vsyncPeriod);
+    void deliverRefreshRateChanges(nsecs_t now);
+
+    enum class IdleModeState {
+        ACTIVE,
+        /* Idle config is requested, the next present applies it */
+        ENTERING,
+        IDLE,
+    };
+    /* Guards mIdleTimer, it should not be held with mDisplayMutex */
+    std::mutex mIdleTimerMutex;
+    std::optional<OneShotTimer> mIdleTimer;
+    int32_t mIdleTimeoutMs = 0;
+    /* Below are guarded by mDisplayMutex */
+    IdleModeState mIdleModeState = IdleModeState::ACTIVE;
+    hwc2_config_t mIdleRestoreConfig = 0;
+    uint64_t mIdleEnterCount = 0;
+    void handleIdleTimeout();
+    void exitIdleModeLocked();
+    bool getIdleConfig(hwc2_config_t activeConfig, hwc2_config_t &outConfig);
+    int32_t setActiveConfigWithConstraintsLocked(hwc2_config_t config,
+                                                 hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
+                                                 hwc_vsync_period_change_timeline_t *outTimeline,
+                                                 bool needUpdateTimeline);
 
   public:
     std::map<uint32_t, displayTDMInfo> mDisplayTDMInfo;
@@ -1272,11 +1689,19 @@ class LayerDumpManager {
     void stop();
     void wait();
     bool isRunning();
+    bool isIdle();
     void triggerDumpFrame();
+    void requestWrite();
     void loop();
+    /*
+     * RUN: the frames are copied on the dump thread when they are triggered.
+     * WRITE: the copies are written to the files on the dump thread. The
+     * thread stops by itself after that.
+     */
     enum class ThreadState {
         STOPPED = 0,
         RUN = 1,
+        WRITE = 2,
     };
 
   private:
@@ -1284,6 +1709,7 @@ class LayerDumpManager {
     int32_t mDumpMaxIndex; // GUARDED_BY(mMutex)
     ExynosDisplay *mDisplay;
     std::mutex mMutex;
+    std::condition_variable mCondition;
     ThreadState mState = ThreadState::STOPPED; // GUARDED_BY(mMutex)
     layerDumpFrameInfo mLayerDumpInfo[LAYER_DUMP_FRAME_CNT_MAX];
     std::thread mThread;
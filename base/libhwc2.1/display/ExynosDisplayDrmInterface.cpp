@@ -16,6 +16,9 @@
 
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
 #include <sys/types.h>
+#include <android/sync.h>
+#include <math.h>
+#include <utils/Trace.h>
 #include <drm_fourcc.h>
 #include <xf86drm.h>
 #include <drm.h>
@@ -23,6 +26,8 @@
 #include <cutils/properties.h>
 #include "ExynosDisplayDrmInterface.h"
 #include "ExynosHWCDebug.h"
+#include "ExynosLatencyStats.h"
+#include "ExynosPerfettoTrace.h"
 #include "ExynosGraphicBuffer.h"
 #include "DrmDataType.h"
 
@@ -70,17 +75,20 @@ ExynosDisplayDrmInterface::~ExynosDisplayDrmInterface() {
         removeFbs(mDrmDevice->fd(), mOldFbIds);
         removeFbs(mDrmDevice->fd(), mFbIds);
 
-        if (mActiveModeState.blob_id)
-            mDrmDevice->DestroyPropertyBlob(mActiveModeState.blob_id);
-        if (mActiveModeState.old_blob_id)
-            mDrmDevice->DestroyPropertyBlob(mActiveModeState.old_blob_id);
-        if (mDesiredModeState.blob_id)
-            mDrmDevice->DestroyPropertyBlob(mDesiredModeState.blob_id);
-        if (mDesiredModeState.old_blob_id)
-            mDrmDevice->DestroyPropertyBlob(mDesiredModeState.old_blob_id);
+        for (auto &modeBlob : mModeBlobs)
+            mDrmDevice->DestroyPropertyBlob(modeBlob.second);
+        mModeBlobs.clear();
         if (mPartialRegionState.blob_id)
             mDrmDevice->DestroyPropertyBlob(mPartialRegionState.blob_id);
+        if (mHdrOutputMetaState.blob_id)
+            mDrmDevice->DestroyPropertyBlob(mHdrOutputMetaState.blob_id);
+        if (mColorRequest.matrix_blob)
+            mDrmDevice->DestroyPropertyBlob(mColorRequest.matrix_blob);
+        if (mColorRequest.active_matrix_blob)
+            mDrmDevice->DestroyPropertyBlob(mColorRequest.active_matrix_blob);
     }
+    if (mInFlightFence >= 0)
+        close(mInFlightFence);
 }
 
 void ExynosDisplayDrmInterface::init(const DisplayIdentifier &display,
@@ -157,6 +165,26 @@ void ExynosDisplayDrmInterface::parseStandardEnums(const DrmProperty &property)
     }
 }
 
+void ExynosDisplayDrmInterface::parseContentTypeEnums(const DrmProperty &property) {
+    /* Only the connectors of the external sinks have the property */
+    if (property.id() == 0)
+        return;
+
+    const std::vector<std::pair<uint32_t, const char *>> contentTypeEnums = {
+        {HWC2_CONTENT_TYPE_NONE, "No Data"},
+        {HWC2_CONTENT_TYPE_GRAPHICS, "Graphics"},
+        {HWC2_CONTENT_TYPE_PHOTO, "Photo"},
+        {HWC2_CONTENT_TYPE_CINEMA, "Cinema"},
+        {HWC2_CONTENT_TYPE_GAME, "Game"},
+    };
+
+    ALOGD("Init content type enums");
+    parseEnums(property, contentTypeEnums, mContentTypeEnums);
+    for (auto &e : mContentTypeEnums) {
+        ALOGD("content type [hal: %d, drm: %" PRId64 "]", e.first, e.second);
+    }
+}
+
 void ExynosDisplayDrmInterface::parseTransferEnums(const DrmProperty &property) {
     const std::vector<std::pair<uint32_t, const char *>> transferEnums = {
         {HAL_DATASPACE_TRANSFER_UNSPECIFIED, "Unspecified"},
@@ -267,6 +295,7 @@ void ExynosDisplayDrmInterface::initDrmDevice(DrmDevice *drmDevice, int drmDispl
         }
         mDrmVSyncWorker.Init(mDrmDevice, drmDisplayId);
         mDrmVSyncWorker.RegisterCallback(static_cast<VsyncCallback *>(this));
+        parseContentTypeEnums(mDrmConnector->content_type());
     }
 
     getLowPowerDrmModeModeInfo();
@@ -303,6 +332,8 @@ void ExynosDisplayDrmInterface::initDrmDevice(DrmDevice *drmDevice, int drmDispl
 
 void ExynosDisplayDrmInterface::Callback(
     int display, int64_t timestamp) {
+    /* Called on the thread of mDrmVSyncWorker */
+    setHelperThreadProfile();
     mVsyncHandler->handleVsync(timestamp);
 }
 
@@ -347,11 +378,13 @@ int32_t ExynosDisplayDrmInterface::setLowPowerMode(bool suspend) {
     int ret = 0;
     int modeNo = -1;
 
+    /* The doze mode of the lowest refresh rate in the active resolution */
     for (auto &e : mDozeDrmModes) {
-        ALOGD("%s, %d, %d, %d, %d", __func__, e.second.h_display(), e.second.v_display(),
-              mActiveModeState.mode.h_display(), mActiveModeState.mode.v_display());
+        ALOGD("%s, %d, %d, %f, %d, %d", __func__, e.second.h_display(), e.second.v_display(),
+              e.second.v_refresh(), mActiveModeState.mode.h_display(), mActiveModeState.mode.v_display());
         if ((e.second.h_display() == mActiveModeState.mode.h_display()) &&
-            (e.second.v_display() == mActiveModeState.mode.v_display())) {
+            (e.second.v_display() == mActiveModeState.mode.v_display()) &&
+            ((modeNo < 0) || (e.second.v_refresh() < mDozeDrmModes[modeNo].v_refresh()))) {
             modeNo = e.first;
         }
     }
@@ -386,6 +419,9 @@ int32_t ExynosDisplayDrmInterface::setPowerMode(int32_t mode) {
 
     if (mDrmConnector == nullptr)
         return ret;
+    /* Panel and planes are reset by power mode change */
+    mPropertyShadow.invalidate();
+
     const DrmProperty &prop = mDrmConnector->dpms_property();
     if ((ret = drmModeConnectorSetProperty(mDrmDevice->fd(), mDrmConnector->id(), prop.id(),
                                            dpms_value)) != NO_ERROR) {
@@ -587,17 +623,69 @@ int32_t ExynosDisplayDrmInterface::getColorModes(
 int32_t ExynosDisplayDrmInterface::setColorTransform(const float *matrix,
                                                      int32_t hint, int32_t dqe_fd) {
 #ifdef USE_DISPLAY_COLOR_INTERFACE
-    if (mDrmCrtc->color_mode_property().id() == 0) {
-        return HWC2_ERROR_UNSUPPORTED;
+    if ((dqe_fd >= 0) && (mDrmCrtc->color_mode_property().id() != 0)) {
+        if (mDrmCrtc->dqe_fd_property().id() != 0) {
+            mColorRequest.requestTransform(dqe_fd);
+            return HWC2_ERROR_NONE;
+        }
+        ALOGI("%s:: dqe_fd property id is abnormal", __func__);
     }
+#endif
+    /* The color library didn't build the DQE LUT of the matrix */
+    return setLinearMatrix(matrix, hint);
+}
 
-    if (mDrmCrtc->dqe_fd_property().id() == 0) {
-        ALOGI("%s:: dqe_fd property id is abnormal", __func__);
+/*
+ * The linear matrix of the DQE takes S3.12 coefficients and offsets in
+ * the 10-bit code values, both in two's complement.
+ */
+#define DQE_MATRIX_COEF_FRAC_BITS 12
+#define DQE_MATRIX_OFFSET_SCALE 1023.0f
+
+int32_t ExynosDisplayDrmInterface::setLinearMatrix(const float *matrix, int32_t hint) {
+    if (mDrmCrtc->linear_matrix_property().id() == 0)
         return HWC2_ERROR_UNSUPPORTED;
-    } else {
-        mColorRequest.requestTransform(dqe_fd);
+
+    uint32_t blob = 0;
+    if (hint != HAL_COLOR_TRANSFORM_IDENTITY) {
+        /*
+         * The matrix of the HWC2 API is applied to the row vector [R G B 1],
+         * R' = R * m[0] + G * m[4] + B * m[8] + m[12], and so on.
+         * The alpha column should be that of the identity.
+         */
+        if ((matrix[3] != 0.0f) || (matrix[7] != 0.0f) ||
+            (matrix[11] != 0.0f) || (matrix[15] != 1.0f))
+            return HWC2_ERROR_UNSUPPORTED;
+
+        struct exynos_matrix linearMatrix;
+        for (uint32_t i = 0; i < DRM_SAMSUNG_MATRIX_DIMENS; i++) {
+            for (uint32_t j = 0; j < DRM_SAMSUNG_MATRIX_DIMENS; j++) {
+                long coef = lroundf(matrix[j * 4 + i] * (1 << DQE_MATRIX_COEF_FRAC_BITS));
+                if ((coef > INT16_MAX) || (coef < INT16_MIN))
+                    return HWC2_ERROR_UNSUPPORTED;
+                linearMatrix.coeffs[i * DRM_SAMSUNG_MATRIX_DIMENS + j] =
+                    static_cast<__u16>(static_cast<int16_t>(coef));
+            }
+            float offset = matrix[12 + i];
+            if ((offset > 1.0f) || (offset < -1.0f))
+                return HWC2_ERROR_UNSUPPORTED;
+            linearMatrix.offsets[i] =
+                static_cast<__u16>(static_cast<int16_t>(lroundf(offset * DQE_MATRIX_OFFSET_SCALE)));
+        }
+
+        int ret = mDrmDevice->CreatePropertyBlob(&linearMatrix, sizeof(linearMatrix), &blob);
+        if (ret || (blob == 0)) {
+            HWC_LOGE(mDisplayIdentifier, "%s:: Failed to create linear matrix blob %d",
+                     __func__, ret);
+            return HWC2_ERROR_UNSUPPORTED;
+        }
     }
-#endif
+
+    /* The blob of the previous request was not committed */
+    if (mColorRequest.matrix_request && mColorRequest.matrix_blob)
+        mDrmDevice->DestroyPropertyBlob(mColorRequest.matrix_blob);
+    mColorRequest.requestMatrix(blob);
+
     return HWC2_ERROR_NONE;
 }
 
@@ -681,7 +769,6 @@ int32_t ExynosDisplayDrmInterface::setActiveConfigWithConstraints(
         }
         ret = drmReq.commit(DRM_MODE_ATOMIC_TEST_ONLY, true);
         if (ret) {
-            drmReq.addOldBlob(modeBlob);
             HWC_LOGE(mDisplayIdentifier, "%s:: Failed to commit pset ret=%d in applyDisplayMode()\n",
                      __func__, ret);
             return ret;
@@ -691,7 +778,7 @@ int32_t ExynosDisplayDrmInterface::setActiveConfigWithConstraints(
     }
 
     if (modeBlob != 0) {
-        mDesiredModeState.setMode(*mode, modeBlob, drmReq);
+        mDesiredModeState.setMode(*mode, modeBlob);
     }
     return HWC2_ERROR_NONE;
 }
@@ -714,7 +801,6 @@ int32_t ExynosDisplayDrmInterface::setActiveDrmMode(DrmMode const &mode) {
     DrmModeAtomicReq drmReq(this);
 
     if ((ret = setDisplayMode(drmReq, modeBlob)) != NO_ERROR) {
-        drmReq.addOldBlob(modeBlob);
         HWC_LOGE(mDisplayIdentifier, "%s: Fail to apply display mode",
                  __func__);
         return ret;
@@ -723,7 +809,6 @@ int32_t ExynosDisplayDrmInterface::setActiveDrmMode(DrmMode const &mode) {
 
     ALOGD("%s, commit  %d -> %d", __func__, mActiveModeState.mode.id(), mode.id());
     if ((ret = drmReq.commit(DRM_MODE_ATOMIC_ALLOW_MODESET, true))) {
-        drmReq.addOldBlob(modeBlob);
         HWC_LOGE(mDisplayIdentifier, "%s:: Failed to commit pset ret=%d in applyDisplayMode()\n",
                  __func__, ret);
         return ret;
@@ -739,7 +824,7 @@ int32_t ExynosDisplayDrmInterface::setActiveDrmMode(DrmMode const &mode) {
     }
 
     mDrmConnector->set_active_mode(mode);
-    mActiveModeState.setMode(mode, modeBlob, drmReq);
+    mActiveModeState.setMode(mode, modeBlob);
     mActiveModeState.needs_modeset = false;
 
     return HWC2_ERROR_NONE;
@@ -747,6 +832,15 @@ int32_t ExynosDisplayDrmInterface::setActiveDrmMode(DrmMode const &mode) {
 
 int32_t ExynosDisplayDrmInterface::createModeBlob(const DrmMode &mode,
                                                   uint32_t &modeBlob) {
+    auto cached = mModeBlobs.find(mode.id());
+    if (cached != mModeBlobs.end()) {
+        modeBlob = cached->second;
+        return NO_ERROR;
+    }
+
+    /* Modes can be changed by hotplug */
+    destroyUnusedModeBlobs();
+
     struct drm_mode_modeinfo drm_mode;
     memset(&drm_mode, 0, sizeof(drm_mode));
     mode.ToDrmModeModeInfo(&drm_mode);
@@ -758,10 +852,27 @@ int32_t ExynosDisplayDrmInterface::createModeBlob(const DrmMode &mode,
         HWC_LOGE(mDisplayIdentifier, "Failed to create mode property blob %d", ret);
         return ret;
     }
+    mModeBlobs[mode.id()] = modeBlob;
 
     return NO_ERROR;
 }
 
+void ExynosDisplayDrmInterface::destroyUnusedModeBlobs() {
+    for (auto it = mModeBlobs.begin(); it != mModeBlobs.end();) {
+        uint32_t modeId = it->first;
+        bool used = (mActiveModeState.blob_id == it->second) ||
+                    (mDesiredModeState.blob_id == it->second) ||
+                    std::any_of(mDrmConnector->modes().begin(), mDrmConnector->modes().end(),
+                                [modeId](DrmMode const &m) { return m.id() == modeId; });
+        if (used) {
+            it++;
+            continue;
+        }
+        mDrmDevice->DestroyPropertyBlob(it->second);
+        it = mModeBlobs.erase(it);
+    }
+}
+
 int32_t ExynosDisplayDrmInterface::setDisplayMode(
     DrmModeAtomicReq &drmReq, const uint32_t modeBlob) {
     int ret = NO_ERROR;
@@ -788,10 +899,9 @@ int32_t ExynosDisplayDrmInterface::clearActiveDrmMode() {
     int ret = NO_ERROR;
     DrmModeAtomicReq drmReq(this);
 
-    if (mActiveModeState.blob_id) {
-        mDrmDevice->DestroyPropertyBlob(mActiveModeState.blob_id);
+    /* Blob of the mode is kept in mModeBlobs */
+    if (mActiveModeState.blob_id)
         mActiveModeState.reset();
-    }
 
     if ((ret = drmReq.atomicAddProperty(mDrmConnector->id(),
                                         mDrmConnector->crtc_id_property(), 0)) < 0)
@@ -834,7 +944,44 @@ int32_t ExynosDisplayDrmInterface::setActiveConfig(hwc2_config_t config,
 }
 
 int32_t ExynosDisplayDrmInterface::setCursorPositionAsync(uint32_t x_pos, uint32_t y_pos) {
-    return 0;
+    const CursorPlaneState &cursor = mCursorPlaneState;
+
+    if ((cursor.channelId < 0) || !cursor.movable)
+        return -EINVAL;
+
+    /* The clipped cursor needs new source crop, it is done by the next frame */
+    if (((uint64_t)x_pos + cursor.dst.w > cursor.dst.f_w) ||
+        ((uint64_t)y_pos + cursor.dst.h > cursor.dst.f_h))
+        return -ERANGE;
+
+    auto &plane = mDrmDevice->planes().at(cursor.channelId);
+    DrmModeAtomicReq drmReq(this);
+    int ret = NO_ERROR;
+
+    /*
+     * Only the position of the cursor plane is committed. Other planes and
+     * the buffer of the cursor keep the state of the last frame commit.
+     * The shadow makes the next frame commit send the position it has.
+     */
+    drmReq.setPropertyShadow(&mPropertyShadow);
+    if (((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->crtc_x_property(), x_pos)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->crtc_y_property(), y_pos)) < 0))
+        return ret;
+
+    if (drmReq.getSkippedPropertyNum() == 2)
+        return NO_ERROR;
+
+    if ((ret = drmReq.commit(DRM_MODE_ATOMIC_NONBLOCK)) < 0) {
+        HWC_LOGE(mDisplayIdentifier, "%s:: Failed to move cursor to (%d, %d) ret(%d)",
+                 __func__, x_pos, y_pos, ret);
+        return ret;
+    }
+    HDEBUGLOGD(eDebugDisplayInterfaceConfig, "%s:: cursor plane %d is moved to (%d, %d)",
+               __func__, cursor.channelId, x_pos, y_pos);
+
+    return NO_ERROR;
 }
 
 int32_t ExynosDisplayDrmInterface::updateHdrCapabilities(std::vector<int32_t> &outTypes,
@@ -966,29 +1113,29 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         return ret;
     }
 
-    if (((ret = drmReq.atomicAddProperty(plane->id(), plane->crtc_property(),
-                                         mDrmCrtc->id())) < 0) ||
+    if (((ret = drmReq.atomicAddShadowedProperty(plane->id(), plane->crtc_property(),
+                                                 mDrmCrtc->id())) < 0) ||
         ((ret = drmReq.atomicAddProperty(plane->id(), plane->fb_property(),
                                          fbId)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_x_property(), config.dst.x)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_y_property(), config.dst.y)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_w_property(), config.dst.w)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_h_property(), config.dst.h)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_x_property(),
-                                         (int)(config.src.x) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_y_property(),
-                                         (int)(config.src.y) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_w_property(),
-                                         (int)(config.src.w) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_h_property(),
-                                         (int)(config.src.h) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->rotation_property(),
-                                         halTransformToDrmRot(config.transform), true)) < 0)) {
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->crtc_x_property(), config.dst.x)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->crtc_y_property(), config.dst.y)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->crtc_w_property(), config.dst.w)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->crtc_h_property(), config.dst.h)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(), plane->src_x_property(),
+                                                 (int)(config.src.x) << 16)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(), plane->src_y_property(),
+                                                 (int)(config.src.y) << 16)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(), plane->src_w_property(),
+                                                 (int)(config.src.w) << 16)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(), plane->src_h_property(),
+                                                 (int)(config.src.h) << 16)) < 0) ||
+        ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                 plane->rotation_property(),
+                                                 halTransformToDrmRot(config.transform), true)) < 0)) {
         HWC_LOGE(mDisplayIdentifier, "Fail to set properties");
         return ret;
     }
@@ -999,8 +1146,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         int32_t retVal = NO_ERROR;
         uint64_t drmEnum = 0;
         std::tie(drmEnum, retVal) = halToDrmEnum(halData, drmEnums);
-        if ((retVal < 0) || ((retVal = drmReq.atomicAddProperty(plane->id(),
-                                                                property, drmEnum, true)) < 0)) {
+        if ((retVal < 0) || ((retVal = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                                        property, drmEnum, true)) < 0)) {
             HWC_LOGE(mDisplayIdentifier, "Fail to set %s (%d)",
                      property.name().c_str(), halData);
             return retVal;
@@ -1019,8 +1166,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         // Ignore ret and use min_zpos as 0 by default
         std::tie(std::ignore, min_zpos) = plane->zpos_property().range_min();
 
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                            plane->zpos_property(), configIndex + min_zpos)) < 0)
+        if ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                    plane->zpos_property(), configIndex + min_zpos)) < 0)
             return ret;
     }
 
@@ -1036,9 +1183,9 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
             ALOGW("[%s] Invalid plane alpha (%f)", mDisplayIdentifier.name.string(), config.plane_alpha);
         }
 
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                            plane->alpha_property(),
-                                            planeAlpha, true)) < 0)
+        if ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                    plane->alpha_property(),
+                                                    planeAlpha, true)) < 0)
             return ret;
     }
 
@@ -1049,8 +1196,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
 
     if (config.state == config.WIN_STATE_COLOR) {
         if (plane->colormap_property().id()) {
-            if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                                plane->colormap_property(), config.color)) < 0)
+            if ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                        plane->colormap_property(), config.color)) < 0)
                 return ret;
         } else {
             HWC_LOGE(mDisplayIdentifier, "colormap property is not supported");
@@ -1077,8 +1224,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
     }
 
     if (plane->virtual8k_split_property().id()) {
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                            plane->virtual8k_split_property(), config.split, true)) < 0)
+        if ((ret = drmReq.atomicAddShadowedProperty(plane->id(),
+                                                    plane->virtual8k_split_property(), config.split, true)) < 0)
             return ret;
     }
 
@@ -1093,7 +1240,7 @@ int32_t ExynosDisplayDrmInterface::setFrameStaticMeta(DrmModeAtomicReq &drmReq,
     int ret = NO_ERROR;
 
     if (config.metaParcel != nullptr) {
-        struct hdr_output_metadata drm_hdr_meta;
+        struct hdr_output_metadata drm_hdr_meta = {};
         drm_hdr_meta.hdmi_metadata_type1.display_primaries[0].x =
             static_cast<__u16>(config.metaParcel->sHdrStaticInfo.sType1.mR.x);
         drm_hdr_meta.hdmi_metadata_type1.display_primaries[0].y =
@@ -1115,18 +1262,26 @@ int32_t ExynosDisplayDrmInterface::setFrameStaticMeta(DrmModeAtomicReq &drmReq,
         drm_hdr_meta.hdmi_metadata_type1.max_fall =
             static_cast<__u16>(config.metaParcel->sHdrStaticInfo.sType1.mMaxFrameAverageLightLevel);
 
-        uint32_t blob_id = 0;
-        ret = mDrmDevice->CreatePropertyBlob(&drm_hdr_meta, sizeof(drm_hdr_meta), &blob_id);
-        if (ret || (blob_id == 0)) {
-            HWC_LOGE(mDisplayIdentifier, "Failed to create static meta"
-                                         "blob id=%d, ret=%d",
-                     blob_id, ret);
-            return ret;
+        if ((mHdrOutputMetaState.blob_id == 0) ||
+            mHdrOutputMetaState.isUpdated(drm_hdr_meta)) {
+            uint32_t blob_id = 0;
+            ret = mDrmDevice->CreatePropertyBlob(&drm_hdr_meta, sizeof(drm_hdr_meta), &blob_id);
+            if (ret || (blob_id == 0)) {
+                HWC_LOGE(mDisplayIdentifier, "Failed to create static meta"
+                                             "blob id=%d, ret=%d",
+                         blob_id, ret);
+                return ret;
+            }
+            mHdrOutputMetaState.meta = drm_hdr_meta;
+
+            if (mHdrOutputMetaState.blob_id)
+                drmReq.addOldBlob(mHdrOutputMetaState.blob_id);
+            mHdrOutputMetaState.blob_id = blob_id;
         }
 
         if ((ret = drmReq.atomicAddProperty(mDrmConnector->id(),
                                             mDrmConnector->hdr_output_meta(),
-                                            blob_id)) < 0) {
+                                            mHdrOutputMetaState.blob_id)) < 0) {
             HWC_LOGE(mDisplayIdentifier, "Failed to set hdr_output_meta property %d", ret);
             return ret;
         }
@@ -1202,21 +1357,31 @@ void ExynosDisplayDrmInterface::disablePlanes(DrmModeAtomicReq &drmReq,
     for (auto &plane : mDrmDevice->planes()) {
         uint32_t curChId = chId++;
         ExynosMPP *exynosMPP = mExynosMPPsForPlane[plane->id()];
-        if (((exynosMPP != nullptr) && (mDisplayIdentifier.id != UINT32_MAX) &&
-             (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_RESERVED) &&
-             (exynosMPP->mReservedDisplayInfo.displayIdentifier.id !=
-              (int32_t)mDisplayIdentifier.id) &&
-             (!mCanDisableAllPlanes)) ||
-            ((planeEnableInfo != nullptr) &&
-             (planeEnableInfo[curChId] == 1)))
+        if ((exynosMPP != nullptr) && (mDisplayIdentifier.id != UINT32_MAX) &&
+            (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_RESERVED) &&
+            (exynosMPP->mReservedDisplayInfo.displayIdentifier.id !=
+             (int32_t)mDisplayIdentifier.id) &&
+            (!mCanDisableAllPlanes)) {
+            /* Other display can change this plane */
+            mPropertyShadow.invalidateObject(plane->id());
             continue;
+        }
+        if ((planeEnableInfo != nullptr) &&
+            (planeEnableInfo[curChId] == 1))
+            continue;
+
+        if ((exynosMPP != nullptr) &&
+            (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_ASSIGNED) &&
+            (exynosMPP->mAssignedDisplayInfo.displayIdentifier.id !=
+             (int32_t)mDisplayIdentifier.id))
+            mPropertyShadow.invalidateObject(plane->id());
 
-        if (drmReq.atomicAddProperty(plane->id(), plane->crtc_property(), 0) < 0) {
+        if (drmReq.atomicAddShadowedProperty(plane->id(), plane->crtc_property(), 0) < 0) {
             HWC_LOGE(mDisplayIdentifier, "%s:: Fail to add crtc_property",
                      __func__);
             continue;
         }
-        if (drmReq.atomicAddProperty(plane->id(), plane->fb_property(), 0) < 0) {
+        if (drmReq.atomicAddShadowedProperty(plane->id(), plane->fb_property(), 0) < 0) {
             HWC_LOGE(mDisplayIdentifier, "%s:: Fail to add fb_property",
                      __func__);
             continue;
@@ -1224,6 +1389,15 @@ void ExynosDisplayDrmInterface::disablePlanes(DrmModeAtomicReq &drmReq,
     }
 }
 
+void ExynosDisplayDrmInterface::DrmPropertyShadow::invalidateObject(const uint32_t objectId) {
+    for (auto it = mValues.begin(); it != mValues.end();) {
+        if ((uint32_t)(it->first >> 32) == objectId)
+            it = mValues.erase(it);
+        else
+            it++;
+    }
+}
+
 void ExynosDisplayDrmInterface::flipFBs(bool isActiveCommit) {
     if (mFbIds.size() > 0) {
         if (isActiveCommit) {
@@ -1238,6 +1412,7 @@ void ExynosDisplayDrmInterface::flipFBs(bool isActiveCommit) {
 }
 
 int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData) {
+    ExynosLatencyStats::Scope latencyScope(mDisplayIdentifier.id, LATENCY_STAGE_INTERFACE_DELIVER);
     int ret = NO_ERROR;
     uint32_t planeEnableInfo[MAX_DECON_WIN] = {0};
     android::String8 result;
@@ -1247,7 +1422,17 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
             flipFBs((ret == NO_ERROR) && !mDrmReq.getError());
             mDrmReq.reset(); });
 
+    if (exynosHWCControl.atomicPropertyShadow) {
+        mDrmReq.setPropertyShadow(&mPropertyShadow);
+    } else {
+        mDrmReq.setPropertyShadow(nullptr);
+        mPropertyShadow.invalidate();
+    }
+
     if (mDesiredModeState.needs_modeset) {
+        /* Planes are reprogrammed by modeset, send every property */
+        mPropertyShadow.invalidate();
+
         /* Use different instance with mDrmReq */
         DrmModeAtomicReq drmReqForModeSet(this);
 
@@ -1294,6 +1479,7 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
     }
 
     size_t virtualPlaneIndex = 0;
+    CursorPlaneState cursorPlaneState;
     for (exynos_win_config_data &config : dpuData.configs) {
         if ((config.state != config.WIN_STATE_BUFFER) &&
             (config.state != config.WIN_STATE_COLOR) &&
@@ -1305,6 +1491,16 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
 
         int channelId = config.assignedMPP->mChId;
 
+        if (config.state == config.WIN_STATE_CURSOR) {
+            cursorPlaneState.channelId = channelId;
+            cursorPlaneState.dst = config.dst;
+            cursorPlaneState.movable =
+                (config.transform == 0) &&
+                (config.src.x == 0) && (config.src.y == 0) &&
+                (config.src.w == config.src.f_w) && (config.src.h == config.src.f_h) &&
+                (config.src.w == config.dst.w) && (config.src.h == config.dst.h);
+        }
+
         /* src size should be set even in dim layer */
         if (config.state == config.WIN_STATE_COLOR) {
             config.src.w = config.dst.w;
@@ -1358,8 +1554,12 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
     if ((ret = mDrmReq.commit(flags, true)) < 0) {
         HWC_LOGE(mDisplayIdentifier, "%s:: Failed to commit pset ret=%d in deliverWinConfigData()\n",
                  __func__, ret);
+        mCursorPlaneState = {};
         return ret;
     }
+    mCursorPlaneState = cursorPlaneState;
+    HDEBUGLOGD(eDebugDisplayInterfaceConfig, "%s:: %d properties are skipped by shadow",
+               __func__, mDrmReq.getSkippedPropertyNum());
 
     if (dpuData.enable_standalone_writeback) {
         dpuData.present_fence = dpuData.standalone_writeback_info.acq_fence;
@@ -1373,6 +1573,7 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
         ALOGE("%d Getting present_fence = 0!!", __LINE__);
         dpuData.present_fence = -1;
     }
+    updateInFlightFence(dpuData.present_fence);
 
     /*
      * [HACK] dup present_fence for each layer's release fence
@@ -1394,7 +1595,7 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
     if (mDesiredModeState.needs_modeset) {
         HDEBUGLOGD(eDebugDisplayConfig, "%s:: mActiveModeState is updated to mDesiredModeState(%d -> %d)",
                    __func__, mActiveModeState.mode.id(), mDesiredModeState.mode.id());
-        mDesiredModeState.apply(mActiveModeState, mDrmReq);
+        mDesiredModeState.apply(mActiveModeState);
     }
 
     return NO_ERROR;
@@ -1511,6 +1712,7 @@ int32_t ExynosDisplayDrmInterface::clearDisplay() {
                  __func__, ret);
         return ret;
     }
+    mCursorPlaneState = {};
 
     return NO_ERROR;
 }
@@ -1585,6 +1787,9 @@ void ExynosDisplayDrmInterface::DrmModeAtomicReq::reset() {
         HWC_LOGE(mDrmDisplayInterface->mDisplayIdentifier, "destroy blob error");
 
     drmModeAtomicSetCursor(mPset, 0);
+    if (mShadow)
+        mShadow->discardPending();
+    mSkippedPropertyNum = 0;
 }
 
 int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
@@ -1605,11 +1810,26 @@ int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
                      __func__, property.id(), property.name().c_str(), id, ret);
             return ret;
         }
+        if (mShadow)
+            mShadow->stage(id, property.id(), value);
     }
 
     return NO_ERROR;
 }
 
+int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddShadowedProperty(
+    const uint32_t id,
+    const DrmProperty &property,
+    uint64_t value, bool optional) {
+    if (mShadow && property.id() &&
+        mShadow->isApplied(id, property.id(), value)) {
+        mSkippedPropertyNum++;
+        return NO_ERROR;
+    }
+
+    return atomicAddProperty(id, property, value, optional);
+}
+
 String8 &ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
     String8 &result, bool debugPrint) {
     /* print log only if eDebugDisplayInterfaceConfig flag is set when debugPrint is true */
@@ -1685,10 +1905,38 @@ String8 &ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
     return result;
 }
 
+void ExynosDisplayDrmInterface::updateInFlightFence(int presentFence) {
+    if (mInFlightFence >= 0)
+        close(mInFlightFence);
+    mInFlightFence = (presentFence >= 0) ? dup(presentFence) : -1;
+}
+
+void ExynosDisplayDrmInterface::waitInFlightCommit() {
+    if (mInFlightFence < 0)
+        return;
+
+    ATRACE_CALL();
+    HWC_TRACE_EVENT("fence_wait", "display", mDisplayIdentifier.id, "fence", mInFlightFence);
+    if (sync_wait(mInFlightFence, IN_FLIGHT_COMMIT_WAIT_MS) < 0)
+        HWC_LOGE(mDisplayIdentifier, "%s:: fence(%d) is not signaled during %d ms",
+                 __func__, mInFlightFence, IN_FLIGHT_COMMIT_WAIT_MS);
+}
+
 int ExynosDisplayDrmInterface::DrmModeAtomicReq::commit(uint32_t flags, bool loggingForDebug) {
+    ExynosLatencyStats::Scope latencyScope(mDrmDisplayInterface->mDisplayIdentifier.id,
+                                           LATENCY_STAGE_ATOMIC_COMMIT);
+    HWC_TRACE_EVENT("commit", "display", mDrmDisplayInterface->mDisplayIdentifier.id,
+                    "flags", flags);
     android::String8 result;
     int ret = drmModeAtomicCommit(mDrmDisplayInterface->mDrmDevice->fd(),
                                   mPset, flags, mDrmDisplayInterface->mDrmDevice);
+    /* Back-pressure of nonblocking commit, previous commit is not flipped yet */
+    if ((ret == -EBUSY) && (flags & DRM_MODE_ATOMIC_NONBLOCK) &&
+        !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+        mDrmDisplayInterface->waitInFlightCommit();
+        ret = drmModeAtomicCommit(mDrmDisplayInterface->mDrmDevice->fd(),
+                                  mPset, flags, mDrmDisplayInterface->mDrmDevice);
+    }
     if (loggingForDebug)
         dumpAtomicCommitInfo(result, true);
     if (ret < 0) {
@@ -1696,6 +1944,18 @@ int ExynosDisplayDrmInterface::DrmModeAtomicReq::commit(uint32_t flags, bool log
         setError(ret);
     }
 
+    if (flags & DRM_MODE_ATOMIC_TEST_ONLY) {
+        if (mShadow)
+            mShadow->discardPending();
+    } else if (mShadow == nullptr) {
+        /* Kernel state is changed outside of the frame commit */
+        mDrmDisplayInterface->mPropertyShadow.invalidate();
+    } else if (ret < 0) {
+        mShadow->invalidate();
+    } else {
+        mShadow->apply();
+    }
+
     return ret;
 }
 
@@ -1710,6 +1970,58 @@ std::tuple<uint64_t, int> ExynosDisplayDrmInterface::halToDrmEnum(
     }
 }
 
+void ExynosDisplayDrmInterface::getSupportedContentTypes(std::vector<uint32_t> &outTypes) {
+    /* NONE is not reported as a content type */
+    for (uint32_t type = HWC2_CONTENT_TYPE_GRAPHICS; type <= HWC2_CONTENT_TYPE_GAME; type++) {
+        if (mContentTypeEnums.count(type))
+            outTypes.push_back(type);
+    }
+}
+
+int32_t ExynosDisplayDrmInterface::setContentType(int32_t contentType) {
+    int ret = 0;
+    uint64_t drmEnum = 0;
+    std::tie(drmEnum, ret) = halToDrmEnum(contentType, mContentTypeEnums);
+    if (ret < 0)
+        return HWC2_ERROR_UNSUPPORTED;
+
+    DrmModeAtomicReq drmReq(this);
+    if ((ret = drmReq.atomicAddProperty(mDrmConnector->id(),
+                                        mDrmConnector->content_type(), drmEnum)) < 0)
+        return ret;
+
+    if ((ret = drmReq.commit(0, true)) < 0) {
+        HWC_LOGE(mDisplayIdentifier, "%s:: Failed to commit content type(%d) ret=%d",
+                 __func__, contentType, ret);
+        return ret;
+    }
+
+    return NO_ERROR;
+}
+
+bool ExynosDisplayDrmInterface::isAllmSupported() {
+    return (mDrmConnector != nullptr) && (mDrmConnector->allm().id() != 0);
+}
+
+int32_t ExynosDisplayDrmInterface::setAutoLowLatencyMode(bool on) {
+    if (!isAllmSupported())
+        return HWC2_ERROR_UNSUPPORTED;
+
+    int32_t ret = NO_ERROR;
+    DrmModeAtomicReq drmReq(this);
+    if ((ret = drmReq.atomicAddProperty(mDrmConnector->id(),
+                                        mDrmConnector->allm(), on ? 1 : 0)) < 0)
+        return ret;
+
+    if ((ret = drmReq.commit(0, true)) < 0) {
+        HWC_LOGE(mDisplayIdentifier, "%s:: Failed to commit allm(%d) ret=%d",
+                 __func__, on, ret);
+        return ret;
+    }
+
+    return NO_ERROR;
+}
+
 int32_t ExynosDisplayDrmInterface::getReadbackBufferAttributes(
     int32_t * /*android_pixel_format_t*/ outFormat,
     int32_t * /*android_dataspace_t*/ outDataspace) {
@@ -1939,46 +2251,31 @@ int32_t ExynosDisplayDrmInterface::getDisplayIdentificationData(
         return HWC2_ERROR_UNSUPPORTED;
     }
 
-    if (mDrmConnector->UpdateEdid() < 0) {
-        ALOGE("UpdateEdid fail");
-    }
-
     if (mDrmConnector->edid_property().id() == 0) {
         ALOGD("%s: edid_property is not supported",
               mDisplayIdentifier.name.string());
         return HWC2_ERROR_UNSUPPORTED;
     }
 
-    drmModePropertyBlobPtr blob;
-    int ret;
-    uint64_t blobId;
-
-    std::tie(ret, blobId) = mDrmConnector->edid_property().value();
-    if (ret) {
-        ALOGE("Failed to get edid property value.");
-        return HWC2_ERROR_UNSUPPORTED;
-    }
-    if (blobId == 0) {
-        ALOGD("%s: edid_property is supported but blob is not valid",
-              mDisplayIdentifier.name.string());
-        return HWC2_ERROR_UNSUPPORTED;
+    /* EDID is read again only if the blob of connector is changed */
+    if (mDrmConnector->UpdateEdid() < 0) {
+        ALOGE("UpdateEdid fail");
     }
 
-    blob = drmModeGetPropertyBlob(mDrmDevice->fd(), blobId);
-    if (blob == nullptr) {
-        ALOGD("%s: Failed to get blob",
+    const std::vector<uint8_t> &edid = mDrmConnector->edid();
+    if (edid.empty()) {
+        ALOGD("%s: edid_property is supported but blob is not valid",
               mDisplayIdentifier.name.string());
         return HWC2_ERROR_UNSUPPORTED;
     }
 
     if (outData) {
-        *outDataSize = std::min(*outDataSize, blob->length);
-        memcpy(outData, blob->data, *outDataSize);
+        *outDataSize = std::min(*outDataSize, static_cast<uint32_t>(edid.size()));
+        memcpy(outData, edid.data(), *outDataSize);
     } else {
-        *outDataSize = blob->length;
+        *outDataSize = static_cast<uint32_t>(edid.size());
     }
     *outPort = mDrmConnector->id();
-    drmModeFreePropertyBlob(blob);
 
     return HWC2_ERROR_NONE;
 }
@@ -2009,16 +2306,23 @@ bool ExynosDisplayDrmInterface::readHotplugStatus() {
         return false;
     }
 
+    /* The connector is read again only by hotplug events */
+    if (mHotplugState.load(std::memory_order_acquire) < 0)
+        updateHotplugStatus();
+
+    return mHotplugState.load(std::memory_order_acquire) == DRM_MODE_CONNECTED;
+}
+
+void ExynosDisplayDrmInterface::updateHotplugStatus() {
+    if (mDrmConnector == nullptr) {
+        return;
+    }
+
     uint32_t numConfigs;
     std::map<uint32_t, displayConfigs_t> temp;
     getDisplayConfigs(&numConfigs, NULL, temp);
 
-    if (mDrmConnector->state() == DRM_MODE_CONNECTED)
-        return true;
-    else if (mDrmConnector->state() == DRM_MODE_DISCONNECTED)
-        return false;
-
-    return false;
+    mHotplugState.store(mDrmConnector->state(), std::memory_order_release);
 }
 
 bool ExynosDisplayDrmInterface::updateHdrSinkInfo() {
@@ -2042,6 +2346,40 @@ bool ExynosDisplayDrmInterface::updateHdrSinkInfo() {
     return mIsHdrSink = hdr_sink_connected == 0 ? false : true;
 }
 
+bool ExynosDisplayDrmInterface::isVrrCapable() {
+    if ((mDrmCrtc == nullptr) || (mDrmCrtc->vrr_enabled_property().id() == 0))
+        return false;
+
+    if (mDrmConnector->UpdateVrrCapable() < 0)
+        return false;
+
+    int ret = 0;
+    uint64_t vrrCapable = 0;
+    std::tie(ret, vrrCapable) = mDrmConnector->vrr_capable().value();
+
+    return (ret == 0) && (vrrCapable != 0);
+}
+
+int32_t ExynosDisplayDrmInterface::setVrrEnabled(bool enabled) {
+    if ((mDrmCrtc == nullptr) || (mDrmCrtc->vrr_enabled_property().id() == 0))
+        return HWC2_ERROR_UNSUPPORTED;
+
+    int32_t ret = NO_ERROR;
+    DrmModeAtomicReq drmReq(this);
+    if ((ret = drmReq.atomicAddProperty(mDrmCrtc->id(),
+                                        mDrmCrtc->vrr_enabled_property(),
+                                        enabled ? 1 : 0)) < 0)
+        return ret;
+
+    if ((ret = drmReq.commit(0, true)) < 0) {
+        HWC_LOGE(mDisplayIdentifier, "%s:: Failed to commit VRR_ENABLED(%d) ret=%d",
+                 __func__, enabled, ret);
+        return ret;
+    }
+
+    return NO_ERROR;
+}
+
 void ExynosDisplayDrmInterface::onDisplayRemoved() {
     mFBManager.onDisplayRemoved(mDisplayIdentifier.type);
 }
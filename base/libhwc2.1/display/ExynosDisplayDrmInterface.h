@@ -20,6 +20,7 @@
 #include <samsung_drm.h>
 #include <xf86drmMode.h>
 
+#include <atomic>
 #include <unordered_map>
 
 #include "ExynosDisplay.h"
@@ -32,6 +33,9 @@
 #include "drmcrtc.h"
 #include "vsyncworker.h"
 
+/* Max wait time for the in-flight commit when the next commit is busy */
+#define IN_FLIGHT_COMMIT_WAIT_MS 100
+
 #ifndef HWC_FORCE_PANIC_PATH
 #define HWC_FORCE_PANIC_PATH "/d/dri/1/crtc-0/panic"
 #endif
@@ -50,6 +54,44 @@ enum drm_virtual8k_split {
 class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
                                   public VsyncCallback {
   public:
+    /*
+     * Values of properties that were applied by the last successful
+     * commits of this display, keyed by (object id, property id).
+     * Properties added through atomicAddShadowedProperty() are dropped
+     * from the request if the kernel already has the same value.
+     */
+    class DrmPropertyShadow {
+      public:
+        bool isApplied(const uint32_t objectId, const uint32_t propertyId,
+                       const uint64_t value) const {
+            auto it = mValues.find(key(objectId, propertyId));
+            return (it != mValues.end()) && (it->second == value);
+        };
+        void stage(const uint32_t objectId, const uint32_t propertyId,
+                   const uint64_t value) {
+            mPending.push_back(std::make_pair(key(objectId, propertyId), value));
+        };
+        void apply() {
+            for (auto &pending : mPending)
+                mValues[pending.first] = pending.second;
+            mPending.clear();
+        };
+        void discardPending() { mPending.clear(); };
+        void invalidate() {
+            mValues.clear();
+            mPending.clear();
+        };
+        void invalidateObject(const uint32_t objectId);
+        size_t size() const { return mValues.size(); };
+
+      private:
+        static uint64_t key(const uint32_t objectId, const uint32_t propertyId) {
+            return ((uint64_t)objectId << 32) | propertyId;
+        };
+        std::unordered_map<uint64_t, uint64_t> mValues;
+        std::vector<std::pair<uint64_t, uint64_t>> mPending;
+    };
+
     class DrmModeAtomicReq {
       public:
         DrmModeAtomicReq(){};
@@ -67,6 +109,11 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         int32_t atomicAddProperty(const uint32_t id,
                                   const DrmProperty &property,
                                   uint64_t value, bool optional = false);
+        int32_t atomicAddShadowedProperty(const uint32_t id,
+                                          const DrmProperty &property,
+                                          uint64_t value, bool optional = false);
+        void setPropertyShadow(DrmPropertyShadow *shadow) { mShadow = shadow; };
+        uint32_t getSkippedPropertyNum() { return mSkippedPropertyNum; };
         String8 &dumpAtomicCommitInfo(String8 &result, bool debugPrint = false);
         int commit(uint32_t flags, bool loggingForDebug = false);
         void addOldBlob(uint32_t blob_id) {
@@ -91,6 +138,9 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         ExynosDisplayDrmInterface *mDrmDisplayInterface = NULL;
         /* Destroy old blobs after commit */
         std::vector<uint32_t> mOldBlobs;
+        /* Shadow of committed properties, only set for the frame commit */
+        DrmPropertyShadow *mShadow = nullptr;
+        uint32_t mSkippedPropertyNum = 0;
         int drmFd() const { return mDrmDisplayInterface->mDrmDevice->fd(); }
     };
     void Callback(int display, int64_t timestamp) override;
@@ -111,8 +161,8 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     virtual int32_t getColorModes(
         uint32_t *outNumModes,
         int32_t *outModes);
-    virtual int32_t setColorTransform(const float *__unused matrix,
-                                      int32_t __unused hint, int32_t __unused dqe_fd);
+    virtual int32_t setColorTransform(const float *matrix,
+                                      int32_t hint, int32_t __unused dqe_fd);
     virtual int32_t setColorMode(int32_t mode, int32_t __unused dqe_fd);
     virtual int32_t setColorModeWithRenderIntent(int32_t __unused mode, int32_t __unused intent,
                                                  int32_t __unused dqe_fd);
@@ -147,14 +197,19 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     virtual void setDeviceToDisplayInterface(const struct DeviceToDisplayInterface &initData);
     virtual void onDisplayRemoved() override;
     virtual void onLayerDestroyed(hwc2_layer_t layer) override {
+        mFBManager.onLayerDestroyed();
         mFBManager.removeBuffersForOwner((void *)layer);
     };
     virtual void onLayerCreated(hwc2_layer_t __unused outLayer) override {
+        mFBManager.onLayerCreated();
         mFBManager.cleanupSignal();
     };
     virtual void onClientTargetDestroyed(void *owner) override {
         mFBManager.removeBuffersForOwner(owner);
     };
+    virtual void preImportBuffer(const exynos_win_config_data &config) override {
+        mFBManager.preImport(mDisplayIdentifier.type, config);
+    };
 
     struct virtual8KOTFHalfInfo {
         int32_t channelId = -1;
@@ -167,7 +222,14 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     bool getVirtual8KOtfInfo(exynos_win_config_data &config,
                              virtual8KOTFInfo &virtualOtfInfo);
     virtual bool readHotplugStatus();
+    virtual void updateHotplugStatus();
     virtual bool updateHdrSinkInfo();
+    virtual bool isVrrCapable();
+    virtual int32_t setVrrEnabled(bool enabled);
+    virtual void getSupportedContentTypes(std::vector<uint32_t> &outTypes);
+    virtual int32_t setContentType(int32_t contentType);
+    virtual bool isAllmSupported();
+    virtual int32_t setAutoLowLatencyMode(bool on);
     virtual void canDisableAllPlanes(bool canDisable) {
         mCanDisableAllPlanes = canDisable;
     }
@@ -181,24 +243,20 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     };
 
   protected:
+    /* Mode blobs are owned by mModeBlobs */
     struct ModeState {
         bool needs_modeset = false;
         DrmMode mode;
         uint32_t blob_id = 0;
-        uint32_t old_blob_id = 0;
-        void setMode(const DrmMode newMode, const uint32_t modeBlob,
-                     DrmModeAtomicReq &drmReq) {
-            drmReq.addOldBlob(old_blob_id);
+        void setMode(const DrmMode newMode, const uint32_t modeBlob) {
             mode = newMode;
-            old_blob_id = blob_id;
             blob_id = modeBlob;
         };
         void reset() {
             *this = {};
         };
-        void apply(ModeState &toModeState, DrmModeAtomicReq &drmReq) {
-            toModeState.setMode(mode, blob_id, drmReq);
-            drmReq.addOldBlob(old_blob_id);
+        void apply(ModeState &toModeState) {
+            toModeState.setMode(mode, blob_id);
             reset();
         };
     };
@@ -207,6 +265,10 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         int32_t dqe_fd = -1;
         int32_t color_mode = -1;
         int32_t render_intent = -1;
+        /* linear_matrix blob, 0 bypasses the matrix */
+        bool matrix_request = false;
+        uint32_t matrix_blob = 0;
+        uint32_t active_matrix_blob = 0;
         void requestTransform(int32_t fd) {
             hasRequest = true;
             dqe_fd = fd;
@@ -217,6 +279,11 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
             color_mode = mode;
             render_intent = intent;
         }
+        void requestMatrix(uint32_t blob) {
+            hasRequest = true;
+            matrix_request = true;
+            matrix_blob = blob;
+        }
         void apply(DrmModeAtomicReq &drmReq, DrmCrtc *drmCrtc) {
             if (!hasRequest)
                 return;
@@ -238,7 +305,21 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
                     ALOGE("%s:: set render_intent property failed", __func__);
                 }
             }
+            if (matrix_request) {
+                if (drmReq.atomicAddProperty(drmCrtc->id(),
+                                             drmCrtc->linear_matrix_property(), matrix_blob) < 0) {
+                    ALOGE("%s:: set linear_matrix property failed", __func__);
+                    if (matrix_blob)
+                        drmReq.addOldBlob(matrix_blob);
+                } else {
+                    if (active_matrix_blob)
+                        drmReq.addOldBlob(active_matrix_blob);
+                    active_matrix_blob = matrix_blob;
+                }
+            }
             hasRequest = false;
+            matrix_request = false;
+            matrix_blob = 0;
             dqe_fd = -1;
             color_mode = -1;
             render_intent = -1;
@@ -246,6 +327,7 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     };
 
     int32_t createModeBlob(const DrmMode &mode, uint32_t &modeBlob);
+    void destroyUnusedModeBlobs();
     int32_t setDisplayMode(DrmModeAtomicReq &drmReq, const uint32_t modeBlob);
     int32_t chosePreferredConfig();
     static std::tuple<uint64_t, int> halToDrmEnum(
@@ -276,6 +358,7 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     void parseColorModeEnums(const DrmProperty &property);
     void parsePanelTypeEnums(const DrmProperty &property);
     void parseVirtual8kEnums(const DrmProperty &property);
+    void parseContentTypeEnums(const DrmProperty &property);
 
     void disablePlanes(DrmModeAtomicReq &drmReq,
                        uint32_t *planeEnableInfo = nullptr);
@@ -307,6 +390,23 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         };
     };
 
+    /* hdr_output_metadata blob of the connector, recreated only if the metadata changes */
+    struct HdrOutputMetaState {
+        struct hdr_output_metadata meta = {};
+        uint32_t blob_id = 0;
+        bool isUpdated(const hdr_output_metadata &newMeta) {
+            return memcmp(&meta, &newMeta, sizeof(meta)) != 0;
+        };
+    };
+
+    /* Cursor window of the last frame commit, moved by setCursorPositionAsync() */
+    struct CursorPlaneState {
+        int32_t channelId = -1;
+        struct decon_frame dst = {0, 0, 0, 0, 0, 0};
+        /* The whole cursor buffer is shown unscaled, so only CRTC_X/Y can change */
+        bool movable = false;
+    };
+
   protected:
     class DrmWritebackInfo {
       public:
@@ -325,10 +425,18 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     DrmDevice *mDrmDevice;
     DrmCrtc *mDrmCrtc;
     DrmConnector *mDrmConnector;
+    /*
+     * Connection state of mDrmConnector, refreshed by hotplug events.
+     * -1 until the connector is read for the first time.
+     */
+    std::atomic<int32_t> mHotplugState{-1};
     VSyncWorker mDrmVSyncWorker;
     ModeState mActiveModeState;
     ModeState mDesiredModeState;
+    /* Mode blobs are kept per DrmMode id for switching back and forth */
+    std::unordered_map<uint32_t, uint32_t> mModeBlobs;
     PartialRegionState mPartialRegionState;
+    HdrOutputMetaState mHdrOutputMetaState;
     /* Mapping plane id to ExynosMPP, key is plane id */
     std::unordered_map<uint32_t, ExynosMPP *> mExynosMPPsForPlane;
 
@@ -339,13 +447,27 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     DrmPropertyMap mPanelTypeEnums;
     DrmPropertyMap mColorModeEnums;
     DrmPropertyMap mVirtual8kEnums;
+    DrmPropertyMap mContentTypeEnums;
 
     DrmWritebackInfo mWritebackInfo;
 
     FramebufferManager &mFBManager = FramebufferManager::getInstance();
 
+    /* Declared before mDrmReq that refers to it */
+    DrmPropertyShadow mPropertyShadow;
+
+    /*
+     * Present fence of the last commit. Nonblocking commit is rejected
+     * with -EBUSY while the previous one is not flipped yet,
+     * it is waited only in that case.
+     */
+    int mInFlightFence = -1;
+    void updateInFlightFence(int presentFence);
+    void waitInFlightCommit();
     DrmModeAtomicReq mDrmReq;
     ColorRequest mColorRequest;
+    CursorPlaneState mCursorPlaneState;
+    int32_t setLinearMatrix(const float *matrix, int32_t hint);
 
   private:
     std::unordered_map</*mode id*/ uint32_t, DrmMode> mDozeDrmModes;
@@ -483,18 +483,69 @@ int32_t ExynosDisplayFbInterface::postProcessForVirtual8K(struct decon_win_confi
     return NO_ERROR;
 }
 
+/* Returns true if cur differs from last only in the buffer fds and the fences */
+bool ExynosDisplayFbInterface::canReuseWinConfig(const exynos_win_config_data &last,
+                                                 const exynos_win_config_data &cur) {
+    return (last.state == cur.state) &&
+           (last.color == cur.color) &&
+           (last.plane_alpha == cur.plane_alpha) &&
+           (last.blending == cur.blending) &&
+           (last.assignedMPP == cur.assignedMPP) &&
+           (last.format == cur.format) &&
+           (last.transform == cur.transform) &&
+           (last.dataspace == cur.dataspace) &&
+           (last.hdr_enable == cur.hdr_enable) &&
+           (last.comp_src == cur.comp_src) &&
+           (last.min_luminance == cur.min_luminance) &&
+           (last.max_luminance == cur.max_luminance) &&
+           !memcmp(&last.block_area, &cur.block_area, sizeof(cur.block_area)) &&
+           !memcmp(&last.transparent_area, &cur.transparent_area, sizeof(cur.transparent_area)) &&
+           !memcmp(&last.opaque_area, &cur.opaque_area, sizeof(cur.opaque_area)) &&
+           !memcmp(&last.src, &cur.src, sizeof(cur.src)) &&
+           !memcmp(&last.dst, &cur.dst, sizeof(cur.dst)) &&
+           (last.protection == cur.protection) &&
+           (last.compressionInfo.type == cur.compressionInfo.type) &&
+           (last.hdrLayerDataspace == cur.hdrLayerDataspace) &&
+           (last.vOtfEnable == cur.vOtfEnable) &&
+           (last.vOtfBufIndex == cur.vOtfBufIndex) &&
+           (last.split == cur.split);
+}
+
 int32_t ExynosDisplayFbInterface::deliverWinConfigData(exynos_dpu_data &dpuData) {
     android::String8 result;
     clearFbWinConfigData(mFbConfigData);
     struct decon_win_config *config = mFbConfigData.config;
+    uint32_t reusedNum = 0;
     for (uint32_t i = 0; i < NUM_HW_WINDOWS; i++) {
+        const exynos_win_config_data &displayConfig = dpuData.configs[i];
+        FbWinConfigCache &cache = mWinConfigCache[i];
+
+        if ((displayConfig.state != displayConfig.WIN_STATE_DISABLED) &&
+            cache.valid && canReuseWinConfig(cache.displayConfig, displayConfig)) {
+            config[i] = cache.config;
+            config[i].fd_idma[0] = displayConfig.fd_idma[0];
+            config[i].fd_idma[1] = displayConfig.fd_idma[1];
+            config[i].fd_idma[2] = displayConfig.fd_idma[2];
+            config[i].acq_fence = displayConfig.acq_fence;
+            config[i].rel_fence = displayConfig.rel_fence;
+            setFdLut(&config[i], displayConfig.fd_lut);
+            reusedNum++;
+            continue;
+        }
+
         int32_t ret = configFromDisplayConfig(mFbConfigData.config[i],
-                                              dpuData.configs[i]);
+                                              displayConfig);
         if (ret != NO_ERROR) {
             HWC_LOGE(mDisplayIdentifier, "configFromDisplayConfig config[%d] fail", i);
+            cache.valid = false;
             return ret;
         }
+        cache.valid = true;
+        cache.displayConfig = displayConfig;
+        cache.config = config[i];
     }
+    HDEBUGLOGD(eDebugDisplayInterfaceConfig, "%s:: %d windows reuse the last config",
+               __func__, reusedNum);
 #ifdef USE_DQE_INTERFACE
     mFbConfigData.fd_dqe = dpuData.fd_dqe;
 #endif
@@ -149,12 +149,25 @@ class ExynosDisplayFbInterface : public ExynosDisplayInterface {
                                             const exynos_win_config_data &display_config);
     virtual void alignDSCBlockSize(hwc_rect &merge_rect);
     virtual void updateDSCBlockSize(){};
+    static bool canReuseWinConfig(const exynos_win_config_data &last,
+                                  const exynos_win_config_data &cur);
 
   protected:
     /**
          * LCD device member variables
          */
     decon_win_config_data mFbConfigData;
+    /*
+     * Windows converted by configFromDisplayConfig() in the last frame.
+     * Decon takes every window in every frame, but a window that has only
+     * new buffer fds and fences reuses the converted config.
+     */
+    struct FbWinConfigCache {
+        bool valid = false;
+        exynos_win_config_data displayConfig;
+        decon_win_config config;
+    };
+    FbWinConfigCache mWinConfigCache[NUM_HW_WINDOWS];
     decon_edid_data mEdidData;
     int mVsyncFd = -1;
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
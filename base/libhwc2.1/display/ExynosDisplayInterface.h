@@ -96,13 +96,24 @@ class ExynosDisplayInterface {
     virtual int getVsyncFd() const { return -1; };
     virtual void setDeviceToDisplayInterface(const struct DeviceToDisplayInterface __unused &initData){};
     virtual bool readHotplugStatus() { return true; };
+    /* Reads the connection state again on a hotplug event */
+    virtual void updateHotplugStatus(){};
     virtual void updateUeventNodeName(String8 __unused node){};
     virtual bool updateHdrSinkInfo() { return false; };
+    /* The sink follows the frame timing within its refresh range (adaptive sync) */
+    virtual bool isVrrCapable() { return false; };
+    virtual int32_t setVrrEnabled(bool __unused enabled) { return HWC2_ERROR_UNSUPPORTED; };
+    /* Content type and ALLM are signalled to the sink by its InfoFrames */
+    virtual void getSupportedContentTypes(std::vector<uint32_t> __unused &outTypes){};
+    virtual int32_t setContentType(int32_t __unused contentType) { return HWC2_ERROR_UNSUPPORTED; };
+    virtual bool isAllmSupported() { return false; };
+    virtual int32_t setAutoLowLatencyMode(bool __unused on) { return HWC2_ERROR_UNSUPPORTED; };
 
     virtual void onDisplayRemoved(){};
     virtual void onLayerDestroyed(hwc2_layer_t __unused layer){};
     virtual void onLayerCreated(hwc2_layer_t __unused layer){};
     virtual void onClientTargetDestroyed(void *__unused owner){};
+    virtual void preImportBuffer(const exynos_win_config_data __unused &config){};
 
     virtual void canDisableAllPlanes(__unused bool canDisable){};
     virtual uint64_t getWorkingVsyncPeriod() { return 0; };
@@ -16,6 +16,8 @@
 #ifndef _EXYNOSDPUDATA_H
 #define _EXYNOSDPUDATA_H
 
+#include <array>
+
 #include "ExynosMPP.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosHWCTypes.h"
@@ -71,9 +73,96 @@ struct exynos_win_config_data {
     };
 };
 
+enum {
+    WIN_CONFIG_DIRTY_STATE = 1 << 0,
+    WIN_CONFIG_DIRTY_BUFFER = 1 << 1,
+    WIN_CONFIG_DIRTY_SRC = 1 << 2,
+    WIN_CONFIG_DIRTY_DST = 1 << 3,
+    WIN_CONFIG_DIRTY_FORMAT = 1 << 4,
+    WIN_CONFIG_DIRTY_BLENDING = 1 << 5,
+    WIN_CONFIG_DIRTY_ALPHA = 1 << 6,
+    WIN_CONFIG_DIRTY_ALL = 0x7f,
+};
+
+/*
+ * Structure-of-arrays copy of the window fields that are compared
+ * between frames, so that the comparison doesn't walk every
+ * exynos_win_config_data field by field.
+ */
+struct exynos_win_config_table {
+    bool valid = false;
+    std::vector<uint8_t> state;
+    std::vector<std::array<int, kIdmaFdNum>> fd_idma;
+    std::vector<decon_frame> src;
+    std::vector<decon_frame> dst;
+    std::vector<ExynosFormat> format;
+    std::vector<int32_t> blending;
+    std::vector<float> plane_alpha;
+
+    void init(uint32_t configNum) {
+        state.resize(configNum);
+        fd_idma.resize(configNum);
+        src.resize(configNum);
+        dst.resize(configNum);
+        format.resize(configNum);
+        blending.resize(configNum);
+        plane_alpha.resize(configNum);
+        valid = false;
+    };
+
+    void update(const std::vector<exynos_win_config_data> &configs) {
+        if (configs.size() != state.size())
+            init(configs.size());
+        for (size_t i = 0; i < configs.size(); i++) {
+            state[i] = configs[i].state;
+            for (uint32_t j = 0; j < kIdmaFdNum; j++)
+                fd_idma[i][j] = configs[i].fd_idma[j];
+            src[i] = configs[i].src;
+            dst[i] = configs[i].dst;
+            format[i] = configs[i].format;
+            blending[i] = configs[i].blending;
+            plane_alpha[i] = configs[i].plane_alpha;
+        }
+        valid = true;
+    };
+
+    static bool isFrameChanged(const decon_frame &a, const decon_frame &b) {
+        return (a.x != b.x) || (a.y != b.y) || (a.w != b.w) || (a.h != b.h);
+    };
+
+    /* Returns WIN_CONFIG_DIRTY_* bits of config against the stored window */
+    uint32_t getDirty(size_t index, const exynos_win_config_data &config) const {
+        if (!valid || (index >= state.size()))
+            return WIN_CONFIG_DIRTY_ALL;
+
+        uint32_t dirty = 0;
+        if (state[index] != config.state)
+            dirty |= WIN_CONFIG_DIRTY_STATE;
+        if ((fd_idma[index][0] != config.fd_idma[0]) ||
+            (fd_idma[index][1] != config.fd_idma[1]) ||
+            (fd_idma[index][2] != config.fd_idma[2]))
+            dirty |= WIN_CONFIG_DIRTY_BUFFER;
+        if (isFrameChanged(src[index], config.src))
+            dirty |= WIN_CONFIG_DIRTY_SRC;
+        if (isFrameChanged(dst[index], config.dst))
+            dirty |= WIN_CONFIG_DIRTY_DST;
+        if (format[index] != config.format)
+            dirty |= WIN_CONFIG_DIRTY_FORMAT;
+        if (blending[index] != config.blending)
+            dirty |= WIN_CONFIG_DIRTY_BLENDING;
+        if (plane_alpha[index] != config.plane_alpha)
+            dirty |= WIN_CONFIG_DIRTY_ALPHA;
+        return dirty;
+    };
+};
+
 struct exynos_dpu_data {
     int present_fence = -1;
     std::vector<exynos_win_config_data> configs;
+    /* WIN_CONFIG_DIRTY_* bits of each window against the last delivered frame */
+    std::vector<uint32_t> win_dirty;
+    /* Snapshot of configs, valid only after this was assigned from other data */
+    exynos_win_config_table win_table;
     bool enable_win_update = false;
     std::atomic<bool> enable_readback = false;
     bool enable_standalone_writeback = false;
@@ -88,12 +177,28 @@ struct exynos_dpu_data {
             exynos_win_config_data config_data;
             configs.push_back(config_data);
         }
+        win_dirty.assign(configNum, WIN_CONFIG_DIRTY_ALL);
+        win_table.init(configNum);
+    };
+
+    /* Returns true if any window is changed from lastData */
+    bool updateWinDirty(const exynos_dpu_data &lastData) {
+        bool changed = false;
+        win_dirty.resize(configs.size());
+        for (size_t i = 0; i < configs.size(); i++) {
+            win_dirty[i] = lastData.win_table.getDirty(i, configs[i]);
+            if (win_dirty[i])
+                changed = true;
+        }
+        return changed;
     };
 
     void reset() {
         present_fence = -1;
         for (uint32_t i = 0; i < configs.size(); i++)
             configs[i].reset();
+        win_dirty.assign(configs.size(), WIN_CONFIG_DIRTY_ALL);
+        win_table.valid = false;
         /*
          * Should not initialize readback_info
          * readback_info should be initialized after present
@@ -106,6 +211,8 @@ struct exynos_dpu_data {
             return *this;
         }
         configs = configs_data.configs;
+        win_dirty = configs_data.win_dirty;
+        win_table.update(configs);
 #ifdef USE_DQE_INTERFACE
         fd_dqe = configs_data.fd_dqe;
 #endif
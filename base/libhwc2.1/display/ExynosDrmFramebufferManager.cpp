@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#include <sys/resource.h>
+#include <unistd.h>
+#include <system/thread_defs.h>
 #include <xf86drm.h>
 #include "exynos_drm_modifier.h"
 #include "ExynosDrmFramebufferManager.h"
@@ -78,6 +81,8 @@ void removeFbs(int drmFd, std::list<uint32_t> &fbs) {
 
 ANDROID_SINGLETON_STATIC_INSTANCE(FramebufferManager);
 FramebufferManager::~FramebufferManager() {
+    /* Pending imports are done before the buffers are released */
+    mImportWorker.reset();
     {
         Mutex::Autolock lock(mMutex);
         mRmFBThreadRunning = false;
@@ -95,6 +100,7 @@ void FramebufferManager::init(int drmFd) {
     mRmFBThreadRunning = true;
     mRmFBThread = std::thread(&FramebufferManager::removeFBsThreadRoutine, this);
     pthread_setname_np(mRmFBThread.native_handle(), "RemoveFBsThread");
+    mImportWorker = std::make_unique<ExynosWorkerPool>("hwc_fb_import", 1);
 }
 
 uint32_t FramebufferManager::getBufHandleFromFd(int fd) {
@@ -126,14 +132,46 @@ bool FramebufferManager::canRemoveBuffer(const std::unique_ptr<Framebuffer> &fra
             mLastActiveCommitTime[i] == frameBuf->lastActiveTime[i]) {
             return false;
         }
+        if (mPrevActiveCommitTime[i] &&
+            mPrevActiveCommitTime[i] == frameBuf->lastActiveTime[i]) {
+            return false;
+        }
     }
     return true;
 }
 
+void FramebufferManager::addCachedIndex(FBList::iterator it) {
+    mCachedIndex.emplace(getKey(*it), it);
+}
+
+void FramebufferManager::removeCachedIndex(FBList::iterator it) {
+    auto range = mCachedIndex.equal_range(getKey(*it));
+    for (auto indexIt = range.first; indexIt != range.second; indexIt++) {
+        if (indexIt->second == it) {
+            mCachedIndex.erase(indexIt);
+            return;
+        }
+    }
+}
+
 void FramebufferManager::fillCleanupBuffer() {
+    /* Buffers that were in use when removal was requested */
+    for (auto it = mCachedBuffers.begin(); it != mCachedBuffers.end();) {
+        auto const cit = it;
+        it++;
+        if ((*cit)->removePending && canRemoveBuffer(*cit)) {
+            removeCachedIndex(cit);
+            mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
+        }
+    }
+
+    if (mCachedBuffers.size() == 0)
+        return;
+
+    uint32_t maxCachedBuffers = getMaxCachedBuffers();
     auto it = mCachedBuffers.end();
     it--;
-    while (mCachedBuffers.size() > MAX_CACHED_BUFFERS) {
+    while (mCachedBuffers.size() > maxCachedBuffers) {
         bool stop = false;
         /*
          * MAX_CACHED_BUFFERS is more than 2,
@@ -144,15 +182,26 @@ void FramebufferManager::fillCleanupBuffer() {
             stop = true;
         else
             it--;
-        if (canRemoveBuffer(*cit))
+        if (canRemoveBuffer(*cit)) {
+            removeCachedIndex(cit);
             mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
+        }
 
         if (stop)
             break;
     }
 }
 
+/*
+ * drmModeRmFB() contends with atomic commit in the kernel,
+ * so framebuffers are removed in small batches right after flip()
+ * that is the farthest point from the next commit.
+ * If there is no flip, the rest of them are removed after RM_FB_IDLE_TIMEOUT.
+ */
 void FramebufferManager::removeFBsThreadRoutine() {
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_BACKGROUND);
+    setHelperThreadProfile();
+
     FBList cleanupBuffers;
     while (true) {
         {
@@ -160,10 +209,19 @@ void FramebufferManager::removeFBsThreadRoutine() {
             if (!mRmFBThreadRunning) {
                 break;
             }
-            mCondition.wait(mMutex);
+            bool idle = false;
+            if (mCleanupBuffers.size() > 0)
+                idle = (mCondition.waitRelative(mMutex, RM_FB_IDLE_TIMEOUT) == TIMED_OUT);
+            else
+                mCondition.wait(mMutex);
             fillCleanupBuffer();
+
+            auto last = mCleanupBuffers.begin();
+            for (uint32_t i = 0; (last != mCleanupBuffers.end()) &&
+                                 (idle || (i < RM_FB_BATCH_SIZE)); i++)
+                last++;
             cleanupBuffers.splice(cleanupBuffers.end(), mCleanupBuffers,
-                                  mCleanupBuffers.begin(), mCleanupBuffers.end());
+                                  mCleanupBuffers.begin(), last);
         }
         ATRACE_BEGIN("cleanup framebuffers");
         cleanupBuffers.clear();
@@ -174,6 +232,40 @@ void FramebufferManager::removeFBsThreadRoutine() {
 int32_t FramebufferManager::getBuffer(const uint32_t displayType,
                                       const exynos_win_config_data &config,
                                       uint32_t &fbId, const bool caching) {
+    return getBufferInternal(displayType, config, fbId, caching, false);
+}
+
+void FramebufferManager::preImport(const uint32_t displayType,
+                                   const exynos_win_config_data &config) {
+    if ((mImportWorker == nullptr) ||
+        ((config.state != config.WIN_STATE_BUFFER) &&
+         (config.state != config.WIN_STATE_CURSOR)))
+        return;
+
+    /* Buffer can be freed by the client before the import is done */
+    exynos_win_config_data importConfig = config;
+    for (uint32_t i = 0; i < kIdmaFdNum; i++)
+        importConfig.fd_idma[i] = (config.fd_idma[i] >= 0) ? dup(config.fd_idma[i]) : -1;
+
+    mImportWorker->submit([this, displayType, importConfig]() {
+        uint32_t fbId = 0;
+        ATRACE_NAME("pre-import framebuffer");
+        getBufferInternal(displayType, importConfig, fbId, true, true);
+        for (uint32_t i = 0; i < kIdmaFdNum; i++) {
+            if (importConfig.fd_idma[i] >= 0)
+                close(importConfig.fd_idma[i]);
+        }
+    });
+}
+
+/*
+ * Framebuffer that is created by pre-import is added to the front of
+ * cached buffers instead of staging buffers because it is not committed yet.
+ */
+int32_t FramebufferManager::getBufferInternal(const uint32_t displayType,
+                                              const exynos_win_config_data &config,
+                                              uint32_t &fbId, const bool caching,
+                                              const bool preImport) {
     int ret = NO_ERROR;
     int drmFormat = DRM_FORMAT_UNDEFINED;
     uint32_t bpp = 0;
@@ -290,14 +382,19 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
 
     if (caching) {
         Mutex::Autolock lock(mMutex);
-        auto it =
-            std::find_if(mCachedBuffers.begin(), mCachedBuffers.end(),
-                         [&config, &drmFormat, &bufWidth, &bufHeight, &modifiers](auto &buffer) { return (buffer->bufferId == config.buffer_id) &&
-                                                                                                         (buffer->format == drmFormat) &&
-                                                                                                         (buffer->width == bufWidth) &&
-                                                                                                         (buffer->height == bufHeight) &&
-                                                                                                         (buffer->modifier == modifiers[0]); });
-        if (it != mCachedBuffers.end()) {
+        FramebufferKey key = {config.buffer_id, (uint32_t)drmFormat, bufWidth, bufHeight,
+                              modifiers[0]};
+        auto indexIt = mCachedIndex.find(key);
+        if (preImport) {
+            if (indexIt != mCachedIndex.end())
+                return NO_ERROR;
+            for (auto &staged : mStagingBuffers) {
+                if (getKey(staged) == key)
+                    return NO_ERROR;
+            }
+        } else if (indexIt != mCachedIndex.end()) {
+            auto it = indexIt->second;
+            mCachedIndex.erase(indexIt);
             fbId = (*it)->fbId;
             mStagingBuffers.splice(mStagingBuffers.end(), mCachedBuffers, it);
             return NO_ERROR;
@@ -335,7 +432,14 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
         return ret;
     }
 
-    if (caching) {
+    if (caching && preImport) {
+        Mutex::Autolock lock(mMutex);
+        mCachedBuffers.emplace_front(new Framebuffer(mDrmFd, config.buffer_id,
+                                                     displayType, config.owner,
+                                                     drmFormat, bufWidth, bufHeight,
+                                                     modifiers[0], fbId));
+        addCachedIndex(mCachedBuffers.begin());
+    } else if (caching) {
         Mutex::Autolock lock(mMutex);
         mStagingBuffers.emplace_back(new Framebuffer(mDrmFd, config.buffer_id,
                                                      displayType, config.owner,
@@ -352,9 +456,10 @@ void FramebufferManager::flip(uint32_t displayType, bool isActiveCommit) {
         nsecs_t time = systemTime(SYSTEM_TIME_MONOTONIC);
         if (isActiveCommit)
             updateLastActiveCommitTime(displayType, time);
-        for (auto &it : mStagingBuffers) {
+        for (auto it = mStagingBuffers.begin(); it != mStagingBuffers.end(); it++) {
             if (isActiveCommit)
-                it->updateLastActiveTime(displayType, time);
+                (*it)->updateLastActiveTime(displayType, time);
+            addCachedIndex(it);
         }
         mCachedBuffers.splice(mCachedBuffers.begin(), mStagingBuffers);
     }
@@ -364,6 +469,7 @@ void FramebufferManager::flip(uint32_t displayType, bool isActiveCommit) {
 void FramebufferManager::releaseAll() {
     Mutex::Autolock lock(mMutex);
     mStagingBuffers.clear();
+    mCachedIndex.clear();
     mCachedBuffers.clear();
 }
 
@@ -377,6 +483,7 @@ void FramebufferManager::onDisplayRemoved(const uint32_t displayType) {
          */
         Mutex::Autolock lock(mMutex);
         mLastActiveCommitTime[displayType] = 0;
+        mPrevActiveCommitTime[displayType] = 0;
     }
     removeBuffersForDisplay(displayType);
 }
@@ -390,6 +497,7 @@ void FramebufferManager::removeBufferInternal(std::function<bool(const std::uniq
             it++;
             if ((*cit)->removePending || compareFunc(*cit)) {
                 if (canRemoveBuffer(*cit)) {
+                    removeCachedIndex(cit);
                     mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
                 } else {
                     (*cit)->pendRemove();
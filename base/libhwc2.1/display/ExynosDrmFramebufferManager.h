@@ -19,16 +19,25 @@
 #include <sys/types.h>
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
+#include <algorithm>
 #include <list>
 #include <array>
+#include <atomic>
 #include <thread>
+#include <unordered_map>
 #include <xf86drmMode.h>
 #include <utils/Singleton.h>
 #include "ExynosHWCTypes.h"
 #include "ExynosDpuData.h"
+#include "ExynosWorkerPool.h"
 
 constexpr uint32_t MAX_CACHED_BUFFERS = 32;  // TODO: find a good value for this
-constexpr uint32_t MAX_CACHED_BUFFERS_NO_LAYER_NUM_CHANGE = MAX_CACHED_BUFFERS * 2;
+/* Cache limit grows with live layers, each layer can cycle this number of buffers */
+constexpr uint32_t CACHED_BUFFERS_PER_LAYER = 4;
+/* Framebuffers are removed by this number at a time right after flip */
+constexpr uint32_t RM_FB_BATCH_SIZE = 8;
+/* Rest of framebuffers are removed if there is no flip for this time */
+constexpr nsecs_t RM_FB_IDLE_TIMEOUT = ms2ns(50);
 
 /* Max plane number of buffer object */
 #define HWC_DRM_BO_MAX_PLANES 4
@@ -50,16 +59,22 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     // when frame is committed
     int32_t getBuffer(const uint32_t displayType, const exynos_win_config_data &config, uint32_t &fbId, const bool caching);
 
+    // import buffer of provided config into cached buffers asynchronously so that
+    // getBuffer() of the next frame can reuse it. fds of config are duplicated,
+    // caller doesn't need to keep them
+    void preImport(const uint32_t displayType, const exynos_win_config_data &config);
+
     // this should be called after frame update
     // this will move all staged buffers to front of the cached buffers queue
     // This will also schedule a cleanup of cached buffers if cached buffer list goes
-    // beyond MAX_CACHED_BUFFERS_NO_LAYER_NUM_CHANGE
+    // beyond twice of getMaxCachedBuffers()
     void flip(uint32_t displayId, bool isActiveCommit);
 
     // release all currently tracked buffers
     void releaseAll();
 
     void updateLastActiveCommitTime(uint32_t displayType, nsecs_t time) {
+        mPrevActiveCommitTime[displayType] = mLastActiveCommitTime[displayType];
         mLastActiveCommitTime[displayType] = time;
     };
 
@@ -67,10 +82,13 @@ class FramebufferManager : public Singleton<FramebufferManager> {
 
     void cleanupSignal(bool hasLayerNumChange = true) {
         bool needSignal = false;
-        uint32_t maxCacheBuffer = hasLayerNumChange ? MAX_CACHED_BUFFERS : MAX_CACHED_BUFFERS_NO_LAYER_NUM_CHANGE;
+        uint32_t maxCacheBuffer = getMaxCachedBuffers();
+        if (!hasLayerNumChange)
+            maxCacheBuffer *= 2;
         {
             Mutex::Autolock lock(mMutex);
-            if (mCachedBuffers.size() > maxCacheBuffer)
+            if ((mCachedBuffers.size() > maxCacheBuffer) ||
+                (mCleanupBuffers.size() > 0))
                 needSignal = true;
         }
         if (needSignal)
@@ -81,7 +99,18 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     void removeBuffersForDisplay(const uint32_t displayType);
     void removeBuffersForOwner(const void *owner);
 
+    void onLayerCreated() { mLiveLayerNum++; };
+    void onLayerDestroyed() {
+        if (mLiveLayerNum > 0)
+            mLiveLayerNum--;
+    };
+    uint32_t getMaxCachedBuffers() {
+        return std::max(MAX_CACHED_BUFFERS, mLiveLayerNum.load() * CACHED_BUFFERS_PER_LAYER);
+    };
+
   private:
+    int32_t getBufferInternal(const uint32_t displayType, const exynos_win_config_data &config,
+                              uint32_t &fbId, const bool caching, const bool preImport);
     uint32_t getBufHandleFromFd(int fd);
     // this struct should contain elements that can be used to identify framebuffer more easily
     struct Framebuffer {
@@ -118,6 +147,37 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     };
     using FBList = std::list<std::unique_ptr<Framebuffer>>;
 
+    struct FramebufferKey {
+        uint64_t bufferId;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint64_t modifier;
+        bool operator==(const FramebufferKey &rhs) const {
+            return (bufferId == rhs.bufferId) && (format == rhs.format) &&
+                   (width == rhs.width) && (height == rhs.height) &&
+                   (modifier == rhs.modifier);
+        };
+    };
+    struct FramebufferKeyHash {
+        size_t operator()(const FramebufferKey &key) const {
+            size_t hash = std::hash<uint64_t>()(key.bufferId);
+            hash ^= std::hash<uint64_t>()(((uint64_t)key.format << 32) | key.width) +
+                    0x9e3779b9 + (hash << 6) + (hash >> 2);
+            hash ^= std::hash<uint64_t>()(((uint64_t)key.height << 32) ^ key.modifier) +
+                    0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        };
+    };
+    /* Index of mCachedBuffers, list iterators are kept valid by splice */
+    using FBIndex = std::unordered_multimap<FramebufferKey, FBList::iterator, FramebufferKeyHash>;
+    static FramebufferKey getKey(const std::unique_ptr<Framebuffer> &frameBuf) {
+        return {frameBuf->bufferId, frameBuf->format, frameBuf->width,
+                frameBuf->height, frameBuf->modifier};
+    };
+    void addCachedIndex(FBList::iterator it);   // REQUIRES(mMutex)
+    void removeCachedIndex(FBList::iterator it);  // REQUIRES(mMutex)
+
     int addFB2WithModifiers(uint32_t width, uint32_t height, uint32_t pixel_format,
                             const BufHandles handles, const uint32_t pitches[4],
                             const uint32_t offsets[4], const uint64_t modifier[4], uint32_t *buf_id,
@@ -128,7 +188,7 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     bool canRemoveBuffer(const std::unique_ptr<Framebuffer> &frameBuf); // REQUIRES(mMutex)
     void removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc);
     // Put the framebuffers at the back of the cached buffer queue that go beyond
-    // MAX_CACHED_BUFFERS to the FBList. Framebuffers in the FBList would be
+    // getMaxCachedBuffers() to the FBList. Framebuffers in the FBList would be
     // released by removeFBsThreadRoutine()
     void fillCleanupBuffer();
 
@@ -137,15 +197,20 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     // unused buffers that have been used recently, front of the queue has the most recently used
     // ones
     FBList mCachedBuffers;
+    FBIndex mCachedIndex;
     // buffers that are going to be removed
     FBList mCleanupBuffers;
 
     int mDrmFd = -1;
     nsecs_t mLastActiveCommitTime[HWC_NUM_DISPLAY_TYPES] = {0};
+    /* Framebuffers of previous commit can be scanned out until new commit is applied */
+    nsecs_t mPrevActiveCommitTime[HWC_NUM_DISPLAY_TYPES] = {0};
 
     std::thread mRmFBThread;
     bool mRmFBThreadRunning = false;
     Condition mCondition;
     Mutex mMutex;
+    std::atomic<uint32_t> mLiveLayerNum = 0;
+    std::unique_ptr<ExynosWorkerPool> mImportWorker;
 };
 #endif
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include <hardware/hwcomposer2.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sync/sync.h>
+#include <sys/mman.h>
+#include <utils/Trace.h>
+
+#ifdef __ARM_FEATURE_CRC32
+#include <arm_acle.h>
+#endif
+
+#include "ExynosFrameCrc.h"
+#include "ExynosGraphicBuffer.h"
+#include "ExynosHWCDebug.h"
+#include "ExynosHWCHelper.h"
+
+using namespace vendor::graphics;
+
+#define CRC32C_POLY 0x82f63b78U
+
+ExynosFrameCrc::~ExynosFrameCrc() {
+    disable();
+}
+
+bool ExynosFrameCrc::isFormatSupported(int32_t format) {
+    switch (format) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+    case HAL_PIXEL_FORMAT_RGBA_1010102:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint32_t ExynosFrameCrc::crc32c(uint32_t crc, const void *data, size_t size) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+
+    crc = ~crc;
+#ifdef __ARM_FEATURE_CRC32
+    for (; size && ((uintptr_t)p & 7); size--)
+        crc = __crc32cb(crc, *p++);
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+    for (; size; size--)
+        crc = __crc32cb(crc, *p++);
+#else
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> t = {};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? ((c >> 1) ^ CRC32C_POLY) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+    for (; size; size--)
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+#endif
+    return ~crc;
+}
+
+int32_t ExynosFrameCrc::enable(int32_t format, uint32_t width, uint32_t height) {
+    if (!isFormatSupported(format) || (width == 0) || (height == 0)) {
+        ALOGE("%s:: display[%d] unsupported readback format(0x%x), %dx%d",
+              __func__, mDisplayId, format, width, height);
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+
+    /* CRC is restarted with new parameters */
+    disable();
+
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    uint64_t usage = static_cast<uint64_t>(GRALLOC1_CONSUMER_USAGE_HWCOMPOSER |
+                                           GRALLOC1_CONSUMER_USAGE_CPU_READ_OFTEN);
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &buffer : mBuffers) {
+        uint32_t stride = 0;
+        status_t error = gAllocator.allocate(width, height, format, 1, usage,
+                                             &buffer.handle, &stride, "HWC_frame_crc");
+        if ((error != NO_ERROR) || (buffer.handle == nullptr)) {
+            ALOGE("%s:: display[%d] failed to allocate buffer(%dx%d): %d",
+                  __func__, mDisplayId, width, height, error);
+            buffer.handle = nullptr;
+            freeBuffers();
+            return HWC2_ERROR_NO_RESOURCES;
+        }
+    }
+
+    if (mWorkerPool == nullptr)
+        mWorkerPool = std::make_unique<ExynosWorkerPool>(
+            "hwc_frame_crc_" + std::to_string(mDisplayId), 1);
+
+    mFormat = format;
+    mPresentCount = 0;
+    mCrcCount = 0;
+    mSkipCount = 0;
+    mFailCount = 0;
+    mRecords.clear();
+    mEnabled = true;
+    ALOGI("%s:: display[%d] frame CRC of %dx%d, format(0x%x)",
+          __func__, mDisplayId, width, height, format);
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosFrameCrc::disable() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mEnabled)
+            return;
+        mEnabled = false;
+    }
+
+    /* CRC jobs are using buffers */
+    if (mWorkerPool != nullptr)
+        mWorkerPool->wait();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    freeBuffers();
+    mRecords.clear();
+}
+
+bool ExynosFrameCrc::isEnabled() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEnabled;
+}
+
+void ExynosFrameCrc::freeBuffers() {
+    ExynosGraphicBufferMapper &gMapper(ExynosGraphicBufferMapper::get());
+    for (auto &buffer : mBuffers) {
+        if (buffer.handle != nullptr)
+            gMapper.freeBuffer(buffer.handle);
+        buffer = {};
+    }
+}
+
+buffer_handle_t ExynosFrameCrc::dequeueFrame(bool readbackAvailable) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled)
+        return nullptr;
+
+    uint64_t frame = mPresentCount++;
+    if (readbackAvailable) {
+        for (auto &buffer : mBuffers) {
+            if (!buffer.busy) {
+                buffer.busy = true;
+                buffer.frame = frame;
+                return buffer.handle;
+            }
+        }
+    }
+    /* Readback is in use or previous frames are still being read */
+    mSkipCount++;
+    return nullptr;
+}
+
+void ExynosFrameCrc::queueFrame(buffer_handle_t handle, int32_t fence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t index = 0;
+    for (; index < kBufferNum; index++) {
+        if (mBuffers[index].handle == handle)
+            break;
+    }
+
+    if (!mEnabled || (index == kBufferNum) || (fence < 0)) {
+        if (index < kBufferNum)
+            mBuffers[index].busy = false;
+        if (fence >= 0)
+            hwcFdClose(fence);
+        mFailCount++;
+        return;
+    }
+
+    uint64_t frame = mBuffers[index].frame;
+    mWorkerPool->submit([this, index, fence, frame]() {
+        compute(index, fence, frame);
+    });
+}
+
+void ExynosFrameCrc::compute(uint32_t index, int32_t fence, uint64_t frame) {
+    ATRACE_CALL();
+    uint32_t crc = 0;
+
+    bool done = (sync_wait(fence, 1000) >= 0);
+    hwcFdClose(fence);
+    if (!done)
+        ALOGE("%s:: display[%d] writeback is not done", __func__, mDisplayId);
+    else
+        done = readCrc(mBuffers[index].handle, crc);
+
+    if (done)
+        ALOGI("display[%d] frame %" PRIu64 " crc 0x%08x", mDisplayId, frame, crc);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBuffers[index].busy = false;
+    if (!done) {
+        mFailCount++;
+        return;
+    }
+    mRecords.push_back({frame, crc});
+    while (mRecords.size() > kHistorySize)
+        mRecords.pop_front();
+    mCrcCount++;
+}
+
+bool ExynosFrameCrc::readCrc(buffer_handle_t handle, uint32_t &crc) {
+    ExynosGraphicBufferMeta gmeta(handle);
+    uint32_t bpp = formatToBpp(gmeta.format) / 8;
+    uint32_t size = gmeta.stride * gmeta.vstride * bpp;
+    void *data = mmap(0, size, PROT_READ, MAP_SHARED, gmeta.fd, 0);
+    if ((data == MAP_FAILED) || (data == NULL)) {
+        ALOGE("%s:: display[%d] fail to mmap", __func__, mDisplayId);
+        return false;
+    }
+
+    /* Padding of lines is not written by DPU */
+    crc = 0;
+    for (uint32_t y = 0; y < gmeta.height; y++) {
+        const uint8_t *line = static_cast<const uint8_t *>(data) + (size_t)y * gmeta.stride * bpp;
+        crc = crc32c(crc, line, (size_t)gmeta.width * bpp);
+    }
+    munmap(data, size);
+    return true;
+}
+
+void ExynosFrameCrc::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEnabled)
+        return;
+
+    result.appendFormat("Frame CRC: format(0x%x), presented(%" PRIu64 "), crc(%" PRIu64 "), "
+                        "skipped(%" PRIu64 "), failed(%" PRIu64 ")\n",
+                        mFormat, mPresentCount, mCrcCount, mSkipCount, mFailCount);
+    for (auto &record : mRecords)
+        result.appendFormat("\tframe %" PRIu64 ": 0x%08x\n", record.frame, record.crc);
+}
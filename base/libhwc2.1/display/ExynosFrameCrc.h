@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSFRAMECRC_H
+#define _EXYNOSFRAMECRC_H
+
+#include <cutils/native_handle.h>
+#include <utils/String8.h>
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "ExynosWorkerPool.h"
+
+using namespace android;
+
+/*
+ * CRC of presented frames for visual regression tests.
+ * Every presented frame is written back to an internal buffer and the
+ * CRC32C of its visible pixels is logged from a worker thread, so that
+ * the composition can be compared between runs at full frame rate
+ * without dumping frames. Frames are skipped, not delayed, if the
+ * readback is in use by others or all buffers are still being read.
+ */
+class ExynosFrameCrc {
+  public:
+    static constexpr uint32_t kBufferNum = 3;
+    static constexpr uint32_t kHistorySize = 16;
+
+    ExynosFrameCrc(uint32_t displayId) : mDisplayId(displayId){};
+    ~ExynosFrameCrc();
+
+    static bool isFormatSupported(int32_t format);
+    /* CRC32C (Castagnoli) of @size bytes continued from @crc */
+    static uint32_t crc32c(uint32_t crc, const void *data, size_t size);
+
+    int32_t enable(int32_t format, uint32_t width, uint32_t height);
+    void disable();
+    bool isEnabled();
+
+    /*
+     * For present path, it is called for every presented frame.
+     * Buffer is returned if this frame should be written back.
+     */
+    buffer_handle_t dequeueFrame(bool readbackAvailable);
+    /* fence is owned by this after this call, -1 if writeback failed */
+    void queueFrame(buffer_handle_t buffer, int32_t fence);
+
+    void dump(String8 &result);
+
+  private:
+    struct Buffer {
+        buffer_handle_t handle = nullptr;
+        bool busy = false;
+        /* Frame number of the frame written back to this */
+        uint64_t frame = 0;
+    };
+    struct Record {
+        uint64_t frame = 0;
+        uint32_t crc = 0;
+    };
+
+    void compute(uint32_t index, int32_t fence, uint64_t frame);
+    bool readCrc(buffer_handle_t handle, uint32_t &crc);
+    void freeBuffers();
+
+    uint32_t mDisplayId;
+    std::mutex mMutex;
+    bool mEnabled = false;
+    int32_t mFormat = 0;
+    std::array<Buffer, kBufferNum> mBuffers;
+    /* Presented frames since enabled, a CRC is logged with its frame number */
+    uint64_t mPresentCount = 0;
+    std::deque<Record> mRecords;
+    uint64_t mCrcCount = 0;
+    uint64_t mSkipCount = 0;
+    uint64_t mFailCount = 0;
+
+    /* Declared last to drain jobs before other members are destroyed */
+    std::unique_ptr<ExynosWorkerPool> mWorkerPool;
+};
+
+#endif
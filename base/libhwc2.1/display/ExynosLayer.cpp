@@ -15,6 +15,7 @@
  */
 
 #include <utils/Errors.h>
+#include <atomic>
 #include <linux/videodev2.h>
 #include <sys/mman.h>
 #include <hardware/hwcomposer_defs.h>
@@ -55,6 +56,7 @@ ExynosLayer::ExynosLayer(DisplayInfo displayInfo)
       mFrameCount(0),
       mLastFrameCount(0),
       mLastFpsTime(0),
+      mFrequentlyUpdated(false),
       mLastLayerBuffer(NULL),
       mLayerBuffer(NULL),
       mDamageNum(0),
@@ -68,7 +70,9 @@ ExynosLayer::ExynosLayer(DisplayInfo displayInfo)
       mIsHdr10PlusLayer(false),
       mIsHdrFrameworkPath(false),
       mIsHdr10PlusFrameworkPath(false),
-      mMetaParcelFd(-1) {
+      mMetaParcelFd(-1),
+      mHdr10PlusBlobHash(0),
+      mHdrDynamicGeneration(0) {
     memset(&mDisplayFrame, 0, sizeof(mDisplayFrame));
     memset(&mSourceCrop, 0, sizeof(mSourceCrop));
     mVisibleRegionScreen.numRects = 0;
@@ -247,6 +251,9 @@ int32_t ExynosLayer::doPreProcess(DeviceValidateInfo &validateInfo,
     } else if ((mDisplayInfo.cursorSupport == true) &&
                (mCompositionType == HWC2_COMPOSITION_CURSOR)) {
         priority = ePriorityMid;
+    } else if ((mDisplayInfo.updateRatePriority == true) &&
+               isFrequentlyUpdated()) {
+        priority = ePriorityMid;
     } else {
         priority = ePriorityLow;
     }
@@ -254,6 +261,22 @@ int32_t ExynosLayer::doPreProcess(DeviceValidateInfo &validateInfo,
     return NO_ERROR;
 }
 
+bool ExynosLayer::preProcessSpeculatively() {
+    if ((mLayerBuffer == nullptr) || (mCompositionType == HWC2_COMPOSITION_SOLID_COLOR))
+        return false;
+
+    if (mLayerFormat.isYUV() || hasHdrInfo(mDataSpace) || (getDrmMode(mLayerBuffer) != NO_DRM))
+        return false;
+
+    mLayerFlag = 0x0;
+    mPreprocessedInfo.sourceCrop = mSourceCrop;
+    mPreprocessedInfo.displayFrame = mDisplayFrame;
+    mPreprocessedInfo.interlacedType = V4L2_FIELD_NONE;
+    mPreprocessedInfo.mUsePrivateFormat = false;
+
+    return true;
+}
+
 int32_t ExynosLayer::setLayerBuffer(buffer_handle_t buffer, int32_t acquireFence,
                                     uint64_t &geometryFlag) {
     if (buffer != NULL) {
@@ -319,12 +342,44 @@ int32_t ExynosLayer::setLayerBuffer(buffer_handle_t buffer, int32_t acquireFence
     HDEBUGLOGD(eDebugLayer, "layers bufferHandle: %p, mDataSpace: 0x%8x, acquireFence: %d, compressionType: %8x, format: 0x%" PRIx64 "",
                buffer, mDataSpace, mAcquireFence, mCompressionInfo.type, (uint64_t)ExynosGraphicBufferMeta::get_format(buffer));
 
+    if ((buffer != NULL) && (buffer != mLayerBuffer))
+        mFrameCount++;
+
     mLayerBuffer = buffer;
     mLayerFormat = ExynosFormat(halFormat, mCompressionInfo.type);
+    mBufferGeneration++;
 
     return HWC2_ERROR_NONE;
 }
 
+uint32_t ExynosLayer::checkFps() {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t diff = now - mLastFpsTime;
+
+    if (diff >= LAYER_FPS_CHECK_PERIOD) {
+        mFps = (uint32_t)(((uint64_t)(mFrameCount - mLastFrameCount) * s2ns(1)) / diff);
+        mLastFrameCount = mFrameCount;
+        mLastFpsTime = now;
+    }
+    return mFps;
+}
+
+/*
+ * Layer that is updated frequently is assigned to otfMPP before
+ * other normal layers, so layers that are rarely updated
+ * are composited by client or m2mMPP when otfMPPs are not enough.
+ */
+bool ExynosLayer::isFrequentlyUpdated() {
+    uint32_t fps = checkFps();
+
+    if (fps >= LAYER_FREQUENT_UPDATE_FPS_HIGH)
+        mFrequentlyUpdated = true;
+    else if (fps < LAYER_FREQUENT_UPDATE_FPS_LOW)
+        mFrequentlyUpdated = false;
+
+    return mFrequentlyUpdated;
+}
+
 int32_t ExynosLayer::setLayerSurfaceDamage(hwc_region_t damage) {
     mDamageNum = damage.numRects;
     mDamageRects.clear();
@@ -343,8 +398,18 @@ int32_t ExynosLayer::setLayerBlendMode(int32_t /*hwc2_blend_mode_t*/ mode, uint6
     //TODO mGeometryChanged  here
     if (mode < 0)
         return HWC2_ERROR_BAD_PARAMETER;
-    if (mBlending != mode)
-        setGeometryChanged(GEOMETRY_LAYER_BLEND_CHANGED, geometryFlag);
+    if (mBlending != mode) {
+        /* Coverage and premultiplied blend the same when there is no alpha to premultiply */
+        bool sameBlend = (mLayerBuffer != NULL) && !mLayerFormat.hasAlphaChannel() &&
+                         ((mBlending == HWC2_BLEND_MODE_COVERAGE) ||
+                          (mBlending == HWC2_BLEND_MODE_PREMULTIPLIED)) &&
+                         ((mode == HWC2_BLEND_MODE_COVERAGE) ||
+                          (mode == HWC2_BLEND_MODE_PREMULTIPLIED));
+        if (sameBlend)
+            mFilteredGeometryChanged |= GEOMETRY_LAYER_BLEND_CHANGED;
+        else
+            setGeometryChanged(GEOMETRY_LAYER_BLEND_CHANGED, geometryFlag);
+    }
     mBlending = mode;
     return HWC2_ERROR_NONE;
 }
@@ -404,7 +469,14 @@ int32_t ExynosLayer::setLayerDataspace(int32_t /*android_dataspace_t*/ dataspace
     }
 
     if (currentDataSpace != mDataSpace) {
-        setGeometryChanged(GEOMETRY_LAYER_DATASPACE_CHANGED, geometryFlag);
+        /* UNKNOWN is configured as the default dataspace of the buffer format */
+        int halFormat = mLayerFormat.halFormat();
+        if ((mLayerBuffer != NULL) &&
+            (getRefinedDataspace(halFormat, currentDataSpace) ==
+             getRefinedDataspace(halFormat, mDataSpace)))
+            mFilteredGeometryChanged |= GEOMETRY_LAYER_DATASPACE_CHANGED;
+        else
+            setGeometryChanged(GEOMETRY_LAYER_DATASPACE_CHANGED, geometryFlag);
     }
     mDataSpace = currentDataSpace;
 
@@ -554,12 +626,29 @@ int32_t ExynosLayer::setLayerPerFrameMetadataBlobs(uint32_t numElements, const i
         switch (keys[i]) {
         case HWC2_HDR10_PLUS_SEI:
             if (allocMetaParcel() == NO_ERROR) {
+                uint64_t hash = 0xcbf29ce484222325ULL;
+                hashFingerprint(hash, metadata_start, sizeof(uint8_t) * sizes[i]);
+                if (hash == 0)
+                    hash = 1;
+
+                /* The parcel has the parsed info of the same blob already */
+                if ((hash == mHdr10PlusBlobHash) &&
+                    (mMetaParcel->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC)) {
+                    mIsHdr10PlusFrameworkPath = true;
+                    mIsHdr10PlusLayer = true;
+                    break;
+                }
+
                 mMetaParcel->eType =
                     static_cast<ExynosVideoInfoType>(mMetaParcel->eType | VIDEO_INFO_TYPE_HDR_DYNAMIC);
                 ExynosHdrDynamicInfo *info = &(mMetaParcel->sHdrDynamicInfo);
                 if (Exynos_parsing_user_data_registered_itu_t_t35(info, (void *)metadata_start) == NO_ERROR) {
                     mIsHdr10PlusFrameworkPath = true;
                     mIsHdr10PlusLayer = true;
+                    mHdr10PlusBlobHash = hash;
+                    mHdrDynamicGeneration = nextHdrDynamicGeneration();
+                } else {
+                    invalidateHdrDynamicGeneration();
                 }
             } else {
                 ALOGE("Layer has no metaParcel!");
@@ -589,6 +678,69 @@ int32_t ExynosLayer::setLayerColorTransform(const float *matrix) {
     return 0;
 }
 
+int32_t ExynosLayer::setLayerState(const exynos_layer_state_t &state, uint64_t &geometryFlag) {
+    int32_t ret = HWC2_ERROR_NONE;
+    uint64_t geometry = 0;
+    auto apply = [&ret](int32_t err) {
+        if (ret == HWC2_ERROR_NONE)
+            ret = err;
+    };
+
+    if (state.buffer)
+        apply(setLayerBuffer(*state.buffer, state.acquireFence, geometry));
+    if (state.surfaceDamage) {
+        hwc_region_t region = {state.surfaceDamage->size(), state.surfaceDamage->data()};
+        apply(setLayerSurfaceDamage(region));
+    }
+    if (state.blendMode)
+        apply(setLayerBlendMode(*state.blendMode, geometry));
+    if (state.color)
+        apply(setLayerColor(*state.color));
+    if (state.compositionType)
+        apply(setLayerCompositionType(*state.compositionType, geometry));
+    if (state.dataspace)
+        apply(setLayerDataspace(*state.dataspace, geometry));
+    if (state.displayFrame)
+        apply(setLayerDisplayFrame(*state.displayFrame, geometry));
+    if (state.planeAlpha)
+        apply(setLayerPlaneAlpha(*state.planeAlpha));
+    if (state.sourceCrop)
+        apply(setLayerSourceCrop(*state.sourceCrop, geometry));
+    if (state.transform)
+        apply(setLayerTransform(*state.transform, geometry));
+    if (state.visibleRegion) {
+        hwc_region_t region = {state.visibleRegion->size(), state.visibleRegion->data()};
+        apply(setLayerVisibleRegion(region));
+    }
+    if (state.zOrder)
+        apply(setLayerZOrder(*state.zOrder, geometry));
+
+    geometryFlag |= geometry;
+    return ret;
+}
+
+uint64_t ExynosLayer::getValidateFingerprint() {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int32_t format = mLayerFormat.halFormat();
+    uint32_t drmMode = (mLayerBuffer != NULL) ? getDrmMode(getBufferMeta().usage) : 0;
+
+    hashFingerprint(hash, &mCompositionType, sizeof(mCompositionType));
+    hashFingerprint(hash, &mDataSpace, sizeof(mDataSpace));
+    hashFingerprint(hash, &mDisplayFrame, sizeof(mDisplayFrame));
+    hashFingerprint(hash, &mSourceCrop, sizeof(mSourceCrop));
+    hashFingerprint(hash, &mTransform, sizeof(mTransform));
+    hashFingerprint(hash, &mZOrder, sizeof(mZOrder));
+    hashFingerprint(hash, &mBlending, sizeof(mBlending));
+    hashFingerprint(hash, &mLayerFlag, sizeof(mLayerFlag));
+    hashFingerprint(hash, &mOverlayPriority, sizeof(mOverlayPriority));
+    hashFingerprint(hash, &mCompressionInfo.type, sizeof(mCompressionInfo.type));
+    hashFingerprint(hash, &format, sizeof(format));
+    hashFingerprint(hash, &drmMode, sizeof(drmMode));
+    hashFingerprint(hash, &mPreprocessedInfo.mUsePrivateFormat,
+                    sizeof(mPreprocessedInfo.mUsePrivateFormat));
+    return hash;
+}
+
 void ExynosLayer::resetValidateData() {
     mValidateCompositionType = HWC2_COMPOSITION_INVALID;
     mOtfMPP = NULL;
@@ -600,6 +752,143 @@ void ExynosLayer::resetValidateData() {
     setDstExynosImage(&mDstImg);
 }
 
+/*
+ * Classifies the client composition of this frame. The flags of the layer
+ * are checked from the decisions that cover the whole layer to the ones of
+ * the resource assignment, and the rejections of the MPPs are checked last.
+ */
+uint32_t ExynosLayer::updateClientCompositionReason() {
+    static constexpr uint64_t hdrRejects = eMPPUnsupportedDynamicMeta;
+    static constexpr uint64_t formatRejects =
+        eMPPUnsupportedFormat | eMPPUnsupportedCompression | eMPPUnsupportedCSC |
+        eMPPUnsupportedDRM | eMPPUnsupportedRotation | eMPPUnsupportedBlending |
+        eMPPUnsupportedDIMLayer | eMPPUnsupportedColorTransform;
+    static constexpr uint64_t scaleRejects = eMPPExeedMaxDownScale | eMPPExeedMaxUpScale;
+    static constexpr uint64_t capacityRejects =
+        eMPPHWBusy | eMPPExeedHWResource | eMPPConflictSharedMPP | eMPPSaveCapability;
+
+    if (mValidateCompositionType != HWC2_COMPOSITION_CLIENT) {
+        mClientCompositionReason = CLIENT_REASON_NONE;
+        return mClientCompositionReason;
+    }
+
+    uint64_t rejects = 0;
+    for (auto &it : mCheckMPPFlag)
+        rejects |= it.second;
+
+    if (mOverlayInfo & eSkipLayer)
+        mClientCompositionReason = CLIENT_REASON_REQUESTED;
+    else if (mOverlayInfo & (eForceFbEnabled | eFroceClientLayer | eDynamicRecomposition |
+                              eLowPowerComposition))
+        mClientCompositionReason = CLIENT_REASON_FORCED;
+    else if (mOverlayInfo & eResourceAssignFail)
+        mClientCompositionReason = CLIENT_REASON_ASSIGN_FAIL;
+    else if (mOverlayInfo & eUnSupportedColorTransform)
+        mClientCompositionReason = CLIENT_REASON_COLOR_TRANSFORM;
+    else if (mOverlayInfo & eInvalidVideoMetaData)
+        mClientCompositionReason = CLIENT_REASON_HDR;
+    else if (mOverlayInfo & eAssignDeadline)
+        mClientCompositionReason = CLIENT_REASON_DEADLINE;
+    else if (mOverlayInfo & (eSandwitchedBetweenGLES | eSandwitchedBetweenEXYNOS))
+        mClientCompositionReason = CLIENT_REASON_SANDWICH;
+    else if (mOverlayInfo & (eInsufficientWindow | eExceedMaxLayerNum))
+        mClientCompositionReason = CLIENT_REASON_WINDOW;
+    else if (mOverlayInfo & (eInsufficientMPP | eResourcePendingWork | eExceedDpuBandwidth))
+        mClientCompositionReason = CLIENT_REASON_CAPACITY;
+    else if (mSupportedMPPFlag != 0)
+        /* Some MPPs support the layer but none of them could be assigned */
+        mClientCompositionReason = CLIENT_REASON_CAPACITY;
+    else if (rejects & hdrRejects)
+        mClientCompositionReason = CLIENT_REASON_HDR;
+    else if (rejects & formatRejects)
+        mClientCompositionReason = CLIENT_REASON_FORMAT;
+    else if (rejects & scaleRejects)
+        mClientCompositionReason = CLIENT_REASON_SCALE;
+    else if (rejects & capacityRejects)
+        mClientCompositionReason = CLIENT_REASON_CAPACITY;
+    else if (rejects)
+        mClientCompositionReason = CLIENT_REASON_SIZE;
+    else
+        mClientCompositionReason = CLIENT_REASON_OTHER;
+
+    return mClientCompositionReason;
+}
+
+const ExynosLayer::BufferMetaCache &ExynosLayer::getBufferMeta() {
+    /* mLayerBuffer can also be replaced without setLayerBuffer() */
+    if ((mBufferMetaCache.generation == mBufferGeneration) &&
+        (mBufferMetaCache.handle == mLayerBuffer))
+        return mBufferMetaCache;
+
+    mBufferMetaCache = {};
+    mBufferMetaCache.generation = mBufferGeneration;
+    mBufferMetaCache.handle = mLayerBuffer;
+    if (mLayerBuffer != NULL) {
+        ExynosGraphicBufferMeta gmeta(mLayerBuffer);
+        mBufferMetaCache.stride = gmeta.stride;
+        mBufferMetaCache.vstride = gmeta.vstride;
+        mBufferMetaCache.format = gmeta.format;
+#ifdef GRALLOC_VERSION1
+        mBufferMetaCache.usage = gmeta.producer_usage;
+        mBufferMetaCache.consumerUsage = gmeta.consumer_usage;
+#else
+        mBufferMetaCache.usage = (uint64_t)gmeta.flags;
+        mBufferMetaCache.consumerUsage = (uint64_t)gmeta.flags;
+#endif
+    }
+
+    return mBufferMetaCache;
+}
+
+void ExynosLayer::updatePreImportConfig(const exynos_win_config_data &config) {
+    const BufferMetaCache &meta = getBufferMeta();
+
+    mPreImportConfig = config;
+    /* Only buffer properties are used, fds of this frame are not owned */
+    mPreImportConfig.acq_fence = -1;
+    mPreImportConfig.rel_fence = -1;
+    mPreImportConfig.fd_lut = -1;
+    mPreImportConfig.metaParcel = nullptr;
+    mPreImportMeta = meta;
+    mPreImportFormat = ExynosGraphicBufferMeta::get_format(mLayerBuffer);
+    mPreImportValid = true;
+}
+
+/*
+ * Framebuffer of the new buffer is same with the last one except
+ * the buffer itself if it has same properties with the last buffer.
+ */
+bool ExynosLayer::getPreImportConfig(buffer_handle_t buffer, exynos_win_config_data &config) {
+    if ((!mPreImportValid) || (buffer == NULL) ||
+        (buffer == mPreImportMeta.handle))
+        return false;
+
+    ExynosGraphicBufferMeta gmeta(buffer);
+#ifdef GRALLOC_VERSION1
+    uint64_t usage = gmeta.producer_usage;
+#else
+    uint64_t usage = (uint64_t)gmeta.flags;
+#endif
+    if ((gmeta.format != mPreImportFormat) ||
+        ((uint32_t)gmeta.stride != mPreImportMeta.stride) ||
+        ((uint32_t)gmeta.vstride != mPreImportMeta.vstride) ||
+        (getDrmMode(usage) != getDrmMode(mPreImportMeta.usage)))
+        return false;
+
+    compressionInfo_t compressionInfo = getCompressionInfo(buffer);
+    if (compressionInfo.type != mPreImportConfig.compressionInfo.type)
+        return false;
+
+    config = mPreImportConfig;
+    config.compressionInfo = compressionInfo;
+    config.fd_idma[0] = gmeta.fd;
+    config.fd_idma[1] = gmeta.fd1;
+    config.fd_idma[2] = gmeta.fd2;
+    config.buffer_id = ExynosGraphicBufferMeta::get_buffer_id(buffer);
+
+    return true;
+}
+
 int32_t ExynosLayer::setSrcExynosImage(exynos_image *src_img) {
     buffer_handle_t handle = mLayerBuffer;
     if (isDimLayer()) {
@@ -641,25 +930,21 @@ int32_t ExynosLayer::setSrcExynosImage(exynos_image *src_img) {
         src_img->usageFlags = 0x0;
         src_img->bufferHandle = handle;
     } else {
-        ExynosGraphicBufferMeta gmeta(handle);
+        const BufferMetaCache &meta = getBufferMeta();
 
         if ((mPreprocessedInfo.interlacedType == V4L2_FIELD_INTERLACED_TB) ||
             (mPreprocessedInfo.interlacedType == V4L2_FIELD_INTERLACED_BT)) {
-            src_img->fullWidth = (gmeta.stride * 2);
-            src_img->fullHeight = pixel_align_down((gmeta.vstride / 2), 2);
+            src_img->fullWidth = (meta.stride * 2);
+            src_img->fullHeight = pixel_align_down((meta.vstride / 2), 2);
         } else {
-            src_img->fullWidth = gmeta.stride;
-            src_img->fullHeight = gmeta.vstride;
+            src_img->fullWidth = meta.stride;
+            src_img->fullHeight = meta.vstride;
         }
         if (!mPreprocessedInfo.mUsePrivateFormat)
             src_img->exynosFormat = mLayerFormat;
         else
             src_img->exynosFormat = mPreprocessedInfo.mPrivateFormat;
-#ifdef GRALLOC_VERSION1
-        src_img->usageFlags = gmeta.producer_usage;
-#else
-        src_img->usageFlags = (uint64_t)gmeta.flags;
-#endif
+        src_img->usageFlags = meta.usage;
         src_img->bufferHandle = handle;
     }
     src_img->x = (int)mPreprocessedInfo.sourceCrop.left;
@@ -689,9 +974,11 @@ int32_t ExynosLayer::setSrcExynosImage(exynos_image *src_img) {
     /* Set HDR metadata */
     src_img->metaParcel = nullptr;
     src_img->metaType = VIDEO_INFO_TYPE_INVALID;
+    src_img->hdrDynamicGeneration = 0;
     if (mMetaParcel != nullptr) {
         src_img->metaParcel = mMetaParcel;
         src_img->metaType = mMetaParcel->eType;
+        src_img->hdrDynamicGeneration = mHdrDynamicGeneration;
     }
 
     src_img->needColorTransform = mLayerColorTransform.enable;
@@ -712,11 +999,7 @@ int32_t ExynosLayer::setDstExynosImage(exynos_image *dst_img) {
     if (handle == NULL) {
         dst_img->usageFlags = 0x0;
     } else {
-#ifdef GRALLOC_VERSION1
-        dst_img->usageFlags = ExynosGraphicBufferMeta::get_producer_usage(handle);
-#else
-        dst_img->usageFlags = (uint64_t)handle->flags;
-#endif
+        dst_img->usageFlags = getBufferMeta().usage;
     }
 
     if (isDimLayer()) {
@@ -765,9 +1048,11 @@ int32_t ExynosLayer::setDstExynosImage(exynos_image *dst_img) {
     /* Set HDR metadata */
     dst_img->metaParcel = nullptr;
     dst_img->metaType = VIDEO_INFO_TYPE_INVALID;
+    dst_img->hdrDynamicGeneration = 0;
     if (mMetaParcel != NULL) {
         dst_img->metaParcel = mMetaParcel;
         dst_img->metaType = mMetaParcel->eType;
+        dst_img->hdrDynamicGeneration = mHdrDynamicGeneration;
     }
 
     return NO_ERROR;
@@ -788,6 +1073,41 @@ int32_t ExynosLayer::resetAssignedResource() {
     return ret;
 }
 
+void ExynosLayer::updatePrevAssignInfo() {
+    if ((mValidateCompositionType != HWC2_COMPOSITION_DEVICE) ||
+        (mOtfMPP == NULL)) {
+        mPrevAssignInfo.reset();
+        return;
+    }
+    mPrevAssignInfo.otfMPP = mOtfMPP;
+    mPrevAssignInfo.m2mMPP = mM2mMPP;
+    mPrevAssignInfo.srcImg = mSrcImg;
+    mPrevAssignInfo.midImg = mMidImg;
+}
+
+/*
+ * Previous assignment can be reused only if the layer keeps
+ * the same geometry class. Buffer handle and fences are not compared.
+ */
+bool ExynosLayer::isPrevAssignReusable(exynos_image &src_img) {
+    exynos_image &prev = mPrevAssignInfo.srcImg;
+
+    if ((mPrevAssignInfo.otfMPP == NULL) || (mGeometryChanged != 0))
+        return false;
+
+    return ((prev.exynosFormat == src_img.exynosFormat) &&
+            (prev.fullWidth == src_img.fullWidth) &&
+            (prev.fullHeight == src_img.fullHeight) &&
+            (prev.x == src_img.x) && (prev.y == src_img.y) &&
+            (prev.w == src_img.w) && (prev.h == src_img.h) &&
+            (prev.dataSpace == src_img.dataSpace) &&
+            (prev.transform == src_img.transform) &&
+            (prev.blending == src_img.blending) &&
+            (prev.layerFlags == src_img.layerFlags) &&
+            (prev.compressionInfo.type == src_img.compressionInfo.type) &&
+            (prev.needColorTransform == src_img.needColorTransform));
+}
+
 void ExynosLayer::setSrcAcquireFence() {
     if (mAcquireFence == -1 && mPrevAcquireFence != -1) {
         mAcquireFence = mFenceTracer.checkFenceDebug(mDisplayInfo.displayIdentifier,
@@ -825,6 +1145,8 @@ void ExynosLayer::dump(String8 &result) {
                         mPreprocessedInfo.displayFrame.left, mPreprocessedInfo.displayFrame.top, mPreprocessedInfo.displayFrame.right, mPreprocessedInfo.displayFrame.bottom,
                         mCompositionType, mExynosCompositionType, mValidateCompositionType, mOverlayInfo, mSupportedMPPFlag, mHWResourceAmount[TDM_ATTR_SRAM_AMOUNT]);
     result.appendFormat("+---------------+---------------------------------+--------------------------+------+------------+--------------+-------------+------------------------------------+\n");
+    if (mClientCompositionReason != CLIENT_REASON_NONE)
+        result.appendFormat("client composition reason: %u\n", mClientCompositionReason);
 
     if (mCheckMPPFlag.size()) {
         result.appendFormat("Unsupported MPP flags\n");
@@ -903,6 +1225,21 @@ void ExynosLayer::setGeometryChanged(uint64_t changedBit,
     outGeometryChanged |= changedBit;
 }
 
+/*
+ * Generations are unique in the process, so equal generations of two
+ * images mean the same parsed dynamic info even if the layers differ.
+ */
+uint64_t ExynosLayer::nextHdrDynamicGeneration() {
+    static std::atomic<uint64_t> generation{0};
+
+    return ++generation;
+}
+
+void ExynosLayer::invalidateHdrDynamicGeneration() {
+    mHdr10PlusBlobHash = 0;
+    mHdrDynamicGeneration = 0;
+}
+
 int ExynosLayer::allocMetaParcel() {
     /* Already allocated */
     if ((mMetaParcelFd >= 0) &&
@@ -1005,6 +1342,7 @@ void ExynosLayer::handleHdrDynamicMetaData(ExynosVideoMeta *metaData,
 
         const auto &metaValue = smpte2094_40.value();
         ExynosHdrDynamicInfo *info = &(mMetaParcel->sHdrDynamicInfo);
+        invalidateHdrDynamicGeneration();
         int32_t prevFlag = mLayerFlag & EXYNOS_HWC_FORCE_CLIENT_HDR_META_ERROR;
         if (Exynos_parsing_user_data_registered_itu_t_t35(info, (void *)metaValue.data())) {
             mLayerFlag |= EXYNOS_HWC_FORCE_CLIENT_HDR_META_ERROR;
@@ -1027,6 +1365,7 @@ void ExynosLayer::handleHdrDynamicMetaData(ExynosVideoMeta *metaData,
         mMetaParcel->eType =
             static_cast<ExynosVideoInfoType>(mMetaParcel->eType | VIDEO_INFO_TYPE_HDR_DYNAMIC);
         mMetaParcel->sHdrDynamicInfo = metaData->sHdrDynamicInfo;
+        invalidateHdrDynamicGeneration();
         mIsHdr10PlusLayer = true;
         HDEBUGLOGD(eDebugLayer, "HWC2: Layer has dynamic metadata");
     }
@@ -18,13 +18,16 @@
 #define _EXYNOSLAYER_H
 
 #include <array>
+#include <optional>
 #include <system/graphics.h>
 #include <unordered_map>
+#include <vector>
 #include <log/log.h>
 #include <utils/Timers.h>
 #include <hardware/hwcomposer2.h>
 #include "ExynosHWC.h"
 #include "ExynosMPP.h"
+#include "ExynosDpuData.h"
 #include "VendorVideoAPI.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCTypes.h"
@@ -32,6 +35,12 @@
 #ifndef HWC2_HDR10_PLUS_SEI
 /* based on android.hardware.composer.2_3 */
 #define HWC2_HDR10_PLUS_SEI 12
+
+/* Layer update rate is measured for this period */
+#define LAYER_FPS_CHECK_PERIOD s2ns(1)
+/* Layer is regarded as frequently updated over HIGH fps until it is under LOW fps */
+#define LAYER_FREQUENT_UPDATE_FPS_HIGH 30
+#define LAYER_FREQUENT_UPDATE_FPS_LOW 10
 #endif
 
 typedef struct pre_processed_layer_info {
@@ -43,6 +52,26 @@ typedef struct pre_processed_layer_info {
     ExynosFormat mPrivateFormat;
 } pre_processed_layer_info_t;
 
+/*
+ * Layer state changed by one layer command of composer.
+ * Only the fields that are set are applied.
+ */
+typedef struct exynos_layer_state {
+    std::optional<buffer_handle_t> buffer;
+    int32_t acquireFence = -1;
+    std::optional<std::vector<hwc_rect_t>> surfaceDamage;
+    std::optional<int32_t> blendMode;
+    std::optional<hwc_color_t> color;
+    std::optional<int32_t> compositionType;
+    std::optional<int32_t> dataspace;
+    std::optional<hwc_rect_t> displayFrame;
+    std::optional<float> planeAlpha;
+    std::optional<hwc_frect_t> sourceCrop;
+    std::optional<int32_t> transform;
+    std::optional<std::vector<hwc_rect_t>> visibleRegion;
+    std::optional<uint32_t> zOrder;
+} exynos_layer_state_t;
+
 class ExynosLayer : public ExynosMPPSource {
   public:
     ExynosLayer(DisplayInfo displayInfo);
@@ -80,6 +109,9 @@ class ExynosLayer : public ExynosMPPSource {
 
     uint32_t mOverlayInfo;
 
+    /* client_composition_reason of this frame, CLIENT_REASON_NONE if not client */
+    uint32_t mClientCompositionReason = CLIENT_REASON_NONE;
+
     /**
          * Layer supported information for each MPP type (bit setting)
          * (= Restriction check, out format will be set as RGB for temporary
@@ -109,6 +141,12 @@ class ExynosLayer : public ExynosMPPSource {
          */
     uint64_t mGeometryChanged;
 
+    /**
+         * Changes of this frame that keep the hardware state and so are not
+         * set to mGeometryChanged. Only counted for the dump.
+         */
+    uint64_t mFilteredGeometryChanged = 0;
+
     /**
          * Layer's window index
          */
@@ -133,6 +171,7 @@ class ExynosLayer : public ExynosMPPSource {
     uint32_t mFrameCount;
     uint32_t mLastFrameCount;
     nsecs_t mLastFpsTime;
+    bool mFrequentlyUpdated;
 
     /**
          * Previous buffer's handle
@@ -145,6 +184,35 @@ class ExynosLayer : public ExynosMPPSource {
     buffer_handle_t mLayerBuffer;
     ExynosFormat mLayerFormat;
 
+    /**
+         * Gralloc metadata of mLayerBuffer used to build exynos_image.
+         * It is read from gralloc once per generation, which is
+         * increased whenever a buffer is set to the layer.
+         */
+    struct BufferMetaCache {
+        uint64_t generation = 0;
+        buffer_handle_t handle = NULL;
+        uint32_t stride = 0;
+        uint32_t vstride = 0;
+        uint64_t usage = 0;
+        uint64_t consumerUsage = 0;
+        uint32_t format = 0;
+    } mBufferMetaCache;
+    uint64_t mBufferGeneration = 1;
+    const BufferMetaCache &getBufferMeta();
+
+    /**
+         * Window config of the last frame that is used to predict
+         * the config of next buffer for pre-import.
+         * It is valid only if the layer is composed by otfMPP directly.
+         */
+    exynos_win_config_data mPreImportConfig;
+    BufferMetaCache mPreImportMeta;
+    int mPreImportFormat = 0;
+    bool mPreImportValid = false;
+    void updatePreImportConfig(const exynos_win_config_data &config);
+    bool getPreImportConfig(buffer_handle_t buffer, exynos_win_config_data &config);
+
     /**
          * Surface Damage
          */
@@ -210,6 +278,13 @@ class ExynosLayer : public ExynosMPPSource {
     bool mIsHdrFrameworkPath;
     bool mIsHdr10PlusFrameworkPath;
     int mMetaParcelFd;
+    /**
+         * Hash of the last parsed HDR10+ SEI blob and the generation of the
+         * dynamic info in the parcel. The generation is 0 if the info is not
+         * from a blob of setLayerPerFrameMetadataBlobs.
+         */
+    uint64_t mHdr10PlusBlobHash;
+    uint64_t mHdrDynamicGeneration;
 
     /**
          * color transform info
@@ -219,6 +294,29 @@ class ExynosLayer : public ExynosMPPSource {
         std::array<float, TRANSFORM_MAT_SIZE> mat;
     } mLayerColorTransform;
 
+    /**
+         * MPP assignment of the last successful validate.
+         * It is tried first in the next assignment if geometry class of the layer is not changed.
+         */
+    struct PrevAssignInfo {
+        ExynosMPP *otfMPP = nullptr;
+        ExynosMPP *m2mMPP = nullptr;
+        exynos_image srcImg;
+        exynos_image midImg;
+        void reset() { *this = {}; };
+    } mPrevAssignInfo;
+
+    /**
+         * Number of consecutive frames without buffer or geometry update.
+         */
+    uint32_t mStaticFrameCount = 0;
+
+    /**
+         * otfMPP that the assignment solver chose for this layer.
+         * It is tried first by assignLayer().
+         */
+    ExynosMPP *mSolverOtfMPP = nullptr;
+
     /**
          * @param type
          */
@@ -229,6 +327,15 @@ class ExynosLayer : public ExynosMPPSource {
     void resizeDisplayFrame(DeviceValidateInfo &validateInfo);
     int32_t doPreProcess(DeviceValidateInfo &validateInfo,
                          uint64_t &outGeometryChanged);
+    /*
+     * Sets mPreprocessedInfo as doPreProcess() will do if it doesn't
+     * depend on the device state. Returns false without any change for
+     * the layers that doPreProcess() adjusts: no buffer, dim, YUV, HDR
+     * or DRM layers.
+     */
+    bool preProcessSpeculatively();
+    uint32_t checkFps();
+    bool isFrequentlyUpdated();
 
     /* setLayerBuffer(..., buffer, acquireFence)
          * Descriptor: HWC2_FUNCTION_SET_LAYER_BUFFER
@@ -345,19 +452,38 @@ class ExynosLayer : public ExynosMPPSource {
                                           const uint8_t *metadata);
     int32_t setLayerColorTransform(const float *matrix);
 
+    /*
+     * Apply all of changed fields in the order of separate setLayer*() calls.
+     * Every field is applied even if one of them fails,
+     * the first error is returned.
+     */
+    int32_t setLayerState(const exynos_layer_state_t &state, uint64_t &geometryFlag);
+
+    /*
+     * Hash of layer attributes that resource assignment depends on.
+     * It is compared with the value of last validated frame.
+     */
+    uint64_t getValidateFingerprint();
+
     void resetValidateData();
+    uint32_t updateClientCompositionReason();
     virtual void dump(String8 &result);
     void printLayer();
     int32_t setSrcExynosImage(exynos_image *src_img);
     int32_t setDstExynosImage(exynos_image *dst_img);
     int32_t resetAssignedResource();
+    void updatePrevAssignInfo();
+    bool isPrevAssignReusable(exynos_image &src_img);
 
     void setSrcAcquireFence();
 
     bool isDrm() { return ((mLayerBuffer != NULL) && (getDrmMode(mLayerBuffer) != NO_DRM)); };
     void setGeometryChanged(uint64_t changedBit,
                             uint64_t &outGeometryChanged);
-    void clearGeometryChanged() { mGeometryChanged = 0; };
+    void clearGeometryChanged() {
+        mGeometryChanged = 0;
+        mFilteredGeometryChanged = 0;
+    };
     bool isDimLayer();
     ExynosVideoMeta *getMetaParcel() { return mMetaParcel; };
 
@@ -369,6 +495,8 @@ class ExynosLayer : public ExynosMPPSource {
   private:
     ExynosVideoMeta *mMetaParcel;
     int allocMetaParcel();
+    static uint64_t nextHdrDynamicGeneration();
+    void invalidateHdrDynamicGeneration();
     int32_t handleMetaData(uint64_t &outGeometryChanged);
     void handleHdrStaticMetaData(ExynosVideoMeta *metaData);
     void handleHdrDynamicMetaData(ExynosVideoMeta *metaData, uint64_t &geometryChanged);
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hardware/hwcomposer2.h>
+#include <inttypes.h>
+#include <sync/sync.h>
+#include "ExynosReadbackRing.h"
+#include "ExynosHWCDebug.h"
+#include "ExynosHWCHelper.h"
+
+ExynosReadbackRing::~ExynosReadbackRing() {
+    clearSlots();
+}
+
+int32_t ExynosReadbackRing::start(const std::vector<buffer_handle_t> &buffers) {
+    if ((buffers.size() == 0) || (buffers.size() > READBACK_RING_MAX_SLOTS)) {
+        ALOGE("%s:: invalid number of buffers(%zu)", __func__, buffers.size());
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+    for (auto buffer : buffers) {
+        if (buffer == nullptr) {
+            ALOGE("%s:: buffer is null", __func__);
+            return HWC2_ERROR_BAD_PARAMETER;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    clearSlots();
+    for (auto buffer : buffers) {
+        Slot slot;
+        slot.buffer = buffer;
+        mSlots.push_back(slot);
+    }
+    mFrameNumber = 0;
+    mDropped = 0;
+    mSkipped = 0;
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosReadbackRing::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    clearSlots();
+}
+
+bool ExynosReadbackRing::isRunning() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSlots.size() > 0;
+}
+
+void ExynosReadbackRing::clearSlots() {
+    for (auto &slot : mSlots) {
+        if (slot.fence >= 0)
+            hwcFdClose(slot.fence);
+    }
+    mSlots.clear();
+}
+
+ExynosReadbackRing::Slot *ExynosReadbackRing::findSlot(buffer_handle_t buffer) {
+    for (auto &slot : mSlots) {
+        if (slot.buffer == buffer)
+            return &slot;
+    }
+    return nullptr;
+}
+
+buffer_handle_t ExynosReadbackRing::dequeue() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Slot *candidate = nullptr;
+
+    for (auto &slot : mSlots) {
+        if (slot.state != SLOT_FREE)
+            continue;
+        /* Consumer is still reading this buffer */
+        if ((slot.fence >= 0) && (sync_wait(slot.fence, 0) < 0))
+            continue;
+        candidate = &slot;
+        break;
+    }
+
+    /* Drop the oldest frame that is not acquired yet */
+    if (candidate == nullptr) {
+        for (auto &slot : mSlots) {
+            if ((slot.state == SLOT_READY) &&
+                ((candidate == nullptr) || (slot.frameNumber < candidate->frameNumber)))
+                candidate = &slot;
+        }
+        if (candidate != nullptr)
+            mDropped++;
+    }
+
+    if (candidate == nullptr) {
+        mSkipped++;
+        return nullptr;
+    }
+
+    if (candidate->fence >= 0)
+        candidate->fence = hwcFdClose(candidate->fence);
+    candidate->state = SLOT_WRITING;
+    return candidate->buffer;
+}
+
+void ExynosReadbackRing::queue(buffer_handle_t buffer, int32_t fence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Slot *slot = findSlot(buffer);
+
+    if ((slot == nullptr) || (slot->state != SLOT_WRITING)) {
+        /* Ring was stopped or restarted while this frame is presented */
+        if (fence >= 0)
+            hwcFdClose(fence);
+        return;
+    }
+
+    /* Frame was skipped or failed, buffer was not written */
+    if (fence < 0) {
+        slot->state = SLOT_FREE;
+        mSkipped++;
+        return;
+    }
+
+    slot->state = SLOT_READY;
+    slot->fence = fence;
+    slot->frameNumber = mFrameNumber++;
+}
+
+int32_t ExynosReadbackRing::acquire(buffer_handle_t *outBuffer, int32_t *outFence,
+                                    uint64_t *outFrameNumber) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Slot *oldest = nullptr;
+
+    for (auto &slot : mSlots) {
+        if ((slot.state == SLOT_READY) &&
+            ((oldest == nullptr) || (slot.frameNumber < oldest->frameNumber)))
+            oldest = &slot;
+    }
+
+    if (oldest == nullptr) {
+        *outBuffer = nullptr;
+        *outFence = -1;
+        return HWC2_ERROR_NO_RESOURCES;
+    }
+
+    oldest->state = SLOT_ACQUIRED;
+    *outBuffer = oldest->buffer;
+    *outFence = oldest->fence;
+    oldest->fence = -1;
+    if (outFrameNumber != nullptr)
+        *outFrameNumber = oldest->frameNumber;
+    return HWC2_ERROR_NONE;
+}
+
+int32_t ExynosReadbackRing::release(buffer_handle_t buffer, int32_t releaseFence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Slot *slot = findSlot(buffer);
+
+    if ((slot == nullptr) || (slot->state != SLOT_ACQUIRED)) {
+        ALOGE("%s:: buffer(%p) is not acquired", __func__, buffer);
+        if (releaseFence >= 0)
+            hwcFdClose(releaseFence);
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+
+    slot->state = SLOT_FREE;
+    slot->fence = releaseFence;
+    return HWC2_ERROR_NONE;
+}
+
+void ExynosReadbackRing::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mSlots.size() == 0)
+        return;
+
+    result.appendFormat("Readback ring: %zu slots, frames(%" PRIu64 "), dropped(%" PRIu64 "), "
+                        "skipped(%" PRIu64 ")\n",
+                        mSlots.size(), mFrameNumber, mDropped, mSkipped);
+    for (auto &slot : mSlots) {
+        result.appendFormat("\t%p: state(%d), fence(%d), frame(%" PRIu64 ")\n",
+                            slot.buffer, slot.state, slot.fence, slot.frameNumber);
+    }
+}
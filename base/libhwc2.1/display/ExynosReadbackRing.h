@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSREADBACKRING_H
+#define _EXYNOSREADBACKRING_H
+
+#include <cutils/native_handle.h>
+#include <utils/String8.h>
+#include <mutex>
+#include <vector>
+
+#define READBACK_RING_MAX_SLOTS 8
+
+using namespace android;
+
+/*
+ * Ring of caller-provided readback buffers for streaming writeback.
+ * Present path dequeues a slot for concurrent writeback of each frame and
+ * queues it back with the writeback done fence. Consumers acquire frames
+ * in present order and release them with their release fence.
+ * If consumers are slower than present, the oldest ready frame is dropped
+ * instead of stalling present path.
+ */
+class ExynosReadbackRing {
+  public:
+    ~ExynosReadbackRing();
+
+    /* Buffers are owned by caller and should be kept until stop() */
+    int32_t start(const std::vector<buffer_handle_t> &buffers);
+    void stop();
+    bool isRunning();
+
+    /* For present path, these never wait for fences */
+    buffer_handle_t dequeue();
+    void queue(buffer_handle_t buffer, int32_t fence);
+
+    /*
+     * Oldest ready frame is returned.
+     * outFence should be waited before the buffer is read and closed by caller.
+     */
+    int32_t acquire(buffer_handle_t *outBuffer, int32_t *outFence,
+                    uint64_t *outFrameNumber);
+    /* releaseFence is owned by the ring after this call */
+    int32_t release(buffer_handle_t buffer, int32_t releaseFence);
+
+    void dump(String8 &result);
+
+  private:
+    enum slot_state_t {
+        SLOT_FREE,
+        SLOT_WRITING,
+        SLOT_READY,
+        SLOT_ACQUIRED,
+    };
+    struct Slot {
+        buffer_handle_t buffer = nullptr;
+        slot_state_t state = SLOT_FREE;
+        /* Writeback done fence if ready, consumer release fence if free */
+        int32_t fence = -1;
+        uint64_t frameNumber = 0;
+    };
+
+    Slot *findSlot(buffer_handle_t buffer);
+    void clearSlots();
+
+    std::mutex mMutex;
+    std::vector<Slot> mSlots;
+    uint64_t mFrameNumber = 0;
+    uint64_t mDropped = 0;
+    uint64_t mSkipped = 0;
+};
+
+#endif
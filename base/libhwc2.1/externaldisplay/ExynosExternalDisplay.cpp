@@ -17,6 +17,8 @@
 #include <hardware/hwcomposer_defs.h>
 #include "ExynosExternalDisplay.h"
 #include <errno.h>
+#include <inttypes.h>
+#include <algorithm>
 #include "ExynosLayer.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCDebug.h"
@@ -73,13 +75,20 @@ int ExynosExternalDisplay::openExternalDisplay() {
     }
     mVsyncCallback.enableVSync(true);
 
+    mSinkHash = getSinkHash();
+    mKnownSink = (mSinkHash != 0) && (mSinkInfos.count(mSinkHash) != 0);
+    mSinkInfoUpdated = false;
+    if (mKnownSink)
+        DISPLAY_LOGI("%s:: known sink(0x%" PRIx64 ")", __func__, mSinkHash);
+
     mSkipFrameCount = SKIP_FRAME_COUNT;
-    mSkipStartFrame = 0;
+    mSkipStartFrame = mKnownSink ? (SKIP_EXTERNAL_FRAME - SKIP_EXTERNAL_FRAME_KNOWN_SINK) : 0;
     mActiveConfig = 0;
     mPlugState = true;
 
     if (mLayers.size() != 0) {
         mLayers.clear();
+        mLayerMap.clear();
     }
 
     DISPLAY_LOGD(eDebugExternalDisplay, "open fd for External Display(%d)", ret);
@@ -102,6 +111,12 @@ void ExynosExternalDisplay::closeExternalDisplay() {
 
     mPowerModeState = (hwc2_power_mode_t)HWC_POWER_MODE_OFF;
 
+    if (mVrrEnabled)
+        mDisplayInterface->setVrrEnabled(false);
+    mVrrEnabled = false;
+    mVrrCapable = false;
+    setAutoLowLatencyModeInternal(false);
+
     DISPLAY_LOGD(eDebugExternalDisplay, "Close fd for External Display");
 
     mPlugState = false;
@@ -129,21 +144,60 @@ int ExynosExternalDisplay::getDisplayConfigs(uint32_t *outNumConfigs, hwc2_confi
 
     if (outConfigs) {
         mActiveConfig = outConfigs[0];
+        if (mKnownSink) {
+            /* Bring the sink up in its last-good mode */
+            const SinkInfo &sink = mSinkInfos[mSinkHash];
+            for (uint32_t i = 0; i < *outNumConfigs; i++) {
+                const displayConfigs_t &config = mDisplayConfigs[outConfigs[i]];
+                if ((config.width == sink.width) && (config.height == sink.height) &&
+                    (config.vsyncPeriod == sink.vsyncPeriod)) {
+                    mActiveConfig = outConfigs[i];
+                    break;
+                }
+            }
+        }
         displayConfigs_t displayConfig = mDisplayConfigs[mActiveConfig];
         mXres = displayConfig.width;
         mYres = displayConfig.height;
         mVsyncPeriod = displayConfig.vsyncPeriod;
+        mModeConfig = mActiveConfig;
         if (mDisplayInterface->mType == INTERFACE_TYPE_DRM) {
             int32_t ret2 = mDisplayInterface->setActiveConfig(mActiveConfig, displayConfig);
             if (ret2) {
                 DISPLAY_LOGE("%s:: failed to setActiveConfigs, ret(%d)", __func__, ret2);
                 return ret2;
             }
+            mVrrCapable = mDisplayInterface->isVrrCapable();
+            DISPLAY_LOGI("%s:: VRR capable(%d)", __func__, mVrrCapable);
         }
     }
     return ret;
 }
 
+bool ExynosExternalDisplay::canChangeConfigSeamlessly(hwc2_config_t config) {
+    if (!mVrrCapable || (mDisplayConfigs.count(mModeConfig) == 0))
+        return false;
+
+    /* The refresh rate can be lowered within the resolution of the mode */
+    const displayConfigs_t &mode = mDisplayConfigs[mModeConfig];
+    const displayConfigs_t &target = mDisplayConfigs[config];
+    return (mode.groupId == target.groupId) && (target.vsyncPeriod >= mode.vsyncPeriod);
+}
+
+int32_t ExynosExternalDisplay::setModeConfig(hwc2_config_t config) {
+    int32_t ret = mDisplayInterface->setActiveConfig(config, mDisplayConfigs[config]);
+    if (ret != NO_ERROR) {
+        DISPLAY_LOGE("%s:: failed to set config(%d), ret(%d)", __func__, config, ret);
+        return ret;
+    }
+
+    mModeConfig = config;
+    if (mVrrEnabled && (mDisplayInterface->setVrrEnabled(false) == NO_ERROR))
+        mVrrEnabled = false;
+
+    return updateInternalDisplayConfigVariables(config);
+}
+
 int32_t ExynosExternalDisplay::getActiveConfig(hwc2_config_t *outConfig) {
     DISPLAY_LOGD(eDebugExternalDisplay, "");
     *outConfig = mActiveConfig;
@@ -283,6 +337,9 @@ int32_t ExynosExternalDisplay::presentDisplay(
 
     ret = ExynosDisplay::presentDisplay(presentInfo, outPresentFence);
 
+    if ((ret == HWC2_ERROR_NONE) && !mSinkInfoUpdated)
+        updateSinkInfo();
+
     return ret;
 }
 int32_t ExynosExternalDisplay::setClientTarget(
@@ -517,7 +574,44 @@ int32_t ExynosExternalDisplay::setActiveConfigWithConstraints(hwc2_config_t conf
                                                               hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
                                                               hwc_vsync_period_change_timeline_t *outTimeline,
                                                               bool needUpdateTimeline) {
-    return HWC2_ERROR_NONE;
+    Mutex::Autolock lock(mDisplayMutex);
+
+    if (isBadConfig(config))
+        return HWC2_ERROR_BAD_CONFIG;
+
+    if (needUpdateTimeline) {
+        outTimeline->refreshRequired = false;
+        outTimeline->newVsyncAppliedTimeNanos =
+            std::max(systemTime(SYSTEM_TIME_MONOTONIC), vsyncPeriodChangeConstraints->desiredTimeNanos);
+        outTimeline->refreshTimeNanos = outTimeline->newVsyncAppliedTimeNanos;
+    }
+
+    if ((config == mActiveConfig) || (mDisplayInterface->mType != INTERFACE_TYPE_DRM))
+        return HWC2_ERROR_NONE;
+
+    if (canChangeConfigSeamlessly(config)) {
+        bool vrrEnabled = (config != mModeConfig);
+        if ((vrrEnabled == mVrrEnabled) ||
+            (mDisplayInterface->setVrrEnabled(vrrEnabled) == NO_ERROR)) {
+            mVrrEnabled = vrrEnabled;
+            DISPLAY_LOGI("%s:: config(%d -> %d) without mode set, vrr(%d)", __func__,
+                         mActiveConfig, config, mVrrEnabled);
+            return updateInternalDisplayConfigVariables(config);
+        }
+    }
+
+    if (vsyncPeriodChangeConstraints->seamlessRequired) {
+        if (mDisplayConfigs[mActiveConfig].groupId != mDisplayConfigs[config].groupId)
+            return HWC2_ERROR_SEAMLESS_NOT_ALLOWED;
+        return HWC2_ERROR_SEAMLESS_NOT_POSSIBLE;
+    }
+
+    DISPLAY_LOGI("%s:: config(%d -> %d) with mode set", __func__, mActiveConfig, config);
+    int32_t ret = setModeConfig(config);
+    if ((ret == NO_ERROR) && needUpdateTimeline)
+        outTimeline->refreshRequired = true;
+
+    return ret;
 }
 
 int32_t ExynosExternalDisplay::doDisplayConfigPostProcess() {
@@ -528,12 +622,13 @@ int32_t ExynosExternalDisplay::getHdrCapabilities(uint32_t *outNumTypes,
                                                   int32_t *outTypes, float *outMaxLuminance,
                                                   float *outMaxAverageLuminance, float *outMinLuminance) {
     if (outTypes == NULL) {
-#ifndef USES_HDR_GLES_CONVERSION
-        mDisplayInterface->updateHdrSinkInfo();
-        mSinkHdrSupported = false;
-#else
-        mSinkHdrSupported = mDisplayInterface->updateHdrSinkInfo();
-#endif
+        if (mKnownSink && !mSinkInfoUpdated) {
+            const SinkInfo &sink = mSinkInfos[mSinkHash];
+            mDisplayInterface->mIsHdrSink = sink.isHdrSink;
+            mSinkHdrSupported = sink.hdrSupported;
+        } else {
+            updateSinkHdrInfo();
+        }
     }
 
     int32_t ret = ExynosDisplay::getHdrCapabilities(outNumTypes, outTypes,
@@ -551,6 +646,89 @@ int32_t ExynosExternalDisplay::getHdrCapabilities(uint32_t *outNumTypes,
     return ret;
 }
 
+uint64_t ExynosExternalDisplay::getSinkHash() {
+    /* The fb interface gives a sample EDID if the sink doesn't have one */
+    if (mDisplayInterface->mType != INTERFACE_TYPE_DRM)
+        return 0;
+
+    uint8_t port;
+    uint32_t size = 0;
+    if ((mDisplayInterface->getDisplayIdentificationData(&port, &size, nullptr) != HWC2_ERROR_NONE) ||
+        (size == 0))
+        return 0;
+
+    std::vector<uint8_t> edid(size);
+    if (mDisplayInterface->getDisplayIdentificationData(&port, &size, edid.data()) != HWC2_ERROR_NONE)
+        return 0;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hashFingerprint(hash, edid.data(), size);
+
+    return (hash == 0) ? 1 : hash;
+}
+
+void ExynosExternalDisplay::updateSinkHdrInfo() {
+#ifndef USES_HDR_GLES_CONVERSION
+    mDisplayInterface->updateHdrSinkInfo();
+    mSinkHdrSupported = false;
+#else
+    mSinkHdrSupported = mDisplayInterface->updateHdrSinkInfo();
+#endif
+}
+
+int32_t ExynosExternalDisplay::updateHdrCapabilities() {
+    if (!mKnownSink || mSinkInfoUpdated)
+        return ExynosDisplay::updateHdrCapabilities();
+
+    const SinkInfo &sink = mSinkInfos[mSinkHash];
+    mHdrTypes = sink.hdrTypes;
+    mMaxLuminance = sink.maxLuminance;
+    mMaxAverageLuminance = sink.maxAverageLuminance;
+    mMinLuminance = sink.minLuminance;
+
+    return NO_ERROR;
+}
+
+/*
+ * Called after a frame is presented. The HDR capabilities of a known sink
+ * were served from the cache at the plug, they are read from the sink here.
+ */
+void ExynosExternalDisplay::updateSinkInfo() {
+    if (mSkipStartFrame < SKIP_EXTERNAL_FRAME)
+        return;
+
+    mSinkInfoUpdated = true;
+    if ((mSinkHash == 0) || (mDisplayConfigs.count(mActiveConfig) == 0))
+        return;
+
+    if (mKnownSink) {
+        bool hdrSupported = mSinkHdrSupported;
+        float maxLuminance = mMaxLuminance;
+
+        updateSinkHdrInfo();
+        if (ExynosDisplay::updateHdrCapabilities() != NO_ERROR)
+            DISPLAY_LOGE("%s:: failed to read HDR capabilities of the sink", __func__);
+        if ((hdrSupported != mSinkHdrSupported) || (maxLuminance != mMaxLuminance))
+            DISPLAY_LOGI("%s:: HDR capabilities of sink(0x%" PRIx64 ") are changed",
+                         __func__, mSinkHash);
+    }
+
+    if ((mSinkInfos.count(mSinkHash) == 0) && (mSinkInfos.size() >= MAX_KNOWN_EXTERNAL_SINKS))
+        mSinkInfos.erase(mSinkInfos.begin());
+
+    const displayConfigs_t &config = mDisplayConfigs[mActiveConfig];
+    SinkInfo &sink = mSinkInfos[mSinkHash];
+    sink.width = config.width;
+    sink.height = config.height;
+    sink.vsyncPeriod = config.vsyncPeriod;
+    sink.isHdrSink = mDisplayInterface->mIsHdrSink;
+    sink.hdrSupported = mSinkHdrSupported;
+    sink.hdrTypes = mHdrTypes;
+    sink.maxLuminance = mMaxLuminance;
+    sink.maxAverageLuminance = mMaxAverageLuminance;
+    sink.minLuminance = mMinLuminance;
+}
+
 bool ExynosExternalDisplay::checkDisplayUnstarted() {
     return (mPlugState == true) && (mSkipStartFrame < SKIP_EXTERNAL_FRAME);
 }
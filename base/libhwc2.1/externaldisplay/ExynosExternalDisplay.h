@@ -17,6 +17,7 @@
 #ifndef EXYNOS_EXTERNAL_DISPLAY_H
 #define EXYNOS_EXTERNAL_DISPLAY_H
 
+#include <map>
 #include "ExynosDisplay.h"
 #include <cutils/properties.h>
 #include "ExynosDisplayFbInterface.h"
@@ -25,6 +26,10 @@
 #define EXTERNAL_DISPLAY_SKIP_LAYER 0x00000100
 #define SKIP_EXTERNAL_FRAME 5
 
+/* A known sink is brought up after this number of skipped start frames */
+#define SKIP_EXTERNAL_FRAME_KNOWN_SINK 1
+#define MAX_KNOWN_EXTERNAL_SINKS 8
+
 #ifndef PRIMARY_MAIN_EXTERNAL_WINCNT
 #define PRIMARY_MAIN_EXTERNAL_WINCNT 2
 #endif
@@ -47,6 +52,7 @@ class ExynosExternalDisplay : public ExynosDisplay {
 
     virtual int32_t getHdrCapabilities(uint32_t *outNumTypes, int32_t * /*android_hdr_t*/ outTypes, float *outMaxLuminance,
                                        float *outMaxAverageLuminance, float *outMinLuminance);
+    virtual int32_t updateHdrCapabilities() override;
 
     virtual int enable();
     int disable();
@@ -76,9 +82,9 @@ class ExynosExternalDisplay : public ExynosDisplay {
     virtual void handleHotplugEvent(bool hpdStatus);
     virtual int32_t getDisplayVsyncPeriod(hwc2_vsync_period_t *__unused outVsyncPeriod);
     virtual int32_t getDisplayVsyncPeriodInternal(hwc2_vsync_period_t *outVsyncPeriod);
-    virtual int32_t setActiveConfigWithConstraints(hwc2_config_t __unused config,
-                                                   hwc_vsync_period_change_constraints_t *__unused vsyncPeriodChangeConstraints,
-                                                   hwc_vsync_period_change_timeline_t *__unused outTimeline,
+    virtual int32_t setActiveConfigWithConstraints(hwc2_config_t config,
+                                                   hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
+                                                   hwc_vsync_period_change_timeline_t *outTimeline,
                                                    bool needUpdateTimeline = true);
     virtual int32_t doDisplayConfigPostProcess();
 
@@ -95,6 +101,45 @@ class ExynosExternalDisplay : public ExynosDisplay {
     String8 mEventNodeName;
 
   protected:
+    /*
+     * The last-good configuration and the HDR capabilities of the sinks,
+     * keyed by the hash of the EDID. A known sink is brought up in the same
+     * mode with the cached HDR capabilities, and they are read again from
+     * the sink after its first presented frame.
+     */
+    struct SinkInfo {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t vsyncPeriod = 0;
+        bool isHdrSink = false;
+        bool hdrSupported = false;
+        std::vector<int32_t> hdrTypes;
+        float maxLuminance = 0;
+        float maxAverageLuminance = 0;
+        float minLuminance = 0;
+    };
+    std::map<uint64_t, SinkInfo> mSinkInfos;
+    /* hash of the EDID of the connected sink, 0 if it is unknown */
+    uint64_t mSinkHash = 0;
+    bool mKnownSink = false;
+    bool mSinkInfoUpdated = false;
+
+    /*
+     * A VRR capable sink stays in mModeConfig, the mode set to it, and the
+     * configs of the same group with longer vsync periods are applied by
+     * VRR_ENABLED without a mode set.
+     */
+    hwc2_config_t mModeConfig = 0;
+    bool mVrrCapable = false;
+    bool mVrrEnabled = false;
+
+    bool canChangeConfigSeamlessly(hwc2_config_t config);
+    int32_t setModeConfig(hwc2_config_t config);
+
+    uint64_t getSinkHash();
+    void updateSinkInfo();
+    void updateSinkHdrInfo();
+
     int getDVTimingsIndex(int preset);
     virtual bool getHDRException(ExynosLayer *layer,
                                  DevicePresentInfo &deviceInfo) override;
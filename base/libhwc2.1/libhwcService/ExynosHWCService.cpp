@@ -73,6 +73,31 @@ int ExynosHWCService::getWFDInfo(int32_t *state, int32_t *compositionType, int32
     return INVALID_OPERATION;
 }
 
+int ExynosHWCService::getWFDLatencyRing() {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "%s", __func__);
+    for (uint32_t i = 0; i < mExynosDevice->mDisplays.size(); i++) {
+        if (mExynosDevice->mDisplays[i]->mType == HWC_DISPLAY_VIRTUAL) {
+            ExynosVirtualDisplay *virtualdisplay =
+                (ExynosVirtualDisplay *)mExynosDevice->mDisplays[i];
+            return virtualdisplay->getWFDLatencyRing();
+        }
+    }
+    return INVALID_OPERATION;
+}
+
+void ExynosHWCService::dumpWFDLatency() {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "%s", __func__);
+    for (uint32_t i = 0; i < mExynosDevice->mDisplays.size(); i++) {
+        if (mExynosDevice->mDisplays[i]->mType == HWC_DISPLAY_VIRTUAL) {
+            ExynosVirtualDisplay *virtualdisplay =
+                (ExynosVirtualDisplay *)mExynosDevice->mDisplays[i];
+            String8 result;
+            virtualdisplay->dumpWFDLatency(result);
+            ALOGI("%s", result.string());
+        }
+    }
+}
+
 int ExynosHWCService::sendWFDCommand(int32_t cmd, int32_t ext1, int32_t ext2) {
     ALOGD_IF(HWC_SERVICE_DEBUG, "%s::cmd=%d, ext1=%d, ext2=%d", __func__, cmd, ext1, ext2);
     for (uint32_t i = 0; i < mExynosDevice->mDisplays.size(); i++) {
@@ -198,6 +223,29 @@ int ExynosHWCService::setHWCCtl(uint32_t display, uint32_t ctrl, int32_t val) {
     case HWC_CTL_DO_FENCE_FILE_DUMP:
     case HWC_CTL_USE_PERF_FILE:
     case HWC_CTL_ADJUST_DYNAMIC_RECOMP_TIMER:
+    case HWC_CTL_INCREMENTAL_ASSIGN:
+    case HWC_CTL_RESET_LATENCY_STATS:
+    case HWC_CTL_STATIC_LAYER_CACHE:
+    case HWC_CTL_PARALLEL_VALIDATE:
+    case HWC_CTL_PREDICTIVE_PRESENT:
+    case HWC_CTL_ATOMIC_PROPERTY_SHADOW:
+    case HWC_CTL_ASSIGN_SOLVER:
+    case HWC_CTL_PPC_MODEL:
+    case HWC_CTL_M2M_PIPELINE:
+    case HWC_CTL_MPP_BUFFER_POOL_SIZE:
+    case HWC_CTL_M2M_CAPA_BROKER:
+    case HWC_CTL_DPP_POWER_GATING:
+    case HWC_CTL_ASSIGN_DEADLINE:
+    case HWC_CTL_UPDATE_RATE_PRIORITY:
+    case HWC_CTL_FB_PRE_IMPORT:
+    case HWC_CTL_PIPELINED_COMMIT:
+    case HWC_CTL_VALIDATE_FINGERPRINT:
+    case HWC_CTL_RECORD_FRAMES:
+    case HWC_CTL_DPU_BW_BUDGET:
+    case HWC_CTL_SPECULATIVE_PREVALIDATE:
+    case HWC_CTL_ADAPTIVE_DST_BUF:
+    case HWC_CTL_FOLD_DIM_LAYER:
+    case HWC_CTL_FRAME_CRC:
         ALOGI("%s::%d on/off=%d", __func__, ctrl, val);
         mExynosDevice->setHWCControl(display, ctrl, val);
         break;
@@ -268,6 +316,34 @@ int ExynosHWCService::getCPUPerfInfo(int display, int config, int32_t *cpuIDs, i
     return mExynosDevice->getCPUPerfInfo(display, config, cpuIDs, min_clock);
 }
 
+int ExynosHWCService::getFramePacingStats(int32_t displayId, uint32_t config,
+                                          std::vector<uint64_t> *slip, uint64_t *repeatedFrames) {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "%s::display(%d), config(%u)", __func__, displayId, config);
+    ExynosDisplay *display = mExynosDevice->getDisplay(displayId);
+    if (display == nullptr)
+        return -EINVAL;
+
+    FramePacingInfo::Stats stats;
+    if (display->getFramePacingStats(config, stats) != HWC2_ERROR_NONE)
+        return -ENOENT;
+
+    slip->assign(stats.slip.begin(), stats.slip.end());
+    *repeatedFrames = stats.repeatedFrames;
+    return NO_ERROR;
+}
+
+int ExynosHWCService::getStatusPage() {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "%s", __func__);
+    /* The page is created with the device, it does not take the device lock */
+    int fd = mExynosDevice->getStatusPage();
+    return (fd < 0) ? NO_INIT : fd;
+}
+
+void ExynosHWCService::notifyPSRExit() {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "%s", __func__);
+    mExynosDevice->notifyPSRExit();
+}
+
 int32_t ExynosHWCService::setDisplayMultiThreadedPresent(const int32_t& displayId,
                                                          const bool& enable) {
     auto display = mHWCCtx->device->getDisplay(displayId);
@@ -422,6 +498,46 @@ status_t ExynosHWCService::onTransact(
         getHWCFenceDebug();
         return NO_ERROR;
     } break;
+    case GET_WFD_LATENCY_RING: {
+        CHECK_INTERFACE(IExynosHWCService, data, reply);
+        int fd = getWFDLatencyRing();
+        reply->writeInt32(fd < 0 ? fd : 0);
+        if (fd >= 0)
+            reply->writeDupFileDescriptor(fd);
+        return NO_ERROR;
+    } break;
+    case GET_STATUS_PAGE: {
+        CHECK_INTERFACE(IExynosHWCService, data, reply);
+        int fd = getStatusPage();
+        reply->writeInt32(fd < 0 ? fd : 0);
+        if (fd >= 0)
+            reply->writeDupFileDescriptor(fd);
+        return NO_ERROR;
+    } break;
+    case NOTIFY_PSR_EXIT: {
+        CHECK_INTERFACE(IExynosHWCService, data, reply);
+        notifyPSRExit();
+        return NO_ERROR;
+    } break;
+    case DUMP_WFD_LATENCY: {
+        CHECK_INTERFACE(IExynosHWCService, data, reply);
+        dumpWFDLatency();
+        return NO_ERROR;
+    } break;
+    case GET_FRAME_PACING_STATS: {
+        CHECK_INTERFACE(IExynosHWCService, data, reply);
+        int32_t displayId = data.readInt32();
+        uint32_t config = data.readUint32();
+        std::vector<uint64_t> slip;
+        uint64_t repeatedFrames = 0;
+        int ret = getFramePacingStats(displayId, config, &slip, &repeatedFrames);
+        reply->writeInt32(ret);
+        if (ret == NO_ERROR) {
+            reply->writeUint64Vector(slip);
+            reply->writeUint64(repeatedFrames);
+        }
+        return NO_ERROR;
+    } break;
     case GET_DUMP_LAYER: {
         CHECK_INTERFACE(IExynosHWCService, data, reply);
         uint32_t dumpCount = data.readInt32();
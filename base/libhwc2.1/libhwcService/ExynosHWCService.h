@@ -48,6 +48,11 @@ class ExynosHWCService
     virtual void setBootFinished(void);
     virtual uint32_t getHWCDebug();
     virtual int getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *min_clock);
+    virtual int getWFDLatencyRing();
+    virtual int getFramePacingStats(int32_t displayId, uint32_t config,
+                                    std::vector<uint64_t> *slip, uint64_t *repeatedFrames);
+    virtual int getStatusPage();
+    virtual void notifyPSRExit();
     virtual int32_t setDisplayMultiThreadedPresent(const int32_t& display_id,
                                                    const bool& enable) override;
 
@@ -59,6 +64,7 @@ class ExynosHWCService
     int setHWCCtl(uint32_t display, uint32_t ctrl, int32_t val);
     void setDumpCount(uint32_t dumpCount);
     void setInterfaceDebug(int32_t display, int32_t interface, int32_t value);
+    void dumpWFDLatency();
     virtual int printMppsAttr();
 
     virtual status_t onTransact(uint32_t code,
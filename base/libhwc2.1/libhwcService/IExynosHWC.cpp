@@ -16,6 +16,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <fcntl.h>
 
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
@@ -135,6 +136,14 @@ class BpExynosHWCService : public BpInterface<IExynosHWCService> {
             ALOGE("SET_BOOT_FINISHED transact error(%d)", result);
     }
 
+    virtual void notifyPSRExit() {
+        Parcel data, reply;
+        data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
+        int result = remote()->transact(NOTIFY_PSR_EXIT, data, &reply, IBinder::FLAG_ONEWAY);
+        if (result != NO_ERROR)
+            ALOGE("NOTIFY_PSR_EXIT transact error(%d)", result);
+    }
+
     virtual uint32_t getHWCDebug() {
         Parcel data, reply;
         data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
@@ -161,6 +170,53 @@ class BpExynosHWCService : public BpInterface<IExynosHWCService> {
         }
         return result;
     }
+
+    virtual int getWFDLatencyRing() {
+        Parcel data, reply;
+        data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
+        int result = remote()->transact(GET_WFD_LATENCY_RING, data, &reply);
+        if (result == NO_ERROR) {
+            result = reply.readInt32();
+            if (result >= 0)
+                result = fcntl(reply.readFileDescriptor(), F_DUPFD_CLOEXEC, 0);
+        } else {
+            ALOGE("GET_WFD_LATENCY_RING transact error(%d)", result);
+        }
+        return result;
+    }
+
+    virtual int getFramePacingStats(int32_t displayId, uint32_t config,
+                                    std::vector<uint64_t> *slip, uint64_t *repeatedFrames) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
+        data.writeInt32(displayId);
+        data.writeUint32(config);
+        int result = remote()->transact(GET_FRAME_PACING_STATS, data, &reply);
+        if (result == NO_ERROR) {
+            result = reply.readInt32();
+            if (result == NO_ERROR) {
+                reply.readUint64Vector(slip);
+                *repeatedFrames = reply.readUint64();
+            }
+        } else {
+            ALOGE("GET_FRAME_PACING_STATS transact error(%d)", result);
+        }
+        return result;
+    }
+
+    virtual int getStatusPage() {
+        Parcel data, reply;
+        data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
+        int result = remote()->transact(GET_STATUS_PAGE, data, &reply);
+        if (result == NO_ERROR) {
+            result = reply.readInt32();
+            if (result >= 0)
+                result = fcntl(reply.readFileDescriptor(), F_DUPFD_CLOEXEC, 0);
+        } else {
+            ALOGE("GET_STATUS_PAGE transact error(%d)", result);
+        }
+        return result;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(ExynosHWCService, "android.hal.ExynosHWCService");
@@ -56,6 +56,11 @@ enum {
 
     GET_CPU_PERF_INFO = 109,
     SET_INTERFACE_DEBUG = 110,
+    GET_WFD_LATENCY_RING = 111,
+    DUMP_WFD_LATENCY = 112,
+    GET_FRAME_PACING_STATS = 113,
+    GET_STATUS_PAGE = 114,
+    NOTIFY_PSR_EXIT = 115,
 
     SET_DISPLAY_MULTI_THREADED_PRESENT = 1010,
 };
@@ -78,10 +83,28 @@ class IExynosHWCService : public IInterface {
     virtual void setBootFinished(void) = 0;
     virtual uint32_t getHWCDebug() = 0;
     virtual int getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *min_clock) = 0;
+    /*
+     * getWFDLatencyRing() returns a new fd of the WFD latency trace ring
+     * that is mapped by wfd_latency_ring_map(). The caller should close it.
+     */
+    virtual int getWFDLatencyRing() = 0;
+    /*
+     * getFramePacingStats() returns the histogram of the present-to-vsync
+     * slip in vsync periods and the repeated frames of the display config.
+     */
+    virtual int getFramePacingStats(int32_t displayId, uint32_t config,
+                                    std::vector<uint64_t> *slip, uint64_t *repeatedFrames) = 0;
+    /*
+     * getStatusPage() returns a new fd of the read-only HWC status page
+     * that is mapped by hwc_status_page_map(). The caller should close it.
+     */
+    virtual int getStatusPage() = 0;
 
     /*
+     * notifyPSRExit() is a hint of touch input. The displays exit the PSR
+     * and the hibernation ahead of the next frame. It doesn't wait for HWC.
+     */
     virtual void notifyPSRExit() = 0;
-    */
     virtual int32_t setDisplayMultiThreadedPresent(const int32_t& displayId,
                                                    const bool& enable) = 0;
 };
@@ -66,6 +66,8 @@ ExynosPrimaryDisplay::ExynosPrimaryDisplay(DisplayIdentifier node)
 
             if (mBrightnessOfs.fail())
                 ALOGE("%s open failed! %s", BRIGHTNESS_NODE_BASE, strerror(errno));
+            else
+                mBrightnessWorker = std::make_unique<ExynosWorkerPool>("hwc_brightness", 1);
         } else {
             ALOGE("Max brightness read failed! %s", strerror(errno));
         }
@@ -171,12 +173,15 @@ ExynosPrimaryDisplay::~ExynosPrimaryDisplay() {
     }
 
 #ifdef USE_DISPLAY_COLOR_INTERFACE
+    freeDisplayColorLuts();
     if (mDisplayColorCoefAddr)
         munmap(mDisplayColorCoefAddr, mDisplayColorCoefSize);
     if (mDisplayColorFd >= 0)
         close(mDisplayColorFd);
 #endif
 
+    /* The last brightness is written before the node is closed */
+    mBrightnessWorker.reset();
     if (mBrightnessOfs.is_open()) {
         mBrightnessOfs.close();
     }
@@ -197,19 +202,24 @@ int32_t ExynosPrimaryDisplay::setPowerMode(int32_t mode,
 
     switch (mode) {
     case HWC2_POWER_MODE_DOZE_SUSPEND:
-        return setPowerDoze(true);
-    case HWC2_POWER_MODE_DOZE:
-        return setPowerDoze(false);
+    case HWC2_POWER_MODE_DOZE: {
+        int32_t ret = setPowerDoze(mode == HWC2_POWER_MODE_DOZE_SUSPEND);
+        if (ret == HWC2_ERROR_NONE)
+            setLowPowerComposition(true, geometryFlag);
+        return ret;
+    }
     case HWC2_POWER_MODE_OFF:
         if (mUseDynamicRecomp && mDynamicRecompTimer)
             mDynamicRecompTimer->stop();
         setPowerOff();
+        setLowPowerComposition(false, geometryFlag);
         setGeometryChanged(GEOMETRY_DISPLAY_POWER_OFF, geometryFlag);
         break;
     case HWC2_POWER_MODE_ON:
         if (mUseDynamicRecomp && mDynamicRecompTimer)
             mDynamicRecompTimer->start();
         setPowerOn();
+        setLowPowerComposition(false, geometryFlag);
         setGeometryChanged(GEOMETRY_DISPLAY_POWER_ON, geometryFlag);
         break;
     default:
@@ -415,23 +425,12 @@ void ExynosPrimaryDisplay::checkLayersForSettingDR() {
      * 2. There is scaling layer
      * 3. Layer has plane alpha. (not 1.0)
      * 4. Layer needs color gamut change
+     * The layers are classified in the last validate
      */
-    for (size_t i = 0; i < mLayers.size(); i++) {
-        if (mLayers[i]->mLayerBuffer) {
-            exynos_image src, dst;
-            mLayers[i]->setSrcExynosImage(&src);
-            mLayers[i]->setDstExynosImage(&dst);
-
-            if (src.exynosFormat.isYUV() ||
-                (src.w != dst.w) || (src.h != dst.h) ||
-                (src.planeAlpha != 1.0f) ||
-                ((mColorMode != HAL_COLOR_MODE_NATIVE) &&
-                 (src.dataSpace != dst.dataSpace))) {
-                mDynamicRecompMode = CLIENT_TO_DEVICE;
-                DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] CLIENT_TO_DEVICE by specific condition layer");
-                return;
-            }
-        }
+    if (mLayerSummary.dynamicRecompBlockingLayerNum) {
+        mDynamicRecompMode = CLIENT_TO_DEVICE;
+        DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] CLIENT_TO_DEVICE by specific condition layer");
+        return;
     }
     DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] DEVICE_TO_CLIENT is set");
     mDynamicRecompMode = DEVICE_TO_CLIENT;
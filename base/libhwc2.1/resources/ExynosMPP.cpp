@@ -23,6 +23,7 @@
 #include <sys/mman.h>
 #include <cutils/properties.h>
 #include "ExynosMPP.h"
+#include "ExynosMPPBufferPool.h"
 #include "ExynosResourceRestriction.h"
 #include <hardware/hwcomposer_defs.h>
 #include <math.h>
@@ -105,6 +106,8 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
       mAssignedState(MPP_ASSIGN_STATE_FREE),
       mEnableByDebug(true),
       mDisableByUserScenario(0),
+      mPowerGated(false),
+      mUnusedFrameCnt(0),
       mMaxSrcLayerNum(1),
       mPrevAssignedState(MPP_ASSIGN_STATE_FREE),
       mPrevAssignedDisplayType(-1),
@@ -115,6 +118,8 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
       mFreeOutBufFlag(true),
       mHWBusyFlag(false),
       mWasUsedPrevFrame(false),
+      mDstBufNum(NUM_MPP_DST_BUFS(logicalType)),
+      mDstBufDepth(NUM_MPP_DST_BUFS(logicalType)),
       mCurrentDstBuf(0),
       mPrivDstBuf(-1),
       mTargetCompressionInfo({COMP_TYPE_NONE, 0, 0}),
@@ -206,7 +211,7 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
     for (uint32_t i = 0; i < NUM_MPP_SRC_BUFS; i++) {
         mSrcImgs[i].reset();
     }
-    for (uint32_t i = 0; i < NUM_MPP_DST_BUFS(mLogicalType); i++) {
+    for (uint32_t i = 0; i < NUM_MPP_DST_BUFS_MAX; i++) {
         mDstImgs[i].reset();
     }
 
@@ -230,6 +235,8 @@ ExynosMPP::~ExynosMPP() {
     }
     if (mLutParcelFd >= 0)
         close(mLutParcelFd);
+    if (mPPCSample.fence >= 0)
+        close(mPPCSample.fence);
 }
 
 ExynosMPP::ResourceManageThread::ResourceManageThread(ExynosMPP *exynosMPP)
@@ -398,6 +405,13 @@ bool ExynosMPP::isSupportedCompression(struct exynos_image &src) {
     return true;
 }
 
+bool ExynosMPP::isSupportedDstCompression(struct exynos_image &dst) {
+    if (mMPPType == MPP_TYPE_OTF)
+        return true;
+
+    return isSupportedCompression(dst);
+}
+
 bool ExynosMPP::isSharedMPPUsed() {
     /* Implement it to module */
     return false;
@@ -465,25 +479,11 @@ bool ExynosMPP::isSrcFormatSupported(struct exynos_image &src) {
         return false;
     }
 
-    for (uint32_t i = 0; i < mFormatRestrictions.size(); i++) {
-        if (((mFormatRestrictions[i].nodeType == NODE_NONE) ||
-             (mFormatRestrictions[i].nodeType == NODE_SRC)) &&
-            (mFormatRestrictions[i].format == src.exynosFormat.halFormat()))
-            return true;
-    }
-
-    return false;
+    return hasFormatRestriction(src.exynosFormat.halFormat(), NODE_SRC);
 }
 
 bool ExynosMPP::isDstFormatSupported(struct exynos_image &dst) {
-    for (uint32_t i = 0; i < mFormatRestrictions.size(); i++) {
-        if (((mFormatRestrictions[i].nodeType == NODE_NONE) ||
-             (mFormatRestrictions[i].nodeType == NODE_DST)) &&
-            (mFormatRestrictions[i].format == dst.exynosFormat.halFormat()))
-            return true;
-    }
-
-    return false;
+    return hasFormatRestriction(dst.exynosFormat.halFormat(), NODE_DST);
 }
 
 uint32_t ExynosMPP::getMaxUpscale(struct exynos_image &src, struct exynos_image __unused &dst) {
@@ -773,6 +773,7 @@ void ExynosMPP::ResourceManageThread::threadLoop() {
     if (mExynosMPP == NULL)
         return;
 
+    setHelperThreadProfile();
     ALOGI("%s threadLoop is started", mExynosMPP->mName.string());
     while (mRunning) {
         Mutex::Autolock lock(mMutex);
@@ -892,7 +893,7 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
 
     MPP_LOGD(eDebugMPP | eDebugBuf, "index: %d++++++++", index);
 
-    if (index >= NUM_MPP_DST_BUFS(mLogicalType)) {
+    if (index >= NUM_MPP_DST_BUFS_MAX) {
         return -EINVAL;
     }
 
@@ -908,8 +909,13 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
 
     status_t error = NO_ERROR;
     ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    ExynosMPPBufferPool &bufferPool(ExynosMPPBufferPool::getInstance());
 
-    {
+    /* Reuse freed buffer of the same size class if there is */
+    int pooledFence = -1;
+    bool pooled = bufferPool.take(w, h, format, allocUsage, dstBuffer, pooledFence);
+
+    if (!pooled) {
         ATRACE_CALL();
         error = gAllocator.allocate(w, h, format, 1, allocUsage, &dstBuffer, &dstStride, "HWC");
     }
@@ -937,6 +943,7 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
                                                  FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
                                                  "mpp::freeBuffers: acrylicReleaseFence");
                 }
+                bufferPool.untrack(freeDstBuf.bufferHandle);
                 gAllocator.free(freeDstBuf.bufferHandle);
                 freeDstBuf.reset();
                 freeBuffer = true;
@@ -955,10 +962,15 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
         }
     }
 
+    if (!pooled)
+        bufferPool.track(dstBuffer, w, h, format, allocUsage);
+
     mDstImgs[index].reset();
     mDstImgs[index].bufferHandle = dstBuffer;
     mDstImgs[index].bufferType = getBufferType(usage);
     mDstImgs[index].format = format;
+    /* Previous user of pooled buffer can be still using it */
+    mDstImgs[index].acrylicReleaseFenceFd = pooledFence;
 
     if (!freeBuffer) {
         MPP_LOGD(eDebugMPP | eDebugBuf, "free outbuf[%d] %p", index, freeDstBuf.bufferHandle);
@@ -1006,7 +1018,40 @@ int32_t ExynosMPP::setOutBuf(buffer_handle_t outbuf, int32_t fence,
 int32_t ExynosMPP::freeOutBuf(struct exynos_mpp_img_info dst) {
     if (mBufDestoryedCallback)
         mBufDestoryedCallback(ExynosGraphicBufferMeta::get_buffer_id(dst.bufferHandle));
-    mResourceManageThread.addFreedBuffer(dst);
+
+    /*
+     * Buffer can be reused after both of M2M job and DPU are done with it,
+     * the fence is waited by next M2M job that writes the pooled buffer.
+     */
+    int fence = -1;
+    if (mFenceTracer.fence_valid(dst.acrylicAcquireFenceFd) &&
+        mFenceTracer.fence_valid(dst.acrylicReleaseFenceFd)) {
+        fence = sync_merge("hwc_mpp_pool", dst.acrylicAcquireFenceFd,
+                           dst.acrylicReleaseFenceFd);
+        if (fence < 0) {
+            ExynosMPPBufferPool::getInstance().untrack(dst.bufferHandle);
+            mResourceManageThread.addFreedBuffer(dst);
+            return NO_ERROR;
+        }
+        dst.acrylicAcquireFenceFd = mFenceTracer.fence_close(dst.acrylicAcquireFenceFd,
+                                                             mAssignedDisplayInfo.displayIdentifier,
+                                                             FENCE_TYPE_DST_ACQUIRE, FENCE_IP_ALL,
+                                                             "mpp::freeOutBuf: acrylicAcquireFence");
+        dst.acrylicReleaseFenceFd = mFenceTracer.fence_close(dst.acrylicReleaseFenceFd,
+                                                             mAssignedDisplayInfo.displayIdentifier,
+                                                             FENCE_TYPE_DST_RELEASE, FENCE_IP_ALL,
+                                                             "mpp::freeOutBuf: acrylicReleaseFence");
+    } else if (mFenceTracer.fence_valid(dst.acrylicAcquireFenceFd)) {
+        fence = dst.acrylicAcquireFenceFd;
+    } else if (mFenceTracer.fence_valid(dst.acrylicReleaseFenceFd)) {
+        fence = dst.acrylicReleaseFenceFd;
+    }
+
+    std::vector<exynos_mpp_img_info> freeBuffers;
+    ExynosMPPBufferPool::getInstance().put(dst.bufferHandle, fence, freeBuffers);
+    for (auto &freeBuffer : freeBuffers)
+        mResourceManageThread.addFreedBuffer(freeBuffer);
+
     dst.bufferHandle = NULL;
     return NO_ERROR;
 }
@@ -1087,7 +1132,7 @@ uint64_t ExynosMPP::getBufferUsage(uint64_t usage) {
 bool ExynosMPP::needDstBufRealloc(struct exynos_image &dst, uint32_t index) {
     MPP_LOGD(eDebugMPP | eDebugBuf, "index: %d++++++++", index);
 
-    if (index >= NUM_MPP_DST_BUFS(mLogicalType)) {
+    if (index >= NUM_MPP_DST_BUFS_MAX) {
         MPP_LOGE("%s:: index(%d) is not valid", __func__, index);
         return false;
     }
@@ -1166,7 +1211,7 @@ bool ExynosMPP::canUsePrevFrame(struct exynos_image &src) {
             return false;
     }
 
-    int32_t prevDstIndex = (mCurrentDstBuf + NUM_MPP_DST_BUFS(mLogicalType) - 1) % NUM_MPP_DST_BUFS(mLogicalType);
+    int32_t prevDstIndex = (mCurrentDstBuf + mDstBufNum - 1) % mDstBufNum;
     if (mDstImgs[prevDstIndex].bufferHandle == NULL)
         return false;
 
@@ -1377,7 +1422,6 @@ dstMetaInfo_t ExynosMPP::getDstMetaInfo(android_dataspace_t dstDataspace) {
 
 int32_t ExynosMPP::setupDst(exynos_mpp_img_info *dstImgInfo) {
     int ret = NO_ERROR;
-    bool isComposition = (mMaxSrcLayerNum > 1);
     buffer_handle_t dstHandle = dstImgInfo->bufferHandle;
     int bufFds[MAX_HW2D_PLANES];
     size_t bufLength[MAX_HW2D_PLANES];
@@ -1416,10 +1460,14 @@ int32_t ExynosMPP::setupDst(exynos_mpp_img_info *dstImgInfo) {
     }
 
     /* setup dst */
-    if (isComposition && (isAFBCCompressed(dstHandle)) &&
-        mCurrentTargetCompressionInfoType == COMP_TYPE_AFBC)
+    if (isAFBCCompressed(dstHandle) && (mCurrentTargetCompressionInfoType == COMP_TYPE_AFBC))
         attribute |= AcrylicCanvas::ATTR_COMPRESSED;
 
+    /* M2M waits for the DPU to release the buffer if the ring is too short */
+    if (exynosHWCControl.adaptiveDstBuf && mAllocOutBufFlag &&
+        mFenceTracer.fence_valid(dstImgInfo->acrylicReleaseFenceFd))
+        updateDstBufDepth(getFenceSignalTime(dstImgInfo->acrylicReleaseFenceFd) < 0);
+
     mFenceTracer.setFenceInfo(dstImgInfo->acrylicReleaseFenceFd,
                               mAssignedDisplayInfo.displayIdentifier, FENCE_TYPE_DST_RELEASE, mFenceTracer.getM2MIPFenceType(mPhysicalType), FENCE_TO);
 
@@ -1483,6 +1531,9 @@ int32_t ExynosMPP::doPostProcessingInternal() {
         return -EINVAL;
     }
 
+    /* Previous job should be done, update ppc with its duration */
+    updatePPCCalibration();
+
     /* setup source layers */
     for (size_t i = 0; i < sourceNum; i++) {
         MPP_LOGD(eDebugMPP, "Setup [%zu] source: %p", i, mAssignedSources[i]);
@@ -1534,6 +1585,13 @@ int32_t ExynosMPP::doPostProcessingInternal() {
             delete[] outFences;
     });
 
+    /* Job can be measured only if H/W doesn't wait for the source */
+    bool measurePPC = (exynosHWCControl.ppcModel == PPC_MODEL_CALIBRATE) &&
+                      (sourceNum == 1) &&
+                      ((mSrcImgs[0].acrylicAcquireFenceFd < 0) ||
+                       (getFenceSignalTime(mSrcImgs[0].acrylicAcquireFenceFd) >= 0));
+    nsecs_t submitTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
     {
         ATRACE_CALL();
         acrylicReturn = mAcrylicHandle->execute(outFences, usingFenceCnt);
@@ -1573,6 +1631,9 @@ int32_t ExynosMPP::doPostProcessingInternal() {
         }
     }
 
+    if (measurePPC && (usingFenceCnt != 0))
+        preparePPCSample(outFences[dstBufIdx], submitTime);
+
     if ((mAssignedDisplayInfo.displayIdentifier.id != UINT32_MAX) &&
         (mAssignedDisplayInfo.displayIdentifier.type == HWC_DISPLAY_VIRTUAL) &&
         (!mAssignedDisplayInfo.useDpu) &&
@@ -1746,7 +1807,7 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image &src, struct exynos_imag
     }
 
     if ((realloc == false) && canUsePrevFrame(src)) {
-        mCurrentDstBuf = (mCurrentDstBuf + NUM_MPP_DST_BUFS(mLogicalType) - 1) % NUM_MPP_DST_BUFS(mLogicalType);
+        mCurrentDstBuf = (mCurrentDstBuf + mDstBufNum - 1) % mDstBufNum;
         MPP_LOGD(eDebugMPP, "Reuse previous frame, dstImg[%d]", mCurrentDstBuf);
         for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
             mAssignedSources[i]->mSrcImg.acquireFenceFd =
@@ -1794,7 +1855,7 @@ int32_t ExynosMPP::resetSrcReleaseFence() {
 }
 
 int32_t ExynosMPP::getDstImageInfo(exynos_image *img) {
-    if ((mCurrentDstBuf < 0) || (mCurrentDstBuf >= NUM_MPP_DST_BUFS(mLogicalType)) ||
+    if ((mCurrentDstBuf < 0) || (mCurrentDstBuf >= NUM_MPP_DST_BUFS_MAX) ||
         (mAssignedDisplayInfo.displayIdentifier.id == UINT32_MAX)) {
         MPP_LOGE("mCurrentDstBuf(%d), mAssignedDisplay(0x%8x)",
                  mCurrentDstBuf, mAssignedDisplayInfo.displayIdentifier.id);
@@ -1856,7 +1917,7 @@ int32_t ExynosMPP::setDstReleaseFence(int releaseFence, DisplayInfo &display) {
     if (mAssignedDisplayInfo.displayIdentifier.id == UINT32_MAX)
         mAssignedDisplayInfo = display;
 
-    if (dstBufIndex < 0 || dstBufIndex >= NUM_MPP_DST_BUFS(mLogicalType)) {
+    if (dstBufIndex < 0 || dstBufIndex >= NUM_MPP_DST_BUFS_MAX) {
         releaseFence = mFenceTracer.fence_close(releaseFence,
                                                 mAssignedDisplayInfo.displayIdentifier,
                                                 FENCE_TYPE_DST_RELEASE, FENCE_IP_ALL,
@@ -1882,7 +1943,7 @@ int32_t ExynosMPP::setDstReleaseFence(int releaseFence, DisplayInfo &display) {
 }
 
 int32_t ExynosMPP::resetDstAcquireFence() {
-    if (mCurrentDstBuf < 0 || mCurrentDstBuf >= NUM_MPP_DST_BUFS(mLogicalType))
+    if (mCurrentDstBuf < 0 || mCurrentDstBuf >= NUM_MPP_DST_BUFS_MAX)
         return -EINVAL;
 
     mDstImgs[mCurrentDstBuf].acrylicAcquireFenceFd = -1;
@@ -1924,7 +1985,7 @@ int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
 
         /* Free all of output buffers */
         if (mMPPType == MPP_TYPE_M2M) {
-            for (uint32_t i = 0; i < NUM_MPP_DST_BUFS(mLogicalType); i++) {
+            for (uint32_t i = 0; i < NUM_MPP_DST_BUFS_MAX; i++) {
                 exynos_mpp_img_info freeDstBuf = mDstImgs[i];
                 mDstImgs[i].reset();
                 mDstImgs[i].acrylicAcquireFenceFd = freeDstBuf.acrylicAcquireFenceFd;
@@ -2064,54 +2125,156 @@ int64_t ExynosMPP::checkScaleRatio(DisplayInfo &display, exynos_image &src,
     return NO_ERROR;
 }
 
+static void makeSupportedMemoKey(std::array<uint32_t, ExynosMPP::kSupportedMemoKeySize> &key,
+                                 uint32_t preAssignDisplayInfo, DisplayInfo &display,
+                                 struct exynos_image &src, struct exynos_image &dst) {
+    uint32_t i = 0;
+    key.fill(0);
+
+    key[i++] = preAssignDisplayInfo;
+    key[i++] = display.displayIdentifier.id;
+    key[i++] = display.displayIdentifier.type;
+    key[i++] = display.xres;
+    key[i++] = display.yres;
+    key[i++] = display.workingVsyncPeriod;
+    key[i++] = (uint32_t)display.colorMode;
+    key[i++] = (uint32_t)display.isWFDState;
+    key[i++] = (display.hdrLayersIndex.size() ? 1 : 0) |
+               (display.drmLayersIndex.size() ? 2 : 0) |
+               (display.useDpu ? 4 : 0) |
+               (display.skipM2mProcessing ? 8 : 0);
+
+    key[i++] = src.fullWidth;
+    key[i++] = src.fullHeight;
+    key[i++] = src.x;
+    key[i++] = src.y;
+    key[i++] = src.w;
+    key[i++] = src.h;
+    key[i++] = src.exynosFormat.halFormat();
+    key[i++] = (uint32_t)src.dataSpace;
+    key[i++] = src.blending;
+    key[i++] = src.transform;
+    key[i++] = src.compressionInfo.type;
+    key[i++] = (uint32_t)src.metaType;
+    key[i++] = getDrmMode(src.usageFlags) |
+               ((src.layerFlags & EXYNOS_HWC_DIM_LAYER) ? 0x100 : 0) |
+               (src.needColorTransform ? 0x200 : 0);
+
+    key[i++] = dst.x;
+    key[i++] = dst.y;
+    key[i++] = dst.w;
+    key[i++] = dst.h;
+    key[i++] = dst.exynosFormat.halFormat();
+    key[i++] = (uint32_t)dst.dataSpace;
+    key[i++] = dst.transform;
+    key[i++] = dst.compressionInfo.type;
+}
+
+static uint32_t hashSupportedMemoKey(const std::array<uint32_t, ExynosMPP::kSupportedMemoKeySize> &key) {
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    for (auto value : key) {
+        hash ^= value;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void ExynosMPP::invalidateSupportedMemo() {
+    Mutex::Autolock lock(mSupportedMemoMutex);
+    for (auto &entry : mSupportedMemo)
+        entry.valid = false;
+}
+
+int64_t ExynosMPP::prefetchSupported(DisplayInfo &display, struct exynos_image &src,
+                                     struct exynos_image &dst) {
+    if (!isSupportedMemoizable())
+        return NO_ERROR;
+
+    std::array<uint32_t, kSupportedMemoKeySize> key;
+    makeSupportedMemoKey(key, mPreAssignDisplayInfo, display, src, dst);
+    SupportedMemoEntry &entry = mSupportedMemo[hashSupportedMemoKey(key) % kSupportedMemoSize];
+
+    {
+        Mutex::Autolock lock(mSupportedMemoMutex);
+        if (entry.valid && (entry.key == key))
+            return (entry.dstResult < 0) ? entry.dstResult : entry.result;
+    }
+
+    int64_t dstResult = checkDstSize(dst);
+    int64_t result = isSupportedInternal(display, src, dst);
+
+    Mutex::Autolock lock(mSupportedMemoMutex);
+    entry.key = key;
+    entry.dstResult = dstResult;
+    entry.result = result;
+    entry.valid = true;
+
+    return (dstResult < 0) ? dstResult : result;
+}
+
 int64_t ExynosMPP::isSupported(DisplayInfo &display, struct exynos_image &src, struct exynos_image &dst) {
-    int32_t ret = NO_ERROR;
+    int64_t dstResult = NO_ERROR;
+    int64_t result = NO_ERROR;
 
-    if ((ret = checkDstSize(dst)) < 0)
-        return ret;
+    if (!isSupportedMemoizable()) {
+        if ((dstResult = checkDstSize(dst)) < 0)
+            return countSupportedResult(dstResult);
+        /* for virtual 8K MPP */
+        if (isSharedMPPUsed())
+            return countSupportedResult(-eMPPConflictSharedMPP);
+        return countSupportedResult(isSupportedInternal(display, src, dst));
+    }
 
-    /* for virtual 8K MPP */
-    if (isSharedMPPUsed())
-        return -eMPPConflictSharedMPP;
+    std::array<uint32_t, kSupportedMemoKeySize> key;
+    makeSupportedMemoKey(key, mPreAssignDisplayInfo, display, src, dst);
+    SupportedMemoEntry &entry = mSupportedMemo[hashSupportedMemoKey(key) % kSupportedMemoSize];
 
-    if (src.isDimLayer())  // Dim layer
+    bool found = false;
     {
-        return isDimLayerSupported();
-    }
-
-    if (!isSupportedCapability(display, src))
-        return -eMPPSaveCapability;
-    if (!isSrcFormatSupported(src))
-        return -eMPPUnsupportedFormat;
-    if (!isDstFormatSupported(dst))
-        return -eMPPUnsupportedFormat;
-    if (!isDataspaceSupportedByMPP(src, dst))
-        return -eMPPUnsupportedCSC;
-    if (!isSupportedHDR10Plus(src, dst))
-        return -eMPPUnsupportedDynamicMeta;
-    if (!isSupportedBlend(src))
-        return -eMPPUnsupportedBlending;
-    if (!isSupportedTransform(src))
-        return -eMPPUnsupportedRotation;
-    if ((ret = checkUnResizableSrcSize(src)) < 0)
-        return ret;
-    if (!isSupportedDRM(src))
-        return -eMPPUnsupportedDRM;
-    if ((getDrmMode(src.usageFlags) == NO_DRM) &&
-        ((ret = checkResizableSrcSize(src)) < 0))
-        return ret;
-    if ((ret = checkScaleRatio(display, src, dst)) < 0)
-        return ret;
-    if (!isSupportedHStrideCrop(src))
-        return -eMPPStrideCrop;
+        Mutex::Autolock lock(mSupportedMemoMutex);
+        if (entry.valid && (entry.key == key)) {
+            dstResult = entry.dstResult;
+            result = entry.result;
+            mSupportedMemoHit++;
+            found = true;
+        } else {
+            mSupportedMemoMiss++;
+        }
+    }
 
-    if (!isSupportedCompression(src))
-        return -eMPPUnsupportedCompression;
+    if (!found) {
+        dstResult = checkDstSize(dst);
+        result = isSupportedInternal(display, src, dst);
 
-    if (!isSupportLayerColorTransform(src, dst))
-        return -eMPPUnsupportedColorTransform;
+        Mutex::Autolock lock(mSupportedMemoMutex);
+        entry.key = key;
+        entry.dstResult = dstResult;
+        entry.result = result;
+        entry.valid = true;
+    }
 
-    return NO_ERROR;
+    if (dstResult < 0)
+        return countSupportedResult(dstResult);
+
+    /* for virtual 8K MPP, it depends on assigned state so it is not memoized */
+    if (isSharedMPPUsed())
+        return countSupportedResult(-eMPPConflictSharedMPP);
+
+    return countSupportedResult(result);
+}
+
+int64_t ExynosMPP::countSupportedResult(int64_t result) {
+    if (result >= 0)
+        return result;
+
+    uint64_t errors = static_cast<uint64_t>(-result);
+    for (uint32_t i = 0; i < MPP_REJECT_TYPE_NUM; i++) {
+        if (errors & (1ULL << i))
+            mRejectCount[i].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return result;
 }
 
 int32_t ExynosMPP::resetMPP() {
@@ -2413,11 +2576,34 @@ float ExynosMPP::getPPC(const struct exynos_image &src,
 
     if (mPhysicalType == MPP_G2D || mPhysicalType == MPP_MSC) {
         if (hasPPC(mPhysicalType, formatIndex, rotIndex)) {
-            auto node = ppc_table_map.find(PPC_IDX(mPhysicalType, formatIndex, rotIndex));
+            uint32_t ppcIndex = PPC_IDX(mPhysicalType, formatIndex, rotIndex);
+            auto node = ppc_table_map.find(ppcIndex);
             if (node != ppc_table_map.end())
                 PPC = node->second.ppcList[scaleIndex];
             else
                 PPC = 0.0;
+
+            if ((PPC != 0) && (exynosHWCControl.ppcModel != PPC_MODEL_TABLE)) {
+                float ppcList[PPC_SCALE_MAX];
+                memcpy(ppcList, node->second.ppcList, sizeof(ppcList));
+
+                if (exynosHWCControl.ppcModel == PPC_MODEL_CALIBRATE) {
+                    Mutex::Autolock lock(mPPCCalibrationMutex);
+                    auto calib = mPPCCalibration.find(ppcIndex);
+                    if (calib != mPPCCalibration.end()) {
+                        for (uint32_t i = 0; i < PPC_SCALE_MAX; i++) {
+                            if (calib->second.samples[i] >= PPC_CALIB_MIN_SAMPLES)
+                                ppcList[i] = calib->second.ppcList[i];
+                        }
+                    }
+                }
+
+                if ((mPhysicalType == MPP_G2D) && (src.w * src.h != 0))
+                    PPC = getInterpolatedPPC(ppcList, scaleIndex,
+                                             (float)(dst.w * dst.h) / (float)(src.w * src.h));
+                else
+                    PPC = ppcList[scaleIndex];
+            }
         }
     }
 
@@ -2434,6 +2620,189 @@ float ExynosMPP::getPPC(const struct exynos_image &src,
     return PPC;
 }
 
+/*
+ * dst/src resolution ratio that represents each scale bucket
+ * in ascending order. PPC_SCALE_NO is not an anchor because
+ * the scaler is not used at all in that case.
+ */
+static const struct {
+    uint32_t scaleIndex;
+    float ratio;
+} ppcScaleAnchors[] = {
+    {PPC_SCALE_DOWN_16_, 1.0f / 16},
+    {PPC_SCALE_DOWN_9_16, 1.0f / 12},
+    {PPC_SCALE_DOWN_4_9, 1.0f / 6},
+    {PPC_SCALE_DOWN_1_4, 1.0f / 2},
+    {PPC_SCALE_UP_1_4, 2.0f},
+    {PPC_SCALE_UP_4_, 4.0f},
+};
+
+float ExynosMPP::getInterpolatedPPC(const float ppcList[PPC_SCALE_MAX],
+                                    uint32_t scaleIndex, float scaleRatio) {
+    const size_t anchorNum = sizeof(ppcScaleAnchors) / sizeof(ppcScaleAnchors[0]);
+
+    if ((scaleIndex == PPC_SCALE_NO) || (scaleRatio <= 0))
+        return ppcList[scaleIndex];
+
+    for (size_t i = 0; i + 1 < anchorNum; i++) {
+        const auto &low = ppcScaleAnchors[i];
+        const auto &high = ppcScaleAnchors[i + 1];
+
+        if ((scaleRatio < low.ratio) || (scaleRatio > high.ratio))
+            continue;
+        /* Don't interpolate between scale down and scale up */
+        if ((low.ratio < 1.0f) && (high.ratio > 1.0f))
+            break;
+
+        float lowPPC = ppcList[low.scaleIndex];
+        float highPPC = ppcList[high.scaleIndex];
+        if ((lowPPC <= 0) || (highPPC <= 0))
+            break;
+
+        float weight = (log2f(scaleRatio) - log2f(low.ratio)) /
+                       (log2f(high.ratio) - log2f(low.ratio));
+        return lowPPC + (highPPC - lowPPC) * weight;
+    }
+
+    /* Out of anchors, use value of the bucket */
+    return ppcList[scaleIndex];
+}
+
+void ExynosMPP::preparePPCSample(int dstFence, nsecs_t submitTime) {
+    if ((dstFence < 0) || (mPPCSample.fence >= 0) ||
+        (mAssignedSources.size() != 1))
+        return;
+
+    struct exynos_image &src = mAssignedSources[0]->mSrcImg;
+    struct exynos_image &dst = mAssignedSources[0]->mMidImg;
+
+    /* Capacity of these layers is not calculated with ppc */
+    if ((src.layerFlags & EXYNOS_HWC_DIM_LAYER) || hasHdrInfo(src) ||
+        (getDrmMode(src.usageFlags) != NO_DRM))
+        return;
+
+    uint32_t formatIndex = 0;
+    uint32_t rotIndex = 0;
+    uint32_t scaleIndex = 0;
+    getPPCIndex(src, dst, formatIndex, rotIndex, scaleIndex, src);
+
+    uint32_t ppcIndex = PPC_IDX(mPhysicalType, formatIndex, rotIndex);
+    auto node = ppc_table_map.find(ppcIndex);
+    if ((node == ppc_table_map.end()) || (node->second.ppcList[scaleIndex] <= 0))
+        return;
+
+    mPPCSample.fence = dup(dstFence);
+    if (mPPCSample.fence < 0)
+        return;
+
+    mPPCSample.submitTime = submitTime;
+    mPPCSample.ppcIndex = ppcIndex;
+    mPPCSample.scaleIndex = scaleIndex;
+    mPPCSample.tablePPC = node->second.ppcList[scaleIndex];
+    mPPCSample.pixels = max(src.w * src.h, dst.w * dst.h);
+    mPPCSample.baseCycles = 0;
+    if ((mPhysicalType == MPP_G2D) && (mMaxSrcLayerNum > 1))
+        mPPCSample.baseCycles = (mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) /
+                                G2D_BASE_PPC_COLORFILL;
+}
+
+void ExynosMPP::updatePPCCalibration() {
+    if (mPPCSample.fence < 0)
+        return;
+
+    ppc_sample_t sample = mPPCSample;
+    nsecs_t signalTime = getFenceSignalTime(sample.fence);
+    close(sample.fence);
+    mPPCSample = {};
+
+    /* Not signaled yet, skip this sample */
+    if (signalTime <= sample.submitTime)
+        return;
+
+    /* getMPPClock() is kHz, capacity is ms */
+    float durationMs = (float)(signalTime - sample.submitTime) / 1000000.0f;
+    float cycles = durationMs * getMPPClock() - sample.baseCycles;
+    if (cycles <= 0)
+        return;
+
+    float measuredPPC = sample.pixels / cycles;
+    /* Reject outliers such as the job was preempted */
+    if ((measuredPPC < sample.tablePPC / 4) || (measuredPPC > sample.tablePPC * 4))
+        return;
+
+    if (!mPPCCalibrationLoaded)
+        loadPPCCalibration();
+
+    {
+        Mutex::Autolock lock(mPPCCalibrationMutex);
+        ppc_calibration_t &calib = mPPCCalibration[sample.ppcIndex];
+        uint32_t i = sample.scaleIndex;
+        if (calib.samples[i] == 0)
+            calib.ppcList[i] = measuredPPC;
+        else
+            calib.ppcList[i] += (measuredPPC - calib.ppcList[i]) / 8;
+        if (calib.samples[i] < UINT32_MAX)
+            calib.samples[i]++;
+
+        MPP_LOGD(eDebugCapacity, "ppc calibration idx(0x%x), scale(%d), table(%f), measured(%f), learned(%f), samples(%d)",
+                 sample.ppcIndex, i, sample.tablePPC, measuredPPC,
+                 calib.ppcList[i], calib.samples[i]);
+    }
+
+    if (++mPPCNewSamples >= PPC_CALIB_SAVE_INTERVAL) {
+        savePPCCalibration();
+        mPPCNewSamples = 0;
+    }
+}
+
+void ExynosMPP::loadPPCCalibration() {
+    mPPCCalibrationLoaded = true;
+
+    String8 path;
+    path.appendFormat(MPP_PPC_CALIB_PATH, mName.string());
+    FILE *fp = fopen(path.string(), "r");
+    if (fp == nullptr)
+        return;
+
+    Mutex::Autolock lock(mPPCCalibrationMutex);
+    uint32_t ppcIndex = 0;
+    uint32_t scaleIndex = 0;
+    float ppc = 0;
+    uint32_t samples = 0;
+    while (fscanf(fp, "%u %u %f %u", &ppcIndex, &scaleIndex, &ppc, &samples) == 4) {
+        if ((scaleIndex >= PPC_SCALE_MAX) || (ppc <= 0) ||
+            (ppc_table_map.find(ppcIndex) == ppc_table_map.end()))
+            continue;
+        mPPCCalibration[ppcIndex].ppcList[scaleIndex] = ppc;
+        mPPCCalibration[ppcIndex].samples[scaleIndex] = samples;
+    }
+    fclose(fp);
+
+    MPP_LOGI("%s:: %zu ppc calibration entries are loaded", __func__,
+             mPPCCalibration.size());
+}
+
+void ExynosMPP::savePPCCalibration() {
+    String8 path;
+    path.appendFormat(MPP_PPC_CALIB_PATH, mName.string());
+    FILE *fp = fopen(path.string(), "w");
+    if (fp == nullptr) {
+        MPP_LOGE("%s:: open fail %s", __func__, strerror(errno));
+        return;
+    }
+
+    Mutex::Autolock lock(mPPCCalibrationMutex);
+    for (auto &it : mPPCCalibration) {
+        for (uint32_t i = 0; i < PPC_SCALE_MAX; i++) {
+            if (it.second.samples[i] == 0)
+                continue;
+            fprintf(fp, "%u %u %f %u\n", it.first, i,
+                    it.second.ppcList[i], it.second.samples[i]);
+        }
+    }
+    fclose(fp);
+}
+
 float ExynosMPP::getAssignedCapacity() {
     float capacity = 0;
     float baseCycles = 0;
@@ -2790,9 +3159,72 @@ int ExynosMPP::prioritize(int priority) {
     return ret;
 }
 
+void ExynosMPP::updateDstBufDepth(bool waited) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (waited) {
+        mDstBufWaitCnt++;
+        mLastDstBufWaitTime = now;
+        if (mDstBufDepth < NUM_MPP_DST_BUFS_MAX) {
+            mDstBufDepth++;
+            MPP_LOGD(eDebugMPP | eDebugBuf, "dst buffer wait, depth -> %d", mDstBufDepth);
+        }
+    } else if ((mDstBufDepth > NUM_MPP_DST_BUFS_MIN) &&
+               ((now - mLastDstBufWaitTime) > MPP_DST_BUF_SHRINK_PERIOD)) {
+        /* Restart the period so that one buffer is freed in a period */
+        mLastDstBufWaitTime = now;
+        mDstBufDepth--;
+        MPP_LOGD(eDebugMPP | eDebugBuf, "no dst buffer wait, depth -> %d", mDstBufDepth);
+    }
+}
+
+void ExynosMPP::updateDstBufNum() {
+    uint32_t dstBufNum = NUM_MPP_DST_BUFS(mLogicalType);
+
+    /* The buffers allocated on demand follow the measured depth */
+    if (exynosHWCControl.adaptiveDstBuf && (mMPPType == MPP_TYPE_M2M) && mFreeOutBufFlag)
+        dstBufNum = mDstBufDepth;
+
+    /* Pre-allocated buffers are not changed */
+    if (exynosHWCControl.m2mPipeline && (mMPPType == MPP_TYPE_M2M) &&
+        mFreeOutBufFlag)
+        dstBufNum = max(dstBufNum, (uint32_t)NUM_MPP_DST_BUFS_MAX);
+
+    if (dstBufNum == mDstBufNum)
+        return;
+
+    /*
+     * Buffers can be added at any time but it should be reduced
+     * when index wraps around, buffers of higher index are still
+     * in flight and they are freed with other buffers later.
+     */
+    if ((dstBufNum < mDstBufNum) &&
+        ((uint32_t)(mCurrentDstBuf + 1) < dstBufNum))
+        return;
+
+    MPP_LOGD(eDebugMPP | eDebugBuf, "dst buffer number %d -> %d",
+             mDstBufNum, dstBufNum);
+    if (dstBufNum < mDstBufNum) {
+        mCurrentDstBuf = dstBufNum - 1;
+        /* Previous dst buffer is out of range, don't reuse it */
+        mPrevFrameInfo.srcNum = 0;
+        /* The buffers out of range are freed after the jobs and the DPU are done */
+        for (uint32_t i = dstBufNum; mFreeOutBufFlag && (i < mDstBufNum); i++) {
+            if (mDstImgs[i].bufferHandle == NULL)
+                continue;
+            exynos_mpp_img_info freeDstBuf = mDstImgs[i];
+            mDstImgs[i].reset();
+            freeOutBuf(freeDstBuf);
+        }
+    }
+    mDstBufNum = dstBufNum;
+}
+
 uint32_t ExynosMPP::increaseDstBuffIndex() {
-    if (mAllocOutBufFlag)
-        mCurrentDstBuf = (mCurrentDstBuf + 1) % NUM_MPP_DST_BUFS(mLogicalType);
+    if (mAllocOutBufFlag) {
+        updateDstBufNum();
+        mCurrentDstBuf = (mCurrentDstBuf + 1) % mDstBufNum;
+    }
     return mCurrentDstBuf;
 }
 
@@ -2840,10 +3272,115 @@ void ExynosMPP::dump(String8 &result) {
                         mName.string(), mMPPType, mPhysicalType, mLogicalType, mPhysicalIndex, mLogicalIndex, mPreAssignDisplayInfo);
     result.appendFormat("\tEnable(by debug): %d, Disable(by scenario):0x%8x, HWState: %d, AssignedState: %d, assignedDisplay(%d)\n",
                         mEnableByDebug, mDisableByUserScenario, mHWState, mAssignedState, assignedDisplayType);
+    if (mMPPType == MPP_TYPE_OTF)
+        result.appendFormat("\tPowerGated: %d, UnusedFrameCnt: %d\n", mPowerGated, mUnusedFrameCnt);
     result.appendFormat("\tPrevAssignedState: %d, PrevAssignedDisplayType: %d, ReservedDisplay: %d\n",
                         mPrevAssignedState, mPrevAssignedDisplayType, mReservedDisplayInfo.displayIdentifier.id);
-    result.appendFormat("\tassinedSourceNum(%zu), Capacity(%f), CapaUsed(%f), mCurrentDstBuf(%d)\n",
-                        mAssignedSources.size(), mCapacity, mUsedCapacity, mCurrentDstBuf);
+    result.appendFormat("\tassinedSourceNum(%zu), Capacity(%f), CapaUsed(%f), mCurrentDstBuf(%d/%d)\n",
+                        mAssignedSources.size(), mCapacity, mUsedCapacity, mCurrentDstBuf, mDstBufNum);
+    if (mMPPType == MPP_TYPE_M2M)
+        result.appendFormat("\tdst buffer depth(%d), waits(%" PRIu64 ")\n",
+                            mDstBufDepth, mDstBufWaitCnt);
+    if (mMPPType == MPP_TYPE_M2M)
+        result.appendFormat("\tppcModel(%d), ppc calibration entries(%zu)\n",
+                            exynosHWCControl.ppcModel, mPPCCalibration.size());
+    if ((mMPPType == MPP_TYPE_M2M) && (mAcrylicHandle != NULL)) {
+        const AcrylicStats &stats = mAcrylicHandle->getStats();
+        result.appendFormat("\tjobs(%" PRIu64 "), failed(%" PRIu64 "), latency measured(%" PRIu64 "), "
+                            "avg(%" PRIu64 "us), last(%uus), max(%uus), hw(%uus)\n",
+                            stats.job_count, stats.fail_count, stats.measured_count,
+                            stats.measured_count ? (stats.total_latency_usec / stats.measured_count) : 0,
+                            stats.last_latency_usec, stats.max_latency_usec, stats.last_hw_usec);
+    }
+    uint64_t memoTotal = mSupportedMemoHit + mSupportedMemoMiss;
+    result.appendFormat("\tisSupported memo hit(%" PRIu64 "), miss(%" PRIu64 "), hit rate(%.1f%%)\n",
+                        mSupportedMemoHit, mSupportedMemoMiss,
+                        memoTotal ? (100.0 * mSupportedMemoHit / memoTotal) : 0.0);
+}
+
+static const char *mppRejectTypeName[MPP_REJECT_TYPE_NUM] = {
+    "SaveCapability",
+    "StrideCrop",
+    "UnsupportedRotation",
+    "HWBusy",
+    "ExeedSrcCropMax",
+    "UnsupportedColorTransform",
+    "UnsupportedBlending",
+    "UnsupportedFormat",
+    "NotAlignedDstSize",
+    "NotAlignedSrcCropPosition",
+    "NotAlignedHStride",
+    "NotAlignedVStride",
+    "ExceedHStrideMaximum",
+    "ExceedVStrideMaximum",
+    "ExeedMaxDownScale",
+    "ExeedMaxDstWidth",
+    "ExeedMaxDstHeight",
+    "ExeedMinSrcWidth",
+    "ExeedMinSrcHeight",
+    "ExeedMaxUpScale",
+    "ExeedSrcWCropMax",
+    "ExeedSrcHCropMax",
+    "ExeedSrcWCropMin",
+    "ExeedSrcHCropMin",
+    "NotAlignedCrop",
+    "NotAlignedOffset",
+    "ExeedMinDstWidth",
+    "ExeedMinDstHeight",
+    "UnsupportedCompression",
+    "UnsupportedCSC",
+    "UnsupportedDIMLayer",
+    "UnsupportedDRM",
+    "UnsupportedDynamicMeta",
+    "ConflictSharedMPP",
+    "ExeedHWResource",
+};
+
+void ExynosMPP::updateUsageStats() {
+    if (!(mAssignedState & MPP_ASSIGN_STATE_ASSIGNED) || (mAssignedSources.size() == 0))
+        return;
+
+    mUsageStats.assignedFrames++;
+    mUsageStats.assignedLayers += mAssignedSources.size();
+    for (auto source : mAssignedSources)
+        mUsageStats.processedPixels += (uint64_t)source->mSrcImg.w * source->mSrcImg.h;
+
+    if (mMPPType == MPP_TYPE_M2M) {
+        mUsageStats.usedCapacity += mUsedCapacity;
+        mUsageStats.availableCapacity += mCapacity;
+        if (mUsedCapacity > mUsageStats.maxUsedCapacity)
+            mUsageStats.maxUsedCapacity = mUsedCapacity;
+    }
+}
+
+void ExynosMPP::dumpUsageStats(String8 &result) {
+    const UsageStats &stats = mUsageStats;
+
+    result.appendFormat("%s: frames(%" PRIu64 "), layers(%" PRIu64 "), pixels(%" PRIu64 ")",
+                        mName.string(), stats.assignedFrames, stats.assignedLayers,
+                        stats.processedPixels);
+    if (mMPPType == MPP_TYPE_M2M) {
+        result.appendFormat(", capacity avg used(%f)/available(%f), max used(%f)",
+                            stats.assignedFrames ? (stats.usedCapacity / stats.assignedFrames) : 0.0,
+                            stats.assignedFrames ? (stats.availableCapacity / stats.assignedFrames) : 0.0,
+                            stats.maxUsedCapacity);
+        if (mAcrylicHandle != NULL) {
+            const AcrylicStats &acrylicStats = mAcrylicHandle->getStats();
+            result.appendFormat(", jobs(%" PRIu64 ") avg(%" PRIu64 "us)", acrylicStats.job_count,
+                                acrylicStats.measured_count ?
+                                    (acrylicStats.total_latency_usec / acrylicStats.measured_count) : 0);
+        }
+    }
+    result.append("\n");
+
+    String8 rejects;
+    for (uint32_t i = 0; i < MPP_REJECT_TYPE_NUM; i++) {
+        uint64_t count = mRejectCount[i].load(std::memory_order_relaxed);
+        if (count)
+            rejects.appendFormat(" %s(%" PRIu64 ")", mppRejectTypeName[i], count);
+    }
+    if (rejects.size())
+        result.appendFormat("\trejected:%s\n", rejects.string());
 }
 
 void ExynosMPP::dumpBufInfo(String8 &str) {
@@ -2909,6 +3446,8 @@ void ExynosMPP::closeFences() {
 
 void ExynosMPP::addFormatRestrictions(restriction_key table) {
     mFormatRestrictions.push_back(table);
+    mFormatNodeMask[table.format] |= (1 << table.nodeType);
+    invalidateSupportedMemo();
     HDEBUGLOGD(eDebugAttrSetting, "MPP : %s, %d, %s, %d",
                mName.string(),
                mFormatRestrictions.back().nodeType,
@@ -2919,6 +3458,7 @@ void ExynosMPP::addFormatRestrictions(restriction_key table) {
 void ExynosMPP::addSizeRestrictions(restriction_size srcSize, restriction_size dstSize, restriction_classification format) {
     mSrcSizeRestrictions[format] = srcSize;
     mDstSizeRestrictions[format] = dstSize;
+    invalidateSupportedMemo();
 
     HDEBUGLOGD(eDebugAttrSetting, "MPP : %s: Src: %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d",
                mName.string(),
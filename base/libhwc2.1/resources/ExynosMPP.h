@@ -28,6 +28,8 @@
 #include <utils/List.h>
 #include <utils/Vector.h>
 #include <map>
+#include <array>
+#include <atomic>
 #include <hardware/exynos/acryl.h>
 #include <map>
 #include "ExynosHWCModule.h"
@@ -49,6 +51,24 @@ class ExynosMPP;
 #define NUM_MPP_DST_BUFS(type) (3)
 #endif
 
+/*
+ * Max number of dst buffers of M2M MPP.
+ * One more buffer than NUM_MPP_DST_BUFS is used in pipelined mode
+ * so that next job can be queued while previous one is scanned out.
+ */
+#ifndef NUM_MPP_DST_BUFS_MAX
+#define NUM_MPP_DST_BUFS_MAX 4
+#endif
+
+/*
+ * Bounds of the number of dst buffers of HWC_CTL_ADAPTIVE_DST_BUF.
+ * A buffer is added when M2M has to wait for the DPU to release the next
+ * dst buffer, and one is freed after MPP_DST_BUF_SHRINK_PERIOD without
+ * such waits.
+ */
+#define NUM_MPP_DST_BUFS_MIN 2
+#define MPP_DST_BUF_SHRINK_PERIOD s2ns(2)
+
 #ifndef G2D_MAX_SRC_NUM
 #define G2D_MAX_SRC_NUM 15
 #endif
@@ -152,6 +172,11 @@ class ExynosMPP;
 #endif
 
 #define MPP_DUMP_PATH "/data/vendor/log/hwc/output.dat"
+#define MPP_PPC_CALIB_PATH "/data/vendor/log/hwc/ppc_calib_%s.txt"
+/* Calibrated ppc is used after this number of samples */
+#define PPC_CALIB_MIN_SAMPLES 16
+/* Calibration table is written after this number of new samples */
+#define PPC_CALIB_SAVE_INTERVAL 512
 
 using namespace android;
 
@@ -193,6 +218,9 @@ enum {
     eMPPExeedHWResource = 1ULL << 34,
 };
 
+/* Number of the error bits of isSupported() above */
+#define MPP_REJECT_TYPE_NUM 35
+
 enum {
     MPP_TYPE_NONE,
     MPP_TYPE_OTF,
@@ -287,6 +315,31 @@ typedef struct ppc_list_for_scaling {
 
 typedef std::map<uint32_t, ppc_list_for_scaling> ppc_table;
 
+/* exynosHWCControl.ppcModel */
+enum {
+    PPC_MODEL_TABLE = 0,       /* ppc of scale bucket in ppc_table_map */
+    PPC_MODEL_INTERPOLATE,     /* interpolate ppc across scale buckets */
+    PPC_MODEL_CALIBRATE,       /* interpolate with ppc measured from M2M jobs */
+    PPC_MODEL_MAX
+};
+
+/* Learned ppc of one PPC_IDX, it is persisted to MPP_PPC_CALIB_PATH */
+typedef struct ppc_calibration {
+    float ppcList[PPC_SCALE_MAX] = {};
+    uint32_t samples[PPC_SCALE_MAX] = {};
+} ppc_calibration_t;
+
+/* Job of which duration is measured when its dst fence is signaled */
+typedef struct ppc_sample {
+    int fence = -1;
+    nsecs_t submitTime = 0;
+    uint32_t ppcIndex = 0;
+    uint32_t scaleIndex = 0;
+    float tablePPC = 0;
+    float pixels = 0;
+    float baseCycles = 0;
+} ppc_sample_t;
+
 typedef struct dstMetaInfo {
     uint16_t minLuminance = 0;
     uint16_t maxLuminance = 0;
@@ -311,6 +364,8 @@ enum class DisableType {
     DISABLE_SCENARIO = 1 << 0,
     DISABLE_DEBUG = 1 << 1,
     DISABLE_PRIORITY = 1 << 2,
+    DISABLE_POWER_GATING = 1 << 3,
+    DISABLE_DEFERRED_INIT = 1 << 4,
 };
 
 #define YUV_CHROMA_H_SUBSAMPLE static_cast<uint32_t>(2)  // Horizontal
@@ -516,6 +571,9 @@ class ExynosMPP {
     /* Runtime enable/disable */
     bool mEnableByDebug;
     uint32_t mDisableByUserScenario;
+    /* Gated by usage history of otfMPP */
+    bool mPowerGated;
+    uint32_t mUnusedFrameCnt;
 
     DisplayInfo mAssignedDisplayInfo;
 
@@ -549,7 +607,13 @@ class ExynosMPP {
     bool mWasUsedPrevFrame;
 
     struct exynos_mpp_img_info mSrcImgs[NUM_MPP_SRC_BUFS];
-    struct exynos_mpp_img_info mDstImgs[NUM_MPP_DST_BUFS_DEFAULT];
+    struct exynos_mpp_img_info mDstImgs[NUM_MPP_DST_BUFS_MAX];
+    /* Number of dst buffers in use, it bounds M2M jobs in flight */
+    uint32_t mDstBufNum;
+    /* Number of dst buffers wanted by the measured dst buffer waits */
+    uint32_t mDstBufDepth;
+    uint64_t mDstBufWaitCnt = 0;
+    nsecs_t mLastDstBufWaitTime = 0;
     int32_t mCurrentDstBuf;
     int32_t mPrivDstBuf;
     compressionInfo_t mTargetCompressionInfo;
@@ -557,6 +621,50 @@ class ExynosMPP {
     struct restriction_size mSrcSizeRestrictions[RESTRICTION_MAX];
     struct restriction_size mDstSizeRestrictions[RESTRICTION_MAX];
     std::vector<struct restriction_key> mFormatRestrictions;
+    /*
+     * HAL format -> (1 << nodeType) mask of mFormatRestrictions.
+     * Built while restrictions are added so that format checks
+     * don't need to scan mFormatRestrictions.
+     */
+    std::unordered_map<uint32_t, uint32_t> mFormatNodeMask;
+
+    /* PPC_MODEL_CALIBRATE */
+    std::map<uint32_t, ppc_calibration_t> mPPCCalibration;
+    ppc_sample_t mPPCSample;
+    Mutex mPPCCalibrationMutex;
+    bool mPPCCalibrationLoaded = false;
+    uint32_t mPPCNewSamples = 0;
+
+    /* Direct-mapped cache of isSupported() results */
+    static constexpr uint32_t kSupportedMemoKeySize = 32;
+    static constexpr uint32_t kSupportedMemoSize = 64;
+    struct SupportedMemoEntry {
+        bool valid = false;
+        std::array<uint32_t, kSupportedMemoKeySize> key = {};
+        int64_t dstResult = NO_ERROR;
+        int64_t result = NO_ERROR;
+    };
+    std::array<SupportedMemoEntry, kSupportedMemoSize> mSupportedMemo;
+    Mutex mSupportedMemoMutex;
+    uint64_t mSupportedMemoHit = 0;
+    uint64_t mSupportedMemoMiss = 0;
+
+    /*
+     * Usage counters since boot for dumpsys. The rejections are counted by
+     * the error bits of isSupported() that can be called by the validate
+     * workers, the others are updated by the resource manager.
+     */
+    struct UsageStats {
+        uint64_t assignedFrames = 0;
+        uint64_t assignedLayers = 0;
+        uint64_t processedPixels = 0;
+        double usedCapacity = 0;
+        double availableCapacity = 0;
+        float maxUsedCapacity = 0;
+    };
+    UsageStats mUsageStats;
+    std::array<std::atomic<uint64_t>, MPP_REJECT_TYPE_NUM> mRejectCount = {};
+    int64_t countSupportedResult(int64_t result);
 
     /* For libacryl */
     Acrylic *mAcrylicHandle;
@@ -573,6 +681,10 @@ class ExynosMPP {
     int mLutParcelFd = -1;
     void *mHdrCoefAddr = NULL;
     int mHdrCoefSize = 0;
+    /* Fingerprint of the HDR layer info of the coefficients in mHdrCoefAddr, 0 if unknown */
+    uint64_t mHdrCoefFingerprint = 0;
+    /* Fingerprint of the HDR layer info set for the current frame */
+    uint64_t mHdrCoefPendingFingerprint = 0;
 
     /* vOTF info */
     VotfInfo mVotfInfo;
@@ -621,6 +733,17 @@ class ExynosMPP {
                                     exynos_image &dst);
     virtual int64_t isSupported(DisplayInfo &display, struct exynos_image &src,
                                 struct exynos_image &dst);
+    /* Drop memoized isSupported() results, call it when restrictions change */
+    void invalidateSupportedMemo();
+    /*
+     * Memoizes the result of isSupported() for @src and @dst ahead of the
+     * validation. The result is not counted in the usage stats.
+     */
+    int64_t prefetchSupported(DisplayInfo &display, struct exynos_image &src,
+                              struct exynos_image &dst);
+    /* Accounts the sources of a validated frame of the assigned display */
+    void updateUsageStats();
+    void dumpUsageStats(String8 &result);
 
     virtual bool isDataspaceSupportedByMPP(struct exynos_image &src, struct exynos_image &dst);
     bool isSupportedHDR10Plus(struct exynos_image &src, struct exynos_image &dst);
@@ -702,10 +825,33 @@ class ExynosMPP {
     void dumpBufInfo(String8 &str);
 
     uint32_t increaseDstBuffIndex();
+    void updateDstBufNum();
+    void updateDstBufDepth(bool waited);
     bool canSkipProcessing();
 
     virtual bool isSupportedCompression(struct exynos_image &src);
+    /* Whether the M2M can write @dst in its compression type */
+    virtual bool isSupportedDstCompression(struct exynos_image &dst);
     virtual bool isSharedMPPUsed();
+    /*
+     * isSupported() results are memoized per image signature.
+     * Module should return false if any of its restriction checks
+     * depends on assignment state of other MPPs.
+     */
+    virtual bool isSupportedMemoizable() { return true; };
+    /*
+     * Restriction checks of isSupported(). Modules override it with
+     * checkSupported<ExynosMPPModule>() so that the checks are bound to
+     * the module overrides at compile time and a query is a single
+     * virtual call instead of one per restriction.
+     */
+    virtual int64_t isSupportedInternal(DisplayInfo &display, struct exynos_image &src,
+                                        struct exynos_image &dst) {
+        return checkSupported<ExynosMPP>(display, src, dst);
+    };
+    template <class MPP>
+    int64_t checkSupported(DisplayInfo &display, struct exynos_image &src,
+                           struct exynos_image &dst);
 
     void closeFences();
 
@@ -750,6 +896,8 @@ class ExynosMPP {
         mBufDestoryedCallback = cb;
     };
     void updatePPCTable(ppc_table &map);
+    void loadPPCCalibration();
+    void savePPCCalibration();
 
   protected:
     uint32_t getBufferType(uint64_t usage);
@@ -783,6 +931,11 @@ class ExynosMPP {
                      uint32_t &formatIndex, uint32_t &rotIndex, uint32_t &scaleIndex,
                      const struct exynos_image &criteria);
 
+    float getInterpolatedPPC(const float ppcList[PPC_SCALE_MAX],
+                             uint32_t scaleIndex, float scaleRatio);
+    void preparePPCSample(int dstFence, nsecs_t submitTime);
+    void updatePPCCalibration();
+
     float getRequiredBaseCycles(struct exynos_image &src, struct exynos_image &dst);
     bool addCapacity(ExynosMPPSource *mppSource);
     bool removeCapacity(ExynosMPPSource *mppSource);
@@ -795,10 +948,66 @@ class ExynosMPP {
      * Check additional conditions those have a capacity exception.
      */
     virtual bool isCapacityExceptionCondition(float totalUsedCapacity, float requiredCapacity, struct exynos_image &src);
+    /* Check format is in mFormatRestrictions for the node */
+    bool hasFormatRestriction(uint32_t format, uint32_t nodeType) {
+        auto it = mFormatNodeMask.find(format);
+        if (it == mFormatNodeMask.end())
+            return false;
+        return it->second & ((1 << NODE_NONE) | (1 << nodeType));
+    };
     virtual bool is2StepBlendingRequired(exynos_image &__unused src,
                                          buffer_handle_t __unused outbuf) { return false; };
 
     void dumpDstBuf();
 };
 
+/* MPP should be the most derived class, its subclasses are not consulted */
+template <class MPP>
+int64_t ExynosMPP::checkSupported(DisplayInfo &display, struct exynos_image &src,
+                                  struct exynos_image &dst) {
+    MPP *mpp = static_cast<MPP *>(this);
+    int64_t ret = NO_ERROR;
+
+    if (src.isDimLayer())  // Dim layer
+    {
+        return mpp->MPP::isDimLayerSupported();
+    }
+
+    if (!mpp->MPP::isSupportedCapability(display, src))
+        return -eMPPSaveCapability;
+    if (!mpp->MPP::isSrcFormatSupported(src))
+        return -eMPPUnsupportedFormat;
+    if (!mpp->MPP::isDstFormatSupported(dst))
+        return -eMPPUnsupportedFormat;
+    if (!mpp->MPP::isDataspaceSupportedByMPP(src, dst))
+        return -eMPPUnsupportedCSC;
+    if (!mpp->MPP::isSupportedHDR10Plus(src, dst))
+        return -eMPPUnsupportedDynamicMeta;
+    if (!mpp->MPP::isSupportedBlend(src))
+        return -eMPPUnsupportedBlending;
+    if (!mpp->MPP::isSupportedTransform(src))
+        return -eMPPUnsupportedRotation;
+    if ((ret = mpp->MPP::checkUnResizableSrcSize(src)) < 0)
+        return ret;
+    if (!mpp->MPP::isSupportedDRM(src))
+        return -eMPPUnsupportedDRM;
+    if ((getDrmMode(src.usageFlags) == NO_DRM) &&
+        ((ret = mpp->MPP::checkResizableSrcSize(src)) < 0))
+        return ret;
+    if ((ret = mpp->MPP::checkScaleRatio(display, src, dst)) < 0)
+        return ret;
+    if (!mpp->MPP::isSupportedHStrideCrop(src))
+        return -eMPPStrideCrop;
+
+    if (!mpp->MPP::isSupportedCompression(src))
+        return -eMPPUnsupportedCompression;
+    if (!mpp->MPP::isSupportedDstCompression(dst))
+        return -eMPPUnsupportedCompression;
+
+    if (!mpp->MPP::isSupportLayerColorTransform(src, dst))
+        return -eMPPUnsupportedColorTransform;
+
+    return NO_ERROR;
+}
+
 #endif  //_EXYNOSMPP_H
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <unistd.h>
+#include "ExynosMPPBufferPool.h"
+#include "ExynosGraphicBuffer.h"
+#include "ExynosHWCDebug.h"
+
+using namespace vendor::graphics;
+
+ANDROID_SINGLETON_STATIC_INSTANCE(ExynosMPPBufferPool);
+
+ExynosMPPBufferPool::~ExynosMPPBufferPool() {
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    for (auto &entry : mEntries) {
+        if (entry.fence >= 0)
+            close(entry.fence);
+        gAllocator.free(entry.handle);
+    }
+    mEntries.clear();
+}
+
+void ExynosMPPBufferPool::track(buffer_handle_t handle, uint32_t w, uint32_t h,
+                                uint32_t format, uint64_t usage) {
+    if (handle == nullptr)
+        return;
+
+    BufferDesc desc;
+    desc.w = w;
+    desc.h = h;
+    desc.format = format;
+    desc.usage = usage;
+    desc.size = (uint64_t)w * h * formatToBpp(format) / 8;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTracked[handle] = desc;
+}
+
+void ExynosMPPBufferPool::untrack(buffer_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTracked.erase(handle);
+}
+
+bool ExynosMPPBufferPool::take(uint32_t w, uint32_t h, uint32_t format, uint64_t usage,
+                               buffer_handle_t &handle, int &fence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint64_t area = (uint64_t)w * h;
+    auto best = mEntries.end();
+
+    for (auto it = mEntries.begin(); it != mEntries.end(); it++) {
+        const BufferDesc &desc = it->desc;
+        if ((desc.format != format) || (desc.usage != usage) ||
+            (desc.w < w) || (desc.h < h))
+            continue;
+        uint64_t entryArea = (uint64_t)desc.w * desc.h;
+        if (entryArea * 100 > area * MPP_BUFFER_POOL_AREA_RATIO)
+            continue;
+        /* Smallest one, most recently used one if there are same size */
+        if ((best == mEntries.end()) ||
+            (entryArea < (uint64_t)best->desc.w * best->desc.h))
+            best = it;
+    }
+
+    if (best == mEntries.end()) {
+        mMiss++;
+        return false;
+    }
+
+    handle = best->handle;
+    fence = best->fence;
+    mPooledSize -= best->desc.size;
+    mEntries.erase(best);
+    mHit++;
+
+    HDEBUGLOGD(eDebugBuf, "%s:: %p(%dx%d, 0x%x) is reused", __func__,
+               handle, w, h, format);
+    return true;
+}
+
+void ExynosMPPBufferPool::put(buffer_handle_t handle, int fence,
+                              std::vector<exynos_mpp_img_info> &freeBuffers) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto tracked = mTracked.find(handle);
+
+    if ((tracked == mTracked.end()) ||
+        (tracked->second.size > mMaxSize)) {
+        exynos_mpp_img_info freeBuffer;
+        freeBuffer.bufferHandle = handle;
+        freeBuffer.acrylicReleaseFenceFd = fence;
+        freeBuffers.push_back(freeBuffer);
+        if (tracked != mTracked.end())
+            mTracked.erase(tracked);
+        return;
+    }
+
+    PoolEntry entry;
+    entry.handle = handle;
+    entry.fence = fence;
+    entry.desc = tracked->second;
+    mEntries.push_front(entry);
+    mPooledSize += entry.desc.size;
+
+    reclaim(mMaxSize, freeBuffers);
+}
+
+void ExynosMPPBufferPool::setMaxSize(uint64_t maxSize) {
+    std::vector<exynos_mpp_img_info> freeBuffers;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mMaxSize = maxSize;
+        reclaim(mMaxSize, freeBuffers);
+    }
+
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    for (auto &buffer : freeBuffers) {
+        if (buffer.acrylicReleaseFenceFd >= 0)
+            close(buffer.acrylicReleaseFenceFd);
+        gAllocator.free(buffer.bufferHandle);
+    }
+}
+
+void ExynosMPPBufferPool::reclaim(uint64_t targetSize,
+                                  std::vector<exynos_mpp_img_info> &freeBuffers) {
+    while ((mPooledSize > targetSize) && (mEntries.size() > 0)) {
+        PoolEntry &entry = mEntries.back();
+        exynos_mpp_img_info freeBuffer;
+        freeBuffer.bufferHandle = entry.handle;
+        freeBuffer.acrylicReleaseFenceFd = entry.fence;
+        freeBuffers.push_back(freeBuffer);
+
+        mPooledSize -= entry.desc.size;
+        mTracked.erase(entry.handle);
+        mEntries.pop_back();
+        mReclaimed++;
+    }
+}
+
+void ExynosMPPBufferPool::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    result.appendFormat("MPP buffer pool: %zu buffers, %" PRIu64 "/%" PRIu64 " bytes, "
+                        "hit(%" PRIu64 "), miss(%" PRIu64 "), reclaimed(%" PRIu64 ")\n",
+                        mEntries.size(), mPooledSize, mMaxSize, mHit, mMiss, mReclaimed);
+    for (auto &entry : mEntries) {
+        result.appendFormat("\t%p: %dx%d, format(0x%x), usage(0x%" PRIx64 "), size(%" PRIu64 ")\n",
+                            entry.handle, entry.desc.w, entry.desc.h, entry.desc.format,
+                            entry.desc.usage, entry.desc.size);
+    }
+}
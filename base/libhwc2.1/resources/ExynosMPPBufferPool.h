@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSMPPBUFFERPOOL_H
+#define _EXYNOSMPPBUFFERPOOL_H
+
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "ExynosMPP.h"
+
+/* Default memory cap of pooled M2M dst buffers */
+#ifndef MPP_BUFFER_POOL_SIZE
+#define MPP_BUFFER_POOL_SIZE (64 * 1024 * 1024)
+#endif
+
+/* Pooled buffer can be used for the request up to this area ratio(%) */
+#define MPP_BUFFER_POOL_AREA_RATIO 125
+
+using namespace android;
+
+/*
+ * Pool of freed M2M dst buffers that are shared by all of ExynosMPP.
+ * Buffers are kept per size class (format, usage and size) and reclaimed
+ * in LRU order when the pooled size exceeds the cap.
+ */
+class ExynosMPPBufferPool : public Singleton<ExynosMPPBufferPool> {
+  public:
+    ExynosMPPBufferPool(){};
+    ~ExynosMPPBufferPool();
+
+    /* Buffer allocated by ExynosMPP::allocOutBuf() can be pooled */
+    void track(buffer_handle_t handle, uint32_t w, uint32_t h,
+               uint32_t format, uint64_t usage);
+    void untrack(buffer_handle_t handle);
+
+    /*
+     * Take pooled buffer that fits the request.
+     * Returned fence should be waited before the buffer is written.
+     */
+    bool take(uint32_t w, uint32_t h, uint32_t format, uint64_t usage,
+              buffer_handle_t &handle, int &fence);
+
+    /*
+     * Put buffer into the pool with the fence of its last user.
+     * Buffers that can't be pooled or are reclaimed are added to
+     * freeBuffers and caller should free them.
+     */
+    void put(buffer_handle_t handle, int fence,
+             std::vector<exynos_mpp_img_info> &freeBuffers);
+
+    /* Buffers over the new cap are freed here, don't call it in present path */
+    void setMaxSize(uint64_t maxSize);
+    void dump(String8 &result);
+
+  private:
+    struct BufferDesc {
+        uint32_t w = 0;
+        uint32_t h = 0;
+        uint32_t format = 0;
+        uint64_t usage = 0;
+        uint64_t size = 0;
+    };
+    struct PoolEntry {
+        buffer_handle_t handle = nullptr;
+        int fence = -1;
+        BufferDesc desc;
+    };
+
+    void reclaim(uint64_t targetSize, std::vector<exynos_mpp_img_info> &freeBuffers);
+
+    std::mutex mMutex;
+    std::unordered_map<buffer_handle_t, BufferDesc> mTracked;
+    /* Most recently pooled buffer is at the front */
+    std::list<PoolEntry> mEntries;
+    uint64_t mPooledSize = 0;
+    uint64_t mMaxSize = MPP_BUFFER_POOL_SIZE;
+    uint64_t mHit = 0;
+    uint64_t mMiss = 0;
+    uint64_t mReclaimed = 0;
+};
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "ExynosDisplay.h"
+#include "ExynosLayer.h"
+#include "ExynosHWCHelper.h"
+#include "ExynosResourceManagerModule.h"
+#include "ExynosMPPModule.h"
+#include "ExynosMPP.h"
+
+#include "ui/GraphicBuffer.h"
+
+/*
+ * Latency of the restriction and the capacity checks of validateDisplay()
+ * over synthetic layer mixes. The restrictions, the MPP units and the PPC
+ * tables are the ones of the SoC of TARGET_SOC_BASE this binary is built
+ * for, which is reported as "soc" in the context of the output.
+ */
+#ifndef HWC_BENCHMARK_SOC
+#define HWC_BENCHMARK_SOC "unknown"
+#endif
+
+struct hwc_bench_mix {
+    const char *name;
+    int format;
+    uint32_t compressType;
+    uint32_t srcW, srcH;
+    uint32_t dstW, dstH;
+    uint32_t transform;
+    android_dataspace dataSpace;
+};
+
+static const hwc_bench_mix bench_mixes[] = {
+    {"rgb_full", HAL_PIXEL_FORMAT_RGBA_8888, COMP_TYPE_NONE,
+     1080, 2400, 1080, 2400, 0, HAL_DATASPACE_V0_SRGB},
+    {"rgb_afbc", HAL_PIXEL_FORMAT_RGBA_8888, COMP_TYPE_AFBC,
+     1080, 2400, 1080, 2400, 0, HAL_DATASPACE_V0_SRGB},
+    {"video_down", HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M, COMP_TYPE_NONE,
+     3840, 2160, 1080, 608, 0, HAL_DATASPACE_V0_BT709},
+    {"video_rot", HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M, COMP_TYPE_NONE,
+     1920, 1080, 1080, 1920, HAL_TRANSFORM_ROT_90, HAL_DATASPACE_V0_BT709},
+};
+
+static ExynosResourceManager *gResourceManager;
+static DisplayInfo gDisplayInfo;
+
+/* getPPC() is internal to the MPP; the benchmark calls it through this */
+class BenchMPP : public ExynosMPPModule {
+  public:
+    explicit BenchMPP(const exynos_mpp_t &unit, uint32_t mppType)
+        : ExynosMPPModule(unit.physicalType, unit.logicalType, unit.name,
+                          unit.physical_index, unit.logical_index,
+                          unit.pre_assign_info, mppType){};
+    using ExynosMPP::getPPC;
+};
+
+static void setBenchImages(const hwc_bench_mix &mix, exynos_image &src, exynos_image &dst) {
+    src.exynosFormat = ExynosFormat(mix.format, mix.compressType);
+    src.compressionInfo.type = mix.compressType;
+    src.fullWidth = src.w = mix.srcW;
+    src.fullHeight = src.h = mix.srcH;
+    src.transform = mix.transform;
+    src.dataSpace = mix.dataSpace;
+    src.blending = HWC2_BLEND_MODE_PREMULTIPLIED;
+    src.planeAlpha = 1.0;
+
+    dst = src;
+    dst.exynosFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+    dst.compressionInfo.type = COMP_TYPE_NONE;
+    dst.fullWidth = gDisplayInfo.xres;
+    dst.fullHeight = gDisplayInfo.yres;
+    dst.w = mix.dstW;
+    dst.h = mix.dstH;
+    dst.transform = 0;
+}
+
+static void BM_IsSupported(benchmark::State &state, const hwc_bench_mix &mix) {
+    exynos_image src, dst;
+    setBenchImages(mix, src, dst);
+
+    for (auto _ : state) {
+        for (auto mpp : ExynosResourceManager::getOtfMPPs())
+            benchmark::DoNotOptimize(mpp->isSupported(gDisplayInfo, src, dst));
+    }
+    state.SetItemsProcessed(state.iterations() * ExynosResourceManager::getOtfMPPs().size());
+}
+
+/* The invalidation of the memoized results is timed with the checks */
+static void BM_IsSupportedUncached(benchmark::State &state, const hwc_bench_mix &mix) {
+    exynos_image src, dst;
+    setBenchImages(mix, src, dst);
+
+    for (auto _ : state) {
+        for (auto mpp : ExynosResourceManager::getOtfMPPs()) {
+            mpp->invalidateSupportedMemo();
+            benchmark::DoNotOptimize(mpp->isSupported(gDisplayInfo, src, dst));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * ExynosResourceManager::getOtfMPPs().size());
+}
+
+static void BM_GetRequiredCapacity(benchmark::State &state, const hwc_bench_mix &mix) {
+    BenchMPP mpp(AVAILABLE_M2M_MPP_UNITS[0], MPP_TYPE_M2M);
+    exynos_image src, dst;
+    setBenchImages(mix, src, dst);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mpp.getRequiredCapacity(gDisplayInfo, src, dst));
+}
+
+static void BM_GetPPC(benchmark::State &state, const hwc_bench_mix &mix) {
+    BenchMPP mpp(AVAILABLE_M2M_MPP_UNITS[0], MPP_TYPE_M2M);
+    exynos_image src, dst;
+    setBenchImages(mix, src, dst);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mpp.getPPC(src, dst, src));
+}
+
+/* A display with state.range(0) layers of the mixes in turn */
+class BenchDisplay {
+  public:
+    explicit BenchDisplay(int layerNum) {
+        DisplayIdentifier node = {getDisplayId(HWC_DISPLAY_PRIMARY, 0), HWC_DISPLAY_PRIMARY, 0,
+                                  String8("PrimaryDisplay"), String8("fake_decon_fb")};
+        mDisplay = new ExynosDisplay(node);
+        mDisplay->mXres = gDisplayInfo.xres;
+        mDisplay->mYres = gDisplayInfo.yres;
+        mDisplay->mColorTransformHint = HAL_COLOR_TRANSFORM_IDENTITY;
+
+        DisplayInfo displayInfo;
+        mDisplay->getDisplayInfo(displayInfo);
+
+        for (int i = 0; i < layerNum; i++) {
+            const hwc_bench_mix &mix = bench_mixes[i % (sizeof(bench_mixes) / sizeof(bench_mixes[0]))];
+            sp<GraphicBuffer> buffer = new GraphicBuffer(mix.srcW, mix.srcH, mix.format, 0, 0, "hwc_bench");
+            ExynosLayer *layer = new ExynosLayer(displayInfo);
+
+            layer->mLayerBuffer = buffer->getNativeBuffer()->handle;
+            layer->mCompositionType = HWC2_COMPOSITION_DEVICE;
+            layer->mSourceCrop = {0, 0, (float)mix.srcW, (float)mix.srcH};
+            layer->mDisplayFrame = {0, 0, (int)mix.dstW, (int)mix.dstH};
+            layer->mPreprocessedInfo.sourceCrop = layer->mSourceCrop;
+            layer->mPreprocessedInfo.displayFrame = layer->mDisplayFrame;
+            layer->mDamageRects.push_back({0, 0, (int)mix.srcW / 2, (int)mix.srcH / 2});
+            layer->mDamageRects.push_back({(int)mix.srcW / 2, (int)mix.srcH / 2,
+                                           (int)mix.srcW, (int)mix.srcH});
+            layer->mDamageNum = layer->mDamageRects.size();
+
+            mDisplay->mLayers.add(layer);
+            mBuffers.push_back(buffer);
+        }
+    }
+    ~BenchDisplay() {
+        for (auto layer : mDisplay->mLayers)
+            delete layer;
+        mDisplay->mLayers.clear();
+        delete mDisplay;
+    }
+
+    ExynosDisplay *mDisplay;
+
+  private:
+    std::vector<sp<GraphicBuffer>> mBuffers;
+};
+
+static void BM_ValidateLayer(benchmark::State &state) {
+    BenchDisplay bench(state.range(0));
+    ExynosDisplay *display = bench.mDisplay;
+
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < display->mLayers.size(); i++)
+            benchmark::DoNotOptimize(gResourceManager->validateLayer(i, display, display->mLayers[i]));
+    }
+    state.SetItemsProcessed(state.iterations() * display->mLayers.size());
+}
+
+static void BM_GetLayerRegion(benchmark::State &state) {
+    BenchDisplay bench(state.range(0));
+    ExynosDisplay *display = bench.mDisplay;
+    hwc_rect rect;
+
+    for (auto _ : state) {
+        for (auto layer : display->mLayers)
+            benchmark::DoNotOptimize(display->getLayerRegion(layer, rect, eDamageRegionByDamage));
+    }
+    state.SetItemsProcessed(state.iterations() * display->mLayers.size());
+}
+
+static void registerBenchmark(const char *op, void (*fn)(benchmark::State &, const hwc_bench_mix &),
+                              const hwc_bench_mix &mix) {
+    std::string name = std::string(op) + "/" + mix.name;
+
+    benchmark::RegisterBenchmark(name.c_str(), fn, mix);
+}
+
+int main(int argc, char *argv[]) {
+    benchmark::AddCustomContext("soc", HWC_BENCHMARK_SOC);
+
+    gResourceManager = new ExynosResourceManagerModule();
+    gResourceManager->updateRestrictions();
+    gDisplayInfo.displayIdentifier.id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    gDisplayInfo.displayIdentifier.type = HWC_DISPLAY_PRIMARY;
+    gDisplayInfo.xres = 1080;
+    gDisplayInfo.yres = 2400;
+
+    for (auto &mix : bench_mixes) {
+        registerBenchmark("is_supported", BM_IsSupported, mix);
+        registerBenchmark("is_supported_uncached", BM_IsSupportedUncached, mix);
+        registerBenchmark("required_capacity", BM_GetRequiredCapacity, mix);
+        registerBenchmark("ppc", BM_GetPPC, mix);
+    }
+    benchmark::RegisterBenchmark("validate_layer", BM_ValidateLayer)->RangeMultiplier(2)->Range(1, 16);
+    benchmark::RegisterBenchmark("layer_region", BM_GetLayerRegion)->RangeMultiplier(2)->Range(1, 16);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+
+    delete gResourceManager;
+
+    return 0;
+}
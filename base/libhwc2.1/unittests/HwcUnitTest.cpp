@@ -34,8 +34,13 @@
 
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWCService.h"
+#include "ExynosFrameRecorder.h"
+#include "ExynosRestrictionBlob.h"
 
 #include <sys/types.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <drm_fourcc.h>
 #include <xf86drm.h>
 #include <drm.h>
@@ -179,6 +184,22 @@ TEST_F(HwcUnitTest, OneShotTimer) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, OneShotTimer_CoalescedReset) {
+    std::atomic<int> resets = 0;
+    std::atomic<int> timeouts = 0;
+    OneShotTimer timer(std::chrono::milliseconds(50), [&] { resets++; }, [&] { timeouts++; });
+    timer.start();
+    for (int i = 0; i < 10; i++) {
+        timer.reset();
+        usleep(10000);
+    }
+    usleep(200000);
+    EXPECT_EQ(resets, 1);
+    EXPECT_EQ(timeouts, 1);
+    EXPECT_EQ(timer.isTimerRunning(), false);
+    timer.stop();
+}
+
 TEST_F(HwcUnitTest, Destructor_TraceEnder) {
     android::TraceUtils::TraceEnder* tmp = new android::TraceUtils::TraceEnder();
     delete tmp;
@@ -238,6 +259,67 @@ TEST_F(HwcUnitTest, isDrm) {
     delete layer;
 }
 
+TEST_F(HwcUnitTest, ExynosSortedLayer_zOrder) {
+    DisplayInfo display_info;
+    ExynosLayer *layers[4];
+    uint32_t zOrders[4] = {3, 1, 2, 1};
+    ExynosSortedLayer sorted;
+    uint64_t geometry = 0;
+
+    for (size_t i = 0; i < 4; i++) {
+        layers[i] = new ExynosLayer(display_info);
+        layers[i]->setLayerZOrder(zOrders[i], geometry);
+        sorted.add(layers[i]);
+    }
+    /* Same zOrder in the order of add() */
+    EXPECT_EQ(sorted[0], layers[1]);
+    EXPECT_EQ(sorted[1], layers[3]);
+    EXPECT_EQ(sorted[2], layers[2]);
+    EXPECT_EQ(sorted[3], layers[0]);
+
+    layers[0]->setLayerZOrder(0, geometry);
+    EXPECT_EQ(sorted.vector_sort(), NO_ERROR);
+    EXPECT_EQ(sorted[0], layers[0]);
+    EXPECT_EQ(sorted[3], layers[2]);
+
+    EXPECT_EQ(sorted.remove(layers[3]), 2);
+    EXPECT_EQ(sorted.size(), 3u);
+
+    for (size_t i = 0; i < 4; i++)
+        delete layers[i];
+}
+
+TEST_F(HwcUnitTest, ExynosLayer_filteredGeometryChanged) {
+    DisplayInfo display_info;
+    ExynosLayer *layer = new ExynosLayer(display_info);
+    sp<GraphicBuffer> buffer = new GraphicBuffer(1080, 1080,
+                                                 HAL_PIXEL_FORMAT_RGBX_8888,
+                                                 0, 0, "buffer_libui");
+    uint64_t geometry = 0;
+
+    layer->mLayerBuffer = buffer->getNativeBuffer()->handle;
+    layer->mLayerFormat = ExynosFormat(HAL_PIXEL_FORMAT_RGBX_8888);
+    layer->mBlending = HWC2_BLEND_MODE_PREMULTIPLIED;
+    layer->mDataSpace = HAL_DATASPACE_UNKNOWN;
+
+    /* No alpha to premultiply and UNKNOWN is sRGB for RGB */
+    layer->setLayerBlendMode(HWC2_BLEND_MODE_COVERAGE, geometry);
+    layer->setLayerDataspace(HAL_DATASPACE_V0_SRGB, geometry);
+    EXPECT_EQ(geometry, 0u);
+    EXPECT_EQ(layer->mFilteredGeometryChanged,
+              GEOMETRY_LAYER_BLEND_CHANGED | GEOMETRY_LAYER_DATASPACE_CHANGED);
+    EXPECT_EQ(layer->mBlending, HWC2_BLEND_MODE_COVERAGE);
+
+    layer->setLayerBlendMode(HWC2_BLEND_MODE_NONE, geometry);
+    layer->setLayerDataspace(HAL_DATASPACE_V0_BT709, geometry);
+    EXPECT_EQ(geometry, GEOMETRY_LAYER_BLEND_CHANGED | GEOMETRY_LAYER_DATASPACE_CHANGED);
+
+    layer->clearGeometryChanged();
+    EXPECT_EQ(layer->mFilteredGeometryChanged, 0u);
+    layer->mLayerBuffer = NULL;
+    delete layer;
+}
+
 TEST_F(HwcUnitTest, updateConfigRequestAppliedTime) {
     DisplayIdentifier primary_node = {getDisplayId(HWC_DISPLAY_PRIMARY, 0), HWC_DISPLAY_PRIMARY, 0,
                                       String8("PrimaryDisplay"), String8("fake_decon_fb")};
@@ -322,6 +404,7 @@ TEST_F(HwcUnitTest, ExynosDisplayInterface) {
     DeviceToDisplayInterface temp5;
     tmp->setDeviceToDisplayInterface(temp5);
     tmp->readHotplugStatus();
+    tmp->updateHotplugStatus();
 
     String8 temp6;
     tmp->updateUeventNodeName(temp6);
@@ -340,6 +423,7 @@ TEST_F(HwcUnitTest, ExynosDisplayDrmInterface) {
     ExynosDisplayInterface* tmp = new ExynosDisplayDrmInterface();
     tmp->setForcePanic();
     tmp->setLowPowerMode(0);
+    tmp->updateHotplugStatus();
     tmp->readHotplugStatus();
     tmp->updateHdrSinkInfo();
     tmp->setCursorPositionAsync(0, 0);
@@ -478,6 +562,53 @@ TEST_F(HwcUnitTest, updateFeatureTableAndRestrictions) {
     delete resourceManager;
 }
 
+TEST_F(HwcUnitTest, getDpuReadBandwidth) {
+    exynos_image img;
+    img.exynosFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+    img.compressionInfo.type = COMP_TYPE_NONE;
+    img.w = 1080;
+    img.h = 2400;
+
+    uint64_t linear = 1080ULL * 2400 * 4 * 60;
+    EXPECT_EQ(ExynosResourceManager::getDpuReadBandwidth(img, 60), linear);
+
+    img.exynosFormat = ExynosFormat(HAL_PIXEL_FORMAT_RGBA_8888, COMP_TYPE_AFBC);
+    img.compressionInfo.type = COMP_TYPE_AFBC;
+    EXPECT_EQ(ExynosResourceManager::getDpuReadBandwidth(img, 60),
+              1080ULL * 2400 * 4 * DPU_BW_AFBC_RATIO / 100 * 60);
+    EXPECT_LT(ExynosResourceManager::getDpuReadBandwidth(img, 60), linear);
+}
+
+TEST_F(HwcUnitTest, ExynosMPP_prefetchSupported) {
+    ExynosResourceManager *resourceManager = new ExynosResourceManagerModule();
+    resourceManager->updateRestrictions();
+
+    DisplayInfo display;
+    display.displayIdentifier.id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    display.displayIdentifier.type = HWC_DISPLAY_PRIMARY;
+    display.xres = 1080;
+    display.yres = 2400;
+
+    exynos_image src;
+    src.exynosFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+    src.compressionInfo.type = COMP_TYPE_NONE;
+    src.fullWidth = src.w = 1080;
+    src.fullHeight = src.h = 2400;
+    src.dataSpace = HAL_DATASPACE_V0_SRGB;
+    src.blending = HWC2_BLEND_MODE_PREMULTIPLIED;
+    src.planeAlpha = 1.0;
+    exynos_image dst = src;
+
+    /* A prefetched result is the one isSupported() returns from the memo */
+    for (auto mpp : ExynosResourceManager::getOtfMPPs()) {
+        mpp->invalidateSupportedMemo();
+        int64_t prefetched = mpp->prefetchSupported(display, src, dst);
+        EXPECT_EQ(prefetched, mpp->isSupported(display, src, dst)) << mpp->mName.string();
+        EXPECT_EQ(prefetched, mpp->prefetchSupported(display, src, dst)) << mpp->mName.string();
+    }
+    delete resourceManager;
+}
+
 TEST_F(HwcUnitTest, ExynosDisplay_cpp) {
     uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
     DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
@@ -554,3 +685,164 @@ TEST_F(HwcUnitTest, ExynosDisplay_cpp) {
 
     delete tmp;
 }
+
+TEST_F(HwcUnitTest, ExynosFrameRecorder_RoundTrip) {
+    ExynosFrameRecord frame;
+    frame.seq = 7;
+    frame.displayId = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    frame.displayType = HWC_DISPLAY_PRIMARY;
+    frame.xres = 1080;
+    frame.yres = 2400;
+    frame.geometryChanged = GEOMETRY_LAYER_UNKNOWN_CHANGED;
+    frame.validateTime = 123456;
+
+    ExynosFrameRecordLayer layer;
+    layer.requestedType = HWC2_COMPOSITION_DEVICE;
+    layer.validatedType = HWC2_COMPOSITION_DEVICE;
+    layer.otfMPP = String8("DPP_GF0");
+    layer.src.exynosFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+    layer.src.fullWidth = 1080;
+    layer.src.fullHeight = 2400;
+    layer.src.w = 1080;
+    layer.src.h = 2400;
+    layer.src.blending = HWC2_BLEND_MODE_PREMULTIPLIED;
+    layer.src.dataSpace = HAL_DATASPACE_V0_SRGB;
+    layer.src.planeAlpha = 1.0;
+    layer.src.usageFlags = 0xb00;
+    layer.dst = layer.src;
+    layer.dst.zOrder = 1;
+    frame.layers.push_back(layer);
+
+    String8 text;
+    ExynosFrameRecorder::format(frame, text);
+
+    FILE *fp = tmpfile();
+    ASSERT_NE(fp, nullptr);
+    fwrite(text.string(), 1, text.length(), fp);
+    rewind(fp);
+
+    ExynosFrameRecord parsed;
+    ASSERT_TRUE(ExynosFrameRecorder::parse(fp, parsed));
+    ExynosFrameRecord end;
+    EXPECT_FALSE(ExynosFrameRecorder::parse(fp, end));
+    fclose(fp);
+
+    String8 reformatted;
+    ExynosFrameRecorder::format(parsed, reformatted);
+    EXPECT_STREQ(text.string(), reformatted.string());
+    ASSERT_EQ(parsed.layers.size(), 1u);
+    EXPECT_TRUE(parsed.layers[0].m2mMPP.isEmpty());
+    EXPECT_EQ(parsed.layers[0].dst.zOrder, 1u);
+}
+
+/*
+ * Replays the frames recorded with HWC_CTL_RECORD_FRAMES against the OTF MPPs
+ * of this device. The trace is given by HWC_FRAME_TRACE. For each layer that
+ * was assigned to an OTF MPP, the first OTF MPP that supports the layer is
+ * compared with the recorded one and the time of the checks is reported.
+ */
+TEST_F(HwcUnitTest, ExynosFrameRecorder_Replay) {
+    const char *path = getenv("HWC_FRAME_TRACE");
+    if (path == NULL)
+        GTEST_SKIP() << "HWC_FRAME_TRACE is not set";
+
+    FILE *fp = fopen(path, "r");
+    ASSERT_NE(fp, nullptr) << path;
+
+    ExynosResourceManager *resourceManager = new ExynosResourceManagerModule();
+    ExynosFrameRecord frame;
+    uint64_t frames = 0, layers = 0, matched = 0;
+    nsecs_t checkTime = 0;
+
+    while (ExynosFrameRecorder::parse(fp, frame)) {
+        DisplayInfo display;
+        display.displayIdentifier.id = frame.displayId;
+        display.displayIdentifier.type = frame.displayType;
+        display.xres = frame.xres;
+        display.yres = frame.yres;
+        frames++;
+
+        for (auto &layer : frame.layers) {
+            if (layer.otfMPP.isEmpty())
+                continue;
+
+            ExynosMPP *supported = nullptr;
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (auto mpp : ExynosResourceManager::getOtfMPPs()) {
+                if (mpp->isSupported(display, layer.src, layer.dst) == NO_ERROR) {
+                    supported = mpp;
+                    break;
+                }
+            }
+            checkTime += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+            layers++;
+            if ((supported != nullptr) && (supported->mName == layer.otfMPP))
+                matched++;
+        }
+    }
+    fclose(fp);
+    delete resourceManager;
+
+    printf("frames %" PRIu64 " layers %" PRIu64 " avg check %" PRId64 " ns match %.1f%%\n",
+           frames, layers, layers ? checkTime / (nsecs_t)layers : 0,
+           layers ? (matched * 100.0) / layers : 0.0);
+    EXPECT_GT(frames, 0u);
+}
+
+TEST_F(HwcUnitTest, ExynosFrameCrc_crc32c) {
+    const char check[] = "123456789";
+
+    EXPECT_EQ(ExynosFrameCrc::crc32c(0, check, strlen(check)), 0xe3069283u);
+    /* CRC of lines continued from the previous one is the CRC of the whole */
+    uint32_t crc = ExynosFrameCrc::crc32c(0, check, 4);
+    EXPECT_EQ(ExynosFrameCrc::crc32c(crc, check + 4, strlen(check) - 4), 0xe3069283u);
+    EXPECT_EQ(ExynosFrameCrc::crc32c(0, check, 0), 0u);
+}
+
+TEST_F(HwcUnitTest, ExynosRestrictionBlob) {
+    struct {
+        restriction_blob_header header;
+        restriction_blob_section sections[2];
+        restriction_blob_feature feature;
+        restriction_blob_ppc ppc;
+    } blob = {};
+    blob.header = {RESTRICTION_BLOB_MAGIC, RESTRICTION_BLOB_VERSION, sizeof(blob), 2};
+    blob.sections[0] = {RESTRICTION_BLOB_FEATURE, (uint32_t)offsetof(decltype(blob), feature),
+                        sizeof(restriction_blob_feature), 1};
+    blob.sections[1] = {RESTRICTION_BLOB_PPC, (uint32_t)offsetof(decltype(blob), ppc),
+                        sizeof(restriction_blob_ppc), 1};
+    blob.feature = {MPP_DPP_VGFS, 0, MPP_ATTR_AFBC | MPP_ATTR_SCALE};
+    blob.ppc.ppcIndex = PPC_IDX(MPP_MSC, PPC_FORMAT_RGB32, PPC_ROT_NO);
+    blob.ppc.ppcList[PPC_SCALE_NO] = 3.5;
+
+    char path[] = "/data/local/tmp/hwc_restrictions_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, &blob, sizeof(blob)), (ssize_t)sizeof(blob));
+    close(fd);
+
+    ExynosRestrictionBlob restrictionBlob;
+    ASSERT_EQ(restrictionBlob.open(path), 0);
+    uint32_t num = 0;
+    const restriction_blob_feature *features =
+        restrictionBlob.getEntries<restriction_blob_feature>(RESTRICTION_BLOB_FEATURE, num);
+    ASSERT_EQ(num, 1u);
+    EXPECT_EQ(features[0].attr, (uint64_t)(MPP_ATTR_AFBC | MPP_ATTR_SCALE));
+    const restriction_blob_ppc *ppcs =
+        restrictionBlob.getEntries<restriction_blob_ppc>(RESTRICTION_BLOB_PPC, num);
+    ASSERT_EQ(num, 1u);
+    EXPECT_FLOAT_EQ(ppcs[0].ppcList[PPC_SCALE_NO], 3.5);
+    restrictionBlob.getEntries<restriction_blob_size>(RESTRICTION_BLOB_SIZE, num);
+    EXPECT_EQ(num, 0u);
+
+    /* A blob of another version is not used */
+    blob.header.version = RESTRICTION_BLOB_VERSION + 1;
+    fd = open(path, O_WRONLY | O_TRUNC);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, &blob, sizeof(blob)), (ssize_t)sizeof(blob));
+    close(fd);
+    EXPECT_NE(restrictionBlob.open(path), 0);
+    EXPECT_FALSE(restrictionBlob.isOpened());
+    unlink(path);
+}
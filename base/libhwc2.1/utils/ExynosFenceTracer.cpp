@@ -44,12 +44,39 @@ extern uint64_t errorFrameCount;
 ANDROID_SINGLETON_STATIC_INSTANCE(ExynosFenceTracer);
 
 ExynosFenceTracer::ExynosFenceTracer() {
-    mFenceInfo.clear();
 }
 
 ExynosFenceTracer::~ExynosFenceTracer() {
 }
 
+/* Finds the slot of @fd. A free slot is claimed for @fd if @create is true. */
+hwc_fence_slot_t *ExynosFenceTracer::getFenceSlot(int32_t fd, bool create) {
+    if (fd < 0)
+        return NULL;
+
+    for (uint32_t i = 0; i < MAX_FENCE_TABLE_SIZE; i++) {
+        hwc_fence_slot_t *slot = &mFenceSlots[(fd + i) & (MAX_FENCE_TABLE_SIZE - 1)];
+        int32_t slotFd = slot->fd.load(std::memory_order_acquire);
+
+        if (slotFd == fd)
+            return slot;
+        if (slotFd >= 0)
+            continue;
+        if (!create)
+            return NULL;
+        if (slot->fd.compare_exchange_strong(slotFd, fd, std::memory_order_acq_rel))
+            return slot;
+        /* another thread claimed this slot */
+        if (slotFd == fd)
+            return slot;
+    }
+
+    if (create)
+        FT_LOGE("fence table is full, fd %d is not traced", fd);
+
+    return NULL;
+}
+
 void ExynosFenceTracer::writeFenceInfo(uint32_t fd, hwc_fence_info_t *info,
                                        hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
                                        uint32_t direction, bool pendingAllowed) {
@@ -70,9 +97,7 @@ void ExynosFenceTracer::writeFenceInfo(uint32_t fd, hwc_fence_info_t *info,
     info->pendingAllowed = pendingAllowed;
 
     /* time */
-    struct timeval tv;
     gettimeofday(&seq->time, NULL);
-    tv = seq->time;
 }
 
 void ExynosFenceTracer::changeFenceInfoState(uint32_t fd, const DisplayIdentifier &display,
@@ -81,17 +106,17 @@ void ExynosFenceTracer::changeFenceInfoState(uint32_t fd, const DisplayIdentifie
     if (!fence_valid(fd))
         return;
 
-    /* init or recevice(from previous) trace info */
-    hwc_fence_info_t info;
-    if (mFenceInfo.count(fd) == 0) {
-        info = {};
-    } else
-        info = mFenceInfo.at(fd);
+    /* update the trace info of the fd in place */
+    hwc_fence_slot_t *slot = getFenceSlot(fd, true);
+    if (slot == NULL)
+        return;
+
+    slot->lock();
+    slot->info.displayId = display.id;
+    writeFenceInfo(fd, &slot->info, type, ip, direction, pendingAllowed);
+    slot->unlock();
 
-    info.displayId = display.id;
-    writeFenceInfo(fd, &info, type, ip, direction, pendingAllowed);
     FT_LOGD("FD : %d, direction : %d, type(%d), ip(%d) (%s)", fd, direction, type, ip, __func__);
-    mFenceInfo[fd] = info;
 }
 
 void ExynosFenceTracer::setFenceInfo(uint32_t fd, const DisplayIdentifier &display,
@@ -100,58 +125,59 @@ void ExynosFenceTracer::setFenceInfo(uint32_t fd, const DisplayIdentifier &displ
     if (!fence_valid(fd))
         return;
 
-    /* init or recevice(from previous) trace info */
-    hwc_fence_info_t info;
-    if (mFenceInfo.count(fd) == 0) {
-        info = {};
-    } else {
-        info = mFenceInfo.at(fd);
-    }
+    /* update the trace info of the fd in place */
+    hwc_fence_slot_t *slot = getFenceSlot(fd, true);
+    if (slot == NULL)
+        return;
+
+    slot->lock();
 
-    info.displayId = display.id;
-    writeFenceInfo(fd, &info, type, ip, direction, pendingAllowed);
-    fenceTrace_t *seq = &info.seq[info.seq_no];
+    hwc_fence_info_t *info = &slot->info;
+
+    info->displayId = display.id;
+    writeFenceInfo(fd, info, type, ip, direction, pendingAllowed);
+    fenceTrace_t *seq = &info->seq[info->seq_no];
 
     /* update usage count */
     if ((seq->dir == FENCE_FROM) || (seq->dir == FENCE_DUP)) {
-        info.usage++;
+        info->usage++;
     } else if ((seq->dir == FENCE_TO) || (seq->dir == FENCE_CLOSE)) {
-        info.usage--;
-        if ((seq->dir == FENCE_CLOSE) && (info.usage < 0))
-            info.usage = 0;
+        info->usage--;
+        if ((seq->dir == FENCE_CLOSE) && (info->usage < 0))
+            info->usage = 0;
     } else
         ALOGE("Fence trace : Undefined direction!");
 
-    FT_LOGI("setFenceInfo(%d):: %s, %s, %s, %s usage: %d",
-            fd, display.name.string(),
-            getString(fence_dir_map, seq->dir),
-            getString(fence_type_map, seq->type),
-            getString(fence_ip_map, seq->ip),
-            info.usage);
-
-    seq->usage = info.usage;
+    seq->usage = info->usage;
     // Fence's usage count shuld be zero at end of frame(present done).
     // This flag means usage count of the fence can be pended over frame.
-    if (info.usage == 0)
-        info.pendingAllowed = false;
+    if (info->usage == 0) {
+        info->pendingAllowed = false;
+        info->leaking = false;
+    }
 
     /* last direction */
-    info.last_dir = direction;
-    mFenceInfo[fd] = info;
+    info->last_dir = direction;
+
+    int32_t usage = info->usage;
+
+    slot->unlock();
+
+    FT_LOGI("setFenceInfo(%d):: %s, %s, %s, %s usage: %d",
+            fd, display.name.string(),
+            getString(fence_dir_map, direction),
+            getString(fence_type_map, type),
+            getString(fence_ip_map, ip),
+            usage);
 }
 
-void ExynosFenceTracer::printLastFenceInfo(uint32_t fd) {
+void ExynosFenceTracer::printFenceInfo(int32_t fd, const hwc_fence_info_t &info) {
     struct timeval tv;
-    if (!fence_valid(fd))
-        return;
-    if (mFenceInfo.count(fd) == 0)
-        return;
 
-    hwc_fence_info_t info = mFenceInfo.at(fd);
     FT_LOGD("---- Fence FD : %d, Display(%d), usage(%d) ----", fd, info.displayId, info.usage);
 
     for (int i = 0; i < MAX_FENCE_SEQUENCE; i++) {
-        fenceTrace_t *seq = &info.seq[i];
+        const fenceTrace_t *seq = &info.seq[i];
         FT_LOGD("fd(%d) %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
                 fd, getString(fence_dir_map, seq->dir),
                 getString(fence_ip_map, seq->ip), getString(fence_type_map, seq->type),
@@ -168,31 +194,37 @@ void ExynosFenceTracer::printLastFenceInfo(uint32_t fd) {
     }
 }
 
+void ExynosFenceTracer::printLastFenceInfo(uint32_t fd) {
+    if (!fence_valid(fd))
+        return;
+
+    hwc_fence_slot_t *slot = getFenceSlot(fd, false);
+    if (slot == NULL)
+        return;
+
+    slot->lock();
+    hwc_fence_info_t info = slot->info;
+    slot->unlock();
+
+    printFenceInfo(fd, info);
+}
+
 void ExynosFenceTracer::dumpFenceInfo(int32_t depth) {
     FT_LOGD("Dump fence ++");
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-
-        hwc_fence_info_t info = mFenceInfo.at(i);
+    forEachFenceInfo([&](int32_t fd, const hwc_fence_info_t &info) {
         if ((info.usage >= 1 || info.usage <= -1) && (!info.pendingAllowed))
-            printLastFenceInfo(i);
-    }
+            printFenceInfo(fd, info);
+    });
     FT_LOGD("Dump fence --");
 }
 
 bool ExynosFenceTracer::fenceWarn(uint32_t threshold) {
     uint32_t cnt = 0, r_cnt = 0;
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
+    forEachFenceInfo([&](int32_t, const hwc_fence_info_t &info) {
         if (info.usage >= 1 || info.usage <= -1)
             cnt++;
-    }
+    });
 
     if ((cnt > threshold) || (exynosHWCControl.fenceTracer > 0))
         dumpFenceInfo(0);
@@ -206,35 +238,33 @@ bool ExynosFenceTracer::fenceWarn(uint32_t threshold) {
 
 void ExynosFenceTracer::resetFenceCurFlag() {
     FT_LOGD("%s ++", __func__);
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
+    for (auto &slot : mFenceSlots) {
+        int32_t fd = slot.fd.load(std::memory_order_acquire);
+        if (fd < 0)
             continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
 
-        if (info.usage == 0) {
-            hwc_fence_info_t *info_ = &mFenceInfo[i];
+        slot.lock();
+        int32_t usage = slot.info.usage;
+        bool pendingAllowed = slot.info.pendingAllowed;
+        if (usage == 0) {
             for (int j = 0; j < MAX_FENCE_SEQUENCE; j++)
-                info_->seq[j].curFlag = 0;
-        } else if (!info.pendingAllowed)
-            FT_LOGE("usage mismatched fd %d, usage %d, pending %d", i,
-                    info.usage, info.pendingAllowed);
+                slot.info.seq[j].curFlag = 0;
+        }
+        slot.unlock();
+
+        if ((usage != 0) && !pendingAllowed)
+            FT_LOGE("usage mismatched fd %d, usage %d, pending %d", fd,
+                    usage, pendingAllowed);
     }
     FT_LOGD("%s --", __func__);
 }
 
 void ExynosFenceTracer::printFenceTrace(String8 &saveString, struct tm *localTime) {
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-
-        hwc_fence_info_t info = mFenceInfo.at(i);
-
+    forEachFenceInfo([&](int32_t fd, const hwc_fence_info_t &info) {
         if (info.usage >= 1) {
-            saveString.appendFormat("FD hwc : %d, usage %d, pending : %d\n", i, info.usage, (int)info.pendingAllowed);
+            saveString.appendFormat("FD hwc : %d, usage %d, pending : %d\n", fd, info.usage, (int)info.pendingAllowed);
             for (int j = 0; j < MAX_FENCE_SEQUENCE; j++) {
-                fenceTrace_t *seq = &info.seq[j];
+                const fenceTrace_t *seq = &info.seq[j];
                 saveString.appendFormat("    %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
                                         getString(fence_dir_map, seq->dir),
                                         getString(fence_ip_map, seq->ip), getString(fence_type_map, seq->type),
@@ -250,7 +280,7 @@ void ExynosFenceTracer::printFenceTrace(String8 &saveString, struct tm *localTim
                                         ((tv.tv_sec * 1000) + (tv.tv_usec / 1000)));
             }
         }
-    }
+    });
 }
 
 void ExynosFenceTracer::printLeakFds() {
@@ -260,51 +290,39 @@ void ExynosFenceTracer::printLeakFds() {
 
     errStringPlus.appendFormat("Leak Fds (1) :\n");
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
+    forEachFenceInfo([&](int32_t fd, const hwc_fence_info_t &info) {
         if (info.usage >= 1) {
-            errStringPlus.appendFormat("%d,", i);
+            errStringPlus.appendFormat("%d,", fd);
             if (cnt++ % 10 == 0)
                 errStringPlus.appendFormat("\n");
         }
-    }
+    });
     FT_LOGI("%s", errStringPlus.string());
 
     errStringMinus.appendFormat("Leak Fds (-1) :\n");
 
     cnt = 1;
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
+    forEachFenceInfo([&](int32_t fd, const hwc_fence_info_t &info) {
         if (info.usage < 0) {
-            errStringMinus.appendFormat("%d,", i);
+            errStringMinus.appendFormat("%d,", fd);
             if (cnt++ % 10 == 0)
                 errStringMinus.appendFormat("\n");
         }
-    }
+    });
     FT_LOGI("%s", errStringMinus.string());
 }
 
 bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display) {
     bool ret = true;
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
+    forEachFenceInfo([&](int32_t, const hwc_fence_info_t &info) {
         if (info.displayId != display.id)
-            continue;
+            return;
         if ((info.usage >= 1 || info.usage <= -1) &&
             (!info.pendingAllowed) && (!info.leaking)) {
             ret = false;
         }
-    }
+    });
 
     if (!ret) {
         int priv = exynosHWCControl.fenceTracer;
@@ -318,17 +336,26 @@ bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display)
 
 void ExynosFenceTracer::dumpNCheckLeak(int32_t depth) {
     FT_LOGD("Dump leaking fence ++");
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
+    for (auto &slot : mFenceSlots) {
+        int32_t fd = slot.fd.load(std::memory_order_acquire);
+        if (fd < 0)
             continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if ((info.usage >= 1 || info.usage <= -1) && (!info.pendingAllowed))
+
+        bool newLeak = false;
+        hwc_fence_info_t info;
+
+        slot.lock();
+        if ((slot.info.usage >= 1 || slot.info.usage <= -1) && (!slot.info.pendingAllowed) &&
+            (!slot.info.leaking)) {
             // leak is occured in this frame first
-            if (!info.leaking) {
-                info.leaking = true;
-                printLastFenceInfo(i);
-            }
+            slot.info.leaking = true;
+            info = slot.info;
+            newLeak = true;
+        }
+        slot.unlock();
+
+        if (newLeak)
+            printFenceInfo(fd, info);
     }
 
     int priv = exynosHWCControl.fenceTracer;
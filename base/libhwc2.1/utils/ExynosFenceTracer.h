@@ -19,6 +19,7 @@
 
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCTypes.h"
+#include <atomic>
 #include <vector>
 #include <unordered_map>
 #include <utils/Singleton.h>
@@ -26,6 +27,7 @@
 #define MAX_FENCE_NAME 64
 #define MAX_FENCE_THRESHOLD 500
 #define MAX_FENCE_SEQUENCE 3
+#define MAX_FENCE_TABLE_SIZE 1024 /* power of two */
 
 using namespace android;
 typedef enum hwc_fdebug_fence_type {
@@ -114,6 +116,23 @@ typedef struct hwc_fence_info {
     bool leaking = false;
 } hwc_fence_info_t;
 
+/*
+ * A slot of the fence table. The fd of a slot is set once by the first trace
+ * of the fd and the slot is kept for the reuse of the fd. The info is updated
+ * in place under the lock of the slot.
+ */
+typedef struct hwc_fence_slot {
+    std::atomic<int32_t> fd{-1};
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    hwc_fence_info_t info;
+
+    void lock() {
+        while (busy.test_and_set(std::memory_order_acquire))
+            ;
+    }
+    void unlock() { busy.clear(std::memory_order_release); }
+} hwc_fence_slot_t;
+
 extern int hwcFenceDebug[FENCE_IP_MAX];
 class ExynosFenceTracer : public Singleton<ExynosFenceTracer> {
   public:
@@ -157,8 +176,32 @@ class ExynosFenceTracer : public Singleton<ExynosFenceTracer> {
     }
 
     // Variable for fence tracer
-    std::unordered_map<int32_t, hwc_fence_info> mFenceInfo;
     uint32_t mFenceLogSize = 0;
+
+  private:
+    hwc_fence_slot_t *getFenceSlot(int32_t fd, bool create);
+    void printFenceInfo(int32_t fd, const hwc_fence_info_t &info);
+    /* Calls @func with a copy of the info of each traced fd */
+    template <typename Func>
+    void forEachFenceInfo(Func func) {
+        for (auto &slot : mFenceSlots) {
+            int32_t fd = slot.fd.load(std::memory_order_acquire);
+            if (fd < 0)
+                continue;
+
+            slot.lock();
+            hwc_fence_info_t info = slot.info;
+            slot.unlock();
+
+            func(fd, info);
+        }
+    }
+
+    /*
+     * Open addressed by fd. The fds less than MAX_FENCE_TABLE_SIZE are found
+     * at the first probe.
+     */
+    hwc_fence_slot_t mFenceSlots[MAX_FENCE_TABLE_SIZE];
 };
 
 #endif
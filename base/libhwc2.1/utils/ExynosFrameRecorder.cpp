@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include "ExynosFrameRecorder.h"
+
+ANDROID_SINGLETON_STATIC_INSTANCE(ExynosFrameRecorder);
+
+#define FRAME_RECORD_LINE_MAX 1024
+#define FRAME_RECORD_NAME_MAX 32
+
+int32_t ExynosFrameRecorder::start(const char *path) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mFile != NULL)
+        return NO_ERROR;
+
+    mFile = fopen(path, "w");
+    if (mFile == NULL) {
+        ALOGE("%s: failed to open %s: %s", __func__, path, strerror(errno));
+        return -errno;
+    }
+
+    mSeq = 0;
+    mSize = 0;
+    mRecording = true;
+    ALOGI("%s: recording frames to %s", __func__, path);
+
+    return NO_ERROR;
+}
+
+void ExynosFrameRecorder::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mRecording = false;
+    if (mFile == NULL)
+        return;
+
+    fclose(mFile);
+    mFile = NULL;
+    ALOGI("%s: recorded %" PRIu64 " frames, %zu bytes", __func__, mSeq, mSize);
+}
+
+void ExynosFrameRecorder::record(ExynosFrameRecord &frame) {
+    String8 result;
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mFile == NULL)
+        return;
+
+    frame.seq = mSeq++;
+    format(frame, result);
+
+    if ((fwrite(result.string(), 1, result.length(), mFile) != result.length()) ||
+        (fflush(mFile) != 0)) {
+        ALOGE("%s: failed to write frame %" PRIu64 ": %s", __func__, frame.seq, strerror(errno));
+        mRecording = false;
+        fclose(mFile);
+        mFile = NULL;
+        return;
+    }
+
+    mSize += result.length();
+    if (mSize >= FRAME_RECORD_MAX_SIZE) {
+        ALOGI("%s: stop recording at %zu bytes", __func__, mSize);
+        mRecording = false;
+        fclose(mFile);
+        mFile = NULL;
+    }
+}
+
+static void formatImage(const exynos_image &img, String8 &result) {
+    result.appendFormat("%d %u %ux%u %u,%u,%u,%u %u %u %d %f 0x%x 0x%" PRIx64 " %u",
+                        img.exynosFormat.halFormat(), img.compressionInfo.type,
+                        img.fullWidth, img.fullHeight, img.x, img.y, img.w, img.h,
+                        img.transform, img.blending, img.dataSpace, img.planeAlpha,
+                        img.layerFlags, img.usageFlags, img.zOrder);
+}
+
+/* Returns the number of the characters consumed, 0 if @str is not an image */
+static int parseImage(const char *str, exynos_image &img) {
+    int halFormat;
+    uint32_t compressType;
+    int dataSpace;
+    int consumed = 0;
+
+    if (sscanf(str, " %d %u %ux%u %u,%u,%u,%u %u %u %d %f %x %" SCNx64 " %u%n",
+               &halFormat, &compressType, &img.fullWidth, &img.fullHeight,
+               &img.x, &img.y, &img.w, &img.h, &img.transform, &img.blending,
+               &dataSpace, &img.planeAlpha, &img.layerFlags, &img.usageFlags,
+               &img.zOrder, &consumed) != 15)
+        return 0;
+
+    img.exynosFormat = ExynosFormat(halFormat, compressType);
+    img.compressionInfo.type = compressType;
+    img.dataSpace = static_cast<android_dataspace>(dataSpace);
+
+    return consumed;
+}
+
+void ExynosFrameRecorder::format(const ExynosFrameRecord &frame, String8 &result) {
+    result.appendFormat("frame %" PRIu64 " display %u %u %ux%u geometry 0x%" PRIx64
+                        " validate_ns %" PRId64 " layers %zu\n",
+                        frame.seq, frame.displayId, frame.displayType, frame.xres, frame.yres,
+                        frame.geometryChanged, frame.validateTime, frame.layers.size());
+
+    for (auto &layer : frame.layers) {
+        result.appendFormat("layer %d %d %s %s src ", layer.requestedType, layer.validatedType,
+                            layer.otfMPP.size() ? layer.otfMPP.string() : "-",
+                            layer.m2mMPP.size() ? layer.m2mMPP.string() : "-");
+        formatImage(layer.src, result);
+        result.append(" dst ");
+        formatImage(layer.dst, result);
+        result.append("\n");
+    }
+}
+
+bool ExynosFrameRecorder::parse(FILE *fp, ExynosFrameRecord &frame) {
+    char line[FRAME_RECORD_LINE_MAX];
+    size_t layerNum;
+
+    frame = {};
+
+    if (fgets(line, sizeof(line), fp) == NULL)
+        return false;
+
+    if (sscanf(line, "frame %" SCNu64 " display %u %u %ux%u geometry %" SCNx64
+                     " validate_ns %" SCNd64 " layers %zu",
+               &frame.seq, &frame.displayId, &frame.displayType, &frame.xres, &frame.yres,
+               &frame.geometryChanged, &frame.validateTime, &layerNum) != 8) {
+        ALOGE("%s: invalid frame: %s", __func__, line);
+        return false;
+    }
+
+    frame.layers.resize(layerNum);
+    for (auto &layer : frame.layers) {
+        char otfMPP[FRAME_RECORD_NAME_MAX];
+        char m2mMPP[FRAME_RECORD_NAME_MAX];
+        int pos = 0;
+        int consumed;
+
+        if ((fgets(line, sizeof(line), fp) == NULL) ||
+            (sscanf(line, "layer %d %d %31s %31s src%n", &layer.requestedType,
+                    &layer.validatedType, otfMPP, m2mMPP, &pos) != 4) ||
+            (pos == 0)) {
+            ALOGE("%s: invalid layer of frame %" PRIu64, __func__, frame.seq);
+            return false;
+        }
+
+        if ((consumed = parseImage(line + pos, layer.src)) == 0) {
+            ALOGE("%s: invalid src image of frame %" PRIu64, __func__, frame.seq);
+            return false;
+        }
+        pos += consumed;
+
+        int dstPos = 0;
+        sscanf(line + pos, " dst%n", &dstPos);
+        if ((dstPos == 0) || (parseImage(line + pos + dstPos, layer.dst) == 0)) {
+            ALOGE("%s: invalid dst image of frame %" PRIu64, __func__, frame.seq);
+            return false;
+        }
+
+        layer.otfMPP = strcmp(otfMPP, "-") ? String8(otfMPP) : String8();
+        layer.m2mMPP = strcmp(m2mMPP, "-") ? String8(m2mMPP) : String8();
+    }
+
+    return true;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSFRAMERECORDER_H
+#define _EXYNOSFRAMERECORDER_H
+
+#include <stdio.h>
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "ExynosHWCHelper.h"
+
+using namespace android;
+
+#define FRAME_RECORD_PATH "/data/vendor/log/hwc/hwc_frames.txt"
+#define FRAME_RECORD_MAX_SIZE (64 * 1024 * 1024)
+
+/*
+ * Layer state of a validated frame. The images are the source and the
+ * destination images given to the resource manager, and the composition
+ * types and the MPP names are the outcome of the assignment.
+ */
+struct ExynosFrameRecordLayer {
+    int32_t requestedType = 0;
+    int32_t validatedType = 0;
+    String8 otfMPP;
+    String8 m2mMPP;
+    exynos_image src;
+    exynos_image dst;
+};
+
+struct ExynosFrameRecord {
+    uint64_t seq = 0;
+    uint32_t displayId = 0;
+    uint32_t displayType = 0;
+    uint32_t xres = 0;
+    uint32_t yres = 0;
+    uint64_t geometryChanged = 0;
+    nsecs_t validateTime = 0;
+    std::vector<ExynosFrameRecordLayer> layers;
+};
+
+/*
+ * Recorder of the frames of validateDisplay() to replay them offline
+ *
+ * The records are text lines of a frame followed by its layers:
+ *   frame <seq> display <id> <type> <xres>x<yres> geometry <hex> validate_ns <ns> layers <n>
+ *   layer <requested> <validated> <otf|-> <m2m|-> src <image> dst <image>
+ *   <image> : <format> <compression> <full w>x<full h> <x>,<y>,<w>,<h>
+ *             <transform> <blending> <dataspace> <alpha> <layer flags> <usage> <z>
+ * The file stops growing at FRAME_RECORD_MAX_SIZE.
+ */
+class ExynosFrameRecorder : public Singleton<ExynosFrameRecorder> {
+  public:
+    ExynosFrameRecorder(){};
+    ~ExynosFrameRecorder() { stop(); };
+    int32_t start(const char *path = FRAME_RECORD_PATH);
+    void stop();
+    bool isRecording() { return mRecording; };
+    void record(ExynosFrameRecord &frame);
+
+    static void format(const ExynosFrameRecord &frame, String8 &result);
+    /* Reads the next frame from @fp, false at the end or an invalid record */
+    static bool parse(FILE *fp, ExynosFrameRecord &frame);
+
+  private:
+    std::mutex mMutex;
+    FILE *mFile = NULL;      // GUARDED_BY(mMutex)
+    uint64_t mSeq = 0;       // GUARDED_BY(mMutex)
+    size_t mSize = 0;        // GUARDED_BY(mMutex)
+    /* read without the lock to skip the capture when it is not recording */
+    std::atomic<bool> mRecording{false};
+};
+
+#endif
@@ -18,6 +18,7 @@
 #include <sys/mman.h>
 #include <utils/CallStack.h>
 #include <android/sync.h>
+#include <processgroup/processgroup.h>
 #include <hardware/exynos/ion.h>
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCDebug.h"
@@ -449,6 +450,25 @@ int hwcFdClose(int fd) {
     return -1;
 }
 
+nsecs_t getFenceSignalTime(int fence) {
+    if (fence < 0)
+        return -1;
+
+    struct sync_file_info *info = sync_file_info(fence);
+    if (info == NULL)
+        return -1;
+
+    nsecs_t signalTime = -1;
+    if (info->status == 1) {
+        struct sync_fence_info *fenceInfo = sync_get_fence_info(info);
+        for (uint32_t i = 0; i < info->num_fences; i++)
+            signalTime = max(signalTime, (nsecs_t)fenceInfo[i].timestamp_ns);
+    }
+    sync_file_info_free(info);
+
+    return signalTime;
+}
+
 int hwc_print_stack() {
 #if 0
     CallStack stack(LOG_TAG);
@@ -466,6 +486,18 @@ bool hasPPC(uint32_t physicalType, uint32_t formatIndex, uint32_t rotIndex) {
     return false;
 }
 
+void setHelperThreadProfile() {
+    thread_local bool profileDone = false;
+
+    if (profileDone)
+        return;
+    profileDone = true;
+
+    /* The frame path keeps the big cores, helper threads are not latency critical */
+    if (!SetTaskProfiles(gettid(), {"ServiceCapacityLow"}))
+        ALOGW("Failed to add `%d` into ServiceCapacityLow", gettid());
+}
+
 int allocParcelData(int *fd, size_t size) {
     if (*fd >= 0)
         return NO_ERROR;
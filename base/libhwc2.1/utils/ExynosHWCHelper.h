@@ -18,6 +18,7 @@
 
 #include <array>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 #include <hardware/hwcomposer2.h>
 #include <map>
 #include "DeconCommonHeader.h"
@@ -97,11 +98,33 @@ enum {
     eExceedMaxLayerNum = 0x00040000,
     eFroceClientLayer = 0x00080000,
     eRemoveDynamicMetadata = 0x00100000,
+    eAssignDeadline = 0x00200000,
+    eExceedDpuBandwidth = 0x00400000,
+    eLowPowerComposition = 0x00800000,
     eResourceAssignFail = 0x20000000,
     eMPPUnsupported = 0x40000000,
     eUnknown = 0x80000000,
 };
 
+/* Reason of HWC2_COMPOSITION_CLIENT of a layer derived from mOverlayInfo */
+enum client_composition_reason {
+    CLIENT_REASON_REQUESTED = 0,    /* requested by SurfaceFlinger */
+    CLIENT_REASON_FORCED,           /* debug, dynamic recomposition, doze or WFD */
+    CLIENT_REASON_COLOR_TRANSFORM,
+    CLIENT_REASON_FORMAT,           /* format, compression, rotation, blending, DRM */
+    CLIENT_REASON_SCALE,
+    CLIENT_REASON_SIZE,             /* size, alignment and crop restrictions */
+    CLIENT_REASON_CAPACITY,         /* supported but no MPP was assignable */
+    CLIENT_REASON_WINDOW,
+    CLIENT_REASON_SANDWICH,         /* between GLES or exynos composition layers */
+    CLIENT_REASON_HDR,
+    CLIENT_REASON_DEADLINE,
+    CLIENT_REASON_ASSIGN_FAIL,      /* the whole display fell back by setForceClient() */
+    CLIENT_REASON_OTHER,
+    CLIENT_REASON_MAX,
+    CLIENT_REASON_NONE = CLIENT_REASON_MAX,
+};
+
 enum regionType {
     eTransparentRegion = 0,
     eCoveredOpaqueRegion = 1,
@@ -155,6 +178,8 @@ struct exynos_image {
      * frameworks/native/include/media/hardware/HardwareAPI.h */
     ExynosVideoMeta *metaParcel = nullptr;
     ExynosVideoInfoType metaType = VIDEO_INFO_TYPE_INVALID;
+    /* changed whenever sHdrDynamicInfo of metaParcel is rewritten, 0 if unknown */
+    uint64_t hdrDynamicGeneration = 0;
     bool needColorTransform = false;
     std::array<float, TRANSFORM_MAT_SIZE> colorTransformMatrix = {
         1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
@@ -180,6 +205,15 @@ inline int HEIGHT(const hwc_rect &rect) { return rect.bottom - rect.top; }
 inline int WIDTH(const hwc_frect_t &rect) { return (int)(rect.right - rect.left); }
 inline int HEIGHT(const hwc_frect_t &rect) { return (int)(rect.bottom - rect.top); }
 
+/* FNV-1a of @size bytes of @data into @hash */
+inline void hashFingerprint(uint64_t &hash, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+}
+
 enum decon_blending halBlendingToDpuBlending(int32_t blending);
 enum dpp_rotate halTransformToDpuRot(uint32_t halTransform);
 uint64_t halTransformToDrmRot(uint32_t halTransform);
@@ -201,6 +235,8 @@ void dumpHandle(uint32_t type, buffer_handle_t h);
 void adjustRect(hwc_rect_t &rect, int32_t width, int32_t height);
 
 int hwcFdClose(int fd);
+/* Returns the time the fence was signaled, or -1 if it is not signaled yet */
+nsecs_t getFenceSignalTime(int fence);
 int hwc_print_stack();
 
 inline hwc_rect expand(const hwc_rect &r1, const hwc_rect &r2) {
@@ -212,6 +248,17 @@ inline hwc_rect expand(const hwc_rect &r1, const hwc_rect &r2) {
     return i;
 }
 
+inline int64_t AREA(const hwc_rect &rect) {
+    if ((rect.right <= rect.left) || (rect.bottom <= rect.top))
+        return 0;
+    return (int64_t)WIDTH(rect) * HEIGHT(rect);
+}
+
+inline bool isOverlapped(const hwc_rect &r1, const hwc_rect &r2) {
+    return (r1.left < r2.right) && (r2.left < r1.right) &&
+           (r1.top < r2.bottom) && (r2.top < r1.bottom);
+}
+
 int pixel_align_down(int x, int a);
 
 inline int pixel_align(int x, int a) {
@@ -242,6 +289,8 @@ inline uint32_t getDisplayId(int32_t displayType, int32_t displayIndex = 0) {
     return (displayType << DISPLAYID_MASK_LEN) | displayIndex;
 }
 int allocParcelData(int *fd, size_t size);
+/* Moves the calling helper thread to the little cores, once per thread */
+void setHelperThreadProfile();
 compressionInfo_t getCompressionInfo(buffer_handle_t handle);
 
 android_dataspace_t getRefinedDataspace(int halFormat, android_dataspace_t dataspace);
@@ -73,6 +73,29 @@ enum {
     HWC_CTL_SKIP_RESOURCE_ASSIGN = 111,
     HWC_CTL_SKIP_VALIDATE = 112,
     HWC_CTL_ADJUST_DYNAMIC_RECOMP_TIMER = 113,
+    HWC_CTL_INCREMENTAL_ASSIGN = 114,
+    HWC_CTL_RESET_LATENCY_STATS = 115,
+    HWC_CTL_STATIC_LAYER_CACHE = 116,
+    HWC_CTL_PARALLEL_VALIDATE = 117,
+    HWC_CTL_PREDICTIVE_PRESENT = 118,
+    HWC_CTL_ATOMIC_PROPERTY_SHADOW = 119,
+    HWC_CTL_ASSIGN_SOLVER = 120,
+    HWC_CTL_PPC_MODEL = 121,
+    HWC_CTL_M2M_PIPELINE = 122,
+    HWC_CTL_MPP_BUFFER_POOL_SIZE = 123,
+    HWC_CTL_M2M_CAPA_BROKER = 124,
+    HWC_CTL_DPP_POWER_GATING = 125,
+    HWC_CTL_ASSIGN_DEADLINE = 126,
+    HWC_CTL_UPDATE_RATE_PRIORITY = 127,
+    HWC_CTL_FB_PRE_IMPORT = 128,
+    HWC_CTL_PIPELINED_COMMIT = 129,
+    HWC_CTL_VALIDATE_FINGERPRINT = 130,
+    HWC_CTL_RECORD_FRAMES = 131,
+    HWC_CTL_DPU_BW_BUDGET = 132,
+    HWC_CTL_SPECULATIVE_PREVALIDATE = 133,
+    HWC_CTL_ADAPTIVE_DST_BUF = 134,
+    HWC_CTL_FOLD_DIM_LAYER = 135,
+    HWC_CTL_FRAME_CRC = 136,
     HWC_CTL_DUMP_MID_BUF = 200,
     HWC_CTL_CAPTURE_READBACK = 201,
     HWC_CTL_ENABLE_EXYNOSCOMPOSITION_OPT = 301,
@@ -147,6 +170,7 @@ enum {
     GEOMETRY_DISPLAY_LAYER_ADDED = 1ULL << 20,
     GEOMETRY_DISPLAY_LAYER_REMOVED = 1ULL << 21,
     GEOMETRY_DISPLAY_CONFIG_CHANGED = 1ULL << 22,
+    GEOMETRY_DISPLAY_STATIC_LAYER_CACHE = 1ULL << 23,
     GEOMETRY_DISPLAY_SINGLEBUF_CHANGED = 1ULL << 24,
     GEOMETRY_DISPLAY_FORCE_VALIDATE = 1ULL << 25,
     GEOMETRY_DISPLAY_COLOR_MODE_CHANGED = 1ULL << 26,
@@ -158,7 +182,7 @@ enum {
     GEOMETRY_DISPLAY_FRAME_SKIPPED = 1ULL << 32,
     GEOMETRY_DISPLAY_ADJUST_SIZE_CHANGED = 1ULL << 33,
     GEOMETRY_DISPLAY_WORKING_VSYNC_CHANGED = 1ULL << 34,
-    /* 1ULL << 35 */
+    GEOMETRY_DISPLAY_LOW_POWER_CHANGED = 1ULL << 35,
     GEOMETRY_DEVICE_DISPLAY_ADDED = 1ULL << 36,
     GEOMETRY_DEVICE_DISPLAY_REMOVED = 1ULL << 37,
     GEOMETRY_DEVICE_CONFIG_CHANGED = 1ULL << 38,
@@ -174,6 +198,15 @@ enum {
     GEOMETRY_ERROR_CASE = 1ULL << 63,
 };
 
+/* Layer geometry changes that can be compared with validated layer state */
+#define GEOMETRY_LAYER_FINGERPRINT_MASK                                          \
+    (GEOMETRY_LAYER_TYPE_CHANGED | GEOMETRY_LAYER_DATASPACE_CHANGED |            \
+     GEOMETRY_LAYER_DISPLAYFRAME_CHANGED | GEOMETRY_LAYER_SOURCECROP_CHANGED |   \
+     GEOMETRY_LAYER_TRANSFORM_CHANGED | GEOMETRY_LAYER_ZORDER_CHANGED |          \
+     GEOMETRY_LAYER_FLAG_CHANGED | GEOMETRY_LAYER_PRIORITY_CHANGED |             \
+     GEOMETRY_LAYER_COMPRESSED_CHANGED | GEOMETRY_LAYER_BLEND_CHANGED |          \
+     GEOMETRY_LAYER_FORMAT_CHANGED | GEOMETRY_LAYER_DRM_CHANGED)
+
 namespace MSCvOTFInfo {
 enum MSCvOTFInfo {
     ENABLE,
@@ -190,6 +223,15 @@ typedef enum restriction_classification {
     RESTRICTION_MAX
 } restriction_classification_t;
 
+/* Vendor callbacks after HWC2 callbacks */
+#define HWC2_CALLBACK_REFRESH_RATE_CHANGED_DEBUG (HWC2_CALLBACK_SEAMLESS_POSSIBLE + 1)
+#define HWC2_CALLBACK_VSYNC_IDLE (HWC2_CALLBACK_REFRESH_RATE_CHANGED_DEBUG + 1)
+#define HWC2_CALLBACK_EXYNOS_MAX (HWC2_CALLBACK_VSYNC_IDLE + 1)
+typedef void (*HWC2_PFN_REFRESH_RATE_CHANGED_DEBUG)(hwc2_callback_data_t callbackData,
+                                                    hwc2_display_t display,
+                                                    hwc2_vsync_period_t vsyncPeriodNanos);
+typedef void (*HWC2_PFN_VSYNC_IDLE)(hwc2_callback_data_t callbackData, hwc2_display_t display);
+
 struct exynos_callback_info_t {
     hwc2_callback_data_t callbackData = nullptr;
     hwc2_function_pointer_t funcPointer = nullptr;
@@ -247,6 +289,18 @@ typedef struct exynos_hwc_control {
     uint32_t fenceTracer;
     uint32_t sysFenceLogging;
     uint32_t usePerfFile;
+    uint32_t parallelValidate;
+    uint32_t atomicPropertyShadow;
+    uint32_t ppcModel;
+    uint32_t m2mPipeline;
+    uint32_t m2mCapaBroker;
+    uint32_t dppPowerGating;
+    uint32_t fbPreImport;
+    uint32_t validateFingerprint;
+    /* DPU read bandwidth budget in MB/s, 0 disables the bandwidth check */
+    uint32_t dpuBandwidthBudget;
+    uint32_t speculativePrevalidate;
+    uint32_t adaptiveDstBuf;
 } exynos_hwc_control_t;
 
 typedef struct restriction_size_element {
@@ -319,6 +373,7 @@ struct DisplayInfo {
     bool adjustDisplayFrame = false;
     bool cursorSupport = false;
     bool skipM2mProcessing = true;
+    bool updateRatePriority = false;
     uint32_t baseWindowIndex = 0;
     decon_idma_type defaultDMA = MAX_DECON_DMA_TYPE;
 
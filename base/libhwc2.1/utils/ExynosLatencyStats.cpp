@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include "ExynosLatencyStats.h"
+
+ANDROID_SINGLETON_STATIC_INSTANCE(ExynosLatencyStats);
+
+static const char *latencyStageName[LATENCY_STAGE_MAX] = {
+    "validate",
+    "assignResource",
+    "deliverWinConfig",
+    "ifDeliverWinConfig",
+    "atomicCommit",
+    "prevFrameWait",
+};
+
+uint32_t ExynosLatencyStats::StageHistogram::getPercentile(uint32_t percent) const {
+    if (count == 0)
+        return 0;
+
+    uint64_t target = (count * percent + 99) / 100;
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        accumulated += buckets[i];
+        if (accumulated >= target)
+            return kLatencyBucketBounds[i];
+    }
+    return kLatencyBucketBounds.back();
+}
+
+void ExynosLatencyStats::record(uint32_t displayId, hwc_latency_stage_t stage,
+                                nsecs_t duration) {
+    if (stage >= LATENCY_STAGE_MAX)
+        return;
+
+    uint32_t usec = static_cast<uint32_t>(ns2us(duration));
+    size_t index = 0;
+    while ((index < (kLatencyBucketBounds.size() - 1)) &&
+           (usec > kLatencyBucketBounds[index]))
+        index++;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    StageHistogram &histogram = mHistograms[displayId][stage];
+    histogram.buckets[index]++;
+    histogram.count++;
+    histogram.total += duration;
+    if (duration > histogram.max)
+        histogram.max = duration;
+}
+
+uint32_t ExynosLatencyStats::getPercentile(uint32_t displayId, hwc_latency_stage_t stage,
+                                           uint32_t percent) {
+    if (stage >= LATENCY_STAGE_MAX)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mHistograms.find(displayId);
+    if (it == mHistograms.end())
+        return 0;
+    return it->second[stage].getPercentile(percent);
+}
+
+bool ExynosLatencyStats::getHistogram(uint32_t displayId, hwc_latency_stage_t stage,
+                                      std::array<uint32_t, kLatencyBucketBounds.size()> &buckets,
+                                      uint64_t &count, nsecs_t &max) {
+    if (stage >= LATENCY_STAGE_MAX)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mHistograms.find(displayId);
+    if ((it == mHistograms.end()) || (it->second[stage].count == 0))
+        return false;
+
+    const StageHistogram &histogram = it->second[stage];
+    buckets = histogram.buckets;
+    count = histogram.count;
+    max = histogram.max;
+    return true;
+}
+
+void ExynosLatencyStats::reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mHistograms.clear();
+}
+
+void ExynosLatencyStats::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    result.append("HWC stage latency (usec, percentiles are bucket upper bounds)\n");
+    for (auto &display : mHistograms) {
+        result.appendFormat("  display[0x%x]\n", display.first);
+        result.appendFormat("  %20s | %8s | %8s | %8s | %8s | %8s | %8s\n",
+                            "stage", "count", "avg", "p50", "p90", "p99", "max");
+        for (uint32_t i = 0; i < LATENCY_STAGE_MAX; i++) {
+            const StageHistogram &histogram = display.second[i];
+            if (histogram.count == 0)
+                continue;
+            result.appendFormat("  %20s | %8" PRIu64 " | %8" PRId64,
+                                latencyStageName[i], histogram.count,
+                                ns2us(histogram.total / (nsecs_t)histogram.count));
+            for (uint32_t percent : {50, 90, 99}) {
+                uint32_t value = histogram.getPercentile(percent);
+                if (value == UINT32_MAX)
+                    result.appendFormat(" | %8s", "inf");
+                else
+                    result.appendFormat(" | %8u", value);
+            }
+            result.appendFormat(" | %8" PRId64 "\n", ns2us(histogram.max));
+        }
+    }
+    result.append("\n");
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSLATENCYSTATS_H
+#define _EXYNOSLATENCYSTATS_H
+
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <array>
+#include <map>
+#include <mutex>
+
+using namespace android;
+
+typedef enum hwc_latency_stage {
+    LATENCY_STAGE_VALIDATE = 0,
+    LATENCY_STAGE_ASSIGN_RESOURCE,
+    LATENCY_STAGE_DELIVER_WIN_CONFIG,
+    LATENCY_STAGE_INTERFACE_DELIVER,
+    LATENCY_STAGE_ATOMIC_COMMIT,
+    LATENCY_STAGE_PREV_FRAME_WAIT,
+    LATENCY_STAGE_MAX
+} hwc_latency_stage_t;
+
+/* Upper bound of each bucket in usec, the last bucket has no upper bound */
+constexpr std::array<uint32_t, 19> kLatencyBucketBounds = {
+    50, 100, 200, 300, 500, 750, 1000, 1500, 2000, 3000,
+    4000, 6000, 8000, 12000, 16000, 25000, 33000, 50000, UINT32_MAX};
+
+class ExynosLatencyStats : public Singleton<ExynosLatencyStats> {
+  public:
+    /**
+         * Records elapsed time of the scope to the stage of the display
+         */
+    class Scope {
+      public:
+        Scope(uint32_t displayId, hwc_latency_stage_t stage)
+            : mDisplayId(displayId), mStage(stage), mStart(systemTime(SYSTEM_TIME_MONOTONIC)){};
+        ~Scope() {
+            ExynosLatencyStats::getInstance().record(mDisplayId, mStage,
+                                                     systemTime(SYSTEM_TIME_MONOTONIC) - mStart);
+        };
+
+      private:
+        uint32_t mDisplayId;
+        hwc_latency_stage_t mStage;
+        nsecs_t mStart;
+    };
+
+    ExynosLatencyStats(){};
+    void record(uint32_t displayId, hwc_latency_stage_t stage, nsecs_t duration);
+    void reset();
+    void dump(String8 &result);
+    /* Percentile in usec of the stage, 0 if there is no sample */
+    uint32_t getPercentile(uint32_t displayId, hwc_latency_stage_t stage, uint32_t percent);
+    /* Copies the histogram of the stage, false if there is no sample */
+    bool getHistogram(uint32_t displayId, hwc_latency_stage_t stage,
+                      std::array<uint32_t, kLatencyBucketBounds.size()> &buckets,
+                      uint64_t &count, nsecs_t &max);
+
+  private:
+    struct StageHistogram {
+        std::array<uint32_t, kLatencyBucketBounds.size()> buckets = {};
+        uint64_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+        uint32_t getPercentile(uint32_t percent) const;
+    };
+    typedef std::array<StageHistogram, LATENCY_STAGE_MAX> DisplayHistogram;
+
+    std::mutex mMutex;
+    std::map<uint32_t, DisplayHistogram> mHistograms;
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ExynosPerfettoTrace.h"
+
+#ifdef USE_PERFETTO_TRACE
+
+#include "ExynosDisplay.h"
+#include "ExynosLayer.h"
+
+PERFETTO_TRACK_EVENT_STATIC_STORAGE();
+
+void ExynosPerfettoTrace::init() {
+    perfetto::TracingInitArgs args;
+    args.backends = perfetto::kSystemBackend;
+
+    perfetto::Tracing::Initialize(args);
+    perfetto::TrackEvent::Register();
+}
+
+void ExynosPerfettoTrace::annotateDisplay(perfetto::EventContext &ctx, ExynosDisplay *display) {
+    uint32_t clientLayers = 0;
+    std::string mpps;
+
+    for (size_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+
+        if (layer->mValidateCompositionType == HWC2_COMPOSITION_CLIENT)
+            clientLayers++;
+        if (i)
+            mpps += ",";
+        if (layer->mM2mMPP != NULL) {
+            mpps += layer->mM2mMPP->mName.string();
+            mpps += ">";
+        }
+        mpps += (layer->mOtfMPP != NULL) ? layer->mOtfMPP->mName.string() : "-";
+    }
+
+    ctx.AddDebugAnnotation("display", display->mDisplayId);
+    ctx.AddDebugAnnotation("layers", static_cast<uint64_t>(display->mLayers.size()));
+    ctx.AddDebugAnnotation("client_layers", clientLayers);
+    ctx.AddDebugAnnotation("mpps", mpps);
+}
+
+#endif
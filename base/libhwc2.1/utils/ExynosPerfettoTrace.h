@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSPERFETTOTRACE_H
+#define _EXYNOSPERFETTOTRACE_H
+
+/*
+ * Track events of the HWC pipeline in the "hwc" category
+ *
+ * With USE_PERFETTO_TRACE the spans are Perfetto SDK track events written
+ * to the shared memory buffer of the system backend; the arguments are
+ * debug annotations that are evaluated only if the category is enabled.
+ * Otherwise the spans fall back to ATRACE and the arguments are dropped.
+ *
+ *   HWC_TRACE_EVENT(name, "key", value, ...)    span of the enclosing scope
+ *   HWC_TRACE_BEGIN(name, "key", value, ...)    start of a span
+ *   HWC_TRACE_END_DISPLAY(display)              end of the span with the
+ *                                               layer state of @display
+ */
+#ifdef USE_PERFETTO_TRACE
+
+#include <perfetto/tracing.h>
+
+PERFETTO_DEFINE_CATEGORIES(
+    perfetto::Category("hwc").SetDescription("Validate, present and commit of HWC"));
+
+class ExynosDisplay;
+
+namespace ExynosPerfettoTrace {
+/* Connects to traced, called once at the start of the HAL */
+void init();
+/* display id, layer count, client layer count and the MPPs of the layers */
+void annotateDisplay(perfetto::EventContext &ctx, ExynosDisplay *display);
+}  // namespace ExynosPerfettoTrace
+
+#define HWC_TRACE_EVENT(name, ...) TRACE_EVENT("hwc", name, ##__VA_ARGS__)
+#define HWC_TRACE_BEGIN(name, ...) TRACE_EVENT_BEGIN("hwc", name, ##__VA_ARGS__)
+#define HWC_TRACE_END_DISPLAY(display)                               \
+    TRACE_EVENT_END("hwc", [&](perfetto::EventContext ctx) {         \
+        ExynosPerfettoTrace::annotateDisplay(ctx, display);          \
+    })
+
+#else
+
+#include <utils/Trace.h>
+
+namespace ExynosPerfettoTrace {
+static inline void init(){};
+}  // namespace ExynosPerfettoTrace
+
+#define HWC_TRACE_EVENT(name, ...) ATRACE_NAME(name)
+#define HWC_TRACE_BEGIN(name, ...) ATRACE_BEGIN(name)
+#define HWC_TRACE_END_DISPLAY(display) ATRACE_END()
+
+#endif
+
+#endif
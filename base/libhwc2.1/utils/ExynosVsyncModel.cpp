@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <cmath>
+#include "ExynosVsyncModel.h"
+
+void ExynosVsyncModel::reset() {
+    mHead = 0;
+    mCount = 0;
+    mPeriod = 0;
+    mPhase = 0;
+    mLastError = 0;
+}
+
+void ExynosVsyncModel::addVsync(nsecs_t timestamp, nsecs_t nominalPeriod) {
+    if (nominalPeriod <= 0)
+        return;
+
+    if (nominalPeriod != mNominalPeriod) {
+        reset();
+        mNominalPeriod = nominalPeriod;
+    }
+
+    if (mCount > 0) {
+        if (timestamp <= mLastTimestamp)
+            return;
+        /* Phase can be drifted while vsync is off */
+        if ((timestamp - mLastTimestamp) > (nominalPeriod * (nsecs_t)kMaxGapPeriods))
+            reset();
+    }
+
+    if (isValid())
+        mLastError = timestamp - getNextVsync(timestamp - mPeriod / 2);
+    mLastTimestamp = timestamp;
+
+    mTimestamps[mHead] = timestamp;
+    mHead = (mHead + 1) % kHistorySize;
+    if (mCount < kHistorySize)
+        mCount++;
+
+    if (mCount >= kMinSamples)
+        fit();
+}
+
+void ExynosVsyncModel::fit() {
+    uint32_t oldest = (mHead + kHistorySize - mCount) % kHistorySize;
+    nsecs_t base = mTimestamps[oldest];
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    double lastX = 0;
+
+    for (uint32_t i = 0; i < mCount; i++) {
+        nsecs_t y = mTimestamps[(oldest + i) % kHistorySize] - base;
+        /* Missed vsyncs are skipped by the index */
+        double x = std::round((double)y / mNominalPeriod);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+        lastX = x;
+    }
+
+    double n = mCount;
+    double denom = n * sumXX - sumX * sumX;
+    if (denom <= 0) {
+        mPeriod = 0;
+        return;
+    }
+
+    double slope = (n * sumXY - sumX * sumY) / denom;
+    double intercept = (sumY - slope * sumX) / n;
+    nsecs_t period = (nsecs_t)slope;
+    if (std::llabs(period - mNominalPeriod) * 100 >
+        mNominalPeriod * (nsecs_t)kMaxPeriodErrorRatio) {
+        mPeriod = 0;
+        return;
+    }
+
+    mPeriod = period;
+    mPhase = base + (nsecs_t)(intercept + slope * lastX);
+}
+
+nsecs_t ExynosVsyncModel::getNextVsync(nsecs_t time) const {
+    if ((!isValid()) ||
+        ((time - mLastTimestamp) > (mPeriod * (nsecs_t)kMaxPredictPeriods)))
+        return 0;
+
+    if (time < mPhase)
+        return mPhase - ((mPhase - time) / mPeriod) * mPeriod;
+
+    return mPhase + ((time - mPhase) / mPeriod + 1) * mPeriod;
+}
+
+void ExynosVsyncModel::dump(String8 &result) const {
+    result.appendFormat("vsync model: nominal(%" PRId64 " ns), fitted(%" PRId64 " ns), "
+                        "phase(%" PRId64 "), last error(%" PRId64 " ns), samples(%d)\n",
+                        mNominalPeriod, mPeriod, mPhase, mLastError, mCount);
+}
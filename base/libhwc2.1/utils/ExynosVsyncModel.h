@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSVSYNCMODEL_H
+#define _EXYNOSVSYNCMODEL_H
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <array>
+
+using namespace android;
+
+/*
+ * Vsync period and phase fitted to hardware vsync timestamps.
+ * Recent timestamps are fitted by least squares against their vsync index,
+ * so the prediction follows the actual clock of the panel instead of
+ * the nominal period of the config.
+ */
+class ExynosVsyncModel {
+  public:
+    static constexpr uint32_t kHistorySize = 16;
+    static constexpr uint32_t kMinSamples = 6;
+    /* History is restarted if vsync is not received for this number of periods */
+    static constexpr uint32_t kMaxGapPeriods = 8;
+    /* Fitted period can be different from the nominal one up to this ratio(%) */
+    static constexpr uint32_t kMaxPeriodErrorRatio = 5;
+    /* Phase is predicted up to this number of periods after the last vsync */
+    static constexpr uint32_t kMaxPredictPeriods = 120;
+
+    void reset();
+    void addVsync(nsecs_t timestamp, nsecs_t nominalPeriod);
+    bool isValid() const { return mPeriod > 0; };
+    /* Fitted period, nominal period is returned if the model is not valid */
+    nsecs_t getPeriod(nsecs_t nominalPeriod) const {
+        return isValid() ? mPeriod : nominalPeriod;
+    };
+    /* Predicted hardware vsync time after the time, 0 if the model is not valid */
+    nsecs_t getNextVsync(nsecs_t time) const;
+    void dump(String8 &result) const;
+
+  private:
+    void fit();
+
+    nsecs_t mNominalPeriod = 0;
+    std::array<nsecs_t, kHistorySize> mTimestamps = {};
+    uint32_t mHead = 0;
+    uint32_t mCount = 0;
+
+    nsecs_t mPeriod = 0;
+    /* Vsync time on the fitted line */
+    nsecs_t mPhase = 0;
+    nsecs_t mLastTimestamp = 0;
+    /* Error of the last timestamp from the prediction */
+    nsecs_t mLastError = 0;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <hardware/hardware.h>
+#include <log/log.h>
+#include "ExynosWorkerPool.h"
+
+ExynosWorkerPool::ExynosWorkerPool(const std::string &name, uint32_t threadNum)
+    : mName(name) {
+    for (uint32_t i = 0; i < threadNum; i++)
+        mThreads.emplace_back(&ExynosWorkerPool::loop, this, i);
+}
+
+ExynosWorkerPool::~ExynosWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mJobCondition.notify_all();
+    for (auto &thread : mThreads) {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void ExynosWorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+    mJobCondition.notify_one();
+}
+
+void ExynosWorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mJobs.empty() && (mRunningJobs == 0); });
+}
+
+void ExynosWorkerPool::loop(uint32_t index) {
+    std::string threadName = mName + std::to_string(index);
+    pthread_setname_np(pthread_self(), threadName.substr(0, 15).c_str());
+    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobCondition.wait(lock, [this] { return mStopped || !mJobs.empty(); });
+            if (mStopped && mJobs.empty())
+                return;
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+            mRunningJobs++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRunningJobs--;
+            if (mJobs.empty() && (mRunningJobs == 0))
+                mDoneCondition.notify_all();
+        }
+    }
+}
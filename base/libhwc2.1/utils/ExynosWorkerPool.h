@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSWORKERPOOL_H
+#define _EXYNOSWORKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed size thread pool for short jobs of a frame.
+ * Jobs are queued with submit() and wait() blocks until every queued job is done.
+ */
+class ExynosWorkerPool {
+  public:
+    ExynosWorkerPool(const std::string &name, uint32_t threadNum);
+    ~ExynosWorkerPool();
+
+    void submit(std::function<void()> job);
+    void wait();
+    size_t size() const { return mThreads.size(); };
+
+  private:
+    void loop(uint32_t index);
+
+    std::string mName;
+    std::vector<std::thread> mThreads;
+    std::deque<std::function<void()>> mJobs;
+    std::mutex mMutex;
+    std::condition_variable mJobCondition;
+    std::condition_variable mDoneCondition;
+    uint32_t mRunningJobs = 0;
+    bool mStopped = false;
+};
+
+#endif
@@ -21,8 +21,11 @@
 }                                       \
 
 #include <chrono>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #include "OneShotTimer.h"
-#include <utils/Timers.h>
 namespace {
 using namespace std::chrono_literals;
 constexpr int64_t kNsToSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(1s).count();
@@ -30,9 +33,11 @@ constexpr int64_t kNsToSeconds = std::chrono::duration_cast<std::chrono::nanosec
 // The syscall interface uses a pair of integers for the timestamp. The first
 // (tv_sec) is the whole count of seconds. The second (tv_nsec) is the
 // nanosecond part of the count. This function takes care of translation.
-void calculateTimeoutTime(std::chrono::nanoseconds timestamp, timespec* spec) {
-    auto timeout = systemTime(CLOCK_MONOTONIC) + timestamp.count();
-    spec->tv_sec = static_cast<__kernel_time_t>(timeout / kNsToSeconds);
+// steady_clock is CLOCK_MONOTONIC, the clock of mTimerFd.
+void calculateTimeoutTime(std::chrono::steady_clock::time_point time, timespec* spec) {
+    auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch())
+                           .count();
+    spec->tv_sec = static_cast<time_t>(timeout / kNsToSeconds);
     spec->tv_nsec = timeout % kNsToSeconds;
 }
 } // namespace
@@ -46,30 +51,55 @@ OneShotTimer::~OneShotTimer() {
 }
 
 void OneShotTimer::start() {
-    int result = sem_init(&mSemaphore, 0, 0);
-    LOG_ALWAYS_IF(result, "OneShotTimer::start(), sem_init failed");
+    if (mThread.joinable()) {
+        ALOGI("OneShotTimer::the thread is already started!");
+        return;
+    }
 
-    if (!mThread.joinable()) {
-        mThread = std::thread(&OneShotTimer::loop, this);
-    } else {
-    ALOGI("OneShotTimer::the thread is already started!");
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mTimerFd < 0 || mEventFd < 0 || mEpollFd < 0) {
+        ALOGE("OneShotTimer::start(), failed to create fds %d", errno);
+        closeFds();
+        return;
     }
+
+    struct epoll_event event = {.events = EPOLLIN};
+    event.data.fd = mTimerFd;
+    int result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &event);
+    event.data.fd = mEventFd;
+    result |= epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &event);
+    if (result) {
+        ALOGE("OneShotTimer::start(), epoll_ctl failed %d", errno);
+        closeFds();
+        return;
+    }
+
+    mThread = std::thread(&OneShotTimer::loop, this);
 }
 
 void OneShotTimer::stop() {
     mStopTriggered = true;
-    int result = sem_post(&mSemaphore);
-    LOG_ALWAYS_IF(result, "OneShotTimer::stop(), sem_post_failed");
+    if (mEventFd >= 0)
+        LOG_ALWAYS_IF(eventfd_write(mEventFd, 1), "OneShotTimer::stop(), eventfd_write failed");
 
     if (mThread.joinable()) {
         mThread.join();
-        result = sem_destroy(&mSemaphore);
-        LOG_ALWAYS_IF(result, "OneShotTimer::stop(), sem_destroy failed");
+        closeFds();
     } else {
         mStopTriggered = false;
     }
 }
 
+void OneShotTimer::closeFds() {
+    for (int *fd : {&mEpollFd, &mEventFd, &mTimerFd}) {
+        if (*fd >= 0)
+            close(*fd);
+        *fd = -1;
+    }
+}
+
 void OneShotTimer::setInterval(const Interval &interval) {
     stop();
     mInterval = interval;
@@ -87,9 +117,7 @@ void OneShotTimer::loop() {
             break;
 
         if (state == TimerState::IDLE) {
-            int result = sem_wait(&mSemaphore);
-            if (result && errno != EINTR)
-                ALOGE("OneShotTimer::loop(), sem_wait failed %d", errno);
+            waitForEvent();
             continue;
         }
 
@@ -107,13 +135,12 @@ void OneShotTimer::loop() {
         state = TimerState::WAITING;
         while (true) {
             // Wait until triggerTime time to check if we need to reset or drop into the idle state.
-            if (const auto triggerInterval = triggerTime - std::chrono::steady_clock::now(); triggerInterval > 0ns) {
+            // Resets while waiting only move mLastResetTime, the timer is re-armed from it
+            // when it expires.
+            if (triggerTime - std::chrono::steady_clock::now() > 0ns) {
                 mWaiting = true;
-                struct timespec ts;
-                calculateTimeoutTime(triggerInterval, &ts);
-                int result = sem_clockwait(&mSemaphore, CLOCK_MONOTONIC, &ts);
-                if (result && errno != ETIMEDOUT && errno != EINTR)
-                    ALOGE("OneShotTimer::loop(), sem_clockwait failed");
+                armTimer(triggerTime);
+                waitForEvent();
             }
 
             mWaiting = false;
@@ -155,10 +182,32 @@ void OneShotTimer::reset() {
     mLastResetTime = std::chrono::steady_clock::now();
     mResetTriggered = true;
     // If mWaiting is true, then we are guaranteed to be in a block where we are waiting on
-    // mSemaphore for a timeout, rather than idling. So we can avoid a sem_post call since we can
-    // just check that we triggered a reset on timeout.
-    if (!mWaiting)
-        LOG_ALWAYS_IF(sem_post(&mSemaphore), "OneShotTimer::reset(), sem_post failed");
+    // mTimerFd for a timeout, rather than idling. So we can avoid waking the thread up since
+    // we can just check that we triggered a reset on timeout. A reset of every frame is only
+    // these stores.
+    if (!mWaiting && mEventFd >= 0)
+        LOG_ALWAYS_IF(eventfd_write(mEventFd, 1), "OneShotTimer::reset(), eventfd_write failed");
+}
+
+void OneShotTimer::armTimer(std::chrono::steady_clock::time_point triggerTime) {
+    struct itimerspec spec = {};
+    calculateTimeoutTime(triggerTime, &spec.it_value);
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr))
+        ALOGE("OneShotTimer::armTimer(), timerfd_settime failed %d", errno);
+}
+
+void OneShotTimer::waitForEvent() {
+    struct epoll_event events[2];
+    int num = epoll_wait(mEpollFd, events, 2, -1);
+    if (num < 0 && errno != EINTR)
+        ALOGE("OneShotTimer::waitForEvent(), epoll_wait failed %d", errno);
+
+    // Every wakeup posted while the thread was running is drained at once.
+    for (int i = 0; i < num; i++) {
+        uint64_t count;
+        if (read(events[i].data.fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            ALOGE("OneShotTimer::waitForEvent(), read failed %d", errno);
+    }
 }
 
 bool OneShotTimer::isTimerRunning() {
@@ -18,7 +18,6 @@
 #define _ONESHOTTIMER_H
 
 #include <android-base/thread_annotations.h>
-#include <semaphore.h>
 #include <chrono>
 #include <condition_variable>
 #include <thread>
@@ -71,11 +70,20 @@ class OneShotTimer {
     // mState if so.
     TimerState checkForResetAndStop(TimerState state);
 
+    // Arms mTimerFd to expire at triggerTime.
+    void armTimer(std::chrono::steady_clock::time_point triggerTime);
+    // Waits until mTimerFd expires or mEventFd is signaled, and drains both.
+    void waitForEvent();
+    void closeFds();
+
     // Thread waiting for timer to expire.
     std::thread mThread;
 
-    // Semaphore to keep mThread synchronized.
-    sem_t mSemaphore;
+    // mThread waits on mEpollFd for the expiry of mTimerFd or for mEventFd,
+    // which is signaled to stop the thread or to wake it up from IDLE.
+    int mTimerFd = -1;
+    int mEventFd = -1;
+    int mEpollFd = -1;
 
     // Interval after which timer expires.
     Interval mInterval;
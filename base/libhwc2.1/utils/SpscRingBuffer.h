@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SPSCRINGBUFFER_H
+#define _SPSCRINGBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Lock-free ring buffer for one producer thread and one consumer.
+ * Consumer can be several threads if they are serialized by a lock.
+ * Size must be power of two.
+ */
+template <typename T, size_t N>
+class SpscRingBuffer {
+    static_assert((N != 0) && ((N & (N - 1)) == 0), "size should be power of two");
+
+  public:
+    bool push(const T &item) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if ((head - mTail.load(std::memory_order_acquire)) >= N)
+            return false;
+        mItems[head & (N - 1)] = item;
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    };
+    bool pop(T &item) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire))
+            return false;
+        item = mItems[tail & (N - 1)];
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    };
+    bool empty() const {
+        return mTail.load(std::memory_order_acquire) ==
+               mHead.load(std::memory_order_acquire);
+    };
+
+  private:
+    std::array<T, N> mItems;
+    std::atomic<size_t> mHead = 0;
+    std::atomic<size_t> mTail = 0;
+};
+
+#endif
@@ -23,12 +23,15 @@
 #include "ExynosGraphicBuffer.h"
 
 #include <cutils/properties.h>
+#include <algorithm>
 
 using vendor::graphics::BufferUsage;
 using vendor::graphics::ExynosGraphicBufferUsage;
 
 #define SKIP_FRAME_COUNT_FOR_FB_INTERFACE 5
 #define SKIP_FRAME_COUNT_FOR_DRM_INTERFACE 1
+/* About a half second at 60Hz */
+#define DEFAULT_MAX_STATIC_SKIP_COUNT 30
 
 extern struct exynos_hwc_control exynosHWCControl;
 
@@ -45,16 +48,23 @@ ExynosVirtualDisplay::ExynosVirtualDisplay(DisplayIdentifier node)
     mPresentationMode = false;
 
     mSkipFrameCount = -1;
+    mSkippedFrameCount = 0;
+    mMaxStaticSkipCount = property_get_int32("vendor.hwc.wfd.max_static_skip",
+                                             DEFAULT_MAX_STATIC_SKIP_COUNT);
 
     // TODO : Hard coded currently
     mNumMaxPriorityAllowed = 1;
 
     mDisplayWidth = 0;
     mDisplayHeight = 0;
+    mSurfaceWidth = 0;
+    mSurfaceHeight = 0;
     mOutputBuffer = NULL;
     mCompositionType = COMPOSITION_GLES;
     mGLESFormat = HAL_PIXEL_FORMAT_RGBA_8888;
     mSinkUsage = BufferUsage::COMPOSER_OVERLAY | BufferUsage::VIDEO_ENCODER;
+    mEncoderFormat = 0;
+    mSinkFormat = mGLESFormat;
     mIsSecureDRM = false;
     mIsNormalDRM = false;
     mNeedReloadResourceForHWFC = false;
@@ -66,9 +76,16 @@ ExynosVirtualDisplay::ExynosVirtualDisplay(DisplayIdentifier node)
     mDisplayControl.enableExynosCompositionOptimization = false;
     mIsFirstFrameDisplayed = false;
     mExternalPlugState = false;
+
+    mLatencyRing = wfd_latency_ring_create(&mLatencyRingFd);
+    if (mLatencyRing == NULL)
+        DISPLAY_LOGE("failed to create WFD latency trace ring");
 }
 
 ExynosVirtualDisplay::~ExynosVirtualDisplay() {
+    wfd_latency_ring_unmap(mLatencyRing);
+    if (mLatencyRingFd >= 0)
+        close(mLatencyRingFd);
 }
 
 void ExynosVirtualDisplay::createVirtualDisplay(uint32_t width, uint32_t height, int32_t *format) {
@@ -82,6 +99,8 @@ void ExynosVirtualDisplay::createVirtualDisplay(uint32_t width, uint32_t height,
     mPlugState = true;
     mDisplayWidth = width;
     mDisplayHeight = height;
+    mSurfaceWidth = width;
+    mSurfaceHeight = height;
     mXres = width;
     mYres = height;
     mGLESFormat = *format;
@@ -95,6 +114,7 @@ void ExynosVirtualDisplay::createVirtualDisplay(uint32_t width, uint32_t height,
         mIsFirstFrameDisplayed = false;
         mDisplayInterface->setRepeaterBuffer(true);
     }
+    mSkippedFrameCount = 0;
     mPowerModeState = HWC2_POWER_MODE_ON;
 }
 
@@ -113,6 +133,8 @@ void ExynosVirtualDisplay::destroyVirtualDisplay() {
     mPlugState = false;
     mDisplayWidth = 0;
     mDisplayHeight = 0;
+    mSurfaceWidth = 0;
+    mSurfaceHeight = 0;
     mXres = 0;
     mYres = 0;
     mMinTargetLuminance = 0;
@@ -120,6 +142,8 @@ void ExynosVirtualDisplay::destroyVirtualDisplay() {
     mSinkDeviceType = 0;
     mCompositionType = COMPOSITION_HWC;
     mGLESFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+    mEncoderFormat = 0;
+    mSinkFormat = mGLESFormat;
 
     mNeedReloadResourceForHWFC = false;
 
@@ -152,7 +176,7 @@ int ExynosVirtualDisplay::getWFDInfo(int32_t *state, int32_t *compositionType, i
     else if (mIsSecureDRM && !mIsSecureVDSState)
         *format = (int32_t)HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN;
     else
-        *format = (int32_t)mGLESFormat;
+        *format = (int32_t)mSinkFormat;
     *usage = mSinkUsage;
     *width = mDisplayWidth;
     *height = mDisplayHeight;
@@ -184,6 +208,10 @@ int ExynosVirtualDisplay::sendWFDCommand(int32_t cmd, int32_t ext1, int32_t ext2
         /* ext1: type, ext2: unused */
         mSinkDeviceType = ext1;
         break;
+    case SET_ENCODER_FORMAT:
+        /* ext1: format, 0 to disable, ext2: unused */
+        mEncoderFormat = ext1;
+        break;
     default:
         DISPLAY_LOGE("invalid cmd(%d)", cmd);
         break;
@@ -229,6 +257,17 @@ int ExynosVirtualDisplay::setVDSGlesFormat(int format) {
     return HWC2_ERROR_NONE;
 }
 
+void ExynosVirtualDisplay::dumpWFDLatency(String8 &result) {
+    if (mLatencyRing == NULL)
+        return;
+
+    std::vector<char> buf(WFD_LATENCY_RING_SIZE * 64);
+    wfd_latency_ring_dump(mLatencyRing, buf.data(), buf.size());
+
+    result.appendFormat("WFD latency trace\n");
+    result.append(buf.data());
+}
+
 bool ExynosVirtualDisplay::is2StepBlendingRequired(exynos_image &src, buffer_handle_t outbuf) {
     return false;
 }
@@ -268,6 +307,8 @@ void ExynosVirtualDisplay::doPreProcessing(
     if (mUseDpu)
         return;
 
+    scaleLayersToSink();
+
     /*
      * If there is layer that has priority higher than ePriorityMid
      * exynos composition handles only one layer that has the highest priority.
@@ -301,6 +342,56 @@ void ExynosVirtualDisplay::doPreProcessing(
     }
 }
 
+bool ExynosVirtualDisplay::isScaledToSink() {
+    /* The writeback of DPU doesn't scale the output */
+    if (mUseDpu || (mSurfaceWidth == 0) || (mSurfaceHeight == 0))
+        return false;
+
+    return (mSurfaceWidth != mXres) || (mSurfaceHeight != mYres);
+}
+
+void ExynosVirtualDisplay::scaleLayersToSink() {
+    if (!isScaledToSink())
+        return;
+
+    auto scale = [](int32_t pos, uint32_t to, uint32_t from) -> int32_t {
+        return (int32_t)(((int64_t)pos * to) / from);
+    };
+
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        hwc_rect_t &frame = layer->mPreprocessedInfo.displayFrame;
+
+        frame.left = scale(frame.left, mXres, mSurfaceWidth);
+        frame.top = scale(frame.top, mYres, mSurfaceHeight);
+        frame.right = std::max(scale(frame.right, mXres, mSurfaceWidth), frame.left + 1);
+        frame.bottom = std::max(scale(frame.bottom, mYres, mSurfaceHeight), frame.top + 1);
+
+        exynos_image srcImg;
+        exynos_image dstImg;
+        layer->setSrcExynosImage(&srcImg);
+        layer->setDstExynosImage(&dstImg);
+        layer->setExynosImage(srcImg, dstImg);
+    }
+
+    DISPLAY_LOGD(eDebugVirtualDisplay, "%s:: %ux%u to %ux%u", __func__,
+                 mSurfaceWidth, mSurfaceHeight, mXres, mYres);
+}
+
+int32_t ExynosVirtualDisplay::setCompositionTargetExynosImage(uint32_t targetType,
+                                                              exynos_image *src_img,
+                                                              exynos_image *dst_img) {
+    int32_t ret = ExynosDisplay::setCompositionTargetExynosImage(targetType, src_img, dst_img);
+
+    /* The client target is rendered in the resolution of surfaceflinger */
+    if ((targetType == COMPOSITION_CLIENT) && isScaledToSink()) {
+        src_img->fullWidth = src_img->w = mSurfaceWidth;
+        src_img->fullHeight = src_img->h = mSurfaceHeight;
+    }
+
+    return ret;
+}
+
 int32_t ExynosVirtualDisplay::preProcessValidate(
     DeviceValidateInfo &validateInfo,
     uint64_t &geometryChanged) {
@@ -323,10 +414,13 @@ int32_t ExynosVirtualDisplay::postProcessValidate() {
         handleSkipFrame();
         if (mSkipFrameCount > 0)
             mSkipFrameCount--;
+        mSkippedFrameCount++;
     } else {
+        mSkippedFrameCount = 0;
         setDrmMode();
         setSinkBufferUsage();
         setCompositionType();
+        setSinkFormat();
         mIsFirstFrameDisplayed = true;
     }
 
@@ -353,8 +447,13 @@ int32_t ExynosVirtualDisplay::presentDisplay(
         return ret;
     }
 
+    uint64_t frameId = wfd_latency_new_frame(mLatencyRing);
+    wfd_latency_trace_at(mLatencyRing, frameId, WFD_LATENCY_HWC_PRESENT, systemTime(SYSTEM_TIME_MONOTONIC));
+
     ret = ExynosDisplay::presentDisplay(presentInfo, outPresentFence);
 
+    wfd_latency_trace_at(mLatencyRing, frameId, WFD_LATENCY_HWC_COMMIT, systemTime(SYSTEM_TIME_MONOTONIC));
+
     if (!mUseDpu && *outPresentFence == -1 && mOutputBufferAcquireFenceFd >= 0) {
         *outPresentFence = mOutputBufferAcquireFenceFd;
         mOutputBufferAcquireFenceFd = -1;
@@ -481,6 +580,40 @@ void ExynosVirtualDisplay::setSinkBufferUsage() {
         mSinkUsage |= ExynosGraphicBufferUsage::PRIVATE_NONSECURE;
 }
 
+/*
+ * The output buffer is written by the writeback of DPU or by G2D of the
+ * exynos composition in every composition type, so it can be in the format
+ * of the encoder if the writer supports it. The encoder then reads the
+ * output without its own conversion from RGB.
+ */
+void ExynosVirtualDisplay::setSinkFormat() {
+    mSinkFormat = mGLESFormat;
+
+    if ((mEncoderFormat == 0) || mIsSecureVDSState || mIsSecureDRM)
+        return;
+
+    ExynosFormat encoderFormat(mEncoderFormat);
+    if (!encoderFormat.isYUV())
+        return;
+
+    if (mUseDpu) {
+        /* The writeback of DPU doesn't write the compressed formats */
+        if (encoderFormat.isSBWC())
+            return;
+    } else {
+        ExynosMPP *m2mMPP = mExynosCompositionInfo.mM2mMPP;
+        if (m2mMPP == NULL)
+            return;
+        exynos_image dstImg;
+        dstImg.exynosFormat = encoderFormat;
+        if (!m2mMPP->isDstFormatSupported(dstImg))
+            return;
+    }
+
+    mSinkFormat = mEncoderFormat;
+    DISPLAY_LOGD(eDebugVirtualDisplay, "%s:: output in encoder format(0x%x)", __func__, mSinkFormat);
+}
+
 void ExynosVirtualDisplay::setCompositionType() {
     size_t compositionClientLayerCount = 0;
     size_t CompositionDeviceLayerCount = 0;
@@ -517,6 +650,7 @@ void ExynosVirtualDisplay::initPerFrameData() {
     mIsNormalDRM = false;
     mCompositionType = COMPOSITION_HWC;
     mSinkUsage = BufferUsage::COMPOSER_OVERLAY | BufferUsage::VIDEO_ENCODER;
+    mSinkFormat = mGLESFormat;
 }
 
 bool ExynosVirtualDisplay::checkSkipFrame() {
@@ -545,9 +679,41 @@ bool ExynosVirtualDisplay::checkSkipFrame() {
         return true;
     }
 
+    if (checkStaticFrame()) {
+        DISPLAY_LOGD(eDebugVirtualDisplay, "%s:: static frame", __func__);
+        return true;
+    }
+
     return false;
 }
 
+bool ExynosVirtualDisplay::checkStaticFrame() {
+    bool useRepeater = (mIsWFDState == LLWFD) && mUseDpu;
+
+    if (!mIsFirstFrameDisplayed)
+        return false;
+
+    if (!useRepeater && (mSkippedFrameCount >= mMaxStaticSkipCount))
+        return false;
+
+    if (mGeometryChanged != 0)
+        return false;
+
+    /* mLastLayerBuffer is updated only by the composed frames */
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        if (layer->mLastLayerBuffer != layer->mLayerBuffer)
+            return false;
+        /* The same buffer is drawn again, e.g. by front buffer rendering */
+        for (auto &rect : layer->mDamageRects) {
+            if ((rect.left != rect.right) && (rect.top != rect.bottom))
+                return false;
+        }
+    }
+
+    return true;
+}
+
 void ExynosVirtualDisplay::setDrmMode() {
     mIsSecureDRM = false;
     for (size_t i = 0; i < mLayers.size(); i++) {
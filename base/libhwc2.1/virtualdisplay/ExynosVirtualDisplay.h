@@ -18,6 +18,7 @@
 
 #include "ExynosHWCDebug.h"
 #include "ExynosDisplay.h"
+#include "wfd_latency_trace.h"
 
 #define VIRTUAL_DISLAY_SKIP_LAYER 0x00000100
 
@@ -27,6 +28,7 @@ enum WFDCommand {
     SET_WFD_MODE,
     SET_TARGET_DISPLAY_LUMINANCE,
     SET_TARGET_DISPLAY_DEVICE,
+    SET_ENCODER_FORMAT,
 };
 
 class ExynosVirtualDisplay : public ExynosDisplay {
@@ -56,6 +58,10 @@ class ExynosVirtualDisplay : public ExynosDisplay {
     int getPresentationMode(void);
     int setVDSGlesFormat(int format);
 
+    /* fd of the WFD latency trace ring that is shared with the WFD engine */
+    int getWFDLatencyRing() { return mLatencyRingFd; }
+    void dumpWFDLatency(String8 &result);
+
     /* setOutputBuffer(..., buffer, releaseFence)
      * Descriptor: HWC2_FUNCTION_SET_OUTPUT_BUFFER
      * HWC2_PFN_SET_OUTPUT_BUFFER
@@ -71,6 +77,9 @@ class ExynosVirtualDisplay : public ExynosDisplay {
     virtual void doPreProcessing(DeviceValidateInfo &validateInfo,
                                  uint64_t &geometryChanged) override;
 
+    virtual int32_t setCompositionTargetExynosImage(uint32_t targetType, exynos_image *src_img,
+                                                    exynos_image *dst_img) override;
+
     virtual int32_t preProcessValidate(DeviceValidateInfo &validateInfo,
                                        uint64_t &geometryChanged) override;
     virtual int32_t postProcessValidate() override;
@@ -148,6 +157,14 @@ class ExynosVirtualDisplay : public ExynosDisplay {
 
     int mSkipFrameCount;
 
+    /**
+     * the number of the consecutive skipped frames and the maximum number
+     * of the static frames that are skipped in a row, 0 not to skip them.
+     * The frame after the maximum is composed to keep the encoder alive.
+     */
+    uint32_t mSkippedFrameCount;
+    uint32_t mMaxStaticSkipCount;
+
     /**
      * reload the G2D instance to remove the shared buffer for HWFC
      */
@@ -169,6 +186,8 @@ class ExynosVirtualDisplay : public ExynosDisplay {
   protected:
     void setSinkBufferUsage();
 
+    void setSinkFormat();
+
     void setCompositionType();
 
     void setDrmMode();
@@ -177,16 +196,40 @@ class ExynosVirtualDisplay : public ExynosDisplay {
 
     bool checkSkipFrame();
 
+    /*
+     * A frame without new layer buffers, damage or geometry change since the
+     * last composed frame is not composed. In LLWFD, the repeater keeps the
+     * last written frame and it is repeated to the encoder. Otherwise the
+     * encoder gets a frame after mMaxStaticSkipCount skipped frames.
+     */
+    bool checkStaticFrame();
+
     void handleSkipFrame();
 
     void handleAcquireFence();
 
+    /*
+     * The layers are placed in the resolution of surfaceflinger. If the sink
+     * resolution is different, the display frames are scaled to the sink
+     * resolution so G2D scales the layers to the output in one pass.
+     */
+    bool isScaledToSink();
+    void scaleLayersToSink();
+
     /**
      * Display width, height information set by surfaceflinger
      */
     unsigned int mDisplayWidth;
     unsigned int mDisplayHeight;
 
+    /**
+     * width, height of the layer coordinates and the client target,
+     * mDisplayWidth and mDisplayHeight are changed to the sink resolution
+     * by setWFDOutputResolution().
+     */
+    unsigned int mSurfaceWidth;
+    unsigned int mSurfaceHeight;
+
     /**
      * output buffer and fence are set by setOutputBuffer()
      */
@@ -201,6 +244,9 @@ class ExynosVirtualDisplay : public ExynosDisplay {
 
     bool mPresentationMode;
 
+    struct wfd_latency_ring *mLatencyRing;
+    int mLatencyRingFd;
+
     /**
      * If mIsRotationState is true,
      * VurtualDisplaySurface don't queue graphic buffer
@@ -217,6 +263,14 @@ class ExynosVirtualDisplay : public ExynosDisplay {
      */
     int64_t mSinkUsage;
 
+    /**
+     * pixel format that the encoder of the WFD engine reads directly,
+     * 0 if the encoder converts the output itself.
+     * mSinkFormat is the format of the output buffer of the current frame.
+     */
+    int32_t mEncoderFormat;
+    int32_t mSinkFormat;
+
     /**
      * If mIsSecureDRM is true, DPU composition is used.
      * Otherwise, G2D composition is used.
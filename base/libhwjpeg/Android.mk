@@ -28,7 +28,8 @@ LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
 
 LOCAL_SRC_FILES := hwjpeg-base.cpp hwjpeg-v4l2.cpp ExynosJpegEncoder.cpp \
                    LibScalerForJpeg.cpp AppMarkerWriter.cpp ExynosJpegEncoderForCamera.cpp \
-                   libhwjpeg-exynos.cpp ThumbnailScaler.cpp GiantThumbnailScaler.cpp G2dThumbnailScaler.cpp
+                   libhwjpeg-exynos.cpp ThumbnailScaler.cpp GiantThumbnailScaler.cpp G2dThumbnailScaler.cpp \
+                   ExynosJpegEncoderPool.cpp
 
 LOCAL_MODULE := libhwjpeg
 LOCAL_MODULE_TAGS := optional
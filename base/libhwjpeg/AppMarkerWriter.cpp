@@ -44,12 +44,13 @@ CEndianessChecker::CEndianessChecker()
 
 
 CAppMarkerWriter::CAppMarkerWriter()
-        : m_pAppBase(NULL), m_pApp1End(NULL), m_pExif(NULL), m_pExtra(NULL)
+        : m_pAppBase(NULL), m_pApp1End(NULL), m_pExif(NULL), m_pExtra(NULL), m_szThumbSizeOffset(0)
 {
     Init();
 }
 
 CAppMarkerWriter::CAppMarkerWriter(char *base, exif_attribute_t *exif, debug_attribute_t *debug)
+        : m_szThumbSizeOffset(0)
 {
     extra_appinfo_t extraInfo;
     app_info_t appInfo[15];
@@ -291,6 +292,133 @@ void CAppMarkerWriter::PrepareAppWriter(char *base, exif_attribute_t *exif, extr
     ALOGI("APP1: %u bytes(ThumbMax %zu)", m_szApp1, m_szMaxThumbSize);
 }
 
+template <typename T>
+static inline void AppendExifKey(std::vector<char> &key, const T &val)
+{
+    const char *p = reinterpret_cast<const char *>(&val);
+    key.insert(key.end(), p, p + sizeof(val));
+}
+
+static inline void AppendExifKey(std::vector<char> &key, const void *data, size_t len)
+{
+    const char *p = reinterpret_cast<const char *>(data);
+    key.insert(key.end(), p, p + len);
+}
+
+static inline size_t GetGPSProcessingMethodLength(exif_attribute_t *exif)
+{
+    return min(strlen(exif->gps_processing_method), static_cast<size_t>(99UL));
+}
+
+// The key of the template with the layout of APP1 and the values that are not patched
+void CAppMarkerWriter::MakeExifKey(std::vector<char> &key)
+{
+    key.clear();
+
+    AppendExifKey(key, m_szApp1);
+    AppendExifKey(key, m_n0thIFDFields);
+    AppendExifKey(key, m_n1stIFDFields);
+    AppendExifKey(key, m_nExifIFDFields);
+    AppendExifKey(key, m_nGPSIFDFields);
+    AppendExifKey(key, m_szUniqueID);
+    AppendExifKey(key, m_szOffsetTime);
+    AppendExifKey(key, m_pExif->maker_note_size);
+    AppendExifKey(key, m_pExif->user_comment_size);
+    AppendExifKey(key, m_pExif->enableGps);
+    AppendExifKey(key, m_pExif->enableThumb);
+
+    AppendExifKey(key, m_szMake);
+    AppendExifKey(key, m_pExif->maker, m_szMake);
+    AppendExifKey(key, m_szModel);
+    AppendExifKey(key, m_pExif->model, m_szModel);
+    AppendExifKey(key, m_szSoftware);
+    AppendExifKey(key, m_pExif->software, m_szSoftware);
+    AppendExifKey(key, m_pExif->x_resolution);
+    AppendExifKey(key, m_pExif->y_resolution);
+    AppendExifKey(key, m_pExif->resolution_unit);
+    AppendExifKey(key, m_pExif->ycbcr_positioning);
+    AppendExifKey(key, m_pExif->exif_version, 4);
+    AppendExifKey(key, m_pExif->fnumber);
+    AppendExifKey(key, m_pExif->aperture);
+    AppendExifKey(key, m_pExif->max_aperture);
+    AppendExifKey(key, m_pExif->focal_length);
+    AppendExifKey(key, m_pExif->focal_length_in_35mm_length);
+    AppendExifKey(key, m_pExif->color_space);
+    AppendExifKey(key, m_pExif->interoperability_index);
+    AppendExifKey(key, m_pExif->compression_scheme);
+
+    if (m_pExif->enableGps) {
+        AppendExifKey(key, m_pExif->gps_version_id, 4);
+        AppendExifKey(key, GetGPSProcessingMethodLength(m_pExif));
+    }
+}
+
+void CAppMarkerWriter::AddExifPatch(char *value, size_t length, int type,
+                                    const void *(*source)(const exif_attribute_t *exif))
+{
+    ALOG_ASSERT(value != NULL);
+
+    ExifPatch patch;
+
+    patch.offset = static_cast<uint16_t>(PTR_DIFF(m_pAppBase, value));
+    patch.length = static_cast<uint16_t>(length);
+    patch.type = type;
+    patch.source = source;
+
+    m_ExifPatches.push_back(patch);
+}
+
+void CAppMarkerWriter::SaveExifTemplate(char *end)
+{
+    m_ExifTemplate.assign(m_pAppBase, end);
+    m_ExifTemplateKey.swap(m_ExifKey);
+}
+
+char *CAppMarkerWriter::PatchAPP1(char *base, bool reserve_thumbnail_space)
+{
+    memcpy(base, m_ExifTemplate.data(), m_ExifTemplate.size());
+
+    uint16_t len = m_szApp1;
+    if (reserve_thumbnail_space)
+        len += m_szMaxThumbSize + JPEG_APP1_OEM_RESERVED;
+    WriteDataInBig(base + JPEG_MARKER_SIZE, len);
+
+    for (auto &patch : m_ExifPatches) {
+        char *value = base + patch.offset;
+        const char *source = reinterpret_cast<const char *>(patch.source(m_pExif));
+
+        switch (patch.type) {
+            case EXIF_PATCH_BYTES:
+                memcpy(value, source, patch.length);
+                break;
+            case EXIF_PATCH_ASCII:
+                memcpy(value, source, patch.length);
+                value[patch.length - 1] = '\0';
+                break;
+            case EXIF_PATCH_CSTRING:
+                strncpy(value, source, patch.length);
+                value[patch.length - 1] = '\0';
+                break;
+        }
+    }
+
+    char *end = base + m_ExifTemplate.size();
+
+    if (m_pExif->enableThumb) {
+        m_pThumbSizePlaceholder = base + m_szThumbSizeOffset;
+        if (reserve_thumbnail_space)
+            end += m_szMaxThumbSize + JPEG_APP1_OEM_RESERVED;
+    }
+
+    return end;
+}
+
+// Records the value of the last tag of @writer to be updated with @field in
+// the later shots. @field is an expression of exif.
+#define EXIF_PATCH(writer, len, type, field)                            \
+        AddExifPatch((writer).GetLastValueAddress(), len, type,         \
+                     [] (const exif_attribute_t *exif) -> const void * { return field; })
+
 #define APPMARKLEN (JPEG_MARKER_SIZE + JPEG_SEGMENT_LENFIELD_SIZE)
 char *CAppMarkerWriter::WriteAPP11(char *current, size_t dummy, size_t align)
 {
@@ -344,6 +472,14 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     if (!m_pExif)
         return current;
 
+    if (!updating) {
+        MakeExifKey(m_ExifKey);
+        if (!m_ExifTemplate.empty() && (m_ExifKey == m_ExifTemplateKey))
+            return PatchAPP1(current, reserve_thumbnail_space);
+    }
+
+    m_ExifPatches.clear();
+
     // APP1 Marker
     *current++ = 0xFF;
     *current++ = 0xE1;
@@ -369,6 +505,7 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     CIFDWriter writer(tiffheader, current, m_n0thIFDFields);
 
     writer.WriteShort(EXIF_TAG_ORIENTATION, 1, &m_pExif->orientation);
+    EXIF_PATCH(writer, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->orientation);
     writer.WriteShort(EXIF_TAG_YCBCR_POSITIONING, 1, &m_pExif->ycbcr_positioning);
     writer.WriteRational(EXIF_TAG_X_RESOLUTION, 1, &m_pExif->x_resolution);
     writer.WriteRational(EXIF_TAG_Y_RESOLUTION, 1, &m_pExif->y_resolution);
@@ -380,54 +517,87 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     if (m_szSoftware > 0)
         writer.WriteASCII(EXIF_TAG_SOFTWARE, m_szSoftware + 1, m_pExif->software);
     writer.WriteCString(EXIF_TAG_DATE_TIME, EXIF_DATETIME_LENGTH, m_pExif->date_time);
+    EXIF_PATCH(writer, EXIF_DATETIME_LENGTH, EXIF_PATCH_CSTRING, exif->date_time);
 
     char *pSubIFDBase = writer.BeginSubIFD(EXIF_TAG_EXIF_IFD_POINTER);
     if (pSubIFDBase) { // This should be always true!!
         CIFDWriter exifwriter(tiffheader, pSubIFDBase, m_nExifIFDFields);
         exifwriter.WriteRational(EXIF_TAG_EXPOSURE_TIME, 1, &m_pExif->exposure_time);
+        EXIF_PATCH(exifwriter, sizeof(rational_t), EXIF_PATCH_BYTES, &exif->exposure_time);
         exifwriter.WriteRational(EXIF_TAG_FNUMBER, 1, &m_pExif->fnumber);
         exifwriter.WriteShort(EXIF_TAG_EXPOSURE_PROGRAM, 1, &m_pExif->exposure_program);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->exposure_program);
         exifwriter.WriteShort(EXIF_TAG_ISO_SPEED_RATING, 1, &m_pExif->iso_speed_rating);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->iso_speed_rating);
         exifwriter.WriteUndef(EXIF_TAG_EXIF_VERSION, 4, reinterpret_cast<unsigned char *>(m_pExif->exif_version));
         exifwriter.WriteCString(EXIF_TAG_DATE_TIME_ORG, EXIF_DATETIME_LENGTH, m_pExif->date_time);
+        EXIF_PATCH(exifwriter, EXIF_DATETIME_LENGTH, EXIF_PATCH_CSTRING, exif->date_time);
         exifwriter.WriteCString(EXIF_TAG_DATE_TIME_DIGITIZE, EXIF_DATETIME_LENGTH, m_pExif->date_time);
+        EXIF_PATCH(exifwriter, EXIF_DATETIME_LENGTH, EXIF_PATCH_CSTRING, exif->date_time);
         if (m_szOffsetTime > 0) {
             exifwriter.WriteCString(EXIF_TAG_OFFSET_TIME, EXIF_OFFSETTIME_LENGTH, m_pExif->offset_time);
+            EXIF_PATCH(exifwriter, EXIF_OFFSETTIME_LENGTH, EXIF_PATCH_CSTRING, exif->offset_time);
             exifwriter.WriteCString(EXIF_TAG_OFFSET_TIME_ORG, EXIF_OFFSETTIME_LENGTH, m_pExif->offset_time);
+            EXIF_PATCH(exifwriter, EXIF_OFFSETTIME_LENGTH, EXIF_PATCH_CSTRING, exif->offset_time);
             exifwriter.WriteCString(EXIF_TAG_OFFSET_TIME_DIGITIZE, EXIF_OFFSETTIME_LENGTH, m_pExif->offset_time);
+            EXIF_PATCH(exifwriter, EXIF_OFFSETTIME_LENGTH, EXIF_PATCH_CSTRING, exif->offset_time);
         }
         exifwriter.WriteSRational(EXIF_TAG_SHUTTER_SPEED, 1, &m_pExif->shutter_speed);
+        EXIF_PATCH(exifwriter, sizeof(srational_t), EXIF_PATCH_BYTES, &exif->shutter_speed);
         exifwriter.WriteRational(EXIF_TAG_APERTURE, 1, &m_pExif->aperture);
         exifwriter.WriteSRational(EXIF_TAG_BRIGHTNESS, 1, &m_pExif->brightness);
+        EXIF_PATCH(exifwriter, sizeof(srational_t), EXIF_PATCH_BYTES, &exif->brightness);
         exifwriter.WriteSRational(EXIF_TAG_EXPOSURE_BIAS, 1, &m_pExif->exposure_bias);
+        EXIF_PATCH(exifwriter, sizeof(srational_t), EXIF_PATCH_BYTES, &exif->exposure_bias);
         exifwriter.WriteRational(EXIF_TAG_MAX_APERTURE, 1, &m_pExif->max_aperture);
         exifwriter.WriteShort(EXIF_TAG_METERING_MODE, 1, &m_pExif->metering_mode);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->metering_mode);
         exifwriter.WriteShort(EXIF_TAG_FLASH, 1, &m_pExif->flash);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->flash);
         exifwriter.WriteUndef(EXIF_TAG_FLASHPIX_VERSION, 4, reinterpret_cast<const unsigned char *>("0100"));
         exifwriter.WriteUndef(EXIF_TAG_COMPONENTS_CONFIGURATION, 4, ComponentsConfiguration);
         exifwriter.WriteRational(EXIF_TAG_FOCAL_LENGTH, 1, &m_pExif->focal_length);
         exifwriter.WriteCString(EXIF_TAG_SUBSEC_TIME, EXIF_SUBSECTIME_LENGTH, m_pExif->sec_time);
+        EXIF_PATCH(exifwriter, EXIF_SUBSECTIME_LENGTH, EXIF_PATCH_CSTRING, exif->sec_time);
         exifwriter.WriteCString(EXIF_TAG_SUBSEC_TIME_ORIG, EXIF_SUBSECTIME_LENGTH, m_pExif->sec_time);
+        EXIF_PATCH(exifwriter, EXIF_SUBSECTIME_LENGTH, EXIF_PATCH_CSTRING, exif->sec_time);
         exifwriter.WriteCString(EXIF_TAG_SUBSEC_TIME_DIG, EXIF_SUBSECTIME_LENGTH, m_pExif->sec_time);
-        if (m_pExif->maker_note_size > 0)
+        EXIF_PATCH(exifwriter, EXIF_SUBSECTIME_LENGTH, EXIF_PATCH_CSTRING, exif->sec_time);
+        if (m_pExif->maker_note_size > 0) {
             exifwriter.WriteUndef(EXIF_TAG_MAKER_NOTE, m_pExif->maker_note_size, m_pExif->maker_note);
-        if (m_pExif->user_comment_size > 0)
+            EXIF_PATCH(exifwriter, m_pExif->maker_note_size, EXIF_PATCH_BYTES, exif->maker_note);
+        }
+        if (m_pExif->user_comment_size > 0) {
             exifwriter.WriteUndef(EXIF_TAG_USER_COMMENT, m_pExif->user_comment_size, m_pExif->user_comment);
+            EXIF_PATCH(exifwriter, m_pExif->user_comment_size, EXIF_PATCH_BYTES, exif->user_comment);
+        }
         exifwriter.WriteShort(EXIF_TAG_COLOR_SPACE, 1, &m_pExif->color_space);
         exifwriter.WriteLong(EXIF_TAG_PIXEL_X_DIMENSION, 1, &m_pExif->width);
+        EXIF_PATCH(exifwriter, sizeof(uint32_t), EXIF_PATCH_BYTES, &exif->width);
         exifwriter.WriteLong(EXIF_TAG_PIXEL_Y_DIMENSION, 1, &m_pExif->height);
+        EXIF_PATCH(exifwriter, sizeof(uint32_t), EXIF_PATCH_BYTES, &exif->height);
         exifwriter.WriteUndef(EXIF_TAG_SCENE_TYPE, sizeof(SceneType), SceneType);
         exifwriter.WriteShort(EXIF_TAG_CUSTOM_RENDERED, 1, &m_pExif->custom_rendered);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->custom_rendered);
         exifwriter.WriteShort(EXIF_TAG_EXPOSURE_MODE, 1, &m_pExif->exposure_mode);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->exposure_mode);
         exifwriter.WriteShort(EXIF_TAG_WHITE_BALANCE, 1, &m_pExif->white_balance);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->white_balance);
         exifwriter.WriteRational(EXIF_TAG_DIGITAL_ZOOM_RATIO, 1, &m_pExif->digital_zoom_ratio);
+        EXIF_PATCH(exifwriter, sizeof(rational_t), EXIF_PATCH_BYTES, &exif->digital_zoom_ratio);
         exifwriter.WriteShort(EXIF_TAG_FOCA_LENGTH_IN_35MM_FILM, 1, &m_pExif->focal_length_in_35mm_length);
         exifwriter.WriteShort(EXIF_TAG_SCENCE_CAPTURE_TYPE, 1, &m_pExif->scene_capture_type);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->scene_capture_type);
         exifwriter.WriteShort(EXIF_TAG_CONTRAST, 1, &m_pExif->contrast);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->contrast);
         exifwriter.WriteShort(EXIF_TAG_SATURATION, 1, &m_pExif->saturation);
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->saturation);
         exifwriter.WriteShort(EXIF_TAG_SHARPNESS, 1, &m_pExif->sharpness);
-        if (m_szUniqueID > 0)
+        EXIF_PATCH(exifwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->sharpness);
+        if (m_szUniqueID > 0) {
             exifwriter.WriteASCII(EXIF_TAG_IMAGE_UNIQUE_ID, m_szUniqueID + 1, m_pExif->unique_id);
+            EXIF_PATCH(exifwriter, m_szUniqueID + 1, EXIF_PATCH_ASCII, exif->unique_id);
+        }
         pSubIFDBase = exifwriter.BeginSubIFD(EXIF_TAG_INTEROPERABILITY);
         if (pSubIFDBase) {
             CIFDWriter interopwriter(tiffheader, pSubIFDBase, 2);
@@ -452,18 +622,25 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
             CIFDWriter gpswriter(tiffheader, pSubIFDBase, m_nGPSIFDFields);
             gpswriter.WriteByte(EXIF_TAG_GPS_VERSION_ID, 4, m_pExif->gps_version_id);
             gpswriter.WriteASCII(EXIF_TAG_GPS_LATITUDE_REF, 2, m_pExif->gps_latitude_ref);
+            EXIF_PATCH(gpswriter, 2, EXIF_PATCH_ASCII, exif->gps_latitude_ref);
             gpswriter.WriteRational(EXIF_TAG_GPS_LATITUDE, 3, m_pExif->gps_latitude);
+            EXIF_PATCH(gpswriter, sizeof(rational_t) * 3, EXIF_PATCH_BYTES, exif->gps_latitude);
             gpswriter.WriteASCII(EXIF_TAG_GPS_LONGITUDE_REF, 2, m_pExif->gps_longitude_ref);
+            EXIF_PATCH(gpswriter, 2, EXIF_PATCH_ASCII, exif->gps_longitude_ref);
             gpswriter.WriteRational(EXIF_TAG_GPS_LONGITUDE, 3, m_pExif->gps_longitude);
+            EXIF_PATCH(gpswriter, sizeof(rational_t) * 3, EXIF_PATCH_BYTES, exif->gps_longitude);
             gpswriter.WriteByte(EXIF_TAG_GPS_ALTITUDE_REF, 1, &m_pExif->gps_altitude_ref);
+            EXIF_PATCH(gpswriter, 1, EXIF_PATCH_BYTES, &exif->gps_altitude_ref);
             gpswriter.WriteRational(EXIF_TAG_GPS_ALTITUDE, 1, &m_pExif->gps_altitude);
+            EXIF_PATCH(gpswriter, sizeof(rational_t), EXIF_PATCH_BYTES, &exif->gps_altitude);
             gpswriter.WriteCString(EXIF_TAG_GPS_DATESTAMP, EXIF_GPSDATESTAMP_LENGTH,
                                    m_pExif->gps_datestamp);
+            EXIF_PATCH(gpswriter, EXIF_GPSDATESTAMP_LENGTH, EXIF_PATCH_CSTRING, exif->gps_datestamp);
             gpswriter.WriteRational(EXIF_TAG_GPS_TIMESTAMP, 3, m_pExif->gps_timestamp);
-            size_t len = strlen(m_pExif->gps_processing_method);
+            EXIF_PATCH(gpswriter, sizeof(rational_t) * 3, EXIF_PATCH_BYTES, exif->gps_timestamp);
+            size_t len = GetGPSProcessingMethodLength(m_pExif);
             if (len > 0) {
                 size_t idx;
-                len = min(len, static_cast<size_t>(99UL));
                 unsigned char buf[sizeof(ExifAsciiPrefix) + len + 1];
                 for (idx = 0; idx < sizeof(ExifAsciiPrefix); idx++)
                     buf[idx] = ExifAsciiPrefix[idx];
@@ -471,6 +648,11 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
                 len += idx;
                 buf[len] = '\0';
                 gpswriter.WriteUndef(EXIF_TAG_GPS_PROCESSING_METHOD, len + 1, buf);
+                AddExifPatch(gpswriter.GetLastValueAddress() + sizeof(ExifAsciiPrefix),
+                             len + 1 - sizeof(ExifAsciiPrefix), EXIF_PATCH_CSTRING,
+                             [] (const exif_attribute_t *exif) -> const void * {
+                                 return exif->gps_processing_method;
+                             });
             }
             gpswriter.Finish(true);
             writer.EndSubIFD(gpswriter.GetNextIFDBase());
@@ -480,17 +662,23 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     }
 
     // thumbnail and the next IFD pointer is never updated.
-    if (updating)
+    if (updating) {
+        // The template is not valid any more because the patches are replaced
+        m_ExifTemplate.clear();
         return NULL;
+    }
 
     if (m_pExif->enableThumb) {
         writer.Finish(false);
 
         CIFDWriter thumbwriter(tiffheader, writer.GetNextIFDBase(), m_n1stIFDFields);
         thumbwriter.WriteLong(EXIF_TAG_IMAGE_WIDTH, 1, &m_pExif->widthThumb);
+        EXIF_PATCH(thumbwriter, sizeof(uint32_t), EXIF_PATCH_BYTES, &exif->widthThumb);
         thumbwriter.WriteLong(EXIF_TAG_IMAGE_HEIGHT, 1, &m_pExif->heightThumb);
+        EXIF_PATCH(thumbwriter, sizeof(uint32_t), EXIF_PATCH_BYTES, &exif->heightThumb);
         thumbwriter.WriteShort(EXIF_TAG_COMPRESSION_SCHEME, 1, &m_pExif->compression_scheme);
         thumbwriter.WriteShort(EXIF_TAG_ORIENTATION, 1, &m_pExif->orientation);
+        EXIF_PATCH(thumbwriter, sizeof(uint16_t), EXIF_PATCH_BYTES, &exif->orientation);
 
         ALOG_ASSERT(thumbwriter.GetNextIFDBase() != m_pThumbBase);
         uint32_t offset = thumbwriter.Offset(m_pThumbBase);
@@ -498,8 +686,11 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
         offset = 0; // temporarilly 0 byte
         thumbwriter.WriteLong(EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LEN, 1, &offset);
         m_pThumbSizePlaceholder = thumbwriter.GetNextTagAddress() - 4;
+        m_szThumbSizeOffset = PTR_DIFF(m_pAppBase, m_pThumbSizePlaceholder);
         thumbwriter.Finish(true);
 
+        SaveExifTemplate(thumbwriter.GetNextIFDBase());
+
         size_t thumbspace = reserve_thumbnail_space ? m_szMaxThumbSize + JPEG_APP1_OEM_RESERVED : 0;
 
         return thumbwriter.GetNextIFDBase() + thumbspace;
@@ -507,6 +698,8 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
 
     writer.Finish(true);
 
+    SaveExifTemplate(writer.GetNextIFDBase());
+
     return writer.GetNextIFDBase();
 }
 
@@ -17,6 +17,8 @@
 #ifndef __HARDWARE_SAMSUNG_SLSI_EXYNOS_APPMARKER_WRITER_H__
 #define __HARDWARE_SAMSUNG_SLSI_EXYNOS_APPMARKER_WRITER_H__
 
+#include <vector>
+
 #include <ExynosExif.h>
 #include "include/hardware/exynos/ExynosExif.h"
 
@@ -46,7 +48,28 @@
 #define EXIF_OFFSETTIME_LENGTH 7
 #define EXIF_GPSDATESTAMP_LENGTH 11
 
+/*
+ * Most of the Exif attributes like make, model and the lens data are the same
+ * during a camera session. CAppMarkerWriter keeps APP1 of the last shot as a
+ * template with the locations of the values that are changed for each shot
+ * like the timestamps, the exposure and GPS. If the next exif has the same
+ * layout and the same invariant attributes, APP1 is copied from the template
+ * and only the values of the shot are updated in place.
+ */
 class CAppMarkerWriter {
+    enum {
+        EXIF_PATCH_BYTES,       // copied as it is
+        EXIF_PATCH_ASCII,       // copied and terminated by null
+        EXIF_PATCH_CSTRING,     // copied until null and padded with null
+    };
+
+    struct ExifPatch {
+        uint16_t offset;        // offset of the value from the APP1 marker
+        uint16_t length;
+        int type;
+        const void *(*source)(const exif_attribute_t *exif);
+    };
+
     char *m_pAppBase;
     char *m_pApp1End;
     size_t m_szMaxThumbSize; // Maximum available thumbnail stream size minus JPEG_MARKER_SIZE
@@ -73,8 +96,21 @@ class CAppMarkerWriter {
     // Note that the address may not be aligned by 32-bit.
     char *m_pThumbSizePlaceholder;
 
+    // APP1 of the last shot and the attributes that are not patched
+    std::vector<char> m_ExifTemplate;
+    std::vector<char> m_ExifTemplateKey;
+    std::vector<char> m_ExifKey;
+    std::vector<ExifPatch> m_ExifPatches;
+    size_t m_szThumbSizeOffset; // offset of m_pThumbSizePlaceholder in the template
+
     void Init();
 
+    void MakeExifKey(std::vector<char> &key);
+    void AddExifPatch(char *value, size_t length, int type,
+                      const void *(*source)(const exif_attribute_t *exif));
+    char *PatchAPP1(char *base, bool reserve_thumbnail_space);
+    void SaveExifTemplate(char *end);
+
     char *WriteAPP1(char *base, bool reserve_thumbnail_space, bool updating = false);
     char *WriteAPPX(char *base, bool just_reserve);
     char *WriteAPP11(char *current, size_t dummy, size_t align);
@@ -225,5 +225,11 @@ bool ExynosJpegEncoder::__EnsureFormatIsApplied() {
 }
 
 int ExynosJpegEncoder::setQuality(const unsigned char q_table[]) {
-    return m_hwjpeg.SetQuality(q_table) ? 0 : -1;
+    if (!m_hwjpeg.SetQuality(q_table))
+        return -1;
+
+    // The quality factor should reach m_hwjpeg to replace q_table even though it is the same
+    m_nQFactor = 0;
+
+    return 0;
 }
@@ -17,6 +17,7 @@
 
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <cutils/properties.h>
 #include <linux/videodev2.h>
 
@@ -80,7 +81,13 @@ ExynosJpegEncoderForCamera::ExynosJpegEncoderForCamera(bool bBTBComp, unsigned i
         return;
     }
 
-    m_phwjpeg4thumb = new CHWJpegV4L2Compressor(jpeg_node[index]);
+    // The thumbnail is compressed by another JPEG device if it exists to
+    // overlap the compression of the thumbnail with the main image.
+    unsigned int thumb_index = (index + 1) % ARRSIZE(jpeg_node);
+    if (access(jpeg_node[thumb_index], F_OK) != 0)
+        thumb_index = index;
+
+    m_phwjpeg4thumb = new CHWJpegV4L2Compressor(jpeg_node[thumb_index]);
     if (!m_phwjpeg4thumb) {
         ALOGE("Failed to create thumbnail compressor!");
         return;
@@ -108,6 +115,9 @@ ExynosJpegEncoderForCamera::ExynosJpegEncoderForCamera(bool bBTBComp, unsigned i
     m_extraInfo.appInfo = m_appInfo;
     m_extraInfo.num_of_appmarker = 0;
 
+    memset(&m_curStats, 0, sizeof(m_curStats));
+    memset(m_stats, 0, sizeof(m_stats));
+
     mThumbnailScaler.reset(ThumbnailScaler::createInstance());
 
     ALOGI("ExynosJpegEncoderForCamera Created: %p, ION %d", this, m_fdIONClient);
@@ -278,8 +288,21 @@ bool ExynosJpegEncoderForCamera::ProcessExif(char *base, size_t limit,
     // the compressed data of the main image is shifted by the length of the
     // compressed data of the thumbnail image. Then the compressed data of
     // the thumbnail image is copied to the place for it.
-    if (!exifInfo || !exifInfo->enableThumb || (limit < (JPEG_MAX_SEGMENT_SIZE * 10)))
+    if (!exifInfo || !exifInfo->enableThumb) {
+        reserve_thumbspace = false;
+    } else if (TestState(STATE_ZERO_COPY_OUTPUT)) {
+        // The main image should be written after the reserved space as long
+        // as the buffer is large enough not to shift the main image later.
+        size_t required = m_pAppWriter->CalculateAPPSize(0) + m_pAppWriter->GetMaxThumbnailSize() +
+                          m_pAppWriter->GetAPP1ResrevedSize() + NECESSARY_JPEG_LENGTH;
+        if (limit <= required) {
+            ALOGI("Too small stream buffer %zu bytes to reserve thumbnail space (%zu bytes required)",
+                  limit, required);
+            reserve_thumbspace = false;
+        }
+    } else if (limit < (JPEG_MAX_SEGMENT_SIZE * 10)) {
         reserve_thumbspace = false;
+    }
 
     m_pAppWriter->Write(reserve_thumbspace, JPEG_MARKER_SIZE, align,
                         TestState(STATE_HWFC_ENABLED));
@@ -291,18 +314,12 @@ bool ExynosJpegEncoderForCamera::ProcessExif(char *base, size_t limit,
     return true;
 }
 
-bool ExynosJpegEncoderForCamera::PrepareCompression(bool thumbnail)
+bool ExynosJpegEncoderForCamera::PrepareCompression(bool thumbnail, int fdJpegBuffer)
 {
     if (!thumbnail)
         return true;
 
-    if (IsThumbGenerationNeeded()) {
-        if (pthread_create(&m_threadWorker, NULL,
-                tCompressThumbnail, reinterpret_cast<void *>(this)) != 0) {
-            ALOGERR("Failed to create thumbnail generation thread");
-            return false;
-        }
-    } else {
+    if (!IsThumbGenerationNeeded()) {
         // allocate temporary thumbnail stream buffer
         // to prevent overflow of the compressed stream
         if (!AllocThumbJpegBuffer()) {
@@ -310,6 +327,18 @@ bool ExynosJpegEncoderForCamera::PrepareCompression(bool thumbnail)
         }
     }
 
+    ConfigureThumbStreamBuffer(fdJpegBuffer);
+
+    // The thumbnail image is scaled if required and compressed by the worker
+    // while the main image is compressed unless they are compressed back-to-back.
+    if (IsThumbCompressedConcurrently()) {
+        if (pthread_create(&m_threadWorker, NULL,
+                tCompressThumbnail, reinterpret_cast<void *>(this)) != 0) {
+            ALOGERR("Failed to create thumbnail generation thread");
+            return false;
+        }
+    }
+
     if (!TestState(STATE_NO_BTBCOMP) && IsBTBCompressionSupported()) {
         if (checkOutBufType() == JPEG_BUF_TYPE_USER_PTR) {
             if (!GetCompressor().SetJpegBuffer2(m_pIONThumbJpegBuffer, m_szIONThumbJpegBuffer)) {
@@ -361,6 +390,11 @@ int ExynosJpegEncoderForCamera::encode(int *size, exif_attribute_t *exifInfo,
         return -1;
     }
 
+    if (!m_hwfcFrames.empty()) {
+        ALOGE("Unable to encode during compression of %zu frames", m_hwfcFrames.size());
+        return -1;
+    }
+
     if (*size <= 0) {
         ALOGE("Too small stram buffer length %d bytes", *size);
         return -1;
@@ -378,24 +412,15 @@ int ExynosJpegEncoderForCamera::encode(int *size, exif_attribute_t *exifInfo,
 
     CStopWatch stopwatch(true);
 
+    memset(&m_curStats, 0, sizeof(m_curStats));
+
     if (!ProcessExif(jpeg_base, m_nStreamSize, exifInfo, appInfo))
         return -1;
 
-    int offset = PTR_DIFF(m_pStreamBase, m_pAppWriter->GetMainStreamBase());
-    int buffsize = static_cast<int>(m_nStreamSize - offset);
-    if ((fdJpegBuffer < 0) || !(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_DMABUF_OFFSET)) { // JPEG_BUF_TYPE_USER_PTR
-        if (setOutBuf(m_pAppWriter->GetMainStreamBase(), buffsize) < 0) {
-            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d",
-                    fdJpegBuffer, m_pAppWriter->GetMainStreamBase(), buffsize);
-            return -1;
-        }
-    } else { // JPEG_BUF_TYPE_DMA_BUF
-        if (setOutBuf(fdJpegBuffer, buffsize, offset) < 0) {
-            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d",
-                    fdJpegBuffer, m_pAppWriter->GetMainStreamBase(), buffsize);
-            return -1;
-        }
-    }
+    m_curStats.exif = stopwatch.GetElapsed();
+
+    if (!ConfigureStreamBuffer(m_pStreamBase, m_nStreamSize, fdJpegBuffer))
+        return -1;
 
     bool block_mode = !TestState(STATE_HWFC_ENABLED);
     bool thumbenc = m_pAppWriter->GetThumbStreamBase() != NULL;
@@ -437,19 +462,31 @@ int ExynosJpegEncoderForCamera::encode(int *size, exif_attribute_t *exifInfo,
         return -1;
     }
 
-    if (!PrepareCompression(thumbenc)) {
+    m_curStats.compression_case = GetCompressionCase(thumbenc, block_mode);
+
+    PrepareStreamCacheClean(fdJpegBuffer, block_mode);
+
+    if (!PrepareCompression(thumbenc, fdJpegBuffer)) {
         ALOGE("Failed to prepare compression");
         return -1;
     }
 
+    CStopWatch mainwatch(true);
+
     ssize_t mainlen = GetCompressor().Compress(&thumblen, block_mode);
+
+    m_curStats.main_compress = mainwatch.GetElapsed();
+
     if (mainlen < 0) {
         ALOGE("Error occured while JPEG compression: %zd", mainlen);
+        if (thumbenc && IsThumbCompressedConcurrently())
+            pthread_join(m_threadWorker, NULL);
         return -1;
     }
 
     if (mainlen == 0) { /* non-blocking compression */
         ALOGI("Waiting for MCSC run");
+        m_curStats.total = stopwatch.GetElapsed();
         return 0;
     }
 
@@ -457,8 +494,12 @@ int ExynosJpegEncoderForCamera::encode(int *size, exif_attribute_t *exifInfo,
     if (*size < 0)
         return -1;
 
+    CleanFinishedStream(*size);
+
+    RecordStats(stopwatch.GetElapsed(), *size);
+
     ALOGI("....compression delay(usec.): HW %u, Total %lu)",
-          GetHWDelay(), stopwatch.GetElapsed());
+          GetHWDelay(), m_curStats.total);
 
     if (property_get_bool("vendor.jpeg.debug", false))
         DumpInfo();
@@ -466,8 +507,244 @@ int ExynosJpegEncoderForCamera::encode(int *size, exif_attribute_t *exifInfo,
     return 0;
 }
 
+bool ExynosJpegEncoderForCamera::ConfigureStreamBuffer(char *base, size_t limit, int fdJpegBuffer)
+{
+    int offset = PTR_DIFF(base, m_pAppWriter->GetMainStreamBase());
+    int buffsize = static_cast<int>(limit - offset);
+    if ((fdJpegBuffer < 0) || !(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_DMABUF_OFFSET)) { // JPEG_BUF_TYPE_USER_PTR
+        if (setOutBuf(m_pAppWriter->GetMainStreamBase(), buffsize) < 0) {
+            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d",
+                    fdJpegBuffer, m_pAppWriter->GetMainStreamBase(), buffsize);
+            return false;
+        }
+    } else { // JPEG_BUF_TYPE_DMA_BUF
+        if (setOutBuf(fdJpegBuffer, buffsize, offset) < 0) {
+            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d",
+                    fdJpegBuffer, m_pAppWriter->GetMainStreamBase(), buffsize);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ExynosJpegEncoderForCamera::ConfigureThumbStreamBuffer(int fdJpegBuffer)
+{
+    char *thumbbase = m_pAppWriter->GetThumbStreamBase();
+    unsigned long align = 16;
+    if (!!(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_NO_STREAMBASE_ALIGN))
+        align = 1;
+
+    m_thumbStream = {NULL, 0, -1, 0};
+
+    // The thumbnail compressed back-to-back is written by the compressor of
+    // the main image which has no offset of the secondary stream buffer.
+    if (!TestState(STATE_ZERO_COPY_OUTPUT) || !thumbbase || !m_pAppWriter->IsThumbSpaceReserved() ||
+            !IsThumbCompressedConcurrently() || (PTR_TO_ULONG(thumbbase) & (align - 1)))
+        return;
+
+    // The stream of the thumbnail is allowed to overflow to the OEM reserved
+    // area which is cleared after the compression.
+    m_thumbStream.base = thumbbase;
+    m_thumbStream.len = m_pAppWriter->GetMaxThumbnailSize() + m_pAppWriter->GetAPP1ResrevedSize();
+    if ((fdJpegBuffer >= 0) && !!(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_DMABUF_OFFSET)) {
+        m_thumbStream.fd = fdJpegBuffer;
+        m_thumbStream.offset = static_cast<int>(PTR_DIFF(m_pStreamBase, thumbbase));
+    }
+}
+
+bool ExynosJpegEncoderForCamera::SetThumbStreamBuffer()
+{
+    if (!m_thumbStream.base) {
+        if (!m_phwjpeg4thumb->SetJpegBuffer(m_fdIONThumbJpegBuffer, m_szIONThumbJpegBuffer)) {
+            ALOGE("Failed to configure thumbnail stream buffer (fd %d, size %zu)",
+                    m_fdIONThumbJpegBuffer, m_szIONThumbJpegBuffer);
+            return false;
+        }
+        return true;
+    }
+
+    bool okay;
+    if (m_thumbStream.fd >= 0)
+        okay = m_phwjpeg4thumb->SetJpegBuffer(m_thumbStream.fd, m_thumbStream.len, m_thumbStream.offset);
+    else
+        okay = m_phwjpeg4thumb->SetJpegBuffer(m_thumbStream.base, m_thumbStream.len);
+
+    if (!okay) {
+        ALOGE("Failed to configure thumbnail stream buffer in APP1 (fd %d, offset %d, size %zu)",
+                m_thumbStream.fd, m_thumbStream.offset, m_thumbStream.len);
+        return false;
+    }
+
+    return true;
+}
+
+void ExynosJpegEncoderForCamera::PrepareStreamCacheClean(int fdJpegBuffer, bool block_mode)
+{
+    bool partial = TestState(STATE_PARTIAL_CACHE_CLEAN) && block_mode && (fdJpegBuffer >= 0) &&
+                   (m_fdIONClient >= 0) && !!(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_DMABUF_OFFSET);
+
+    if (partial) {
+        exynos_ion_sync_ranges ranges;
+
+        // H/W writes the stream after the APP markers written by ProcessExif()
+        m_szPartialCleanHeader = PTR_DIFF(m_pStreamBase, m_pAppWriter->GetMainStreamBase());
+        exynos_ion_sync_ranges_init(&ranges);
+        exynos_ion_sync_ranges_add(&ranges, 0, m_szPartialCleanHeader);
+        if (exynos_ion_sync_ranges(m_fdIONClient, fdJpegBuffer, &ranges) < 0)
+            partial = false;
+    }
+
+    if (partial && (m_fdPartialCleanStream < 0))
+        GetCompressor().SetAuxFlags(EXYNOS_HWJPEG_AUXOPT_DST_NOCACHECLEAN);
+    else if (!partial && (m_fdPartialCleanStream >= 0))
+        GetCompressor().ClearAuxFlags(EXYNOS_HWJPEG_AUXOPT_DST_NOCACHECLEAN);
+
+    m_fdPartialCleanStream = partial ? fdJpegBuffer : -1;
+}
+
+void ExynosJpegEncoderForCamera::CleanFinishedStream(size_t streamlen)
+{
+    if (m_fdPartialCleanStream < 0)
+        return;
+
+    exynos_ion_sync_ranges ranges;
+
+    exynos_ion_sync_ranges_init(&ranges);
+    // FinishCompression() rewrites the APP markers and the SOI of the main stream.
+    // The main stream is also shifted if the thumbnail is embedded without the reserved space.
+    if (m_pAppWriter->GetThumbStreamBase() && !m_pAppWriter->IsThumbSpaceReserved())
+        exynos_ion_sync_ranges_add(&ranges, 0, streamlen);
+    else
+        exynos_ion_sync_ranges_add(&ranges, 0, m_szPartialCleanHeader + JPEG_MARKER_SIZE);
+
+    exynos_ion_sync_ranges(m_fdIONClient, m_fdPartialCleanStream, &ranges);
+}
+
+int ExynosJpegEncoderForCamera::queueFrame(int size, exif_attribute_t *exifInfo, int fdJpegBuffer,
+                                           char *pcJpegBuffer, void *cookie, FrameCompletion completion)
+{
+    if (!TestState(STATE_HWFC_ENABLED)) {
+        ALOGE("Frames are queued only if HWFC is enabled");
+        return -1;
+    }
+
+    if (!pcJpegBuffer || (size <= 0)) {
+        ALOGE("Invalid stream buffer %p of %d bytes for the frame", pcJpegBuffer, size);
+        return -1;
+    }
+
+    if (exifInfo && exifInfo->enableThumb) {
+        ALOGE("Thumbnail is not supported for the queued frames");
+        return -1;
+    }
+
+    // Confirm that no thumbnail information is transferred to HWJPEG
+    setThumbnailSize(0, 0);
+
+    // The driver cleans the buffers of the frames in compression
+    PrepareStreamCacheClean(-1, false);
+
+    if (!ProcessExif(pcJpegBuffer, size, exifInfo, NULL) ||
+            !ConfigureStreamBuffer(pcJpegBuffer, size, fdJpegBuffer) ||
+            !EnsureFormatIsApplied())
+        return -1;
+
+    if (GetCompressor().Compress(NULL, false) < 0) {
+        ALOGE("Failed to queue a frame during compression of %zu frames", m_hwfcFrames.size());
+        // The buffers of the frames in compression may be cancelled by the failure
+        CancelFrames();
+        return -1;
+    }
+
+    m_hwfcFrames.push_back({pcJpegBuffer, m_pAppWriter->GetMainStreamBase(),
+                            m_pAppWriter->CalculateAPPSize(0), cookie, completion});
+
+    return 0;
+}
+
+ssize_t ExynosJpegEncoderForCamera::FinishFrame()
+{
+    HWFCFrame frame = m_hwfcFrames.front();
+    m_hwfcFrames.pop_front();
+
+    ssize_t streamlen = GetCompressor().WaitForCompression();
+    if (streamlen >= 0) {
+        size_t mainlen = RemoveTrailingDummies(frame.mainbase, streamlen);
+
+        // The same as FinishCompression() without thumbnail
+        frame.mainbase[0] = 0;
+        frame.mainbase[1] = 0;
+        frame.base[0] = 0xFF;
+        frame.base[1] = 0xD8;
+
+        streamlen = static_cast<ssize_t>(frame.appsize + mainlen);
+    }
+
+    if (frame.completion)
+        frame.completion(frame.cookie, streamlen);
+
+    return streamlen;
+}
+
+void ExynosJpegEncoderForCamera::CancelFrames()
+{
+    if (m_hwfcFrames.empty())
+        return;
+
+    GetCompressor().Release();
+
+    while (!m_hwfcFrames.empty()) {
+        HWFCFrame frame = m_hwfcFrames.front();
+        m_hwfcFrames.pop_front();
+
+        if (frame.completion)
+            frame.completion(frame.cookie, -1);
+    }
+}
+
+unsigned int ExynosJpegEncoderForCamera::GetCompressionCase(bool thumbenc, bool block_mode)
+{
+    // The cases are decided according to the table in encode()
+    if (!thumbenc)
+        return 6;
+
+    if (IsThumbGenerationNeeded())
+        return block_mode ? 1 : 2;
+
+    if (IsBTBCompressionSupported())
+        return block_mode ? 4 : 5;
+
+    return block_mode ? 3 : 7;
+}
+
+void ExynosJpegEncoderForCamera::RecordStats(unsigned long elapsed, size_t stream_size)
+{
+    m_curStats.total += elapsed;
+    m_curStats.hw_delay = GetHWDelay();
+    m_curStats.stream_size = stream_size;
+
+    std::lock_guard<std::mutex> lock(m_statsLock);
+
+    m_stats[m_nStatsCount % MAX_STATS] = m_curStats;
+    m_nStatsCount++;
+}
+
+unsigned int ExynosJpegEncoderForCamera::GetStats(ExynosJpegCompressionStats stats[], unsigned int count)
+{
+    std::lock_guard<std::mutex> lock(m_statsLock);
+
+    unsigned int num = min(count, min(m_nStatsCount, MAX_STATS));
+
+    for (unsigned int i = 0; i < num; i++)
+        stats[i] = m_stats[(m_nStatsCount - 1 - i) % MAX_STATS];
+
+    return num;
+}
+
 ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thumblen)
 {
+    CStopWatch stopwatch(true);
     bool btb = false;
     size_t max_streamsize = m_nStreamSize;
     char *mainbase = m_pAppWriter->GetMainStreamBase();
@@ -482,7 +759,7 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
     m_pAppWriter->GetMainStreamBase()[1] = 0;
 
     if (thumbbase) {
-        if (IsThumbGenerationNeeded()) {
+        if (IsThumbCompressedConcurrently()) {
             void *len;
             int ret = pthread_join(m_threadWorker, &len);
             if (ret != 0) {
@@ -494,8 +771,6 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
                 ALOGE("Error occurred during thumbnail creation: no thumbnail is embedded");
 
             thumblen = reinterpret_cast<size_t>(len);
-        } else if (TestState(STATE_NO_BTBCOMP) || !IsBTBCompressionSupported()) {
-            thumblen = CompressThumbnailOnly(m_pAppWriter->GetMaxThumbnailSize(), m_nThumbQuality, getColorFormat(), checkInBufType());
         } else {
             btb = true;
         }
@@ -506,7 +781,9 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
             ALOGI("Too large thumbnail (%dx%d) stream size %zu (max: %zu, quality factor %d)",
                   m_nThumbWidth, m_nThumbHeight, thumblen, max_thumb, m_nThumbQuality);
             ALOGI("Retrying thumbnail compression with quality factor 50");
+            CStopWatch thumbwatch(true);
             thumblen = CompressThumbnailOnly(max_thumb, 50, getColorFormat(), checkInBufType());
+            m_curStats.thumb_compress += thumbwatch.GetElapsed();
             if (thumblen == 0)
                 return -1;
         }
@@ -529,7 +806,9 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
         }
 
         if (thumblen > 0) {
-            memcpy(m_pAppWriter->GetThumbStreamBase(), m_pIONThumbJpegBuffer, thumblen);
+            // The thumbnail stream compressed in place is already in APP1
+            if (!m_thumbStream.base)
+                memcpy(m_pAppWriter->GetThumbStreamBase(), m_pIONThumbJpegBuffer, thumblen);
             m_pAppWriter->Finalize(thumblen);
         }
 
@@ -556,21 +835,36 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
     m_pStreamBase[0] = 0xFF;
     m_pStreamBase[1] = 0xD8;
 
+    m_curStats.finalize = stopwatch.GetElapsed();
+
     return m_nStreamSize;
 }
 
 /* The logic in WaitForHWFC() is the same with encode() */
 ssize_t ExynosJpegEncoderForCamera::WaitForCompression()
 {
+    if (!m_hwfcFrames.empty())
+        return FinishFrame();
+
     if (!TestState(STATE_HWFC_ENABLED))
         return m_nStreamSize;
 
+    CStopWatch stopwatch(true);
+
     size_t thumblen = 0;
     ssize_t streamlen = GetCompressor().WaitForCompression(&thumblen);
     if (streamlen < 0)
         return streamlen;
 
-    return FinishCompression(streamlen, thumblen);
+    m_curStats.wait = stopwatch.GetElapsed();
+
+    streamlen = FinishCompression(streamlen, thumblen);
+    if (streamlen < 0)
+        return streamlen;
+
+    RecordStats(stopwatch.GetElapsed(), streamlen);
+
+    return streamlen;
 }
 
 bool ExynosJpegEncoderForCamera::GenerateThumbnailImage()
@@ -641,10 +935,14 @@ size_t ExynosJpegEncoderForCamera::CompressThumbnail()
     unsigned int v4l2Format = getColorFormat();
     int buftype = checkInBufType();
 
+    CStopWatch stopwatch(true);
+
     if (IsThumbGenerationNeeded()) {
         if (!GenerateThumbnailImage())
             return 0;
 
+        m_curStats.thumb_scale = stopwatch.GetElapsedUpdate();
+
         // libcsc output configured by this class is always NV21.
         v4l2Format = GetThumbnailFormat(getColorFormat());
 
@@ -654,7 +952,11 @@ size_t ExynosJpegEncoderForCamera::CompressThumbnail()
         m_szThumbnailImageLen[0] = m_szIONThumbImgBuffer;
     }
 
-    return CompressThumbnailOnly(m_pAppWriter->GetMaxThumbnailSize(), m_nThumbQuality, v4l2Format, buftype);
+    size_t thumblen = CompressThumbnailOnly(m_pAppWriter->GetMaxThumbnailSize(), m_nThumbQuality, v4l2Format, buftype);
+
+    m_curStats.thumb_compress = stopwatch.GetElapsed();
+
+    return thumblen;
 }
 
 bool ExynosJpegEncoderForCamera::AllocThumbBuffer(int v4l2Format)
@@ -772,11 +1074,8 @@ size_t ExynosJpegEncoderForCamera::CompressThumbnailOnly(size_t limit, int quali
         }
     }
 
-    if (!m_phwjpeg4thumb->SetJpegBuffer(m_fdIONThumbJpegBuffer, m_szIONThumbJpegBuffer)) {
-        ALOGE("Failed to configure thumbnail stream buffer (fd %d, size %zu)",
-                m_fdIONThumbJpegBuffer, m_szIONThumbJpegBuffer);
+    if (!SetThumbStreamBuffer())
         return 0;
-    }
 
     // Since the compressed stream of the thumbnail image is to be embedded in
     // APP1 segment, at the end of Exif metadata, the length of the stream should
@@ -790,12 +1089,21 @@ size_t ExynosJpegEncoderForCamera::CompressThumbnailOnly(size_t limit, int quali
         }
 
         ssize_t thumbsize = m_phwjpeg4thumb->Compress();
+        if ((thumbsize < 0) && m_thumbStream.base) {
+            // The reserved space in APP1 is much smaller than the internal buffer
+            ALOGI("Failed to compress thumbnail in APP1. Retrying with the internal buffer...");
+            m_thumbStream.base = NULL;
+            if (!SetThumbStreamBuffer())
+                return 0;
+            thumbsize = m_phwjpeg4thumb->Compress();
+        }
+
         if (thumbsize < 0) {
             ALOGE("Failed to compress thumbnail");
             return 0;
         }
 
-        thumbsize = RemoveTrailingDummies(m_pIONThumbJpegBuffer, thumbsize);
+        thumbsize = RemoveTrailingDummies(GetThumbStreamBuffer(), thumbsize);
         if (static_cast<size_t>(thumbsize) > limit) {
             quality = min(50, quality - 10);
             ALOGI_IF(quality >= 20,
@@ -907,6 +1215,7 @@ size_t ExynosJpegEncoderForCamera::GetThumbnailImage(char *buffer, size_t buflen
 
 int ExynosJpegEncoderForCamera::destroy()
 {
+    CancelFrames();
     GetCompressor().Release();
     return 0;
 }
@@ -926,4 +1235,11 @@ void ExynosJpegEncoderForCamera::DumpInfo() {
     if (thumbenc && IsThumbGenerationNeeded())
         m_phwjpeg4thumb->DumpInfo(true, false);
 
+    ExynosJpegCompressionStats stats;
+    if (GetStats(&stats, 1) == 1) {
+        ALOGI("CASE%u: exif %lu, thumb scale %lu, thumb comp %lu, main comp %lu, wait %lu, finalize %lu, total %lu usec (HW %u)",
+              stats.compression_case, stats.exif, stats.thumb_scale, stats.thumb_compress,
+              stats.main_compress, stats.wait, stats.finalize, stats.total, stats.hw_delay);
+    }
+
 }
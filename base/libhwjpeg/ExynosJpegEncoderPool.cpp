@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#include <ExynosJpegEncoderPool.h>
+
+#include "hwjpeg-internal.h"
+
+ExynosJpegEncoderPool::ExynosJpegEncoderPool(unsigned int count, Completion completion, bool bBTBComp)
+        : mCompletion(completion)
+{
+    unsigned int nodes[ARRSIZE(jpeg_node)];
+    unsigned int node_count = 0;
+
+    for (unsigned int i = 0; i < ARRSIZE(jpeg_node); i++) {
+        if (access(jpeg_node[i], F_OK) == 0)
+            nodes[node_count++] = i;
+    }
+
+    if (node_count == 0) {
+        ALOGE("No JPEG device is found for the encoder pool");
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        std::unique_ptr<ExynosJpegEncoderForCamera> encoder(
+                new ExynosJpegEncoderForCamera(bBTBComp, nodes[i % node_count]));
+        if (encoder->create() < 0) {
+            ALOGE("Failed to create %u-th encoder of the pool", i);
+            break;
+        }
+        mEncoders.push_back(std::move(encoder));
+    }
+
+    for (auto &encoder : mEncoders)
+        mWorkers.emplace_back(&ExynosJpegEncoderPool::worker, this, encoder.get());
+
+    ALOGI("ExynosJpegEncoderPool Created: %zu encoders on %u devices", mEncoders.size(), node_count);
+}
+
+ExynosJpegEncoderPool::~ExynosJpegEncoderPool()
+{
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTerminating = true;
+    }
+    mRequestCond.notify_all();
+
+    for (auto &worker : mWorkers)
+        worker.join();
+}
+
+bool ExynosJpegEncoderPool::queue(const Request &request)
+{
+    if (mEncoders.empty()) {
+        ALOGE("No encoder is available in the pool");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back(request);
+    }
+    mRequestCond.notify_one();
+
+    return true;
+}
+
+void ExynosJpegEncoderPool::flush()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleCond.wait(lock, [this] { return mRequests.empty() && (mBusyCount == 0); });
+}
+
+void ExynosJpegEncoderPool::worker(ExynosJpegEncoderForCamera *encoder)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    for (;;) {
+        mRequestCond.wait(lock, [this] { return mTerminating || !mRequests.empty(); });
+        if (mRequests.empty())
+            break;
+
+        Request request = mRequests.front();
+        mRequests.pop_front();
+        mBusyCount++;
+
+        lock.unlock();
+
+        int len = encode(encoder, request);
+        if (mCompletion)
+            mCompletion(request, len);
+
+        lock.lock();
+
+        mBusyCount--;
+        if (mRequests.empty() && (mBusyCount == 0))
+            mIdleCond.notify_all();
+    }
+}
+
+int ExynosJpegEncoderPool::encode(ExynosJpegEncoderForCamera *encoder, Request &request)
+{
+    // The setters do nothing if the value is the same as the previous request
+    if ((encoder->setSize(request.width, request.height) < 0) ||
+            (encoder->setColorFormat(request.colorFormat) < 0) ||
+            (encoder->setJpegFormat(request.jpegFormat) < 0) ||
+            (encoder->setQuality(request.quality) < 0) ||
+            (encoder->setThumbnailSize(request.thumbWidth, request.thumbHeight) < 0)) {
+        ALOGE("Failed to configure %dx%d (fmt %#x) with thumbnail %dx%d",
+              request.width, request.height, request.colorFormat, request.thumbWidth, request.thumbHeight);
+        return -1;
+    }
+
+    if ((request.thumbWidth != 0) && (encoder->setThumbnailQuality(request.thumbQuality) < 0))
+        return -1;
+
+    if (encoder->setInBuf(request.imageBuf, request.imageLen) < 0) {
+        ALOGE("Failed to configure the image buffer");
+        return -1;
+    }
+
+    int len = request.streamLen;
+    if (encoder->encode(&len, request.exif, request.streamBuf, &request.streamAddr, request.appInfo) < 0) {
+        ALOGE("Failed to compress %dx%d", request.width, request.height);
+        return -1;
+    }
+
+    return len;
+}
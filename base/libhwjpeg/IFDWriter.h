@@ -78,6 +78,7 @@ class CIFDWriter {
     char *m_pBase;
     char *m_pIFDBase;
     char *m_pValue;
+    char *m_pLastValue;
     unsigned int m_nTags;
 
     char *WriteOffset(char *target, char *addr) {
@@ -114,6 +115,7 @@ public:
         m_pIFDBase = ifdbase;
         m_pValue = m_pIFDBase + IFD_FIELDCOUNT_SIZE +
                    IFD_FIELD_SIZE * tagcount + IFD_NEXTIFDOFFSET_SIZE;
+        m_pLastValue = NULL;
 
         // COUNT field of IFD
         const char *pval = reinterpret_cast<char *>(&m_nTags);
@@ -132,10 +134,12 @@ public:
 
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            m_pLastValue = m_pValue;
             for (uint32_t i = 0; i < count; i++) {
                 *m_pValue++ = static_cast<char>(value[i]);
             }
         } else {
+            m_pLastValue = m_pIFDBase;
             for (uint32_t i = 0; i < count; i++)
                 *m_pIFDBase++ = static_cast<char>(value[i]);
             m_pIFDBase += IFD_VALOFF_SIZE - count;
@@ -151,11 +155,13 @@ public:
 
         if (count > (IFD_VALOFF_SIZE / sizeof(value[0]))) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            m_pLastValue = m_pValue;
             for (uint32_t i = 0; i < count; i++) {
                 *m_pValue++ = *p++;
                 *m_pValue++ = *p++;
             }
         } else {
+            m_pLastValue = m_pIFDBase;
             for (uint32_t i = 0; i < count; i++) {
                 *m_pIFDBase++ = *p++;
                 *m_pIFDBase++ = *p++;
@@ -172,8 +178,10 @@ public:
         const char *p = reinterpret_cast<const char *>(&value[0]);
         if (count > (IFD_VALOFF_SIZE / sizeof(value[0]))) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            m_pLastValue = m_pValue;
             *m_pValue++ = *p++;
         } else {
+            m_pLastValue = m_pIFDBase;
             *m_pIFDBase++ = *p++;
             *m_pIFDBase++ = *p++;
             *m_pIFDBase++ = *p++;
@@ -188,10 +196,12 @@ public:
 
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            m_pLastValue = m_pValue;
             memcpy(m_pValue, value, count);
             m_pValue[count - 1] = '\0';
             m_pValue += count;
         } else {
+            m_pLastValue = m_pIFDBase;
             for (uint32_t i = 0; i < count; i++)
                 *m_pIFDBase++ = value[i];
             *(m_pIFDBase - 1) = '\0';
@@ -206,12 +216,14 @@ public:
 
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            m_pLastValue = m_pValue;
             strncpy(m_pValue, string, count);
             m_pValue[count - 1] = '\0';
             m_pValue += count;
         } else {
             uint32_t i;
 
+            m_pLastValue = m_pIFDBase;
             for (i = 0; (i < (count - 1)) && (string[i] != '\0'); i++)
                 *m_pIFDBase++ = string[i];
 
@@ -227,6 +239,7 @@ public:
 
         WriteTagTypeCount(tag, EXIF_TYPE_RATIONAL, count);
         m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+        m_pLastValue = m_pValue;
 
         for (uint32_t i = 0; i < count; i++) {
             const char *pt;
@@ -248,6 +261,7 @@ public:
 
         WriteTagTypeCount(tag, EXIF_TYPE_SRATIONAL, count);
         m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+        m_pLastValue = m_pValue;
 
         const char *pt = reinterpret_cast<const char *>(value);
         for (uint32_t i = 0; i < sizeof(srational_t) * count; i++)
@@ -260,9 +274,11 @@ public:
         WriteTagTypeCount(tag, EXIF_TYPE_UNDEFINED, count);
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            m_pLastValue = m_pValue;
             memcpy(m_pValue, value, count);
             m_pValue += count;
         } else {
+            m_pLastValue = m_pIFDBase;
             for (uint32_t i = 0; i < count; i++)
                 *m_pIFDBase++ = static_cast<char>(value[i]);
             m_pIFDBase += IFD_VALOFF_SIZE - count;
@@ -300,6 +316,8 @@ public:
 
     char *GetNextIFDBase() { return m_pValue; }
     char *GetNextTagAddress() { return m_pIFDBase; }
+    // The address of the value of the last tag written
+    char *GetLastValueAddress() { return m_pLastValue; }
 };
 
 #endif //__HARDWARE_SAMSUNG_SLSI_EXYNOS_IFDWRITER_H__
@@ -45,6 +45,14 @@ bool LibScalerForJpeg::RunStream(char *srcBuf[SCALER_MAX_PLANES], int __unused s
     return queue(srcBuf, dstBuf);
 }
 
+bool LibScalerForJpeg::RunStream(int srcBuf[SCALER_MAX_PLANES], int __unused srcLen[SCALER_MAX_PLANES], char *dstBuf, size_t __unused dstLen)
+{
+    if (!mSrcImage.begin(V4L2_MEMORY_DMABUF) || !mDstImage.begin(V4L2_MEMORY_USERPTR))
+        return false;
+
+    return queue(srcBuf, dstBuf);
+}
+
 bool LibScalerForJpeg::Image::set(unsigned int width, unsigned int height, unsigned int format)
 {
     if (same(width, height, format))
@@ -59,6 +67,25 @@ bool LibScalerForJpeg::Image::set(unsigned int width, unsigned int height, unsig
         return false;
 
     memoryType = 0; // new reqbufs is required.
+    crop.width = 0; // S_FMT resets the crop to the entire image
+
+    return true;
+}
+
+bool LibScalerForJpeg::Image::setCrop(unsigned int left, unsigned int top, unsigned int width, unsigned int height)
+{
+    v4l2_rect rect{static_cast<__s32>(left), static_cast<__s32>(top), width, height};
+
+    if ((crop.left == rect.left) && (crop.top == rect.top) &&
+            (crop.width == rect.width) && (crop.height == rect.height))
+        return true;
+
+    if (!mDevice.setCrop(bufferType, rect)) {
+        crop.width = 0;
+        return false;
+    }
+
+    crop = rect;
 
     return true;
 }
@@ -148,6 +175,23 @@ bool LibScalerForJpeg::Device::setFormat(unsigned int buftype, unsigned int form
     return true;
 }
 
+bool LibScalerForJpeg::Device::setCrop(unsigned int buftype, const v4l2_rect &rect)
+{
+    v4l2_selection sel{};
+
+    sel.type = buftype;
+    sel.target = (buftype == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) ? V4L2_SEL_TGT_CROP : V4L2_SEL_TGT_COMPOSE;
+    sel.r = rect;
+
+    if (ioctl(mFd, VIDIOC_S_SELECTION, &sel) < 0) {
+        ALOGERR("failed S_SELECTION(%s, %ux%u@(%d,%d))", getBufTypeString(buftype),
+                rect.width, rect.height, rect.left, rect.top);
+        return false;
+    }
+
+    return true;
+}
+
 bool LibScalerForJpeg::Device::streamOn(unsigned int buftype)
 {
     if (ioctl(mFd, VIDIOC_STREAMON, &buftype) < 0) {
@@ -231,6 +275,22 @@ bool LibScalerForJpeg::Device::queueBuffer(unsigned int buftype, int buf, unsign
     return true;
 }
 
+bool LibScalerForJpeg::Device::queueBuffer(unsigned int buftype, char *buf, unsigned int len[SCALER_MAX_PLANES])
+{
+    if (!queueBuffer(buftype, [buf, len] (v4l2_buffer &buffer)
+                {
+                    buffer.memory = V4L2_MEMORY_USERPTR;
+                    buffer.length = 1;
+                    buffer.m.planes[0].m.userptr = reinterpret_cast<unsigned long>(buf);
+                    buffer.m.planes[0].length = len[0];
+                })) {
+        ALOGERR("failed QBUF(%s, ptr=%p, len=%d", getBufTypeString(buftype), buf, len[0]);
+        return false;
+    }
+
+    return true;
+}
+
 bool LibScalerForJpeg::Device::dequeueBuffer(unsigned int buftype, unsigned int memtype)
 {
     v4l2_buffer buffer{};
@@ -35,8 +35,14 @@ public:
         return mDstImage.set(width, height, v4l2_format);
     }
 
+    // The source is cropped to the entire image by SetSrcImage() with a different image
+    bool SetSrcCrop(unsigned int left, unsigned int top, unsigned int width, unsigned int height) {
+        return mSrcImage.setCrop(left, top, width, height);
+    }
+
     bool RunStream(int srcBuf[SCALER_MAX_PLANES], int srcLen[SCALER_MAX_PLANES], int dstBuf, size_t dstLen);
     bool RunStream(char *srcBuf[SCALER_MAX_PLANES], int srcLen[SCALER_MAX_PLANES], int dstBuf, size_t dstLen);
+    bool RunStream(int srcBuf[SCALER_MAX_PLANES], int srcLen[SCALER_MAX_PLANES], char *dstBuf, size_t dstLen);
 
 private:
     struct Device {
@@ -46,12 +52,14 @@ private:
         ~Device();
         bool requestBuffers(unsigned int buftype, unsigned int memtype, unsigned int count);
         bool setFormat(unsigned int buftype, unsigned int format, unsigned int width, unsigned int height, unsigned int planelen[SCALER_MAX_PLANES]);
+        bool setCrop(unsigned int buftype, const v4l2_rect &rect);
         bool streamOn(unsigned int buftype);
         bool streamOff(unsigned int buftype);
         bool queueBuffer(unsigned int buftype, std::function<void(v4l2_buffer &)> bufferFiller);
         bool queueBuffer(unsigned int buftype, int buf[SCALER_MAX_PLANES], unsigned int len[SCALER_MAX_PLANES]);
         bool queueBuffer(unsigned int buftype, char *buf[SCALER_MAX_PLANES], unsigned int len[SCALER_MAX_PLANES]);
         bool queueBuffer(unsigned int buftype, int buf, unsigned int len[SCALER_MAX_PLANES]);
+        bool queueBuffer(unsigned int buftype, char *buf, unsigned int len[SCALER_MAX_PLANES]);
         bool dequeueBuffer(unsigned int buftype, unsigned int memtype);
     };
 
@@ -63,12 +71,14 @@ private:
         unsigned int memoryType = 0;
         const unsigned int bufferType;
         unsigned int planeLen[SCALER_MAX_PLANES];
+        v4l2_rect crop{}; // zero width if the entire image is used
 
         Image(Device &dev, unsigned int w, unsigned int h, unsigned int f, unsigned int buftype)
             : mDevice(dev), width(w), height(h), format(f), bufferType(buftype)
         { }
 
         bool set(unsigned int width, unsigned int height, unsigned int format);
+        bool setCrop(unsigned int left, unsigned int top, unsigned int width, unsigned int height);
         bool begin(unsigned int memtype);
         bool cancelBuffer();
 
@@ -79,8 +89,8 @@ private:
         bool same(unsigned int w, unsigned int h, unsigned int f) { return width == w && height == h && format == f; }
     };
 
-    template<class T>
-    bool queue(T srcBuf[SCALER_MAX_PLANES], int dstBuf) {
+    template<class T, class D>
+    bool queue(T srcBuf[SCALER_MAX_PLANES], D dstBuf) {
         if (!mSrcImage.queueBuffer(srcBuf))
             return false;
 
@@ -24,6 +24,7 @@
 CHWJpegV4L2Compressor::CHWJpegV4L2Compressor(const char *path): CHWJpegCompressor(path)
 {
     memset(&m_v4l2Format, 0, sizeof(m_v4l2Format));
+    memset(&m_v4l2AppliedFormat, 0, sizeof(m_v4l2AppliedFormat));
     memset(&m_v4l2SrcBuffer, 0, sizeof(m_v4l2SrcBuffer));
     memset(&m_v4l2DstBuffer, 0, sizeof(m_v4l2DstBuffer));
     memset(&m_v4l2SrcPlanes, 0, sizeof(m_v4l2SrcPlanes));
@@ -46,7 +47,13 @@ CHWJpegV4L2Compressor::CHWJpegV4L2Compressor(const char *path): CHWJpegCompresso
     m_v4l2DstBuffer.m.planes = m_v4l2DstPlanes;
 
     m_uiControlsToSet = 0;
+    m_uiQueueDepth = 1;
+    m_uiQueuedBuffers = 0;
+    m_uiNextBufferIndex = 0;
+    m_bQTablesApplied = false;
     m_uiHWDelay = 0;
+    m_uiSrcMemory = 0;
+    m_uiDstMemory = 0;
 
     m_bEnableHWFC = false;
 
@@ -87,13 +94,23 @@ bool CHWJpegV4L2Compressor::SetChromaSampFactor(
            return false;
     }
 
-    m_v4l2Controls[HWJPEG_CTRL_CHROMFACTOR].id = V4L2_CID_JPEG_CHROMA_SUBSAMPLING;
-    m_v4l2Controls[HWJPEG_CTRL_CHROMFACTOR].value = value;
-    m_uiControlsToSet |= 1 << HWJPEG_CTRL_CHROMFACTOR;
+    SetControl(HWJPEG_CTRL_CHROMFACTOR, V4L2_CID_JPEG_CHROMA_SUBSAMPLING, value);
 
     return true;
 }
 
+void CHWJpegV4L2Compressor::SetControl(unsigned int idx, __u32 id, __s32 value)
+{
+    // The controls are kept by the driver across streaming. So the same value
+    // of the previous compression need not be configured again.
+    if ((m_v4l2Controls[idx].id == id) && (m_v4l2Controls[idx].value == value))
+        return;
+
+    m_v4l2Controls[idx].id = id;
+    m_v4l2Controls[idx].value = value;
+    m_uiControlsToSet |= 1 << idx;
+}
+
 bool CHWJpegV4L2Compressor::SetQuality(
         unsigned int quality_factor, unsigned int quality_factor2)
 {
@@ -108,23 +125,23 @@ bool CHWJpegV4L2Compressor::SetQuality(
         return false;
     }
 
-    if (quality_factor > 0) {
-        m_v4l2Controls[HWJPEG_CTRL_QFACTOR].id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
-        m_v4l2Controls[HWJPEG_CTRL_QFACTOR].value = static_cast<__s32>(quality_factor);
-        m_uiControlsToSet |= 1 << HWJPEG_CTRL_QFACTOR;
-    }
+    if (quality_factor > 0)
+        SetControl(HWJPEG_CTRL_QFACTOR, V4L2_CID_JPEG_COMPRESSION_QUALITY,
+                   static_cast<__s32>(quality_factor));
 
-    if (quality_factor2 > 0) {
-        m_v4l2Controls[HWJPEG_CTRL_QFACTOR2].id = V4L2_CID_JPEG_SEC_COMP_QUALITY;
-        m_v4l2Controls[HWJPEG_CTRL_QFACTOR2].value = static_cast<__s32>(quality_factor2);
-        m_uiControlsToSet |= 1 << HWJPEG_CTRL_QFACTOR2;
-    }
+    if (quality_factor2 > 0)
+        SetControl(HWJPEG_CTRL_QFACTOR2, V4L2_CID_JPEG_SEC_COMP_QUALITY,
+                   static_cast<__s32>(quality_factor2));
 
     return true;
 }
 
 bool CHWJpegV4L2Compressor::SetQuality(const unsigned char qtable[])
 {
+    // The driver keeps the tables until a quality factor is configured
+    if (m_bQTablesApplied && (memcmp(m_uiQTables, qtable, sizeof(m_uiQTables)) == 0))
+        return true;
+
     v4l2_ext_controls ctrls;
     v4l2_ext_control ctrl;
 
@@ -136,14 +153,22 @@ bool CHWJpegV4L2Compressor::SetQuality(const unsigned char qtable[])
     ctrls.count = 1;
 
     ctrl.id = V4L2_CID_JPEG_QTABLES2;
-    ctrl.size = 128; /* two quantization tables */
+    ctrl.size = sizeof(m_uiQTables); /* two quantization tables */
     ctrl.p_u8 = const_cast<unsigned char *>(qtable);
 
     if (ioctl(GetDeviceFD(), VIDIOC_S_EXT_CTRLS, &ctrls) < 0) {
         ALOGERR("Failed to configure %u controls", ctrls.count);
+        m_bQTablesApplied = false;
         return false;
     }
 
+    memcpy(m_uiQTables, qtable, sizeof(m_uiQTables));
+    m_bQTablesApplied = true;
+
+    // The custom quantization tables replace the ones of the quality factor.
+    // The quality factor should be configured again even though it is the same.
+    m_v4l2Controls[HWJPEG_CTRL_QFACTOR].id = 0;
+
     return true;
 }
 
@@ -156,6 +181,16 @@ bool CHWJpegV4L2Compressor::SetImageFormat(unsigned int v4l2_fmt,
         (m_v4l2Format.fmt.pix_mp.height == TO_IMAGE_SIZE(height, height2)))
         return true;
 
+    // Returning to the format that is already applied to the device does not
+    // require S_FMT and restarting the stream in the next compression.
+    if ((m_v4l2AppliedFormat.fmt.pix_mp.pixelformat == v4l2_fmt) &&
+        (m_v4l2AppliedFormat.fmt.pix_mp.width == TO_IMAGE_SIZE(width, width2)) &&
+        (m_v4l2AppliedFormat.fmt.pix_mp.height == TO_IMAGE_SIZE(height, height2))) {
+        m_v4l2Format = m_v4l2AppliedFormat;
+        ClearFlag(HWJPEG_FLAG_PIX_FMT);
+        return true;
+    }
+
     m_v4l2Format.fmt.pix_mp.pixelformat = v4l2_fmt;
     m_v4l2Format.fmt.pix_mp.width = TO_IMAGE_SIZE(width, width2);
     m_v4l2Format.fmt.pix_mp.height = TO_IMAGE_SIZE(height, height2);
@@ -353,6 +388,8 @@ bool CHWJpegV4L2Compressor::StopStreaming()
 
     // Stream off dequeues all queued buffers
     ClearFlag(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP);
+    m_uiQueuedBuffers = 0;
+    m_uiNextBufferIndex = 0;
 
     // It is OK to skip DQBUF because STREAMOFF dequeues all queued buffers
     if (TestFlag(HWJPEG_FLAG_REQBUFS)) {
@@ -364,13 +401,60 @@ bool CHWJpegV4L2Compressor::StopStreaming()
     return true;
 }
 
+bool CHWJpegV4L2Compressor::SetQueueDepth(unsigned int depth)
+{
+    if ((depth == 0) || (depth > VIDEO_MAX_FRAME)) {
+        ALOGE("Unsupported queue depth %u", depth);
+        return false;
+    }
+
+    if (depth == m_uiQueueDepth)
+        return true;
+
+    if (m_uiQueuedBuffers > 0) {
+        ALOGE("Unable to change queue depth to %u during %u compressions", depth, m_uiQueuedBuffers);
+        return false;
+    }
+
+    // The buffers should be allocated again with the new depth
+    if (!StopStreaming())
+        return false;
+
+    m_uiQueueDepth = depth;
+
+    return true;
+}
+
 ssize_t CHWJpegV4L2Compressor::Compress(size_t *secondary_stream_size, bool block_mode)
 {
+    if (m_uiQueuedBuffers > 0) {
+        // The buffers of the compressions in progress should not be cancelled
+        if (block_mode || TestFlag(HWJPEG_FLAG_PIX_FMT) ||
+                (m_uiSrcMemory != m_v4l2SrcBuffer.memory) || (m_uiDstMemory != m_v4l2DstBuffer.memory)) {
+            ALOGE("Block mode, format or memory type change is not permitted during %u compressions",
+                  m_uiQueuedBuffers);
+            return -1;
+        }
+
+        if (m_uiQueuedBuffers == m_uiQueueDepth) {
+            ALOGE("All %u buffers are in compression", m_uiQueueDepth);
+            return -1;
+        }
+    }
+
     if (TestFlag(HWJPEG_FLAG_PIX_FMT)) {
         if (!StopStreaming() || !SetFormat())
             return -1;
     }
 
+    // The device keeps streaming between compressions of the same format
+    // unless the buffers are allocated with another type of memory.
+    if (TestFlag(HWJPEG_FLAG_REQBUFS) &&
+            ((m_uiSrcMemory != m_v4l2SrcBuffer.memory) || (m_uiDstMemory != m_v4l2DstBuffer.memory))) {
+        if (!StopStreaming())
+            return -1;
+    }
+
     if (!TestFlag(HWJPEG_FLAG_SRC_BUFFER)) {
         ALOGE("Source image buffer is not specified");
         return -1;
@@ -400,7 +484,7 @@ ssize_t CHWJpegV4L2Compressor::Compress(size_t *secondary_stream_size, bool bloc
     if (!!(GetAuxFlags() & EXYNOS_HWJPEG_AUXOPT_DST_NOCACHECLEAN))
         m_v4l2DstBuffer.flags |= V4L2_BUF_FLAG_NO_CACHE_CLEAN;
 
-    if (!ReqBufs() || !StreamOn() || !UpdateControls() || !QBuf())
+    if (!ReqBufs(m_uiQueueDepth) || !StreamOn() || !UpdateControls() || !QBuf())
         return -1;
 
     return block_mode ? DQBuf(secondary_stream_size) : 0;
@@ -436,6 +520,8 @@ bool CHWJpegV4L2Compressor::SetFormat()
         return false;
     }
 
+    m_v4l2AppliedFormat = m_v4l2Format;
+
     ClearFlag(HWJPEG_FLAG_PIX_FMT);
 
     return true;
@@ -456,6 +542,11 @@ bool CHWJpegV4L2Compressor::UpdateControls()
 
     ctrls.ctrl_class = V4L2_CTRL_CLASS_JPEG;
     ctrls.controls = ctrl;
+
+    // The quality factor replaces the custom quantization tables
+    if (m_uiControlsToSet & (1 << HWJPEG_CTRL_QFACTOR))
+        m_bQTablesApplied = false;
+
     unsigned int idx_ctrl = 0;
     while (m_uiControlsToSet != 0) {
         if (m_uiControlsToSet & (1 << idx_ctrl)) {
@@ -476,6 +567,10 @@ bool CHWJpegV4L2Compressor::UpdateControls()
 
     if (ioctl(GetDeviceFD(), VIDIOC_S_EXT_CTRLS, &ctrls) < 0) {
         ALOGERR("Failed to configure %u controls", ctrls.count);
+        // forget the values to configure them again by the next Set functions
+        for (auto &control : m_v4l2Controls)
+            control.id = 0;
+        m_bQTablesApplied = false;
         return false;
     }
 
@@ -495,7 +590,7 @@ bool CHWJpegV4L2Compressor::ReqBufs(unsigned int count)
 
     memset(&reqbufs, 0, sizeof(reqbufs));
     reqbufs.count = count;
-    reqbufs.memory = m_v4l2SrcBuffer.memory;
+    reqbufs.memory = (count > 0) ? m_v4l2SrcBuffer.memory : m_uiSrcMemory;
     reqbufs.type = m_v4l2SrcBuffer.type;
     if (ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &reqbufs) < 0) {
         ALOGERR("Failed to REQBUFS(%u) of the source image", count);
@@ -504,22 +599,25 @@ bool CHWJpegV4L2Compressor::ReqBufs(unsigned int count)
 
     memset(&reqbufs, 0, sizeof(reqbufs));
     reqbufs.count = count;
-    reqbufs.memory = m_v4l2DstBuffer.memory;
+    reqbufs.memory = (count > 0) ? m_v4l2DstBuffer.memory : m_uiDstMemory;
     reqbufs.type = m_v4l2DstBuffer.type;
     if (ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &reqbufs) < 0) {
         ALOGERR("Failed to REQBUFS(%u) of the JPEG stream", count);
         // rolling back the reqbufs for the source image
-        reqbufs.memory = m_v4l2SrcBuffer.memory;
+        reqbufs.memory = (count > 0) ? m_v4l2SrcBuffer.memory : m_uiSrcMemory;
         reqbufs.type = m_v4l2SrcBuffer.type;
         reqbufs.count = 0;
         ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &reqbufs); // don't care if it fails
         return false;
     }
 
-    if (count > 0)
+    if (count > 0) {
+        m_uiSrcMemory = m_v4l2SrcBuffer.memory;
+        m_uiDstMemory = m_v4l2DstBuffer.memory;
         SetFlag(HWJPEG_FLAG_REQBUFS);
-    else
+    } else {
         ClearFlag(HWJPEG_FLAG_REQBUFS);
+    }
 
     return true;
 }
@@ -574,6 +672,10 @@ bool CHWJpegV4L2Compressor::QBuf()
         return false;
     }
 
+    // The buffers are queued and dequeued in the same order
+    m_v4l2SrcBuffer.index = m_uiNextBufferIndex;
+    m_v4l2DstBuffer.index = m_uiNextBufferIndex;
+
     if (ioctl(GetDeviceFD(), VIDIOC_QBUF, &m_v4l2SrcBuffer) < 0) {
         ALOGERR("QBuf of the source buffers is failed (B2B %s)",
                 IsB2BCompression() ? "enabled" : "disabled");
@@ -589,6 +691,8 @@ bool CHWJpegV4L2Compressor::QBuf()
     }
 
     SetFlag(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP);
+    m_uiQueuedBuffers++;
+    m_uiNextBufferIndex = (m_uiNextBufferIndex + 1) % m_uiQueueDepth;
 
     return true;
 }
@@ -626,7 +730,10 @@ ssize_t CHWJpegV4L2Compressor::DQBuf(size_t *secondary_stream_size)
         failed = true;
     }
 
-    ClearFlag(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP);
+    if (m_uiQueuedBuffers > 0)
+        m_uiQueuedBuffers--;
+    if (m_uiQueuedBuffers == 0)
+        ClearFlag(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP);
 
     if (failed)
         return -1;
@@ -844,7 +951,8 @@ bool CHWJpegV4L2Decompressor::SetImageFormat(unsigned int v4l2_fmt,
     if (m_v4l2Format.type != 0) {
         v4l2_pix_format *p = &m_v4l2Format.fmt.pix;
         if ((p->pixelformat == v4l2_fmt) &&
-            (p->width == width) && (p->height == height))
+            (p->width == width) && (p->height == height) &&
+            !TestFlag(HWJPEG_FLAG_CROPPED))
             return true;
     }
 
@@ -863,6 +971,59 @@ bool CHWJpegV4L2Decompressor::SetImageFormat(unsigned int v4l2_fmt,
         return false;
     }
 
+    if (TestFlag(HWJPEG_FLAG_CROPPED)) {
+        // The previous crop is not for this image. Restore it to the entire image
+        v4l2_selection sel;
+
+        memset(&sel, 0, sizeof(sel));
+        sel.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        sel.target = V4L2_SEL_TGT_CROP;
+        sel.r.width = width;
+        sel.r.height = height;
+
+        if (ioctl(GetDeviceFD(), VIDIOC_S_SELECTION, &sel) < 0) {
+            ALOGERR("Failed to reset the crop of decompressed image to %ux%u", width, height);
+            m_v4l2Format.type = 0;
+            return false;
+        }
+
+        ClearFlag(HWJPEG_FLAG_CROPPED);
+    }
+
+    return true;
+}
+
+bool CHWJpegV4L2Decompressor::SetImageCrop(unsigned int left, unsigned int top,
+                                           unsigned int width, unsigned int height)
+{
+    if (!IsDeviceCapability(V4L2_CAP_EXYNOS_JPEG_DECOMPRESSION_CROP))
+        return false;
+
+    if (m_v4l2Format.type == 0) {
+        ALOGE("Decompressed image format should be configured before crop");
+        return false;
+    }
+
+    CancelCapture();
+
+    v4l2_selection sel;
+
+    memset(&sel, 0, sizeof(sel));
+    sel.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sel.target = V4L2_SEL_TGT_CROP;
+    sel.r.left = static_cast<__s32>(left);
+    sel.r.top = static_cast<__s32>(top);
+    sel.r.width = width;
+    sel.r.height = height;
+
+    // The crop of the driver may be partially changed on failure
+    SetFlag(HWJPEG_FLAG_CROPPED);
+
+    if (ioctl(GetDeviceFD(), VIDIOC_S_SELECTION, &sel) < 0) {
+        ALOGERR("Failed to crop %ux%u@(%u,%u) of decompressed image", width, height, left, top);
+        return false;
+    }
+
     return true;
 }
 
@@ -18,7 +18,10 @@
 #ifndef __HARDWARE_EXYNOS_JPEG_ENCODER_FOR_CAMERA_H__
 #define __HARDWARE_EXYNOS_JPEG_ENCODER_FOR_CAMERA_H__
 
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 
 #include <pthread.h>
 
@@ -29,12 +32,39 @@
 class CAppMarkerWriter; // defined in libhwjpeg/AppMarkerWriter.h
 class ThumbnailScaler; // defined in libhwjpeg/thumbnail_scaler.h
 
+/*
+ * ExynosJpegCompressionStats - durations of the stages of a shot in usec.
+ *
+ * A stage that is not performed in a shot has zero duration. The thumbnail
+ * stages are performed by the worker thread concurrently with the main
+ * compression. The thumbnail compressed back-to-back with the main image is
+ * included in @main_compress. @finalize includes waiting for the worker.
+ */
+struct ExynosJpegCompressionStats {
+    unsigned int compression_case; // CASE1 ~ CASE7 described in encode()
+    unsigned long exif;            // writing APP markers
+    unsigned long thumb_scale;     // generating the thumbnail image
+    unsigned long thumb_compress;  // compressing the thumbnail image
+    unsigned long main_compress;   // Compress() of the main image
+    unsigned long wait;            // WaitForCompression() of HWFC
+    unsigned long finalize;        // completing the stream after compression
+    unsigned long total;           // elapsed in encode() and WaitForCompression()
+    unsigned int hw_delay;         // H/W delay reported by the driver
+    size_t stream_size;
+};
+
 class ExynosJpegEncoderForCamera: public ExynosJpegEncoder {
+public:
+    // called with the length of the JPEG stream of a frame or -1 on failure
+    using FrameCompletion = std::function<void(void *cookie, ssize_t stream_len)>;
+private:
     enum {
         STATE_THUMBSIZE_CHANGED = STATE_BASE_MAX << 0,
         STATE_HWFC_ENABLED = STATE_BASE_MAX << 1,
         STATE_NO_CREATE_THUMBIMAGE = STATE_BASE_MAX << 2,
         STATE_NO_BTBCOMP = STATE_BASE_MAX << 3,
+        STATE_ZERO_COPY_OUTPUT = STATE_BASE_MAX << 4,
+        STATE_PARTIAL_CACHE_CLEAN = STATE_BASE_MAX << 5,
     };
 
     CHWJpegCompressor *m_phwjpeg4thumb;
@@ -62,6 +92,21 @@ class ExynosJpegEncoderForCamera: public ExynosJpegEncoder {
 
     char m_fThumbBufferType;
 
+    // The thumbnail space reserved in APP1 of the stream buffer where the
+    // thumbnail compressor writes the stream in place in zero copy output
+    // mode. @base is NULL if the internal thumbnail stream buffer is used.
+    struct {
+        char *base;
+        size_t len;
+        int fd;     // -1 if @base is configured as userptr
+        int offset; // from the start of the dma-buf of @fd
+    } m_thumbStream = {NULL, 0, -1, 0};
+
+    // The stream buffer of the shot whose CPU written ranges are cleaned by
+    // the encoder instead of the driver. -1 if the driver cleans the buffer.
+    int m_fdPartialCleanStream = -1;
+    size_t m_szPartialCleanHeader = 0;
+
     union {
         char *m_pThumbnailImageBuffer[3]; // checkInBufType() == JPEG_BUF_TYPE_USER_PTR
         int m_fdThumbnailImageBuffer[3]; // checkInBufType() == JPEG_BUF_TYPE_DMA_BUF
@@ -75,6 +120,23 @@ class ExynosJpegEncoderForCamera: public ExynosJpegEncoder {
     extra_appinfo_t m_extraInfo;
     app_info_t m_appInfo[15];
 
+    static const unsigned int MAX_STATS = 16;
+
+    ExynosJpegCompressionStats m_curStats; // stats of the shot in progress
+    std::mutex m_statsLock;
+    ExynosJpegCompressionStats m_stats[MAX_STATS]; // ring buffer of the stats of the last shots
+    unsigned int m_nStatsCount = 0; // the number of stats recorded to m_stats
+
+    // The frames queued by queueFrame() in the order of compression
+    struct HWFCFrame {
+        char *base;
+        char *mainbase;
+        size_t appsize;
+        void *cookie;
+        FrameCompletion completion;
+    };
+    std::deque<HWFCFrame> m_hwfcFrames;
+
     bool AllocThumbBuffer(int v4l2Format); /* For single compression */
     bool AllocThumbJpegBuffer(); /* For BTB compression */
     bool GenerateThumbnailImage();
@@ -82,10 +144,20 @@ class ExynosJpegEncoderForCamera: public ExynosJpegEncoder {
     size_t CompressThumbnailOnly(size_t limit, int quality, unsigned int v4l2Format, int src_buftype);
     size_t RemoveTrailingDummies(char *base, size_t len);
     ssize_t FinishCompression(size_t mainlen, size_t thumblen);
+    ssize_t FinishFrame();
+    void CancelFrames();
+    bool ConfigureStreamBuffer(char *base, size_t limit, int fdJpegBuffer);
+    void ConfigureThumbStreamBuffer(int fdJpegBuffer);
+    bool SetThumbStreamBuffer();
+    char *GetThumbStreamBuffer() { return m_thumbStream.base ? m_thumbStream.base : m_pIONThumbJpegBuffer; }
+    void PrepareStreamCacheClean(int fdJpegBuffer, bool block_mode);
+    void CleanFinishedStream(size_t streamlen);
     bool ProcessExif(char *base, size_t limit, exif_attribute_t *exifInfo, extra_appinfo_t *extra);
     static void *tCompressThumbnail(void *p);
-    bool PrepareCompression(bool thumbnail);
+    bool PrepareCompression(bool thumbnail, int fdJpegBuffer);
     void DumpInfo();
+    unsigned int GetCompressionCase(bool thumbenc, bool block_mode);
+    void RecordStats(unsigned long elapsed, size_t stream_size);
 
     // IsThumbGenerationNeeded - true if thumbnail image needed to be generated from the main image
     //                           It also implies that a worker thread is generated to generate thumbnail concurrently.
@@ -97,6 +169,12 @@ class ExynosJpegEncoderForCamera: public ExynosJpegEncoder {
         return !!(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_B2B_COMPRESSION) &&
                     !TestState(STATE_NO_BTBCOMP);
     }
+
+    // IsThumbCompressedConcurrently - true if the worker thread compresses the thumbnail
+    //                                 while the main image is compressed
+    inline bool IsThumbCompressedConcurrently() {
+        return IsThumbGenerationNeeded() || !IsBTBCompressionSupported();
+    }
 protected:
     virtual bool EnsureFormatIsApplied();
 public:
@@ -122,8 +200,56 @@ public:
         ClearState(STATE_HWFC_ENABLED);
     }
 
+    /*
+     * In zero copy output mode, the space for the largest thumbnail stream is
+     * always reserved in APP1 if the stream buffer is large enough. Then the
+     * compressed stream of the main image is written by H/W after the space
+     * and it is never shifted to embed the thumbnail stream at the cost of the
+     * unused part of the reserved space in the final JPEG stream. The thumbnail
+     * compressed concurrently with the main image is also written by H/W to the
+     * reserved space in place unless it is not aligned for H/W.
+     */
+    void EnableZeroCopyOutput() { SetState(STATE_ZERO_COPY_OUTPUT); }
+    void DisableZeroCopyOutput() { ClearState(STATE_ZERO_COPY_OUTPUT); }
+
+    /*
+     * In partial cache clean mode, the driver does not clean the whole stream
+     * buffer before the blocking compression to a dma-buf. The encoder cleans
+     * only the APP markers written by CPU before the compression and the part
+     * of the stream written by CPU after the compression instead. The users
+     * should not leave dirty cache lines in the stream buffer by CPU writes.
+     */
+    void EnablePartialCacheClean() { SetState(STATE_PARTIAL_CACHE_CLEAN); }
+    void DisablePartialCacheClean() { ClearState(STATE_PARTIAL_CACHE_CLEAN); }
+
     ssize_t WaitForCompression();
 
+    /*
+     * Streaming of frames with HWFC
+     *
+     * queueFrame() starts compressing the image configured by setInBuf() to
+     * the given stream buffer and returns without waiting for the completion.
+     * The next frame can be queued with another stream buffer before the
+     * previous frames are completed as long as less than the depth configured
+     * by setFrameQueueDepth() are in compression. WaitForCompression() waits
+     * for the oldest frame, calls its completion and returns its length.
+     * HWFC should be enabled and thumbnails are not supported. A failure of
+     * queueFrame() or destroy() completes all frames in compression with -1.
+     */
+    int setFrameQueueDepth(unsigned int depth) { return GetCompressor().SetQueueDepth(depth) ? 0 : -1; }
+    int queueFrame(int size, exif_attribute_t *exifInfo, int fdJpegBuffer, char *pcJpegBuffer,
+                   void *cookie, FrameCompletion completion);
+    unsigned int getQueuedFrames() { return static_cast<unsigned int>(m_hwfcFrames.size()); }
+
+    /*
+     * GetStats - retrieve the stats of the last shots from the latest one
+     * @stats[out] : array of @count elements to store the stats
+     * @return     : the number of the stats stored to @stats
+     *
+     * The stats of the last MAX_STATS shots at most are kept.
+     */
+    unsigned int GetStats(ExynosJpegCompressionStats stats[], unsigned int count);
+
     size_t GetThumbnailImage(char *buffer, size_t buflen);
 
     virtual int destroy(void);
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_JPEG_ENCODER_POOL_H__
+#define __HARDWARE_EXYNOS_JPEG_ENCODER_POOL_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ExynosJpegEncoderForCamera.h"
+
+/*
+ * ExynosJpegEncoderPool - concurrent JPEG compression of a queue of images
+ *
+ * The pool keeps several instances of ExynosJpegEncoderForCamera, each of
+ * them with its own context of the JPEG device, and one worker thread for
+ * each instance. The instances are spread over the JPEG devices available in
+ * the system. A worker takes the oldest request in the queue and its encoder
+ * is configured again only with the settings that are different from the
+ * previous request of the encoder. The completion callback is called on the
+ * worker thread with the length of the stream or -1 on failure.
+ *
+ * The buffers, the exif and the app markers of a request should be valid
+ * until its completion is called. The completions of the requests may be
+ * called in a different order from the requests.
+ */
+class ExynosJpegEncoderPool {
+public:
+    struct Request {
+        int width;
+        int height;
+        int colorFormat;        // V4L2 pixel format of the image
+        int jpegFormat;         // V4L2_PIX_FMT_JPEG_XXX
+        int quality;
+        int thumbWidth;         // 0 if no thumbnail is required
+        int thumbHeight;
+        int thumbQuality;
+        int imageBuf[3];        // dma-bufs of the image
+        int imageLen[3];
+        int streamBuf;          // dma-buf of the stream buffer or -1
+        char *streamAddr;       // mapped address of the stream buffer
+        int streamLen;
+        exif_attribute_t *exif;
+        extra_appinfo_t *appInfo;
+        void *cookie;           // passed to the completion
+    };
+
+    using Completion = std::function<void(const Request &request, int stream_len)>;
+
+    ExynosJpegEncoderPool(unsigned int count, Completion completion, bool bBTBComp = true);
+    ~ExynosJpegEncoderPool();
+
+    // number of encoders that are successfully created
+    unsigned int size() { return static_cast<unsigned int>(mEncoders.size()); }
+
+    bool queue(const Request &request);
+    // wait for the completions of all queued requests
+    void flush();
+private:
+    void worker(ExynosJpegEncoderForCamera *encoder);
+    int encode(ExynosJpegEncoderForCamera *encoder, Request &request);
+
+    Completion mCompletion;
+    std::vector<std::unique_ptr<ExynosJpegEncoderForCamera>> mEncoders;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mRequestCond;
+    std::condition_variable mIdleCond;
+    std::deque<Request> mRequests;
+    unsigned int mBusyCount = 0;
+    bool mTerminating = false;
+};
+
+#endif //__HARDWARE_EXYNOS_JPEG_ENCODER_POOL_H__
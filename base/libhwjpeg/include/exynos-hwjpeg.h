@@ -312,6 +312,19 @@ public:
      * Compress().
      */
     virtual ssize_t WaitForCompression(size_t __unused *secondary_stream_size = NULL) = 0;
+    /*
+     * SetQueueDepth - Configure the number of compressions in non-block mode at the same time
+     * @depth[in] : The maximum number of compressions started by Compress() in non-block
+     *              mode that WaitForCompression() is not called for yet.
+     * @return    : true if @depth is configured. false if @depth is not supported or
+     *              there are compressions in progress.
+     *
+     * If @depth is larger than 1, Compress() in non-block mode may be called with new
+     * buffers before WaitForCompression() is called for the previous compressions.
+     * WaitForCompression() returns the sizes of the streams in the order of Compress().
+     * Compress() in block mode is not permitted while any compression is in progress.
+     */
+    virtual bool SetQueueDepth(unsigned int depth) { return depth == 1; }
     /*
      * GetImageBuffers - Retrieve the configured uncompressed image buffer information (dmabuf)
      * @buffers[out]: The file descriptors of the buffers exported by dma-buf
@@ -421,6 +434,25 @@ public:
      */
     virtual bool SetImageBuffer(int buffer, size_t len_buffer) = 0;
 
+    /*
+     * SetImageCrop - Configure the region of the image to decompress
+     * @left[in]   : horizontal offset of the region in the decompressed image
+     * @top[in]    : vertical offset of the region in the decompressed image
+     * @width[in]  : width of the region
+     * @height[in] : height of the region
+     * @return : true if the region is configured. false if HWJPEG is not able to
+     *           crop or the region is not acceptable.
+     *
+     * The region is in the coordinate of the decompressed image that is downscaled
+     * already and the image format configured by SetImageFormat() should have the
+     * size of the region. SetImageCrop() should be called after SetImageFormat()
+     * because SetImageFormat() resets the region to the entire image.
+     * V4L2_CAP_EXYNOS_JPEG_DECOMPRESSION_CROP is set in the device capabilities
+     * if HWJPEG supports for cropping during decompression.
+     */
+    virtual bool SetImageCrop(unsigned int __unused left, unsigned int __unused top,
+                              unsigned int __unused width, unsigned int __unused height) { return false; }
+
     /*
      * SetStreamPixelSize - Configure the width and the height of the compressed stream
      * @width[in] : The number of horizontal pixels of the compressed image
@@ -530,15 +562,26 @@ class CHWJpegV4L2Compressor : public CHWJpegCompressor, private CHWJpegFlagManag
     } m_v4l2Controls[HWJPEG_CTRL_NUM];
 
     unsigned int m_uiControlsToSet;
+    // The number of buffers of REQBUFS and the buffers queued to the driver in order
+    unsigned int m_uiQueueDepth;
+    unsigned int m_uiQueuedBuffers;
+    unsigned int m_uiNextBufferIndex;
+    // The custom quantization tables that the driver keeps
+    unsigned char m_uiQTables[128];
+    bool m_bQTablesApplied;
     // H/W delay of the last compressoin in usec.
     // Only valid after Compression() successes.
     unsigned int m_uiHWDelay;
 
     v4l2_format m_v4l2Format; // v4l2 format for the source image
+    v4l2_format m_v4l2AppliedFormat; // m_v4l2Format of the last S_FMT
     v4l2_buffer m_v4l2SrcBuffer; // v4l2 source buffer
     v4l2_plane m_v4l2SrcPlanes[6];
     v4l2_buffer m_v4l2DstBuffer;
     v4l2_plane m_v4l2DstPlanes[2];
+    // memory types of the buffers allocated by the last REQBUFS
+    __u32 m_uiSrcMemory;
+    __u32 m_uiDstMemory;
 
     bool m_bEnableHWFC;
 
@@ -547,11 +590,13 @@ class CHWJpegV4L2Compressor : public CHWJpegCompressor, private CHWJpegFlagManag
                     TO_SEC_IMG_SIZE(m_v4l2Format.fmt.pix_mp.height)) != 0;
     }
 
+    void SetControl(unsigned int idx, __u32 id, __s32 value);
+
     // V4L2 Helpers
     bool TryFormat();
     bool SetFormat();
     bool UpdateControls();
-    bool ReqBufs(unsigned int count = 1);
+    bool ReqBufs(unsigned int count);
     bool StreamOn();
     bool StreamOff();
     bool QBuf();
@@ -587,6 +632,7 @@ public:
     virtual bool GetJpegBuffer(char **buffer, size_t *len_buffer);
     virtual bool GetJpegBuffer(int *buffer, size_t *len_buffer);
     virtual ssize_t WaitForCompression(size_t *secondary_stream_size = NULL);
+    virtual bool SetQueueDepth(unsigned int depth);
     virtual void Release();
     virtual void DumpInfo(bool thumb, bool btb);
 };
@@ -595,6 +641,7 @@ class CHWJpegV4L2Decompressor : public CHWJpegDecompressor, private CHWJpegFlagM
     enum  {
         HWJPEG_FLAG_OUTPUT_READY  = 0x10, /* the output stream is ready */
         HWJPEG_FLAG_CAPTURE_READY = 0x20, /* the capture stream is ready */
+        HWJPEG_FLAG_CROPPED       = 0x40, /* the crop of the capture stream is configured */
     };
 
     unsigned int m_uiHWDelay;
@@ -614,8 +661,13 @@ public:
     virtual bool SetImageFormat(unsigned int v4l2_fmt, unsigned int width, unsigned int height);
     virtual bool SetImageBuffer(char *buffer, size_t len_buffer);
     virtual bool SetImageBuffer(int buffer, size_t len_buffer);
+    virtual bool SetImageCrop(unsigned int left, unsigned int top, unsigned int width, unsigned int height);
     virtual bool Decompress(const char *buffer, size_t len);
 
     unsigned int GetHWDelay() { return m_uiHWDelay; }
+    // The number of bytes of the image buffer required by the configured image format
+    size_t GetImageBufferSize() { return (m_v4l2Format.type != 0) ? m_v4l2Format.fmt.pix.sizeimage : 0; }
+    // Release the buffers of the streams to keep the device for later use
+    void Release() { CancelStream(); CancelCapture(); }
 };
 #endif /* __EXYNOS_HWJPEG_H__ */
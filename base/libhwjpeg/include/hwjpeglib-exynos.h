@@ -132,6 +132,30 @@ bool hwjpeg_dmabuf_dst(hwjpeg_decompress_ptr cinfo, int outfd[], size_t outsize[
  */
 void hwjpeg_set_downscale_factor(hwjpeg_decompress_ptr cinfo, unsigned int factor);
 
+/*
+ * hwjpeg_set_crop - configure the region of the compressed image to decompress
+ *
+ * @cinfo: decompressor instance handle
+ * @left: horizontal offset of the region in the compressed image
+ * @top: vertical offset of the region in the compressed image
+ * @width: width of the region. 0 to decompress the entire image.
+ * @height: height of the region
+ *
+ * The region is decompressed with the downscaling factor configured by
+ * hwjpeg_set_downscale_factor(). @cinfo->output_width and @cinfo->output_height
+ * are decided by the region.
+ *  - @cinfo->output_width = @width / @cinfo->scale_factor
+ *  - @cinfo->output_height = @height / @cinfo->scale_factor
+ * All of @left, @top, @width and @height should be multiples of the chroma
+ * sampling factor of the compressed image multiplied by the downscaling factor.
+ * If HWJPEG is not able to crop, the entire image is decompressed with the
+ * downscaling factor to an internal buffer and the region is copied to the
+ * output buffer by MSCL. The region should be configured before
+ * hwjpeg_read_header().
+ */
+void hwjpeg_set_crop(hwjpeg_decompress_ptr cinfo,
+                     unsigned int left, unsigned int top, unsigned int width, unsigned int height);
+
 /*
  * hwjpeg_read_header - reads the headers of the compressed JPEG stream
  *
@@ -18,6 +18,9 @@
 #include <cstdio>
 
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -27,10 +30,13 @@
 
 #include <linux/videodev2.h>
 
+#include <hardware/exynos/ion.h>
+
 #include <exynos-hwjpeg.h>
 #include <hwjpeglib-exynos.h>
 
 #include "hwjpeg-internal.h"
+#include "LibScalerForJpeg.h"
 
 #define ALOGERR(fmt, args...) ((void)ALOG(LOG_ERROR, LOG_TAG, fmt " [%s]", ##args, strerror(errno)))
 
@@ -116,6 +122,12 @@ bool CJpegStreamParser::Parse(unsigned char *streambase, size_t length)
             return false;
         }
 
+        // Any marker may be preceded by fill bytes of 0xFF
+        while ((filelen > 2) && (*addr == 0xFF)) {
+            addr++;
+            filelen--;
+        }
+
         unsigned char marker = *addr++;
 
         if ((marker != 0xC4) && ((marker & 0xF0) == 0xC0)) { // SOFn
@@ -217,6 +229,66 @@ bool CJpegStreamParser::ParseFrame(unsigned char *addr)
     return true;
 }
 
+/*
+ * Applications like gallery thumbnail grids create a decompressor for each
+ * image. Opening the device and querying its capability for every image is
+ * avoided by keeping the devices of the destroyed decompressors for the next
+ * decompressors. The buffers of the kept devices are released not to hold
+ * the buffers of the applications.
+ */
+class CHWJpegDecompressorCache {
+    static const size_t MAX_IDLE_DEVICES = 2;
+
+    std::mutex m_lock;
+    std::vector<CHWJpegV4L2Decompressor *> m_idleDevices;
+public:
+    ~CHWJpegDecompressorCache() {
+        for (auto device : m_idleDevices)
+            delete device;
+    }
+
+    CHWJpegV4L2Decompressor *Get() {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            if (!m_idleDevices.empty()) {
+                CHWJpegV4L2Decompressor *device = m_idleDevices.back();
+                m_idleDevices.pop_back();
+                return device;
+            }
+        }
+
+        CHWJpegV4L2Decompressor *device = new CHWJpegV4L2Decompressor;
+        if (!device || !*device) {
+            ALOGE("Failed to create HWJPEG decompressor");
+            delete device;
+            return NULL;
+        }
+
+        return device;
+    }
+
+    void Put(CHWJpegV4L2Decompressor *device) {
+        if (!device)
+            return;
+
+        device->Release();
+
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            if (m_idleDevices.size() < MAX_IDLE_DEVICES) {
+                m_idleDevices.push_back(device);
+                return;
+            }
+        }
+
+        delete device;
+    }
+};
+
+static CHWJpegDecompressorCache decompressorCache;
+
 class CLibhwjpegDecompressor: public hwjpeg_decompressor_struct {
     enum {
         HWJPG_FLAG_NEED_MUNMAP = 1,
@@ -224,13 +296,36 @@ class CLibhwjpegDecompressor: public hwjpeg_decompressor_struct {
 
     unsigned int m_flags;
     bool m_bPrepared;
-    CHWJpegDecompressor *m_hwjpeg;
+    CHWJpegV4L2Decompressor *m_hwjpeg;
 
     unsigned char *m_pStreamBuffer;
     size_t m_nStreamLength;
     size_t m_nDummyBytes;
 
+    char *m_pImageBuffer;
+    int m_fdImageBuffer;
+    size_t m_nImageLength;
+
+    // region to decompress in the compressed image. zero width for the entire image
+    unsigned int m_nCropLeft;
+    unsigned int m_nCropTop;
+    unsigned int m_nCropWidth;
+    unsigned int m_nCropHeight;
+
+    /*
+     * If HWJPEG is not able to crop, the entire image is decompressed with the
+     * downscaling factor to m_fdCropBuffer and MSCL crops the region from it.
+     */
+    bool m_bScalerCrop;
+    int m_fdIONClient;
+    int m_fdCropBuffer;
+    size_t m_nCropBufferLength;
+    std::unique_ptr<LibScalerForJpeg> m_pScaler;
+
     CJpegStreamParser m_jpegStreamParser;
+
+    bool AllocCropBuffer(size_t len);
+    bool CropByScaler();
 public:
     CLibhwjpegDecompressor() : m_flags(0) {
         // members of hwjpeg_decompressor_struct
@@ -251,15 +346,30 @@ public:
         m_nStreamLength = 0;
         m_nDummyBytes = 0;
 
-        m_hwjpeg = new CHWJpegV4L2Decompressor;
-        if (!m_hwjpeg || !*m_hwjpeg) {
-            ALOGE("Failed to create HWJPEG decompressor");
-            delete m_hwjpeg;
-        }
+        m_pImageBuffer = NULL;
+        m_fdImageBuffer = -1;
+        m_nImageLength = 0;
+
+        m_nCropLeft = 0;
+        m_nCropTop = 0;
+        m_nCropWidth = 0;
+        m_nCropHeight = 0;
+
+        m_bScalerCrop = false;
+        m_fdIONClient = -1;
+        m_fdCropBuffer = -1;
+        m_nCropBufferLength = 0;
+
+        m_hwjpeg = decompressorCache.Get();
     }
 
     ~CLibhwjpegDecompressor() {
-        delete m_hwjpeg;
+        decompressorCache.Put(m_hwjpeg);
+
+        if (m_fdCropBuffer >= 0)
+            close(m_fdCropBuffer);
+        if (m_fdIONClient >= 0)
+            exynos_ion_close(m_fdIONClient);
 
         if (!!(m_flags & HWJPG_FLAG_NEED_MUNMAP))
             munmap(m_pStreamBuffer, m_nStreamLength + m_nDummyBytes);
@@ -353,7 +463,11 @@ public:
             return false;
         }
 
-        return m_hwjpeg->SetImageBuffer(reinterpret_cast<char *>(buffer[0]), len[0]);
+        m_pImageBuffer = reinterpret_cast<char *>(buffer[0]);
+        m_fdImageBuffer = -1;
+        m_nImageLength = len[0];
+
+        return true;
     }
 
     bool SetImageBuffer(int buffer[3], size_t len[3], unsigned int num_bufs) {
@@ -362,11 +476,24 @@ public:
             return false;
         }
 
-        return m_hwjpeg->SetImageBuffer(buffer[0], len[0]);
+        m_pImageBuffer = NULL;
+        m_fdImageBuffer = buffer[0];
+        m_nImageLength = len[0];
+
+        return true;
     }
 
     void SetDownscaleFactor(unsigned int factor) { scale_factor = factor; }
 
+    void SetCrop(unsigned int left, unsigned int top, unsigned int width, unsigned int height) {
+        m_nCropLeft = left;
+        m_nCropTop = top;
+        m_nCropWidth = width;
+        m_nCropHeight = height;
+
+        m_bPrepared = false;
+    }
+
     bool PrepareDecompression();
     bool Decompress();
 
@@ -407,8 +534,32 @@ bool CLibhwjpegDecompressor::PrepareDecompression()
         return false;
     }
 
-    output_width = image_width / scale_factor;
-    output_height = image_height / scale_factor;
+    bool crop = (m_nCropWidth != 0) &&
+                ((m_nCropWidth != image_width) || (m_nCropHeight != image_height));
+
+    if (crop) {
+        if ((m_nCropLeft > image_width) || (m_nCropWidth > (image_width - m_nCropLeft)) ||
+                (m_nCropTop > image_height) || (m_nCropHeight > (image_height - m_nCropTop)) ||
+                (m_nCropHeight == 0)) {
+            ALOGE("Crop %ux%u@(%u,%u) is out of the image %ux%u",
+                    m_nCropWidth, m_nCropHeight, m_nCropLeft, m_nCropTop, image_width, image_height);
+            return false;
+        }
+
+        if ((((m_nCropLeft | m_nCropWidth) % (chroma_h_samp_factor * scale_factor)) != 0) ||
+                (((m_nCropTop | m_nCropHeight) % (chroma_v_samp_factor * scale_factor)) != 0)) {
+            ALOGE("Crop %ux%u@(%u,%u) is not aligned to factor %d (chroma %d:%d)",
+                    m_nCropWidth, m_nCropHeight, m_nCropLeft, m_nCropTop,
+                    scale_factor, chroma_h_samp_factor, chroma_v_samp_factor);
+            return false;
+        }
+
+        output_width = m_nCropWidth / scale_factor;
+        output_height = m_nCropHeight / scale_factor;
+    } else {
+        output_width = image_width / scale_factor;
+        output_height = image_height / scale_factor;
+    }
 
     if (!m_hwjpeg->SetStreamPixelSize(image_width, image_height)) {
         ALOGE("Failed to configure stream pixel size (%ux%u)", image_width, image_height);
@@ -420,6 +571,21 @@ bool CLibhwjpegDecompressor::PrepareDecompression()
         return false;
     }
 
+    m_bScalerCrop = false;
+
+    if (crop && !m_hwjpeg->SetImageCrop(m_nCropLeft / scale_factor, m_nCropTop / scale_factor,
+                                        output_width, output_height)) {
+        unsigned int width = image_width / scale_factor;
+        unsigned int height = image_height / scale_factor;
+
+        if (!m_hwjpeg->SetImageFormat(output_format, width, height)) {
+            ALOGE("Failed to configure image format (%ux%u/%08X)", width, height, output_format);
+            return false;
+        }
+
+        m_bScalerCrop = true;
+    }
+
     m_bPrepared = true;
 
     return true;
@@ -437,16 +603,88 @@ bool CLibhwjpegDecompressor::Decompress()
         return false;
     }
 
+    if ((m_pImageBuffer == NULL) && (m_fdImageBuffer < 0)) {
+        ALOGE("No image buffer is configured");
+        return false;
+    }
+
     m_bPrepared = false;
 
-    if (!m_hwjpeg->Decompress(reinterpret_cast<char *>(m_pStreamBuffer), m_nStreamLength)) {
+    bool ret;
+
+    if (m_bScalerCrop) {
+        ret = AllocCropBuffer(m_hwjpeg->GetImageBufferSize()) &&
+              m_hwjpeg->SetImageBuffer(m_fdCropBuffer, m_nCropBufferLength);
+    } else if (m_fdImageBuffer >= 0) {
+        ret = m_hwjpeg->SetImageBuffer(m_fdImageBuffer, m_nImageLength);
+    } else {
+        ret = m_hwjpeg->SetImageBuffer(m_pImageBuffer, m_nImageLength);
+    }
+
+    if (!ret || !m_hwjpeg->Decompress(reinterpret_cast<char *>(m_pStreamBuffer), m_nStreamLength)) {
         ALOGE("Failed to decompress");
         return false;
     }
 
+    if (m_bScalerCrop && !CropByScaler()) {
+        ALOGE("Failed to crop %ux%u@(%u,%u) from the decompressed image",
+                m_nCropWidth, m_nCropHeight, m_nCropLeft, m_nCropTop);
+        return false;
+    }
+
+    return true;
+}
+
+bool CLibhwjpegDecompressor::AllocCropBuffer(size_t len)
+{
+    if (m_nCropBufferLength >= len)
+        return true;
+
+    if (m_fdIONClient < 0) {
+        m_fdIONClient = exynos_ion_open();
+        if (m_fdIONClient < 0) {
+            ALOGERR("Failed to create ION client for the crop buffer");
+            return false;
+        }
+    }
+
+    if (m_fdCropBuffer >= 0) {
+        close(m_fdCropBuffer);
+        m_fdCropBuffer = -1;
+        m_nCropBufferLength = 0;
+    }
+
+    m_fdCropBuffer = exynos_ion_alloc(m_fdIONClient, len, EXYNOS_ION_HEAP_SYSTEM_MASK, 0);
+    if (m_fdCropBuffer < 0) {
+        ALOGERR("Failed to allocate %zu bytes of the crop buffer", len);
+        return false;
+    }
+
+    m_nCropBufferLength = len;
+
     return true;
 }
 
+bool CLibhwjpegDecompressor::CropByScaler()
+{
+    if (!m_pScaler)
+        m_pScaler.reset(new LibScalerForJpeg());
+
+    if (!m_pScaler->SetSrcImage(image_width / scale_factor, image_height / scale_factor, output_format) ||
+            !m_pScaler->SetSrcCrop(m_nCropLeft / scale_factor, m_nCropTop / scale_factor,
+                                   output_width, output_height) ||
+            !m_pScaler->SetDstImage(output_width, output_height, output_format))
+        return false;
+
+    int srcBuf[ThumbnailScaler::SCALER_MAX_PLANES] = {m_fdCropBuffer, -1, -1};
+    int srcLen[ThumbnailScaler::SCALER_MAX_PLANES] = {static_cast<int>(m_nCropBufferLength), 0, 0};
+
+    if (m_fdImageBuffer >= 0)
+        return m_pScaler->RunStream(srcBuf, srcLen, m_fdImageBuffer, m_nImageLength);
+
+    return m_pScaler->RunStream(srcBuf, srcLen, m_pImageBuffer, m_nImageLength);
+}
+
 hwjpeg_decompress_ptr hwjpeg_create_decompress()
 {
     hwjpeg_decompress_ptr p = new CLibhwjpegDecompressor();
@@ -498,6 +736,13 @@ void hwjpeg_set_downscale_factor(hwjpeg_decompress_ptr cinfo, unsigned int facto
     cinfo->scale_factor = factor;
 }
 
+void hwjpeg_set_crop(hwjpeg_decompress_ptr cinfo,
+        unsigned int left, unsigned int top, unsigned int width, unsigned int height)
+{
+    CLibhwjpegDecompressor *decomp = reinterpret_cast<CLibhwjpegDecompressor *>(cinfo);
+    decomp->SetCrop(left, top, width, height);
+}
+
 bool hwjpeg_read_header(hwjpeg_decompress_ptr cinfo)
 {
     CLibhwjpegDecompressor *decomp = reinterpret_cast<CLibhwjpegDecompressor *>(cinfo);
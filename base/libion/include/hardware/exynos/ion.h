@@ -49,6 +49,17 @@
 #define ION_FLAG_PROTECTED (16 | ION_EXYNOS_FLAG_PROTECTED)
 #define ION_FLAG_SYNC_FORCE 32
 #define ION_FLAG_MAY_HWRENDER 64
+/*
+ * Handled by libion_exynos and never passed to the kernel. The length of the
+ * buffers of EXYNOS_ION_LARGE_PAGE_SIZE or larger is rounded up to
+ * EXYNOS_ION_LARGE_PAGE_SIZE for the heaps to allocate the largest chunks, and
+ * exynos_ion_mmap() places the mapping at a EXYNOS_ION_LARGE_PAGE_SIZE
+ * boundary with the pages populated, so the kernel can map the buffer with
+ * block mappings and the first CPU pass does not fault on every page.
+ */
+#define ION_FLAG_LARGE_PAGES (1 << 17)
+
+#define EXYNOS_ION_LARGE_PAGE_SIZE (2 * 1024 * 1024)
 
 #define ION_SYNC_READ      (1 << 0)
 #define ION_SYNC_WRITE     (2 << 0)
@@ -64,14 +75,76 @@ int exynos_ion_free_handle(int ion_fd, int handle);
 int exynos_ion_sync_fd(int ion_fd, int fd);
 int exynos_ion_sync_fd_partial(int ion_fd, int fd, off_t offset, size_t len);
 
+/*
+ * Maps @len bytes of the buffer @fd with @prot as mmap(MAP_SHARED) does. The
+ * mapping is aligned for large pages if @flags has ION_FLAG_LARGE_PAGES. It
+ * is released by munmap().
+ */
+void *exynos_ion_mmap(int fd, size_t len, int prot, unsigned int flags);
+
 int exynos_ion_sync_start(int ion_fd, int fd, int direction);
 int exynos_ion_sync_end(int ion_fd, int fd, int direction);
 
+/*
+ * Ranges of a buffer written by CPU
+ *
+ * The users record the byte ranges that CPU wrote with
+ * exynos_ion_sync_ranges_add() and exynos_ion_sync_ranges() writes back only
+ * the ranges from the CPU caches instead of the whole buffer. The overlapping
+ * and the adjoining ranges are merged. If more than EXYNOS_ION_SYNC_RANGES_MAX
+ * ranges are added, the nearest ranges are merged with the gap between them.
+ *
+ * DMA_BUF_IOCTL_SYNC of dma-heap and the modern ion has no range. The whole
+ * buffer is written back for them if any range is recorded. Nothing is done
+ * if no range is recorded.
+ */
+#define EXYNOS_ION_SYNC_RANGES_MAX 8
+
+struct exynos_ion_sync_ranges {
+    unsigned int count;
+    struct {
+        off_t offset;
+        size_t len;
+    } range[EXYNOS_ION_SYNC_RANGES_MAX];
+};
+
+void exynos_ion_sync_ranges_init(struct exynos_ion_sync_ranges *ranges);
+void exynos_ion_sync_ranges_add(struct exynos_ion_sync_ranges *ranges, off_t offset, size_t len);
+int exynos_ion_sync_ranges(int ion_fd, int fd, const struct exynos_ion_sync_ranges *ranges);
+
 const char *exynos_ion_get_heap_name(unsigned int legacy_heap_id);
 
 int exynos_ion_dma_buf_track(int fd);
 int exynos_ion_dma_buf_untrack(int fd);
 
+/*
+ * Recycling pool of dma-bufs
+ *
+ * The buffers returned by exynos_ion_pool_free() are kept in the pool by
+ * their size class and given again to exynos_ion_pool_alloc() of the same
+ * size class without allocation from the kernel. The sizes are rounded up to
+ * the size class. The recycled buffers are cleared unless the pool is created
+ * with ION_FLAG_NOZEROED in @flags. The protected pools require
+ * ION_FLAG_NOZEROED because CPU cannot clear the protected buffers.
+ *
+ * The oldest buffers in the pool are released when the pool has more than
+ * @max_bytes, when an allocation from the heap fails and when the user calls
+ * exynos_ion_pool_trim() on memory pressure. exynos_ion_pool_trim() returns
+ * the number of bytes released to the heap.
+ *
+ * Only the fds from exynos_ion_pool_alloc() can be returned to the pool and
+ * the pool takes the ownership of them. The buffers shared with other
+ * processes should be closed instead because they may be still accessed.
+ */
+struct exynos_ion_pool;
+
+struct exynos_ion_pool *exynos_ion_pool_create(unsigned int heap_mask, unsigned int flags,
+                                               size_t max_bytes);
+void exynos_ion_pool_destroy(struct exynos_ion_pool *pool);
+int exynos_ion_pool_alloc(struct exynos_ion_pool *pool, size_t len);
+int exynos_ion_pool_free(struct exynos_ion_pool *pool, int fd);
+size_t exynos_ion_pool_trim(struct exynos_ion_pool *pool, size_t max_cached_bytes);
+
 __END_DECLS
 
 #endif /* __HARDWARE_EXYNOS_ION_H__ */
@@ -25,12 +25,16 @@
 #include <linux/dma-heap.h>
 #include <log/log.h>
 #include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "ion.h"
 #include "ion_uapi.h"
 
@@ -42,8 +46,6 @@
  */
 #define EXYNOS_ION_HEAP_VENDOR_SYSTEM_MASK  (1 << 14)
 
-#define ION_MAX_HEAP_COUNT 15
-
 /*
  * ION heap names
  * The array index is the legacy heap id
@@ -194,34 +196,65 @@ int DmabufExporter::alloc_modern(int ion_fd, size_t len, unsigned int legacy_hea
     return (int)data.fd;
 }
 
-int DmabufExporter::alloc_dma_heap(size_t len, unsigned int legacy_heap_mask, unsigned int flags) {
+static const char *dmaheap_suffix[DMA_HEAP_VARIANT_COUNT] = {
+    "", "-uncached", "-secure",
+};
+
+/*
+ * Returns the device of the dma-heap of @legacy_heap_id and @variant. It is
+ * opened on the first call and the later calls get the same fd without locks.
+ * If two threads race for the first open, the fd of the loser is closed.
+ */
+int DmabufExporter::get_dma_heap_fd(unsigned int legacy_heap_id, enum dma_heap_variant variant) {
+    std::atomic<int> &cached = dma_heap_fd[legacy_heap_id][variant];
+    int fd = cached.load(std::memory_order_acquire);
+
+    if (fd >= 0)
+        return fd;
+
     char path[MAX_HEAP_PATH];
-    int id;
 
-    strcpy(path, DmaHeapRoot);
-    for (id = 0; id < ION_NUM_HEAP_NAMES; id++) {
-        if (legacy_heap_mask & (1 << id)) {
-            strcat(path, ion_heap_name[id].dmaheap_name);
-            break;
-        }
+    snprintf(path, sizeof(path), "%s%s%s", DmaHeapRoot,
+             ion_heap_name[legacy_heap_id].dmaheap_name, dmaheap_suffix[variant]);
+
+    fd = systemInterface.Open(path);
+    if (fd < 0) {
+        ALOGE("%s No device for %s failed: %s", __func__, path, strerror(errno));
+        return fd;
+    }
+
+    int expected = -1;
+    if (!cached.compare_exchange_strong(expected, fd, std::memory_order_acq_rel)) {
+        systemInterface.Close(fd);
+        fd = expected;
     }
-    if (id == ION_NUM_HEAP_NAMES) {
+
+    return fd;
+}
+
+int DmabufExporter::alloc_dma_heap(size_t len, unsigned int legacy_heap_mask, unsigned int flags) {
+    unsigned int valid_mask = legacy_heap_mask & ((1U << ION_NUM_HEAP_NAMES) - 1);
+
+    if (!valid_mask) {
         ALOGE("%s invalid heapmask (%zu, %#x, %#x)", __func__, len, legacy_heap_mask, flags);
         return -EINVAL;
     }
 
-    /* Append heap name for flags */
+    /* The lowest heap id in the mask is used as the previous lookup did */
+    unsigned int id = __builtin_ctz(valid_mask);
+    enum dma_heap_variant variant;
+
     if (flags & ION_FLAG_PROTECTED)
-        strcat(path, "-secure");
+        variant = DMA_HEAP_SECURE;
     else if (!(flags & ION_FLAG_CACHED))
-        strcat(path, "-uncached");
+        variant = DMA_HEAP_UNCACHED;
+    else
+        variant = DMA_HEAP_CACHED;
 
-    int ret, fd = systemInterface.Open(path);
-    if (fd < 0) {
-        ALOGE("%s No device for %s (%zu, %#x, %#x) failed: %s", __func__,
-              path, len, legacy_heap_mask, flags, strerror(errno));
+    int ret, fd = get_dma_heap_fd(id, variant);
+    if (fd < 0)
         return fd;
-    }
+
     struct dma_heap_allocation_data data;
 
     data.fd = 0;
@@ -231,13 +264,12 @@ int DmabufExporter::alloc_dma_heap(size_t len, unsigned int legacy_heap_mask, un
 
     ret = systemInterface.Ioctl(fd, DMA_HEAP_IOCTL_ALLOC, &data);
     if (ret < 0)
-        ALOGE("%s Allocation failure for %s (%zu, %#x, %#x) failed: %s", __func__,
-              path, len, legacy_heap_mask, flags, strerror(errno));
+        ALOGE("%s Allocation failure for %s%s (%zu, %#x, %#x) failed: %s", __func__,
+              ion_heap_name[id].dmaheap_name, dmaheap_suffix[variant],
+              len, legacy_heap_mask, flags, strerror(errno));
     else
         ret = data.fd;
 
-    systemInterface.Close(fd);
-
     return ret;
 }
 
@@ -265,6 +297,12 @@ int DmabufExporter::close(int fd) {
 int DmabufExporter::alloc(int ion_fd, size_t len, unsigned int legacy_heap_mask, unsigned int flags) {
     int fd;
 
+    if (flags & ION_FLAG_LARGE_PAGES) {
+        flags &= ~ION_FLAG_LARGE_PAGES;
+        if (len >= EXYNOS_ION_LARGE_PAGE_SIZE)
+            len = (len + EXYNOS_ION_LARGE_PAGE_SIZE - 1) & ~(EXYNOS_ION_LARGE_PAGE_SIZE - 1);
+    }
+
     if (version == DMAHEAP_VERSION)
         fd = alloc_dma_heap(len, legacy_heap_mask, flags);
     else if (version == ION_LEGACY_VERSION)
@@ -405,6 +443,22 @@ int DmabufExporter::sync(int ion_fd, int fd, int direction, int sync) {
     return 0;
 }
 
+int DmabufExporter::sync_ranges(int ion_fd, int fd, const struct exynos_ion_sync_ranges *ranges) {
+    if (ranges->count == 0)
+        return 0;
+
+    /* DMA_BUF_IOCTL_SYNC has no range. Only the legacy ion syncs the ranges. */
+    if (version != ION_LEGACY_VERSION)
+        return sync(ion_fd, fd, ION_SYNC_WRITE, DMA_BUF_SYNC_END);
+
+    for (unsigned int i = 0; i < ranges->count; i++) {
+        if (sync_fd_partial(ion_fd, fd, ranges->range[i].offset, ranges->range[i].len) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 DmabufExporter& getDefaultExporter(void) {
     static DefaultSystemInterface systemInterface;
     static DmabufExporter exporter(systemInterface);
@@ -433,9 +487,102 @@ int exynos_ion_sync_fd(int ion_fd, int fd) {
 int exynos_ion_sync_fd_partial(int ion_fd, int fd, off_t offset, size_t len) {
     return getDefaultExporter().sync_fd_partial(ion_fd, fd, offset, len);
 }
+void *exynos_ion_mmap(int fd, size_t len, int prot, unsigned int flags) {
+    if (!(flags & ION_FLAG_LARGE_PAGES) || (len < EXYNOS_ION_LARGE_PAGE_SIZE))
+        return mmap(NULL, len, prot, MAP_SHARED, fd, 0);
+
+    /* Reserves an area that has a large page boundary with @len bytes after it */
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t maplen = (len + pagesize - 1) & ~(pagesize - 1);
+    size_t reserved = maplen + EXYNOS_ION_LARGE_PAGE_SIZE;
+    void *area = mmap(NULL, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        ALOGE("%s(%d, %zu) failed to reserve the address space: %s", __func__, fd, len, strerror(errno));
+        return MAP_FAILED;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(area);
+    uintptr_t aligned = (start + EXYNOS_ION_LARGE_PAGE_SIZE - 1) & ~(EXYNOS_ION_LARGE_PAGE_SIZE - 1);
+
+    void *addr = mmap(reinterpret_cast<void *>(aligned), maplen, prot,
+                      MAP_SHARED | MAP_FIXED | MAP_POPULATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        int err = errno;
+
+        ALOGE("%s(%d, %zu) failed: %s", __func__, fd, len, strerror(err));
+        munmap(area, reserved);
+        errno = err;
+        return MAP_FAILED;
+    }
+
+    if (aligned > start)
+        munmap(area, aligned - start);
+    if (start + reserved > aligned + maplen)
+        munmap(reinterpret_cast<void *>(aligned + maplen), start + reserved - (aligned + maplen));
+
+    return addr;
+}
+
 int exynos_ion_sync_start(int ion_fd, int fd, int direction) {
     return getDefaultExporter().sync(ion_fd, fd, direction, DMA_BUF_SYNC_START);
 }
 int exynos_ion_sync_end(int ion_fd, int fd, int direction) {
     return getDefaultExporter().sync(ion_fd, fd, direction, DMA_BUF_SYNC_END);
 }
+
+void exynos_ion_sync_ranges_init(struct exynos_ion_sync_ranges *ranges) {
+    ranges->count = 0;
+}
+
+void exynos_ion_sync_ranges_add(struct exynos_ion_sync_ranges *ranges, off_t offset, size_t len) {
+    if (len == 0)
+        return;
+
+    off_t end = offset + static_cast<off_t>(len);
+    unsigned int i = 0;
+
+    /* ranges are sorted by the offset and never overlap or adjoin */
+    while ((i < ranges->count) &&
+            (ranges->range[i].offset + static_cast<off_t>(ranges->range[i].len) < offset))
+        i++;
+
+    unsigned int j = i;
+    while ((j < ranges->count) && (ranges->range[j].offset <= end)) {
+        offset = std::min(offset, ranges->range[j].offset);
+        end = std::max(end, ranges->range[j].offset + static_cast<off_t>(ranges->range[j].len));
+        j++;
+    }
+
+    if (j > i) {
+        /* merged with ranges[i ... j - 1] */
+        ranges->range[i].offset = offset;
+        ranges->range[i].len = end - offset;
+        memmove(&ranges->range[i + 1], &ranges->range[j], (ranges->count - j) * sizeof(ranges->range[0]));
+        ranges->count -= j - i - 1;
+        return;
+    }
+
+    if (ranges->count == EXYNOS_ION_SYNC_RANGES_MAX) {
+        /* no more room: merge with the nearest range and the gap between them */
+        if ((i == ranges->count) || ((i > 0) &&
+                (offset - (ranges->range[i - 1].offset + static_cast<off_t>(ranges->range[i - 1].len)) <
+                 ranges->range[i].offset - end)))
+            i--;
+
+        off_t start = std::min(offset, ranges->range[i].offset);
+
+        end = std::max(end, ranges->range[i].offset + static_cast<off_t>(ranges->range[i].len));
+        ranges->range[i].offset = start;
+        ranges->range[i].len = end - start;
+        return;
+    }
+
+    memmove(&ranges->range[i + 1], &ranges->range[i], (ranges->count - i) * sizeof(ranges->range[0]));
+    ranges->range[i].offset = offset;
+    ranges->range[i].len = len;
+    ranges->count++;
+}
+
+int exynos_ion_sync_ranges(int ion_fd, int fd, const struct exynos_ion_sync_ranges *ranges) {
+    return getDefaultExporter().sync_ranges(ion_fd, fd, ranges);
+}
@@ -17,8 +17,11 @@
 #ifndef _ION_H
 #define _ION_H
 
+#include <atomic>
 #include <errno.h>
+#include <hardware/exynos/ion.h>
 #include <log/log.h>
+#include <stdio.h>
 
 class SystemInterface {
 public:
@@ -32,6 +35,16 @@ public:
 #define MAX_HEAP_PATH 64
 static const char DmaHeapRoot[] = "/dev/dma_heap/";
 
+#define ION_MAX_HEAP_COUNT 15
+
+/* Device variants of a dma-heap. The suffix of the name is in dmaheap_suffix[] */
+enum dma_heap_variant {
+    DMA_HEAP_CACHED,
+    DMA_HEAP_UNCACHED,
+    DMA_HEAP_SECURE,
+    DMA_HEAP_VARIANT_COUNT,
+};
+
 enum exp_version {
     UNKNOWN_VERSION,
     ION_MODERN_VERSION,
@@ -44,25 +57,39 @@ public:
     DmabufExporter(SystemInterface &_systemInterface) : systemInterface(_systemInterface), dma_buf_trace_supported(true) {
         char path[MAX_HEAP_PATH];
 
-        strcpy(path, DmaHeapRoot);
-        strcat(path, "system");
+        for (auto &variants : dma_heap_fd)
+            for (auto &fd : variants)
+                fd.store(-1, std::memory_order_relaxed);
+
+        snprintf(path, sizeof(path), "%ssystem", DmaHeapRoot);
 
         int fd = systemInterface.Open(path);
 
         if (fd >= 0) {
             version = DMAHEAP_VERSION;
-        } else {
-            fd = systemInterface.Open("/dev/ion");
-            if (fd < 0) {
-                ALOGE("%s Failed to find BOTH DMA-HEAP and ION", __func__);
-                version = UNKNOWN_VERSION;
-                return;
-            }
-            legacy_free_handle(fd, 0);
-            version = (errno == ENOTTY) ? ION_MODERN_VERSION : ION_LEGACY_VERSION;
+            /* keep the system heap for the allocations */
+            dma_heap_fd[ION_EXYNOS_HEAP_ID_SYSTEM][DMA_HEAP_CACHED].store(fd, std::memory_order_relaxed);
+            return;
         }
+
+        fd = systemInterface.Open("/dev/ion");
+        if (fd < 0) {
+            ALOGE("%s Failed to find BOTH DMA-HEAP and ION", __func__);
+            version = UNKNOWN_VERSION;
+            return;
+        }
+        legacy_free_handle(fd, 0);
+        version = (errno == ENOTTY) ? ION_MODERN_VERSION : ION_LEGACY_VERSION;
         systemInterface.Close(fd);
     }
+    ~DmabufExporter() {
+        for (auto &variants : dma_heap_fd) {
+            for (auto &fd : variants) {
+                if (fd.load(std::memory_order_relaxed) >= 0)
+                    systemInterface.Close(fd.load(std::memory_order_relaxed));
+            }
+        }
+    }
     int open();
     int close(int fd);
     int alloc(int ion_fd, size_t len, unsigned int legacy_heap_mask, unsigned int flags);
@@ -72,6 +99,7 @@ public:
     int sync_fd(int ion_fd, int fd);
     int sync_fd_partial(int ion_fd, int fd, off_t offset, size_t len);
     int sync(int ion_fd, int fd, int direction, int sync);
+    int sync_ranges(int ion_fd, int fd, const struct exynos_ion_sync_ranges *ranges);
     int trace_buffer(int fd);
     int untrace_buffer(int fd);
 
@@ -79,10 +107,16 @@ private:
     int alloc_legacy(int ion_fd, size_t len, unsigned int legacy_heap_mask, unsigned int flags);
     int alloc_modern(int ion_fd, size_t len, unsigned int legacy_heap_mask, unsigned int flags);
     int alloc_dma_heap(size_t len, unsigned int legacy_heap_mask, unsigned int flags);
+    int get_dma_heap_fd(unsigned int legacy_heap_id, enum dma_heap_variant variant);
     int query_heap_id(int ion_fd, unsigned int legacy_heap_mask);
 
     SystemInterface &systemInterface;
     bool dma_buf_trace_supported;
     enum exp_version version;
+    /*
+     * Devices of dma-heap opened on the first allocation from them and kept
+     * until the exporter is destroyed. -1 if not opened yet.
+     */
+    std::atomic<int> dma_heap_fd[ION_MAX_HEAP_COUNT][DMA_HEAP_VARIANT_COUNT];
 };
 #endif
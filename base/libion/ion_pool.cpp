@@ -0,0 +1,258 @@
+/*
+ *  ion_pool.cpp
+ *
+ *  Copyright 2021 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "ion-pool"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <log/log.h>
+
+#include <hardware/exynos/ion.h>
+
+/*
+ * The sizes are rounded up to the pages and the sizes larger than
+ * ION_POOL_EXACT_SIZE are rounded up again to ION_POOL_CLASS_STEPS steps
+ * between the powers of two. A request reuses only the buffers of its size
+ * class, so the waste of a buffer is less than 1/ION_POOL_CLASS_STEPS.
+ */
+#define ION_POOL_PAGE_SIZE      4096UL
+#define ION_POOL_EXACT_SIZE     (64UL * 1024)
+#define ION_POOL_CLASS_STEPS    8
+
+struct ion_pool_entry {
+    int fd;
+    unsigned long seq;  /* order of the free to release the oldest first */
+};
+
+struct exynos_ion_pool {
+    std::mutex lock;
+    int ion_fd;
+    unsigned int heap_mask;
+    unsigned int flags;
+    size_t max_bytes;
+    size_t cached_bytes;
+    unsigned long seq;
+    /* buffers in the pool by size class */
+    std::map<size_t, std::deque<ion_pool_entry>> free_buffers;
+    /* size class of the buffers allocated from the pool */
+    std::unordered_map<int, size_t> allocated;
+};
+
+static size_t ion_pool_class_size(size_t len) {
+    size_t size = (len + ION_POOL_PAGE_SIZE - 1) & ~(ION_POOL_PAGE_SIZE - 1);
+
+    if (size <= ION_POOL_EXACT_SIZE)
+        return size;
+
+    size_t step = (1UL << (63 - __builtin_clzl(size))) / ION_POOL_CLASS_STEPS;
+
+    return (size + step - 1) & ~(step - 1);
+}
+
+/* Removes the oldest buffers until @target bytes remain. @lock should be held. */
+static void ion_pool_evict_locked(struct exynos_ion_pool *pool, size_t target,
+                                  std::vector<int> &released) {
+    while (pool->cached_bytes > target) {
+        auto oldest = pool->free_buffers.end();
+
+        for (auto it = pool->free_buffers.begin(); it != pool->free_buffers.end(); ++it) {
+            if ((oldest == pool->free_buffers.end()) ||
+                    (it->second.front().seq < oldest->second.front().seq))
+                oldest = it;
+        }
+
+        released.push_back(oldest->second.front().fd);
+        pool->cached_bytes -= oldest->first;
+        oldest->second.pop_front();
+        if (oldest->second.empty())
+            pool->free_buffers.erase(oldest);
+    }
+}
+
+static void ion_pool_close(const std::vector<int> &fds) {
+    for (int fd : fds)
+        close(fd);
+}
+
+/*
+ * A recycled buffer has the content written by the previous user in this
+ * process. It is cleared here as the kernel clears a new buffer.
+ */
+static int ion_pool_clear(struct exynos_ion_pool *pool, int fd, size_t size) {
+    void *addr = exynos_ion_mmap(fd, size, PROT_READ | PROT_WRITE, pool->flags);
+    if (addr == MAP_FAILED) {
+        ALOGE("%s: failed to map fd %d of %zu bytes: %s", __func__, fd, size, strerror(errno));
+        return -1;
+    }
+
+    exynos_ion_sync_start(pool->ion_fd, fd, ION_SYNC_WRITE);
+    memset(addr, 0, size);
+    exynos_ion_sync_end(pool->ion_fd, fd, ION_SYNC_WRITE);
+
+    munmap(addr, size);
+
+    return 0;
+}
+
+struct exynos_ion_pool *exynos_ion_pool_create(unsigned int heap_mask, unsigned int flags,
+                                               size_t max_bytes) {
+    /*
+     * CPU cannot clear the protected buffers. The users of a protected pool
+     * should accept the content of the previous user with ION_FLAG_NOZEROED.
+     */
+    if (((flags & ION_FLAG_PROTECTED) == ION_FLAG_PROTECTED) && !(flags & ION_FLAG_NOZEROED)) {
+        ALOGE("%s: protected pool of heap %#x requires ION_FLAG_NOZEROED", __func__, heap_mask);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int ion_fd = exynos_ion_open();
+    if (ion_fd < 0)
+        return NULL;
+
+    struct exynos_ion_pool *pool = new exynos_ion_pool;
+
+    pool->ion_fd = ion_fd;
+    pool->heap_mask = heap_mask;
+    pool->flags = flags;
+    pool->max_bytes = max_bytes;
+    pool->cached_bytes = 0;
+    pool->seq = 0;
+
+    return pool;
+}
+
+void exynos_ion_pool_destroy(struct exynos_ion_pool *pool) {
+    if (!pool)
+        return;
+
+    std::vector<int> released;
+
+    ion_pool_evict_locked(pool, 0, released);
+    ion_pool_close(released);
+
+    if (!pool->allocated.empty())
+        ALOGI("%s: %zu buffers are not returned to the pool of heap %#x",
+              __func__, pool->allocated.size(), pool->heap_mask);
+
+    exynos_ion_close(pool->ion_fd);
+
+    delete pool;
+}
+
+int exynos_ion_pool_alloc(struct exynos_ion_pool *pool, size_t len) {
+    size_t size = ion_pool_class_size(len);
+    int fd = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+
+        auto it = pool->free_buffers.find(size);
+        if (it != pool->free_buffers.end()) {
+            /* the most recently freed buffer is likely to be still warm */
+            fd = it->second.back().fd;
+            it->second.pop_back();
+            if (it->second.empty())
+                pool->free_buffers.erase(it);
+            pool->cached_bytes -= size;
+            pool->allocated[fd] = size;
+        }
+    }
+
+    if (fd >= 0) {
+        if ((pool->flags & ION_FLAG_NOZEROED) || (ion_pool_clear(pool, fd, size) == 0))
+            return fd;
+
+        std::lock_guard<std::mutex> lock(pool->lock);
+        pool->allocated.erase(fd);
+        close(fd);
+    }
+
+    fd = exynos_ion_alloc(pool->ion_fd, size, pool->heap_mask, pool->flags);
+    if (fd < 0) {
+        /* The heap may be short of memory because of the buffers in the pool */
+        if (exynos_ion_pool_trim(pool, 0) == 0)
+            return fd;
+        fd = exynos_ion_alloc(pool->ion_fd, size, pool->heap_mask, pool->flags);
+        if (fd < 0)
+            return fd;
+    }
+
+    std::lock_guard<std::mutex> lock(pool->lock);
+    pool->allocated[fd] = size;
+
+    return fd;
+}
+
+int exynos_ion_pool_free(struct exynos_ion_pool *pool, int fd) {
+    std::vector<int> released;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+
+        auto it = pool->allocated.find(fd);
+        if (it == pool->allocated.end()) {
+            ALOGE("%s: fd %d is not allocated from the pool of heap %#x",
+                  __func__, fd, pool->heap_mask);
+            return -EINVAL;
+        }
+
+        size_t size = it->second;
+
+        pool->allocated.erase(it);
+
+        if (size > pool->max_bytes) {
+            released.push_back(fd);
+        } else {
+            pool->free_buffers[size].push_back({fd, pool->seq++});
+            pool->cached_bytes += size;
+            ion_pool_evict_locked(pool, pool->max_bytes, released);
+        }
+    }
+
+    ion_pool_close(released);
+
+    return 0;
+}
+
+size_t exynos_ion_pool_trim(struct exynos_ion_pool *pool, size_t max_cached_bytes) {
+    std::vector<int> released;
+    size_t trimmed;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+
+        size_t cached_bytes = pool->cached_bytes;
+
+        ion_pool_evict_locked(pool, max_cached_bytes, released);
+        trimmed = cached_bytes - pool->cached_bytes;
+    }
+
+    ion_pool_close(released);
+
+    return trimmed;
+}
@@ -239,10 +239,9 @@ TEST_F(IonAPI, DmaHeap)
 {
     MockSystemInterface mockSystemInterface;
 
+    /* The system heap opened by the constructor is reused by the allocations */
     EXPECT_CALL(mockSystemInterface, Open(_))
-        .Times(4)
-        .WillOnce(Return(1))
-        .WillOnce(Return(1))
+        .Times(2)
         .WillOnce(Return(1))
         .WillOnce(Return(-1));
 
@@ -268,10 +267,9 @@ TEST_F(IonAPI, DmaHeap)
         .WillOnce(Return(0))
         .WillOnce(Return(-1));
 
-    EXPECT_CALL(mockSystemInterface, Close(_))
-        .Times(3)
-        .WillOnce(Return(0))
-        .WillOnce(Return(0))
+    /* The cached heap is closed by the destructor */
+    EXPECT_CALL(mockSystemInterface, Close(1))
+        .Times(1)
         .WillOnce(Return(0));
 
     DmabufExporter DmaHeapExporter(mockSystemInterface);
@@ -286,7 +284,8 @@ TEST_F(IonAPI, DmaHeap)
     EXPECT_EQ(-EINVAL, DmaHeapExporter.alloc(1, 4096, 0, ION_FLAG_CACHED));
     EXPECT_EQ(0, DmaHeapExporter.alloc(1, 4096, EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED));
     EXPECT_EQ(-1, DmaHeapExporter.alloc(1, 4096, EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED));
-    EXPECT_EQ(-1, DmaHeapExporter.alloc(1, 4096, EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED));
+    /* No system-uncached heap */
+    EXPECT_EQ(-1, DmaHeapExporter.alloc(1, 4096, EXYNOS_ION_HEAP_SYSTEM_MASK, 0));
 
     /* Sync */
     EXPECT_EQ(0, DmaHeapExporter.sync(1, 1, 0, 0));
@@ -296,6 +295,55 @@ TEST_F(IonAPI, DmaHeap)
     EXPECT_EQ(0, DmaHeapExporter.sync_fd_partial(1, 1, 0, 0));
 }
 
+TEST_F(IonAPI, LargePages)
+{
+    MockSystemInterface mockSystemInterface;
+    struct ion_allocation_data allocated[3];
+    int count = 0;
+
+    EXPECT_CALL(mockSystemInterface, Open(_))
+        .Times(2)
+        .WillOnce(Return(-1))
+        .WillOnce(Return(1));
+
+    /* Determine Modern and Legacy ION by errno of IOC_FREE */
+    EXPECT_CALL(mockSystemInterface, Ioctl(_, ION_IOC_FREE, _))
+        .WillRepeatedly(Return(0));
+
+    EXPECT_CALL(mockSystemInterface, Ioctl(_, ION_IOC_ALLOC, _))
+        .Times(3)
+        .WillRepeatedly([&](int, unsigned int, void *data) {
+            allocated[count++] = *static_cast<struct ion_allocation_data *>(data);
+            return 0;
+        });
+
+    EXPECT_CALL(mockSystemInterface, Ioctl(_, ION_IOC_SHARE, _))
+        .Times(3)
+        .WillRepeatedly(Return(0));
+
+    EXPECT_CALL(mockSystemInterface, Close(_))
+        .Times(1)
+        .WillOnce(Return(0));
+
+    errno = EINVAL;
+    DmabufExporter LegacyExporter(mockSystemInterface);
+
+    EXPECT_EQ(0, LegacyExporter.alloc(1, mkb(8, 4), EXYNOS_ION_HEAP_SYSTEM_MASK,
+                                      ION_FLAG_CACHED | ION_FLAG_LARGE_PAGES));
+    EXPECT_EQ(0, LegacyExporter.alloc(1, kb(64), EXYNOS_ION_HEAP_SYSTEM_MASK,
+                                      ION_FLAG_CACHED | ION_FLAG_LARGE_PAGES));
+    EXPECT_EQ(0, LegacyExporter.alloc(1, mkb(8, 4), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED));
+
+    ASSERT_EQ(3, count);
+
+    /* The flag is not passed to the kernel */
+    EXPECT_EQ(static_cast<size_t>(mb(10)), allocated[0].len);
+    EXPECT_EQ(static_cast<unsigned int>(ION_FLAG_CACHED), allocated[0].flags);
+    EXPECT_EQ(static_cast<size_t>(kb(64)), allocated[1].len);
+    EXPECT_EQ(static_cast<unsigned int>(ION_FLAG_CACHED), allocated[1].flags);
+    EXPECT_EQ(static_cast<size_t>(mkb(8, 4)), allocated[2].len);
+}
+
 TEST_F(IonAPI, TraceNoLegacy)
 {
     MockSystemInterface mockSystemInterface;
@@ -451,3 +499,72 @@ TEST_F(IonAPI, Protected)
 
     exynos_ion_close(ion_fd);
 }
+
+TEST_F(IonAPI, Pool)
+{
+    struct exynos_ion_pool *pool;
+
+    ASSERT_EQ(NULL, exynos_ion_pool_create(EXYNOS_ION_HEAP_VIDEO_STREAM_MASK, ION_FLAG_PROTECTED, mb(4)));
+
+    ASSERT_NE(nullptr, pool = exynos_ion_pool_create(EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED, mb(4)));
+
+    int fd;
+    ASSERT_LE(0, fd = exynos_ion_pool_alloc(pool, mb(1))) << ": " << strerror(errno);
+
+    char *p = reinterpret_cast<char *>(mmap(NULL, mb(1), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    ASSERT_NE(MAP_FAILED, p);
+    memset(p, 0xA5, mb(1));
+    munmap(p, mb(1));
+
+    EXPECT_EQ(0, exynos_ion_pool_free(pool, fd));
+    EXPECT_EQ(-EINVAL, exynos_ion_pool_free(pool, fd));
+
+    /* The recycled buffer should be cleared */
+    int recycled;
+    ASSERT_LE(0, recycled = exynos_ion_pool_alloc(pool, mkb(1, 4)));
+    EXPECT_EQ(fd, recycled);
+
+    off_t erridx;
+    unsigned long val = 0;
+    EXPECT_EQ(static_cast<off_t>(mb(1)), erridx = checkZero(recycled, mb(1), &val))
+              << "non-zero " << val << " found at " << erridx << " byte";
+
+    /* Larger than the pool */
+    int large;
+    ASSERT_LE(0, large = exynos_ion_pool_alloc(pool, mb(8)));
+    EXPECT_EQ(0, exynos_ion_pool_free(pool, large));
+    EXPECT_EQ(0u, exynos_ion_pool_trim(pool, 0));
+
+    EXPECT_EQ(0, exynos_ion_pool_free(pool, recycled));
+    EXPECT_LE(static_cast<size_t>(mb(1)), exynos_ion_pool_trim(pool, 0));
+
+    exynos_ion_pool_destroy(pool);
+}
+
+TEST_F(IonAPI, SyncRanges)
+{
+    struct exynos_ion_sync_ranges ranges;
+
+    exynos_ion_sync_ranges_init(&ranges);
+    exynos_ion_sync_ranges_add(&ranges, 4096, 0);
+    EXPECT_EQ(0u, ranges.count);
+
+    exynos_ion_sync_ranges_add(&ranges, 8192, 100);
+    exynos_ion_sync_ranges_add(&ranges, 0, 100);
+    exynos_ion_sync_ranges_add(&ranges, 100, 100); /* adjoins the second */
+    exynos_ion_sync_ranges_add(&ranges, 8000, 300); /* overlaps the third */
+    ASSERT_EQ(2u, ranges.count);
+    EXPECT_EQ(0, ranges.range[0].offset);
+    EXPECT_EQ(200u, ranges.range[0].len);
+    EXPECT_EQ(8000, ranges.range[1].offset);
+    EXPECT_EQ(300u, ranges.range[1].len);
+
+    /* the ranges more than the limit are merged with the nearest one */
+    exynos_ion_sync_ranges_init(&ranges);
+    for (unsigned int i = 0; i < EXYNOS_ION_SYNC_RANGES_MAX; i++)
+        exynos_ion_sync_ranges_add(&ranges, i * 4096, 16);
+    exynos_ion_sync_ranges_add(&ranges, 4096 + 64, 16);
+    ASSERT_EQ(static_cast<unsigned int>(EXYNOS_ION_SYNC_RANGES_MAX), ranges.count);
+    EXPECT_EQ(4096, ranges.range[1].offset);
+    EXPECT_EQ(80u, ranges.range[1].len);
+}
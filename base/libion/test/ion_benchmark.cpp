@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2021 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+
+#include <hardware/exynos/ion.h>
+
+#include <benchmark/benchmark.h>
+
+#include "ion_test_define.h"
+
+/*
+ * Latency of the allocation, the free, the mapping, the first touch and the
+ * cache maintenance by heap, by size from 4KB to 64MB and by the number of
+ * threads. The names of the benchmarks are <operation>/<heap>/<size>.
+ *
+ * Run with --benchmark_format=json or --benchmark_out=<file> for the output
+ * to compare the kernels. The context of the output has the kernel release
+ * and the allocator of the kernel: "ion" or "dma-heap".
+ */
+struct ion_bench_heap {
+    const char *name;
+    unsigned int heap_mask;
+    unsigned int flags;
+};
+
+static const ion_bench_heap bench_heaps[] = {
+    {"system_cached",   EXYNOS_ION_HEAP_SYSTEM_MASK,        ION_FLAG_CACHED},
+    {"system_uncached", EXYNOS_ION_HEAP_SYSTEM_MASK,        0},
+    {"system_nozeroed", EXYNOS_ION_HEAP_SYSTEM_MASK,        ION_FLAG_CACHED | ION_FLAG_NOZEROED},
+    {"secure_vstream",  EXYNOS_ION_HEAP_VIDEO_STREAM_MASK,  ION_FLAG_PROTECTED},
+};
+
+static bool isMappable(const ion_bench_heap &heap)
+{
+    return (heap.flags & ION_FLAG_PROTECTED) != ION_FLAG_PROTECTED;
+}
+
+class IonBenchBuffer {
+    int m_ionFd;
+    int m_fd = -1;
+public:
+    IonBenchBuffer(benchmark::State &state, const ion_bench_heap &heap, size_t size) {
+        m_ionFd = exynos_ion_open();
+        if (m_ionFd < 0) {
+            state.SkipWithError("failed to open ion");
+            return;
+        }
+
+        m_fd = exynos_ion_alloc(m_ionFd, size, heap.heap_mask, heap.flags);
+        if (m_fd < 0)
+            state.SkipWithError("failed to allocate a buffer");
+    }
+    ~IonBenchBuffer() {
+        if (m_fd >= 0)
+            close(m_fd);
+        if (m_ionFd >= 0)
+            exynos_ion_close(m_ionFd);
+    }
+
+    int getIonFd() { return m_ionFd; }
+    int getFd() { return m_fd; }
+};
+
+static void BM_Alloc(benchmark::State &state, const ion_bench_heap &heap)
+{
+    size_t size = state.range(0);
+    int ion_fd = exynos_ion_open();
+
+    if (ion_fd < 0) {
+        state.SkipWithError("failed to open ion");
+        return;
+    }
+
+    for (auto _ : state) {
+        int fd = exynos_ion_alloc(ion_fd, size, heap.heap_mask, heap.flags);
+        if (fd < 0) {
+            state.SkipWithError("failed to allocate a buffer");
+            break;
+        }
+
+        state.PauseTiming();
+        close(fd);
+        state.ResumeTiming();
+    }
+
+    exynos_ion_close(ion_fd);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+static void BM_Free(benchmark::State &state, const ion_bench_heap &heap)
+{
+    size_t size = state.range(0);
+    int ion_fd = exynos_ion_open();
+
+    if (ion_fd < 0) {
+        state.SkipWithError("failed to open ion");
+        return;
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        int fd = exynos_ion_alloc(ion_fd, size, heap.heap_mask, heap.flags);
+        state.ResumeTiming();
+        if (fd < 0) {
+            state.SkipWithError("failed to allocate a buffer");
+            break;
+        }
+
+        close(fd);
+    }
+
+    exynos_ion_close(ion_fd);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+static void BM_Mmap(benchmark::State &state, const ion_bench_heap &heap)
+{
+    size_t size = state.range(0);
+    IonBenchBuffer buffer(state, heap, size);
+
+    if (buffer.getFd() < 0)
+        return;
+
+    for (auto _ : state) {
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buffer.getFd(), 0);
+        if (p == MAP_FAILED) {
+            state.SkipWithError("failed to map the buffer");
+            break;
+        }
+        munmap(p, size);
+    }
+}
+
+/* The page faults of a new mapping of a buffer written by the CPU */
+static void BM_FirstTouch(benchmark::State &state, const ion_bench_heap &heap)
+{
+    size_t size = state.range(0);
+    IonBenchBuffer buffer(state, heap, size);
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    if (buffer.getFd() < 0)
+        return;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        char *p = static_cast<char *>(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                           buffer.getFd(), 0));
+        state.ResumeTiming();
+        if (p == MAP_FAILED) {
+            state.SkipWithError("failed to map the buffer");
+            break;
+        }
+
+        for (size_t offset = 0; offset < size; offset += pagesize)
+            p[offset] = 1;
+        benchmark::ClobberMemory();
+
+        state.PauseTiming();
+        munmap(p, size);
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+/* The cache maintenance around a write of the whole buffer by the CPU */
+static void BM_Sync(benchmark::State &state, const ion_bench_heap &heap)
+{
+    size_t size = state.range(0);
+    IonBenchBuffer buffer(state, heap, size);
+
+    if (buffer.getFd() < 0)
+        return;
+
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buffer.getFd(), 0);
+    if (p == MAP_FAILED) {
+        state.SkipWithError("failed to map the buffer");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (exynos_ion_sync_start(buffer.getIonFd(), buffer.getFd(), ION_SYNC_WRITE) < 0) {
+            state.SkipWithError("failed to start the cpu access");
+            break;
+        }
+
+        state.PauseTiming();
+        memset(p, 0, size);
+        state.ResumeTiming();
+
+        if (exynos_ion_sync_end(buffer.getIonFd(), buffer.getFd(), ION_SYNC_WRITE) < 0) {
+            state.SkipWithError("failed to end the cpu access");
+            break;
+        }
+    }
+
+    munmap(p, size);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+static void registerBenchmark(const char *op, void (*fn)(benchmark::State &, const ion_bench_heap &),
+                              const ion_bench_heap &heap)
+{
+    std::string name = std::string(op) + "/" + heap.name;
+
+    benchmark::RegisterBenchmark(name.c_str(), fn, heap)
+        ->RangeMultiplier(4)->Range(kb(4), mb(64))
+        ->Threads(1)->Threads(4)
+        ->UseRealTime();
+}
+
+int main(int argc, char *argv[])
+{
+    struct utsname uts;
+
+    if (uname(&uts) == 0)
+        benchmark::AddCustomContext("kernel", uts.release);
+    /* libion_exynos prefers dma-heap to ion if the kernel has both */
+    benchmark::AddCustomContext("allocator",
+                                (access("/dev/dma_heap/system", F_OK) == 0) ? "dma-heap" : "ion");
+
+    for (auto &heap : bench_heaps) {
+        registerBenchmark("alloc", BM_Alloc, heap);
+        registerBenchmark("free", BM_Free, heap);
+        if (!isMappable(heap))
+            continue;
+        registerBenchmark("mmap", BM_Mmap, heap);
+        registerBenchmark("first_touch", BM_FirstTouch, heap);
+        if (heap.flags & ION_FLAG_CACHED)
+            registerBenchmark("sync", BM_Sync, heap);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+
+    return 0;
+}
@@ -1,10 +1,10 @@
-#include <fstream>
-#include <sstream>
-#include <regex>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
-#include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <cerrno>
 #include <sys/stat.h>
@@ -14,6 +14,7 @@
 #include <hardware/exynos/ion.h>
 
 #include "memtrack_exynos.h"
+#include "memtrack_text.h"
 
 using namespace std;
 
@@ -34,18 +35,19 @@ struct DmabufBuffer {
         : id(_id), type(MEMTRACK_FLAG_SMAPS_UNACCOUNTED | MEMTRACK_FLAG_SHARED_PSS), size(_size), pss(_pss)
     { }
     void setFlags(unsigned int flags) { type |= (flags & ION_FLAG_PROTECTED) ? MEMTRACK_FLAG_SECURE : MEMTRACK_FLAG_NONSECURE; }
-    void setPoolType(string _type) { type |= (_type == "carveout") ? MEMTRACK_FLAG_DEDICATED : MEMTRACK_FLAG_SYSTEM; }
+    void setPoolType(const char *_type, size_t len) {
+        type |= ((len == 8) && !memcmp(_type, "carveout", 8)) ? MEMTRACK_FLAG_DEDICATED : MEMTRACK_FLAG_SYSTEM;
+    }
 };
 
 const char ION_BUFFERS_PATH[] = "/sys/kernel/debug/ion/buffers";
 
 static bool is_gki_dmabuf_footprint(void)
 {
-    ifstream ion(ION_BUFFERS_PATH);
-    if (!ion)
-        return true;
+    // the kernel does not change while the HAL is running
+    static const bool gki = access(ION_BUFFERS_PATH, R_OK) != 0;
 
-    return false;
+    return gki;
 }
 
 struct dmabuf_trace_memory {
@@ -62,54 +64,46 @@ struct dmabuf_trace_memory {
 #define DMABUF_TRACE_IOCTL_GET_MEMORY	_IOWR(DMABUF_TRACE_BASE, 0, struct dmabuf_trace_memory)
 
 const char DMABUF_TRACE_PATH[] = "/dev/dmabuf_trace";
-static int dmabuf_gki_footprint(struct memtrack_record *records, pid_t pid, int type, int count)
+static int dmabuf_trace_fd(void)
 {
-    struct dmabuf_trace_memory data;
+    static mutex lock;
+    static int fd = -1;
 
-    struct LocalSweeper {
-        int fd;
-        uint32_t *flags;
-        uint32_t *size_in_bytes;
+    lock_guard<mutex> guard(lock);
 
-        LocalSweeper() : fd(0), flags(nullptr), size_in_bytes(nullptr) { }
-        ~LocalSweeper() {
-            if (fd)
-                close(fd);
+    // opened once and shared by all queries. Retried if it failed.
+    if (fd < 0)
+        fd = open(DMABUF_TRACE_PATH, O_RDONLY | O_CLOEXEC);
 
-            if (flags)
-                free(flags);
+    return fd;
+}
 
-            if (size_in_bytes)
-                free(size_in_bytes);
-        }
-    } sweeper;
+static int dmabuf_gki_footprint(struct memtrack_record *records, pid_t pid, int type, int count)
+{
+    struct dmabuf_trace_memory data;
+    uint32_t flags[NUM_AVAILABLE_FLAGS];
+    uint32_t size_in_bytes[NUM_AVAILABLE_FLAGS] = {0, };
 
-    int fd = open(DMABUF_TRACE_PATH, O_RDONLY | O_CLOEXEC);
+    int fd = dmabuf_trace_fd();
     if (fd < 0)
         return -EACCES;
-    sweeper.fd = fd;
-
-    data.flags = (uint32_t *)calloc(count, sizeof(int32_t));
-    if (!data.flags)
-        return -ENOMEM;
-    sweeper.flags = data.flags;
 
-    data.size_in_bytes = (uint32_t *)calloc(count, sizeof(int32_t));
-    if (!data.size_in_bytes)
-        return -ENOMEM;
-    sweeper.size_in_bytes = data.size_in_bytes;
+    if (count > static_cast<int>(NUM_AVAILABLE_FLAGS))
+        count = NUM_AVAILABLE_FLAGS;
 
+    data.flags = flags;
+    data.size_in_bytes = size_in_bytes;
     data.type = type;
     data.count = count;
     data.pid = pid;
-    for (size_t i = 0; i < count; i++)
+    for (int i = 0; i < count; i++)
         data.flags[i] = available_flags[i];
 
     int ret = ioctl(fd, DMABUF_TRACE_IOCTL_GET_MEMORY, &data);
     if (ret < 0)
         return ret;
 
-    for (size_t i = 0; i < count; i++)
+    for (int i = 0; i < count; i++)
         records[i].size_in_bytes = data.size_in_bytes[i];
 
     return 0;
@@ -119,47 +113,69 @@ const char DMABUF_FOOTPRINT_PATH[] = "/sys/kernel/debug/dma_buf/footprint/";
 
 static int dmabuf_footprint(vector<DmabufBuffer> &buffers, pid_t pid, int type)
 {
-    ostringstream dmabuf_path;
-    dmabuf_path << DMABUF_FOOTPRINT_PATH << pid;
+    // reused by the calls from the same thread
+    static thread_local string text;
+    char dmabuf_path[sizeof(DMABUF_FOOTPRINT_PATH) + 16];
 
-    ifstream dmabuf(dmabuf_path.str());
-    if (!dmabuf)
+    snprintf(dmabuf_path, sizeof(dmabuf_path), "%s%d", DMABUF_FOOTPRINT_PATH, pid);
+
+    if (read_text_file(dmabuf_path, text))
         return -ENODEV;
 
+    // index of the buffers by id
+    unordered_map<unsigned int, size_t> index;
+
     //
     // exp_name      size     share
     // ion-102   69271552  34635776
-    regex rex("\\s*ion-(\\d+)\\s+(\\d+)\\s+(\\d+).*");
-    smatch mch;
-    // 1-id, 2-size, 3-pss
-    for (string line; getline(dmabuf, line); )
-        if (regex_match(line, mch, rex))
-            buffers.emplace_back(stoul(mch[1], 0, 10), stoul(mch[2], 0, 10), stoul(mch[3], 0, 10));
+    for (const char *p = text.data(), *eof = p + text.size(); p < eof; ) {
+        TextLine line(p, eof, &p);
+        unsigned int id;
+        size_t size, pss;
+
+        line.skipSpaces();
+        if (line.expect("ion-") && line.number(id) && line.spaces() &&
+                line.number(size) && line.spaces() && line.number(pss)) {
+            index.emplace(id, buffers.size());
+            buffers.emplace_back(id, size, pss);
+        }
+    }
 
     if (buffers.size() == 0)
         return 0;
 
-    ifstream ion(ION_BUFFERS_PATH);
-    if (!ion)
+    // read for every process. It is kept open by each thread.
+    static thread_local TextFile ion_buffers(ION_BUFFERS_PATH);
+
+    if (ion_buffers.read(text))
         return -ENODEV;
 
     // [  id]            heap heaptype flags size(kb) : iommu_mapped...
     // [ 106] ion_system_heap   system  0x40    16912 : 19080000.dsim(0)
-    regex rexion("\\[ *(\\d+)\\] +[[:alnum:]\\-_]+ +(\\w+) +([x[:xdigit:]]+) +(\\d+).*");
-    // 1-id, 2-heaptype, 3-flags, 4-size
-    for (string line; getline(ion, line); ) {
-        if (regex_match(line, mch, rexion)) {
-            unsigned int id = stoul(mch[1], 0, 10);
-            unsigned int flags = stoul(mch[3], 0, 16);
-            size_t len = stoul(mch[4], 0, 10) * 1024;
-            auto elem = find_if(begin(buffers), end(buffers), [id, len] (auto &item) {
-                                    return (item.id == id) && (item.size == len);
-                                });
-            // passes if type = OTHER && not flag & hwrender or type == GRAPHIC && flag & hwrender
-            if ((elem != end(buffers)) && ((type == MEMTRACK_TYPE_OTHER) == !(flags & ION_FLAG_MAY_HWRENDER))) {
-                elem->setFlags(flags);
-                elem->setPoolType(mch[2]);
-            }
+    for (const char *p = text.data(), *eof = p + text.size(); p < eof; ) {
+        TextLine line(p, eof, &p);
+        unsigned int id, flags;
+        size_t len;
+        const char *heapname, *heaptype;
+        size_t namelen, typelen;
+
+        if (!line.expect('['))
+            continue;
+        line.skipSpaces();
+        if (!line.number(id) || !line.expect(']') || !line.spaces() ||
+                !line.word(&heapname, &namelen) || !line.spaces() ||
+                !line.word(&heaptype, &typelen) || !line.spaces() ||
+                !line.number(flags, 16) || !line.spaces() || !line.number(len))
+            continue;
+
+        auto elem = index.find(id);
+        if ((elem == index.end()) || (buffers[elem->second].size != len * 1024))
+            continue;
+
+        // passes if type = OTHER && not flag & hwrender or type == GRAPHIC && flag & hwrender
+        if ((type == MEMTRACK_TYPE_OTHER) == !(flags & ION_FLAG_MAY_HWRENDER)) {
+            buffers[elem->second].setFlags(flags);
+            buffers[elem->second].setPoolType(heaptype, typelen);
         }
     }
 
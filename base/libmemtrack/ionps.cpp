@@ -2,22 +2,26 @@
 #include <errno.h>
 #include <fstream>
 #include <sstream>
-#include <regex>
 #include <list>
 #include <algorithm>
 #include <iomanip>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include <dirent.h>
 #include <cerrno>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <getopt.h>
 
 #include <hardware/exynos/ion.h>
 
+#include "memtrack_text.h"
+
 #define MAX_NAME_SIZE 64
 
 using namespace std;
@@ -57,7 +61,7 @@ struct BufferNode {
     }
     void setTraceNode(unsigned int refcount, ProcessNode *procNode);
     void setMapNode(unsigned int fd, ProcessNode *procNode);
-    string getIonFlag(void);
+    string getIonFlag(void) const;
 
     unsigned int id;
     unsigned int flags;
@@ -126,6 +130,7 @@ public:
     void printProcess(ProcessNode &processNode);
     void print();
     void printSummary(void);
+    void printDelta(const MapTable &prev);
 private:
     unsigned int totalIonMemory;
     BufferType bufferList;
@@ -162,7 +167,7 @@ void BufferNode::setMapNode(unsigned int fd, ProcessNode *procNode)
     node.first->second.fd = fd;
 }
 
-string BufferNode::getIonFlag(void)
+string BufferNode::getIonFlag(void) const
 {
     string tag;
 
@@ -240,31 +245,37 @@ const char DMABUF_FOOTPRINT_PATH[] = "/sys/kernel/debug/dma_buf/footprint";
 
 bool MapTable::setupBuffer()
 {
-    ifstream ion(ION_BUFFERS_PATH);
-    if (!ion) {
+    string text;
+
+    if (read_text_file(ION_BUFFERS_PATH, text)) {
         cout << "Buffer path does not exist (" << ION_BUFFERS_PATH << ")" << endl;
         return false;
     }
 
     // [  id]            heap heaptype flags size(kb)
     // [ 106] ion_system_heap   system  0x40    16912
-    regex rexion_ion("\\[ *(\\d+)\\] +(\\w+)+ +(\\w+) +([x[:xdigit:]]+) +(\\d+).*");
-    smatch mch;
-
-    // 1-id, 2-heapname 3-heaptype, 3-flags, 4-size
-    for (string line; getline(ion, line); ) {
-        if (regex_match(line, mch, rexion_ion)) {
-            unsigned int id = stoul(mch[1]);
-            unsigned int flags = stoul(mch[4], 0, 16);
-            size_t len = stoul(mch[5]);
-
-            bufferList.emplace(id, BufferNode(id, flags, len * 1024, mch[3], mch[2]));
-            totalIonMemory += len;
-        }
+    for (const char *p = text.data(), *eof = p + text.size(); p < eof; ) {
+        TextLine line(p, eof, &p);
+        unsigned int id, flags;
+        size_t len;
+        const char *heapname, *heaptype;
+        size_t namelen, typelen;
+
+        if (!line.expect('['))
+            continue;
+        line.skipSpaces();
+        if (!line.number(id) || !line.expect(']') || !line.spaces() ||
+                !line.word(&heapname, &namelen) || !line.spaces() ||
+                !line.word(&heaptype, &typelen) || !line.spaces() ||
+                !line.number(flags, 16) || !line.spaces() || !line.number(len))
+            continue;
+
+        bufferList.emplace(id, BufferNode(id, flags, len * 1024, string(heaptype, typelen),
+                                          string(heapname, namelen)));
+        totalIonMemory += len;
     }
 
-    ifstream dmabuf(DMABUF_BUFINFO_PATH);
-    if (!dmabuf) {
+    if (read_text_file(DMABUF_BUFINFO_PATH, text)) {
         cout << "dmabuf path does not exist (" << DMABUF_BUFINFO_PATH << ")" << endl;
         return false;
     }
@@ -276,29 +287,34 @@ bool MapTable::setupBuffer()
     //  18500000.mali
     //Total 1 devices attached
     //
-    regex rexion_dmabuf("(\\d+)\\s+(\\d{8})\\s+(\\d{8})\\s+(\\d{8})\\s+ion\\-(\\d+).*");
-    for (string line; getline(dmabuf, line); ) {
+    for (const char *p = text.data(), *eof = p + text.size(); p < eof; ) {
+        TextLine line(p, eof, &p);
+        size_t size;
+        unsigned int bufflags, mode, file_count, id;
+
         // 1-size 2-flags 3-mode 4-count 5-id
-        if (regex_match(line, mch, rexion_dmabuf)) {
-            unsigned int file_count = stoul(mch[4]);
-            unsigned id = stoul(mch[5]);
+        if (!line.number(size) || !line.spaces() || !line.number(bufflags) || !line.spaces() ||
+                !line.number(mode) || !line.spaces() || !line.number(file_count) || !line.spaces() ||
+                !line.expect("ion-") || !line.number(id))
+            continue;
 
-            BufferNode *bufferNode = getBufferNode(id);
-            if (!bufferNode)
-                continue;
+        BufferNode *bufferNode = getBufferNode(id);
+        if (!bufferNode)
+            continue;
 
-            bufferNode->setFileCount(file_count);
+        bufferNode->setFileCount(file_count);
 
-            // Attached Devices:
-            getline(dmabuf, line);
+        // Attached Devices:
+        p = TextLine::next(p, eof);
 
-            while (getline(dmabuf, line)) {
-                // Total n devices attached
-                if (!line.compare(0, 5, "Total"))
-                    break;
+        while (p < eof) {
+            TextLine device(p, eof, &p);
 
-                bufferNode->setAttachDevice(line);
-            }
+            // Total n devices attached
+            if (device.expect("Total"))
+                break;
+
+            bufferNode->setAttachDevice(string(device.pos, device.end - device.pos));
         }
     }
 
@@ -318,6 +334,7 @@ bool MapTable::setupTraceInfo()
     }
 
     struct dirent *ProcessDirectory;
+    string text;
 
     while ((ProcessDirectory = readdir(proc)) != NULL) {
         char *strptr;
@@ -329,33 +346,34 @@ bool MapTable::setupTraceInfo()
         ostringstream file_directory;
         file_directory << DMABUF_FOOTPRINT_PATH << "/" << pid;
 
-        ifstream trace(file_directory.str().c_str());
-        if (!trace) {
+        if (read_text_file(file_directory.str().c_str(), text)) {
             closedir(proc);
             cout << "Process file of footprint does not exist (" << file_directory.str() << ")" << endl;
             return false;
         }
 
-        smatch mch;
-        regex rexion_trace(" *ion\\-(\\d+) *(\\d+) *(\\d+) *(\\d+)");
         ProcessNode *procNode = nullptr;
 
-        for (string line; getline(trace, line); ) {
+        for (const char *p = text.data(), *eof = p + text.size(); p < eof; ) {
+            TextLine line(p, eof, &p);
+            unsigned int id, refcount;
+            size_t size, share;
+
             // 1-id 2-size 3-share 4-refcount
-            if (regex_match(line, mch, rexion_trace)) {
-                    unsigned int id = stoul(mch[1]);
-                    unsigned int refcount = stoul(mch[4]);
+            line.skipSpaces();
+            if (!line.expect("ion-") || !line.number(id) || !line.spaces() || !line.number(size) ||
+                    !line.spaces() || !line.number(share) || !line.spaces() || !line.number(refcount))
+                continue;
 
-                    BufferNode *bufferNode = getBufferNode(id);
-                    if (!bufferNode)
-                        continue;
+            BufferNode *bufferNode = getBufferNode(id);
+            if (!bufferNode)
+                continue;
 
-                    if (!procNode)
-                        procNode = setupProcessNode(pid);
+            if (!procNode)
+                procNode = setupProcessNode(pid);
 
-                    bufferNode->setTraceNode(refcount, procNode);
-                    procNode->setTraceNode(refcount, bufferNode);
-            }
+            bufferNode->setTraceNode(refcount, procNode);
+            procNode->setTraceNode(refcount, bufferNode);
         }
     }
 
@@ -569,6 +587,85 @@ void MapTable::print(void)
         printProcess(process.second);
 }
 
+static unsigned int processResidentSize(const ProcessNode &procNode)
+{
+    unsigned int rss = 0;
+
+    for (auto node : procNode.mapList)
+        rss += node.second.bufferNode->size;
+
+    return rss;
+}
+
+static void printBufferLine(char prefix, const BufferNode &bufferNode)
+{
+    cout << prefix << setw(7) << bufferNode.id << setw(10) << bufferNode.size;
+    cout << setw(8) << bufferNode.getIonFlag();
+    cout << setw(20) << bufferNode.HeapName << setw(10) << bufferNode.HeapType << endl;
+}
+
+static void printSizeDelta(const string &name, long long prev, long long cur)
+{
+    cout << "  " << setw(26) << name << setw(10) << prev / 1024 << "K -> ";
+    cout << setw(10) << cur / 1024 << "K (" << showpos << (cur - prev) / 1024 << noshowpos << "K)" << endl;
+}
+
+/*
+ * Prints the difference from @prev: the new and the freed buffers, and the
+ * change of the size by heap and the resident size by process.
+ */
+void MapTable::printDelta(const MapTable &prev)
+{
+    time_t now = time(NULL);
+    char timestamp[32];
+
+    strftime(timestamp, sizeof(timestamp), "%T", localtime(&now));
+    cout << "---- " << timestamp << " total ion memory : " << totalIonMemory << "KB (";
+    cout << showpos << static_cast<long long>(totalIonMemory) - prev.totalIonMemory << noshowpos << "KB)" << endl;
+
+    for (auto &buffer : bufferList) {
+        auto old = prev.bufferList.find(buffer.first);
+        if ((old == prev.bufferList.end()) || (old->second.size != buffer.second.size))
+            printBufferLine('+', buffer.second);
+    }
+
+    for (auto &buffer : prev.bufferList) {
+        auto cur = bufferList.find(buffer.first);
+        if ((cur == bufferList.end()) || (cur->second.size != buffer.second.size))
+            printBufferLine('-', buffer.second);
+    }
+
+    map<string, pair<long long, long long>> heaps;
+
+    for (auto &buffer : prev.bufferList)
+        heaps[buffer.second.HeapName].first += buffer.second.size;
+    for (auto &buffer : bufferList)
+        heaps[buffer.second.HeapName].second += buffer.second.size;
+
+    for (auto &heap : heaps) {
+        if (heap.second.first != heap.second.second)
+            printSizeDelta(heap.first, heap.second.first, heap.second.second);
+    }
+
+    map<unsigned int, pair<long long, long long>> processes;
+
+    for (auto &process : prev.processList)
+        processes[process.first].first = processResidentSize(process.second);
+    for (auto &process : processList)
+        processes[process.first].second = processResidentSize(process.second);
+
+    for (auto &process : processes) {
+        if (process.second.first == process.second.second)
+            continue;
+
+        auto node = processList.find(process.first);
+        const string &comm = (node != processList.end()) ? node->second.comm :
+                             prev.processList.find(process.first)->second.comm;
+
+        printSizeDelta(to_string(process.first) + " " + comm, process.second.first, process.second.second);
+    }
+}
+
 void MapTable::printSummary(void)
 {
     cout << endl;
@@ -585,13 +682,12 @@ void MapTable::printSummary(void)
     for (auto process : processList) {
         ProcessNode procNode = process.second;
         unsigned int pss = 0;
-        unsigned int rss = 0;
+        unsigned int rss = processResidentSize(procNode);
 
         for (auto node : procNode.mapList) {
             BufferNode *bufferNode = node.second.bufferNode;
 
             pss += bufferNode->size / bufferNode->mapList.size();
-            rss += bufferNode->size;
         }
 
         cout << setw(10) << procNode.pid << setw(15) << rss / 1024 << "K" << setw(20) << pss / 1024;
@@ -631,7 +727,7 @@ static void printHeap(string heapName)
 
 static void printHelp(void)
 {
-    cout << "usage : ionps [-aesh] [-b BUFFER ID] [-p PROCESS ID] [-H HEAP NAME]" << endl;
+    cout << "usage : ionps [-aesh] [-b BUFFER ID] [-p PROCESS ID] [-H HEAP NAME] [-t INTERVAL]" << endl;
 
     cout << setw(5) << "-b" << setw(10) << "--buffer" << setw(20) << "<buffer index>";
     cout << "   show process information that owns request buffer" << endl;
@@ -645,6 +741,8 @@ static void printHelp(void)
     cout <<  "   show every buffer, process in detail" << endl;
     cout << setw(5) << "-s" << setw(10) << "--summary" << setw(20) << " ";
     cout <<  "   show summary such as ion total memory, and rss, pss by process" << endl;
+    cout << setw(5) << "-t" << setw(10) << "--top" << setw(20) << "<seconds>";
+    cout <<  "   show new and freed buffers, and size changes by heap and process every interval" << endl;
     cout << setw(5) << "-h" << setw(10) << "--help" << setw(20) << " ";
     cout << "   This help message" << endl << endl;
 
@@ -706,6 +804,35 @@ static int args_to_num(const char *optarg)
     return num;
 }
 
+/* Samples the tables every @interval seconds and prints the changes until killed */
+static int runTop(MapTable &first, int interval)
+{
+    if (interval <= 0) {
+        cout << "Invalid interval " << interval << endl;
+        return -1;
+    }
+
+    unique_ptr<MapTable> prev;
+    MapTable *last = &first;
+
+    first.printSummary();
+
+    for (;;) {
+        sleep(interval);
+
+        unique_ptr<MapTable> cur(new MapTable());
+        if (!(cur->setupBuffer() && cur->setupTraceInfo() && cur->setupMapInfo()))
+            return -1;
+
+        cur->printDelta(*last);
+
+        prev = move(cur);
+        last = prev.get();
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     setupHeapName();
@@ -727,12 +854,13 @@ int main(int argc, char *argv[])
         {"event",     required_argument,  0,          'e'},
         {"all",       no_argument,        0,          'a'},
         {"summary",   no_argument,        0,          's'},
+        {"top",       required_argument,  0,          't'},
         {"help",      no_argument,        0,          'h'},
         {0, 0, 0, 0}
     };
 
     int c, option_index = 0;
-    if ((c = getopt_long(argc, argv, "b:p:H:eash", long_options, &option_index)) == -1) {
+    if ((c = getopt_long(argc, argv, "b:p:H:t:eash", long_options, &option_index)) == -1) {
         cout << "No argument" << endl;
 
         return -1;
@@ -771,6 +899,8 @@ int main(int argc, char *argv[])
         case 's':
             maptable.printSummary();
             break;
+        case 't':
+            return runTop(maptable, args_to_num(optarg));
         case '?':
             cout << "Unknown option " << optopt << " @ " << optind << endl;
             return -1;
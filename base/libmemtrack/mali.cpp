@@ -23,7 +23,13 @@
 
 #include <hardware/memtrack.h>
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 #include "memtrack_exynos.h"
+#include "memtrack_text.h"
 
 /* Following includes added for directory parsing. */
 #include <sys/types.h>
@@ -82,6 +88,9 @@ static void scan_directory_for_filenames(pid_t pid)
              * contents. Also concatenate the directory path, so that
              * file can be opened.
              * */
+            if (libmemtrack_gbl_input_filename_counter == MAX_FILES_PER_PID)
+                break;
+
             if (!strncmp(entries->d_name, pid_string, pid_len)) {
                 snprintf(libmemtrack_gbl_input_filename[libmemtrack_gbl_input_filename_counter], MAX_FILES_PER_NAME, "%s%s%s", MALI_DEBUG_FS_PATH, entries->d_name, MALI_DEBUG_MEM_FILE);
                 libmemtrack_gbl_input_filename_counter++;
@@ -96,16 +105,89 @@ static void scan_directory_for_filenames(pid_t pid)
     return;
 }
 
+/*
+ * The mem_profile files are kept open for the next queries. The files of the
+ * exited processes are removed from debugfs and their reads fail. They are
+ * closed when the read fails or when too many files are open.
+ */
+#define MAX_OPEN_PROFILES 256
+
+static std::unordered_map<std::string, std::unique_ptr<TextFile>> mali_profiles;
+static std::string mali_profile_text;
+
+static int read_mem_profile(const char *path)
+{
+    auto it = mali_profiles.find(path);
+
+    if (it == mali_profiles.end()) {
+        if (mali_profiles.size() >= MAX_OPEN_PROFILES)
+            mali_profiles.clear();
+        it = mali_profiles.emplace(path, std::make_unique<TextFile>(path)).first;
+    }
+
+    int ret = it->second->read(mali_profile_text);
+    if (ret)
+        mali_profiles.erase(it);
+
+    return ret;
+}
+
+static inline void add_memory_size(long long int &total, long long int val)
+{
+    if ((INT64_MAX - val) > total)
+        total += val;
+    else
+        total = INT64_MAX;
+}
+
+/*
+ * Adds the size of the native buffers and the total size of the profile in
+ * mali_profile_text. The total memory after the native buffers is added. If
+ * the DDK does not support the native buffers, all the total memory is added.
+ */
+static void parse_mem_profile(long long int *native_buf_mem_size, long long int *total_memory_size)
+{
+    const char *eof = mali_profile_text.data() + mali_profile_text.size();
+    const char *total_start = mali_profile_text.data();
+    long long int val;
+
+    /* Format:
+     *
+     * Channel: Native Buffer (Total memory: 44285952)
+     *
+     */
+    for (const char *p = mali_profile_text.data(); p < eof; ) {
+        TextLine line(p, eof, &p);
+
+        if (line.skipWords(1) && line.spaces() && line.token("Native") && line.spaces() &&
+                line.token("Buffer") && line.skipWords(2) && line.spaces() && line.number(val)) {
+            add_memory_size(*native_buf_mem_size, val);
+            total_start = p;
+            break;
+        }
+    }
+
+    /* Format:
+     *
+     * Total allocated memory: 36146960
+     *
+     */
+    for (const char *p = total_start; p < eof; ) {
+        TextLine line(p, eof, &p);
+
+        line.skipSpaces();
+        if (line.token("Total") && line.skipWords(2) && line.spaces() && line.number(val))
+            add_memory_size(*total_memory_size, val);
+    }
+}
+
 int mali_memtrack_get_memory(pid_t pid, int __unused type,
                              struct memtrack_record *records,
                              size_t *num_records)
 {
+    static std::mutex lock;
     size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
-    FILE *fp;
-    int local_count;
-    long long int temp_val = 0, total_memory_size = 0, native_buf_mem_size = 0;
-    bool native_buffer_read = false;
-    char line[1024] = {0};
+    long long int total_memory_size = 0, native_buf_mem_size = 0;
 
     *num_records = ARRAY_SIZE(record_templates);
 
@@ -117,109 +199,18 @@ int mali_memtrack_get_memory(pid_t pid, int __unused type,
     memcpy(records, record_templates,
            sizeof(struct memtrack_record) * allocated_records);
 
+    std::lock_guard<std::mutex> guard(lock);
+
     /* First, scan the directoy. */
     scan_directory_for_filenames(pid);
 
-    local_count = 0;
-    total_memory_size = 0;
-    native_buf_mem_size = 0;
-
-    while (local_count < libmemtrack_gbl_input_filename_counter) {
-        fp = fopen(&libmemtrack_gbl_input_filename[local_count][0], "r");
-
-        if (fp == NULL) {
-            /* Unable to open the file. Either move to next file, or
-             * return to caller. */
-            local_count++;
+    for (int i = 0; i < libmemtrack_gbl_input_filename_counter; i++) {
+        /* Unable to read the file. Move to next file. */
+        if (read_mem_profile(libmemtrack_gbl_input_filename[i]))
             continue;
-        }
 
-        while (1) {
-            char memory_type[16] = {0};
-            char memory_type_2[16] = {0};
-            int ret = 0;
-
-            if (native_buffer_read == false) {
-                if (fgets(line, sizeof(line), fp) == NULL) {
-                    if (native_buffer_read == false) {
-                        /* Unable to read Native buffer.
-                         * Probably DDK doesn't support Native Buffer.
-                         * Reset to start of file and look for Total
-                         * Memory. */
-                        fseek(fp, 0, SEEK_SET);
-
-                        /* Also, set Native buffer flag and memory sizes. */
-                        native_buffer_read = true;
-                        continue;
-                    }
-                }
-
-                /* Search for Total memory. */
-                /* Format:
-                 *
-                 * Channel: Native Buffer (Total memory: 44285952)
-                 *
-                 */
-                ret = sscanf(line, "%*s %15s %15s %*s %*s %lld \n", memory_type, memory_type_2, &temp_val);
-
-                if (ret != 3)
-                    continue;
-
-                if ((strcmp(memory_type, "Native") == 0) &&
-                        (strcmp(memory_type_2, "Buffer") == 0)) {
-                    /* Set native buffer memory read flag to true. */
-                    native_buffer_read = true;
-                    if ((INT64_MAX - temp_val) > native_buf_mem_size)
-                        native_buf_mem_size += temp_val;
-                    else
-                        native_buf_mem_size = INT64_MAX;
-                } else {
-                    /* Ignore case. Nothing to do here. */
-                    /* Continue reading file until NativeBuffer is found. */
-                }
-            } else {
-                if (fgets(line, sizeof(line), fp) == NULL) {
-                    /* Unable to find, so break the loop here.*/
-                    break;
-                }
-
-                /* Search for Total memory. */
-                /* Format:
-                 *
-                 * Total allocated memory: 36146960
-                 *
-                 */
-                ret = sscanf(line, "%15s %*s %*s %lld \n", memory_type, &temp_val);
-
-                if (ret != 2)
-                    continue;
-
-                if (strcmp(memory_type, "Total") == 0) {
-                    /* Store total memory. */
-                    if ((INT64_MAX - temp_val) > total_memory_size)
-                        total_memory_size += temp_val;
-                    else
-                        total_memory_size = INT64_MAX;
-                } else {
-                    /* Ignore case. Nothing to do here. */
-                }
-            } /* end if (native_buffer_read == false) */
-
-        } /* End while(1) */
-
-        if (fp != NULL) {
-            /* Close the opened file. */
-            fclose(fp);
-
-            /* Reset some of the local variables here. */
-            fp = NULL;
-            native_buffer_read = false;
-        }
-
-        /* Manage local variables and counters. */
-        local_count++;
-
-    } /* while (local_count <= libmemtrack_gbl_input_filename_counter) */
+        parse_mem_profile(&native_buf_mem_size, &total_memory_size);
+    }
 
     /* Arrange and return memory size details. */
     if (allocated_records > 0)
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MEMTRACK_TEXT_H_
+#define _MEMTRACK_TEXT_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+/*
+ * Tokenizer of the text files of debugfs and procfs
+ *
+ * read_text_file() reads the whole file into @buf that is reused by the
+ * callers for the next files without reallocation. TextFile keeps a file
+ * open for the repeated queries of the same file. TextLine scans a line in
+ * the buffer: the parsers return false without moving the position if the
+ * text at the position does not match.
+ */
+static inline int read_text_file(const char *path, std::string &buf)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    size_t len = 0;
+
+    buf.resize(buf.capacity() > 4096 ? buf.capacity() : 4096);
+
+    for (;;) {
+        if (len == buf.size())
+            buf.resize(buf.size() * 2);
+
+        ssize_t ret = read(fd, &buf[len], buf.size() - len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            ret = -errno;
+            close(fd);
+            buf.clear();
+            return static_cast<int>(ret);
+        }
+        if (ret == 0)
+            break;
+        len += ret;
+    }
+
+    close(fd);
+    buf.resize(len);
+
+    return 0;
+}
+
+/*
+ * A text file kept open for the queries. read() reads the file again from the
+ * start with pread() into @buf. The file is opened again once if the read
+ * fails because the file of debugfs may be removed and created again.
+ */
+class TextFile {
+public:
+    explicit TextFile(const char *path) : mPath(path) { }
+    ~TextFile() {
+        if (mFd >= 0)
+            close(mFd);
+    }
+    TextFile(const TextFile &) = delete;
+    TextFile &operator=(const TextFile &) = delete;
+
+    int read(std::string &buf) {
+        for (int retry = 0; retry < 2; retry++) {
+            if (mFd < 0) {
+                mFd = open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+                if (mFd < 0)
+                    return -errno;
+            }
+
+            int ret = readAll(buf);
+            if (ret == 0)
+                return 0;
+
+            close(mFd);
+            mFd = -1;
+            if (retry > 0)
+                return ret;
+        }
+
+        return -EIO;
+    }
+
+private:
+    int readAll(std::string &buf) {
+        size_t len = 0;
+
+        buf.resize(buf.capacity() > 4096 ? buf.capacity() : 4096);
+
+        for (;;) {
+            if (len == buf.size())
+                buf.resize(buf.size() * 2);
+
+            ssize_t ret = pread(mFd, &buf[len], buf.size() - len, len);
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                buf.clear();
+                return -errno;
+            }
+            if (ret == 0)
+                break;
+            len += ret;
+        }
+
+        buf.resize(len);
+
+        return 0;
+    }
+
+    std::string mPath;
+    int mFd = -1;
+};
+
+struct TextLine {
+    const char *pos;
+    const char *end;
+
+    // the line at @p that ends before a newline or @eof. @nextline is the next line.
+    TextLine(const char *p, const char *eof, const char **nextline) : pos(p) {
+        end = static_cast<const char *>(memchr(p, '\n', eof - p));
+        if (!end)
+            end = eof;
+        *nextline = (end < eof) ? end + 1 : eof;
+    }
+
+    // the start of the line after the line at @p
+    static const char *next(const char *p, const char *eof) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', eof - p));
+        return eol ? eol + 1 : eof;
+    }
+
+    static bool isSpace(char c) { return (c == ' ') || (c == '\t') || (c == '\v') || (c == '\r'); }
+
+    // skips zero or more spaces
+    void skipSpaces() {
+        while ((pos < end) && isSpace(*pos))
+            pos++;
+    }
+
+    // skips one or more spaces
+    bool spaces() {
+        if ((pos == end) || !isSpace(*pos))
+            return false;
+        skipSpaces();
+        return true;
+    }
+
+    bool expect(char c) {
+        if ((pos == end) || (*pos != c))
+            return false;
+        pos++;
+        return true;
+    }
+
+    bool expect(const char *prefix) {
+        size_t len = strlen(prefix);
+
+        if ((static_cast<size_t>(end - pos) < len) || memcmp(pos, prefix, len))
+            return false;
+        pos += len;
+        return true;
+    }
+
+    // an unsigned number of @base. "0x" is allowed in front of a hexadecimal number.
+    template <typename T>
+    bool number(T &val, int base = 10) {
+        const char *p = pos;
+        T v = 0;
+
+        if ((base == 16) && (end - p > 2) && (p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X')))
+            p += 2;
+
+        const char *digits = p;
+
+        for (; p < end; p++) {
+            int d;
+
+            if ((*p >= '0') && (*p <= '9'))
+                d = *p - '0';
+            else if ((base == 16) && (*p >= 'a') && (*p <= 'f'))
+                d = *p - 'a' + 10;
+            else if ((base == 16) && (*p >= 'A') && (*p <= 'F'))
+                d = *p - 'A' + 10;
+            else
+                break;
+            v = v * base + d;
+        }
+
+        if (p == digits)
+            return false;
+
+        val = v;
+        pos = p;
+        return true;
+    }
+
+    // a word of non-space characters that is the same as @w
+    bool token(const char *w) {
+        const char *word_start;
+        size_t len;
+        const char *p = pos;
+
+        if (!word(&word_start, &len))
+            return false;
+        if ((len != strlen(w)) || memcmp(word_start, w, len)) {
+            pos = p;
+            return false;
+        }
+        return true;
+    }
+
+    // skips @count words and the spaces before them
+    bool skipWords(int count) {
+        const char *p = pos;
+        const char *w;
+        size_t len;
+
+        for (int i = 0; i < count; i++) {
+            skipSpaces();
+            if (!word(&w, &len)) {
+                pos = p;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a word of non-space characters
+    bool word(const char **w, size_t *len) {
+        const char *p = pos;
+
+        while ((p < end) && !isSpace(*p))
+            p++;
+        if (p == pos)
+            return false;
+
+        *w = pos;
+        *len = p - pos;
+        pos = p;
+        return true;
+    }
+};
+
+#endif
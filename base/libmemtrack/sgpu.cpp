@@ -7,7 +7,11 @@
 
 #include <hardware/memtrack.h>
 
+#include <mutex>
+#include <string>
+
 #include "memtrack_exynos.h"
+#include "memtrack_text.h"
 
 /* Following includes added for directory parsing. */
 #include <sys/types.h>
@@ -30,15 +34,43 @@ struct memtrack_record sgpu_record_templates[] = {
     },
 };
 
+/*
+ * mem_info starts with a line of each process:
+ * pid: <pid> <size in bytes>
+ */
+static size_t sgpu_mem_size(pid_t pid)
+{
+    static std::mutex lock;
+    static TextFile mem_info("/sys/kernel/gpu/mem_info");
+    static std::string text;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (mem_info.read(text))
+        return 0;
+
+    for (const char *p = text.data(), *eof = p + text.size(); p < eof; ) {
+        TextLine line(p, eof, &p);
+        int cur_pid;
+        size_t mem_size;
+
+        line.skipSpaces();
+        if (!line.token("pid:") || !line.spaces() || !line.number(cur_pid) ||
+                !line.spaces() || !line.number(mem_size))
+            break;
+
+        if (cur_pid == pid)
+            return mem_size;
+    }
+
+    return 0;
+}
+
 int sgpu_memtrack_get_memory(pid_t pid, int __unused type,
                              struct memtrack_record *records,
                              size_t *num_records)
 {
     size_t allocated_records = min(*num_records, ARRAY_SIZE(sgpu_record_templates));
-    FILE *fp;
-    char line[1024] = {0}, mem_type[16] = {0};
-    int r, cur_pid;
-    size_t mem_size = 0;
 
     *num_records = ARRAY_SIZE(sgpu_record_templates);
 
@@ -49,39 +81,10 @@ int sgpu_memtrack_get_memory(pid_t pid, int __unused type,
     memcpy(records, sgpu_record_templates,
            sizeof(struct memtrack_record) * allocated_records);
 
-    fp = fopen("/sys/kernel/gpu/mem_info", "r");
-
-    if (fp == NULL)
-	return 0;
-
-    while(1) {
-	if (fgets(line, sizeof(line), fp) == NULL)
-	    break;
-
-	r = sscanf(line, "%s", mem_type);
-	if (!strcmp(mem_type, "pid:")) {
-	    r = sscanf(line, "%*s %d %zu\n", &cur_pid, &mem_size);
-	    if (!r) {
-		fclose(fp);
-	        return r;
-	    }
-
-	    if(cur_pid != pid)
-		continue;
-	    else
-		break;
-	}
-	mem_size = 0;
-	break;
-    }
-
-    if (fp != NULL)
-	    fclose(fp);
-
     if (allocated_records > 0)
         records[0].size_in_bytes = 0;
     if (allocated_records > 1)
-        records[1].size_in_bytes = mem_size;
+        records[1].size_in_bytes = sgpu_mem_size(pid);
 
     return 0;
 }
@@ -34,6 +34,19 @@ int repeater_stop(void *handle);
 int repeater_pause(void *handle);
 int repeater_resume(void *handle);
 
+/*
+ * Pauses the repeater while the screen is static, e.g. HWC skips the frames
+ * of the virtual display, and resumes it when a new frame is composed. It
+ * only issues the ioctl if the state of the repeater changes.
+ */
+int repeater_set_static(void *handle, bool is_static);
+
+/*
+ * Maps the WFD latency trace ring of HWC that is dumped by repeater_dump().
+ * fd can be closed after the call. -1 unmaps the ring.
+ */
+int repeater_set_latency_ring(void *handle, int fd);
+
 int repeater_get_idle(void *handle, int *idle);
 int repeater_dump(void *handle, char *name);
 
@@ -32,6 +32,7 @@
 #include "exynos_format.h"
 #include "repeater.h"
 #include "repeater_hal.h"
+#include "wfd_latency_trace.h"
 
 #define REPEATER_DEV_NAME       "/dev/repeater"
 
@@ -54,6 +55,11 @@ struct repeater_hal {
     struct repeater_info info;
     int repeater_fd;
     void *buf_addr[MAX_SHARED_BUFFER_NUM];
+    /* allocated size and heap of buf_fd[] that are kept for the next map */
+    int buf_size[MAX_SHARED_BUFFER_NUM];
+    bool buf_secure[MAX_SHARED_BUFFER_NUM];
+    bool paused;
+    struct wfd_latency_ring *latency_ring;
 };
 
 struct dma_ion_heap_map {
@@ -86,14 +92,34 @@ void *repeater_open()
         free(hal);
         return NULL;
     }
-    for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++)
+    for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++) {
         hal->info.buf_fd[i] = -1;
+        hal->buf_addr[i] = NULL;
+        hal->buf_size[i] = 0;
+        hal->buf_secure[i] = false;
+    }
+    hal->paused = false;
+    hal->latency_ring = NULL;
 
     ALOGI("repeater opened");
 
     return hal;
 }
 
+static void repeater_free_buffer(struct repeater_hal *hal, int i)
+{
+    if (hal->info.buf_fd[i] < 0)
+        return;
+
+    if (hal->buf_addr[i])
+        munmap(hal->buf_addr[i], hal->buf_size[i]);
+    close(hal->info.buf_fd[i]);
+
+    hal->info.buf_fd[i] = -1;
+    hal->buf_addr[i] = NULL;
+    hal->buf_size[i] = 0;
+}
+
 void repeater_close(void *handle)
 {
     struct repeater_hal *hal;
@@ -103,6 +129,11 @@ void repeater_close(void *handle)
 
     hal = (struct repeater_hal *)handle;
 
+    for (int i = 0; i < MAX_SHARED_BUFFER_NUM; i++)
+        repeater_free_buffer(hal, i);
+
+    wfd_latency_ring_unmap(hal->latency_ring);
+
     if (hal->repeater_fd > 0) {
         close(hal->repeater_fd);
         hal->repeater_fd = -1;
@@ -130,45 +161,55 @@ int repeater_map(void *handle, struct repeater_map_info *map_info)
 
     hal = (struct repeater_hal *)handle;
 
-    std::unique_ptr<BufferAllocator> bufallocator(new BufferAllocator());
-
-    /* allocated buffer free */
-    for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++) {
-        if (hal->info.buf_fd[i] > 0) {
-            close(hal->info.buf_fd[i]);
-            hal->info.buf_fd[i] = -1;
-        }
-    }
-
     size = NV12N_Y_SIZE(w, h) + NV12N_CBCR_SIZE(w, h);
 
     if (enable_hdcp) {
         heap_map = dma_ion_heap_maps[1];
     }
 
-    ret = bufallocator->MapNameToIonHeap(heap_map.heap_name, heap_map.ion_heap_name,
-            heap_map.ion_heap_flags, heap_map.legacy_ion_heap_mask, heap_map.legacy_ion_heap_flags);
-
-    if (ret < 0) {
-        ALOGE("failed to dmabufheap MapNameToIonHeap");
-        return ret;
-    }
-
-    ALOGI("hwfc buffer attribute: heap_name %s heap_id %d, ion_flags 0x%x",
-        heap_map.heap_name, heap_map.ion_heap_id, heap_map.ion_heap_flags);
     ALOGI("repeater_map(), width %d, height %d, NV12N_Y_SIZE() %d, NV12N_CBCR_SIZE() %d",
         w, h, NV12N_Y_SIZE(w, h), NV12N_CBCR_SIZE(w, h));
 
-    /* buffer alloc */
+    /*
+     * The buffers of the previous map are reused if they are from the same
+     * heap and large enough but not twice larger than required. Only the
+     * others are allocated again.
+     */
+    std::unique_ptr<BufferAllocator> bufallocator;
+
     for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++) {
+        if ((hal->info.buf_fd[i] >= 0) && (hal->buf_size[i] >= size) &&
+                (hal->buf_size[i] / 2 < size) && (hal->buf_secure[i] == enable_hdcp))
+            continue;
+
+        repeater_free_buffer(hal, i);
+
+        if (!bufallocator) {
+            bufallocator.reset(new BufferAllocator());
+
+            ret = bufallocator->MapNameToIonHeap(heap_map.heap_name, heap_map.ion_heap_name,
+                    heap_map.ion_heap_flags, heap_map.legacy_ion_heap_mask, heap_map.legacy_ion_heap_flags);
+
+            if (ret < 0) {
+                ALOGE("failed to dmabufheap MapNameToIonHeap");
+                return ret;
+            }
+
+            ALOGI("hwfc buffer attribute: heap_name %s heap_id %d, ion_flags 0x%x",
+                heap_map.heap_name, heap_map.ion_heap_id, heap_map.ion_heap_flags);
+        }
+
         int fd = bufallocator->Alloc(heap_map.heap_name, size);
         if (fd < 0) {
             ALOGE("fail to dmabufheap alloc");
-            hal->info.buf_fd[i] = -1;
             return -ENOMEM;
         }
         hal->info.buf_fd[i] = fd;
+        hal->buf_size[i] = size;
+        hal->buf_secure[i] = enable_hdcp;
         hal->buf_addr[i] = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, hal->info.buf_fd[i], 0);
+        if (hal->buf_addr[i] == MAP_FAILED)
+            hal->buf_addr[i] = NULL;
     }
 
     hal->info.width = w;
@@ -197,9 +238,6 @@ int repeater_map(void *handle, struct repeater_map_info *map_info)
 void repeater_unmap(void *handle)
 {
     struct repeater_hal *hal;
-    int i;
-    int width, height;
-    int size;
 
     if (!handle)
         return;
@@ -208,18 +246,7 @@ void repeater_unmap(void *handle)
 
     ioctl(hal->repeater_fd, REPEATER_IOCTL_UNMAP_BUF);
 
-    /* buffer free */
-    width = hal->info.width;
-    height = hal->info.height;
-    size = NV12N_Y_SIZE(width, height) + NV12N_CBCR_SIZE(width, height);
-    for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++) {
-        if (hal->info.buf_fd[i] > 0) {
-            if (hal->buf_addr[i])
-                munmap(hal->buf_addr[i], size);
-            close(hal->info.buf_fd[i]);
-            hal->info.buf_fd[i] = -1;
-        }
-    }
+    /* the buffers are kept for the next repeater_map() until repeater_close() */
 
     ALOGI("repeater_unmap");
 }
@@ -240,6 +267,8 @@ int repeater_start(void *handle)
         return ret;
     }
 
+    hal->paused = false;
+
     ALOGI("repeater start success");
 
     return ret;
@@ -282,6 +311,8 @@ int repeater_pause(void *handle)
         return ret;
     }
 
+    hal->paused = true;
+
     ALOGI("repeater pause success");
 
     return ret;
@@ -303,11 +334,73 @@ int repeater_resume(void *handle)
         return ret;
     }
 
+    hal->paused = false;
+
     ALOGI("repeater resume success");
 
     return ret;
 }
 
+int repeater_set_static(void *handle, bool is_static)
+{
+    struct repeater_hal *hal;
+
+    if (!handle)
+        return -ENOENT;
+
+    hal = (struct repeater_hal *)handle;
+
+    if (hal->paused == is_static)
+        return 0;
+
+    ALOGV("repeater_set_static(%d)", is_static);
+
+    return is_static ? repeater_pause(handle) : repeater_resume(handle);
+}
+
+int repeater_set_latency_ring(void *handle, int fd)
+{
+    struct repeater_hal *hal;
+
+    if (!handle)
+        return -ENOENT;
+
+    hal = (struct repeater_hal *)handle;
+
+    wfd_latency_ring_unmap(hal->latency_ring);
+    hal->latency_ring = NULL;
+
+    if (fd < 0)
+        return 0;
+
+    hal->latency_ring = wfd_latency_ring_map(fd);
+    if (!hal->latency_ring) {
+        ALOGE("fail to map WFD latency trace ring (fd %d)", fd);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static void repeater_dump_latency(struct repeater_hal *hal)
+{
+    if (!hal->latency_ring)
+        return;
+
+    char *buf = (char *)malloc(WFD_LATENCY_RING_SIZE * 64);
+    if (!buf)
+        return;
+
+    wfd_latency_ring_dump(hal->latency_ring, buf, WFD_LATENCY_RING_SIZE * 64);
+
+    ALOGI("WFD latency trace");
+    char *saveptr = NULL;
+    for (char *line = strtok_r(buf, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr))
+        ALOGI("%s", line);
+
+    free(buf);
+}
+
 int repeater_get_idle(void *handle, int *idle) {
     int ret;
     struct repeater_hal *hal;
@@ -356,6 +449,8 @@ int repeater_dump(void *handle, char *name)
         }
     }
 
+    repeater_dump_latency(hal);
+
     return ret;
 }
 
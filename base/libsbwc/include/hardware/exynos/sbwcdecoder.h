@@ -25,14 +25,36 @@ public:
     bool setImage(SbwcImgInfo &src, SbwcImgInfo &dst, unsigned int dataspace,
                   unsigned int attr, unsigned int framerate = 0);
     bool decode(int inBuf[], size_t inLen[], int outBuf[], size_t outLen[]);
+    /*
+     * A session keeps the stream configured across the frames until
+     * endSession(). The stream is configured again only when setImage()
+     * changes the configuration. queue() and dequeue() let up to @count
+     * frames in flight during the session and decode() is queue() followed
+     * by dequeue(). All queued frames should be dequeued before the
+     * configuration by setImage() is changed.
+     */
+    static const unsigned int MAX_SESSION_BUFFERS = 4;
+    bool beginSession(unsigned int count = MAX_SESSION_BUFFERS);
+    void endSession();
+    bool queue(int inBuf[], size_t inLen[], int outBuf[], size_t outLen[]);
+    bool dequeue();
+    /*
+     * Wait up to @timeout_ms milliseconds until the oldest queued frame is
+     * decoded. Returns 1 if dequeue() will not block, 0 on timeout and -1
+     * on error. @timeout_ms of 0 polls without blocking.
+     */
+    int waitFrame(int timeout_ms = 0);
+    unsigned int getQueuedCount() { return mQueuedCount; }
 private:
+    bool configure(unsigned int count);
+    void unconfigure();
     bool setCtrl();
     bool setFrameRate();
     bool setFmt();
     bool setCrop();
     bool streamOn();
     bool streamOff();
-    bool queueBuf(int inBuf[], size_t inLen[], int outBuf[], size_t outLen[]);
+    bool queueBuf(unsigned int index, int inBuf[], size_t inLen[], int outBuf[], size_t outLen[]);
     bool dequeueBuf();
     bool reqBufsWithCount(unsigned int count);
 
@@ -45,6 +67,11 @@ private:
     bool mIsProtected = 0;
     uint32_t mFrameRate = 0;
     unsigned int mDataspace = 0;
+    unsigned int mSessionBufCount = 0; // 0 if no session is began
+    unsigned int mStreamBufCount = 0; // 0 if the stream is not configured
+    bool mConfigChanged = true;
+    unsigned int mNextIndex = 0;
+    unsigned int mQueuedCount = 0;
 };
 
 #endif
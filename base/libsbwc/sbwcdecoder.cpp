@@ -4,6 +4,7 @@
 #include <cstdio>
 #include <cerrno>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include <log/log.h>
@@ -83,6 +84,8 @@ SbwcDecoder::SbwcDecoder()
 
 SbwcDecoder::~SbwcDecoder()
 {
+    endSession();
+
     if (fd_dev >= 0)
         close(fd_dev);
 }
@@ -326,7 +329,7 @@ bool SbwcDecoder::streamOff()
 }
 
 //TODO : data_offset is not set, calculate byteused
-bool SbwcDecoder::queueBuf(int inBuf[], size_t inLen[],
+bool SbwcDecoder::queueBuf(unsigned int index, int inBuf[], size_t inLen[],
                            int outBuf[], size_t outLen[])
 {
     ATRACE_CALL();
@@ -336,6 +339,7 @@ bool SbwcDecoder::queueBuf(int inBuf[], size_t inLen[],
 
     memset(&buffer, 0, sizeof(buffer));
 
+    buffer.index = index;
     buffer.memory = V4L2_MEMORY_DMABUF;
 
     memset(planes, 0, sizeof(planes));
@@ -414,9 +418,13 @@ bool SbwcDecoder::dequeueBuf()
     return true;
 }
 
-bool SbwcDecoder::decode(int inBuf[], size_t inLen[],
-                         int outBuf[], size_t outLen[])
+bool SbwcDecoder::configure(unsigned int count)
 {
+    if ((mStreamBufCount == count) && !mConfigChanged)
+        return true;
+
+    unconfigure();
+
     bool ret;
 
     ret = setCtrl();
@@ -427,20 +435,144 @@ bool SbwcDecoder::decode(int inBuf[], size_t inLen[],
     if (ret)
         ret = setFrameRate();
     if (ret)
-        ret = reqBufsWithCount(1);
+        ret = reqBufsWithCount(count);
     if (ret)
         ret = streamOn();
-    if (ret)
-        ret = queueBuf(inBuf, inLen, outBuf, outLen);
-    if (ret)
-        ret = dequeueBuf();
 
+    if (!ret) {
+        streamOff();
+        reqBufsWithCount(0);
+        return false;
+    }
+
+    mStreamBufCount = count;
+    mConfigChanged = false;
+    mNextIndex = 0;
+    mQueuedCount = 0;
+
+    return true;
+}
+
+void SbwcDecoder::unconfigure()
+{
+    if (mStreamBufCount == 0)
+        return;
+
+    // STREAMOFF also returns the frames that are not dequeued
     streamOff();
     reqBufsWithCount(0);
 
+    mStreamBufCount = 0;
+    mQueuedCount = 0;
+}
+
+bool SbwcDecoder::beginSession(unsigned int count)
+{
+    if ((count == 0) || (count > MAX_SESSION_BUFFERS)) {
+        ALOGE("Invalid number of buffers %u for a session", count);
+        return false;
+    }
+
+    if (mQueuedCount > 0) {
+        ALOGE("%u frames are not dequeued before a new session", mQueuedCount);
+        return false;
+    }
+
+    mSessionBufCount = count;
+
+    return true;
+}
+
+void SbwcDecoder::endSession()
+{
+    mSessionBufCount = 0;
+    unconfigure();
+}
+
+bool SbwcDecoder::queue(int inBuf[], size_t inLen[],
+                        int outBuf[], size_t outLen[])
+{
+    unsigned int count = (mSessionBufCount > 0) ? mSessionBufCount : 1;
+
+    if (mQueuedCount > 0) {
+        if (mConfigChanged) {
+            ALOGE("The image is configured again before %u frames are dequeued", mQueuedCount);
+            return false;
+        }
+
+        if (mQueuedCount >= mStreamBufCount) {
+            ALOGE("Too many frames in flight, %u", mQueuedCount);
+            return false;
+        }
+    } else if (!configure(count)) {
+        return false;
+    }
+
+    if (!queueBuf(mNextIndex, inBuf, inLen, outBuf, outLen)) {
+        if (mQueuedCount == 0)
+            unconfigure();
+        return false;
+    }
+
+    mNextIndex = (mNextIndex + 1) % mStreamBufCount;
+    mQueuedCount++;
+
+    return true;
+}
+
+bool SbwcDecoder::dequeue()
+{
+    if (mQueuedCount == 0) {
+        ALOGE("No frame is queued");
+        return false;
+    }
+
+    bool ret = dequeueBuf();
+
+    mQueuedCount--;
+
+    // The stream is torn down after a failure and after a frame without a session
+    if (!ret || (mSessionBufCount == 0))
+        unconfigure();
+
     return ret;
 }
 
+int SbwcDecoder::waitFrame(int timeout_ms)
+{
+    ATRACE_CALL();
+
+    if (mQueuedCount == 0) {
+        ALOGE("No frame is queued");
+        return -1;
+    }
+
+    // The source is returned before the destination when a frame is decoded
+    struct pollfd pfd = { fd_dev, POLLIN, 0 };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while ((ret < 0) && (errno == EINTR));
+
+    if (ret < 0) {
+        ALOGERR("Failed to poll the decoder");
+        return -1;
+    }
+
+    if (!!(pfd.revents & (POLLERR | POLLNVAL))) {
+        ALOGE("Error during running, revents %#x", pfd.revents);
+        return -1;
+    }
+
+    return !!(pfd.revents & POLLIN) ? 1 : 0;
+}
+
+bool SbwcDecoder::decode(int inBuf[], size_t inLen[],
+                         int outBuf[], size_t outLen[])
+{
+    return queue(inBuf, inLen, outBuf, outLen) && dequeue();
+}
+
 static struct {
     uint32_t halFmtSBWC;
     uint32_t halFmtNonSBWC;
@@ -491,6 +623,11 @@ static struct {
     {HAL_PIXEL_FORMAT_RGBA_8888,                V4L2_PIX_FMT_RGB32,      1 },
 };
 
+static inline bool isSameImage(const SbwcImgInfo &a, const SbwcImgInfo &b)
+{
+    return (a.fmt == b.fmt) && (a.width == b.width) && (a.height == b.height) && (a.stride == b.stride);
+}
+
 bool SbwcDecoder::setImage(unsigned int format, unsigned int width,
                            unsigned int height, unsigned int stride)
 {
@@ -527,6 +664,9 @@ bool SbwcDecoder::setImage(SbwcImgInfo &src, SbwcImgInfo &dst,
 {
     ATRACE_CALL();
 
+    SbwcImgInfo oldSrc = mSrc;
+    SbwcImgInfo oldDst = mDst;
+
     mSrc.fmt = 0;
     for (size_t i = 0; i < ARRSIZE(__halfmtSBWC_to_v4l2); i++) {
         if (src.fmt == __halfmtSBWC_to_v4l2[i].fmtHal) {
@@ -550,6 +690,7 @@ bool SbwcDecoder::setImage(SbwcImgInfo &src, SbwcImgInfo &dst,
     }
     if (mSrc.fmt == 0) {
         ALOGE("fail to find the proper v4l2 format for HAL format(SRC) %#x", mSrc.fmt);
+        mConfigChanged = true;
         return false;
     }
 
@@ -564,6 +705,7 @@ bool SbwcDecoder::setImage(SbwcImgInfo &src, SbwcImgInfo &dst,
     }
     if (mDst.fmt == 0) {
         ALOGE("fail to find the proper v4l2 format for HAL format(DST) %#x", mDst.fmt);
+        mConfigChanged = true;
         return false;
     }
 
@@ -575,6 +717,11 @@ bool SbwcDecoder::setImage(SbwcImgInfo &src, SbwcImgInfo &dst,
     mDst.height = dst.height;
     mDst.stride = dst.stride;
 
+    if (!isSameImage(mSrc, oldSrc) || !isSameImage(mDst, oldDst) ||
+            (mDataspace != dataspace) || (mFrameRate != framerate) ||
+            (mIsProtected != !!(attr & SBWCDECODER_ATTR_SECURE_BUFFER)))
+        mConfigChanged = true;
+
     mDataspace = dataspace;
     mFrameRate = framerate;
     mIsProtected = !!(attr & SBWCDECODER_ATTR_SECURE_BUFFER);
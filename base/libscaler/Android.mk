@@ -16,7 +16,8 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_PRELINK_MODULE := false
-LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libacryl
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libacryl libion_exynos
+LOCAL_STATIC_LIBRARIES := libsbwc
 LOCAL_HEADER_LIBRARIES := libcutils_headers libsystem_headers libhardware_headers libexynos_headers
 
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
@@ -226,6 +226,21 @@ void *exynos_sc_create(int dev_num);
  */
 int exynos_sc_destroy(void *handle);
 
+/*!
+ * Create libscaler handle on the default blter
+ *
+ * \ingroup exynos_scaler
+ *
+ * The handle is driven by the same API as the handles by exynos_sc_create()
+ * but its conversions are processed by the H/W of bit block transfer (G2D)
+ * instead of the scaler (MSCL). Used with exynos_sc_convert_batch(), the
+ * conversions on the both devices run concurrently.
+ *
+ * \return
+ * libscaler handle
+ */
+void *exynos_sc_create_blter(void);
+
 /*!
  * Convert color space with presetup color format
  *
@@ -239,6 +254,28 @@ int exynos_sc_destroy(void *handle);
  */
 int exynos_sc_convert(void *handle);
 
+/*!
+ * Convert several images with presetup color formats at once
+ *
+ * \ingroup exynos_scaler
+ *
+ * All conversions are started before waiting for any of them. Conversions of
+ * an image to several destinations, for example a preview and a thumbnail,
+ * are processed concurrently if their handles are on different devices.
+ * Every handle should be configured as exynos_sc_convert() expects.
+ *
+ * \param handles
+ *   libscaler handles[in]
+ *
+ * \param count
+ *   number of handles in handles[in]
+ *
+ * \return
+ *   error code. It returns after all started conversions are completed
+ *   even though an error occurred.
+ */
+int exynos_sc_convert_batch(void *handles[], unsigned int count);
+
 /*!
  * Convert color space with presetup color format
  *
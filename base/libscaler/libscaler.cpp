@@ -33,6 +33,7 @@
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <system/graphics.h>
 
@@ -40,8 +41,13 @@
 #include <log/log.h>
 #include <cerrno>
 #include <cstring>
+#include <memory>
+#include <vector>
 
 #include <hardware/exynos/acryl.h>
+#include <hardware/exynos/format_index.h>
+#include <hardware/exynos/ion.h>
+#include <hardware/exynos/sbwcdecoder.h>
 #include "exynos_scaler.h"
 
 #define ARRSIZE(arr) (sizeof(arr)/sizeof(arr[0]))
@@ -76,7 +82,7 @@ class CScalerAcryl {
     }
 
 public:
-    CScalerAcryl();
+    CScalerAcryl(bool blter = false);
     ~CScalerAcryl();
 
     Acrylic *getHandle() { return mAcrylicHandle; }
@@ -150,6 +156,63 @@ public:
     inline int GetTransform(void) {
         return mTransform;
     }
+
+    inline void SetTransform(int transform) {
+        mTransform = transform;
+    }
+
+    /*
+     * The exclusive APIs configure the formats and the crops only when the
+     * images are different from the last configuration. Buffers are given
+     * for every frame.
+     */
+    inline bool IsConfigured(exynos_sc_img &src, exynos_sc_img &dst) {
+        return mConfigured && IsSameConfig(src, mSrcImg) && IsSameConfig(dst, mDstImg);
+    }
+
+    inline void SetConfigured(exynos_sc_img &src, exynos_sc_img &dst) {
+        mSrcImg = src;
+        mDstImg = dst;
+        mConfigured = true;
+    }
+
+    inline void InvalidateConfig(void) {
+        mConfigured = false;
+    }
+
+    /*
+     * SBWC sources that the scaler cannot read directly are decoded by
+     * SbwcDecoder into an intermediate image of the same size first and the
+     * intermediate image is scaled then.
+     */
+    bool NeedSbwcDecoding(unsigned int v4l2_fmt);
+    bool SetSbwcDecoding(unsigned int v4l2_fmt, unsigned int width, unsigned int height);
+    void ClearSbwcDecoding(void) { mSbwcDecoding = false; }
+    bool DecodeSbwc(void *addr[SC_NUM_OF_PLANES]);
+
+    inline bool IsSbwcDecoding(void) { return mSbwcDecoding; }
+    inline unsigned int GetSbwcDecodedFormat(void) { return mSbwcFormat; }
+    inline int *GetSbwcBuffers(void) { return mSbwcBuf; }
+    inline size_t *GetSbwcBufferLengths(void) { return mSbwcLen; }
+
+private:
+    static inline bool IsSameConfig(exynos_sc_img &a, exynos_sc_img &b) {
+        return (a.x == b.x) && (a.y == b.y) && (a.w == b.w) && (a.h == b.h) &&
+               (a.fw == b.fw) && (a.fh == b.fh) && (a.format == b.format) &&
+               (a.rot == b.rot) && (a.drmMode == b.drmMode) && (a.pre_multi == b.pre_multi);
+    }
+
+    exynos_sc_img mSrcImg;
+    exynos_sc_img mDstImg;
+    bool mConfigured = false;
+
+    void FreeSbwcBuffers(void);
+
+    std::unique_ptr<SbwcDecoder> mSbwcDecoder;
+    bool mSbwcDecoding = false;
+    unsigned int mSbwcFormat = 0;
+    int mSbwcBuf[2] = {-1, -1};
+    size_t mSbwcLen[2] = {0, 0};
 };
 
 #define V4L2_PIX_FMT_ABGR2101010       v4l2_fourcc('A', 'R', '1', '0')
@@ -158,7 +221,7 @@ public:
 #define V4L2_PIX_FMT_YUV420N            v4l2_fourcc('Y', 'N', '1', '2')
 #define V4L2_PIX_FMT_NV12N_10B          v4l2_fourcc('B', 'N', '1', '2')
 
-const int v4l2_to_hal_format_table[][2] = {
+constexpr int v4l2_to_hal_format_table[][2] = {
     { V4L2_PIX_FMT_RGB32,           HAL_PIXEL_FORMAT_RGBA_8888                      },
     { V4L2_PIX_FMT_RGB24,           HAL_PIXEL_FORMAT_RGB_888                        },
     { V4L2_PIX_FMT_RGB565,          HAL_PIXEL_FORMAT_RGB_565                        },
@@ -209,7 +272,10 @@ const int v4l2_to_hal_format_table[][2] = {
     { V4L2_PIX_FMT_NV12N_SBWC_256_10B,  HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_256_SBWC  },
 };
 
-const int hal_to_v4l2_format_table[][2] = {
+constexpr auto v4l2_to_hal_format_table_index =
+        makeFormatIndex(v4l2_to_hal_format_table, [] (const auto &e) { return e[0]; });
+
+constexpr int hal_to_v4l2_format_table[][2] = {
     { HAL_PIXEL_FORMAT_RGBA_8888,                      V4L2_PIX_FMT_RGB32           },
     { HAL_PIXEL_FORMAT_RGBX_8888,                      V4L2_PIX_FMT_RGB32           },
     { HAL_PIXEL_FORMAT_RGB_888,                        V4L2_PIX_FMT_RGB24           },
@@ -264,6 +330,9 @@ const int hal_to_v4l2_format_table[][2] = {
     { HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_256_SBWC,  V4L2_PIX_FMT_NV12N_SBWC_256_10B },
 };
 
+constexpr auto hal_to_v4l2_format_table_index =
+        makeFormatIndex(hal_to_v4l2_format_table, [] (const auto &e) { return e[0]; });
+
 const uint32_t v4l2_to_hal_dataspace_table[][2] = {
     { V4L2_COLORSPACE_SRGB,       HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_FULL        },
     { V4L2_COLORSPACE_REC709,     HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_LIMITED     },
@@ -283,10 +352,9 @@ const uint32_t v4l2_to_hal_dataspace_table[][2] = {
 
 int v4l2_pixfmt_to_hal(int v4l2_pixel_format)
 {
-    for (uint32_t i = 0; i < ARRSIZE(v4l2_to_hal_format_table); i++) {
-        if (v4l2_to_hal_format_table[i][0] == v4l2_pixel_format)
-            return v4l2_to_hal_format_table[i][1];
-    }
+    int i = v4l2_to_hal_format_table_index.find(v4l2_pixel_format);
+    if (i >= 0)
+        return v4l2_to_hal_format_table[i][1];
 
     ALOGE("Unsupported v4l2 pixel format(%#x)", v4l2_pixel_format);
 
@@ -295,10 +363,9 @@ int v4l2_pixfmt_to_hal(int v4l2_pixel_format)
 
 int hal_pixfmt_to_v4l2(int hal_pixel_format)
 {
-    for (uint32_t i = 0; i < ARRSIZE(hal_to_v4l2_format_table); i++) {
-        if (hal_to_v4l2_format_table[i][0] == hal_pixel_format)
-            return hal_to_v4l2_format_table[i][1];
-    }
+    int i = hal_to_v4l2_format_table_index.find(hal_pixel_format);
+    if (i >= 0)
+        return hal_to_v4l2_format_table[i][1];
 
     ALOGE("Unsupported hal pixel format(%#x)", hal_pixel_format);
 
@@ -336,6 +403,18 @@ void *exynos_sc_create(int dev_num)
     return reinterpret_cast<void *>(sc);
 }
 
+void *exynos_sc_create_blter(void)
+{
+    CScalerAcryl *sc = new CScalerAcryl(true);
+    if (!sc->Valid()) {
+        ALOGE("Failed to create a Scaler handle on the default blter");
+        delete sc;
+        return nullptr;
+    }
+
+    return reinterpret_cast<void *>(sc);
+}
+
 int exynos_sc_destroy(void *handle)
 {
     CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
@@ -394,7 +473,19 @@ int exynos_sc_set_src_format(
     if (!layer->setImageDimension(width, height))
         return -1;
 
-    if (!layer->setImageType(v4l2_pixfmt_to_hal(v4l2_colorformat), sc->GetCSCEq()))
+    unsigned int hal_format = v4l2_pixfmt_to_hal(v4l2_colorformat);
+
+    if (sc->NeedSbwcDecoding(v4l2_colorformat)) {
+        if (!sc->SetSbwcDecoding(v4l2_colorformat, width, height)) {
+            sc->ClearSbwcDecoding();
+            return -1;
+        }
+        hal_format = sc->GetSbwcDecodedFormat();
+    } else {
+        sc->ClearSbwcDecoding();
+    }
+
+    if (!layer->setImageType(hal_format, sc->GetCSCEq()))
         return -1;
 
     return 0;
@@ -456,20 +547,39 @@ void exynos_sc_set_framerate(
     sc->SetFrameRate(framerate);
 }
 
-int exynos_sc_set_src_addr(
-        void *handle,
-        void *addr[SC_NUM_OF_PLANES],
-        int mem_type,
-        int __unused acquireFenceFd)
+// The fences not transferred to Acrylic are waited and closed here
+static void wait_fence(int fence)
 {
-    CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
-    if (!sc)
-        return -1;
+    if (fence < 0)
+        return;
+
+    struct pollfd pfd = { fence, POLLIN, 0 };
+    if (poll(&pfd, 1, 1000) <= 0)
+        ALOGE("Failed to wait for the acquire fence %d", fence);
+
+    close(fence);
+}
 
+static int set_src_buffer(CScalerAcryl *sc, void *addr[SC_NUM_OF_PLANES], int mem_type, int fence)
+{
     AcrylicLayer *layer = sc->getLayer();
     int buf_count = sc->GetSrcPlaneCount();
 
-    if (mem_type == V4L2_MEMORY_DMABUF) {
+    if (sc->IsSbwcDecoding()) {
+        wait_fence(fence);
+
+        if (mem_type != V4L2_MEMORY_DMABUF) {
+            ALOGE("SBWC source of memory type %d is not supported", mem_type);
+            return -1;
+        }
+
+        if (!sc->DecodeSbwc(addr))
+            return -1;
+
+        off_t offset[2] = {0, 0};
+        if (!layer->setImageBuffer(sc->GetSbwcBuffers(), sc->GetSbwcBufferLengths(), offset, 2, -1, 0))
+            return -1;
+    } else if (mem_type == V4L2_MEMORY_DMABUF) {
         int fd[SC_NUM_OF_PLANES];
         size_t len[SC_NUM_OF_PLANES];
         off_t offset[SC_NUM_OF_PLANES];
@@ -480,23 +590,29 @@ int exynos_sc_set_src_addr(
             offset[i] = 0;
         }
 
-        if (!layer->setImageBuffer(fd, len, offset, buf_count, -1, 0))
+        if (!layer->setImageBuffer(fd, len, offset, buf_count, fence, 0)) {
+            wait_fence(fence);
             return -1;
+        }
     } else if (mem_type == V4L2_MEMORY_USERPTR) {
         size_t len[SC_NUM_OF_PLANES];
 
         for (int i = 0; i < buf_count; i++)
             len[i] = sc->GetSrcPlaneSize(i);
 
+        wait_fence(fence);
+
         if (!layer->setImageBuffer(addr, len, buf_count, 0))
             return -1;
-    } else
+    } else {
+        wait_fence(fence);
         return -1;
+    }
 
     return 0;
 }
 
-int exynos_sc_set_dst_addr(
+int exynos_sc_set_src_addr(
         void *handle,
         void *addr[SC_NUM_OF_PLANES],
         int mem_type,
@@ -506,6 +622,11 @@ int exynos_sc_set_dst_addr(
     if (!sc)
         return -1;
 
+    return set_src_buffer(sc, addr, mem_type, -1);
+}
+
+static int set_dst_buffer(CScalerAcryl *sc, void *addr[SC_NUM_OF_PLANES], int mem_type, int fence)
+{
     Acrylic *acrylHandle = sc->getHandle();
     int buf_count = sc->GetDstPlaneCount();
     uint32_t attr = sc->GetDRM() ? AcrylicCanvas::ATTR_PROTECTED : AcrylicCanvas::ATTR_NONE;
@@ -522,22 +643,41 @@ int exynos_sc_set_dst_addr(
             offset[i] = 0;
         }
 
-        if (!acrylHandle->setCanvasBuffer(fd, len, offset, buf_count, -1, attr))
+        if (!acrylHandle->setCanvasBuffer(fd, len, offset, buf_count, fence, attr)) {
+            wait_fence(fence);
             return -1;
+        }
     } else if (mem_type == V4L2_MEMORY_USERPTR) {
         size_t len[SC_NUM_OF_PLANES];
 
         for (int i = 0; i < buf_count; i++)
             len[i] = sc->GetDstPlaneSize(i);
 
+        wait_fence(fence);
+
         if (!acrylHandle->setCanvasBuffer(addr, len, buf_count, attr))
             return -1;
-    } else
+    } else {
+        wait_fence(fence);
         return -1;
+    }
 
     return 0;
 }
 
+int exynos_sc_set_dst_addr(
+        void *handle,
+        void *addr[SC_NUM_OF_PLANES],
+        int mem_type,
+        int __unused acquireFenceFd)
+{
+    CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
+    if (!sc)
+        return -1;
+
+    return set_dst_buffer(sc, addr, mem_type, -1);
+}
+
 int exynos_sc_convert(void *handle)
 {
     CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
@@ -556,6 +696,43 @@ int exynos_sc_convert(void *handle)
     return 0;
 }
 
+int exynos_sc_convert_batch(void *handles[], unsigned int count)
+{
+    std::vector<int> jobs(count, -1);
+    unsigned int started = 0;
+    int ret = 0;
+
+    for (; started < count; started++) {
+        CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handles[started]);
+        if (!sc) {
+            ret = -1;
+            break;
+        }
+
+        AcrylicLayer *layer = sc->getLayer();
+
+        layer->setCompositMode(HWC_BLENDING_NONE, 255, 0);
+        layer->setCompositArea(sc->GetSrcCrop(), sc->GetDstCrop(), sc->GetTransform(), 0);
+
+        // Jobs on different devices run concurrently until they are waited below
+        if (!sc->getHandle()->execute(&jobs[started])) {
+            ALOGE("Failed to start %u-th conversion of %u", started, count);
+            ret = -1;
+            break;
+        }
+    }
+
+    for (unsigned int i = 0; i < started; i++) {
+        CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handles[i]);
+        if (!sc->getHandle()->waitExecution(jobs[i])) {
+            ALOGE("Failed to complete %u-th conversion of %u", i, count);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
 /* CScalerAcryl */
 struct PixFormat {
     unsigned int pixfmt;
@@ -563,7 +740,7 @@ struct PixFormat {
     unsigned short bit_pp[3];
 };
 
-const static PixFormat g_pixfmt_table[] = {
+static constexpr PixFormat g_pixfmt_table[] = {
     {V4L2_PIX_FMT_RGB32,        1, {32, 0, 0}, },
     {V4L2_PIX_FMT_BGR32,        1, {32, 0, 0}, },
     {V4L2_PIX_FMT_RGB565,       1, {16, 0, 0}, },
@@ -622,12 +799,15 @@ const static PixFormat g_pixfmt_table[] = {
     {V4L2_PIX_FMT_NV12N_SBWC_256_10B, 1, {27, 10, 256}, },
 };
 
+static constexpr auto g_pixfmt_index =
+        makeFormatIndex(g_pixfmt_table, [] (const auto &e) { return e.pixfmt; });
+
 
-CScalerAcryl::CScalerAcryl() : mDRM(false), mColorSpace(0), mTransform(0), mFilter(0), mFramerate(0)
+CScalerAcryl::CScalerAcryl(bool blter) : mDRM(false), mColorSpace(0), mTransform(0), mFilter(0), mFramerate(0)
 {
-    mAcrylicHandle = Acrylic::createScaler();
+    mAcrylicHandle = blter ? Acrylic::createBlter() : Acrylic::createScaler();
     if (mAcrylicHandle == nullptr) {
-        ALOGE("Failed to create default scaler");
+        ALOGE("Failed to create default %s", blter ? "blter" : "scaler");
     } else {
         mLayer = mAcrylicHandle->createLayer();
         if (mLayer == nullptr) {
@@ -643,6 +823,7 @@ CScalerAcryl::CScalerAcryl() : mDRM(false), mColorSpace(0), mTransform(0), mFilt
 
 CScalerAcryl::~CScalerAcryl()
 {
+    FreeSbwcBuffers();
     delete mLayer;
     delete mAcrylicHandle;
 }
@@ -728,14 +909,8 @@ CScalerAcryl::~CScalerAcryl()
 bool CScalerAcryl::SetFormat(frameInfo &info, unsigned int width, unsigned int height,
                              unsigned int v4l2_fmt, bool isSrc) {
     (void)isSrc; // prevent unused warning instead of using [[maybe_unused]] of C++17
-    const PixFormat *pixfmt = nullptr;
-
-    for (size_t i = 0; i < ARRSIZE(g_pixfmt_table); i++) {
-        if (g_pixfmt_table[i].pixfmt == v4l2_fmt) {
-            pixfmt = &g_pixfmt_table[i];
-            break;
-        }
-    }
+    int index = g_pixfmt_index.find(v4l2_fmt);
+    const PixFormat *pixfmt = (index >= 0) ? &g_pixfmt_table[index] : nullptr;
 
     if (!pixfmt) {
         ALOGE("Format %#x is not supported", v4l2_fmt);
@@ -814,6 +989,91 @@ bool CScalerAcryl::SetFormat(frameInfo &info, unsigned int width, unsigned int h
     return true;
 }
 
+bool CScalerAcryl::NeedSbwcDecoding(unsigned int v4l2_fmt)
+{
+    int index = g_pixfmt_index.find(v4l2_fmt);
+    if (index < 0)
+        return false;
+
+    const PixFormat *pixfmt = &g_pixfmt_table[index];
+    if (!pixIsSbwc(pixfmt) && !pixIsSbwc27(pixfmt))
+        return false;
+
+    return !mAcrylicHandle->getCapabilities().isFormatSupported(v4l2_pixfmt_to_hal(v4l2_fmt));
+}
+
+void CScalerAcryl::FreeSbwcBuffers(void)
+{
+    for (int i = 0; i < 2; i++) {
+        if (mSbwcBuf[i] >= 0)
+            close(mSbwcBuf[i]);
+        mSbwcBuf[i] = -1;
+        mSbwcLen[i] = 0;
+    }
+}
+
+bool CScalerAcryl::SetSbwcDecoding(unsigned int v4l2_fmt, unsigned int width, unsigned int height)
+{
+    const PixFormat *pixfmt = &g_pixfmt_table[g_pixfmt_index.find(v4l2_fmt)];
+    bool is10bit = pixGetBitOfSbwc(pixfmt) == 10;
+    size_t len[2];
+
+    // SbwcDecoder decodes 8-bit SBWC to NV12M and 10-bit SBWC to P010M
+    mSbwcFormat = is10bit ? HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M : HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M;
+    len[0] = static_cast<size_t>(width) * height * (is10bit ? 2 : 1);
+    len[1] = len[0] / 2;
+
+    if (!mSbwcDecoder)
+        mSbwcDecoder = std::make_unique<SbwcDecoder>();
+
+    if (!mSbwcDecoder->setImage(v4l2_pixfmt_to_hal(v4l2_fmt), width, height, width,
+                                mDRM ? SBWCDECODER_ATTR_SECURE_BUFFER : 0, mFramerate))
+        return false;
+
+    if ((mSbwcLen[0] != len[0]) || (mSbwcLen[1] != len[1])) {
+        FreeSbwcBuffers();
+
+        int ion = exynos_ion_open();
+        if (ion < 0) {
+            ALOGE("Failed to open ion for the SBWC intermediate image");
+            return false;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            mSbwcBuf[i] = exynos_ion_alloc(ion, len[i], EXYNOS_ION_HEAP_SYSTEM_MASK, 0);
+            if (mSbwcBuf[i] < 0) {
+                ALOGE("Failed to allocate %zu bytes for the SBWC intermediate image", len[i]);
+                break;
+            }
+            mSbwcLen[i] = len[i];
+        }
+
+        exynos_ion_close(ion);
+
+        if ((mSbwcBuf[0] < 0) || (mSbwcBuf[1] < 0)) {
+            FreeSbwcBuffers();
+            return false;
+        }
+    }
+
+    mSbwcDecoding = true;
+
+    return true;
+}
+
+bool CScalerAcryl::DecodeSbwc(void *addr[SC_NUM_OF_PLANES])
+{
+    int fd[SC_NUM_OF_PLANES];
+    size_t len[SC_NUM_OF_PLANES];
+
+    for (int i = 0; i < mSrcInfo.num_buffers; i++) {
+        fd[i] = static_cast<int>(reinterpret_cast<intptr_t>(addr[i]));
+        len[i] = mSrcInfo.len[i];
+    }
+
+    return mSbwcDecoder->decode(fd, len, mSbwcBuf, mSbwcLen);
+}
+
 bool CScalerAcryl::SetRotate(int rot, int hflip, int vflip)
 {
     if ((rot % 90) != 0) {
@@ -843,36 +1103,135 @@ bool CScalerAcryl::SetRotate(int rot, int hflip, int vflip)
 
     return true;
 }
-/* Dummies to avoid build error */
 void *exynos_sc_create_exclusive(
-    int __unused dev_num,
+    int dev_num,
     int __unused allow_drm)
 {
-    return nullptr;
+    return exynos_sc_create(dev_num);
 }
 
-int exynos_sc_csc_exclusive(void __unused *handle,
-    unsigned int __unused range_full,
-    unsigned int __unused v4l2_colorspace)
+int exynos_sc_csc_exclusive(void *handle,
+    unsigned int range_full,
+    unsigned int v4l2_colorspace)
 {
+    CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
+    if (!sc)
+        return -1;
+
+    unsigned int hal_colorspace;
+    if (v4l2_dataspace_to_hal(v4l2_colorspace, &hal_colorspace) < 0)
+        return -1;
+
+    hal_colorspace &= ~HAL_DATASPACE_RANGE_MASK;
+    hal_colorspace |= range_full ? HAL_DATASPACE_RANGE_FULL : HAL_DATASPACE_RANGE_LIMITED;
+
+    if (sc->GetCSCEq() != static_cast<int>(hal_colorspace)) {
+        sc->SetCSCEq(hal_colorspace);
+        // the image types are configured again with the new dataspace
+        sc->InvalidateConfig();
+    }
+
     return 0;
 }
 
 int exynos_sc_config_exclusive(
-    void __unused *handle,
-    exynos_sc_img __unused *src_img,
-    exynos_sc_img __unused *dst_img)
+    void *handle,
+    exynos_sc_img *src_img,
+    exynos_sc_img *dst_img)
 {
+    CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
+    if (!sc || !src_img || !dst_img)
+        return -1;
+
+    if (sc->IsConfigured(*src_img, *dst_img))
+        return 0;
+
+    sc->InvalidateConfig();
+
+    if (exynos_sc_set_src_format(handle, src_img->fw, src_img->fh,
+                                 src_img->x, src_img->y, src_img->w, src_img->h,
+                                 src_img->format, src_img->cacheable,
+                                 src_img->drmMode, src_img->pre_multi) < 0)
+        return -1;
+
+    if (exynos_sc_set_dst_format(handle, dst_img->fw, dst_img->fh,
+                                 dst_img->x, dst_img->y, dst_img->w, dst_img->h,
+                                 dst_img->format, dst_img->cacheable,
+                                 dst_img->drmMode, dst_img->pre_multi) < 0)
+        return -1;
+
+    // rot of the destination is HAL_TRANSFORM_XXX like libgscaler
+    sc->SetTransform(dst_img->rot);
+
+    AcrylicLayer *layer = sc->getLayer();
+
+    if (!layer->setCompositMode(HWC_BLENDING_NONE, 255, 0) ||
+        !layer->setCompositArea(sc->GetSrcCrop(), sc->GetDstCrop(), sc->GetTransform(), 0))
+        return -1;
+
+    sc->SetConfigured(*src_img, *dst_img);
+
     return 0;
 }
 
-
+/*
+ * The job is submitted without waiting for its completion. The acquire fences
+ * are transferred to libscaler and the release fences of the job are returned
+ * to src_img->releaseFenceFd and dst_img->releaseFenceFd.
+ */
 int exynos_sc_run_exclusive(
-    void __unused *handle,
-    exynos_sc_img __unused *src_img,
-    exynos_sc_img __unused *dst_img)
+    void *handle,
+    exynos_sc_img *src_img,
+    exynos_sc_img *dst_img)
 {
+    CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
+    if (!sc || !src_img || !dst_img)
+        return -1;
+
+    src_img->releaseFenceFd = -1;
+    dst_img->releaseFenceFd = -1;
+
+    if (exynos_sc_config_exclusive(handle, src_img, dst_img) < 0)
+        goto err;
+
+    {
+        void *src_addr[SC_NUM_OF_PLANES] = {reinterpret_cast<void *>(src_img->yaddr),
+                                            reinterpret_cast<void *>(src_img->uaddr),
+                                            reinterpret_cast<void *>(src_img->vaddr)};
+        void *dst_addr[SC_NUM_OF_PLANES] = {reinterpret_cast<void *>(dst_img->yaddr),
+                                            reinterpret_cast<void *>(dst_img->uaddr),
+                                            reinterpret_cast<void *>(dst_img->vaddr)};
+
+        // set_src_buffer() and set_dst_buffer() always consume the acquire fences
+        int src_fence = src_img->acquireFenceFd;
+        int dst_fence = dst_img->acquireFenceFd;
+        src_img->acquireFenceFd = -1;
+        dst_img->acquireFenceFd = -1;
+
+        if (set_src_buffer(sc, src_addr, src_img->mem_type, src_fence) < 0) {
+            wait_fence(dst_fence);
+            return -1;
+        }
+
+        if (set_dst_buffer(sc, dst_addr, dst_img->mem_type, dst_fence) < 0)
+            return -1;
+
+        int release_fence[2];
+        if (!sc->getHandle()->execute(release_fence, 2))
+            return -1;
+
+        src_img->releaseFenceFd = release_fence[0];
+        dst_img->releaseFenceFd = release_fence[1];
+    }
+
     return 0;
+err:
+    wait_fence(src_img->acquireFenceFd);
+    wait_fence(dst_img->acquireFenceFd);
+    src_img->acquireFenceFd = -1;
+    dst_img->acquireFenceFd = -1;
+
+    return -1;
 }
 
 void *exynos_sc_create_blend_exclusive(
@@ -891,6 +1250,21 @@ int exynos_sc_config_blend_exclusive(
     return 0;
 }
 
-int exynos_sc_wait_frame_done_exclusive(void __unused *handle) {return 0; }
-int exynos_sc_stop_exclusive(void __unused *handle) { return 0; }
-int exynos_sc_free_and_close(void __unused *handle) { return 0; }
+int exynos_sc_wait_frame_done_exclusive(void *handle)
+{
+    CScalerAcryl *sc = reinterpret_cast<CScalerAcryl *>(handle);
+    if (!sc)
+        return -1;
+
+    return sc->getHandle()->waitExecution(0) ? 0 : -1;
+}
+
+int exynos_sc_stop_exclusive(void *handle)
+{
+    return exynos_sc_wait_frame_done_exclusive(handle);
+}
+
+int exynos_sc_free_and_close(void *handle)
+{
+    return exynos_sc_destroy(handle);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TSMUX_CRC32_H
+#define TSMUX_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/*
+ * CRC32 of MPEG-2 sections (ISO/IEC 13818-1 Annex A)
+ *
+ * The polynomial is 0x04C11DB7, processed MSB first without reflection and
+ * final XOR. The tables for slice-by-8 are built at compile time and shared
+ * by all users. tsmux_crc32() returns the CRC in the host byte order and it
+ * should be written to a section in big endian.
+ */
+struct tsmux_crc32_tables {
+    uint32_t t[8][256];
+
+    constexpr tsmux_crc32_tables() : t() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i << 24;
+            for (int j = 0; j < 8; j++)
+                crc = (crc << 1) ^ ((crc & 0x80000000) ? 0x04C11DB7 : 0);
+            t[0][i] = crc;
+        }
+
+        for (int k = 1; k < 8; k++) {
+            for (int i = 0; i < 256; i++)
+                t[k][i] = (t[k - 1][i] << 8) ^ t[0][t[k - 1][i] >> 24];
+        }
+    }
+};
+
+static constexpr tsmux_crc32_tables tsmux_crc32_lut;
+
+static inline uint32_t tsmux_crc32_update(uint32_t crc, const uint8_t *p, size_t size)
+{
+    const uint32_t (&t)[8][256] = tsmux_crc32_lut.t;
+
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t hi = crc ^ ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+                             (uint32_t)p[2] << 8 | p[3]);
+
+        crc = t[7][hi >> 24] ^ t[6][(hi >> 16) & 0xFF] ^
+              t[5][(hi >> 8) & 0xFF] ^ t[4][hi & 0xFF] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+
+    for (; size > 0; size--, p++)
+        crc = (crc << 8) ^ t[0][((crc >> 24) ^ *p) & 0xFF];
+
+    return crc;
+}
+
+static inline uint32_t tsmux_crc32(const uint8_t *start, size_t size)
+{
+    return tsmux_crc32_update(0xFFFFFFFF, start, size);
+}
+
+}
+
+#endif
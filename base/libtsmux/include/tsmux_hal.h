@@ -20,6 +20,8 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/ADebug.h>
 
+#include <sys/uio.h>
+
 #include "tsmux.h"
 
 #define TS_PKT_COUNT_PER_RTP    7
@@ -41,6 +43,38 @@ struct tsmux_config_data {
     struct tsmux_rtp_hdr *rtp_hdr;
 };
 
+/*
+ * Depacketizers of the stream from tsmux for loopback and local recording.
+ * They do not support streams with HDCP enabled.
+ *
+ * depacketize_iov() stores the spans of ES in packetized_data to iov without
+ * copy and returns the number of the spans. Only the first iov_count spans
+ * are stored if more spans are required.
+ */
+void depacketize_rtp(char *ts_data, int *ts_size, char *rtp_data, int rtp_size);
+void depacketize(char* depacketized_data, char* packetized_data, int es_size, bool psi);
+int depacketize_iov(struct iovec *iov, int iov_count, char *packetized_data, int es_size, bool psi);
+
+/*
+ * Statistics of a tsmux session. The latencies are accumulated in us and
+ * divided by the number of frames or runs for the average.
+ */
+struct tsmux_stats {
+    int64_t video_frames;
+    int64_t audio_frames;
+    int64_t bytes_out;              /* RTP packets produced by tsmux */
+    int64_t psi_count;
+    int64_t psi_bytes;              /* TS packets of PAT, PMT and PCR */
+    int64_t psi_interval_us;        /* current PSI interval */
+    int64_t otf_packetize_us;       /* tsmux processing time of OTF frames */
+    int64_t otf_packetize_max_us;
+    int64_t otf_dq_wait_us;         /* time to wait for OTF frames */
+    int64_t otf_dq_wait_max_us;
+    int64_t m2m_runs;
+    int64_t m2m_packetize_us;       /* time of TSMUX_IOCTL_M2M_RUN */
+    int64_t m2m_packetize_max_us;
+};
+
 void *tsmux_open(bool enable_hdcp, bool use_hevc, bool use_lpcm, bool otf_dummy_ts_packet);
 void tsmux_close(void *handle);
 
@@ -53,10 +87,59 @@ int tsmux_init_m2m(void *handle);
 void tsmux_deinit_m2m(void *handle);
 int tsmux_packetize_m2m(void *handle, sp<ABuffer> *inbufs,
         sp<ABuffer> *outbufs);
+/*
+ * tsmux_queue_m2m() queues an audio access unit. The queued access units are
+ * packetized in one m2m job when max_count access units are queued or when
+ * the access units span max_delay_us or longer by their timeUs. It returns 1
+ * if the access units are packetized into outbufs in the order they are
+ * queued, 0 if the access unit is queued and negative on failure. outbufs
+ * should have TSMUX_MAX_M2M_CMD_QUEUE_NUM entries. tsmux_flush_m2m() packetizes
+ * the queued access units at once, e.g. at the end of the stream. Each access
+ * unit is packetized by tsmux_queue_m2m() unless tsmux_set_m2m_coalescing()
+ * is called.
+ */
+int tsmux_set_m2m_coalescing(void *handle, int max_count, int64_t max_delay_us);
+int tsmux_queue_m2m(void *handle, const sp<ABuffer> &inbuf, sp<ABuffer> *outbufs);
+int tsmux_flush_m2m(void *handle, sp<ABuffer> *outbufs);
 int tsmux_init_otf(void *handle, uint32_t width, uint32_t height);
 void tsmux_deinit_otf(void *handle);
 int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf);
 void tsmux_q_buf_otf(void *handle);
+/*
+ * The OTF buffer dequeued by tsmux_dq_buf_otf_nocopy() is wrapped in outbuf
+ * without copy. It should be returned by tsmux_q_buf_otf_index() with
+ * buf_index after outbuf is no longer accessed, e.g. RTP packets in it are
+ * transmitted, and before tsmux_deinit_otf().
+ */
+int tsmux_dq_buf_otf_nocopy(void *handle, sp<ABuffer> &outbuf, int *buf_index);
+void tsmux_q_buf_otf_index(void *handle, int buf_index);
+/*
+ * The OTF worker dequeues each OTF buffer as soon as tsmux completes it and
+ * passes it to sink on the worker thread as tsmux_dq_buf_otf_nocopy() does.
+ * The sink should return the buffer by tsmux_q_buf_otf_index() with
+ * buf_index and may keep up to TSMUX_OUT_BUF_CNT - 1 buffers in flight.
+ * tsmux_dq_buf_otf() and tsmux_dq_buf_otf_nocopy() should not be called
+ * while the worker is running. tsmux_stop_otf_worker() returns after the
+ * dequeue waiting in the worker is completed.
+ */
+typedef void (*tsmux_otf_sink_t)(void *cookie, sp<ABuffer> &outbuf, int buf_index);
+int tsmux_start_otf_worker(void *handle, tsmux_otf_sink_t sink, void *cookie);
+void tsmux_stop_otf_worker(void *handle);
+/*
+ * PSI is sent every 50ms by default. With a range of the interval, the
+ * interval starts at min_interval_us, returns to it when the sink reports
+ * packet loss and grows by 25% up to max_interval_us on each report without
+ * loss.
+ */
+int tsmux_set_psi_interval(void *handle, int64_t min_interval_us, int64_t max_interval_us);
+void tsmux_report_packet_loss(void *handle, int lost_packets);
+int tsmux_get_stats(void *handle, struct tsmux_stats *stats);
+/*
+ * Maps the WFD latency trace ring of HWC. The stages of each OTF frame are
+ * recorded to the ring when it is dequeued. fd can be closed after the call
+ * and -1 unmaps the ring.
+ */
+int tsmux_set_latency_ring(void *handle, int fd);
 int tsmux_get_config_otf(void *handle, struct tsmux_config_data *config);
 }
 
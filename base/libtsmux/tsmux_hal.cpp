@@ -25,14 +25,18 @@
 #include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <BufferAllocator/BufferAllocator.h>
 
 #include "exynos_format.h"
 
 #include "tsmux_hal.h"
+#include "tsmux_crc32.h"
+#include "wfd_latency_trace.h"
 
 namespace android {
 
@@ -58,6 +62,9 @@ namespace android {
 #define VIDEO_CONSTRAINT_SET    192
 #define M2M_BUF_SIZE            32768
 
+#define PSI_INTERVAL_US         50000
+#define PSI_PACKET_COUNT        3       /* PAT, PMT and PCR */
+
 struct tsmux_hal {
     struct tsmux_m2m_cmd_queue m2m_cmd_queue;
     struct tsmux_otf_cmd_queue otf_cmd_queue;
@@ -73,71 +80,79 @@ struct tsmux_hal {
     int64_t audio_frame_count;
     int64_t video_frame_count;
 
+    /* PSI interval shrinks to min on packet loss and grows up to max */
+    int64_t psi_interval_us;
+    int64_t psi_min_interval_us;
+    int64_t psi_max_interval_us;
+
+    pthread_mutex_t stats_lock;
+    struct tsmux_stats stats;
+
+    struct wfd_latency_ring *latency_ring;
+
     struct tsmux_rtp_ts_info rtp_ts_info;
 
-    uint32_t crc_table[256];
     bool use_hevc;
     bool use_lpcm;
+    int psi_config;  /* configuration of PAT and PMT in psi_info. -1 if not built */
+
+    /* audio access units staged in m2m_cmd_queue and not packetized yet */
+    int m2m_staged_count;
+    int64_t m2m_staged_time_us[TSMUX_MAX_M2M_CMD_QUEUE_NUM];
+    int m2m_coalesce_count;
+    int64_t m2m_coalesce_us;
+
+    /* the last configuration of OTF set to tsmux device driver */
+    struct tsmux_otf_config applied_otf_config;
+    bool otf_config_applied;
+
+    pthread_t otf_worker;
+    bool otf_worker_running;
+    volatile bool otf_worker_stop;
+    tsmux_otf_sink_t otf_sink;
+    void *otf_sink_cookie;
 };
 
 void depacketize_rtp(char *ts_data, int *ts_size, char *rtp_data, int rtp_size)
 {
-    char *rtp_ptr, *ts_ptr;
-    rtp_ptr = rtp_data;
+    char *rtp_ptr = rtp_data;
     *ts_size = 0;
-    int ts_packet_size = 188;
-    while (rtp_size > 0) {
-
-        rtp_ptr += 1; /* skip ver(2b), padding(1b), extenstion(2b), CSCR Count(4b) */
-        rtp_ptr += 1; /* skip Marker(1b), payload type(7b) */
-        rtp_ptr += 2; /* skip sequence number(16b) */
-        rtp_ptr += 4; /* skip timestamp(32b) */
-        rtp_ptr += 4; /* skip SSRC(32b) */
-        rtp_size -= 12;
-
-        ts_ptr = rtp_ptr;
-        int remain_ts_packet = TS_PKT_COUNT_PER_RTP;
-        while (remain_ts_packet > 0) {
-            memcpy(ts_data, ts_ptr, ts_packet_size);
-            ts_data += ts_packet_size;
-            ts_ptr += ts_packet_size;
-            rtp_size -= ts_packet_size;
-            *ts_size += ts_packet_size;
-            remain_ts_packet -= 1;
-            if (rtp_size == 0)
-                break;
-        }
-        rtp_ptr = ts_ptr;
+
+    /* TS packets in an RTP packet are contiguous and copied at once */
+    while (rtp_size > RTP_HEADER_SIZE) {
+        rtp_ptr += RTP_HEADER_SIZE;
+        rtp_size -= RTP_HEADER_SIZE;
+
+        int copy_size = TS_PKT_COUNT_PER_RTP * TS_PACKET_SIZE;
+        if (copy_size > rtp_size)
+            copy_size = rtp_size;
+
+        memcpy(ts_data, rtp_ptr, copy_size);
+        ts_data += copy_size;
+        rtp_ptr += copy_size;
+        rtp_size -= copy_size;
+        *ts_size += copy_size;
     }
 }
 
-void depacketize(char* depacketized_data, char* packetized_data, int es_size, bool psi)
+int depacketize_iov(struct iovec *iov, int iov_count, char *packetized_data, int es_size, bool psi)
 {
-    char *rtp_ptr, *ts_ptr, *pes_ptr, *es_ptr;
-    char *out_data_ptr = depacketized_data;
+    char *rtp_ptr, *ts_ptr, *es_ptr;
     char adaptation_field_control;
-    int adaptation_field_length;
+    int adaptation_field_length = 0;
     int is_pes_header = 1;
     int remain_es_size = es_size;
     int psi_packet = 3;
+    int count = 0;
 
     rtp_ptr = packetized_data;
     while (remain_es_size > 0) {
+        ts_ptr = rtp_ptr + RTP_HEADER_SIZE;
 
-        rtp_ptr += 1; /* skip ver(2b), padding(1b), extenstion(2b), CSCR Count(4b) */
-        rtp_ptr += 1; /* skip Marker(1b), payload type(7b) */
-        rtp_ptr += 2; /* skip sequence number(16b) */
-        rtp_ptr += 4; /* skip timestamp(32b) */
-        rtp_ptr += 4; /* skip SSRC(32b) */
-
-        ts_ptr = rtp_ptr;
-        int remain_ts_packet = 7;
-        while (remain_ts_packet > 0) {
-            ts_ptr += 1; /* skip sync byte(8b) */
-            ts_ptr += 2; /* skip err(1b), start(1b), priority(1b), PID(13b) */
-            adaptation_field_control = ((*ts_ptr) >> 4) & 0x3;
-            ALOGV("depacketize(), adaptation_field_control 0x%x", adaptation_field_control);
-            ts_ptr += 1; /* skip scarmbling(1b), adaptation(2b), continuity counter(2b) */
+        for (int i = 0; (i < TS_PKT_COUNT_PER_RTP) && (remain_es_size > 0); i++) {
+            /* skip sync byte(8b), err(1b), start(1b), priority(1b), PID(13b) */
+            adaptation_field_control = (ts_ptr[3] >> 4) & 0x3;
+            ts_ptr += TS_HEADER_SIZE;
             if (adaptation_field_control == 0x3) {
                 adaptation_field_length = *ts_ptr;
                 ts_ptr += 1;
@@ -148,44 +163,65 @@ void depacketize(char* depacketized_data, char* packetized_data, int es_size, bo
             if (psi && psi_packet > 0) {
                 ts_ptr += 184;
                 psi_packet--;
-            } else {
-                pes_ptr = ts_ptr;
-                if (is_pes_header) {
-                    pes_ptr += 3; /* skip start code */
-                    pes_ptr += 1; /* skip stream id */
-                    pes_ptr += 2; /* skip PES packet length */
-                    pes_ptr += 1; /* skip scramble, priority, coptyright, copy */
-                    pes_ptr += 1; /* skip PTS DTS flag, PES extention flag */
-                    pes_ptr += 1; /* skip PES header data length */
-                    pes_ptr += 5; /* skip PTS */
-                    is_pes_header = 0;
-                    ts_payload -= 14;
-                }
-
-                es_ptr = pes_ptr;
-                if (adaptation_field_control == 0x3) {
-                    es_ptr += adaptation_field_length;
-                    ALOGV("depacketize(), adaptation_field_length %d, %.2x %.2x %.2x %.2x",
-                        adaptation_field_length, *(es_ptr), *(es_ptr + 1), *(es_ptr + 2), *(es_ptr + 3));
-                }
-                int copy_size;
-                if (remain_es_size >= ts_payload) {
-                    copy_size = ts_payload;
-                } else {
-                    copy_size = remain_es_size;
-                }
-                memcpy(out_data_ptr, es_ptr, copy_size);
-                out_data_ptr += copy_size;
-                remain_es_size -= copy_size;
-                ts_ptr = es_ptr + copy_size;
+                continue;
             }
 
-            remain_ts_packet -= 1;
-            if (remain_es_size == 0)
-                break;
+            es_ptr = ts_ptr;
+            if (is_pes_header) {
+                /*
+                 * skip start code, stream id, PES packet length, flags,
+                 * PES header data length and PTS
+                 */
+                es_ptr += 14;
+                is_pes_header = 0;
+                ts_payload -= 14;
+            }
+
+            if (adaptation_field_control == 0x3)
+                es_ptr += adaptation_field_length;
+
+            int copy_size = (remain_es_size >= ts_payload) ? ts_payload : remain_es_size;
+            if (count < iov_count) {
+                iov[count].iov_base = es_ptr;
+                iov[count].iov_len = copy_size;
+            }
+            count++;
+            remain_es_size -= copy_size;
+            ts_ptr = es_ptr + copy_size;
         }
         rtp_ptr = ts_ptr;
     }
+
+    return count;
+}
+
+#define DEPACKETIZE_IOV_COUNT   256
+
+void depacketize(char* depacketized_data, char* packetized_data, int es_size, bool psi)
+{
+    struct iovec local_iov[DEPACKETIZE_IOV_COUNT];
+    struct iovec *iov = local_iov;
+    char *out_data_ptr = depacketized_data;
+
+    int count = depacketize_iov(iov, DEPACKETIZE_IOV_COUNT, packetized_data, es_size, psi);
+    if (count > DEPACKETIZE_IOV_COUNT) {
+        iov = (struct iovec *)malloc(sizeof(struct iovec) * count);
+        if (iov == NULL) {
+            ALOGE("%s: fail to allocate %d iovec", __FUNCTION__, count);
+            return;
+        }
+        depacketize_iov(iov, count, packetized_data, es_size, psi);
+    }
+
+    ALOGV("depacketize(), es_size %d in %d spans", es_size, count);
+
+    for (int i = 0; i < count; i++) {
+        memcpy(out_data_ptr, iov[i].iov_base, iov[i].iov_len);
+        out_data_ptr += iov[i].iov_len;
+    }
+
+    if (iov != local_iov)
+        free(iov);
 }
 
 int increament_ts_continuity_counter(int ts_continuity_counter, int rtp_size, int psi_enable)
@@ -305,67 +341,20 @@ void addADTSHeader(uint8_t *dst, uint8_t *src, int es_size,
         *(temp_ptr + 8), *(temp_ptr + 9), *(temp_ptr + 10), *(temp_ptr + 11));
 }
 
-void tsmux_init_crc_table(void *handle) {
-    struct tsmux_hal *hal;
-
-    if (!handle) {
-        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
-        return;
-    }
-
-    hal = (struct tsmux_hal *)handle;
-
-    uint32_t poly = 0x04C11DB7;
-
-    for (int i = 0; i < 256; i++) {
-        uint32_t crc = i << 24;
-        for (int j = 0; j < 8; j++) {
-            crc = (crc << 1) ^ ((crc & 0x80000000) ? (poly) : 0);
-        }
-        hal->crc_table[i] = crc;
-    }
-
-    for (int i = 0; i < 256; i += 8) {
-        ALOGV("hal->crc_table 0x%x 0x%x 0x%x 0x%x 0x%x 0x%x 0x%x 0x%x",
-            hal->crc_table[i], hal->crc_table[i + 1], hal->crc_table[i + 2], hal->crc_table[i + 3],
-            hal->crc_table[i + 4], hal->crc_table[i + 5], hal->crc_table[i + 6], hal->crc_table[i + 7]);
-    }
-
-}
-
-static uint32_t tsmux_crc32(void *handle, const uint8_t *start, size_t size) {
-    struct tsmux_hal *hal;
-
-    if (!handle) {
-        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
-        return 0;
-    }
-
-    hal = (struct tsmux_hal *)handle;
-
-    uint32_t crc = 0xFFFFFFFF;
-    const uint8_t *p;
-
-    for (p = start; p < start + size; ++p) {
-        crc = (crc << 8) ^ hal->crc_table[((crc >> 24) ^ *p) & 0xFF];
-    }
-
-    return crc;
+static int tsmux_psi_config(struct tsmux_hal *hal)
+{
+    return (hal->otf_cmd_queue.config.hex_ctrl.otf_enable ? 1 : 0) |
+           (hal->use_hevc ? 2 : 0) | (hal->use_lpcm ? 4 : 0);
 }
 
-void tsmux_send_psi(void *handle, int64_t timeUs)
+/*
+ * PAT and PMT depend only on the stream configuration and their continuity
+ * counters are set by tsmux device driver. They are built once for the
+ * configuration and only PCR is written for each PSI.
+ */
+static void tsmux_build_psi(struct tsmux_hal *hal)
 {
-    int ret;
-    struct tsmux_hal *hal;
-
-    if (!handle) {
-        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
-        return;
-    }
-
-    hal = (struct tsmux_hal *)handle;
-
-    ALOGV("send_psi");
+    ALOGV("build_psi");
     uint8_t *packetDataStart = (uint8_t *)hal->psi_info.psi_data;
 
     /* PAT */
@@ -391,7 +380,7 @@ void tsmux_send_psi(void *handle, int64_t timeUs)
     *ptr++ = 0xe0 | (TS_PID_PMT >> 8);
     *ptr++ = TS_PID_PMT & 0xff;
 
-    uint32_t crc = htonl(tsmux_crc32(hal, crcDataStart, ptr - crcDataStart));
+    uint32_t crc = htonl(tsmux_crc32(crcDataStart, ptr - crcDataStart));
     ALOGV("pat crc 0x%x", crc);
     memcpy(ptr, &crc, 4);
     ptr += 4;
@@ -530,7 +519,7 @@ void tsmux_send_psi(void *handle, int64_t timeUs)
     size_t section_length = ptr - (crcDataStart + 3) + 4 /* CRC */;
     crcDataStart[1] = 0xb0 | (section_length >> 8);
     crcDataStart[2] = section_length & 0xff;
-    crc = htonl(tsmux_crc32(hal, crcDataStart, ptr - crcDataStart));
+    crc = htonl(tsmux_crc32(crcDataStart, ptr - crcDataStart));
     ALOGV("pmt crc 0x%x", crc);
     memcpy(ptr, &crc, 4);
     ptr += 4;
@@ -539,9 +528,31 @@ void tsmux_send_psi(void *handle, int64_t timeUs)
 
     hal->psi_info.pmt_len = ptr - packetDataStart;
 
+    hal->psi_config = tsmux_psi_config(hal);
+}
+
+void tsmux_send_psi(void *handle, int64_t timeUs)
+{
+    int ret;
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    ALOGV("send_psi");
+
+    if (hal->psi_config != tsmux_psi_config(hal))
+        tsmux_build_psi(hal);
+
     /* PCR */
     /* PCR of OTF will be set by tsmux device driver */
-    packetDataStart = ptr;
+    uint8_t *packetDataStart = (uint8_t *)hal->psi_info.psi_data +
+        hal->psi_info.pat_len + hal->psi_info.pmt_len;
+    uint8_t *ptr = packetDataStart;
     uint64_t PCR = timeUs * 27;  // PCR based on a 27MHz clock
     uint64_t PCR_base = PCR / 300;
     uint32_t PCR_ext = PCR % 300;
@@ -614,8 +625,20 @@ void *tsmux_open(bool enable_hdcp, bool use_hevc, bool use_lpcm, bool otf_dummy_
     ALOGI("tsmux heap_name %s", "system-uncached");
 
     hal->last_psi_time_us = 0;
-
-    tsmux_init_crc_table(hal);
+    hal->audio_frame_count = 0;
+    hal->video_frame_count = 0;
+    hal->psi_interval_us = PSI_INTERVAL_US;
+    hal->psi_min_interval_us = PSI_INTERVAL_US;
+    hal->psi_max_interval_us = PSI_INTERVAL_US;
+    pthread_mutex_init(&hal->stats_lock, NULL);
+    hal->latency_ring = NULL;
+    memset(&hal->stats, 0, sizeof(hal->stats));
+    hal->psi_config = -1;
+    hal->otf_config_applied = false;
+    hal->otf_worker_running = false;
+    hal->m2m_staged_count = 0;
+    hal->m2m_coalesce_count = 1;
+    hal->m2m_coalesce_us = 0;
 
     if (otf_dummy_ts_packet) {
         hal->otf_cmd_queue.config.pkt_ctrl.rtp_size = TS_PKT_COUNT_PER_RTP - 1;
@@ -650,6 +673,8 @@ void tsmux_close(void *handle)
 
     hal = (struct tsmux_hal *)handle;
 
+    tsmux_stop_otf_worker(hal);
+
     if (hal->tsmux_fd > 0) {
         close(hal->tsmux_fd);
         hal->tsmux_fd = -1;
@@ -659,6 +684,9 @@ void tsmux_close(void *handle)
         delete hal->bufAllocator;
     }
 
+    pthread_mutex_destroy(&hal->stats_lock);
+    wfd_latency_ring_unmap(hal->latency_ring);
+
     free(hal);
     ALOGI("tsmux_close");
 }
@@ -823,6 +851,9 @@ void tsmux_deinit_m2m(void *handle)
 
     ioctl(hal->tsmux_fd, TSMUX_IOCTL_M2M_UNMAP_BUF);
 
+    /* the access units that are not flushed are dropped */
+    hal->m2m_staged_count = 0;
+
     /* buffer free */
     for (i = 0; i < TSMUX_MAX_M2M_CMD_QUEUE_NUM; i++) {
         if (hal->inbuf_addr[i] != NULL) {
@@ -844,24 +875,74 @@ void tsmux_deinit_m2m(void *handle)
     ALOGI("tsmux_deinit_m2m");
 }
 
-int tsmux_packetize_m2m(void *handle, sp<ABuffer> *inbufs, sp<ABuffer> *outbufs)
+static bool tsmux_psi_due(struct tsmux_hal *hal, int64_t nowUs)
+{
+    bool due;
+
+    pthread_mutex_lock(&hal->stats_lock);
+    due = nowUs - hal->last_psi_time_us > hal->psi_interval_us;
+    if (due) {
+        hal->last_psi_time_us = nowUs;
+        hal->stats.psi_count++;
+        hal->stats.psi_bytes += PSI_PACKET_COUNT * TS_PACKET_SIZE;
+    }
+    pthread_mutex_unlock(&hal->stats_lock);
+
+    return due;
+}
+
+static void tsmux_update_latency(int64_t *total_us, int64_t *max_us, int64_t latency_us)
+{
+    *total_us += latency_us;
+    if (*max_us < latency_us)
+        *max_us = latency_us;
+}
+
+/*
+ * Copies an audio access unit to the input buffer of the m2m job. The job is
+ * packetized by the next tsmux_run_m2m().
+ */
+static int tsmux_stage_m2m(struct tsmux_hal *hal, int i, const sp<ABuffer> &inbuf)
+{
+    int64_t timeUs;
+    int inbuf_size = inbuf->size();
+
+    CHECK(inbuf->meta()->findInt64("timeUs", &timeUs));
+
+    ALOGV("tsmux_stage_m2m(), i %d, inbufs %d", i, inbuf_size);
+
+    if (inbuf_size + (hal->use_lpcm ? 0 : 7) > M2M_BUF_SIZE) {
+        ALOGE("%s: too large audio access unit %d", __FUNCTION__, inbuf_size);
+        return -EINVAL;
+    }
+
+    if (hal->use_lpcm)
+        memcpy((uint8_t *)hal->inbuf_addr[i], (uint8_t *)inbuf->data(), inbuf_size);
+    else {
+        addADTSHeader((uint8_t *)hal->inbuf_addr[i], (uint8_t *)inbuf->data(),
+            inbuf_size, 1/* AAC_LC */, 3/* 48000Hz */, 2 /* 2 channels */);
+        inbuf_size += 7;
+    }
+
+    hal->m2m_cmd_queue.m2m_job[i].in_buf.actual_size = inbuf_size;
+    hal->m2m_staged_time_us[i] = timeUs;
+
+    return 0;
+}
+
+/*
+ * Packetizes the m2m jobs of which staged[i] is true in one TSMUX_IOCTL_M2M_RUN
+ */
+static int tsmux_run_m2m(struct tsmux_hal *hal, const bool *staged, sp<ABuffer> *outbufs)
 {
     int ret;
-    struct tsmux_hal *hal;
-    int64_t timeUs[TSMUX_MAX_M2M_CMD_QUEUE_NUM] = {0};
+    int64_t *timeUs = hal->m2m_staged_time_us;
     int i;
     struct tsmux_pkt_ctrl *pkt_ctrl;
     struct tsmux_pes_hdr *pes_hdr;
     struct tsmux_ts_hdr *ts_hdr;
     struct tsmux_rtp_hdr *rtp_hdr;
 
-    if (!handle) {
-        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
-        return -ENOENT;
-    }
-
-    hal = (struct tsmux_hal *)handle;
-
     // init
     for (i = 0; i <TSMUX_MAX_M2M_CMD_QUEUE_NUM; i++) {
         pes_hdr = &hal->m2m_cmd_queue.m2m_job[i].pes_hdr;
@@ -869,30 +950,16 @@ int tsmux_packetize_m2m(void *handle, sp<ABuffer> *inbufs, sp<ABuffer> *outbufs)
     }
 
     for (i = 0; i <TSMUX_MAX_M2M_CMD_QUEUE_NUM; i++) {
-        if (inbufs[i] == NULL)
+        if (!staged[i])
             continue;
 
-        CHECK(inbufs[i]->meta()->findInt64("timeUs", &timeUs[i]));
-
-        int inbuf_size = inbufs[i]->size();
-        ALOGV("tsmux_packetize_m2m(), i %d, inbufs %d", i, inbuf_size);
-
-        if (hal->use_lpcm)
-            memcpy((uint8_t *)hal->inbuf_addr[i], (uint8_t *)inbufs[i]->data(), inbuf_size);
-        else {
-            addADTSHeader((uint8_t *)hal->inbuf_addr[i], (uint8_t *)inbufs[i]->data(),
-                inbuf_size, 1/* AAC_LC */, 3/* 48000Hz */, 2 /* 2 channels */);
-            inbuf_size += 7;
-        }
-
-        hal->m2m_cmd_queue.m2m_job[i].in_buf.actual_size = inbuf_size;
+        int inbuf_size = hal->m2m_cmd_queue.m2m_job[i].in_buf.actual_size;
 
         pkt_ctrl = &hal->m2m_cmd_queue.m2m_job[i].pkt_ctrl;
 
         int64_t nowUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
-        if (nowUs - hal->last_psi_time_us > 50000) {
-            hal->last_psi_time_us = nowUs;
-            tsmux_send_psi(handle, timeUs[i]);
+        if (tsmux_psi_due(hal, nowUs)) {
+            tsmux_send_psi(hal, timeUs[i]);
             pkt_ctrl->psi_en = 1;
         } else {
             pkt_ctrl->psi_en = 0;
@@ -957,13 +1024,29 @@ int tsmux_packetize_m2m(void *handle, sp<ABuffer> *inbufs, sp<ABuffer> *outbufs)
         rtp_hdr->ssrc = 0xdeadbeef;
     }
 
+    int64_t runUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
+
     ret = ioctl(hal->tsmux_fd, TSMUX_IOCTL_M2M_RUN, &hal->m2m_cmd_queue);
     if (ret < 0) {
         ALOGE("fail to ioctl: TSMUX_IOCTL_M2M_RUN");
         return ret;
     }
 
+    runUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll - runUs;
+
+    pthread_mutex_lock(&hal->stats_lock);
+    tsmux_update_latency(&hal->stats.m2m_packetize_us, &hal->stats.m2m_packetize_max_us, runUs);
+    hal->stats.m2m_runs++;
+    for (i = 0; i <TSMUX_MAX_M2M_CMD_QUEUE_NUM; i++) {
+        if (staged[i] && (hal->m2m_cmd_queue.m2m_job[i].out_buf.actual_size > 0))
+            hal->stats.bytes_out += hal->m2m_cmd_queue.m2m_job[i].out_buf.actual_size;
+    }
+    pthread_mutex_unlock(&hal->stats_lock);
+
     for (i = 0; i <TSMUX_MAX_M2M_CMD_QUEUE_NUM; i++) {
+        if (!staged[i])
+            continue;
+
         int outbufSize = hal->m2m_cmd_queue.m2m_job[i].out_buf.actual_size;
         pkt_ctrl = &hal->m2m_cmd_queue.m2m_job[i].pkt_ctrl;
         ALOGV("tsmux_packetize_m2m(), i %d, outbufSize %d", i, outbufSize);
@@ -980,6 +1063,126 @@ int tsmux_packetize_m2m(void *handle, sp<ABuffer> *inbufs, sp<ABuffer> *outbufs)
     return ret;
 }
 
+int tsmux_packetize_m2m(void *handle, sp<ABuffer> *inbufs, sp<ABuffer> *outbufs)
+{
+    int ret;
+    struct tsmux_hal *hal;
+    bool staged[TSMUX_MAX_M2M_CMD_QUEUE_NUM] = {false};
+    int i;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if (hal->m2m_staged_count > 0) {
+        ALOGE("%s: %d audio access units are queued by tsmux_queue_m2m()",
+            __FUNCTION__, hal->m2m_staged_count);
+        return -EBUSY;
+    }
+
+    for (i = 0; i <TSMUX_MAX_M2M_CMD_QUEUE_NUM; i++) {
+        if (inbufs[i] == NULL)
+            continue;
+
+        ret = tsmux_stage_m2m(hal, i, inbufs[i]);
+        if (ret < 0)
+            return ret;
+
+        staged[i] = true;
+    }
+
+    return tsmux_run_m2m(hal, staged, outbufs);
+}
+
+int tsmux_set_m2m_coalescing(void *handle, int max_count, int64_t max_delay_us)
+{
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if ((max_count < 1) || (max_count > TSMUX_MAX_M2M_CMD_QUEUE_NUM) || (max_delay_us < 0)) {
+        ALOGE("%s: invalid coalescing %d access units, %lld us", __FUNCTION__,
+            max_count, (long long)max_delay_us);
+        return -EINVAL;
+    }
+
+    if (hal->m2m_staged_count >= max_count) {
+        ALOGE("%s: %d audio access units are already queued", __FUNCTION__,
+            hal->m2m_staged_count);
+        return -EBUSY;
+    }
+
+    hal->m2m_coalesce_count = max_count;
+    hal->m2m_coalesce_us = max_delay_us;
+
+    return 0;
+}
+
+int tsmux_flush_m2m(void *handle, sp<ABuffer> *outbufs)
+{
+    int ret;
+    struct tsmux_hal *hal;
+    bool staged[TSMUX_MAX_M2M_CMD_QUEUE_NUM] = {false};
+    int i;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if (hal->m2m_staged_count == 0)
+        return 0;
+
+    for (i = 0; i < hal->m2m_staged_count; i++)
+        staged[i] = true;
+
+    ALOGV("tsmux_flush_m2m(), %d audio access units", hal->m2m_staged_count);
+
+    hal->m2m_staged_count = 0;
+
+    ret = tsmux_run_m2m(hal, staged, outbufs);
+    if (ret < 0)
+        return ret;
+
+    return 1;
+}
+
+int tsmux_queue_m2m(void *handle, const sp<ABuffer> &inbuf, sp<ABuffer> *outbufs)
+{
+    int ret;
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    ret = tsmux_stage_m2m(hal, hal->m2m_staged_count, inbuf);
+    if (ret < 0)
+        return ret;
+
+    hal->m2m_staged_count++;
+
+    if ((hal->m2m_staged_count < hal->m2m_coalesce_count) &&
+            (hal->m2m_staged_time_us[hal->m2m_staged_count - 1] -
+             hal->m2m_staged_time_us[0] < hal->m2m_coalesce_us))
+        return 0;
+
+    return tsmux_flush_m2m(handle, outbufs);
+}
+
 int tsmux_init_otf(void *handle, uint32_t width, uint32_t height) {
     int ret;
     struct tsmux_hal *hal;
@@ -1028,6 +1231,7 @@ int tsmux_init_otf(void *handle, uint32_t width, uint32_t height) {
     }
 
     hal->video_frame_count = 0;
+    hal->otf_config_applied = false;
 
     ret = ioctl(hal->tsmux_fd, TSMUX_IOCTL_OTF_MAP_BUF, &hal->otf_cmd_queue);
     if (ret < 0) {
@@ -1057,6 +1261,8 @@ void tsmux_deinit_otf(void *handle) {
 
     hal = (struct tsmux_hal *)handle;
 
+    tsmux_stop_otf_worker(hal);
+
     ioctl(hal->tsmux_fd, TSMUX_IOCTL_OTF_UNMAP_BUF);
 
     /* buffer free */
@@ -1076,28 +1282,47 @@ void tsmux_deinit_otf(void *handle) {
     ALOGI("tsmux_deinit_otf");
 }
 
-int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf)
+/*
+ * Records the stages of the dequeued frame with the timestamps in us of
+ * tsmux device driver. A stage without timestamp is not recorded.
+ */
+static void tsmux_trace_otf_latency(struct tsmux_hal *hal, struct tsmux_buffer *out_buf)
 {
-    int ret;
-    struct tsmux_hal *hal;
-    int cur_buf_index;
-    struct tsmux_buffer *cur_out_buf = NULL;
+    const struct {
+        uint32_t stage;
+        int64_t time_us;
+    } stamps[] = {
+        {WFD_LATENCY_REPEATER_COPY_START, out_buf->g2d_start_stamp},
+        {WFD_LATENCY_REPEATER_COPY_DONE, out_buf->g2d_end_stamp},
+        {WFD_LATENCY_ENCODER_START, out_buf->mfc_start_stamp},
+        {WFD_LATENCY_ENCODER_DONE, out_buf->mfc_end_stamp},
+        {WFD_LATENCY_TSMUX_DONE, out_buf->tsmux_end_stamp},
+    };
+
+    if (!hal->latency_ring)
+        return;
 
-    ALOGV("tsmux_dq_buf_otf()");
+    uint64_t frame_id = hal->latency_ring->frame_id.load(std::memory_order_relaxed);
 
-    if (!handle) {
-        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
-        return -1;
+    for (size_t i = 0; i < sizeof(stamps) / sizeof(stamps[0]); i++) {
+        if (stamps[i].time_us > 0)
+            wfd_latency_trace_at(hal->latency_ring, frame_id, stamps[i].stage,
+                                 stamps[i].time_us * 1000);
     }
 
-    hal = (struct tsmux_hal *)handle;
+    wfd_latency_trace_at(hal->latency_ring, frame_id, WFD_LATENCY_TSMUX_DEQUEUE,
+                         systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
+static int tsmux_dq_otf(struct tsmux_hal *hal)
+{
+    int ret;
 
     struct tsmux_pkt_ctrl *pkt_ctrl = &hal->otf_cmd_queue.config.pkt_ctrl;
 
     int64_t nowUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
-    if (nowUs - hal->last_psi_time_us > 50000) {
-        hal->last_psi_time_us = nowUs;
-        tsmux_send_psi(handle, nowUs);
+    if (tsmux_psi_due(hal, nowUs)) {
+        tsmux_send_psi(hal, nowUs);
         pkt_ctrl->psi_en = 1;
     } else {
         pkt_ctrl->psi_en = 0;
@@ -1155,10 +1380,24 @@ int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf)
     rtp_hdr->pl_type = 33;
     rtp_hdr->ssrc = 0xdeadbeef;
 
-    ret = ioctl(hal->tsmux_fd, TSMUX_IOCTL_OTF_SET_CONFIG, &hal->otf_cmd_queue.config);
-    if (ret < 0) {
-        ALOGE("fail to ioctl: TSMUX_IOCTL_OTF_SET_CONFIG");
-        return -1;
+    /*
+     * The configuration is changed by PSI, by the users of
+     * tsmux_get_config_otf() and by TSMUX_IOCTL_OTF_DQ_BUF that writes back
+     * the whole command queue. It is set to the driver only if it differs
+     * from the last one that is set.
+     */
+    if (!hal->otf_config_applied ||
+            memcmp(&hal->applied_otf_config, &hal->otf_cmd_queue.config,
+                   sizeof(hal->applied_otf_config)) != 0) {
+        ret = ioctl(hal->tsmux_fd, TSMUX_IOCTL_OTF_SET_CONFIG, &hal->otf_cmd_queue.config);
+        if (ret < 0) {
+            ALOGE("fail to ioctl: TSMUX_IOCTL_OTF_SET_CONFIG");
+            hal->otf_config_applied = false;
+            return -1;
+        }
+
+        hal->applied_otf_config = hal->otf_cmd_queue.config;
+        hal->otf_config_applied = true;
     }
 
     ALOGV("tsmux_dq_buf_otf: request dq buf");
@@ -1169,18 +1408,29 @@ int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf)
         return -1;
     }
 
-    int64_t curTimeUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
+    struct tsmux_buffer *out_buf = &hal->otf_cmd_queue.out_buf[hal->otf_cmd_queue.cur_buf_num];
+    int64_t waitUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll - nowUs;
 
-    cur_buf_index = hal->otf_cmd_queue.cur_buf_num;
-    cur_out_buf = &hal->otf_cmd_queue.out_buf[cur_buf_index];
+    pthread_mutex_lock(&hal->stats_lock);
+    tsmux_update_latency(&hal->stats.otf_dq_wait_us, &hal->stats.otf_dq_wait_max_us, waitUs);
+    tsmux_update_latency(&hal->stats.otf_packetize_us, &hal->stats.otf_packetize_max_us,
+        out_buf->tsmux_end_stamp - out_buf->tsmux_start_stamp);
+    hal->stats.bytes_out += out_buf->actual_size;
+    pthread_mutex_unlock(&hal->stats_lock);
 
-    int out_buf_size = cur_out_buf->actual_size;
-    outbuf = new ABuffer(out_buf_size);
-    memcpy(outbuf->data(), hal->otfbuf_addr[cur_buf_index], out_buf_size);
+    tsmux_trace_otf_latency(hal, out_buf);
+
+    return hal->otf_cmd_queue.cur_buf_num;
+}
+
+static void tsmux_set_otf_meta(struct tsmux_hal *hal, struct tsmux_buffer *cur_out_buf,
+        sp<ABuffer> &outbuf)
+{
+    int64_t curTimeUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
 
     outbuf->meta()->setInt32("es_size", cur_out_buf->es_size);
     outbuf->meta()->setInt32("hdcp", hal->otf_cmd_queue.config.hex_ctrl.otf_enable);
-    outbuf->meta()->setInt32("rtp_size", pkt_ctrl->rtp_size);
+    outbuf->meta()->setInt32("rtp_size", hal->otf_cmd_queue.config.pkt_ctrl.rtp_size);
     outbuf->meta()->setInt64("g2ds", cur_out_buf->g2d_start_stamp);
     outbuf->meta()->setInt64("g2de", cur_out_buf->g2d_end_stamp);
     outbuf->meta()->setInt64("mfcs", cur_out_buf->mfc_start_stamp);
@@ -1189,6 +1439,34 @@ int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf)
     outbuf->meta()->setInt64("tsme", cur_out_buf->tsmux_end_stamp);
     outbuf->meta()->setInt64("kere", cur_out_buf->kernel_end_stamp);
     outbuf->meta()->setInt64("plts", curTimeUs);
+}
+
+int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf)
+{
+    struct tsmux_hal *hal;
+    int cur_buf_index;
+    struct tsmux_buffer *cur_out_buf = NULL;
+
+    ALOGV("tsmux_dq_buf_otf()");
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -1;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    cur_buf_index = tsmux_dq_otf(hal);
+    if (cur_buf_index < 0)
+        return -1;
+
+    cur_out_buf = &hal->otf_cmd_queue.out_buf[cur_buf_index];
+
+    int out_buf_size = cur_out_buf->actual_size;
+    outbuf = new ABuffer(out_buf_size);
+    memcpy(outbuf->data(), hal->otfbuf_addr[cur_buf_index], out_buf_size);
+
+    tsmux_set_otf_meta(hal, cur_out_buf, outbuf);
 
     ALOGV("tsmux_dq_buf_otf: dequeu buf, cur_out_buf->actual_size %d", out_buf_size);
 
@@ -1197,6 +1475,44 @@ int tsmux_dq_buf_otf(void *handle, sp<ABuffer> &outbuf)
     return 0;
 }
 
+int tsmux_dq_buf_otf_nocopy(void *handle, sp<ABuffer> &outbuf, int *buf_index)
+{
+    struct tsmux_hal *hal;
+    int cur_buf_index;
+    struct tsmux_buffer *cur_out_buf = NULL;
+
+    ALOGV("tsmux_dq_buf_otf_nocopy()");
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -1;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    cur_buf_index = tsmux_dq_otf(hal);
+    if (cur_buf_index < 0)
+        return -1;
+
+    cur_out_buf = &hal->otf_cmd_queue.out_buf[cur_buf_index];
+
+    /* the mapped OTF buffer is returned to the driver by tsmux_q_buf_otf_index() */
+    outbuf = new ABuffer(hal->otfbuf_addr[cur_buf_index], cur_out_buf->actual_size);
+
+    tsmux_set_otf_meta(hal, cur_out_buf, outbuf);
+    outbuf->meta()->setInt32("buf_index", cur_buf_index);
+    outbuf->meta()->setInt32("buf_fd", cur_out_buf->ion_buf_fd);
+
+    *buf_index = cur_buf_index;
+
+    ALOGV("tsmux_dq_buf_otf_nocopy: dequeu buf %d, cur_out_buf->actual_size %d",
+        cur_buf_index, cur_out_buf->actual_size);
+
+    hal->video_frame_count++;
+
+    return 0;
+}
+
 void tsmux_q_buf_otf(void *handle)
 {
     int ret;
@@ -1216,6 +1532,220 @@ void tsmux_q_buf_otf(void *handle)
     }
 }
 
+void tsmux_q_buf_otf_index(void *handle, int buf_index)
+{
+    int ret;
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return;
+    }
+
+    if ((buf_index < 0) || (buf_index >= TSMUX_OUT_BUF_CNT)) {
+        ALOGE("%s: invalid otf buffer index %d", __FUNCTION__, buf_index);
+        return;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    ret = ioctl(hal->tsmux_fd, TSMUX_IOCTL_OTF_Q_BUF, &buf_index);
+    if (ret < 0) {
+        ALOGE("fail to ioctl: TSMUX_IOCTL_OTF_Q_BUF(%d)", buf_index);
+        return;
+    }
+}
+
+int tsmux_set_psi_interval(void *handle, int64_t min_interval_us, int64_t max_interval_us)
+{
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if ((min_interval_us <= 0) || (min_interval_us > max_interval_us)) {
+        ALOGE("%s: invalid PSI interval %lld ~ %lld us", __FUNCTION__,
+            (long long)min_interval_us, (long long)max_interval_us);
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&hal->stats_lock);
+    hal->psi_min_interval_us = min_interval_us;
+    hal->psi_max_interval_us = max_interval_us;
+    hal->psi_interval_us = min_interval_us;
+    pthread_mutex_unlock(&hal->stats_lock);
+
+    ALOGI("PSI interval %lld ~ %lld us", (long long)min_interval_us, (long long)max_interval_us);
+
+    return 0;
+}
+
+void tsmux_report_packet_loss(void *handle, int lost_packets)
+{
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    pthread_mutex_lock(&hal->stats_lock);
+    if (lost_packets > 0) {
+        /* the sink may have lost PSI. resend PSI as soon as possible */
+        hal->psi_interval_us = hal->psi_min_interval_us;
+    } else {
+        hal->psi_interval_us += hal->psi_interval_us / 4;
+        if (hal->psi_interval_us > hal->psi_max_interval_us)
+            hal->psi_interval_us = hal->psi_max_interval_us;
+    }
+    pthread_mutex_unlock(&hal->stats_lock);
+
+    ALOGV("packet loss %d, PSI interval %lld us", lost_packets, (long long)hal->psi_interval_us);
+}
+
+int tsmux_set_latency_ring(void *handle, int fd)
+{
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if (hal->otf_worker_running) {
+        ALOGE("%s: otf worker is running", __FUNCTION__);
+        return -EBUSY;
+    }
+
+    wfd_latency_ring_unmap(hal->latency_ring);
+    hal->latency_ring = NULL;
+
+    if (fd < 0)
+        return 0;
+
+    hal->latency_ring = wfd_latency_ring_map(fd);
+    if (!hal->latency_ring) {
+        ALOGE("%s: fail to map WFD latency trace ring (fd %d)", __FUNCTION__, fd);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+int tsmux_get_stats(void *handle, struct tsmux_stats *stats)
+{
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    pthread_mutex_lock(&hal->stats_lock);
+    *stats = hal->stats;
+    stats->video_frames = hal->video_frame_count;
+    stats->audio_frames = hal->audio_frame_count;
+    stats->psi_interval_us = hal->psi_interval_us;
+    pthread_mutex_unlock(&hal->stats_lock);
+
+    return 0;
+}
+
+static void *tsmux_otf_worker(void *arg)
+{
+    struct tsmux_hal *hal = (struct tsmux_hal *)arg;
+
+    ALOGI("tsmux otf worker started");
+
+    while (!hal->otf_worker_stop) {
+        sp<ABuffer> outbuf;
+        int buf_index;
+
+        if (tsmux_dq_buf_otf_nocopy(hal, outbuf, &buf_index) < 0) {
+            /* the device is being stopped or failed. avoid busy looping */
+            usleep(1000);
+            continue;
+        }
+
+        if (hal->otf_worker_stop) {
+            tsmux_q_buf_otf_index(hal, buf_index);
+            break;
+        }
+
+        hal->otf_sink(hal->otf_sink_cookie, outbuf, buf_index);
+    }
+
+    ALOGI("tsmux otf worker stopped");
+
+    return NULL;
+}
+
+int tsmux_start_otf_worker(void *handle, tsmux_otf_sink_t sink, void *cookie)
+{
+    struct tsmux_hal *hal;
+    int ret;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return -ENOENT;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if (!sink) {
+        ALOGE("%s: no sink is given", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    if (hal->otf_worker_running) {
+        ALOGE("%s: otf worker is already running", __FUNCTION__);
+        return -EBUSY;
+    }
+
+    hal->otf_sink = sink;
+    hal->otf_sink_cookie = cookie;
+    hal->otf_worker_stop = false;
+
+    ret = pthread_create(&hal->otf_worker, NULL, tsmux_otf_worker, hal);
+    if (ret != 0) {
+        ALOGE("%s: failed to create otf worker (%d)", __FUNCTION__, ret);
+        return -ret;
+    }
+
+    hal->otf_worker_running = true;
+
+    return 0;
+}
+
+void tsmux_stop_otf_worker(void *handle)
+{
+    struct tsmux_hal *hal;
+
+    if (!handle) {
+        ALOGE("%s: tsmux module was not opened", __FUNCTION__);
+        return;
+    }
+
+    hal = (struct tsmux_hal *)handle;
+
+    if (!hal->otf_worker_running)
+        return;
+
+    hal->otf_worker_stop = true;
+    pthread_join(hal->otf_worker, NULL);
+    hal->otf_worker_running = false;
+}
+
 int tsmux_get_config_otf(void *handle, struct tsmux_config_data *config)
 {
     struct tsmux_hal *hal;
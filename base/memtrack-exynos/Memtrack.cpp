@@ -15,10 +15,11 @@
  */
 
 #include <fcntl.h>
-#include <fstream>
-#include <sstream>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 
@@ -61,44 +62,14 @@ static uint32_t sgpu_available_flags[] = {
 };
 
 const char DMABUF_TRACE_PATH[] = "/dev/dmabuf_trace";
-static void getDmaBufMem(pid_t pid, std::vector<MemtrackRecord>* _aidl_return) {
+static void getDmaBufMem(int fd, pid_t pid, std::vector<MemtrackRecord>* _aidl_return) {
     struct dmabuf_trace_memory data;
+    uint32_t flags[ARRAY_SIZE(available_flags)];
+    uint32_t size_in_bytes[ARRAY_SIZE(available_flags)] = {0, };
     unsigned int count = ARRAY_SIZE(available_flags);
 
-    struct LocalSweeper {
-        int fd;
-        uint32_t *flags;
-        uint32_t *size_in_bytes;
-
-        LocalSweeper() : fd(0), flags(nullptr), size_in_bytes(nullptr) { }
-        ~LocalSweeper() {
-            if (fd)
-                close(fd);
-
-            if (flags)
-                free(flags);
-
-            if (size_in_bytes)
-                free(size_in_bytes);
-        }
-    } sweeper;
-
-    int fd = open(DMABUF_TRACE_PATH, O_RDONLY | O_CLOEXEC);
-    if (fd < 0)
-        return;
-
-    sweeper.fd = fd;
-
-    data.flags = (uint32_t *)calloc(count, sizeof(int32_t));
-    if (!data.flags)
-        return;
-    sweeper.flags = data.flags;
-
-    data.size_in_bytes = (uint32_t *)calloc(count, sizeof(int32_t));
-    if (!data.size_in_bytes)
-        return;
-    sweeper.size_in_bytes = data.size_in_bytes;
-
+    data.flags = flags;
+    data.size_in_bytes = size_in_bytes;
     data.count = count;
     data.type = (uint32_t)MemtrackType::GRAPHICS;
     data.pid = pid;
@@ -118,46 +89,65 @@ static void getDmaBufMem(pid_t pid, std::vector<MemtrackRecord>* _aidl_return) {
     }
 }
 
-static void getGpuMem(pid_t pid, std::vector<MemtrackRecord>* _aidl_return) {
-    size_t allocated_records = ARRAY_SIZE(sgpu_available_flags);
-    FILE *fp;
+int Memtrack::getDmaBufTraceFd() {
+    std::lock_guard<std::mutex> lock(mDmaBufTraceLock);
+
+    if (mDmaBufTraceFd < 0)
+        mDmaBufTraceFd = open(DMABUF_TRACE_PATH, O_RDONLY | O_CLOEXEC);
+
+    return mDmaBufTraceFd;
+}
+
+const char GPU_MEM_INFO_PATH[] = "/sys/kernel/gpu/mem_info";
+
+/*
+ * mem_info starts with a line of each process:
+ * pid: <pid> <size in bytes>
+ */
+void Memtrack::updateGpuMemSnapshot(std::chrono::steady_clock::time_point now) {
     char line[1024] = {0, }, mem_type[16] = {0, };
-    int r, cur_pid;
-    size_t mem_size = 0;
+    int cur_pid;
+    size_t mem_size;
 
-    /* fastpath to return the necessary number of
-     * * records */
-    if (allocated_records == 0)
-	return;
+    mGpuMem.clear();
+    mGpuMemValid = true;
+    mGpuMemTime = now;
 
-    fp = fopen("/sys/kernel/gpu/mem_info", "r");
+    FILE *fp = fopen(GPU_MEM_INFO_PATH, "r");
 
+    mGpuMemAvailable = (fp != NULL);
     if (fp == NULL)
-	return;
-
-    while(1) {
-	if (fgets(line, sizeof(line), fp) == NULL)
-	    break;
+        return;
 
-	r = sscanf(line, "%s", mem_type);
-	if (!strcmp(mem_type, "pid:")) {
-	    r = sscanf(line, "%*s %d %zu\n", &cur_pid, &mem_size);
-	    if (!r) {
-		    fclose(fp);
-		    return;
-	    }
-
-	    if(cur_pid != pid)
-		continue;
-	    else
-		break;
-	}
-	mem_size = 0;
-	break;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if ((sscanf(line, "%15s", mem_type) != 1) || strcmp(mem_type, "pid:"))
+            break;
+        if (sscanf(line, "%*s %d %zu", &cur_pid, &mem_size) != 2)
+            break;
+        mGpuMem[cur_pid] = mem_size;
     }
 
-    if (fp != NULL)
-	fclose(fp);
+    fclose(fp);
+}
+
+bool Memtrack::getGpuMemSize(int pid, size_t* size) {
+    std::lock_guard<std::mutex> lock(mGpuMemLock);
+    auto now = std::chrono::steady_clock::now();
+
+    if (!mGpuMemValid || (now - mGpuMemTime > kGpuMemSnapshotTtl))
+        updateGpuMemSnapshot(now);
+
+    if (!mGpuMemAvailable)
+        return false;
+
+    auto it = mGpuMem.find(pid);
+    *size = (it != mGpuMem.end()) ? it->second : 0;
+
+    return true;
+}
+
+static void getGpuMem(size_t mem_size, std::vector<MemtrackRecord>* _aidl_return) {
+    size_t allocated_records = ARRAY_SIZE(sgpu_available_flags);
 
     if (allocated_records > 0) {
 	MemtrackRecord record = {
@@ -177,7 +167,8 @@ static void getGpuMem(pid_t pid, std::vector<MemtrackRecord>* _aidl_return) {
 
 ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
                                        std::vector<MemtrackRecord>* _aidl_return) {
-    struct stat st;
+    size_t mem_size;
+    int fd;
 
     if (pid < 0) {
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
@@ -190,11 +181,13 @@ ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
 
     switch (type) {
 	case MemtrackType::GL:
-	    if (!stat("/sys/kernel/gpu", &st) && S_ISDIR(st.st_mode))
-		getGpuMem(pid, _aidl_return);
+	    if (getGpuMemSize(pid, &mem_size))
+		getGpuMem(mem_size, _aidl_return);
 	    break;
 	case MemtrackType::GRAPHICS:
-	    getDmaBufMem(pid, _aidl_return);
+	    fd = getDmaBufTraceFd();
+	    if (fd >= 0)
+		getDmaBufMem(fd, pid, _aidl_return);
 	    break;
 	default:
 	    break;
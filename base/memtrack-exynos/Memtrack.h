@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
 #include <aidl/android/hardware/memtrack/BnMemtrack.h>
 #include <aidl/android/hardware/memtrack/DeviceInfo.h>
 #include <aidl/android/hardware/memtrack/MemtrackRecord.h>
@@ -31,6 +35,27 @@ class Memtrack : public BnMemtrack {
                                  std::vector<MemtrackRecord>* _aidl_return) override;
 
     ndk::ScopedAStatus getGpuDeviceInfo(std::vector<DeviceInfo>* _aidl_return) override;
+
+    /*
+     * The system queries all processes back to back. The GPU memory of all
+     * processes is read from mem_info at once and the queries within
+     * kGpuMemSnapshotTtl are served from the snapshot.
+     */
+    static constexpr std::chrono::milliseconds kGpuMemSnapshotTtl{1000};
+
+    bool getGpuMemSize(int pid, size_t* size);
+    void updateGpuMemSnapshot(std::chrono::steady_clock::time_point now);
+    int getDmaBufTraceFd();
+
+    std::mutex mGpuMemLock;
+    bool mGpuMemValid = false;
+    bool mGpuMemAvailable = false;
+    std::chrono::steady_clock::time_point mGpuMemTime;
+    std::unordered_map<int, size_t> mGpuMem;
+
+    // opened once and kept for the queries of GRAPHICS
+    std::mutex mDmaBufTraceLock;
+    int mDmaBufTraceFd = -1;
 };
 
 }  // namespace memtrack
@@ -38,6 +38,8 @@ typedef struct perfMap {
     uint32_t minClock[CPU_CLUSTER_CNT];
     // M2M Capa
     uint32_t m2mCapa;
+    /* uclamp.min of the present thread, 0 leaves it to the task profile */
+    uint32_t uclampMin;
 } perfMap_t;
 
 /* If you need affinity settings for each refresh rates, Write CPU_CLUSTER[x]_MASK definitions
@@ -45,9 +47,9 @@ typedef struct perfMap {
  * - If it's needed to set affinity to Middle and Big clusters, Write "CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK"
  * - If it's not needed to set affinity, write all MASKs */
 static std::map<uint32_t, perfMap> perfTable = {
-    {30, {CPU_CLUSTER0_MASK | CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK, {0, 0, 0}, 24}},
-    {60, {CPU_CLUSTER0_MASK | CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK, {0, 0, 0}, 8}},
-    {120, {CPU_CLUSTER0_MASK | CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK, {0, 0, 0}, 4}},
+    {30, {CPU_CLUSTER0_MASK | CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK, {0, 0, 0}, 24, 0}},
+    {60, {CPU_CLUSTER0_MASK | CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK, {0, 0, 0}, 8, 0}},
+    {120, {CPU_CLUSTER0_MASK | CPU_CLUSTER1_MASK | CPU_CLUSTER2_MASK, {0, 0, 0}, 4, 0}},
 };
 
 typedef struct cpuProp {
@@ -34,6 +34,8 @@ class ExynosDeviceModule : public ExynosDevice {
         };
         bool isEPICHandleInit = false;
         virtual void setCPUClocksPerCluster(uint32_t fps);
+        virtual void acquireCPUPerfPerCluster(uint32_t fps);
+        virtual void releaseCPUPerfPerCluster();
         epic_handle cl_min_handle[CPU_CLUSTER_CNT];
 };
 
@@ -106,6 +106,7 @@ void ExynosResourceManagerModule::setVirtualOtfMPPsRestrictions()
                 (mOtfMPPs[i]->mLogicalType == MPP_LOGICAL_DPP_VGRFS8K))
         {
             mOtfMPPs[i]->mAttr &= (~MPP_ATTR_DIM) & (~MPP_ATTR_WINDOW_UPDATE) & (~MPP_ATTR_BLOCK_MODE);
+            mOtfMPPs[i]->invalidateSupportedMemo();
             for (uint32_t j = 0; j < RESTRICTION_MAX; j++) {
                 /* Src min/max size */
                 mOtfMPPs[i]->mSrcSizeRestrictions[j].minCropWidth = mOtfMPPs[i]->mSrcSizeRestrictions[j].maxCropWidth;
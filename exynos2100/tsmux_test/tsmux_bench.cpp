@@ -0,0 +1,423 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Throughput and latency benchmark of libtsmux
+ *
+ * m2m: synthetic AAC or LPCM access units of the given bitrate are
+ *      packetized by tsmux_packetize_m2m() as fast as possible.
+ * otf: the repeater is started with synthetic NV12N frames and the OTF
+ *      stream of AVC or HEVC is dequeued and queued back as WFD does.
+ *      The video bitrate is decided by the encoder configuration.
+ *
+ * It reports TS packets per second, percentiles of the packetize latency
+ * of a frame and the CPU time of this process.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <BufferAllocator/BufferAllocatorWrapper.h>
+
+#include "tsmux_hal.h"
+#include "repeater.h"
+
+using namespace android;
+
+#define DEVNAME_REPEATER    "/dev/repeater"
+
+#define M2M_PATH            (0)
+#define OTF_PATH            (1)
+
+#define AAC_FRAME_US        (1024 * 1000000ll / 48000)
+#define LPCM_FRAME_US       (5000)
+
+#ifndef __ALIGN_UP
+#define __ALIGN_UP(x, a)        (((x) + ((a) - 1)) & ~((a) - 1))
+#endif
+#define NV12N_Y_SIZE(w, h)      (__ALIGN_UP((w), 16) * __ALIGN_UP((h), 16) + 256)
+#define NV12N_CBCR_SIZE(w, h)   (__ALIGN_UP((__ALIGN_UP((w), 16) * (__ALIGN_UP((h), 16) / 2) + 256), 16))
+#define v4l2_fourcc(a,b,c,d) ((__u32) (a) | ((__u32) (b) << 8) | ((__u32) (c) << 16) | ((__u32) (d) << 24))
+#define V4L2_PIX_FMT_NV12N v4l2_fourcc('N', 'N', '1', '2')
+
+struct bench_config {
+    int type;
+    bool hdcp;
+    bool hevc;
+    bool lpcm;
+    int bitrate_kbps;       /* of audio access units */
+    int batch;              /* access units in a m2m run */
+    int frames;
+    int width;
+    int height;
+    int fps;
+};
+
+struct bench_result {
+    int64_t frames;
+    int64_t bytes;
+    int64_t ts_packets;
+    int64_t wall_us;
+    int64_t cpu_us;
+    std::vector<int64_t> latency_us;    /* of each frame */
+};
+
+static int64_t now_us(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+/* TS packets in an RTP stream of the given size, excluding the RTP headers */
+static int64_t count_ts_packets(int64_t bytes, int rtp_size)
+{
+    int64_t rtp_packet_size = RTP_HEADER_SIZE + (int64_t)rtp_size * TS_PACKET_SIZE;
+    int64_t rtp_packets = (bytes + rtp_packet_size - 1) / rtp_packet_size;
+
+    return (bytes - rtp_packets * RTP_HEADER_SIZE) / TS_PACKET_SIZE;
+}
+
+static int bench_m2m(void *handle, const struct bench_config *config, struct bench_result *result)
+{
+    int64_t frame_us = config->lpcm ? LPCM_FRAME_US : AAC_FRAME_US;
+    int au_size = (int)(config->bitrate_kbps * 1000ll * frame_us / 8 / 1000000ll);
+    int64_t timeUs = 0;
+    int ret;
+
+    if (au_size <= 0) {
+        printf("too low bitrate %d kbps\n", config->bitrate_kbps);
+        return -EINVAL;
+    }
+
+    ret = tsmux_init_m2m(handle);
+    if (ret < 0) {
+        printf("tsmux_init_m2m() failed %d\n", ret);
+        tsmux_deinit_m2m(handle);
+        return ret;
+    }
+
+    printf("m2m: %s %d kbps, %d bytes per %lld us, %d per run\n",
+        config->lpcm ? "lpcm" : "aac", config->bitrate_kbps, au_size,
+        (long long)frame_us, config->batch);
+
+    sp<ABuffer> inbufs[TSMUX_MAX_M2M_CMD_QUEUE_NUM];
+    for (int i = 0; i < config->batch; i++) {
+        inbufs[i] = new ABuffer(au_size);
+        for (int j = 0; j < au_size; j++)
+            inbufs[i]->data()[j] = (uint8_t)rand();
+    }
+
+    for (int frame = 0; frame < config->frames; frame += config->batch) {
+        sp<ABuffer> outbufs[TSMUX_MAX_M2M_CMD_QUEUE_NUM];
+
+        for (int i = 0; i < config->batch; i++) {
+            inbufs[i]->meta()->setInt64("timeUs", timeUs);
+            timeUs += frame_us;
+        }
+
+        int64_t start = now_us(CLOCK_MONOTONIC);
+        ret = tsmux_packetize_m2m(handle, inbufs, outbufs);
+        int64_t latency = now_us(CLOCK_MONOTONIC) - start;
+        if (ret < 0) {
+            printf("tsmux_packetize_m2m() failed %d at frame %d\n", ret, frame);
+            break;
+        }
+
+        for (int i = 0; i < config->batch; i++) {
+            int32_t rtp_size = TS_PKT_COUNT_PER_RTP;
+
+            if (outbufs[i] == NULL)
+                continue;
+            outbufs[i]->meta()->findInt32("rtp_size", &rtp_size);
+            result->bytes += outbufs[i]->size();
+            result->ts_packets += count_ts_packets(outbufs[i]->size(), rtp_size);
+            result->frames++;
+            /* the access units of a run are packetized at once */
+            result->latency_us.push_back(latency);
+        }
+    }
+
+    tsmux_deinit_m2m(handle);
+
+    return ret < 0 ? ret : 0;
+}
+
+static int start_repeater(const struct bench_config *config, BufferAllocator *allocator)
+{
+    int buffer_size = NV12N_Y_SIZE(config->width, config->height) +
+                      NV12N_CBCR_SIZE(config->width, config->height);
+    struct repeater_info info;
+    int repeater_fd;
+    int i;
+
+    repeater_fd = open(DEVNAME_REPEATER, O_RDWR);
+    if (repeater_fd < 0) {
+        printf("failed to open repeater : %s, %d\n", DEVNAME_REPEATER, errno);
+        return -1;
+    }
+
+    for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++) {
+        info.buf_fd[i] = DmabufHeapAlloc(allocator, "system-uncached", buffer_size, 0);
+        if (info.buf_fd[i] < 0) {
+            printf("failed to dmabufheap alloc\n");
+            while (--i >= 0)
+                close(info.buf_fd[i]);
+            close(repeater_fd);
+            return -1;
+        }
+
+        /* gradient of luma shifted by buffers, neutral chroma */
+        char *addr = (char *)mmap(0, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            info.buf_fd[i], 0);
+        if (addr != MAP_FAILED) {
+            int y_size = NV12N_Y_SIZE(config->width, config->height);
+            for (int j = 0; j < y_size; j++)
+                addr[j] = (char)(j + i * 16);
+            memset(addr + y_size, 0x80, buffer_size - y_size);
+            munmap(addr, buffer_size);
+        }
+    }
+
+    info.fps = config->fps;
+    info.width = config->width;
+    info.height = config->height;
+    info.pixel_format = V4L2_PIX_FMT_NV12N;
+    info.buffer_count = MAX_SHARED_BUFFER_NUM;
+
+    if (ioctl(repeater_fd, REPEATER_IOCTL_MAP_BUF, &info) < 0 ||
+            ioctl(repeater_fd, REPEATER_IOCTL_START) < 0) {
+        printf("failed to start repeater %d\n", errno);
+        ioctl(repeater_fd, REPEATER_IOCTL_UNMAP_BUF);
+        close(repeater_fd);
+        repeater_fd = -1;
+    }
+
+    /* the repeater keeps the mapped buffers */
+    for (i = 0; i < MAX_SHARED_BUFFER_NUM; i++)
+        close(info.buf_fd[i]);
+
+    return repeater_fd;
+}
+
+static void stop_repeater(int repeater_fd)
+{
+    if (repeater_fd < 0)
+        return;
+
+    ioctl(repeater_fd, REPEATER_IOCTL_STOP);
+    ioctl(repeater_fd, REPEATER_IOCTL_UNMAP_BUF);
+    close(repeater_fd);
+}
+
+static int bench_otf(void *handle, const struct bench_config *config, struct bench_result *result)
+{
+    int ret;
+
+    ret = tsmux_init_otf(handle, config->width, config->height);
+    if (ret < 0) {
+        printf("tsmux_init_otf() failed %d\n", ret);
+        tsmux_deinit_otf(handle);
+        return ret;
+    }
+
+    printf("otf: %s %dx%d@%d\n", config->hevc ? "hevc" : "avc",
+        config->width, config->height, config->fps);
+
+    for (int frame = 0; frame < config->frames; frame++) {
+        sp<ABuffer> outbuf;
+        int buf_index;
+        int64_t tsms = 0, tsme = 0;
+        int32_t rtp_size = TS_PKT_COUNT_PER_RTP;
+
+        ret = tsmux_dq_buf_otf_nocopy(handle, outbuf, &buf_index);
+        if (ret < 0) {
+            printf("tsmux_dq_buf_otf_nocopy() failed %d at frame %d\n", ret, frame);
+            break;
+        }
+
+        /* the packetize latency of OTF is stamped by the driver */
+        outbuf->meta()->findInt64("tsms", &tsms);
+        outbuf->meta()->findInt64("tsme", &tsme);
+        outbuf->meta()->findInt32("rtp_size", &rtp_size);
+        result->bytes += outbuf->size();
+        result->ts_packets += count_ts_packets(outbuf->size(), rtp_size);
+        result->frames++;
+        result->latency_us.push_back(tsme - tsms);
+
+        outbuf.clear();
+        tsmux_q_buf_otf_index(handle, buf_index);
+    }
+
+    tsmux_deinit_otf(handle);
+
+    return ret < 0 ? ret : 0;
+}
+
+static int64_t percentile(const std::vector<int64_t> &sorted, int pct)
+{
+    if (sorted.empty())
+        return 0;
+
+    size_t index = (sorted.size() * pct + 99) / 100;
+    return sorted[index > 0 ? index - 1 : 0];
+}
+
+static void report(void *handle, const struct bench_config *config, struct bench_result *result)
+{
+    struct tsmux_stats stats;
+    double seconds = result->wall_us / 1000000.0;
+
+    std::sort(result->latency_us.begin(), result->latency_us.end());
+
+    printf("%s hdcp %d: %lld frames, %lld bytes in %.3f s\n",
+        config->type == M2M_PATH ? "m2m" : "otf", config->hdcp,
+        (long long)result->frames, (long long)result->bytes, seconds);
+    if (seconds > 0)
+        printf("  %.0f TS packets/s, %.0f frames/s, %.2f Mbps\n",
+            result->ts_packets / seconds, result->frames / seconds,
+            result->bytes * 8 / seconds / 1000000.0);
+    printf("  packetize latency us: p50 %lld, p90 %lld, p99 %lld, max %lld\n",
+        (long long)percentile(result->latency_us, 50),
+        (long long)percentile(result->latency_us, 90),
+        (long long)percentile(result->latency_us, 99),
+        (long long)percentile(result->latency_us, 100));
+    printf("  cpu %lld us (%.1f%% of wall), %.1f us per frame\n",
+        (long long)result->cpu_us,
+        result->wall_us ? result->cpu_us * 100.0 / result->wall_us : 0.0,
+        result->frames ? (double)result->cpu_us / result->frames : 0.0);
+
+    if (tsmux_get_stats(handle, &stats) == 0)
+        printf("  psi %lld (%lld bytes), m2m runs %lld, otf dq wait max %lld us\n",
+            (long long)stats.psi_count, (long long)stats.psi_bytes,
+            (long long)stats.m2m_runs, (long long)stats.otf_dq_wait_max_us);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-o] [-e] [-v] [-l] [-b kbps] [-q batch] [-n frames] [-s WxH] [-f fps]\n"
+           "  -o: otf path instead of m2m\n"
+           "  -e: enable HDCP\n"
+           "  -v: HEVC instead of AVC\n"
+           "  -l: LPCM instead of AAC\n"
+           "  -b: bitrate of audio access units (default AAC 128, LPCM 1536 kbps)\n"
+           "  -q: access units packetized in a m2m run (1 ~ %d)\n"
+           "  -n: frames to measure (default 1000)\n"
+           "  -s: otf frame size (default 1920x1080)\n"
+           "  -f: otf frame rate (default 60)\n",
+           name, TSMUX_MAX_M2M_CMD_QUEUE_NUM);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_config config = {M2M_PATH, false, false, false, 0, 1, 1000, 1920, 1080, 60};
+    struct bench_result result = {};
+    BufferAllocator *allocator = NULL;
+    int repeater_fd = -1;
+    void *handle;
+    int opt;
+    int ret;
+
+    while ((opt = getopt(argc, argv, "oevlb:q:n:s:f:h")) != -1) {
+        switch (opt) {
+        case 'o': config.type = OTF_PATH; break;
+        case 'e': config.hdcp = true; break;
+        case 'v': config.hevc = true; break;
+        case 'l': config.lpcm = true; break;
+        case 'b': config.bitrate_kbps = atoi(optarg); break;
+        case 'q': config.batch = atoi(optarg); break;
+        case 'n': config.frames = atoi(optarg); break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &config.width, &config.height) != 2) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 'f': config.fps = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if (config.bitrate_kbps == 0)
+        config.bitrate_kbps = config.lpcm ? 1536 : 128;
+    if ((config.batch < 1) || (config.batch > TSMUX_MAX_M2M_CMD_QUEUE_NUM) ||
+            (config.frames <= 0) || (config.width <= 0) || (config.height <= 0) ||
+            (config.fps <= 0)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (config.type == OTF_PATH) {
+        allocator = CreateDmabufHeapBufferAllocator();
+        if (!allocator ||
+                MapDmabufHeapNameToIonHeap(allocator, "system-uncached", "ion_system_heap",
+                    0, 1 << 0, 0) < 0) {
+            printf("failed to dmabufheap MapNameToIonHeap\n");
+            return -1;
+        }
+
+        repeater_fd = start_repeater(&config, allocator);
+        if (repeater_fd < 0) {
+            FreeDmabufHeapBufferAllocator(allocator);
+            return -1;
+        }
+    }
+
+    handle = tsmux_open(config.hdcp, config.hevc, config.lpcm, false);
+    if (!handle) {
+        printf("tsmux_open() failed\n");
+        stop_repeater(repeater_fd);
+        if (allocator)
+            FreeDmabufHeapBufferAllocator(allocator);
+        return -1;
+    }
+
+    result.latency_us.reserve(config.frames);
+
+    int64_t wall = now_us(CLOCK_MONOTONIC);
+    int64_t cpu = now_us(CLOCK_PROCESS_CPUTIME_ID);
+
+    if (config.type == M2M_PATH)
+        ret = bench_m2m(handle, &config, &result);
+    else
+        ret = bench_otf(handle, &config, &result);
+
+    result.wall_us = now_us(CLOCK_MONOTONIC) - wall;
+    result.cpu_us = now_us(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+    report(handle, &config, &result);
+
+    tsmux_close(handle);
+    stop_repeater(repeater_fd);
+    if (allocator)
+        FreeDmabufHeapBufferAllocator(allocator);
+
+    return ret;
+}
@@ -23,6 +23,9 @@
  * ****************************************************************/
 #define RESTRICTION_NONE 0
 
+/* DPU read bandwidth budget(MB/s), a quarter of the peak DRAM bandwidth */
+#define DPU_READ_BW_BUDGET_MBPS 1800
+
 #define USE_MODULE_ATTR
 
 /* Basic supported features */
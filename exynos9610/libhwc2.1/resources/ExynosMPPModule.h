@@ -24,6 +24,10 @@ class ExynosMPPModule : public ExynosMPP {
         ExynosMPPModule(uint32_t physicalType, uint32_t logicalType, const char *name,
             uint32_t physicalIndex, uint32_t logicalIndex, uint32_t preAssignInfo, uint32_t mppType);
         ~ExynosMPPModule();
+        virtual int64_t isSupportedInternal(DisplayInfo &display, struct exynos_image &src,
+                struct exynos_image &dst) override {
+            return checkSupported<ExynosMPPModule>(display, src, dst);
+        };
         virtual bool isDataspaceSupportedByMPP(struct exynos_image &src, struct exynos_image &dst);
     protected:
         virtual uint32_t getMPPClock();
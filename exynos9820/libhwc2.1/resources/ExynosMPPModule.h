@@ -25,8 +25,14 @@ class ExynosMPPModule : public ExynosMPP {
         ExynosMPPModule(uint32_t physicalType, uint32_t logicalType, const char *name,
             uint32_t physicalIndex, uint32_t logicalIndex, uint32_t preAssignInfo, uint32_t mppType);
         ~ExynosMPPModule();
+        virtual int64_t isSupportedInternal(DisplayInfo &display, struct exynos_image &src,
+                struct exynos_image &dst) override {
+            return checkSupported<ExynosMPPModule>(display, src, dst);
+        };
         virtual bool isSupportedTransform(struct exynos_image &src);
         virtual bool isSupportedCompression(struct exynos_image &src);
+        /* AFBC support depends on assigned state of mSharedMPP */
+        virtual bool isSupportedMemoizable() { return false; };
         virtual uint32_t getDstWidthAlign(struct exynos_image &dst);
         virtual uint32_t getSrcMaxCropSize(struct exynos_image &src);
         virtual bool isSrcFormatSupported(struct exynos_image &src);
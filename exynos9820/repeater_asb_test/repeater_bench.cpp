@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark and stress harness of librepeater
+ *
+ * The repeater copies its shared buffers to the encoder in the kernel, so
+ * the frames are observed at the end of the OTF path through libtsmux and
+ * the timestamps of the driver in each OTF buffer:
+ *
+ *   copy        g2d_end - g2d_start of the repeater copy
+ *   turnaround  kernel_end - g2d_start, from the copy to the OTF buffer
+ *   interval    between the copies of consecutive frames
+ *
+ * Each size and fps is mapped, measured, paused and resumed for the given
+ * cycles and unmapped. Then the first size is mapped again repeatedly to
+ * measure repeater_map() with the buffers kept by librepeater.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "repeater_hal.h"
+#include "tsmux_hal.h"
+
+using namespace android;
+
+#define MAX_DQ_FAILURES     (10)
+
+struct bench_mode {
+    int width;
+    int height;
+    int fps;
+};
+
+struct bench_config {
+    std::vector<struct bench_mode> modes;
+    int frames;
+    int pause_cycles;
+    int pause_ms;
+    int remap_cycles;
+    int max_skipped_frame;
+};
+
+struct bench_latency {
+    std::vector<int64_t> copy_us;
+    std::vector<int64_t> turnaround_us;
+    std::vector<int64_t> interval_us;
+    std::vector<int64_t> resume_us;
+    std::vector<int64_t> map_us;
+};
+
+static int64_t now_us(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+static void print_percentiles(const char *name, std::vector<int64_t> &values)
+{
+    if (values.empty())
+        return;
+
+    std::sort(values.begin(), values.end());
+
+    auto pct = [&values](size_t p) {
+        size_t index = (values.size() * p + 99) / 100;
+        return (long long)values[index > 0 ? index - 1 : 0];
+    };
+
+    printf("  %-10s us: p50 %lld, p90 %lld, p99 %lld, max %lld (%zu)\n",
+        name, pct(50), pct(90), pct(99), pct(100), values.size());
+}
+
+/*
+ * Dequeues an OTF buffer of which copy started at start_us or later.
+ * Returns the driver timestamps in the buffer or a negative value on failure.
+ */
+static int dequeue_frame(void *tsmux, int64_t start_us, int64_t *g2ds, int64_t *g2de,
+        int64_t *kere)
+{
+    int failures = 0;
+
+    while (failures < MAX_DQ_FAILURES) {
+        sp<ABuffer> outbuf;
+        int buf_index;
+
+        if (tsmux_dq_buf_otf_nocopy(tsmux, outbuf, &buf_index) < 0) {
+            failures++;
+            continue;
+        }
+
+        *g2ds = *g2de = *kere = 0;
+        outbuf->meta()->findInt64("g2ds", g2ds);
+        outbuf->meta()->findInt64("g2de", g2de);
+        outbuf->meta()->findInt64("kere", kere);
+        outbuf.clear();
+        tsmux_q_buf_otf_index(tsmux, buf_index);
+
+        /* the frames copied before start_us, e.g. before a pause, are dropped */
+        if (*g2ds >= start_us)
+            return 0;
+    }
+
+    return -ETIMEDOUT;
+}
+
+static int measure_frames(void *tsmux, int frames, struct bench_latency *latency)
+{
+    int64_t last_g2ds = 0;
+
+    for (int i = 0; i < frames; i++) {
+        int64_t g2ds, g2de, kere;
+
+        if (dequeue_frame(tsmux, 0, &g2ds, &g2de, &kere) < 0) {
+            printf("failed to dequeue frame %d\n", i);
+            return -ETIMEDOUT;
+        }
+
+        if (g2de > g2ds)
+            latency->copy_us.push_back(g2de - g2ds);
+        if (kere > g2ds)
+            latency->turnaround_us.push_back(kere - g2ds);
+        if (last_g2ds > 0)
+            latency->interval_us.push_back(g2ds - last_g2ds);
+        last_g2ds = g2ds;
+    }
+
+    return 0;
+}
+
+static int cycle_pause(void *repeater, void *tsmux, const struct bench_config *config,
+        struct bench_latency *latency)
+{
+    for (int i = 0; i < config->pause_cycles; i++) {
+        int idle = -1;
+
+        if (repeater_pause(repeater) < 0)
+            return -EIO;
+
+        usleep(config->pause_ms * 1000);
+
+        repeater_get_idle(repeater, &idle);
+
+        int64_t resume = now_us(CLOCK_MONOTONIC);
+        if (repeater_resume(repeater) < 0)
+            return -EIO;
+
+        int64_t g2ds, g2de, kere;
+        if (dequeue_frame(tsmux, resume, &g2ds, &g2de, &kere) < 0) {
+            printf("no frame after resume of cycle %d\n", i);
+            return -ETIMEDOUT;
+        }
+
+        latency->resume_us.push_back(g2ds - resume);
+        if (idle > 0)
+            printf("  pause cycle %d: idle %d\n", i, idle);
+    }
+
+    return 0;
+}
+
+static int map_repeater(void *repeater, const struct bench_mode *mode,
+        const struct bench_config *config, struct bench_latency *latency)
+{
+    struct repeater_map_info map_info;
+
+    map_info.w = mode->width;
+    map_info.h = mode->height;
+    map_info.fps = mode->fps;
+    map_info.enable_hdcp = false;
+    map_info.max_skipped_frame = config->max_skipped_frame;
+
+    int64_t start = now_us(CLOCK_MONOTONIC);
+    int ret = repeater_map(repeater, &map_info);
+    if (ret < 0) {
+        printf("repeater_map(%dx%d@%d) failed %d\n", mode->width, mode->height, mode->fps, ret);
+        return ret;
+    }
+    latency->map_us.push_back(now_us(CLOCK_MONOTONIC) - start);
+
+    return 0;
+}
+
+static int measure_mode(void *repeater, void *tsmux, const struct bench_mode *mode,
+        const struct bench_config *config)
+{
+    struct bench_latency latency;
+    int ret;
+
+    ret = map_repeater(repeater, mode, config, &latency);
+    if (ret < 0)
+        return ret;
+
+    ret = tsmux_init_otf(tsmux, mode->width, mode->height);
+    if (ret < 0) {
+        printf("tsmux_init_otf() failed %d\n", ret);
+        goto err_tsmux;
+    }
+
+    ret = repeater_start(repeater);
+    if (ret < 0)
+        goto err_start;
+
+    {
+        int64_t wall = now_us(CLOCK_MONOTONIC);
+        int64_t cpu = now_us(CLOCK_PROCESS_CPUTIME_ID);
+
+        ret = measure_frames(tsmux, config->frames, &latency);
+
+        wall = now_us(CLOCK_MONOTONIC) - wall;
+        cpu = now_us(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+        printf("%dx%d@%d: %zu frames in %lld us (%.1f fps), cpu %.1f us per frame\n",
+            mode->width, mode->height, mode->fps, latency.interval_us.size() + 1,
+            (long long)wall, wall ? config->frames * 1000000.0 / wall : 0.0,
+            (double)cpu / config->frames);
+    }
+
+    if (ret == 0)
+        ret = cycle_pause(repeater, tsmux, config, &latency);
+
+    print_percentiles("copy", latency.copy_us);
+    print_percentiles("turnaround", latency.turnaround_us);
+    print_percentiles("interval", latency.interval_us);
+    print_percentiles("resume", latency.resume_us);
+    print_percentiles("map", latency.map_us);
+
+    repeater_stop(repeater);
+err_start:
+    tsmux_deinit_otf(tsmux);
+err_tsmux:
+    repeater_unmap(repeater);
+
+    return ret;
+}
+
+static int bench_remap(void *repeater, const struct bench_config *config)
+{
+    struct bench_latency latency;
+    const struct bench_mode *mode = &config->modes[0];
+
+    for (int i = 0; i < config->remap_cycles; i++) {
+        int ret = map_repeater(repeater, mode, config, &latency);
+        if (ret < 0)
+            return ret;
+
+        ret = repeater_start(repeater);
+        repeater_stop(repeater);
+        repeater_unmap(repeater);
+        if (ret < 0)
+            return ret;
+    }
+
+    printf("remap %dx%d@%d:\n", mode->width, mode->height, mode->fps);
+    print_percentiles("map", latency.map_us);
+
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-m WxH@fps]... [-n frames] [-p cycles] [-t ms] [-r cycles] [-k frames]\n"
+           "  -m: size and fps to measure, repeatable (default 1920x1080@60)\n"
+           "  -n: frames to measure for each size (default 600)\n"
+           "  -p: pause and resume cycles for each size (default 10)\n"
+           "  -t: duration of a pause in ms (default 100)\n"
+           "  -r: remap cycles of the first size (default 20)\n"
+           "  -k: max skipped frames of the repeater while idle (default 0)\n",
+           name);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_config config = {{}, 600, 10, 100, 20, 0};
+    void *repeater;
+    void *tsmux;
+    int opt;
+    int ret = 0;
+
+    while ((opt = getopt(argc, argv, "m:n:p:t:r:k:h")) != -1) {
+        struct bench_mode mode;
+
+        switch (opt) {
+        case 'm':
+            if ((sscanf(optarg, "%dx%d@%d", &mode.width, &mode.height, &mode.fps) != 3) ||
+                    (mode.width <= 0) || (mode.height <= 0) || (mode.fps <= 0)) {
+                usage(argv[0]);
+                return -1;
+            }
+            config.modes.push_back(mode);
+            break;
+        case 'n': config.frames = atoi(optarg); break;
+        case 'p': config.pause_cycles = atoi(optarg); break;
+        case 't': config.pause_ms = atoi(optarg); break;
+        case 'r': config.remap_cycles = atoi(optarg); break;
+        case 'k': config.max_skipped_frame = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if ((config.frames <= 0) || (config.pause_cycles < 0) || (config.pause_ms < 0) ||
+            (config.remap_cycles < 0)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (config.modes.empty())
+        config.modes.push_back({1920, 1080, 60});
+
+    repeater = repeater_open();
+    if (!repeater) {
+        printf("repeater_open() failed\n");
+        return -1;
+    }
+
+    tsmux = tsmux_open(false, false, false, false);
+    if (!tsmux) {
+        printf("tsmux_open() failed\n");
+        repeater_close(repeater);
+        return -1;
+    }
+
+    for (size_t i = 0; (i < config.modes.size()) && (ret == 0); i++)
+        ret = measure_mode(repeater, tsmux, &config.modes[i], &config);
+
+    if (ret == 0)
+        ret = bench_remap(repeater, &config);
+
+    tsmux_close(tsmux);
+    repeater_close(repeater);
+
+    return ret;
+}
@@ -22,15 +22,72 @@ ExynosDeviceModule::ExynosDeviceModule() {
 }
 
 ExynosDeviceModule::~ExynosDeviceModule() {
+    if (mIsEPICHandleInit == true) {
+        for (uint32_t i = 0; i < cpuPropTable.size(); i++)
+            mEPICFreeFcnPtr(cl_min_handle[i]);
+    }
 }
 
 void ExynosDeviceModule::setCPUClocksPerCluster(uint32_t fps) {
+    if (mEPICHandle == nullptr)
+        return;
+
+    if (mIsEPICHandleInit == false) {
+        for (uint32_t i = 0; i < cpuPropTable.size(); i++)
+            cl_min_handle[i] = mEPICRequestFcnPtr(cpuPropTable[i].minLockId);
+        mIsEPICHandleInit = true;
+    } else {
+        if (mEPICOneShotTimer != NULL)
+            mEPICOneShotTimer->stop();
+        for (uint32_t i = 0; i < cpuPropTable.size(); i++)
+            mEPICReleaseFcnPtr(cl_min_handle[i]);
+    }
 
-    for (uint32_t i = 0; i < cpuPropTable.size(); i++) {
-        long cl_min_handle = mEPICRequestFcnPtr(cpuPropTable[i].minLockId);
-        mEPICAcquireOptionFcnPtr(cl_min_handle, perfTable[fps].minClock[i], 0);
-        ALOGI("CPU set : Cluster(%d), min_clock(%d)", i, perfTable[fps].minClock[i]);
+    /* acquireCPUPerfPerCluster() takes the locks of fps by the next present */
+    if (mEPICOneShotTimer) {
+        mEPICOneShotTimer->setInterval(std::chrono::milliseconds(100));
+    } else {
+        const auto callback = &ExynosDevice::releaseCPUPerfPerCluster;
+        mEPICOneShotTimer = new OneShotTimer(std::chrono::milliseconds(100), NULL,
+                                             [this, callback] { std::invoke(callback, this); });
+        mEPICOneShotTimer->start();
     }
 
     return;
 }
+
+void ExynosDeviceModule::acquireCPUPerfPerCluster(uint32_t fps) {
+    if (mIsEPICHandleInit == false || mEPICHandle == NULL) {
+        HDEBUGLOGD(eDebugDefault, "EPIC handle didn't be initialized");
+        return;
+    }
+
+    if (mEPICOneShotTimer == NULL) {
+        HDEBUGLOGD(eDebugDefault, "OneShotTimer is not initialized");
+        return;
+    }
+
+    const auto its = perfTable.find(fps);
+    if (its == perfTable.end()) {
+        ALOGI("%s, %d fps not found in perfTable", __func__, fps);
+        return;
+    }
+
+    /* The min clocks are held while frames are presented */
+    if (mEPICOneShotTimer->isTimerRunning() == false) {
+        for (uint32_t i = 0; i < cpuPropTable.size(); i++) {
+            mEPICAcquireOptionFcnPtr(cl_min_handle[i], perfTable[fps].minClock[i], 0);
+            HDEBUGLOGD(eDebugDefault, "CPU set : Cluster(%d), min_clock(%d)", i, perfTable[fps].minClock[i]);
+        }
+    }
+    mEPICOneShotTimer->reset();
+}
+
+void ExynosDeviceModule::releaseCPUPerfPerCluster() {
+    if (mIsEPICHandleInit == false || mEPICHandle == NULL) {
+        HDEBUGLOGD(eDebugDefault, "EPIC handle didn't be initialized");
+        return;
+    }
+    for (uint32_t i = 0; i < cpuPropTable.size(); i++)
+        mEPICReleaseFcnPtr(cl_min_handle[i]);
+}
@@ -33,6 +33,10 @@ class ExynosDeviceModule : public ExynosDevice {
 #endif
         };
         virtual void setCPUClocksPerCluster(uint32_t fps);
+        virtual void acquireCPUPerfPerCluster(uint32_t fps);
+        virtual void releaseCPUPerfPerCluster();
+        bool mIsEPICHandleInit = false;
+        epic_handle cl_min_handle[CPU_CLUSTER_CNT];
 };
 
 #endif